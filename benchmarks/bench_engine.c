@@ -0,0 +1,827 @@
+/*
+ * bench_engine.c — native benchmarks for the LoadSpiker engine
+ *
+ * Micro benchmarks time the engine's hot paths directly, without Python in
+ * the way:
+ *
+ *   metrics.update       engine_update_metrics() from N threads at once
+ *   metrics.snapshot     engine_get_metrics(), merging every shard
+ *   queue.dispatch       N producers and N batch-claiming, parking consumers
+ *                        on the request queue, with small items and with
+ *                        whole http_request_t items as engine_execute_request()
+ *                        copies them
+ *   ingest.jsonl         request_table_load_jsonl() on one thread and on all
+ *   ingest.table_add     request_table_add()
+ *   histogram.record     histogram_record()
+ *   histogram.percentile histogram_value_at_percentile() on a busy histogram
+ *   histogram.engine     engine_get_latency_percentiles(): shard merge + lookup
+ *
+ * End-to-end benchmarks run real tests against bench_server.c on loopback:
+ * HTTP keep-alive load tests in both execution modes, a TCP send/expect
+ * script, a UDP echo blast and MQTT QoS 1 publish/subscribe.
+ *
+ * Every result is one JSON object per line on --output (and stdout when no
+ * file is given), with a human-readable line on stderr. Fields ending in
+ * "_per_sec" are better higher and fields ending in "_us" or "_ns" better
+ * lower; benchmarks/compare_bench.py compares those between two runs.
+ *
+ * Build and run via: make bench
+ */
+
+#define _GNU_SOURCE   /* sched_getaffinity */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/engine.h"
+#include "../src/engine_internal.h"
+#include "../src/common.h"
+#include "../src/request_jsonl.h"
+#include "../src/mpmc_queue.h"
+#include "bench_server.h"
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS ""
+#endif
+
+#define BENCH_MAX_THREADS 64
+#define BENCH_MAX_FILTERS 16
+
+typedef struct {
+    int threads[BENCH_MAX_THREADS];
+    int thread_count;
+    const char *filters[BENCH_MAX_FILTERS];
+    int filter_count;
+    int duration_seconds;      /* each end-to-end benchmark */
+    int users;                 /* end-to-end connections / virtual users */
+    int scale;                 /* divides micro benchmark sizes (--quick) */
+    const char *host;
+    const char *revision;      /* build being measured, recorded in the meta line */
+    FILE *output;
+} bench_options_t;
+
+static bench_options_t opts;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int online_cpus(void)
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) return CPU_COUNT(&set);
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static const char *const bench_names[] = {
+    "metrics.update", "metrics.snapshot", "queue.dispatch", "queue.dispatch_request", "ingest.jsonl",
+    "ingest.table_add", "histogram.record", "histogram.percentile", "histogram.engine", "e2e.http.threaded",
+    "e2e.http.event", "e2e.tcp", "e2e.udp", "e2e.mqtt", NULL,
+};
+
+static int selected(const char *name)
+{
+    if (opts.filter_count == 0) return 1;
+    for (int i = 0; i < opts.filter_count; i++) {
+        if (strstr(name, opts.filters[i])) return 1;
+    }
+    return 0;
+}
+
+/* Any benchmark whose name starts with prefix is selected */
+static int group_selected(const char *prefix)
+{
+    for (int i = 0; bench_names[i]; i++) {
+        if (strncmp(bench_names[i], prefix, strlen(prefix)) == 0 && selected(bench_names[i])) return 1;
+    }
+    return 0;
+}
+
+/* ---- Output -------------------------------------------------------------- */
+
+/* Append v as a JSON string body: quotes, backslashes and controls escaped */
+static size_t json_string(char *out, size_t cap, const char *v)
+{
+    size_t len = 0;
+    for (; *v && len + 7 < cap; v++) {
+        unsigned char c = (unsigned char)*v;
+        if (c == '"' || c == '\\') {
+            out[len++] = '\\';
+            out[len++] = (char)c;
+        } else if (c < 0x20) {
+            len += (size_t)snprintf(out + len, cap - len, "\\u%04x", c);
+        } else {
+            out[len++] = (char)c;
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/* One result: name, then "key", value pairs. Keys starting with '#' are
+   integers (passed as long long), '$' strings, anything else doubles. */
+static void report(const char *name, ...)
+{
+    char line[2048];
+    size_t len = (size_t)snprintf(line, sizeof(line), "{\"name\": \"%s\"", name);
+    char human[1024];
+    size_t hlen = (size_t)snprintf(human, sizeof(human), "%-28s", name);
+
+    va_list ap;
+    va_start(ap, name);
+    const char *key;
+    while ((key = va_arg(ap, const char *)) != NULL && len < sizeof(line) - 128) {
+        if (key[0] == '#') {
+            long long v = va_arg(ap, long long);
+            len += (size_t)snprintf(line + len, sizeof(line) - len, ", \"%s\": %lld", key + 1, v);
+            if (hlen < sizeof(human) - 64) hlen += (size_t)snprintf(human + hlen, sizeof(human) - hlen, " %s=%lld", key + 1, v);
+        } else if (key[0] == '$') {
+            const char *v = va_arg(ap, const char *);
+            len += (size_t)snprintf(line + len, sizeof(line) - len, ", \"%s\": \"", key + 1);
+            len += json_string(line + len, sizeof(line) - len - 2, v);
+            line[len++] = '"';
+            if (hlen < sizeof(human) - 64) hlen += (size_t)snprintf(human + hlen, sizeof(human) - hlen, " %s=%s", key + 1, v);
+        } else {
+            double v = va_arg(ap, double);
+            len += (size_t)snprintf(line + len, sizeof(line) - len, ", \"%s\": %.6g", key, v);
+            if (hlen < sizeof(human) - 64) hlen += (size_t)snprintf(human + hlen, sizeof(human) - hlen, " %s=%.4g", key, v);
+        }
+    }
+    va_end(ap);
+    fprintf(opts.output, "%s}\n", line);
+    fflush(opts.output);
+    fprintf(stderr, "%s\n", human);
+}
+
+/* Threads released together so the timed interval covers them all */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int waiting;
+    int total;
+    double start;
+} start_gate_t;
+
+static void gate_init(start_gate_t *gate, int total)
+{
+    pthread_mutex_init(&gate->lock, NULL);
+    pthread_cond_init(&gate->cond, NULL);
+    gate->waiting = 0;
+    gate->total = total;
+}
+
+static void gate_wait(start_gate_t *gate)
+{
+    pthread_mutex_lock(&gate->lock);
+    if (++gate->waiting == gate->total) {
+        gate->start = now_seconds();
+        pthread_cond_broadcast(&gate->cond);
+    } else {
+        while (gate->waiting < gate->total) pthread_cond_wait(&gate->cond, &gate->lock);
+    }
+    pthread_mutex_unlock(&gate->lock);
+}
+
+static void gate_destroy(start_gate_t *gate)
+{
+    pthread_mutex_destroy(&gate->lock);
+    pthread_cond_destroy(&gate->cond);
+}
+
+/* ---- Metrics ------------------------------------------------------------- */
+
+#define METRIC_OPS 4000000
+
+static engine_t *metrics_engine;
+static start_gate_t metrics_gate;
+static int metrics_ops_per_thread;
+
+static void *metrics_thread_func(void *arg)
+{
+    uint64_t seed = (uint64_t)(uintptr_t)arg * 0x9E3779B97F4A7C15ULL + 1;
+    gate_wait(&metrics_gate);
+    for (int i = 0; i < metrics_ops_per_thread; i++) {
+        /* xorshift: latencies over a few decades, one failure in 16 */
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        engine_update_metrics(metrics_engine, 50 + (seed >> 40) % 200000, (seed & 15) != 0);
+    }
+    return NULL;
+}
+
+static void bench_metrics(void)
+{
+    if (!group_selected("metrics.")) return;
+
+    for (int t = 0; t < opts.thread_count && selected("metrics.update"); t++) {
+        int threads = opts.threads[t];
+        metrics_engine = engine_create(10, 1);
+        if (!metrics_engine) return;
+        metrics_ops_per_thread = METRIC_OPS / opts.scale / threads;
+        gate_init(&metrics_gate, threads);
+
+        pthread_t tids[BENCH_MAX_THREADS];
+        for (int i = 0; i < threads; i++) pthread_create(&tids[i], NULL, metrics_thread_func, (void *)(uintptr_t)(i + 1));
+        for (int i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+        double elapsed = now_seconds() - metrics_gate.start;
+        gate_destroy(&metrics_gate);
+
+        metrics_t metrics;
+        engine_get_metrics(metrics_engine, &metrics);
+        engine_destroy(metrics_engine);
+        long long ops = (long long)metrics_ops_per_thread * threads;
+        if (metrics.total_requests != (uint64_t)ops) {
+            fprintf(stderr, "[LoadSpiker] bench: metrics.update lost samples (%llu of %lld)\n",
+                    (unsigned long long)metrics.total_requests, ops);
+        }
+        report("metrics.update", "#threads", (long long)threads, "#ops", ops, "seconds", elapsed,
+               "ops_per_sec", (double)ops / elapsed, "thread_op_ns", elapsed * 1e9 * threads / (double)ops, NULL);
+    }
+
+    if (selected("metrics.snapshot")) {
+        metrics_engine = engine_create(10, 1);
+        if (!metrics_engine) return;
+        metrics_ops_per_thread = 100000;
+        gate_init(&metrics_gate, 4);
+        pthread_t tids[4];
+        for (int i = 0; i < 4; i++) pthread_create(&tids[i], NULL, metrics_thread_func, (void *)(uintptr_t)(i + 1));
+        for (int i = 0; i < 4; i++) pthread_join(tids[i], NULL);
+        gate_destroy(&metrics_gate);
+
+        int calls = 2000 / opts.scale;
+        metrics_t metrics;
+        double start = now_seconds();
+        for (int i = 0; i < calls; i++) engine_get_metrics(metrics_engine, &metrics);
+        double elapsed = now_seconds() - start;
+        int shards = metrics_engine->metric_shard_count;
+        engine_destroy(metrics_engine);
+        report("metrics.snapshot", "#shards", (long long)shards, "#ops", (long long)calls, "seconds", elapsed,
+               "ops_per_sec", calls / elapsed, "op_ns", elapsed * 1e9 / calls, NULL);
+    }
+}
+
+/* ---- Request queue ------------------------------------------------------- */
+
+#define DISPATCH_ITEMS 2000000
+#define DISPATCH_REQUEST_ITEMS 40000
+
+static mpmc_queue_t *dispatch_queue;
+static start_gate_t dispatch_gate;
+static size_t dispatch_item_size;
+static int dispatch_per_producer;
+static _Atomic long dispatch_consumed;
+static long dispatch_total;
+static const http_request_t *dispatch_template;
+
+static void *dispatch_producer(void *arg)
+{
+    (void)arg;
+    uint64_t small[8] = {0};
+    gate_wait(&dispatch_gate);
+    for (int i = 0; i < dispatch_per_producer; i++) {
+        void *slot;
+        while ((slot = mpmc_queue_reserve(dispatch_queue)) == NULL) sched_yield();
+        if (dispatch_template) {
+            memcpy(slot, dispatch_template, sizeof(http_request_t));
+        } else {
+            small[0] = (uint64_t)i;
+            memcpy(slot, small, dispatch_item_size);
+        }
+        mpmc_queue_publish(dispatch_queue, slot);
+    }
+    return NULL;
+}
+
+/* The pool worker loop: claim a batch, use it in place, park when dry */
+static void *dispatch_consumer(void *arg)
+{
+    (void)arg;
+    void *items[ENGINE_DISPATCH_BATCH];
+    volatile uint64_t sink = 0;
+    gate_wait(&dispatch_gate);
+    while (atomic_load_explicit(&dispatch_consumed, memory_order_relaxed) < dispatch_total) {
+        int n = mpmc_queue_claim(dispatch_queue, items, ENGINE_DISPATCH_BATCH);
+        if (n == 0) {
+            uint32_t key = mpmc_queue_prepare_wait(dispatch_queue);
+            if (mpmc_queue_depth(dispatch_queue) == 0 &&
+                atomic_load_explicit(&dispatch_consumed, memory_order_relaxed) < dispatch_total) {
+                mpmc_queue_wait(dispatch_queue, key);
+            } else {
+                mpmc_queue_cancel_wait(dispatch_queue);
+            }
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            sink += *(const uint64_t *)items[i];
+            mpmc_queue_release(dispatch_queue, items[i]);
+        }
+        if (atomic_fetch_add(&dispatch_consumed, n) + n >= dispatch_total) mpmc_queue_wake_all(dispatch_queue);
+    }
+    (void)sink;
+    return NULL;
+}
+
+static void run_dispatch(const char *name, size_t item_size, long items, int threads)
+{
+    dispatch_item_size = item_size;
+    dispatch_per_producer = (int)(items / threads);
+    dispatch_total = (long)dispatch_per_producer * threads;
+    atomic_store(&dispatch_consumed, 0);
+    /* The engine's queue: two cells per connection of a 1000-connection engine */
+    dispatch_queue = mpmc_queue_create(item_size, 2000);
+    if (!dispatch_queue) return;
+    gate_init(&dispatch_gate, 2 * threads);
+
+    pthread_t tids[2 * BENCH_MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, dispatch_producer, NULL);
+        pthread_create(&tids[threads + i], NULL, dispatch_consumer, NULL);
+    }
+    for (int i = 0; i < 2 * threads; i++) pthread_join(tids[i], NULL);
+    double elapsed = now_seconds() - dispatch_gate.start;
+    gate_destroy(&dispatch_gate);
+    mpmc_queue_destroy(dispatch_queue);
+
+    report(name, "#threads", (long long)threads, "#item_bytes", (long long)item_size, "#ops", (long long)dispatch_total,
+           "seconds", elapsed, "ops_per_sec", dispatch_total / elapsed, "op_ns", elapsed * 1e9 / dispatch_total, NULL);
+}
+
+static void bench_dispatch(void)
+{
+    http_request_t *request = calloc(1, sizeof(http_request_t));
+    if (!request) return;
+    strcpy(request->method, "GET");
+    strcpy(request->url, "http://127.0.0.1:9/");
+    request->timeout_ms = 1000;
+
+    for (int t = 0; t < opts.thread_count; t++) {
+        int threads = opts.threads[t];
+        if (selected("queue.dispatch")) {
+            dispatch_template = NULL;
+            run_dispatch("queue.dispatch", 64, DISPATCH_ITEMS / opts.scale, threads);
+        }
+        if (selected("queue.dispatch_request")) {
+            dispatch_template = request;
+            run_dispatch("queue.dispatch_request", sizeof(http_request_t), DISPATCH_REQUEST_ITEMS / opts.scale, threads);
+        }
+    }
+    dispatch_template = NULL;
+    free(request);
+}
+
+/* ---- Request ingestion --------------------------------------------------- */
+
+#define INGEST_REQUESTS 400000
+
+static void bench_ingest(void)
+{
+    if (!group_selected("ingest.")) return;
+    int count = INGEST_REQUESTS / opts.scale;
+    size_t cap = (size_t)count * 160, len = 0;
+    char *data = malloc(cap);
+    if (!data) return;
+    for (int i = 0; i < count; i++) {
+        len += (size_t)snprintf(data + len, cap - len,
+                                "{\"url\": \"http://127.0.0.1:8080/items/%d?page=%d\", \"method\": \"%s\", "
+                                "\"headers\": {\"X-Seq\": \"%d\"}, \"body\": \"n=%d\", \"name\": \"item\"}\n",
+                                i, i % 10, i % 3 ? "GET" : "POST", i, i);
+    }
+
+    int variants[2] = {1, 0};
+    for (int v = 0; v < 2 && selected("ingest.jsonl"); v++) {
+        request_table_t table;
+        request_table_init(&table);
+        char error[256];
+        double start = now_seconds();
+        int added = request_table_load_jsonl(&table, data, len, variants[v], error, sizeof(error));
+        double elapsed = now_seconds() - start;
+        request_table_free(&table);
+        if (added != count) {
+            fprintf(stderr, "[LoadSpiker] bench: ingest.jsonl added %d of %d requests (%s)\n", added, count, error);
+            continue;
+        }
+        report("ingest.jsonl", "$threads", variants[v] ? "1" : "auto", "#requests", (long long)count,
+               "#bytes", (long long)len, "seconds", elapsed, "requests_per_sec", count / elapsed,
+               "mb_per_sec", (double)len / 1e6 / elapsed, NULL);
+    }
+    free(data);
+
+    if (selected("ingest.table_add")) {
+        request_table_t table;
+        request_table_init(&table);
+        char url[96], headers[32];
+        double start = now_seconds();
+        for (int i = 0; i < count; i++) {
+            snprintf(url, sizeof(url), "http://127.0.0.1:8080/items/%d?page=%d", i, i % 10);
+            snprintf(headers, sizeof(headers), "X-Seq: %d", i);
+            request_table_add(&table, i % 3 ? "GET" : "POST", url, headers, "n=1", 3, 5000);
+        }
+        double elapsed = now_seconds() - start;
+        request_table_free(&table);
+        report("ingest.table_add", "#requests", (long long)count, "seconds", elapsed,
+               "requests_per_sec", count / elapsed, "op_ns", elapsed * 1e9 / count, NULL);
+    }
+}
+
+/* ---- Histogram ----------------------------------------------------------- */
+
+#define HISTOGRAM_SAMPLES 4000000
+#define PERCENTILE_CALLS 200000
+
+static void bench_histogram(void)
+{
+    if (!group_selected("histogram.")) return;
+    histogram_layout_t layout;
+    histogram_layout_init(&layout, HISTOGRAM_DEFAULT_HIGHEST_US, HISTOGRAM_DEFAULT_SIGNIFICANT_DIGITS);
+    histogram_t *h = histogram_create(&layout);
+    if (!h) return;
+
+    int samples = HISTOGRAM_SAMPLES / opts.scale;
+    uint64_t seed = 88172645463325252ULL;
+    double start = now_seconds();
+    for (int i = 0; i < samples; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        /* Log-uniform from 1 us to ~17 s: every bucket in use */
+        histogram_record(h, (1ULL << (seed % 24)) + (seed >> 48));
+    }
+    double elapsed = now_seconds() - start;
+    if (selected("histogram.record")) {
+        report("histogram.record", "#counters", (long long)layout.counts_len, "#ops", (long long)samples,
+               "seconds", elapsed, "ops_per_sec", samples / elapsed, "op_ns", elapsed * 1e9 / samples, NULL);
+    }
+
+    static const double percentiles[] = {50.0, 90.0, 95.0, 99.0, 99.9, 99.99};
+    const int per_call = (int)(sizeof(percentiles) / sizeof(percentiles[0]));
+    if (selected("histogram.percentile")) {
+        int calls = PERCENTILE_CALLS / opts.scale;
+        volatile uint64_t sink = 0;
+        start = now_seconds();
+        for (int i = 0; i < calls; i++) sink += histogram_value_at_percentile(h, percentiles[i % per_call]);
+        elapsed = now_seconds() - start;
+        (void)sink;
+        report("histogram.percentile", "#counters", (long long)layout.counts_len, "#ops", (long long)calls,
+               "seconds", elapsed, "ops_per_sec", calls / elapsed, "op_ns", elapsed * 1e9 / calls, NULL);
+    }
+    histogram_destroy(h);
+
+    /* The engine path: merge every thread's shard, then look all six up */
+    if (selected("histogram.engine")) {
+        metrics_engine = engine_create(10, 1);
+        if (!metrics_engine) return;
+        metrics_ops_per_thread = 100000;
+        gate_init(&metrics_gate, 4);
+        pthread_t tids[4];
+        for (int i = 0; i < 4; i++) pthread_create(&tids[i], NULL, metrics_thread_func, (void *)(uintptr_t)(i + 1));
+        for (int i = 0; i < 4; i++) pthread_join(tids[i], NULL);
+        gate_destroy(&metrics_gate);
+
+        int calls = 2000 / opts.scale;
+        uint64_t values[6];
+        start = now_seconds();
+        for (int i = 0; i < calls; i++) engine_get_latency_percentiles(metrics_engine, percentiles, values, per_call);
+        elapsed = now_seconds() - start;
+        engine_destroy(metrics_engine);
+        report("histogram.engine", "#percentiles", (long long)per_call, "#ops", (long long)calls, "seconds", elapsed,
+               "ops_per_sec", calls / elapsed, "op_ns", elapsed * 1e9 / calls, NULL);
+    }
+}
+
+/* ---- End to end ---------------------------------------------------------- */
+
+static engine_t *e2e_engine(engine_mode_t mode, int users)
+{
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = users * 2 > 100 ? users * 2 : 100;
+    config.worker_threads = 1;
+    config.mode = mode;
+    config.metrics_window_ms = 0;
+    return engine_create_with_config(&config);
+}
+
+/* The label a test recorded under `name`, or -1 */
+static int find_label(engine_t *engine, const char *name, label_metrics_t *label)
+{
+    int count = engine_get_label_count(engine);
+    for (int l = 0; l < count; l++) {
+        if (engine_get_label_metrics(engine, l, label) == 0 && strcmp(label->name, name) == 0) return l;
+    }
+    return -1;
+}
+
+static void bench_http(const bench_server_ports_t *ports)
+{
+    static const struct {
+        const char *name;
+        engine_mode_t mode;
+    } modes[] = {{"e2e.http.threaded", ENGINE_MODE_THREADED}, {"e2e.http.event", ENGINE_MODE_EVENT}};
+
+    char url[128];
+    snprintf(url, sizeof(url), "http://%s:%d/bench", opts.host, ports->http);
+    request_table_t table;
+    request_table_init(&table);
+    request_table_add(&table, "GET", url, "Accept: */*", NULL, 0, 5000);
+    request_table_add(&table, "POST", url, "Content-Type: application/json", "{\"bench\": true}", 15, 5000);
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        if (!selected(modes[m].name)) continue;
+        engine_t *engine = e2e_engine(modes[m].mode, opts.users);
+        if (!engine) continue;
+        load_test_options_t options;
+        engine_load_test_options_init(&options);
+        options.concurrent_users = opts.users;
+        options.duration_seconds = opts.duration_seconds;
+        options.connection_mode = CONNECTION_MODE_KEEP_ALIVE;
+        options.loop_requests = true;
+
+        double start = now_seconds();
+        int rc = engine_start_load_test_table(engine, &table, &options);
+        double elapsed = now_seconds() - start;
+        metrics_t metrics;
+        engine_get_metrics(engine, &metrics);
+        engine_destroy(engine);
+        if (rc != 0) {
+            fprintf(stderr, "[LoadSpiker] bench: %s did not run\n", modes[m].name);
+            continue;
+        }
+        report(modes[m].name, "#users", (long long)opts.users, "#requests", (long long)metrics.total_requests,
+               "#errors", (long long)metrics.failed_requests, "seconds", elapsed,
+               "requests_per_sec", metrics.total_requests / elapsed, "p50_us", (double)metrics.p50_us,
+               "p99_us", (double)metrics.p99_us, "p999_us", (double)metrics.p999_us, NULL);
+    }
+    request_table_free(&table);
+}
+
+static void bench_tcp(const bench_server_ports_t *ports)
+{
+    if (!selected("e2e.tcp")) return;
+    engine_t *engine = e2e_engine(ENGINE_MODE_EVENT, opts.users);
+    if (!engine) return;
+
+    static const char payload[] = "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopq\n";
+    socket_target_t target = {opts.host, ports->tcp};
+    socket_step_t steps[2] = {
+        {SOCKET_STEP_SEND, payload, sizeof(payload) - 1, "send"},
+        {SOCKET_STEP_EXPECT_UNTIL, "\n", 1, "echo"},
+    };
+    socket_test_options_t options;
+    engine_socket_test_options_init(&options);
+    options.protocol = PROTOCOL_TCP;
+    options.targets = &target;
+    options.num_targets = 1;
+    options.steps = steps;
+    options.num_steps = 2;
+    options.connections = opts.users;
+    options.duration_seconds = opts.duration_seconds;
+    options.iterations = 0;
+
+    double start = now_seconds();
+    int rc = engine_start_socket_test(engine, &options);
+    double elapsed = now_seconds() - start;
+    label_metrics_t echo;
+    int found = find_label(engine, "echo", &echo);
+    engine_destroy(engine);
+    if (rc != 0 || found < 0) {
+        fprintf(stderr, "[LoadSpiker] bench: e2e.tcp did not run\n");
+        return;
+    }
+    report("e2e.tcp", "#connections", (long long)opts.users, "#round_trips", (long long)echo.successful_requests,
+           "#errors", (long long)echo.failed_requests, "seconds", elapsed,
+           "round_trips_per_sec", echo.successful_requests / elapsed, "p50_us", (double)echo.p50_us,
+           "p99_us", (double)echo.p99_us, NULL);
+}
+
+static void bench_udp(const bench_server_ports_t *ports)
+{
+    if (!selected("e2e.udp")) return;
+    engine_t *engine = e2e_engine(ENGINE_MODE_EVENT, 4);
+    if (!engine) return;
+
+    udp_blast_options_t options;
+    engine_udp_blast_options_init(&options);
+    options.host = opts.host;
+    options.port = ports->udp;
+    options.flows = 4;
+    options.payload_size = 64;
+    options.rate_pps = 0;
+    options.duration_seconds = opts.duration_seconds;
+    options.expect_echo = true;
+    options.linger_ms = 200;
+    udp_blast_result_t result;
+    memset(&result, 0, sizeof(result));
+    int rc = engine_start_udp_blast(engine, &options, &result);
+    engine_destroy(engine);
+    if (rc != 0) {
+        fprintf(stderr, "[LoadSpiker] bench: e2e.udp did not run\n");
+        return;
+    }
+    report("e2e.udp", "#flows", (long long)options.flows, "#sent", (long long)result.datagrams_sent,
+           "#received", (long long)result.datagrams_received, "seconds", result.elapsed_seconds,
+           "send_per_sec", result.send_pps, "receive_per_sec", result.receive_pps, "drop_rate", result.drop_rate,
+           "rtt_p50_us", (double)result.rtt_p50_us, "rtt_p99_us", (double)result.rtt_p99_us, NULL);
+}
+
+static void bench_mqtt(const bench_server_ports_t *ports)
+{
+    if (!selected("e2e.mqtt")) return;
+    engine_t *engine = e2e_engine(ENGINE_MODE_EVENT, 8);
+    if (!engine) return;
+
+    mqtt_test_options_t options;
+    engine_mqtt_test_options_init(&options);
+    options.host = opts.host;
+    options.port = ports->mqtt;
+    options.topic = "bench/load";
+    options.client_id_prefix = "bench";
+    options.publishers = 4;
+    options.subscribers = 1;
+    options.qos = 1;
+    options.inflight = 32;
+    options.payload_size = 64;
+    options.duration_seconds = opts.duration_seconds;
+    options.linger_ms = 200;
+    mqtt_test_result_t result;
+    memset(&result, 0, sizeof(result));
+    int rc = engine_start_mqtt_test(engine, &options, &result);
+    engine_destroy(engine);
+    if (rc != 0) {
+        fprintf(stderr, "[LoadSpiker] bench: e2e.mqtt did not run\n");
+        return;
+    }
+    report("e2e.mqtt", "#publishers", (long long)options.publishers, "#subscribers", (long long)options.subscribers,
+           "#qos", (long long)options.qos, "#published", (long long)result.published,
+           "#delivered", (long long)result.delivered, "seconds", result.elapsed_seconds,
+           "publish_per_sec", result.publish_rate, "deliver_per_sec", result.delivery_rate,
+           "ack_p50_us", (double)result.ack_p50_us, "ack_p99_us", (double)result.ack_p99_us,
+           "latency_p99_us", (double)result.latency_p99_us, NULL);
+}
+
+static void bench_end_to_end(void)
+{
+    if (!group_selected("e2e.")) return;
+    bench_server_t *server = bench_server_start(opts.host, NULL);
+    if (!server) return;
+    bench_server_ports_t ports;
+    bench_server_get_ports(server, &ports);
+
+    bench_http(&ports);
+    bench_tcp(&ports);
+    bench_udp(&ports);
+    bench_mqtt(&ports);
+    bench_server_stop(server);
+}
+
+/* ---- Main ---------------------------------------------------------------- */
+
+static volatile sig_atomic_t serve_stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    serve_stop = 1;
+}
+
+/* --serve: just the echo server, for pointing the Python API or another
+   build's benchmarks at it */
+static int serve(void)
+{
+    bench_server_ports_t ports = {8080, 9000, 9001, 1883};
+    const char *env = getenv("BENCH_PORTS");
+    if (env && sscanf(env, "%d,%d,%d,%d", &ports.http, &ports.tcp, &ports.udp, &ports.mqtt) != 4) {
+        fprintf(stderr, "[LoadSpiker] bench: BENCH_PORTS must be \"http,tcp,udp,mqtt\"\n");
+        return 2;
+    }
+    bench_server_t *server = bench_server_start(opts.host, &ports);
+    if (!server) return 1;
+    bench_server_get_ports(server, &ports);
+    printf("serving on %s: http %d, tcp %d, udp %d, mqtt %d\n", opts.host, ports.http, ports.tcp, ports.udp, ports.mqtt);
+    fflush(stdout);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    while (!serve_stop) pause();
+    bench_server_stop(server);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --list            print the benchmark names\n"
+            "  --filter NAME     run benchmarks whose name contains NAME (repeatable)\n"
+            "  --threads LIST    thread counts for the threaded micro benchmarks (default 1,2,4,8)\n"
+            "  --duration SEC    length of each end-to-end benchmark (default 2)\n"
+            "  --users N         end-to-end virtual users / connections (default 32)\n"
+            "  --quick           one tenth of the micro benchmark work, 1 s end-to-end runs\n"
+            "  --host ADDR       loopback address for the echo server (default 127.0.0.1)\n"
+            "  --output FILE     write JSON lines to FILE instead of stdout\n"
+            "  --revision REV    build identifier for the meta line (e.g. git describe)\n"
+            "  --serve           only run the echo server (ports from BENCH_PORTS=http,tcp,udp,mqtt)\n",
+            prog);
+}
+
+static int parse_threads(const char *list)
+{
+    opts.thread_count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long n = strtol(p, &end, 10);
+        if (end == p || n < 1 || n > BENCH_MAX_THREADS || opts.thread_count == BENCH_MAX_THREADS) return -1;
+        opts.threads[opts.thread_count++] = (int)n;
+        p = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return -1;
+    }
+    return opts.thread_count > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    opts.duration_seconds = 2;
+    opts.users = 32;
+    opts.scale = 1;
+    opts.host = "127.0.0.1";
+    opts.revision = "unknown";
+    opts.output = stdout;
+    parse_threads("1,2,4,8");
+    const char *output = NULL;
+    int serve_only = 0, quick = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--list") == 0) {
+            for (int n = 0; bench_names[n]; n++) printf("%s\n", bench_names[n]);
+            return 0;
+        } else if (strcmp(arg, "--quick") == 0) {
+            quick = 1;
+        } else if (strcmp(arg, "--serve") == 0) {
+            serve_only = 1;
+        } else if (value && strcmp(arg, "--filter") == 0 && opts.filter_count < BENCH_MAX_FILTERS) {
+            opts.filters[opts.filter_count++] = value;
+            i++;
+        } else if (value && strcmp(arg, "--threads") == 0 && parse_threads(value) == 0) {
+            i++;
+        } else if (value && strcmp(arg, "--duration") == 0 && atoi(value) > 0) {
+            opts.duration_seconds = atoi(value);
+            i++;
+        } else if (value && strcmp(arg, "--users") == 0 && atoi(value) > 0) {
+            opts.users = atoi(value);
+            i++;
+        } else if (value && strcmp(arg, "--host") == 0) {
+            opts.host = value;
+            i++;
+        } else if (value && strcmp(arg, "--revision") == 0) {
+            opts.revision = value;
+            i++;
+        } else if (value && strcmp(arg, "--output") == 0) {
+            output = value;
+            i++;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (quick) {
+        opts.scale = 10;
+        opts.duration_seconds = 1;
+    }
+    if (serve_only) return serve();
+
+    if (output && !(opts.output = fopen(output, "w"))) {
+        fprintf(stderr, "[LoadSpiker] bench: cannot write %s: %s\n", output, strerror(errno));
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    char date[32];
+    time_t t = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+    report("meta", "$revision", opts.revision, "$compiler", __VERSION__, "$cflags", BENCH_CFLAGS,
+           "$curl", curl_version_info(CURLVERSION_NOW)->version, "#cpus", (long long)online_cpus(),
+           "#scale", (long long)opts.scale, "$date", date, NULL);
+
+    bench_metrics();
+    bench_dispatch();
+    bench_ingest();
+    bench_histogram();
+    bench_end_to_end();
+
+    if (opts.output != stdout) fclose(opts.output);
+    return 0;
+}
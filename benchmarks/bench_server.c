@@ -0,0 +1,612 @@
+/*
+ * bench_server.c — epoll HTTP/TCP/UDP/MQTT echo server for the benchmarks
+ */
+
+#define _GNU_SOURCE   /* recvmmsg, sendmmsg, memmem, accept4 */
+
+#include "bench_server.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#define SERVER_EVENTS    256
+#define READ_CHUNK       65536
+#define UDP_DATAGRAM_MAX 65536
+#define HTTP_HEADER_MAX  65536
+
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH     0x30
+#define MQTT_PUBACK      0x40
+#define MQTT_PUBREC      0x50
+#define MQTT_PUBREL      0x62
+#define MQTT_PUBCOMP     0x70
+#define MQTT_SUBSCRIBE   0x82
+#define MQTT_SUBACK      0x90
+#define MQTT_UNSUBSCRIBE 0xA2
+#define MQTT_UNSUBACK    0xB0
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+
+typedef enum {
+    SOURCE_WAKE,
+    SOURCE_UDP,
+    SOURCE_LISTEN_HTTP,
+    SOURCE_LISTEN_TCP,
+    SOURCE_LISTEN_MQTT,
+    SOURCE_HTTP,
+    SOURCE_TCP,
+    SOURCE_MQTT
+} source_kind_t;
+
+/* What an epoll event points at: a listener, the UDP socket, the stop
+   eventfd, or (as the first member of conn_t) a connection */
+typedef struct {
+    source_kind_t kind;
+    int fd;
+} source_t;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} buffer_t;
+
+typedef struct conn {
+    source_t source;
+    buffer_t in;
+    buffer_t out;
+    size_t out_sent;
+    bool writable_armed;       /* EPOLLOUT requested: the last flush hit a full socket */
+    bool dirty;                /* on the flush list */
+    bool close_after_flush;    /* HTTP "Connection: close" */
+    bool continued;            /* HTTP: "100 Continue" sent for the request being read */
+    int subscriber;            /* MQTT: index in subscribers[], -1 if not subscribed */
+    struct conn *prev;         /* open connections, for closing them at stop */
+    struct conn *next;
+} conn_t;
+
+struct bench_server {
+    int epoll_fd;
+    pthread_t thread;
+    bool running;
+    bench_server_ports_t ports;
+    source_t wake;
+    source_t udp;
+    source_t listeners[3];
+    conn_t *conns;
+
+    /* Connections with replies queued during the current batch of events */
+    conn_t **dirty;
+    int dirty_count;
+    int dirty_cap;
+    /* Connections closed during the batch, freed once it is done */
+    conn_t **dead;
+    int dead_count;
+    int dead_cap;
+    conn_t **subscribers;
+    int subscriber_count;
+    int subscriber_cap;
+
+    struct mmsghdr udp_msgs[BENCH_SERVER_UDP_BATCH];
+    struct iovec udp_iov[BENCH_SERVER_UDP_BATCH];
+    struct sockaddr_storage udp_peers[BENCH_SERVER_UDP_BATCH];
+    char *udp_buffers;
+};
+
+static bool grow_array(void ***items, int *cap, int need)
+{
+    if (need <= *cap) return true;
+    int cap_new = *cap ? *cap * 2 : 64;
+    while (cap_new < need) cap_new *= 2;
+    void **grown = realloc(*items, (size_t)cap_new * sizeof(void *));
+    if (!grown) return false;
+    *items = grown;
+    *cap = cap_new;
+    return true;
+}
+
+static bool buffer_reserve(buffer_t *buffer, size_t extra)
+{
+    if (buffer->cap - buffer->len >= extra) return true;
+    size_t cap = buffer->cap ? buffer->cap : 4096;
+    while (cap - buffer->len < extra) cap *= 2;
+    char *grown = realloc(buffer->data, cap);
+    if (!grown) return false;
+    buffer->data = grown;
+    buffer->cap = cap;
+    return true;
+}
+
+static void buffer_consume(buffer_t *buffer, size_t n)
+{
+    memmove(buffer->data, buffer->data + n, buffer->len - n);
+    buffer->len -= n;
+}
+
+/* ---- Connections --------------------------------------------------------- */
+
+static void conn_close(bench_server_t *server, conn_t *conn)
+{
+    if (conn->source.fd < 0) return;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->source.fd, NULL);
+    close(conn->source.fd);
+    conn->source.fd = -1;
+    if (conn->prev) conn->prev->next = conn->next;
+    else server->conns = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    if (conn->subscriber >= 0) {
+        conn_t *last = server->subscribers[--server->subscriber_count];
+        server->subscribers[conn->subscriber] = last;
+        last->subscriber = conn->subscriber;
+        conn->subscriber = -1;
+    }
+    if (grow_array((void ***)&server->dead, &server->dead_cap, server->dead_count + 1)) {
+        server->dead[server->dead_count++] = conn;
+    }
+}
+
+/* Queue reply bytes; they go out in flush_dirty() at the end of the batch */
+static void conn_queue(bench_server_t *server, conn_t *conn, const void *data, size_t len)
+{
+    if (conn->source.fd < 0) return;
+    if (!buffer_reserve(&conn->out, len)) {
+        conn_close(server, conn);
+        return;
+    }
+    memcpy(conn->out.data + conn->out.len, data, len);
+    conn->out.len += len;
+    if (!conn->dirty && grow_array((void ***)&server->dirty, &server->dirty_cap, server->dirty_count + 1)) {
+        conn->dirty = true;
+        server->dirty[server->dirty_count++] = conn;
+    }
+}
+
+static void conn_arm_writable(bench_server_t *server, conn_t *conn, bool armed)
+{
+    if (conn->writable_armed == armed) return;
+    struct epoll_event event = {.events = EPOLLIN | (armed ? EPOLLOUT : 0), .data.ptr = conn};
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->source.fd, &event);
+    conn->writable_armed = armed;
+}
+
+static void conn_flush(bench_server_t *server, conn_t *conn)
+{
+    while (conn->source.fd >= 0 && conn->out_sent < conn->out.len) {
+        ssize_t n = send(conn->source.fd, conn->out.data + conn->out_sent, conn->out.len - conn->out_sent,
+                         MSG_NOSIGNAL);
+        if (n > 0) {
+            conn->out_sent += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            conn_arm_writable(server, conn, true);
+            return;
+        } else {
+            conn_close(server, conn);
+            return;
+        }
+    }
+    if (conn->source.fd < 0) return;
+    conn->out.len = 0;
+    conn->out_sent = 0;
+    conn_arm_writable(server, conn, false);
+    if (conn->close_after_flush) conn_close(server, conn);
+}
+
+static void conn_free(conn_t *conn)
+{
+    free(conn->in.data);
+    free(conn->out.data);
+    free(conn);
+}
+
+static void flush_dirty(bench_server_t *server)
+{
+    /* Flushing never queues more, so the list cannot grow under us */
+    for (int i = 0; i < server->dirty_count; i++) {
+        conn_t *conn = server->dirty[i];
+        conn->dirty = false;
+        conn_flush(server, conn);
+    }
+    server->dirty_count = 0;
+    for (int i = 0; i < server->dead_count; i++) conn_free(server->dead[i]);
+    server->dead_count = 0;
+}
+
+/* ---- HTTP ---------------------------------------------------------------- */
+
+/* Value of header `name` in the header block [start, end), NULL if absent */
+static const char *http_header(const char *start, const char *end, const char *name, size_t *value_len)
+{
+    size_t name_len = strlen(name);
+    const char *line = memchr(start, '\n', (size_t)(end - start));
+    while (line && line < end) {
+        line++;
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) break;
+        if ((size_t)(eol - line) > name_len && line[name_len] == ':' && strncasecmp(line, name, name_len) == 0) {
+            const char *value = line + name_len + 1;
+            while (value < eol && (*value == ' ' || *value == '\t')) value++;
+            const char *value_end = eol;
+            while (value_end > value && (value_end[-1] == '\r' || value_end[-1] == ' ')) value_end--;
+            *value_len = (size_t)(value_end - value);
+            return value;
+        }
+        line = eol;
+    }
+    return NULL;
+}
+
+static bool http_input(bench_server_t *server, conn_t *conn)
+{
+    size_t pos = 0;
+    while (pos < conn->in.len && !conn->close_after_flush) {
+        const char *start = conn->in.data + pos;
+        size_t avail = conn->in.len - pos;
+        const char *blank = memmem(start, avail, "\r\n\r\n", 4);
+        if (!blank) {
+            if (avail > HTTP_HEADER_MAX) return false;
+            break;
+        }
+        const char *headers_end = blank + 2;
+        size_t header_len = (size_t)(blank + 4 - start);
+
+        size_t value_len = 0, body_len = 0;
+        const char *value = http_header(start, headers_end, "Content-Length", &value_len);
+        if (value) body_len = (size_t)strtoull(value, NULL, 10);
+        if (http_header(start, headers_end, "Transfer-Encoding", &value_len)) return false;   /* not spoken here */
+
+        if (avail - header_len < body_len) {
+            value = http_header(start, headers_end, "Expect", &value_len);
+            if (value && !conn->continued && value_len == 12 && strncasecmp(value, "100-continue", 12) == 0) {
+                static const char continue_line[] = "HTTP/1.1 100 Continue\r\n\r\n";
+                conn_queue(server, conn, continue_line, sizeof(continue_line) - 1);
+                conn->continued = true;
+            }
+            break;
+        }
+        conn->continued = false;
+
+        value = http_header(start, headers_end, "Connection", &value_len);
+        bool close_after = value && value_len == 5 && strncasecmp(value, "close", 5) == 0;
+
+        const char *body = body_len ? start + header_len : "ok";
+        size_t reply_body_len = body_len ? body_len : 2;
+        char head[160];
+        int head_len = snprintf(head, sizeof(head),
+                                "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n%s\r\n",
+                                reply_body_len, close_after ? "Connection: close\r\n" : "");
+        conn_queue(server, conn, head, (size_t)head_len);
+        conn_queue(server, conn, body, reply_body_len);
+        conn->close_after_flush = close_after;
+        pos += header_len + body_len;
+    }
+    buffer_consume(&conn->in, pos);
+    return true;
+}
+
+/* ---- MQTT ---------------------------------------------------------------- */
+
+static void mqtt_fan_out(bench_server_t *server, const unsigned char *body, size_t length, int qos)
+{
+    /* Same topic and payload at QoS 0: no packet ID */
+    size_t topic_end = 2 + (size_t)((body[0] << 8) | body[1]);
+    size_t payload = topic_end + (qos ? 2 : 0);
+    if (payload > length) return;
+    size_t out_len = topic_end + (length - payload);
+    unsigned char header[5];
+    size_t h = 0;
+    header[h++] = MQTT_PUBLISH;
+    for (size_t rl = out_len;;) {
+        header[h++] = (unsigned char)((rl % 128) | (rl >= 128 ? 0x80 : 0));
+        rl /= 128;
+        if (rl == 0) break;
+    }
+    for (int i = 0; i < server->subscriber_count; i++) {
+        conn_t *sub = server->subscribers[i];
+        conn_queue(server, sub, header, h);
+        conn_queue(server, sub, body, topic_end);
+        conn_queue(server, sub, body + payload, length - payload);
+    }
+}
+
+static bool mqtt_input(bench_server_t *server, conn_t *conn)
+{
+    const unsigned char *buf = (const unsigned char *)conn->in.data;
+    size_t pos = 0;
+    while (conn->in.len - pos >= 2) {
+        size_t length = 0, header = 1;
+        int shift = 0;
+        unsigned char byte;
+        do {
+            if (pos + header >= conn->in.len) goto incomplete;
+            if (header > 4) return false;
+            byte = buf[pos + header++];
+            length |= (size_t)(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        if (conn->in.len - pos - header < length) break;
+
+        unsigned char type = buf[pos];
+        const unsigned char *body = buf + pos + header;
+        if ((type & 0xF0) == MQTT_CONNECT) {
+            static const unsigned char connack[] = {MQTT_CONNACK, 2, 0, 0};
+            conn_queue(server, conn, connack, sizeof(connack));
+        } else if (type == MQTT_SUBSCRIBE && length >= 3) {
+            unsigned char suback[] = {MQTT_SUBACK, 3, body[0], body[1], body[length - 1]};
+            if (conn->subscriber < 0 &&
+                grow_array((void ***)&server->subscribers, &server->subscriber_cap, server->subscriber_count + 1)) {
+                conn->subscriber = server->subscriber_count;
+                server->subscribers[server->subscriber_count++] = conn;
+            }
+            conn_queue(server, conn, suback, sizeof(suback));
+        } else if (type == MQTT_UNSUBSCRIBE && length >= 2) {
+            unsigned char unsuback[] = {MQTT_UNSUBACK, 2, body[0], body[1]};
+            if (conn->subscriber >= 0) {
+                conn_t *last = server->subscribers[--server->subscriber_count];
+                server->subscribers[conn->subscriber] = last;
+                last->subscriber = conn->subscriber;
+                conn->subscriber = -1;
+            }
+            conn_queue(server, conn, unsuback, sizeof(unsuback));
+        } else if ((type & 0xF0) == MQTT_PUBLISH && length >= 2) {
+            int qos = (type >> 1) & 0x03;
+            size_t topic_end = 2 + (size_t)((body[0] << 8) | body[1]);
+            if (topic_end + (qos ? 2 : 0) > length) return false;
+            mqtt_fan_out(server, body, length, qos);
+            if (qos) {
+                unsigned char ack[] = {qos == 1 ? MQTT_PUBACK : MQTT_PUBREC, 2, body[topic_end], body[topic_end + 1]};
+                conn_queue(server, conn, ack, sizeof(ack));
+            }
+        } else if (type == MQTT_PUBREL && length >= 2) {
+            unsigned char pubcomp[] = {MQTT_PUBCOMP, 2, body[0], body[1]};
+            conn_queue(server, conn, pubcomp, sizeof(pubcomp));
+        } else if (type == MQTT_PINGREQ) {
+            static const unsigned char pingresp[] = {MQTT_PINGRESP, 0};
+            conn_queue(server, conn, pingresp, sizeof(pingresp));
+        } else if (type == MQTT_DISCONNECT) {
+            return false;
+        }
+        pos += header + length;
+    }
+incomplete:
+    buffer_consume(&conn->in, pos);
+    return true;
+}
+
+/* ---- Event loop ---------------------------------------------------------- */
+
+static void conn_readable(bench_server_t *server, conn_t *conn)
+{
+    if (!buffer_reserve(&conn->in, READ_CHUNK)) {
+        conn_close(server, conn);
+        return;
+    }
+    ssize_t n = recv(conn->source.fd, conn->in.data + conn->in.len, conn->in.cap - conn->in.len, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+    if (n <= 0) {
+        conn_close(server, conn);
+        return;
+    }
+    conn->in.len += (size_t)n;
+
+    bool keep = true;
+    if (conn->source.kind == SOURCE_TCP) {
+        conn_queue(server, conn, conn->in.data, conn->in.len);
+        conn->in.len = 0;
+    } else if (conn->source.kind == SOURCE_HTTP) {
+        keep = http_input(server, conn);
+    } else {
+        keep = mqtt_input(server, conn);
+    }
+    if (!keep) conn_close(server, conn);
+}
+
+static void accept_ready(bench_server_t *server, source_t *listener)
+{
+    for (int i = 0; i < 64; i++) {
+        int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        conn_t *conn = calloc(1, sizeof(conn_t));
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->source.fd = fd;
+        conn->source.kind = listener->kind == SOURCE_LISTEN_HTTP  ? SOURCE_HTTP
+                            : listener->kind == SOURCE_LISTEN_TCP ? SOURCE_TCP
+                                                                  : SOURCE_MQTT;
+        conn->subscriber = -1;
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = conn};
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            free(conn);
+            continue;
+        }
+        conn->next = server->conns;
+        if (server->conns) server->conns->prev = conn;
+        server->conns = conn;
+    }
+}
+
+static void udp_ready(bench_server_t *server)
+{
+    for (int round = 0; round < 16; round++) {
+        for (int i = 0; i < BENCH_SERVER_UDP_BATCH; i++) {
+            server->udp_iov[i].iov_len = UDP_DATAGRAM_MAX;
+            server->udp_msgs[i].msg_hdr.msg_namelen = sizeof(server->udp_peers[i]);
+        }
+        int n = recvmmsg(server->udp.fd, server->udp_msgs, BENCH_SERVER_UDP_BATCH, MSG_DONTWAIT, NULL);
+        if (n <= 0) return;
+        for (int i = 0; i < n; i++) server->udp_iov[i].iov_len = server->udp_msgs[i].msg_len;
+        for (int sent = 0; sent < n;) {
+            int m = sendmmsg(server->udp.fd, server->udp_msgs + sent, (unsigned)(n - sent), MSG_DONTWAIT);
+            if (m <= 0) break;   /* socket buffer full: the rest are dropped, as a busy echo peer would */
+            sent += m;
+        }
+        if (n < BENCH_SERVER_UDP_BATCH) return;
+    }
+}
+
+static void *server_thread_func(void *arg)
+{
+    bench_server_t *server = arg;
+    struct epoll_event events[SERVER_EVENTS];
+
+    for (;;) {
+        int n = epoll_wait(server->epoll_fd, events, SERVER_EVENTS, -1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) break;
+        for (int i = 0; i < n; i++) {
+            source_t *source = events[i].data.ptr;
+            switch (source->kind) {
+            case SOURCE_WAKE:
+                goto done;
+            case SOURCE_UDP:
+                udp_ready(server);
+                break;
+            case SOURCE_LISTEN_HTTP:
+            case SOURCE_LISTEN_TCP:
+            case SOURCE_LISTEN_MQTT:
+                accept_ready(server, source);
+                break;
+            default: {
+                conn_t *conn = (conn_t *)source;
+                if (conn->source.fd < 0) break;   /* closed earlier in this batch */
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) conn_readable(server, conn);
+                if (conn->source.fd >= 0 && (events[i].events & EPOLLOUT)) conn_flush(server, conn);
+                break;
+            }
+            }
+        }
+        flush_dirty(server);
+    }
+done:
+    flush_dirty(server);
+    return NULL;
+}
+
+/* ---- Setup --------------------------------------------------------------- */
+
+static int open_socket(const char *host, int type, int *port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)*port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "[LoadSpiker] bench server: %s is not an IPv4 address\n", host);
+        return -1;
+    }
+    int fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (type == SOCK_DGRAM) {
+        int size = 4 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    }
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        (type == SOCK_STREAM && listen(fd, 1024) != 0) ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) != 0) {
+        fprintf(stderr, "[LoadSpiker] bench server: cannot listen on %s:%d: %s\n", host, *port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static bool server_watch(bench_server_t *server, source_t *source, source_kind_t kind, int fd)
+{
+    source->kind = kind;
+    source->fd = fd;
+    if (fd < 0) return false;
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = source};
+    return epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bench_server_t *bench_server_start(const char *host, const bench_server_ports_t *ports)
+{
+    bench_server_t *server = calloc(1, sizeof(bench_server_t));
+    if (!server) return NULL;
+    if (ports) server->ports = *ports;
+    if (!host) host = "127.0.0.1";
+    server->wake.fd = server->udp.fd = -1;
+    for (int i = 0; i < 3; i++) server->listeners[i].fd = -1;
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->udp_buffers = malloc((size_t)BENCH_SERVER_UDP_BATCH * UDP_DATAGRAM_MAX);
+    if (!server->udp_buffers || server->epoll_fd < 0) {
+        bench_server_stop(server);
+        return NULL;
+    }
+    for (int i = 0; i < BENCH_SERVER_UDP_BATCH; i++) {
+        server->udp_iov[i].iov_base = server->udp_buffers + (size_t)i * UDP_DATAGRAM_MAX;
+        server->udp_msgs[i].msg_hdr.msg_iov = &server->udp_iov[i];
+        server->udp_msgs[i].msg_hdr.msg_iovlen = 1;
+        server->udp_msgs[i].msg_hdr.msg_name = &server->udp_peers[i];
+    }
+
+    bool ok = server_watch(server, &server->wake, SOURCE_WAKE, eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) &&
+              server_watch(server, &server->listeners[0], SOURCE_LISTEN_HTTP,
+                           open_socket(host, SOCK_STREAM, &server->ports.http)) &&
+              server_watch(server, &server->listeners[1], SOURCE_LISTEN_TCP,
+                           open_socket(host, SOCK_STREAM, &server->ports.tcp)) &&
+              server_watch(server, &server->listeners[2], SOURCE_LISTEN_MQTT,
+                           open_socket(host, SOCK_STREAM, &server->ports.mqtt)) &&
+              server_watch(server, &server->udp, SOURCE_UDP, open_socket(host, SOCK_DGRAM, &server->ports.udp));
+    if (!ok || pthread_create(&server->thread, NULL, server_thread_func, server) != 0) {
+        bench_server_stop(server);
+        return NULL;
+    }
+    server->running = true;
+    return server;
+}
+
+void bench_server_get_ports(const bench_server_t *server, bench_server_ports_t *ports)
+{
+    *ports = server->ports;
+}
+
+void bench_server_stop(bench_server_t *server)
+{
+    if (!server) return;
+    if (server->running) {
+        uint64_t one = 1;
+        if (write(server->wake.fd, &one, sizeof(one)) == sizeof(one)) pthread_join(server->thread, NULL);
+    }
+    while (server->conns) conn_close(server, server->conns);
+    for (int i = 0; i < server->dead_count; i++) conn_free(server->dead[i]);
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+    if (server->wake.fd >= 0) close(server->wake.fd);
+    if (server->udp.fd >= 0) close(server->udp.fd);
+    for (int i = 0; i < 3; i++) {
+        if (server->listeners[i].fd >= 0) close(server->listeners[i].fd);
+    }
+    free(server->dirty);
+    free(server->dead);
+    free(server->subscribers);
+    free(server->udp_buffers);
+    free(server);
+}
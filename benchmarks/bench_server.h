@@ -0,0 +1,45 @@
+#ifndef BENCH_SERVER_H
+#define BENCH_SERVER_H
+
+/*
+ * bench_server.h — the peer for LoadSpiker's end-to-end benchmarks
+ *
+ * One epoll thread serving four listeners on one address:
+ *
+ *   HTTP  HTTP/1.1 with keep-alive and pipelining: 200 for every request,
+ *         the request body echoed back ("ok" when there is none)
+ *   TCP   every byte echoed back
+ *   UDP   every datagram echoed back to its sender, recvmmsg()/sendmmsg()
+ *         batches of up to BENCH_SERVER_UDP_BATCH
+ *   MQTT  a small 3.1.1 broker: CONNACK, SUBACK, UNSUBACK, PUBACK / PUBREC
+ *         / PUBCOMP and PINGRESP; every PUBLISH is fanned out at QoS 0 to
+ *         every subscribed client whatever its filter
+ *
+ * Replies queued while handling one batch of events are written once per
+ * connection at the end of the batch, so a pipelining client sees one write
+ * per read. The server never allocates on its own once connections have
+ * reached their working buffer sizes, and it sends nothing unprompted, so
+ * what the benchmarks measure is the client side of the exchange plus a
+ * small, constant cost per message here.
+ */
+
+#define BENCH_SERVER_UDP_BATCH 64
+
+typedef struct bench_server bench_server_t;
+
+typedef struct {
+    int http;
+    int tcp;
+    int udp;
+    int mqtt;
+} bench_server_ports_t;
+
+// Listen on host (NULL = 127.0.0.1) and start serving. Ports left 0 in
+// ports (or all of them, with ports NULL) are picked by the kernel. NULL
+// when a socket cannot be set up, with the reason on stderr.
+bench_server_t *bench_server_start(const char *host, const bench_server_ports_t *ports);
+void bench_server_get_ports(const bench_server_t *server, bench_server_ports_t *ports);
+// Stop the thread and close every socket
+void bench_server_stop(bench_server_t *server);
+
+#endif /* BENCH_SERVER_H */
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""
+Compare two runs of the native benchmarks (make bench)
+=======================================================
+
+Each run is a JSON Lines file written by bench_engine --output. Results are
+matched by benchmark name and parameters (thread count, users, ...); every
+field ending in "_per_sec" is compared as higher-is-better and every field
+ending in "_us" or "_ns" as lower-is-better.
+
+    python3 benchmarks/compare_bench.py baseline.jsonl current.jsonl
+    python3 benchmarks/compare_bench.py --threshold 10 --fail old.jsonl new.jsonl
+
+With --fail the exit status is 1 when any metric got worse by more than the
+threshold, so the comparison can gate a CI job.
+"""
+
+import argparse
+import json
+import sys
+
+# Fields that identify a result rather than measure it
+PARAMETERS = ('threads', 'item_bytes', 'users', 'connections', 'flows',
+              'publishers', 'subscribers', 'qos', 'percentiles')
+
+
+def load_results(path):
+    """Return (meta, {key: record}) for one benchmark output file."""
+    meta = {}
+    results = {}
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                record = json.loads(line)
+            except ValueError as e:
+                raise ValueError(f"{path}:{number}: not JSON: {e}")
+            if record.get('name') == 'meta':
+                meta = record
+                continue
+            params = ','.join(f"{p}={record[p]}" for p in PARAMETERS if p in record)
+            key = f"{record['name']}[{params}]" if params else record['name']
+            results[key] = record
+    return meta, results
+
+
+def direction(field):
+    """+1 if higher is better, -1 if lower is better, 0 if not compared."""
+    if field.endswith('_per_sec'):
+        return 1
+    if field.endswith('_us') or field.endswith('_ns'):
+        return -1
+    return 0
+
+
+def compare(baseline, current, threshold):
+    """Yield (key, field, old, new, change_pct, regressed) for shared metrics."""
+    for key, record in current.items():
+        old_record = baseline.get(key)
+        if old_record is None:
+            continue
+        for field, new in record.items():
+            sign = direction(field)
+            old = old_record.get(field)
+            if sign == 0 or not isinstance(new, (int, float)) or not isinstance(old, (int, float)):
+                continue
+            if old == 0:
+                change = 0.0 if new == 0 else float('inf')
+            else:
+                change = (new - old) / abs(old) * 100.0
+            regressed = sign * change < -threshold
+            yield key, field, old, new, change, regressed
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description="Compare two make bench result files")
+    parser.add_argument('baseline', help="earlier bench output (JSON lines)")
+    parser.add_argument('current', help="new bench output (JSON lines)")
+    parser.add_argument('--threshold', type=float, default=5.0,
+                        help="percent change that counts as a regression (default 5)")
+    parser.add_argument('--fail', action='store_true',
+                        help="exit with status 1 when anything regressed")
+    args = parser.parse_args(argv)
+
+    old_meta, baseline = load_results(args.baseline)
+    new_meta, current = load_results(args.current)
+    print(f"baseline: {old_meta.get('revision', '?')} ({old_meta.get('date', '?')}, "
+          f"{old_meta.get('cpus', '?')} CPUs)")
+    print(f"current:  {new_meta.get('revision', '?')} ({new_meta.get('date', '?')}, "
+          f"{new_meta.get('cpus', '?')} CPUs)")
+    if old_meta.get('scale') != new_meta.get('scale'):
+        print("warning: runs used different --quick settings; micro benchmark sizes differ")
+    print()
+
+    rows = list(compare(baseline, current, args.threshold))
+    width = max((len(key) for key, *_ in rows), default=10)
+    print(f"{'benchmark':<{width}}  {'metric':<20} {'baseline':>12} {'current':>12} {'change':>9}")
+    regressions = 0
+    for key, field, old, new, change, regressed in rows:
+        mark = "  REGRESSED" if regressed else ""
+        regressions += regressed
+        print(f"{key:<{width}}  {field:<20} {old:>12.4g} {new:>12.4g} {change:>+8.1f}%{mark}")
+
+    missing = sorted(set(baseline) - set(current))
+    if missing:
+        print(f"\nnot in current run: {', '.join(missing)}")
+    print(f"\n{regressions} of {len(rows)} metrics regressed by more than {args.threshold:g}%")
+    return 1 if args.fail and regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
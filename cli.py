@@ -70,6 +70,11 @@ except ImportError:
         def report_progress(self, elapsed_time, metrics):
             if self.show_progress:
                 print(f"⏱️  {elapsed_time:.1f}s - Requests: {metrics.get('total_requests', 0)}")
+        
+        def report_window(self, window):
+            if self.show_progress:
+                print(f"📈 {window.get('start_s', 0) + window.get('duration_s', 0):.1f}s - "
+                      f"RPS: {window.get('requests_per_second', 0):.1f}")
                 
         def report_metrics(self, metrics):
             print("\n📊 Test Results:")
@@ -88,6 +93,7 @@ except ImportError:
             
         def start_reporting(self): pass
         def report_progress(self, elapsed_time, metrics): pass
+        def report_window(self, window): pass
         def end_reporting(self): pass
         
         def report_metrics(self, metrics):
@@ -101,6 +107,7 @@ except ImportError:
             
         def start_reporting(self): pass
         def report_progress(self, elapsed_time, metrics): pass
+        def report_window(self, window): pass
         def end_reporting(self): pass
         def report_metrics(self, metrics): pass
     
@@ -116,6 +123,10 @@ except ImportError:
             for reporter in self.reporters:
                 reporter.report_progress(elapsed_time, metrics)
                 
+        def report_window(self, window):
+            for reporter in self.reporters:
+                reporter.report_window(window)
+                
         def report_metrics(self, metrics):
             for reporter in self.reporters:
                 reporter.report_metrics(metrics)
@@ -246,6 +257,10 @@ Examples:
   
   # Advanced load pattern
   loadspiker https://api.example.com -p "ramp:1:50:60" --html report.html
+  
+  # Distributed: run an agent on each load host, then coordinate from anywhere
+  loadspiker --listen 7070 --mode event
+  loadspiker https://api.example.com -u 20000 -d 300 --agent gen1:7070 --agent gen2:7070
         """
     )
     
@@ -255,6 +270,8 @@ Examples:
     target_group.add_argument('-s', '--scenario', help='Python scenario file')
     target_group.add_argument('-c', '--config', help='JSON configuration file')
     target_group.add_argument('-i', '--interactive', action='store_true', help='Interactive mode')
+    target_group.add_argument('--listen', metavar='[HOST:]PORT',
+                              help='Agent mode: run tests sent by a coordinator (see --agent) on this host')
     
     # Load parameters
     parser.add_argument('-u', '--users', type=int, default=10, help='Number of concurrent users (default: 10)')
@@ -265,6 +282,28 @@ Examples:
     # Engine configuration
     parser.add_argument('--max-connections', type=int, default=1000, help='Max connections (default: 1000)')
     parser.add_argument('--threads', type=int, default=10, help='Worker threads (default: 10)')
+    parser.add_argument('--mode', choices=['threaded', 'event'], default='threaded',
+                        help='Engine mode: one thread per user, or curl_multi event loops (default: threaded)')
+    parser.add_argument('--event-loops', type=int, default=0, help='Event-loop threads in event mode (default: one per CPU)')
+    parser.add_argument('--keep-alive', action='store_true', help='Reuse connections per virtual user instead of reconnecting for every request')
+    parser.add_argument('--http-version', choices=['1.1', '2', 'h2c', '3'],
+                        help='HTTP version to ask for; with --keep-alive in event mode HTTP/2 and HTTP/3 '
+                             'multiplex users over shared connections (default: libcurl decides)')
+    parser.add_argument('--max-streams', type=int, default=0,
+                        help='Concurrent streams per HTTP/2 or HTTP/3 connection (default: 100)')
+    parser.add_argument('--loop', action='store_true',
+                        help='Cycle through the scenario until --duration elapses instead of sending each request once')
+    parser.add_argument('--rate', type=float, default=0.0,
+                        help='Open model: send this many requests per second on a fixed schedule; --users caps requests in flight')
+    parser.add_argument('--arrival', choices=['constant', 'poisson'], default='constant',
+                        help='Request spacing with --rate (default: constant)')
+    
+    # Distributed load generation
+    parser.add_argument('--agent', metavar='HOST:PORT', action='append',
+                        help='Shard the test across this agent (can be used multiple times); '
+                             '--users and --rate are totals over all agents')
+    parser.add_argument('--lead-time', type=float, default=2.0,
+                        help='Seconds from handing out the test to every agent starting it (default: 2)')
     
     # Request configuration
     parser.add_argument('-m', '--method', default='GET', help='HTTP method (default: GET)')
@@ -281,12 +320,35 @@ Examples:
     args = parser.parse_args()
     
     # Validate arguments
-    if not any([args.url, args.scenario, args.config, args.interactive]):
-        parser.error("Must specify URL, scenario file, config file, or interactive mode")
+    if not any([args.url, args.scenario, args.config, args.interactive, args.listen]):
+        parser.error("Must specify URL, scenario file, config file, interactive mode or --listen")
+    if args.agent and args.interactive:
+        parser.error("--agent cannot be combined with interactive mode")
+    
+    # Agent mode: a headless engine waiting for a coordinator
+    if args.listen:
+        from loadspiker.distributed import Agent, _parse_address
+        host, port = _parse_address(args.listen if ':' in args.listen else '0.0.0.0:' + args.listen)
+        agent = Agent(host, port, max_connections=args.max_connections, worker_threads=args.threads,
+                      mode=args.mode, event_loops=args.event_loops, verbose=not args.quiet)
+        print(f"🛰️  Agent listening on {agent.address[0]}:{agent.address[1]} (mode: {args.mode})")
+        try:
+            agent.serve_forever()
+        except KeyboardInterrupt:
+            print("\n⏹️  Agent stopped")
+        finally:
+            agent.close()
+        return
     
     # Create engine
-    print(f"🚀 Initializing engine (connections: {args.max_connections}, threads: {args.threads})")
-    engine = Engine(max_connections=args.max_connections, worker_threads=args.threads)
+    if args.agent:
+        from loadspiker.distributed import Coordinator
+        print(f"🚀 Coordinating {len(args.agent)} agents: {', '.join(args.agent)}")
+        engine = Coordinator(args.agent, lead_time=args.lead_time)
+    else:
+        print(f"🚀 Initializing engine (connections: {args.max_connections}, threads: {args.threads}, mode: {args.mode})")
+        engine = Engine(max_connections=args.max_connections, worker_threads=args.threads,
+                        mode=args.mode, event_loops=args.event_loops)
     
     # Check if we have the Python wrapper or raw C extension
     has_run_scenario = hasattr(engine, 'run_scenario')
@@ -299,13 +361,31 @@ Examples:
             def __getattr__(self, name):
                 return getattr(self._engine, name)
                 
-            def run_scenario(self, scenario, users=10, duration=60, ramp_up_duration=0):
+            def run_scenario(self, scenario, users=10, duration=60, ramp_up_duration=0, keep_alive=False,
+                             arrival_rate=0.0, arrival="constant", loop=False, stages=None, on_window=None,
+                             http_version=None, max_streams=0):
                 requests = scenario.build_requests()
-                return self._engine.start_load_test(
+                if stages is None and ramp_up_duration > 0:
+                    stages = [(users, min(ramp_up_duration, duration), "linear")]
+                    if duration > ramp_up_duration:
+                        stages.append((users, duration - ramp_up_duration, "step"))
+                result = self._engine.start_load_test(
                     requests=requests,
                     concurrent_users=users,
-                    duration_seconds=duration
+                    duration_seconds=duration,
+                    keep_alive=keep_alive,
+                    arrival_rate=arrival_rate,
+                    arrival=arrival,
+                    loop=loop or stages is not None,
+                    stages=stages,
+                    http_version=http_version,
+                    max_streams=max_streams
                 )
+                # No streaming thread here; hand over the windows once the test is done
+                if on_window is not None:
+                    for window in self._engine.get_metrics_windows():
+                        on_window(window)
+                return result
         
         engine = EngineWrapper(engine)
     
@@ -364,33 +444,36 @@ Examples:
     # Start reporting
     reporter.start_reporting()
     
+    run_options = {'keep_alive': args.keep_alive, 'arrival_rate': args.rate, 'arrival': args.arrival,
+                   'loop': args.loop, 'on_window': reporter.report_window,
+                   'http_version': args.http_version, 'max_streams': args.max_streams}
+    
     try:
         # Determine load pattern
         if args.pattern:
-            load_pattern = parse_load_pattern(args.pattern)
+            # The engine walks the stages itself, growing and shrinking its
+            # users in place, so there is no gap between them
+            stages = [(users, duration, "step") for users, duration in parse_load_pattern(args.pattern)]
+            for users, duration, _ in stages:
+                print(f"📊 Stage: {users} users for {duration} seconds")
+            
+            engine.run_scenario(scenario, max(users for users, _, _ in stages),
+                                sum(duration for _, duration, _ in stages), stages=stages, **run_options)
+            
+            elapsed_time = time.time() - reporter.start_time
+            reporter.report_progress(elapsed_time, engine.get_metrics())
             
-            for users, duration in load_pattern:
-                print(f"📊 Running {users} users for {duration} seconds...")
-                
-                if args.ramp_up > 0:
-                    engine.run_scenario(scenario, users, duration, args.ramp_up)
-                else:
-                    engine.run_scenario(scenario, users, duration)
-                
-                # Report progress
-                elapsed_time = time.time() - reporter.start_time
-                metrics = engine.get_metrics()
-                reporter.report_progress(elapsed_time, metrics)
-                
         else:
             # Single test run
             print(f"📊 Running {args.users} users for {args.duration} seconds...")
+            if args.rate > 0:
+                print(f"⏱️  Open model: {args.rate:g} requests/s ({args.arrival} arrivals)")
             
             if args.ramp_up > 0:
                 print(f"🔄 Ramp-up: {args.ramp_up} seconds")
-                engine.run_scenario(scenario, args.users, args.duration, args.ramp_up)
+                engine.run_scenario(scenario, args.users, args.duration, args.ramp_up, **run_options)
             else:
-                engine.run_scenario(scenario, args.users, args.duration)
+                engine.run_scenario(scenario, args.users, args.duration, **run_options)
         
         # Final results
         final_metrics = engine.get_metrics()
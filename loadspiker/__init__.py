@@ -36,7 +36,8 @@ from .engine import _python_modules_available
 
 # Import data sources with fallback
 try:
-    from .data_sources import DataManager, DataStrategy, CSVDataSource, load_csv_data, get_user_data
+    from .data_sources import (DataManager, DataStrategy, CSVDataSource, load_csv_data, get_user_data,
+                               write_requests_jsonl)
 except ImportError:
     try:
         import data_sources as _ds
@@ -45,6 +46,7 @@ except ImportError:
         CSVDataSource = _ds.CSVDataSource
         load_csv_data = _ds.load_csv_data
         get_user_data = _ds.get_user_data
+        write_requests_jsonl = _ds.write_requests_jsonl
     except ImportError:
         # Create stubs
         class DataStrategy:
@@ -62,6 +64,7 @@ except ImportError:
         class CSVDataSource: pass
         def load_csv_data(*args): pass
         def get_user_data(*args): return {}
+        def write_requests_jsonl(*args): return 0
 
 # Import scenarios with fallback
 try:
@@ -109,6 +112,7 @@ except ImportError:
         def header_exists(*args): return HeaderAssertion()
         def custom_assertion(*args): return CustomAssertion()
         def run_assertions(*args): return True, []
+        def native_assertions(assertions): return list(assertions)
 
 # Import reporters with fallback
 try:
@@ -142,7 +146,7 @@ __all__ = [
     "ConsoleReporter", "JSONReporter", "HTMLReporter",
     "ramp_up", "constant_load",
     # Data source classes
-    "DataManager", "DataStrategy", "CSVDataSource", "load_csv_data", "get_user_data",
+    "DataManager", "DataStrategy", "CSVDataSource", "load_csv_data", "get_user_data", "write_requests_jsonl",
     # Assertion classes (if successfully imported)
 ]
 
@@ -153,7 +157,8 @@ if 'Assertion' in globals():
         "BodyContainsAssertion", "RegexAssertion", "JSONPathAssertion", 
         "HeaderAssertion", "CustomAssertion", "AssertionGroup",
         "status_is", "response_time_under", "body_contains", "body_matches",
-        "json_path", "header_exists", "custom_assertion", "run_assertions"
+        "json_path", "header_exists", "custom_assertion", "run_assertions",
+        "native_assertions"
     ])
 
 # Add performance assertion items to __all__ if they were imported
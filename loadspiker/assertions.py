@@ -26,6 +26,16 @@ class Assertion:
     def get_error_message(self, response: Dict[str, Any]) -> str:
         """Get detailed error message for failed assertion"""
         return self.message or "Assertion failed"
+    
+    def native_spec(self) -> Optional[Dict[str, Any]]:
+        """The engine's in-worker form of this check (see native_assertions()),
+        or None when it can only run in Python against a full response."""
+        return None
+    
+    def _named(self, spec: Dict[str, Any]) -> Dict[str, Any]:
+        if self.message:
+            spec['name'] = self.message
+        return spec
 
 
 class StatusCodeAssertion(Assertion):
@@ -42,6 +52,9 @@ class StatusCodeAssertion(Assertion):
         actual = response.get('status_code')
         return (self.message or 
                 f"Expected status {self.expected_status}, got {actual}")
+    
+    def native_spec(self) -> Optional[Dict[str, Any]]:
+        return self._named({'status': self.expected_status})
 
 
 class ResponseTimeAssertion(Assertion):
@@ -59,6 +72,9 @@ class ResponseTimeAssertion(Assertion):
         actual_ms = response.get('response_time_us', 0) / 1000
         return (self.message or 
                 f"Response time {actual_ms:.2f}ms exceeded limit {self.max_time_ms}ms")
+    
+    def native_spec(self) -> Optional[Dict[str, Any]]:
+        return self._named({'max_latency_ms': self.max_time_ms})
 
 
 class BodyContainsAssertion(Assertion):
@@ -81,6 +97,12 @@ class BodyContainsAssertion(Assertion):
     def get_error_message(self, response: Dict[str, Any]) -> str:
         return (self.message or 
                 f"Response body does not contain '{self.expected_text}'")
+    
+    def native_spec(self) -> Optional[Dict[str, Any]]:
+        # The engine matches bytes as they stream in, so only exact case
+        if not self.case_sensitive:
+            return None
+        return self._named({'body_contains': self.expected_text})
 
 
 class RegexAssertion(Assertion):
@@ -194,6 +216,13 @@ class HeaderAssertion(Assertion):
             return f"Header '{self.header_name}' expected '{self.expected_value}'"
         else:
             return f"Header '{self.header_name}' does not exist"
+    
+    def native_spec(self) -> Optional[Dict[str, Any]]:
+        # The engine checks presence (and a value substring), not absence
+        # or exact equality
+        if not self.exists or self.expected_value is not None:
+            return None
+        return self._named({'header': self.header_name})
 
 
 class CustomAssertion(Assertion):
@@ -318,3 +347,22 @@ def run_assertions(response: Dict[str, Any], assertions: List[Assertion],
                 break
     
     return len(failed_messages) == 0, failed_messages
+
+
+def native_assertions(assertions: List[Union[Assertion, Dict[str, Any]]]) -> List[Dict[str, Any]]:
+    """Convert assertions for a load test's ``assertions=`` argument.
+    
+    Dicts are passed through as the engine's own specs; Assertion objects
+    are converted with native_spec(). Raises ValueError for an assertion the
+    engine workers cannot check (regex, JSON path, custom, ...).
+    """
+    specs = []
+    for assertion in assertions:
+        if isinstance(assertion, dict):
+            specs.append(assertion)
+            continue
+        spec = assertion.native_spec() if isinstance(assertion, Assertion) else None
+        if spec is None:
+            raise ValueError(f"{type(assertion).__name__} cannot be checked by the engine during a load test")
+        specs.append(spec)
+    return specs
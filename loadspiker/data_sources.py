@@ -275,3 +275,15 @@ def get_user_data(user_id: int, source_name: str = None) -> Dict[str, Any]:
 def get_data_manager() -> DataManager:
     """Get global data manager instance"""
     return _global_data_manager
+
+def write_requests_jsonl(requests: List[Dict[str, Any]], file_path: str) -> int:
+    """Write request dicts as JSON Lines for Engine.run_requests(); returns the count written"""
+    count = 0
+    with open(file_path, 'w', encoding='utf-8') as f:
+        for request in requests:
+            if isinstance(request.get('body'), bytes):
+                request = dict(request, body=request['body'].decode('utf-8'))
+            f.write(json.dumps(request, separators=(',', ':')))
+            f.write('\n')
+            count += 1
+    return count
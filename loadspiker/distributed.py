@@ -0,0 +1,612 @@
+"""
+Distributed load generation for LoadSpiker
+
+One process is bounded by its host's cores and NIC. An Agent runs the C
+engine headless on each load-generating host and waits for work; a
+Coordinator shards a test across the agents, starts them all at the same
+moment and merges what they report into one result:
+
+    # on every load host
+    Agent(port=7070).serve_forever()          # or: loadspiker --listen 7070
+
+    # anywhere
+    coordinator = Coordinator([("gen1", 7070), ("gen2", 7070)])
+    metrics = coordinator.run(requests, users=2000, duration=60,
+                              on_window=print)
+
+Concurrent users, the open-model arrival rate and every stage of a load
+profile are divided between the agents; a request list that is sent once
+(no loop, no stages) is dealt out between them instead. Agents stream each
+metrics window with its full latency histogram, and the coordinator adds
+the histograms together, so the merged p50/p99/p99.9 are exact rather than
+an average of per-agent percentiles.
+
+The wire protocol is one JSON object per line over TCP; histograms travel
+base64-encoded in the engine's own portable format. There is no
+authentication: only listen on trusted networks.
+"""
+
+import base64
+import json
+import os
+import queue
+import select
+import socket
+import threading
+import time
+from typing import Any, Callable, Dict, List, Optional, Tuple, Union
+
+from .engine import Engine, _c_extension_available
+
+if _c_extension_available:
+    from .loadspiker_c import histogram_merge, histogram_percentiles
+else:
+    histogram_merge = histogram_percentiles = None
+
+DEFAULT_PORT = 7070
+
+_PROTOCOL_VERSION = 1
+_CLOCK_SAMPLES = 5
+_POLL_INTERVAL = 0.25
+_MAX_LINE = 256 * 1024 * 1024     # a prepare message carries the whole request list
+
+_METRIC_PERCENTILES = [(50, 'p50_us'), (90, 'p90_us'), (95, 'p95_us'),
+                       (99, 'p99_us'), (99.9, 'p999_us'), (99.99, 'p9999_us')]
+_WINDOW_PERCENTILES = [(50, 'p50_us'), (90, 'p90_us'), (99, 'p99_us')]
+
+# Engine settings that must agree on every agent for their histograms to merge
+_SHARED_ENGINE_OPTIONS = ('histogram_significant_digits', 'histogram_max_seconds', 'metrics_window_ms')
+
+
+class _Channel:
+    """Newline-delimited JSON messages over a connected socket"""
+
+    def __init__(self, sock: socket.socket):
+        self.sock = sock
+        self._buffer = b""
+        self._send_lock = threading.Lock()
+
+    def send(self, message: Dict[str, Any]):
+        data = json.dumps(message, separators=(',', ':')).encode('utf-8') + b"\n"
+        with self._send_lock:
+            self.sock.sendall(data)
+
+    def recv(self, timeout: Optional[float] = None) -> Optional[Dict[str, Any]]:
+        """The next message; None on timeout. Raises ConnectionError once the peer has gone."""
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while b"\n" not in self._buffer:
+            if deadline is not None:
+                remaining = deadline - time.monotonic()
+                if remaining < 0 or not select.select([self.sock], [], [], remaining)[0]:
+                    return None
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                raise ConnectionError("connection closed")
+            self._buffer += chunk
+            if len(self._buffer) > _MAX_LINE:
+                raise ConnectionError("message too large")
+        line, self._buffer = self._buffer.split(b"\n", 1)
+        try:
+            message = json.loads(line)
+        except ValueError:
+            raise ConnectionError("malformed message")
+        if not isinstance(message, dict) or 'type' not in message:
+            raise ConnectionError("malformed message")
+        return message
+
+    def close(self):
+        try:
+            self.sock.close()
+        except OSError:
+            pass
+
+
+def _encode_histogram(data: bytes) -> str:
+    return base64.b64encode(data).decode('ascii')
+
+
+def _decode_histogram(text: str) -> bytes:
+    return base64.b64decode(text)
+
+
+def _split(total: int, parts: int) -> List[int]:
+    """total spread over parts as evenly as integers allow, larger shares first"""
+    return [total // parts + (1 if i < total % parts else 0) for i in range(parts)]
+
+
+def _parse_address(address: Union[str, Tuple[str, int]]) -> Tuple[str, int]:
+    if isinstance(address, tuple):
+        return address[0], int(address[1])
+    host, sep, port = str(address).rpartition(':')
+    if not sep:
+        return address, DEFAULT_PORT
+    return host.strip('[]') or '127.0.0.1', int(port)
+
+
+class Agent:
+    """Runs load tests for a Coordinator on this host"""
+
+    def __init__(self, host: str = "0.0.0.0", port: int = DEFAULT_PORT,
+                 max_connections: int = 1000, worker_threads: int = 10,
+                 mode: str = "threaded", event_loops: int = 0, verbose: bool = False):
+        """
+        Start listening; call serve_forever() or serve_once() to take work
+
+        Args:
+            host, port: Address to listen on (port 0 picks a free one, see address)
+            max_connections, worker_threads, mode, event_loops: Local engine
+                settings, as for Engine. Histogram precision and the window
+                interval come from the coordinator so that results merge.
+            verbose: Print a line per test
+        """
+        if not _c_extension_available:
+            raise RuntimeError("agent mode requires the C extension")
+        self._engine_options = {'max_connections': max_connections, 'worker_threads': worker_threads,
+                                'mode': mode, 'event_loops': event_loops}
+        self.verbose = verbose
+        self._server = socket.create_server((host, port), reuse_port=False)
+        self._closed = False
+
+    @property
+    def address(self) -> Tuple[str, int]:
+        """The (host, port) actually listened on"""
+        return self._server.getsockname()[:2]
+
+    def serve_forever(self):
+        """Serve coordinators one after another until close()"""
+        while not self._closed:
+            try:
+                self.serve_once()
+            except OSError:
+                if self._closed:
+                    break
+                raise
+
+    def serve_once(self):
+        """Accept one coordinator and run its tests until it disconnects"""
+        sock, peer = self._server.accept()
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        channel = _Channel(sock)
+        try:
+            self._serve(channel, peer)
+        except ConnectionError:
+            pass
+        finally:
+            channel.close()
+
+    def close(self):
+        self._closed = True
+        try:
+            self._server.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+        self._server.close()
+
+    def _serve(self, channel: _Channel, peer):
+        test = None
+        while True:
+            message = channel.recv()
+            kind = message['type']
+            if kind == 'clock':
+                channel.send({'type': 'clock', 'time': time.time()})
+            elif kind == 'prepare':
+                if message.get('version') != _PROTOCOL_VERSION:
+                    channel.send({'type': 'error', 'message': "unsupported protocol version"})
+                    continue
+                test = message
+                channel.send({'type': 'ready'})
+            elif kind == 'start':
+                if test is None:
+                    channel.send({'type': 'error', 'message': "start before prepare"})
+                    continue
+                self._run(channel, peer, test, message.get('at', 0.0))
+                test = None
+            elif kind == 'stop':
+                pass    # the test it was meant for has already finished
+            else:
+                channel.send({'type': 'error', 'message': "unknown message %r" % kind})
+
+    def _run(self, channel: _Channel, peer, test: Dict[str, Any], at: float):
+        options = dict(self._engine_options)
+        options.update({k: test['engine'][k] for k in _SHARED_ENGINE_OPTIONS})
+        shard = test['shard']
+        requests = shard['requests']
+        if isinstance(requests, str):
+            requests = requests.encode('utf-8')
+        stages = shard.get('stages')
+        if stages is not None:
+            stages = [tuple(stage) for stage in stages]
+
+        try:
+            engine = Engine(**options)
+        except Exception as e:
+            channel.send({'type': 'error', 'message': "engine: %s" % e})
+            return
+
+        # A stop can arrive while we wait for the common start time
+        delay = at - time.time()
+        early = channel.recv(timeout=delay) if delay > 0 else None
+        if early is not None and early['type'] == 'stop':
+            channel.send({'type': 'done', 'metrics': {}, 'histogram': None, 'queue_delay_histogram': None})
+            return
+        if self.verbose:
+            print(f"🛰️  {peer[0]}: {shard['users']} users for {shard['duration']} s "
+                  f"(started {max(-delay, 0) * 1000:.0f} ms late)")
+
+        try:
+            handle = engine.start_load_test_async(requests, users=shard['users'], duration=shard['duration'],
+                                                  keep_alive=shard['keep_alive'],
+                                                  arrival_rate=shard['arrival_rate'],
+                                                  arrival=shard['arrival'], loop=shard['loop'], stages=stages,
+                                                  http_version=shard.get('http_version'),
+                                                  max_streams=shard.get('max_streams', 0))
+        except Exception as e:
+            channel.send({'type': 'error', 'message': str(e)})
+            return
+
+        with handle:
+            while not handle.wait(0):
+                message = channel.recv(timeout=_POLL_INTERVAL)
+                if message is not None and message['type'] == 'stop':
+                    handle.stop()
+                self._send_windows(channel, handle)
+            try:
+                handle.poll()
+            except RuntimeError as e:
+                channel.send({'type': 'error', 'message': str(e)})
+                return
+            self._send_windows(channel, handle)
+
+        metrics = engine.get_metrics()
+        channel.send({'type': 'done', 'metrics': metrics,
+                      'histogram': _encode_histogram(engine.get_latency_histogram()),
+                      'queue_delay_histogram': _encode_histogram(engine.get_latency_histogram(queue_delay=True))})
+
+    @staticmethod
+    def _send_windows(channel: _Channel, handle):
+        for window in handle.windows(histograms=True):
+            window['histogram'] = _encode_histogram(window['histogram'])
+            channel.send({'type': 'window', 'window': window})
+
+
+class Coordinator:
+    """Shards load tests across Agents and merges their results"""
+
+    def __init__(self, agents: List[Union[str, Tuple[str, int]]], lead_time: float = 2.0,
+                 connect_timeout: float = 10.0, histogram_significant_digits: int = 2,
+                 histogram_max_seconds: int = 3600, metrics_window_ms: int = 1000):
+        """
+        Args:
+            agents: Agent addresses, as (host, port) tuples or "host:port"
+            lead_time: Seconds between sending the start and the agents
+                starting together; must cover handing the test to every agent
+            connect_timeout: Seconds to wait for each agent to accept and answer
+            histogram_significant_digits, histogram_max_seconds,
+            metrics_window_ms: Engine settings every agent uses, as for Engine
+        """
+        if not agents:
+            raise ValueError("at least one agent is required")
+        if not _c_extension_available:
+            raise RuntimeError("distributed mode requires the C extension")
+        self.agents = [_parse_address(agent) for agent in agents]
+        self.lead_time = lead_time
+        self.connect_timeout = connect_timeout
+        self.engine_options = {'histogram_significant_digits': histogram_significant_digits,
+                               'histogram_max_seconds': histogram_max_seconds,
+                               'metrics_window_ms': metrics_window_ms}
+        self._metrics: Dict[str, Any] = {}
+        self._channels: List[_Channel] = []
+        self._stop_lock = threading.Lock()
+
+    def get_metrics(self) -> Dict[str, Any]:
+        """The merged result of the last test"""
+        return self._metrics
+
+    def stop(self):
+        """End the running test on every agent; safe from another thread"""
+        with self._stop_lock:
+            for channel in self._channels:
+                try:
+                    channel.send({'type': 'stop'})
+                except OSError:
+                    pass
+
+    def run_scenario(self, scenario, users: int = 10, duration: int = 60, ramp_up_duration: int = 0,
+                     **kwargs) -> Dict[str, Any]:
+        """Engine.run_scenario() across the agents"""
+        stages = kwargs.pop('stages', None)
+        if stages is None and ramp_up_duration > 0:
+            stages = [(users, min(ramp_up_duration, duration), "linear")]
+            if duration > ramp_up_duration:
+                stages.append((users, duration - ramp_up_duration, "step"))
+        return self.run(scenario, users=users, duration=duration, stages=stages, **kwargs)
+
+    def run(self, requests, users: int = 10, duration: int = 60, keep_alive: bool = False,
+            arrival_rate: float = 0.0, arrival: str = "constant", loop: bool = False,
+            stages: Optional[List[tuple]] = None,
+            on_window: Optional[Callable[[Dict[str, Any]], None]] = None,
+            http_version: Optional[str] = None, max_streams: int = 0) -> Dict[str, Any]:
+        """
+        Run one load test on all agents at once
+
+        Args:
+            requests: A Scenario, a request list, JSONL bytes or a JSONL path
+            users, duration, keep_alive, arrival_rate, arrival, loop,
+            stages, on_window, http_version, max_streams: As for
+                Engine.run_scenario(); users, the arrival rate and stage
+                sizes are totals over all agents, and on_window gets each
+                window once every agent has reported it
+
+        Returns:
+            Merged metrics as get_metrics() returns them, exact percentiles
+            included (per-label percentiles are left out), plus 'agents':
+            each agent's address, users and own totals
+        """
+        shards = self._shard(requests, users, duration, keep_alive, arrival_rate, arrival,
+                             loop or stages is not None, stages, http_version, max_streams)
+        agents = self.agents[:len(shards)]
+
+        channels = []
+        try:
+            for address in agents:
+                channels.append(self._connect(address))
+            for channel, shard in zip(channels, shards):
+                channel.send({'type': 'prepare', 'version': _PROTOCOL_VERSION,
+                              'engine': self.engine_options, 'shard': shard})
+            for address, channel in zip(agents, channels):
+                self._expect(address, channel, 'ready')
+            offsets = [self._clock_offset(address, channel) for address, channel in zip(agents, channels)]
+
+            start_at = time.time() + self.lead_time
+            for channel, offset in zip(channels, offsets):
+                channel.send({'type': 'start', 'at': start_at + offset})
+            with self._stop_lock:
+                self._channels = channels
+            done = self._collect(agents, channels, on_window)
+        finally:
+            with self._stop_lock:
+                self._channels = []
+            for channel in channels:
+                channel.close()
+
+        self._metrics = self._merge_metrics(agents, shards, done)
+        return self._metrics
+
+    # -- setup ---------------------------------------------------------------
+
+    def _shard(self, requests, users, duration, keep_alive, arrival_rate, arrival, loop, stages,
+               http_version=None, max_streams=0):
+        if hasattr(requests, "build_requests"):
+            requests = requests.build_requests()
+        if isinstance(requests, (bytes, bytearray, memoryview)):
+            requests = bytes(requests).decode('utf-8')
+            jsonl = True
+        elif isinstance(requests, (str, os.PathLike)):
+            with open(requests, 'r', encoding='utf-8') as f:
+                requests = f.read()
+            jsonl = True
+        else:
+            requests = list(requests)
+            jsonl = False
+        if not requests:
+            raise ValueError("requests must not be empty")
+
+        peak = max(target for target, *_ in stages) if stages else users
+        count = max(1, min(len(self.agents), peak))
+        if not loop:
+            # Each request goes out once in total, so deal them out
+            items = [line for line in requests.splitlines() if line.strip()] if jsonl else requests
+            count = min(count, len(items))
+            parts = [items[i::count] for i in range(count)]
+            parts = ["\n".join(part) + "\n" for part in parts] if jsonl else parts
+        else:
+            parts = [requests] * count
+
+        user_shares = _split(users, count)
+        stage_shares = [_split(stage[0], count) for stage in stages] if stages else None
+        shards = []
+        for i in range(count):
+            shards.append({
+                'requests': parts[i],
+                'users': max(user_shares[i], 1),
+                'duration': duration,
+                'keep_alive': keep_alive,
+                'arrival_rate': arrival_rate / count,
+                'arrival': arrival,
+                'loop': loop,
+                'http_version': http_version,
+                'max_streams': max_streams,
+                'stages': [[stage_shares[s][i]] + list(stage[1:]) for s, stage in enumerate(stages)]
+                          if stages else None,
+            })
+        return shards
+
+    def _connect(self, address: Tuple[str, int]) -> _Channel:
+        try:
+            sock = socket.create_connection(address, timeout=self.connect_timeout)
+        except OSError as e:
+            raise RuntimeError(f"agent {address[0]}:{address[1]}: {e}")
+        sock.settimeout(None)
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        return _Channel(sock)
+
+    def _expect(self, address, channel: _Channel, kind: str) -> Dict[str, Any]:
+        try:
+            message = channel.recv(timeout=self.connect_timeout)
+        except (ConnectionError, OSError) as e:
+            raise RuntimeError(f"agent {address[0]}:{address[1]}: {e}")
+        if message is None:
+            raise RuntimeError(f"agent {address[0]}:{address[1]}: no answer")
+        if message['type'] == 'error':
+            raise RuntimeError(f"agent {address[0]}:{address[1]}: {message.get('message')}")
+        if message['type'] != kind:
+            raise RuntimeError(f"agent {address[0]}:{address[1]}: expected {kind}, got {message['type']}")
+        return message
+
+    def _clock_offset(self, address, channel: _Channel) -> float:
+        """Agent clock minus ours, from the round trip that took least time"""
+        best_rtt, offset = None, 0.0
+        for _ in range(_CLOCK_SAMPLES):
+            sent = time.time()
+            channel.send({'type': 'clock'})
+            reply = self._expect(address, channel, 'clock')
+            received = time.time()
+            if best_rtt is None or received - sent < best_rtt:
+                best_rtt = received - sent
+                offset = reply['time'] - (sent + received) / 2
+        return offset
+
+    # -- running -------------------------------------------------------------
+
+    def _collect(self, agents, channels, on_window) -> List[Dict[str, Any]]:
+        inbox: "queue.Queue[Tuple[int, Optional[Dict[str, Any]], Optional[str]]]" = queue.Queue()
+
+        def reader(index: int, channel: _Channel):
+            try:
+                while True:
+                    message = channel.recv()
+                    inbox.put((index, message, None))
+                    if message['type'] in ('done', 'error'):
+                        return
+            except (ConnectionError, OSError) as e:
+                inbox.put((index, None, str(e)))
+
+        for index, channel in enumerate(channels):
+            threading.Thread(target=reader, args=(index, channel), daemon=True).start()
+
+        interval = self.engine_options['metrics_window_ms'] / 1000.0
+        done: List[Optional[Dict[str, Any]]] = [None] * len(channels)
+        latest = [-1] * len(channels)       # last window slot each agent reported
+        pending: Dict[int, List[Dict[str, Any]]] = {}
+        failure = None
+
+        def flush(final: bool = False):
+            live = [latest[i] for i in range(len(channels)) if done[i] is None]
+            ready = min(live) if live and not final else None
+            for slot in sorted(pending):
+                if ready is not None and slot > ready:
+                    break
+                windows = pending.pop(slot)
+                if on_window is not None:
+                    on_window(self._merge_windows(slot, interval, windows))
+
+        while any(d is None for d in done):
+            try:
+                index, message, error = inbox.get(timeout=_POLL_INTERVAL)
+            except queue.Empty:
+                continue
+            except KeyboardInterrupt:
+                self.stop()
+                continue
+            address = agents[index]
+            if message is None or message['type'] == 'error':
+                text = error if message is None else message.get('message')
+                failure = failure or f"agent {address[0]}:{address[1]}: {text}"
+                done[index] = {}
+                self.stop()
+            elif message['type'] == 'window':
+                window = message['window']
+                slot = int(round(window['start_s'] / interval)) if interval > 0 else window['sequence']
+                latest[index] = max(latest[index], slot)
+                pending.setdefault(slot, []).append(window)
+                flush()
+            elif message['type'] == 'done':
+                done[index] = message
+                flush()
+        flush(final=True)
+
+        if failure:
+            raise RuntimeError(failure)
+        return done
+
+    # -- merging -------------------------------------------------------------
+
+    @staticmethod
+    def _merge_windows(slot: int, interval: float, windows: List[Dict[str, Any]]) -> Dict[str, Any]:
+        total = sum(w['total_requests'] for w in windows)
+        merged = {
+            'sequence': slot,
+            'start_s': slot * interval,
+            'duration_s': max(w['duration_s'] for w in windows),
+            'total_requests': total,
+            'successful_requests': sum(w['successful_requests'] for w in windows),
+            'failed_requests': sum(w['failed_requests'] for w in windows),
+            'requests_per_second': sum(w['requests_per_second'] for w in windows),
+            'avg_response_time_ms': (sum(w['avg_response_time_ms'] * w['total_requests'] for w in windows) / total
+                                     if total else 0.0),
+            'max_us': max(w['max_us'] for w in windows),
+            'active_users': sum(w['active_users'] for w in windows),
+            'agents': len(windows),
+        }
+        histogram = histogram_merge([_decode_histogram(w['histogram']) for w in windows])
+        values = histogram_percentiles(histogram, [p for p, _ in _WINDOW_PERCENTILES])
+        for percentile, key in _WINDOW_PERCENTILES:
+            merged[key] = values[float(percentile)]
+        merged['histogram'] = histogram
+        return merged
+
+    @staticmethod
+    def _merge_metrics(agents, shards, done: List[Dict[str, Any]]) -> Dict[str, Any]:
+        reports = [d['metrics'] for d in done]
+        total = sum(m.get('total_requests', 0) for m in reports)
+        total_us = sum(m.get('total_response_time_us', 0) for m in reports)
+        minimums = [m['min_response_time_us'] for m in reports if m.get('total_requests')]
+        maximum = max((m.get('max_response_time_us', 0) for m in reports), default=0)
+        merged: Dict[str, Any] = {
+            'total_requests': total,
+            'successful_requests': sum(m.get('successful_requests', 0) for m in reports),
+            'failed_requests': sum(m.get('failed_requests', 0) for m in reports),
+            'total_response_time_us': total_us,
+            'total_response_time_ms': total_us / 1000.0,
+            'min_response_time_us': min(minimums, default=0),
+            'min_response_time_ms': min(minimums, default=0) / 1000.0,
+            'max_response_time_us': maximum,
+            'max_response_time_ms': maximum / 1000.0,
+            'avg_response_time_ms': total_us / total / 1000.0 if total else 0.0,
+            'requests_per_second': sum(m.get('requests_per_second', 0.0) for m in reports),
+        }
+
+        latency = [_decode_histogram(d['histogram']) for d in done if d.get('histogram')]
+        if latency:
+            values = histogram_percentiles(histogram_merge(latency), [p for p, _ in _METRIC_PERCENTILES])
+            for percentile, key in _METRIC_PERCENTILES:
+                merged[key] = values[float(percentile)]
+        queue_delay = [_decode_histogram(d['queue_delay_histogram']) for d in done if d.get('queue_delay_histogram')]
+        if queue_delay:
+            values = histogram_percentiles(histogram_merge(queue_delay), [50, 99])
+            merged['queue_delay_p50_us'] = values[50.0]
+            merged['queue_delay_p99_us'] = values[99.0]
+            merged['queue_delay_max_us'] = values['max']
+
+        status_codes: Dict[int, int] = {}
+        errors: Dict[str, int] = {}
+        labels: Dict[str, Dict[str, Any]] = {}
+        for m in reports:
+            for code, count in m.get('status_codes', {}).items():
+                status_codes[int(code)] = status_codes.get(int(code), 0) + count
+            for message, count in m.get('errors', {}).items():
+                errors[message] = errors.get(message, 0) + count
+            for name, label in m.get('labels', {}).items():
+                entry = labels.setdefault(name, {'total_requests': 0, 'successful_requests': 0,
+                                                 'failed_requests': 0, 'avg_response_time_ms': 0.0,
+                                                 'max_response_time_us': 0, 'status': {}})
+                weight = entry['total_requests'] + label.get('total_requests', 0)
+                if weight:
+                    entry['avg_response_time_ms'] = (entry['avg_response_time_ms'] * entry['total_requests'] +
+                                                     label.get('avg_response_time_ms', 0.0) *
+                                                     label.get('total_requests', 0)) / weight
+                for key in ('total_requests', 'successful_requests', 'failed_requests'):
+                    entry[key] += label.get(key, 0)
+                entry['max_response_time_us'] = max(entry['max_response_time_us'],
+                                                    label.get('max_response_time_us', 0))
+                for status, count in label.get('status', {}).items():
+                    entry['status'][status] = entry['status'].get(status, 0) + count
+        merged['status_codes'] = status_codes
+        merged['errors'] = errors
+        merged['labels'] = labels
+        merged['agents'] = [{'address': f"{address[0]}:{address[1]}", 'users': shard['users'],
+                             'total_requests': m.get('total_requests', 0),
+                             'requests_per_second': m.get('requests_per_second', 0.0),
+                             'p99_us': m.get('p99_us', 0)}
+                            for address, shard, m in zip(agents, shards, reports)]
+        return merged
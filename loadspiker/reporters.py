@@ -30,6 +30,10 @@ class BaseReporter:
     def report_progress(self, elapsed_time: float, metrics: Dict[str, Any]):
         """Report progress during test execution"""
         pass
+    
+    def report_window(self, window: Dict[str, Any]):
+        """Report one windowed snapshot (see Engine.get_metrics_windows)"""
+        pass
 
 
 class ConsoleReporter(BaseReporter):
@@ -73,8 +77,15 @@ class ConsoleReporter(BaseReporter):
         print(f"Avg Response Time:  {metrics.get('avg_response_time_ms', 0):.2f} ms")
         print(f"Min Response Time:  {metrics.get('min_response_time_us', 0) / 1000:.2f} ms")
         print(f"Max Response Time:  {metrics.get('max_response_time_us', 0) / 1000:.2f} ms")
+        print(f"P50 Response Time:  {metrics.get('p50_us', 0) / 1000:.2f} ms")
         print(f"P95 Response Time:  {metrics.get('p95_us', 0) / 1000:.2f} ms")
         print(f"P99 Response Time:  {metrics.get('p99_us', 0) / 1000:.2f} ms")
+        print(f"P99.9 Response Time: {metrics.get('p999_us', 0) / 1000:.2f} ms")
+        if metrics.get('queue_delay_max_us', 0):
+            print(f"P99 Queue Delay:    {metrics.get('queue_delay_p99_us', 0) / 1000:.2f} ms")
+            print(f"Max Queue Delay:    {metrics.get('queue_delay_max_us', 0) / 1000:.2f} ms")
+
+        self._print_breakdown(metrics)
 
         # Status indicators
         if success_rate >= 95:
@@ -86,6 +97,28 @@ class ConsoleReporter(BaseReporter):
         else:
             print("🔴 Test Status: POOR")
             
+    def _print_breakdown(self, metrics: Dict[str, Any]):
+        """Per-label table plus status-code and error counts, when present"""
+        labels = metrics.get('labels') or {}
+        if labels:
+            width = max(len('Label'), *(len(name) for name in labels))
+            print(f"\n{'Label':<{width}}  {'Requests':>9}  {'Failed':>7}  {'Avg ms':>8}  "
+                  f"{'P50 ms':>8}  {'P99 ms':>8}")
+            for name, label in sorted(labels.items()):
+                # Distributed results carry no per-label percentiles
+                p50 = f"{label['p50_us'] / 1000:>8.2f}" if 'p50_us' in label else f"{'-':>8}"
+                p99 = f"{label['p99_us'] / 1000:>8.2f}" if 'p99_us' in label else f"{'-':>8}"
+                print(f"{name:<{width}}  {label.get('total_requests', 0):>9,}  "
+                      f"{label.get('failed_requests', 0):>7,}  {label.get('avg_response_time_ms', 0):>8.2f}  "
+                      f"{p50}  {p99}")
+
+        status_codes = metrics.get('status_codes') or {}
+        if status_codes:
+            codes = ", ".join(f"{code or 'none'}: {count:,}" for code, count in sorted(status_codes.items()))
+            print(f"\nStatus Codes:       {codes}")
+        for message, count in sorted((metrics.get('errors') or {}).items(), key=lambda item: -item[1]):
+            print(f"  ❌ {message}: {count:,}")
+
     def report_progress(self, elapsed_time: float, metrics: Dict[str, Any]):
         """Show progress updates during test"""
         if not self.show_progress:
@@ -102,6 +135,16 @@ class ConsoleReporter(BaseReporter):
         avg_time = metrics.get('avg_response_time_ms', 0)
         
         print(f"⏱️  {elapsed_time:.0f}s | Requests: {total:,} | RPS: {rps:.1f} | Avg: {avg_time:.1f}ms")
+    
+    def report_window(self, window: Dict[str, Any]):
+        """Print one line per window: throughput and tail latency over time"""
+        if not self.show_progress:
+            return
+        
+        end = window.get('start_s', 0) + window.get('duration_s', 0)
+        print(f"📈 {end:6.1f}s | RPS: {window.get('requests_per_second', 0):8.1f} | "
+              f"P99: {window.get('p99_us', 0) / 1000:7.1f}ms | "
+              f"Errors: {window.get('failed_requests', 0):,} | Users: {window.get('active_users', 0)}")
 
 
 class JSONReporter(BaseReporter):
@@ -113,6 +156,7 @@ class JSONReporter(BaseReporter):
         self.test_data = {
             'test_info': {},
             'progress': [],
+            'windows': [],
             'final_metrics': {}
         }
         
@@ -148,6 +192,10 @@ class JSONReporter(BaseReporter):
             'metrics': metrics.copy()
         }
         self.test_data['progress'].append(progress_entry)
+    
+    def report_window(self, window: Dict[str, Any]):
+        """Save windowed snapshot"""
+        self.test_data['windows'].append(dict(window))
 
 
 class HTMLReporter(BaseReporter):
@@ -166,6 +214,15 @@ class HTMLReporter(BaseReporter):
             'avg_response_time': metrics.get('avg_response_time_ms', 0),
             'total_requests': metrics.get('total_requests', 0)
         })
+    
+    def report_window(self, window: Dict[str, Any]):
+        """Chart per-window throughput, which is sharper than cumulative progress"""
+        self.progress_data.append({
+            'time': window.get('start_s', 0) + window.get('duration_s', 0),
+            'requests_per_second': window.get('requests_per_second', 0),
+            'avg_response_time': window.get('avg_response_time_ms', 0),
+            'total_requests': window.get('total_requests', 0)
+        })
         
     def report_metrics(self, metrics: Dict[str, Any]):
         """Generate HTML report"""
@@ -317,4 +374,8 @@ class MultiReporter(BaseReporter):
             
     def report_progress(self, elapsed_time: float, metrics: Dict[str, Any]):
         for reporter in self.reporters:
-            reporter.report_progress(elapsed_time, metrics)
\ No newline at end of file
+            reporter.report_progress(elapsed_time, metrics)
+            
+    def report_window(self, window: Dict[str, Any]):
+        for reporter in self.reporters:
+            reporter.report_window(window)
\ No newline at end of file
@@ -47,23 +47,29 @@ class HTTPRequest:
     
     def __init__(self, url: str, method: str = "GET", 
                  headers: Optional[Dict[str, str]] = None,
-                 body: str = "", timeout_ms: int = 30000):
+                 body: str = "", timeout_ms: int = 30000,
+                 name: Optional[str] = None):
         self.url = url
         self.method = method.upper()
         self.headers = headers or {}
         self.body = body
         self.timeout_ms = timeout_ms
+        # Metrics label; requests without one are grouped as "METHOD /path"
+        self.name = name
     
     def to_dict(self) -> Dict[str, Any]:
         """Convert to dictionary format expected by C engine"""
         headers_str = "\n".join([f"{k}: {v}" for k, v in self.headers.items()])
-        return {
+        request = {
             "url": self.url,
             "method": self.method,
             "headers": headers_str,
             "body": self.body,
             "timeout_ms": self.timeout_ms
         }
+        if self.name:
+            request["name"] = self.name
+        return request
 
 
 class Scenario:
@@ -83,27 +89,29 @@ class Scenario:
         return self
     
     def get(self, url: str, headers: Optional[Dict[str, str]] = None, 
-            timeout_ms: int = 30000):
+            timeout_ms: int = 30000, name: Optional[str] = None):
         """Add a GET request"""
-        self.requests.append(HTTPRequest(url, "GET", headers, "", timeout_ms))
+        self.requests.append(HTTPRequest(url, "GET", headers, "", timeout_ms, name))
         return self
     
     def post(self, url: str, body: str = "", 
-             headers: Optional[Dict[str, str]] = None, timeout_ms: int = 30000):
+             headers: Optional[Dict[str, str]] = None, timeout_ms: int = 30000,
+             name: Optional[str] = None):
         """Add a POST request"""
-        self.requests.append(HTTPRequest(url, "POST", headers, body, timeout_ms))
+        self.requests.append(HTTPRequest(url, "POST", headers, body, timeout_ms, name))
         return self
     
     def put(self, url: str, body: str = "", 
-            headers: Optional[Dict[str, str]] = None, timeout_ms: int = 30000):
+            headers: Optional[Dict[str, str]] = None, timeout_ms: int = 30000,
+            name: Optional[str] = None):
         """Add a PUT request"""
-        self.requests.append(HTTPRequest(url, "PUT", headers, body, timeout_ms))
+        self.requests.append(HTTPRequest(url, "PUT", headers, body, timeout_ms, name))
         return self
     
     def delete(self, url: str, headers: Optional[Dict[str, str]] = None, 
-               timeout_ms: int = 30000):
+               timeout_ms: int = 30000, name: Optional[str] = None):
         """Add a DELETE request"""
-        self.requests.append(HTTPRequest(url, "DELETE", headers, "", timeout_ms))
+        self.requests.append(HTTPRequest(url, "DELETE", headers, "", timeout_ms, name))
         return self
     
     def set_variable(self, name: str, value: Any):
@@ -157,6 +165,29 @@ class Scenario:
         
         return processed_requests
     
+    def build_data_driven_requests(self) -> Optional[Dict[str, Any]]:
+        """
+        Requests and data rows for substitution in the C engine
+        
+        Scenario variables are substituted here; ${source.field} placeholders
+        are left for the engine, which fills them from the source's rows at
+        send time following the source's strategy. Returns None unless the
+        scenario has exactly one data source.
+        """
+        sources = self.data_manager.list_sources()
+        if len(sources) != 1:
+            return None
+        if self.setup_func:
+            self.setup_func(self)
+        
+        distributor = self.data_manager.data_sources[sources[0]]
+        return {
+            'requests': [self._process_request(request).to_dict() for request in self.requests],
+            'data': distributor.data_source.data,
+            'data_name': sources[0],
+            'data_strategy': distributor.strategy.value,
+        }
+    
     def _process_request(self, request: HTTPRequest, user_data: Dict[str, Dict[str, Any]] = None) -> HTTPRequest:
         """Process request with variable substitution"""
         url = self._substitute_variables(request.url, user_data)
@@ -166,7 +197,7 @@ class Scenario:
         for k, v in request.headers.items():
             headers[k] = self._substitute_variables(v, user_data)
         
-        return HTTPRequest(url, request.method, headers, body, request.timeout_ms)
+        return HTTPRequest(url, request.method, headers, body, request.timeout_ms, request.name)
     
     def _substitute_variables(self, text: str, user_data: Dict[str, Dict[str, Any]] = None) -> str:
         """Substitute variables in text using ${var} syntax"""
@@ -37,6 +37,24 @@ def check_libcurl_available():
         return False
 
 
+def check_optional_driver(package, env_var, min_version=None):
+    """
+    Check whether an optional database client library should be built in.
+
+    The driver is on when pkg-config finds the package (at min_version or
+    newer, if given); setting env_var to 0 or 1 forces it off or on.
+    """
+    forced = os.environ.get(env_var)
+    if forced is not None:
+        return forced == '1'
+    query = ['--atleast-version=%s' % min_version] if min_version else ['--exists']
+    try:
+        subprocess.check_output(['pkg-config'] + query + [package], stderr=subprocess.DEVNULL)
+        return True
+    except (subprocess.CalledProcessError, FileNotFoundError):
+        return False
+
+
 def check_dependencies():
     """
     Check for required system dependencies and provide helpful error messages.
@@ -149,6 +167,21 @@ check_dependencies()
 # Get curl flags
 curl_cflags, curl_libs = get_pkg_config_flags('libcurl')
 
+# Optional database drivers: LOADSPIKER_WITH_LIBPQ / LOADSPIKER_WITH_MYSQL
+db_cflags, db_libs, db_macros = [], [], []
+if check_optional_driver('libpq', 'LOADSPIKER_WITH_LIBPQ', '14'):
+    cflags, libs = get_pkg_config_flags('libpq')
+    db_cflags += cflags
+    db_libs += libs or ['-lpq']
+    db_macros.append(('LOADSPIKER_HAVE_LIBPQ', None))
+if check_optional_driver('mysqlclient', 'LOADSPIKER_WITH_MYSQL'):
+    cflags, libs = get_pkg_config_flags('mysqlclient')
+    db_cflags += cflags
+    db_libs += libs or ['-lmysqlclient']
+    db_macros.append(('LOADSPIKER_HAVE_MYSQL', None))
+if VERBOSE_MODE:
+    print(f"🗄️  Database drivers: {', '.join(m[0] for m in db_macros) or 'none'}")
+
 # Warning flags - catch common bugs at compile time
 WARNING_FLAGS = [
     '-Wall',                              # Enable all common warnings
@@ -174,13 +207,14 @@ else:
 # Combine all compile arguments
 extra_compile_args = (
     curl_cflags + 
+    db_cflags +
     OPTIMIZATION_FLAGS + 
     WARNING_FLAGS + 
     ['-pthread', '-std=c11']
 )
 
 # Combine all link arguments
-extra_link_args = curl_libs + LINK_FLAGS + ['-pthread']
+extra_link_args = curl_libs + db_libs + LINK_FLAGS + ['-pthread', '-lm']
 
 if VERBOSE_MODE:
     print(f"🔧 Compile flags: {' '.join(extra_compile_args)}")
@@ -196,16 +230,38 @@ loadspiker_c_extension = Extension(
     sources=[
         'src/python_extension.c',
         'src/engine.c',
+        'src/event_loop.c',
+        'src/socket_loop.c',
+        'src/udp_blast.c',
+        'src/mqtt_loop.c',
+        'src/ws_loop.c',
+        'src/db_loop.c',
+        'src/request_loop.c',
+        'src/histogram.c',
+        'src/request_table.c',
+        'src/request_template.c',
+        'src/request_jsonl.c',
+        'src/replay_log.c',
+        'src/param_table.c',
+        'src/response_assert.c',
+        'src/scratch_arena.c',
+        'src/metrics_ring.c',
+        'src/placement.c',
+        'src/mpmc_queue.c',
+        'src/lock_stats.c',
         'src/protocols/tcp.c',
         'src/protocols/udp.c', 
+        'src/protocols/conn_table.c',
         'src/protocols/mqtt.c',
         'src/protocols/database.c',
+        'src/protocols/db_postgres.c',
+        'src/protocols/db_mysql.c',
         'src/protocols/websocket.c'
     ],
     include_dirs=['src', 'src/protocols'],
     extra_compile_args=extra_compile_args,
     extra_link_args=extra_link_args,
-    define_macros=[('_GNU_SOURCE', None)]
+    define_macros=[('_GNU_SOURCE', None)] + db_macros
 )
 
 setup(
@@ -0,0 +1,619 @@
+#include "engine_internal.h"
+#include "common.h"
+#include "histogram.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * PostgreSQL back-end behind engine_start_database_test().
+ *
+ * Each loop owns an epoll set and its share of the connections. A
+ * connection is opened with libpq's non-blocking connect (PQconnectPoll
+ * driven by the loop), then put in pipeline mode: it prepares every query
+ * once and keeps up to pipeline_depth queries in flight, each one its own
+ * pipeline segment (query + Sync) so an error fails only that query. Sent
+ * segments sit in a FIFO ring with their send time; results come back in
+ * order, so the segment at the head owns whatever result arrives next and
+ * its Sync marks it done.
+ *
+ * libpq buffers what the PQsend* calls queue; one PQflush() per pass
+ * writes the whole batch.
+ */
+
+#if defined(__linux__) && defined(LOADSPIKER_HAVE_LIBPQ)
+
+#include <libpq-fe.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#define DB_LOOP_MAX_EVENTS 256
+#define DB_SEND_BURST 64                 /* queries per connection per pass, so one cannot hog its loop */
+#define DB_SWEEP_US 50000                /* how often in-flight queries are checked for timeouts */
+
+typedef enum {
+    CLIENT_IDLE = 0,        /* not connected yet */
+    CLIENT_CONNECTING,      /* PQconnectPoll handshake */
+    CLIENT_RUNNING,
+    CLIENT_DRAINING,        /* done sending, waiting for results */
+    CLIENT_DONE
+} client_phase_t;
+
+/* One pipeline segment: a Prepare or a query, then a Sync */
+typedef struct {
+    uint64_t sent_us;
+    int16_t query;          /* index into the plan's queries */
+    bool prepare;
+    bool ok;                /* a result arrived and it was not an error */
+    bool failed;            /* an error result arrived */
+} db_segment_t;
+
+typedef struct {
+    PGconn* pg;
+    int fd;                       /* registered in epoll, -1 = none */
+    client_phase_t phase;
+    bool send_done;               /* counted out of senders_left */
+    bool flushing;                /* libpq still holds output */
+    uint64_t op_start_us;         /* start of the connect or the drain */
+    uint64_t open_us;             /* connected: the rate schedule starts here */
+    uint32_t events;              /* registered epoll interest */
+    db_segment_t* ring;           /* in-flight segments, ring[head..head+pending) */
+    int head;
+    int pending;
+    int pending_queries;          /* of those, queries (not prepares) */
+    int next_query;
+    uint64_t sent;                /* queries sent */
+    uint64_t limit;               /* queries to send; 0 = until stopped */
+} db_client_t;
+
+typedef struct {
+    pthread_t thread;
+    bool started;
+    engine_t* engine;
+    const db_plan_t* plan;
+    struct db_loop_group* group;
+    int loop_id;
+    int epoll_fd;
+    db_client_t* clients;
+    int count;
+    int open;                     /* clients not yet CLIENT_DONE */
+    int ring_size;
+    double rate;                  /* queries per second per connection; 0 = unthrottled */
+    bool busy;                    /* a connection stopped at its burst limit */
+    uint64_t next_sweep_us;
+
+    uint64_t connected;
+    uint64_t connect_failures;
+    uint64_t connections_lost;
+    uint64_t queries_sent;
+    uint64_t queries_ok;
+    uint64_t query_errors;
+    uint64_t timeouts;
+    uint64_t rows_returned;
+    uint64_t statements_prepared;
+    histogram_t* latency;
+} db_loop_t;
+
+struct db_loop_group {
+    db_loop_t* loops;
+    int count;
+    _Atomic int running;
+    _Atomic int senders_left;
+    _Atomic uint64_t send_end_us;       /* 0 until the last connection is done sending */
+    uint64_t start_us;
+};
+
+static const char* statement_name(int query, char* out, size_t len) {
+    snprintf(out, len, "ls_q%d", query);
+    return out;
+}
+
+static void client_watch(db_loop_t* loop, db_client_t* c, uint32_t events) {
+    int fd = PQsocket(c->pg);
+    if (fd != c->fd) {
+        /* libpq may switch sockets while connecting (next host, SSL retry) */
+        if (c->fd >= 0) epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+        c->fd = -1;
+        c->events = 0;
+        if (fd < 0) return;
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.ptr = c;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) return;
+        c->fd = fd;
+        c->events = events;
+        return;
+    }
+    engine_loop_watch(loop->epoll_fd, c->fd, c, &c->events, events);
+}
+
+/* A connection is counted out of senders_left once, sent or not; the last
+   one ends the send phase */
+static void client_end_sending(db_loop_t* loop, db_client_t* c) {
+    if (c->send_done) return;
+    c->send_done = true;
+    if (atomic_fetch_sub(&loop->group->senders_left, 1) == 1) {
+        atomic_store(&loop->group->send_end_us, get_time_us());
+    }
+}
+
+static void client_finish(db_loop_t* loop, db_client_t* c) {
+    if (c->fd >= 0) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+        c->fd = -1;
+    }
+    if (c->pg) {
+        PQfinish(c->pg);
+        c->pg = NULL;
+    }
+    client_end_sending(loop, c);
+    c->phase = CLIENT_DONE;
+    loop->open--;
+}
+
+/* Fail every segment still in flight with result, oldest first */
+static void client_fail_pending(db_loop_t* loop, db_client_t* c, CURLcode result) {
+    while (c->pending > 0) {
+        db_segment_t* seg = &c->ring[c->head];
+        if (!seg->prepare) {
+            engine_record_socket_since(loop->engine, loop->plan->query_labels[seg->query], seg->sent_us, result);
+            if (result == CURLE_OPERATION_TIMEDOUT) {
+                loop->timeouts++;
+            } else {
+                loop->query_errors++;
+            }
+        }
+        c->head = (c->head + 1) % loop->ring_size;
+        c->pending--;
+    }
+    c->pending_queries = 0;
+}
+
+/* The connection is unusable: one failed sample for what it was doing,
+   then it is done */
+static void client_fail(db_loop_t* loop, db_client_t* c, CURLcode result) {
+    if (c->phase == CLIENT_CONNECTING) {
+        engine_record_socket_since(loop->engine, loop->plan->connect_label, c->op_start_us, result);
+        loop->connect_failures++;
+    } else if (c->phase == CLIENT_RUNNING || c->phase == CLIENT_DRAINING) {
+        client_fail_pending(loop, c, result);
+        loop->connections_lost++;
+    }
+    client_finish(loop, c);
+}
+
+static bool client_push(db_loop_t* loop, db_client_t* c, int query, bool prepare) {
+    const db_plan_t* plan = loop->plan;
+    char name[16];
+    int ok;
+    if (prepare) {
+        ok = PQsendPrepare(c->pg, statement_name(query, name, sizeof(name)), plan->options.queries[query], 0, NULL);
+    } else if (plan->options.prepared) {
+        ok = PQsendQueryPrepared(c->pg, statement_name(query, name, sizeof(name)), 0, NULL, NULL, NULL, 0);
+    } else {
+        ok = PQsendQueryParams(c->pg, plan->options.queries[query], 0, NULL, NULL, NULL, NULL, 0);
+    }
+    if (!ok || !PQpipelineSync(c->pg)) return false;
+
+    db_segment_t* seg = &c->ring[(c->head + c->pending) % loop->ring_size];
+    memset(seg, 0, sizeof(db_segment_t));
+    seg->sent_us = get_time_us();
+    seg->query = (int16_t)query;
+    seg->prepare = prepare;
+    c->pending++;
+    if (!prepare) c->pending_queries++;
+    return true;
+}
+
+static bool client_sending_done(const db_loop_t* loop, const db_client_t* c) {
+    return (c->limit > 0 && c->sent >= c->limit) || atomic_load(&loop->engine->stop_flag);
+}
+
+/* Hand libpq's buffered output to the socket; false if the connection broke */
+static bool client_flush(db_loop_t* loop, db_client_t* c) {
+    int rc = PQflush(c->pg);
+    if (rc < 0) {
+        client_fail(loop, c, CURLE_SEND_ERROR);
+        return false;
+    }
+    c->flushing = rc == 1;
+    client_watch(loop, c, c->flushing ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+    return true;
+}
+
+/* Queue the queries that are due, up to the pipeline depth, then flush */
+static void client_service(db_loop_t* loop, db_client_t* c, uint64_t now_us) {
+    const database_test_options_t* options = &loop->plan->options;
+    if (c->phase == CLIENT_RUNNING) {
+        int burst = 0;
+        while (!client_sending_done(loop, c) && c->pending_queries < options->pipeline_depth) {
+            if (loop->rate > 0.0 &&
+                c->sent >= (uint64_t)((double)(now_us - c->open_us) * loop->rate / 1e6) + 1) break;
+            if (burst == DB_SEND_BURST) {
+                loop->busy = true;
+                break;
+            }
+            if (!client_push(loop, c, c->next_query, false)) {
+                client_fail(loop, c, CURLE_SEND_ERROR);
+                return;
+            }
+            c->next_query = (c->next_query + 1) % options->num_queries;
+            c->sent++;
+            loop->queries_sent++;
+            burst++;
+        }
+        if (client_sending_done(loop, c)) {
+            client_end_sending(loop, c);
+            c->phase = CLIENT_DRAINING;
+            c->op_start_us = now_us;
+        }
+    }
+    if (c->phase == CLIENT_DRAINING && c->pending == 0) {
+        client_finish(loop, c);
+        return;
+    }
+    client_flush(loop, c);
+}
+
+/* A segment's Sync arrived: it is complete */
+static void client_on_segment(db_loop_t* loop, db_client_t* c) {
+    db_segment_t* seg = &c->ring[c->head];
+    c->head = (c->head + 1) % loop->ring_size;
+    c->pending--;
+    if (seg->prepare) {
+        if (seg->ok) loop->statements_prepared++;
+        return;
+    }
+    c->pending_queries--;
+    bool ok = seg->ok && !seg->failed;
+    engine_record_socket_since(loop->engine, loop->plan->query_labels[seg->query], seg->sent_us,
+                  ok ? CURLE_OK : CURLE_HTTP_RETURNED_ERROR);
+    if (ok) {
+        uint64_t now_us = get_time_us();
+        histogram_record(loop->latency, now_us > seg->sent_us ? now_us - seg->sent_us : 0);
+        loop->queries_ok++;
+    } else {
+        loop->query_errors++;
+    }
+}
+
+/* Read what arrived and consume the complete results */
+static void client_read(db_loop_t* loop, db_client_t* c) {
+    if (!PQconsumeInput(c->pg)) {
+        client_fail(loop, c, CURLE_RECV_ERROR);
+        return;
+    }
+    int nulls = 0;
+    while (c->pending > 0 && !PQisBusy(c->pg)) {
+        PGresult* res = PQgetResult(c->pg);
+        if (!res) {
+            /* separates one command's results from the next */
+            if (++nulls > 1) break;
+            continue;
+        }
+        nulls = 0;
+        db_segment_t* seg = &c->ring[c->head];
+        switch (PQresultStatus(res)) {
+            case PGRES_PIPELINE_SYNC:
+                client_on_segment(loop, c);
+                break;
+            case PGRES_TUPLES_OK:
+                loop->rows_returned += (uint64_t)PQntuples(res);
+                seg->ok = true;
+                break;
+            case PGRES_COMMAND_OK:
+            case PGRES_EMPTY_QUERY:
+                seg->ok = true;
+                break;
+            default:
+                seg->failed = true;
+                break;
+        }
+        PQclear(res);
+    }
+    if (PQstatus(c->pg) == CONNECTION_BAD) client_fail(loop, c, CURLE_RECV_ERROR);
+}
+
+/* Connected: enter pipeline mode and prepare every query */
+static void client_on_connected(db_loop_t* loop, db_client_t* c) {
+    const database_test_options_t* options = &loop->plan->options;
+    if (PQsetnonblocking(c->pg, 1) != 0 || !PQenterPipelineMode(c->pg)) {
+        client_fail(loop, c, CURLE_FAILED_INIT);
+        return;
+    }
+    engine_record_socket_since(loop->engine, loop->plan->connect_label, c->op_start_us, CURLE_OK);
+    loop->connected++;
+    c->phase = CLIENT_RUNNING;
+    c->open_us = get_time_us();
+    if (options->prepared) {
+        for (int q = 0; q < options->num_queries; q++) {
+            if (!client_push(loop, c, q, true)) {
+                client_fail(loop, c, CURLE_SEND_ERROR);
+                return;
+            }
+        }
+    }
+    client_service(loop, c, c->open_us);
+}
+
+/* Advance the non-blocking connect by one step */
+static void client_connect_poll(db_loop_t* loop, db_client_t* c) {
+    switch (PQconnectPoll(c->pg)) {
+        case PGRES_POLLING_OK:
+            client_on_connected(loop, c);
+            return;
+        case PGRES_POLLING_READING:
+            client_watch(loop, c, EPOLLIN);
+            break;
+        case PGRES_POLLING_WRITING:
+            client_watch(loop, c, EPOLLOUT);
+            break;
+        default:
+            client_fail(loop, c, CURLE_COULDNT_CONNECT);
+            return;
+    }
+    if (c->fd < 0) client_fail(loop, c, CURLE_COULDNT_CONNECT);
+}
+
+static void client_connect(db_loop_t* loop, db_client_t* c) {
+    static const char* const keywords[] = {"application_name", "dbname", NULL};
+    const char* values[] = {"loadspiker", loop->plan->options.connection_string, NULL};
+
+    c->phase = CLIENT_CONNECTING;
+    c->op_start_us = get_time_us();
+    c->pg = PQconnectStartParams(keywords, values, 1);
+    if (!c->pg || PQstatus(c->pg) == CONNECTION_BAD) {
+        client_fail(loop, c, CURLE_COULDNT_CONNECT);
+        return;
+    }
+    /* libpq starts out wanting to write: the socket connect is in progress */
+    client_watch(loop, c, EPOLLOUT);
+    if (c->fd < 0) client_fail(loop, c, CURLE_COULDNT_CONNECT);
+}
+
+static void client_on_event(db_loop_t* loop, db_client_t* c, uint32_t events) {
+    if (c->phase == CLIENT_DONE) return;
+    if (c->phase == CLIENT_CONNECTING) {
+        client_connect_poll(loop, c);
+        return;
+    }
+    if ((events & EPOLLOUT) && c->flushing && !client_flush(loop, c)) return;
+    /* errors and hang-ups surface through PQconsumeInput() */
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        client_read(loop, c);
+        if (c->phase == CLIENT_DONE) return;
+    }
+    client_service(loop, c, get_time_us());
+}
+
+/* Timeouts of the connect and of the oldest segment in flight */
+static void client_tick(db_loop_t* loop, db_client_t* c, uint64_t now_us, bool sweep) {
+    uint64_t timeout_us = (uint64_t)loop->plan->options.timeout_ms * 1000;
+
+    if (c->phase == CLIENT_CONNECTING) {
+        if (now_us - c->op_start_us >= timeout_us) client_fail(loop, c, CURLE_OPERATION_TIMEDOUT);
+        return;
+    }
+    if (sweep && c->pending > 0 && now_us - c->ring[c->head].sent_us >= timeout_us) {
+        /* results come back in order: everything behind it is stuck too */
+        client_fail_pending(loop, c, CURLE_OPERATION_TIMEDOUT);
+        client_finish(loop, c);
+        return;
+    }
+    client_service(loop, c, now_us);
+}
+
+static void* db_loop_thread_func(void* arg) {
+    db_loop_t* loop = (db_loop_t*)arg;
+    struct epoll_event events[DB_LOOP_MAX_EVENTS];
+    engine_place_thread(loop->engine, loop->loop_id);
+    uint64_t woke_us = 0;
+
+    for (int i = 0; i < loop->count; i++) {
+        if (atomic_load(&loop->engine->stop_flag)) {
+            client_finish(loop, &loop->clients[i]);
+        } else {
+            client_connect(loop, &loop->clients[i]);
+        }
+    }
+
+    uint64_t next_tick_us = 0;
+    while (loop->open > 0) {
+        uint64_t now_us = get_time_us();
+        if (now_us >= next_tick_us || loop->busy) {
+            bool sweep = now_us >= loop->next_sweep_us;
+            if (sweep) loop->next_sweep_us = now_us + DB_SWEEP_US;
+            loop->busy = false;
+            for (int i = 0; i < loop->count; i++) {
+                if (loop->clients[i].phase != CLIENT_DONE) client_tick(loop, &loop->clients[i], now_us, sweep);
+            }
+            if (loop->open == 0) break;
+            next_tick_us = get_time_us() + (uint64_t)(loop->rate > 0.0 ? 1 : ENGINE_LOOP_IDLE_WAIT_MS) * 1000;
+        }
+
+        int wait_ms = 0;
+        if (!loop->busy) {
+            now_us = get_time_us();
+            wait_ms = next_tick_us > now_us ? (int)((next_tick_us - now_us + 999) / 1000) : 0;
+        }
+        engine_record_loop_iteration(loop->engine, woke_us);
+        int n = epoll_wait(loop->epoll_fd, events, DB_LOOP_MAX_EVENTS, wait_ms);
+        woke_us = get_time_us();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "[LoadSpiker] Database loop %d: epoll_wait failed: %s\n", loop->loop_id, strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            client_on_event(loop, (db_client_t*)events[i].data.ptr, events[i].events);
+        }
+    }
+
+    /* The last loop out lets the controller finish without waiting a tick */
+    engine_thread_exit(loop->engine);
+    if (atomic_fetch_sub(&loop->group->running, 1) == 1) engine_wake_controller(loop->engine);
+    return NULL;
+}
+
+static void loop_destroy(db_loop_t* loop) {
+    if (loop->clients) {
+        for (int i = 0; i < loop->count; i++) {
+            if (loop->clients[i].pg) PQfinish(loop->clients[i].pg);
+            free(loop->clients[i].ring);
+        }
+        free(loop->clients);
+        loop->clients = NULL;
+    }
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+        loop->epoll_fd = -1;
+    }
+    histogram_destroy(loop->latency);
+    loop->latency = NULL;
+}
+
+static int loop_init(db_loop_t* loop, engine_t* engine, const db_plan_t* plan, int loop_id, int loop_count) {
+    const database_test_options_t* options = &plan->options;
+    loop->engine = engine;
+    loop->plan = plan;
+    loop->loop_id = loop_id;
+    loop->count = options->connections / loop_count + (loop_id < options->connections % loop_count ? 1 : 0);
+    loop->ring_size = options->pipeline_depth + (options->prepared ? options->num_queries : 0);
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->clients = calloc((size_t)loop->count, sizeof(db_client_t));
+    loop->latency = histogram_create(&engine->latency_layout);
+    if (loop->epoll_fd < 0 || !loop->clients || !loop->latency) return -1;
+
+    for (int k = 0; k < loop->count; k++) {
+        db_client_t* c = &loop->clients[k];
+        c->fd = -1;
+        c->limit = (uint64_t)options->iterations * (uint64_t)options->num_queries;
+        c->ring = calloc((size_t)loop->ring_size, sizeof(db_segment_t));
+        if (!c->ring) return -1;
+    }
+    if (options->rate > 0.0) loop->rate = options->rate / options->connections;
+    loop->open = loop->count;
+    return 0;
+}
+
+db_loop_group_t* db_loop_start(engine_t* engine, const db_plan_t* plan) {
+    if (!engine || !plan || plan->options.connections <= 0) return NULL;
+    const database_test_options_t* options = &plan->options;
+
+    int count = engine->event_loops;
+    if (count > options->connections) count = options->connections;
+    if (count <= 0) count = 1;
+    engine_raise_fd_limit(options->connections, ENGINE_FD_HEADROOM, "Database test");
+
+    db_loop_group_t* group = calloc(1, sizeof(db_loop_group_t));
+    if (!group) return NULL;
+    group->loops = calloc((size_t)count, sizeof(db_loop_t));
+    if (!group->loops) {
+        free(group);
+        return NULL;
+    }
+    group->count = count;
+    group->start_us = get_time_us();
+    atomic_store(&group->senders_left, options->connections);
+
+    /* Set every loop up before any starts, so a failure connects nothing */
+    for (int i = 0; i < count; i++) {
+        db_loop_t* loop = &group->loops[i];
+        loop->epoll_fd = -1;
+        loop->group = group;
+        if (loop_init(loop, engine, plan, i, count) != 0) {
+            fprintf(stderr, "[LoadSpiker] Database loop %d: initialisation failed\n", i);
+            for (int j = 0; j <= i; j++) loop_destroy(&group->loops[j]);
+            free(group->loops);
+            free(group);
+            return NULL;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        db_loop_t* loop = &group->loops[i];
+        atomic_fetch_add(&group->running, 1);
+        if (pthread_create(&loop->thread, NULL, db_loop_thread_func, loop) != 0) {
+            /* its connections never run: count them out so the others finish */
+            atomic_fetch_sub(&group->running, 1);
+            for (int k = 0; k < loop->count; k++) {
+                db_client_t* c = &loop->clients[k];
+                c->phase = CLIENT_CONNECTING;
+                c->op_start_us = get_time_us();
+                client_fail(loop, c, CURLE_FAILED_INIT);
+            }
+            continue;
+        }
+        loop->started = true;
+    }
+    return group;
+}
+
+bool db_loop_done(db_loop_group_t* group) {
+    return !group || atomic_load(&group->running) == 0;
+}
+
+void db_loop_join(db_loop_group_t* group, database_test_result_t* result) {
+    if (!group) return;
+
+    memset(result, 0, sizeof(database_test_result_t));
+    histogram_t* latency = NULL;
+    for (int i = 0; i < group->count; i++) {
+        db_loop_t* loop = &group->loops[i];
+        if (loop->started) pthread_join(loop->thread, NULL);
+        result->connected += loop->connected;
+        result->connect_failures += loop->connect_failures;
+        result->connections_lost += loop->connections_lost;
+        result->queries_sent += loop->queries_sent;
+        result->queries_ok += loop->queries_ok;
+        result->query_errors += loop->query_errors;
+        result->timeouts += loop->timeouts;
+        result->rows_returned += loop->rows_returned;
+        result->statements_prepared += loop->statements_prepared;
+        if (!latency) {
+            latency = loop->latency;
+            loop->latency = NULL;
+        } else if (loop->latency) {
+            histogram_add(latency, loop->latency);
+        }
+        loop_destroy(loop);
+    }
+
+    uint64_t end_us = atomic_load(&group->send_end_us);
+    if (end_us > group->start_us) result->elapsed_seconds = (double)(end_us - group->start_us) / 1e6;
+    if (result->elapsed_seconds > 0.0) {
+        result->query_rate = (double)result->queries_ok / result->elapsed_seconds;
+    }
+    if (latency) {
+        result->latency_p50_us = histogram_value_at_percentile(latency, 50.0);
+        result->latency_p90_us = histogram_value_at_percentile(latency, 90.0);
+        result->latency_p99_us = histogram_value_at_percentile(latency, 99.0);
+        result->latency_max_us = latency->max_value;
+        histogram_destroy(latency);
+    }
+
+    free(group->loops);
+    free(group);
+}
+
+#else /* !(__linux__ && LOADSPIKER_HAVE_LIBPQ) */
+
+db_loop_group_t* db_loop_start(engine_t* engine, const db_plan_t* plan) {
+    (void)engine;
+    (void)plan;
+    return NULL;
+}
+
+bool db_loop_done(db_loop_group_t* group) {
+    (void)group;
+    return true;
+}
+
+void db_loop_join(db_loop_group_t* group, database_test_result_t* result) {
+    (void)group;
+    (void)result;
+}
+
+#endif /* __linux__ && LOADSPIKER_HAVE_LIBPQ */
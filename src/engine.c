@@ -1,4 +1,5 @@
-#include "engine.h"
+#include "engine_internal.h"
+#include "placement.h"
 #include "protocols/websocket.h"
 #include "protocols/database.h"
 #include "protocols/tcp.h"
@@ -7,55 +8,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <curl/curl.h>
-#include <pthread.h>
-#include <sys/time.h>
-#include <sys/select.h>
-#include <stdatomic.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
-typedef struct {
-    char* data;
-    size_t size;
-    size_t capacity;
-} response_buffer_t;
-
-typedef struct {
-    char* data;
-    size_t size;
-    size_t capacity;
-} header_buffer_t;
-
-typedef struct worker_thread {
-    pthread_t thread;
-    engine_t* engine;
-    int thread_id;
-    bool active;
-} worker_thread_t;
-
-struct engine {
-    CURLM* multi_handle;
-    worker_thread_t* workers;
-    int num_workers;
-    int max_connections;
-    
-    pthread_mutex_t metrics_mutex;
-    metrics_t metrics;
-    
-    pthread_mutex_t queue_mutex;
-    pthread_cond_t queue_cond;
-    http_request_t* request_queue;
-    http_response_t* response_queue;
-    int queue_size;
-    int queue_head;
-    int queue_tail;
-    bool shutdown;
-    _Atomic int stop_flag;    /* cooperative cancel signal; set to 1 to stop load-test workers */
-    bool load_test_active;    /* true while a load test is running; blocks pool workers from dequeuing */
-    struct timeval test_start_time;  /* wall-clock time when load test started */
-};
-
-static size_t write_callback(void* contents, size_t size, size_t nmemb, response_buffer_t* buffer) {
+size_t engine_write_callback(void* contents, size_t size, size_t nmemb, response_buffer_t* buffer) {
     size_t total_size = size * nmemb;
     
     if (!buffer || !buffer->data || !contents) {
@@ -83,7 +49,7 @@ static size_t write_callback(void* contents, size_t size, size_t nmemb, response
     return total_size;
 }
 
-static size_t header_callback(void* contents, size_t size, size_t nmemb, header_buffer_t* buffer) {
+size_t engine_header_callback(void* contents, size_t size, size_t nmemb, header_buffer_t* buffer) {
     size_t total_size = size * nmemb;
     
     if (!buffer || !buffer->data || !contents) {
@@ -113,9 +79,6 @@ static size_t header_callback(void* contents, size_t size, size_t nmemb, header_
 
 // Removed static get_time_us as it conflicts with mqtt.h declaration
 
-// Forward declaration for update_metrics
-static void update_metrics(engine_t* engine, uint64_t response_time_us, bool success);
-
 protocol_type_t engine_detect_protocol(const char* url) {
     if (!url) return PROTOCOL_HTTP;
     
@@ -166,7 +129,7 @@ int engine_mqtt_connect(engine_t* engine, const char* broker_host, int broker_po
     response->response_time_us = end_time - start_time;
     
     // Update metrics
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     
     return result;
 }
@@ -184,7 +147,7 @@ int engine_mqtt_publish(engine_t* engine, const char* host, int port, const char
     response->response_time_us = end_time - start_time;
     
     // Update metrics
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     
     return result;
 }
@@ -202,7 +165,7 @@ int engine_mqtt_subscribe(engine_t* engine, const char* host, int port, const ch
     response->response_time_us = end_time - start_time;
     
     // Update metrics
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     
     return result;
 }
@@ -220,7 +183,7 @@ int engine_mqtt_unsubscribe(engine_t* engine, const char* broker_host, int broke
     response->response_time_us = end_time - start_time;
     
     // Update metrics
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     
     return result;
 }
@@ -238,7 +201,7 @@ int engine_mqtt_disconnect(engine_t* engine, const char* broker_host, int broker
     response->response_time_us = end_time - start_time;
     
     // Update metrics
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     
     return result;
 }
@@ -265,12 +228,7 @@ int engine_database_connect(engine_t* engine, const char* connection_string, con
     if (!engine || !connection_string || !db_type || !response) return -1;
     
     int result = database_connect(connection_string, db_type, response);
-    
-    // Update metrics for database operations
-    if (response->response_time_us > 0) {
-        update_metrics(engine, response->response_time_us, response->success);
-    }
-    
+    engine_update_metrics(engine, response->response_time_us, response->success);
     return result;
 }
 
@@ -278,12 +236,15 @@ int engine_database_query(engine_t* engine, const char* connection_string, const
     if (!engine || !connection_string || !query || !response) return -1;
     
     int result = database_execute_query(connection_string, query, response);
-    
-    // Update metrics for database operations
-    if (response->response_time_us > 0) {
-        update_metrics(engine, response->response_time_us, response->success);
-    }
-    
+    engine_update_metrics(engine, response->response_time_us, response->success);
+    return result;
+}
+
+int engine_database_disconnect(engine_t* engine, const char* connection_string, response_t* response) {
+    if (!engine || !connection_string || !response) return -1;
+
+    int result = database_disconnect(connection_string, response);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     return result;
 }
 
@@ -300,7 +261,7 @@ int engine_tcp_connect(engine_t* engine, const char* hostname, int port, int tim
     response->response_time_us = end_time - start_time;
     
     // Update metrics
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     
     return result;
 }
@@ -308,7 +269,7 @@ int engine_tcp_connect(engine_t* engine, const char* hostname, int port, int tim
 int engine_tcp_send(engine_t* engine, int socket_fd, const char* data, size_t data_len, int timeout_ms, response_t* response) {
     if (!engine || !data || !response) return -1;
     (void)data_len;   /* tcp_send() uses strlen(data) internally */
-    (void)timeout_ms; /* tcp.c uses a fixed 5-second select() timeout */
+    (void)timeout_ms; /* tcp.c uses a fixed 5-second poll() timeout */
 
     char host[256];
     int port = 0;
@@ -325,13 +286,13 @@ int engine_tcp_send(engine_t* engine, int socket_fd, const char* data, size_t da
        or an error occurs, and populates response->protocol_data.tcp.bytes_sent. */
     int result = tcp_send(host, port, data, response);
 
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     return result;
 }
 
 int engine_tcp_receive(engine_t* engine, int socket_fd, char* buffer, size_t buffer_size, int timeout_ms, response_t* response) {
     if (!engine || !buffer || !response) return -1;
-    (void)timeout_ms; /* tcp.c uses a fixed 5-second select() timeout */
+    (void)timeout_ms; /* tcp.c uses a fixed 5-second poll() timeout */
 
     char host[256];
     int port = 0;
@@ -344,7 +305,7 @@ int engine_tcp_receive(engine_t* engine, int socket_fd, char* buffer, size_t buf
         return -1;
     }
 
-    /* tcp_receive() uses SO_RCVTIMEO with 5-second select() timeout per CONTEXT.md,
+    /* tcp_receive() waits with a 5-second poll() timeout per CONTEXT.md,
        returns 0 bytes on timeout (success=true, status 204).
        Populates response->protocol_data.tcp.bytes_received with actual count. */
     int result = tcp_receive(host, port, response);
@@ -357,7 +318,7 @@ int engine_tcp_receive(engine_t* engine, int socket_fd, char* buffer, size_t buf
         buffer[copy_len] = '\0';
     }
 
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     return result;
 }
 
@@ -379,7 +340,7 @@ int engine_tcp_disconnect(engine_t* engine, int socket_fd, response_t* response)
        Pool slot remains (is_connected=false). Subsequent send/receive will fail. */
     int result = tcp_disconnect(host, port, response);
 
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     return result;
 }
 
@@ -398,7 +359,7 @@ int engine_udp_create_endpoint(engine_t* engine, const char* bind_address, int p
     response->response_time_us = end_time - start_time;
     
     // Update metrics
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     
     return result;
 }
@@ -415,7 +376,7 @@ int engine_udp_send(engine_t* engine, int socket_fd, const char* data, size_t da
     response->response_time_us = end_time - start_time;
     
     // Update metrics
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     
     return result;
 }
@@ -435,7 +396,7 @@ int engine_udp_receive(engine_t* engine, int socket_fd, char* buffer, size_t buf
         return -1;
     }
 
-    /* udp_receive() uses select() with 5s timeout; returns success=true/status 204
+    /* udp_receive() uses poll() with 5s timeout; returns success=true/status 204
        on timeout per CONTEXT.md. Populates protocol_data.udp with real byte count
        and sender info. */
     int result = udp_receive(host, port, response);
@@ -457,7 +418,7 @@ int engine_udp_receive(engine_t* engine, int socket_fd, char* buffer, size_t buf
         *sender_port = response->protocol_data.udp.sender_port;
     }
 
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     return result;
 }
 
@@ -479,7 +440,37 @@ int engine_udp_close_endpoint(engine_t* engine, int socket_fd, response_t* respo
        Pool slot remains with is_bound=false. Subsequent receive will fail. */
     int result = udp_close_endpoint(host, port, response);
 
-    update_metrics(engine, response->response_time_us, response->success);
+    engine_update_metrics(engine, response->response_time_us, response->success);
+    return result;
+}
+
+int engine_udp_send_batch(engine_t* engine, int socket_fd, const udp_datagram_t* datagrams, int count,
+                          const char* dest_address, int dest_port, response_t* response) {
+    if (!engine || !datagrams || count <= 0 || !dest_address || !response) return -1;
+    (void)socket_fd;  /* endpoints are keyed by destination, as in engine_udp_send() */
+
+    int result = udp_send_batch(dest_address, dest_port, datagrams, count, response);
+    engine_update_metrics(engine, response->response_time_us, response->success);
+    return result;
+}
+
+int engine_udp_receive_batch(engine_t* engine, int socket_fd, udp_message_t* messages, int count,
+                             int timeout_ms, response_t* response) {
+    if (!engine || !messages || count <= 0 || timeout_ms < 0 || !response) return -1;
+
+    char host[256];
+    int port = 0;
+    if (udp_lookup_by_fd(socket_fd, host, &port) < 0) {
+        memset(response, 0, sizeof(response_t));
+        response->protocol = PROTOCOL_UDP;
+        response->success = false;
+        response->status_code = 400;
+        strcpy(response->error_message, "socket_fd not found in UDP pool");
+        return -1;
+    }
+
+    int result = udp_receive_batch(host, port, messages, count, timeout_ms, response);
+    engine_update_metrics(engine, response->response_time_us, response->success);
     return result;
 }
 
@@ -498,384 +489,1282 @@ int engine_convert_http_response(const response_t* generic_resp, http_response_t
     return 0;
 }
 
-static void update_metrics(engine_t* engine, uint64_t response_time_us, bool success) {
-    if (!engine) return;
-    
-    pthread_mutex_lock(&engine->metrics_mutex);
-    
-    engine->metrics.total_requests++;
-    if (success) {
-        engine->metrics.successful_requests++;
-    } else {
-        engine->metrics.failed_requests++;
-    }
-    
-    engine->metrics.total_response_time_us += response_time_us;
-    
-    if (engine->metrics.min_response_time_us == 0 || response_time_us < engine->metrics.min_response_time_us) {
-        engine->metrics.min_response_time_us = response_time_us;
+/* Shard of the calling thread. An engine thread takes the first free shard
+   in engine_place_thread() and hands it back in engine_thread_exit(); any
+   other thread is given one of the ENGINE_METRIC_SHARDS spares at the end
+   round-robin on its first sample. The epoch keeps a thread from reusing
+   the index it had in an engine since destroyed. */
+static atomic_uint_fast64_t metric_epoch_counter;
+static _Thread_local uint64_t metric_shard_epoch;
+static _Thread_local int metric_shard_index;
+static _Thread_local bool metric_shard_owned;
+
+static void metric_shard_share(engine_t* engine, int first, int count) {
+    unsigned next = atomic_fetch_add_explicit(&engine->next_shared_shard, 1, memory_order_relaxed);
+    metric_shard_epoch = engine->metric_epoch;
+    metric_shard_index = first + (int)(next % (unsigned)count);
+    metric_shard_owned = false;
+}
+
+static metrics_shard_t* metrics_local_shard(engine_t* engine) {
+    if (metric_shard_epoch != engine->metric_epoch) {
+        metric_shard_share(engine, engine->metric_shard_count - ENGINE_METRIC_SHARDS, ENGINE_METRIC_SHARDS);
     }
-    
-    if (response_time_us > engine->metrics.max_response_time_us) {
-        engine->metrics.max_response_time_us = response_time_us;
+    return &engine->metric_shards[metric_shard_index];
+}
+
+/* The first free shard, else (more live threads than shards) one shared
+   round-robin with the others */
+static void metric_shard_take(engine_t* engine) {
+    for (int i = 0; i < engine->metric_shard_count; i++) {
+        bool taken = false;
+        if (!atomic_load_explicit(&engine->shard_taken[i], memory_order_relaxed) &&
+            atomic_compare_exchange_strong(&engine->shard_taken[i], &taken, true)) {
+            metric_shard_epoch = engine->metric_epoch;
+            metric_shard_index = i;
+            metric_shard_owned = true;
+            return;
+        }
     }
+    metric_shard_share(engine, 0, engine->metric_shard_count);
+}
 
-    /* Insert into histogram (O(1)) */
-    size_t bucket = response_time_us / 1000;  /* 1ms buckets */
-    if (bucket >= HISTOGRAM_BUCKET_COUNT) {
-        bucket = HISTOGRAM_OVERFLOW_INDEX;
+static void metric_shard_return(engine_t* engine) {
+    if (metric_shard_owned && metric_shard_epoch == engine->metric_epoch) {
+        atomic_store(&engine->shard_taken[metric_shard_index], false);
     }
-    engine->metrics.histogram_buckets[bucket]++;
+    metric_shard_owned = false;
+    metric_shard_epoch = 0;
+}
+
+/* CPU accounting of the calling back-end thread, from engine_place_thread() */
+static _Thread_local uint64_t thread_cpu_start_ns;
+static _Thread_local uint64_t thread_wall_start_us;
 
-    pthread_mutex_unlock(&engine->metrics_mutex);
+#define ENGINE_THREAD_MIN_US 50000   /* shorter-lived threads are not measured: too coarse */
+
+static uint64_t thread_cpu_ns(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
 
-static void* worker_thread_func(void* arg) {
-    worker_thread_t* worker = (worker_thread_t*)arg;
-    if (!worker || !worker->engine) {
-        return NULL;
+static uint64_t process_cpu_us(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (uint64_t)usage.ru_utime.tv_sec * 1000000 + (uint64_t)usage.ru_utime.tv_usec +
+           (uint64_t)usage.ru_stime.tv_sec * 1000000 + (uint64_t)usage.ru_stime.tv_usec;
+}
+
+void engine_place_thread(engine_t* engine, int index) {
+    thread_cpu_start_ns = thread_cpu_ns();
+    thread_wall_start_us = get_time_us();
+    if (engine->cpu_count == 0 || index < 0) {
+        metric_shard_take(engine);
+        return;
     }
-    
-    engine_t* engine = worker->engine;
-    
-    while (worker->active) {
-        pthread_mutex_lock(&engine->queue_mutex);
-        
-        while ((engine->queue_head == engine->queue_tail || engine->load_test_active) && !engine->shutdown) {
-            pthread_cond_wait(&engine->queue_cond, &engine->queue_mutex);
-        }
-        
-        if (engine->shutdown) {
-            pthread_mutex_unlock(&engine->queue_mutex);
-            break;
-        }
-        
-        http_request_t request = engine->request_queue[engine->queue_head];
-        engine->queue_head = (engine->queue_head + 1) % engine->queue_size;
-        
-        pthread_mutex_unlock(&engine->queue_mutex);
-        
-        CURL* curl = curl_easy_init();
-        if (!curl) continue;
-        
-        response_buffer_t buffer = {0};
-        buffer.data = malloc(MAX_BODY_LENGTH);
-        if (!buffer.data) {
-            curl_easy_cleanup(curl);
-            continue;
-        }
-        buffer.capacity = MAX_BODY_LENGTH;
-        buffer.data[0] = '\0'; // Initialize as empty string
-        
-        header_buffer_t headers = {0};
-        headers.data = malloc(MAX_HEADER_LENGTH);
-        if (!headers.data) {
-            free(buffer.data);
-            curl_easy_cleanup(curl);
-            continue;
-        }
-        headers.capacity = MAX_HEADER_LENGTH;
-        headers.data[0] = '\0'; // Initialize as empty string
-        
-        uint64_t start_time = get_time_us();
-        
-        curl_easy_setopt(curl, CURLOPT_URL, request.url);
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request.method);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
-        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
-        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &headers);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, request.timeout_ms);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
-        
-        if (strlen(request.body) > 0) {
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body);
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, strlen(request.body));
-        }
-        
-        struct curl_slist* header_list = NULL;
-        if (strlen(request.headers) > 0) {
-            char* header_copy = strdup(request.headers);
-            if (header_copy) {
-                char* token = strtok(header_copy, "\n");
-                while (token) {
-                    header_list = curl_slist_append(header_list, token);
-                    token = strtok(NULL, "\n");
-                }
-                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
-                free(header_copy);
-            }
-        }
-        
-        CURLcode res = curl_easy_perform(curl);
-        uint64_t end_time = get_time_us();
-        uint64_t response_time = end_time - start_time;
-        
-        long response_code = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-        
-        bool success = (res == CURLE_OK && response_code >= 200 && response_code < 400);
-        update_metrics(engine, response_time, success);
-        
-        if (header_list) {
-            curl_slist_free_all(header_list);
+    int slot = index % engine->cpu_count;
+    if (placement_pin_thread(engine->cpus[slot]) != 0) {
+        bool warned = false;
+        if (atomic_compare_exchange_strong(&engine->pin_warned, &warned, true)) {
+            fprintf(stderr, "[LoadSpiker] Cannot pin threads to CPU %d, running them unpinned\n", engine->cpus[slot]);
         }
-        curl_easy_cleanup(curl);
-        free(buffer.data);
-        free(headers.data);
+        metric_shard_take(engine);
+        return;
     }
-    
-    return NULL;
+    /* Threads sharing a CPU never run at once; they share its shard, which
+       lives on the CPU's node */
+    metric_shard_epoch = engine->metric_epoch;
+    metric_shard_index = engine->cpu_shards[slot];
+    metric_shard_owned = false;
 }
 
-engine_t* engine_create(int max_connections, int worker_threads) {
-    if (max_connections <= 0 || worker_threads <= 0) {
-        return NULL;
-    }
-    
-    engine_t* engine = malloc(sizeof(engine_t));
-    if (!engine) return NULL;
-    
-    memset(engine, 0, sizeof(engine_t));
-    
-    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
-        free(engine);
-        return NULL;
-    }
-    
-    engine->multi_handle = curl_multi_init();
-    if (!engine->multi_handle) {
-        curl_global_cleanup();
-        free(engine);
-        return NULL;
-    }
-    
-    engine->max_connections = max_connections;
-    engine->num_workers = worker_threads;
-    
-    if (pthread_mutex_init(&engine->metrics_mutex, NULL) != 0 ||
-        pthread_mutex_init(&engine->queue_mutex, NULL) != 0 ||
-        pthread_cond_init(&engine->queue_cond, NULL) != 0) {
-        curl_multi_cleanup(engine->multi_handle);
-        curl_global_cleanup();
-        free(engine);
-        return NULL;
+void engine_thread_exit(engine_t* engine) {
+    if (engine) metric_shard_return(engine);
+    if (!engine || thread_wall_start_us == 0) return;
+    uint64_t wall_us = get_time_us() - thread_wall_start_us;
+    thread_wall_start_us = 0;
+    if (wall_us < ENGINE_THREAD_MIN_US) return;
+
+    uint64_t cpu_us = (thread_cpu_ns() - thread_cpu_start_ns) / 1000;
+    uint64_t busy_ppm = cpu_us * 1000000 / wall_us;
+    if (busy_ppm > 1000000) busy_ppm = 1000000;
+    atomic_fetch_add_explicit(&engine->threads_measured, 1, memory_order_relaxed);
+    uint64_t cur = atomic_load_explicit(&engine->max_thread_busy_ppm, memory_order_relaxed);
+    while (busy_ppm > cur &&
+           !atomic_compare_exchange_weak_explicit(&engine->max_thread_busy_ppm, &cur, busy_ppm,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
     }
-    
-    engine->queue_size = max_connections * 2;
-    engine->request_queue = malloc(sizeof(http_request_t) * engine->queue_size);
-    engine->response_queue = malloc(sizeof(http_response_t) * engine->queue_size);
-    engine->workers = malloc(sizeof(worker_thread_t) * worker_threads);
-    
-    if (!engine->request_queue || !engine->response_queue || !engine->workers) {
-        free(engine->request_queue);
-        free(engine->response_queue);
-        free(engine->workers);
-        pthread_mutex_destroy(&engine->metrics_mutex);
-        pthread_mutex_destroy(&engine->queue_mutex);
-        pthread_cond_destroy(&engine->queue_cond);
-        curl_multi_cleanup(engine->multi_handle);
-        curl_global_cleanup();
-        free(engine);
-        return NULL;
+}
+
+void engine_place_memory(engine_t* engine, int index, void* addr, size_t len) {
+    if (engine->cpu_count == 0 || index < 0) return;
+    int node = engine->cpu_nodes[index % engine->cpu_count];
+    if (node >= 0) placement_bind_node(addr, len, node);
+}
+
+/* The CPU list, each CPU's node and shard, and the source interfaces */
+static void engine_placement_init(engine_t* engine, const engine_config_t* config) {
+    engine->cpu_count = config->cpu_count;
+    for (int i = 0; i < config->cpu_count; i++) {
+        engine->cpus[i] = config->cpus[i];
+        engine->cpu_nodes[i] = config->numa_local ? placement_cpu_node(config->cpus[i]) : -1;
     }
-    
-    for (int i = 0; i < worker_threads; i++) {
-        engine->workers[i].engine = engine;
-        engine->workers[i].thread_id = i;
-        engine->workers[i].active = true;
-        if (pthread_create(&engine->workers[i].thread, NULL, worker_thread_func, &engine->workers[i]) != 0) {
-            // Clean up on thread creation failure
-            engine->workers[i].active = false;
-            for (int j = 0; j < i; j++) {
-                engine->workers[j].active = false;
-                pthread_join(engine->workers[j].thread, NULL);
+    /* The first metric_shard_count CPUs get a shard each; the rest share
+       one of an earlier CPU on the same node */
+    int shards = engine->metric_shard_count;
+    for (int i = 0; i < engine->cpu_count; i++) {
+        int shard = i % shards;
+        for (int k = 0; i >= shards && k < shards; k++) {
+            int candidate = (i + k) % shards;
+            if (engine->cpu_nodes[candidate] == engine->cpu_nodes[i]) {
+                shard = candidate;
+                break;
             }
-            free(engine->request_queue);
-            free(engine->response_queue);
-            free(engine->workers);
-            pthread_mutex_destroy(&engine->metrics_mutex);
-            pthread_mutex_destroy(&engine->queue_mutex);
-            pthread_cond_destroy(&engine->queue_cond);
-            curl_multi_cleanup(engine->multi_handle);
-            curl_global_cleanup();
-            free(engine);
-            return NULL;
         }
+        engine->cpu_shards[i] = shard;
     }
-    
-    return engine;
+
+    engine->source_address_count = config->source_address_count;
+    for (int i = 0; i < config->source_address_count; i++) {
+        snprintf(engine->source_interfaces[i], sizeof(engine->source_interfaces[i]), "host!%s",
+                 config->source_addresses[i]);
+    }
+    engine->source_port_min = config->source_port_min;
+    engine->source_port_max = config->source_port_max;
 }
 
-void engine_destroy(engine_t* engine) {
-    if (!engine) return;
-    
-    engine->shutdown = true;
-    pthread_cond_broadcast(&engine->queue_cond);
-    
-    for (int i = 0; i < engine->num_workers; i++) {
-        engine->workers[i].active = false;
-        pthread_join(engine->workers[i].thread, NULL);
+/* Move each pinned CPU's shard and its counts blocks to the CPU's node */
+static void metric_shards_place(engine_t* engine) {
+    int count = engine->cpu_count < engine->metric_shard_count ? engine->cpu_count : engine->metric_shard_count;
+    for (int s = 0; s < count; s++) {
+        int node = engine->cpu_nodes[s];
+        if (node < 0) continue;
+        metrics_shard_t* shard = &engine->metric_shards[s];
+        placement_bind_node(shard, sizeof(*shard), node);
+        size_t counts_len = (size_t)(shard->queue_delay_counts - shard->latency_counts) * 2;
+        placement_bind_node(shard->latency_counts, counts_len * sizeof(uint64_t), node);
     }
-    
-    // Clean up all protocol connection pools
-    tcp_cleanup_all();
-    udp_cleanup_all();
-    mqtt_cleanup_all();
-    websocket_cleanup_all();
-    database_cleanup_all();
-    
-    curl_multi_cleanup(engine->multi_handle);
-    curl_global_cleanup();
-    
-    pthread_mutex_destroy(&engine->metrics_mutex);
-    pthread_mutex_destroy(&engine->queue_mutex);
-    pthread_cond_destroy(&engine->queue_cond);
-    
-    free(engine->workers);
-    free(engine->request_queue);
-    free(engine->response_queue);
-    free(engine);
 }
 
-int engine_execute_request_sync(engine_t* engine, const http_request_t* request, http_response_t* response) {
-    if (!engine || !request || !response) return -1;
-    
-    // Initialize response structure
-    memset(response, 0, sizeof(http_response_t));
-    
-    CURL* curl = curl_easy_init();
-    if (!curl) return -1;
-    
-    response_buffer_t buffer = {0};
-    buffer.data = malloc(MAX_BODY_LENGTH);
-    if (!buffer.data) {
-        curl_easy_cleanup(curl);
+static bool source_address_valid(const char* address) {
+    unsigned char parsed[sizeof(struct in6_addr)];
+    return inet_pton(AF_INET, address, parsed) == 1 || inet_pton(AF_INET6, address, parsed) == 1;
+}
+
+/* A shard per pool worker and loop thread plus the spares, and a latency
+   and a queue-delay counts block per shard, each starting on its own cache
+   line so neighbouring blocks never share a line. */
+static int metric_shards_create(engine_t* engine) {
+    int count = engine->num_workers + engine->event_loops + ENGINE_METRIC_SHARDS;
+    void* shards = NULL;
+    if (posix_memalign(&shards, ENGINE_CACHE_LINE, sizeof(metrics_shard_t) * (size_t)count) != 0) {
         return -1;
     }
-    buffer.capacity = MAX_BODY_LENGTH;
-    buffer.data[0] = '\0'; // Initialize as empty string
-    
-    header_buffer_t headers = {0};
-    headers.data = malloc(MAX_HEADER_LENGTH);
-    if (!headers.data) {
-        free(buffer.data);
-        curl_easy_cleanup(curl);
+    memset(shards, 0, sizeof(metrics_shard_t) * (size_t)count);
+
+    size_t per_line = ENGINE_CACHE_LINE / sizeof(uint64_t);
+    size_t stride = ((size_t)engine->latency_layout.counts_len + per_line - 1) / per_line * per_line;
+    void* counts = NULL;
+    size_t blocks = 2 * (size_t)count;
+    if (posix_memalign(&counts, ENGINE_CACHE_LINE, stride * sizeof(uint64_t) * blocks) != 0) {
+        free(shards);
         return -1;
     }
-    headers.capacity = MAX_HEADER_LENGTH;
-    headers.data[0] = '\0'; // Initialize as empty string
-    
-    uint64_t start_time = get_time_us();
-    
-    curl_easy_setopt(curl, CURLOPT_URL, request->url);
-    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request->method);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
-    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
-    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &headers);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, request->timeout_ms);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
-    
-    if (strlen(request->body) > 0) {
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request->body);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, strlen(request->body));
+    memset(counts, 0, stride * sizeof(uint64_t) * blocks);
+    engine->shard_taken = calloc((size_t)count, sizeof(_Atomic bool));
+    if (!engine->shard_taken) {
+        free(shards);
+        free(counts);
+        return -1;
     }
-    
-    struct curl_slist* header_list = NULL;
-    if (strlen(request->headers) > 0) {
-        char* header_copy = strdup(request->headers);
-        if (header_copy) {
-            char* token = strtok(header_copy, "\n");
-            while (token) {
-                header_list = curl_slist_append(header_list, token);
-                token = strtok(NULL, "\n");
-            }
-            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
-            free(header_copy);
+
+    engine->metric_shards = (metrics_shard_t*)shards;
+    engine->metric_shard_count = count;
+    engine->metric_epoch = atomic_fetch_add(&metric_epoch_counter, 1) + 1;
+    engine->latency_counts = (_Atomic uint64_t*)counts;
+    for (int i = 0; i < count; i++) {
+        engine->metric_shards[i].latency_counts = engine->latency_counts + stride * (size_t)(2 * i);
+        engine->metric_shards[i].queue_delay_counts = engine->latency_counts + stride * (size_t)(2 * i + 1);
+    }
+    return 0;
+}
+
+static int metrics_windows_create(engine_t* engine, const engine_config_t* config) {
+    if (config->metrics_window_ms <= 0) return 0;
+
+    engine->window_interval_us = (uint64_t)config->metrics_window_ms * 1000;
+    engine->windows = metrics_ring_create(&engine->latency_layout, config->metrics_window_capacity);
+    engine->window_base_counts = histogram_create(&engine->latency_layout);
+    engine->window_now_counts = histogram_create(&engine->latency_layout);
+    engine->window_counts = histogram_create(&engine->latency_layout);
+    if (!engine->windows || !engine->window_base_counts || !engine->window_now_counts || !engine->window_counts) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Label names and the per-shard label and series histograms allocated on
+   first sample */
+static void metric_labels_free(engine_t* engine) {
+    for (int i = 0; i < engine->label_count; i++) {
+        free(engine->label_names[i]);
+        engine->label_names[i] = NULL;
+    }
+    engine->label_count = 0;
+    if (!engine->metric_shards) return;
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        for (int l = 0; l < ENGINE_MAX_LABELS; l++) {
+            free(atomic_load_explicit(&engine->metric_shards[s].labels[l].latency_counts, memory_order_relaxed));
+        }
+        for (int k = 0; k < ENGINE_SERIES; k++) {
+            free(atomic_load_explicit(&engine->metric_shards[s].series[k].counts, memory_order_relaxed));
         }
     }
+}
+
+static void metrics_windows_free(engine_t* engine) {
+    metrics_ring_destroy(engine->windows);
+    histogram_destroy(engine->window_base_counts);
+    histogram_destroy(engine->window_now_counts);
+    histogram_destroy(engine->window_counts);
+    engine->windows = NULL;
+    engine->window_base_counts = NULL;
+    engine->window_now_counts = NULL;
+    engine->window_counts = NULL;
+}
+
+void engine_update_metrics(engine_t* engine, uint64_t response_time_us, bool success) {
+    if (!engine) return;
     
-    CURLcode res = curl_easy_perform(curl);
-    uint64_t end_time = get_time_us();
-    uint64_t response_time = end_time - start_time;
-    
-    long response_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-    
-    // Fill response structure safely
-    response->status_code = response_code;
-    response->response_time_us = response_time;
-    response->success = (res == CURLE_OK && response_code >= 200 && response_code < 400);
+    metrics_shard_t* shard = metrics_local_shard(engine);
     
-    // Copy response body safely
-    if (buffer.data && buffer.size > 0) {
-        size_t copy_size = (buffer.size < MAX_BODY_LENGTH - 1) ? buffer.size : MAX_BODY_LENGTH - 1;
-        memcpy(response->body, buffer.data, copy_size);
-        response->body[copy_size] = '\0';
+    atomic_fetch_add_explicit(&shard->total_requests, 1, memory_order_relaxed);
+    if (success) {
+        atomic_fetch_add_explicit(&shard->successful_requests, 1, memory_order_relaxed);
     } else {
-        response->body[0] = '\0';
+        atomic_fetch_add_explicit(&shard->failed_requests, 1, memory_order_relaxed);
     }
     
-    // Copy response headers safely
-    if (headers.data && headers.size > 0) {
-        size_t copy_size = (headers.size < MAX_HEADER_LENGTH - 1) ? headers.size : MAX_HEADER_LENGTH - 1;
-        memcpy(response->headers, headers.data, copy_size);
-        response->headers[copy_size] = '\0';
-    } else {
-        response->headers[0] = '\0';
-    }
+    atomic_fetch_add_explicit(&shard->total_response_time_us, response_time_us, memory_order_relaxed);
     
-    // Copy error message if there was an error
-    if (res != CURLE_OK) {
-        const char* error_str = curl_easy_strerror(res);
-        strncpy(response->error_message, error_str, sizeof(response->error_message) - 1);
-        response->error_message[sizeof(response->error_message) - 1] = '\0';
-    } else {
-        response->error_message[0] = '\0';
+    uint64_t cur = atomic_load_explicit(&shard->min_response_time_us, memory_order_relaxed);
+    while ((cur == 0 || response_time_us < cur) &&
+           !atomic_compare_exchange_weak_explicit(&shard->min_response_time_us, &cur, response_time_us,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
     }
     
-    // Update metrics
-    update_metrics(engine, response_time, response->success);
-    
-    if (header_list) {
-        curl_slist_free_all(header_list);
+    cur = atomic_load_explicit(&shard->max_response_time_us, memory_order_relaxed);
+    while (response_time_us > cur &&
+           !atomic_compare_exchange_weak_explicit(&shard->max_response_time_us, &cur, response_time_us,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
     }
-    curl_easy_cleanup(curl);
-    free(buffer.data);
-    free(headers.data);
-    
-    return 0;
+
+    /* Insert into histogram (O(1)) */
+    int index = histogram_counts_index(&engine->latency_layout, response_time_us);
+    atomic_fetch_add_explicit(&shard->latency_counts[index], 1, memory_order_relaxed);
 }
 
-int engine_execute_request(engine_t* engine, const http_request_t* request, http_response_t* response) {
-    if (!engine || !request || !response) return -1;
-    
-    pthread_mutex_lock(&engine->queue_mutex);
-    
-    int next_tail = (engine->queue_tail + 1) % engine->queue_size;
-    if (next_tail == engine->queue_head) {
-        pthread_mutex_unlock(&engine->queue_mutex);
-        return -1; // Queue full
+/* First sample of a label (or series) in this shard: publish its counts
+   block. A racing writer on a shared shard may allocate too; the loser
+   frees its copy. */
+static _Atomic uint64_t* shard_lazy_counts(engine_t* engine, _Atomic(_Atomic uint64_t*)* slot) {
+    _Atomic uint64_t* counts = atomic_load_explicit(slot, memory_order_acquire);
+    if (counts) return counts;
+
+    _Atomic uint64_t* fresh = calloc((size_t)engine->latency_layout.counts_len, sizeof(uint64_t));
+    if (!fresh) return NULL;
+    if (!atomic_compare_exchange_strong_explicit(slot, &counts, fresh,
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+        free(fresh);
+        return counts;
     }
-    
-    // Safe copy of request structure
-    memcpy(&engine->request_queue[engine->queue_tail], request, sizeof(http_request_t));
-    engine->queue_tail = next_tail;
-    
-    pthread_cond_signal(&engine->queue_cond);
-    pthread_mutex_unlock(&engine->queue_mutex);
-    
-    return 0;
+    return fresh;
 }
 
-void engine_get_metrics(engine_t* engine, metrics_t* metrics) {
-    if (!engine || !metrics) return;
+/* Shard, label and error accounting shared by HTTP and socket results;
+   status_code < 0 leaves the status breakdown alone */
+static void engine_record_result(engine_t* engine, int label, uint64_t response_time_us, bool success,
+                                 long status_code, CURLcode result) {
+    engine_update_metrics(engine, response_time_us, success);
 
-    pthread_mutex_lock(&engine->metrics_mutex);
-    memcpy(metrics, &engine->metrics, sizeof(metrics_t));
+    metrics_shard_t* shard = metrics_local_shard(engine);
+    if (status_code >= 0) {
+        if (status_code >= ENGINE_STATUS_CODES) status_code = 0;
+        atomic_fetch_add_explicit(&shard->status_counts[status_code], 1, memory_order_relaxed);
+    }
+    if (result != CURLE_OK && (int)result < ENGINE_ERROR_CODES) {
+        atomic_fetch_add_explicit(&shard->error_counts[result], 1, memory_order_relaxed);
+    }
+
+    if (label < 0 || label >= ENGINE_MAX_LABELS) return;
+    label_shard_t* stats = &shard->labels[label];
+    atomic_fetch_add_explicit(&stats->total_requests, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(success ? &stats->successful_requests : &stats->failed_requests, 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->total_response_time_us, response_time_us, memory_order_relaxed);
+    if (status_code >= 0) {
+        atomic_fetch_add_explicit(&stats->status_classes[status_code / 100], 1, memory_order_relaxed);
+    }
+
+    uint64_t cur = atomic_load_explicit(&stats->max_response_time_us, memory_order_relaxed);
+    while (response_time_us > cur &&
+           !atomic_compare_exchange_weak_explicit(&stats->max_response_time_us, &cur, response_time_us,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    _Atomic uint64_t* counts = shard_lazy_counts(engine, &stats->latency_counts);
+    if (counts) {
+        int index = histogram_counts_index(&engine->latency_layout, response_time_us);
+        atomic_fetch_add_explicit(&counts[index], 1, memory_order_relaxed);
+    }
+}
+
+void engine_record_http_result(engine_t* engine, int label, uint64_t response_time_us,
+                               long status_code, CURLcode result) {
+    engine_record_checked_result(engine, label, response_time_us, status_code, result, NULL);
+}
+
+void engine_record_checked_result(engine_t* engine, int label, uint64_t response_time_us,
+                                  long status_code, CURLcode result, const response_match_t* match) {
+    if (!engine) return;
+
+    bool success = (result == CURLE_OK && status_code >= 200 && status_code < 400);
+    /* Only responses are checked; a transfer that failed has already failed */
+    if (match && match->count > 0 && result == CURLE_OK) {
+        uint32_t failed = response_match_finish(match, status_code, response_time_us);
+        metrics_shard_t* shard = metrics_local_shard(engine);
+        atomic_fetch_add_explicit(&shard->assertion_checks, 1, memory_order_relaxed);
+        if (failed) success = false;
+        while (failed) {
+            int i = __builtin_ctz(failed);
+            failed &= failed - 1;
+            atomic_fetch_add_explicit(&shard->assertion_failures[i], 1, memory_order_relaxed);
+        }
+    }
+    if (status_code < 0) status_code = 0;
+    engine_record_result(engine, label, response_time_us, success, status_code, result);
+}
+
+void engine_record_socket_result(engine_t* engine, int label, uint64_t response_time_us, CURLcode result) {
+    if (!engine) return;
+
+    engine_record_result(engine, label, response_time_us, result == CURLE_OK, -1, result);
+}
+
+void engine_record_socket_since(engine_t* engine, int label, uint64_t start_us, CURLcode result) {
+    uint64_t now_us = get_time_us();
+    engine_record_socket_result(engine, label, now_us > start_us ? now_us - start_us : 0, result);
+}
+
+void engine_raise_fd_limit(int connections, int headroom, const char* what) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+    rlim_t want = (rlim_t)connections + (rlim_t)headroom;
+    if (limit.rlim_cur >= want) return;
+    limit.rlim_cur = limit.rlim_max != RLIM_INFINITY && limit.rlim_max < want ? limit.rlim_max : want;
+    if (setrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur < want) {
+        fprintf(stderr, "[LoadSpiker] %s: open file limit %llu is too low for %d connections\n",
+                what, (unsigned long long)limit.rlim_cur, connections);
+    }
+}
+
+#ifdef __linux__
+void engine_loop_watch(int epoll_fd, int fd, void* ptr, uint32_t* registered, uint32_t events) {
+    if (*registered == events) return;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = ptr;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    *registered = events;
+}
+#endif
+
+bool out_buffer_reserve(out_buffer_t* out, size_t need) {
+    if (out->off > 0 && out->off == out->len) out->off = out->len = 0;
+    if (out->cap - out->len >= need) return true;
+    if (out->off > 0) {
+        memmove(out->data, out->data + out->off, out->len - out->off);
+        out->len -= out->off;
+        out->off = 0;
+        if (out->cap - out->len >= need) return true;
+    }
+    size_t cap = out->cap ? out->cap : 4096;
+    while (cap - out->len < need) cap *= 2;
+    char* data = realloc(out->data, cap);
+    if (!data) return false;
+    out->data = data;
+    out->cap = cap;
+    return true;
+}
+
+#ifdef __linux__
+ssize_t out_buffer_send(out_buffer_t* out, int fd) {
+    ssize_t total = 0;
+    while (out->off < out->len) {
+        ssize_t n = send(fd, out->data + out->off, out->len - out->off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0) return -1;
+        out->off += (size_t)n;
+        total += n;
+    }
+    if (out->off == out->len) out->off = out->len = 0;
+    return total;
+}
+#endif
+
+void out_buffer_free(out_buffer_t* out) {
+    free(out->data);
+    out->data = NULL;
+    out->off = out->len = out->cap = 0;
+}
+
+void engine_count_failure(engine_t* engine) {
+    if (!engine) return;
+    
+    atomic_fetch_add_explicit(&metrics_local_shard(engine)->failed_requests, 1, memory_order_relaxed);
+}
+
+void engine_record_queue_delay(engine_t* engine, uint64_t delay_us) {
+    if (!engine) return;
+
+    metrics_shard_t* shard = metrics_local_shard(engine);
+    uint64_t cur = atomic_load_explicit(&shard->max_queue_delay_us, memory_order_relaxed);
+    while (delay_us > cur &&
+           !atomic_compare_exchange_weak_explicit(&shard->max_queue_delay_us, &cur, delay_us,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    int index = histogram_counts_index(&engine->latency_layout, delay_us);
+    atomic_fetch_add_explicit(&shard->queue_delay_counts[index], 1, memory_order_relaxed);
+}
+
+void engine_record_series(engine_t* engine, engine_series_t series, uint64_t value_us) {
+    if (!engine || (unsigned)series >= ENGINE_SERIES) return;
+
+    series_shard_t* stats = &metrics_local_shard(engine)->series[series];
+    atomic_fetch_add_explicit(&stats->total_us, value_us, memory_order_relaxed);
+    uint64_t cur = atomic_load_explicit(&stats->max_us, memory_order_relaxed);
+    while (value_us > cur &&
+           !atomic_compare_exchange_weak_explicit(&stats->max_us, &cur, value_us,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    _Atomic uint64_t* counts = shard_lazy_counts(engine, &stats->counts);
+    if (counts) {
+        int index = histogram_counts_index(&engine->latency_layout, value_us);
+        atomic_fetch_add_explicit(&counts[index], 1, memory_order_relaxed);
+    }
+}
+
+/* libcurl's timings are cumulative from the start of the transfer:
+   namelookup <= connect <= appconnect <= pretransfer <= starttransfer <= total.
+   A reused connection reports 0 for the first three. */
+void engine_record_phases(engine_t* engine, CURL* curl) {
+#if LIBCURL_VERSION_NUM >= 0x073d00  /* the *_TIME_T timings need libcurl 7.61.0 */
+    if (!engine || !curl) return;
+
+    curl_off_t namelookup = 0, connect = 0, appconnect = 0, pretransfer = 0, starttransfer = 0, total = 0;
+    long connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+
+    long version = 0;
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version);
+    int slot = version == CURL_HTTP_VERSION_1_0 ? ENGINE_HTTP_1_0
+             : version == CURL_HTTP_VERSION_1_1 ? ENGINE_HTTP_1_1
+             : version == CURL_HTTP_VERSION_2_0 ? ENGINE_HTTP_2
+#if LIBCURL_VERSION_NUM >= 0x074200  /* CURL_HTTP_VERSION_3 needs libcurl 7.66.0 */
+             : version == CURL_HTTP_VERSION_3 ? ENGINE_HTTP_3
+#endif
+             : -1;
+    metrics_shard_t* shard = metrics_local_shard(engine);
+    if (slot >= 0) atomic_fetch_add_explicit(&shard->http_versions[slot], 1, memory_order_relaxed);
+    if (connects > 0) atomic_fetch_add_explicit(&shard->connections_opened, (uint64_t)connects, memory_order_relaxed);
+
+    if (connects > 0 && connect > 0) {
+        engine_record_series(engine, (engine_series_t)ENGINE_PHASE_DNS, (uint64_t)namelookup);
+        engine_record_series(engine, (engine_series_t)ENGINE_PHASE_CONNECT,
+                             connect > namelookup ? (uint64_t)(connect - namelookup) : 0);
+        if (appconnect > 0) {
+            engine_record_series(engine, (engine_series_t)ENGINE_PHASE_TLS,
+                                 appconnect > connect ? (uint64_t)(appconnect - connect) : 0);
+        }
+    }
+    if (starttransfer > 0) {
+        engine_record_series(engine, (engine_series_t)ENGINE_PHASE_TTFB,
+                             starttransfer > pretransfer ? (uint64_t)(starttransfer - pretransfer) : 0);
+        engine_record_series(engine, (engine_series_t)ENGINE_PHASE_TRANSFER,
+                             total > starttransfer ? (uint64_t)(total - starttransfer) : 0);
+    }
+#else
+    (void)engine;
+    (void)curl;
+#endif
+}
+
+void engine_record_loop_iteration(engine_t* engine, uint64_t woke_us) {
+    if (woke_us) engine_record_series(engine, ENGINE_SERIES_LOOP_ITERATION, get_time_us() - woke_us);
+}
+
+void engine_wake_controller(engine_t* engine) {
+    pthread_mutex_lock(&engine->control_mutex);
+    engine->control_wake = true;
+    pthread_cond_signal(&engine->control_cond);
+    pthread_mutex_unlock(&engine->control_mutex);
+}
+
+/* Raise stop_flag to `how` (never lowering an abort to a drain). The first
+   abort makes the stop pipe readable for threads blocked in a transfer;
+   repeating a stop already in force does nothing. */
+static void engine_raise_stop(engine_t* engine, int how) {
+    int previous = atomic_fetch_or(&engine->stop_flag, how);
+    if ((previous | how) == previous) return;
+    if (how == ENGINE_STOP_ABORT) {
+        char byte = 1;
+        ssize_t written = write(engine->stop_fds[1], &byte, 1);
+        (void)written;  /* a full pipe is readable already */
+    }
+    engine_wake_controller(engine);
+}
+
+/* Reset stop_flag for a new test; callers hold queue_mutex */
+static void engine_clear_stop(engine_t* engine) {
+    char drain[16];
+    atomic_store(&engine->stop_flag, 0);
+    while (read(engine->stop_fds[0], drain, sizeof(drain)) > 0) {
+    }
+}
+
+/* Take the engine for a test before it touches any shared test state (labels,
+   templates, arrival schedule, counters): -1 with errno EBUSY while another
+   test runs. Pool workers park from here on, and a stop that arrives while
+   the test is still being set up stays in force. */
+static int engine_begin_test(engine_t* engine) {
+    pthread_mutex_lock(&engine->queue_mutex);
+    bool busy = engine->load_test_active;
+    if (!busy) {
+        engine_clear_stop(engine);
+        engine->load_test_active = true;
+    }
+    pthread_mutex_unlock(&engine->queue_mutex);
+    if (busy) errno = EBUSY;
+    return busy ? -1 : 0;
+}
+
+/* End a test taken with engine_begin_test() and unblock pool workers. The
+   test's stop is cleared with it: pool workers drop transfers while
+   engine_aborting(), and requests sent between tests must be recorded. */
+static void engine_end_test(engine_t* engine) {
+    pthread_mutex_lock(&engine->queue_mutex);
+    engine_clear_stop(engine);
+    engine->load_test_active = false;
+    pthread_mutex_unlock(&engine->queue_mutex);
+    mpmc_queue_wake_all(engine->request_queue);
+}
+
+/* Run one transfer on the calling thread's own multi handle. Unlike
+   curl_easy_perform() the wait also watches the stop pipe, so an abort ends
+   it at once: *aborted is set and the transfer is dropped unfinished. */
+static CURLcode engine_perform(engine_t* engine, CURLM* multi, CURL* curl, bool* aborted) {
+    *aborted = false;
+    if (!multi) return curl_easy_perform(curl);
+    if (curl_multi_add_handle(multi, curl) != CURLM_OK) return CURLE_FAILED_INIT;
+
+    struct curl_waitfd stop;
+    stop.fd = engine->stop_fds[0];
+    stop.events = CURL_WAIT_POLLIN;
+    stop.revents = 0;
+
+    CURLcode result = CURLE_FAILED_INIT;
+    for (;;) {
+        int running = 0;
+        if (curl_multi_perform(multi, &running) != CURLM_OK) break;
+
+        bool done = false;
+        CURLMsg* msg;
+        int pending = 0;
+        while ((msg = curl_multi_info_read(multi, &pending)) != NULL) {
+            if (msg->msg == CURLMSG_DONE && msg->easy_handle == curl) {
+                result = msg->data.result;
+                done = true;
+            }
+        }
+        if (done || running == 0) break;
+        if (engine_aborting(engine)) {
+            *aborted = true;
+            break;
+        }
+        if (curl_multi_poll(multi, &stop, 1, 1000, NULL) != CURLM_OK) break;
+    }
+    curl_multi_remove_handle(multi, curl);
+    return result;
+}
+
+struct curl_slist* engine_scratch_headers(scratch_arena_t* arena, const char* headers, void** heap) {
+    *heap = NULL;
+    size_t len = strlen(headers);
+    if (len == 0) return NULL;
+
+    int lines = 1;
+    for (size_t i = 0; i < len; i++) lines += headers[i] == '\n';
+    size_t nodes_size = sizeof(struct curl_slist) * (size_t)lines;
+    struct curl_slist* nodes = arena ? scratch_arena_alloc(arena, nodes_size) : NULL;
+    char* copy = nodes ? scratch_arena_alloc(arena, len + 1) : NULL;
+    if (!copy) {
+        *heap = malloc(nodes_size + len + 1);
+        if (!*heap) return NULL;
+        scratch_count_heap_allocation();
+        nodes = (struct curl_slist*)*heap;
+        copy = (char*)*heap + nodes_size;
+    }
+    memcpy(copy, headers, len + 1);
+    return request_headers_split(copy, len, nodes, lines);
+}
+
+#if defined(__linux__) && !defined(IP_BIND_ADDRESS_NO_PORT)
+#define IP_BIND_ADDRESS_NO_PORT 24
+#endif
+
+/* A socket bound to a source address gets its port at connect(), so the
+   port space is per destination rather than per address */
+static int source_sockopt_cb(void* clientp, curl_socket_t fd, curlsocktype purpose) {
+    (void)clientp;
+#ifdef IP_BIND_ADDRESS_NO_PORT
+    if (purpose == CURLSOCKTYPE_IPCXN) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &on, sizeof(on));
+    }
+#else
+    (void)fd;
+    (void)purpose;
+#endif
+    return CURL_SOCKOPT_OK;
+}
+
+void engine_bind_source(engine_t* engine, CURL* curl, int user, int users) {
+    int addresses = engine->source_address_count;
+    if (addresses > 0) {
+        curl_easy_setopt(curl, CURLOPT_INTERFACE, engine->source_interfaces[user % addresses]);
+    }
+    if (engine->source_port_min > 0) {
+        /* The users of one address split its port range into equal slices */
+        int per_address = addresses > 0 ? addresses : 1;
+        int sharing = users > per_address ? (users + per_address - 1) / per_address : 1;
+        int range = engine->source_port_max - engine->source_port_min + 1;
+        int slice = range / sharing > 0 ? range / sharing : 1;
+        int start = engine->source_port_min + ((user / per_address) % (range / slice)) * slice;
+        curl_easy_setopt(curl, CURLOPT_LOCALPORT, (long)start);
+        curl_easy_setopt(curl, CURLOPT_LOCALPORTRANGE, (long)slice);
+    } else if (addresses > 0) {
+        curl_easy_setopt(curl, CURLOPT_SOCKOPTFUNCTION, source_sockopt_cb);
+    }
+}
+
+bool engine_http_multiplexed(engine_t* engine) {
+    http_version_t version = engine->test_options.http_version;
+    return (version == HTTP_VERSION_2 || version == HTTP_VERSION_2_PRIOR_KNOWLEDGE || version == HTTP_VERSION_3) &&
+           engine->mode == ENGINE_MODE_EVENT && engine->test_options.connection_mode == CONNECTION_MODE_KEEP_ALIVE;
+}
+
+void engine_apply_http_version(engine_t* engine, CURL* curl) {
+    long version;
+    switch (engine->test_options.http_version) {
+    case HTTP_VERSION_1_1: version = CURL_HTTP_VERSION_1_1; break;
+    case HTTP_VERSION_2: version = CURL_HTTP_VERSION_2_0; break;
+    case HTTP_VERSION_2_PRIOR_KNOWLEDGE: version = CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE; break;
+#if LIBCURL_VERSION_NUM >= 0x074200
+    case HTTP_VERSION_3: version = CURL_HTTP_VERSION_3; break;
+#endif
+    default: return;  /* libcurl's default */
+    }
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, version);
+    /* Without this every user of an event loop that starts before the first
+       connection is up opens its own, and nothing gets multiplexed */
+    if (engine_http_multiplexed(engine)) curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+}
+
+bool engine_http_version_supported(http_version_t version) {
+    const curl_version_info_data* info = curl_version_info(CURLVERSION_NOW);
+    switch (version) {
+    case HTTP_VERSION_DEFAULT:
+    case HTTP_VERSION_1_1:
+        return true;
+    case HTTP_VERSION_2:
+    case HTTP_VERSION_2_PRIOR_KNOWLEDGE:
+        return info && (info->features & CURL_VERSION_HTTP2);
+    case HTTP_VERSION_3:
+#if LIBCURL_VERSION_NUM >= 0x074200
+        return info && (info->features & CURL_VERSION_HTTP3);
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+/* Send one queued request on a pool worker's handle; only the metrics are
+   kept, the response is dropped as it arrives */
+static void pool_send(engine_t* engine, int worker_id, CURLM* multi, CURL* curl, scratch_arena_t* arena,
+                      const http_request_t* request) {
+    curl_easy_reset(curl);
+    engine_bind_source(engine, curl, worker_id, engine->num_workers);
+    if (arena) scratch_arena_reset(arena);
+    
+    uint64_t start_time = get_time_us();
+    
+    curl_easy_setopt(curl, CURLOPT_URL, request->url);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request->method);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_discard);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, response_discard);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, request->timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+    
+    if (strlen(request->body) > 0) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request->body);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, strlen(request->body));
+    }
+    
+    void* header_heap = NULL;
+    struct curl_slist* header_list = engine_scratch_headers(arena, request->headers, &header_heap);
+    if (header_list) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
+    
+    /* Per-request connections, as curl_easy_perform() on a fresh handle gave */
+    curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 1L);
+    curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L);
+    
+    bool aborted = false;
+    CURLcode res = engine_perform(engine, multi, curl, &aborted);
+    uint64_t end_time = get_time_us();
+    uint64_t response_time = end_time - start_time;
+    
+    long response_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    
+    bool success = (res == CURLE_OK && response_code >= 200 && response_code < 400);
+    if (!aborted) {
+        engine_update_metrics(engine, response_time, success);
+        engine_record_phases(engine, curl);
+    }
+    free(header_heap);
+}
+
+static void* worker_thread_func(void* arg) {
+    worker_thread_t* worker = (worker_thread_t*)arg;
+    if (!worker || !worker->engine) {
+        return NULL;
+    }
+    
+    engine_t* engine = worker->engine;
+    engine_place_thread(engine, worker->thread_id);
+    mpmc_queue_t* queue = engine->request_queue;
+    CURLM* multi = curl_multi_init();   /* NULL falls back to curl_easy_perform */
+    /* One handle and one scratch arena (mapped with the first request) for
+       every request this worker sends */
+    CURL* curl = curl_easy_init();
+    scratch_arena_t* arena = NULL;
+    
+    for (;;) {
+        if (atomic_load(&engine->shutdown)) break;
+        
+        /* A deep queue is shared out in batches, one CAS per batch; a
+           shallow one a request at a time so idle workers get some */
+        void* batch[ENGINE_DISPATCH_BATCH];
+        int claimed = 0;
+        if (!atomic_load(&engine->load_test_active)) {
+            size_t share = (mpmc_queue_depth(queue) + (size_t)engine->num_workers - 1) / (size_t)engine->num_workers;
+            claimed = mpmc_queue_claim(queue, batch, share < 1 ? 1 : share > ENGINE_DISPATCH_BATCH
+                                                                     ? ENGINE_DISPATCH_BATCH : (int)share);
+        }
+        
+        if (claimed == 0) {
+            /* Nothing to send (or a load test owns the engine): park until
+               a request is published or the test ends */
+            uint32_t key = mpmc_queue_prepare_wait(queue);
+            if (atomic_load(&engine->shutdown) ||
+                (!atomic_load(&engine->load_test_active) && mpmc_queue_depth(queue) > 0)) {
+                mpmc_queue_cancel_wait(queue);
+            } else {
+                mpmc_queue_wait(queue, key);
+            }
+            continue;
+        }
+        
+        if (!curl) curl = curl_easy_init();
+        if (curl && !arena) arena = scratch_arena_thread();
+        /* Requests are sent straight from their queue cells */
+        for (int i = 0; i < claimed; i++) {
+            if (curl && !atomic_load(&engine->shutdown)) pool_send(engine, worker->thread_id, multi, curl, arena, batch[i]);
+            mpmc_queue_release(queue, batch[i]);
+        }
+    }
+    
+    if (curl) curl_easy_cleanup(curl);
+    if (multi) curl_multi_cleanup(multi);
+    return NULL;
+}
+
+static void share_lock_cb(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    (void)handle;
+    (void)access;
+    engine_t* engine = (engine_t*)userptr;
+    lock_stats_lock(&engine->share_locks[data], LOCK_SITE_CURL_SHARE);
+}
+
+static void share_unlock_cb(CURL* handle, curl_lock_data data, void* userptr) {
+    (void)handle;
+    engine_t* engine = (engine_t*)userptr;
+    pthread_mutex_unlock(&engine->share_locks[data]);
+}
+
+static CURLSH* engine_share_create(engine_t* engine, bool connections) {
+    CURLSH* share = curl_share_init();
+    if (!share) return NULL;
+
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock_cb);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock_cb);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, engine);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900  /* shared connection cache needs libcurl 7.57.0 */
+    if (connections) curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#else
+    (void)connections;
+#endif
+    return share;
+}
+
+/* Best effort: without a share handle keep-alive users still reuse their own
+   connections, they just stop sharing DNS/TLS/connection caches. Both
+   handles lock through share_locks, so their DNS and TLS data may share a
+   mutex. */
+static void engine_share_init(engine_t* engine) {
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&engine->share_locks[i], NULL);
+    }
+    engine->share_handle = engine_share_create(engine, true);
+    engine->session_share_handle = engine_share_create(engine, false);
+}
+
+/* Wake the first `count` pool workers and wait for them to exit; requests
+   they are still sending are aborted */
+static void engine_stop_pool_workers(engine_t* engine, int count) {
+    pthread_mutex_lock(&engine->queue_mutex);
+    atomic_store(&engine->shutdown, true);
+    engine_raise_stop(engine, ENGINE_STOP_ABORT);
+    for (int i = 0; i < count; i++) {
+        engine->workers[i].active = false;
+    }
+    pthread_mutex_unlock(&engine->queue_mutex);
+    mpmc_queue_wake_all(engine->request_queue);
+    
+    for (int i = 0; i < count; i++) {
+        pthread_join(engine->workers[i].thread, NULL);
+    }
+}
+
+/* The controller's wakeable tick and the stop pipe */
+static int engine_control_init(engine_t* engine) {
+    pthread_condattr_t attr;
+    if (pthread_condattr_init(&attr) != 0) return -1;
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int rc = pthread_cond_init(&engine->control_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (rc != 0) return -1;
+    if (pthread_mutex_init(&engine->control_mutex, NULL) != 0) {
+        pthread_cond_destroy(&engine->control_cond);
+        return -1;
+    }
+    if (pipe(engine->stop_fds) != 0) {
+        pthread_mutex_destroy(&engine->control_mutex);
+        pthread_cond_destroy(&engine->control_cond);
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(engine->stop_fds[i], F_SETFL, fcntl(engine->stop_fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(engine->stop_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    return 0;
+}
+
+static void engine_control_free(engine_t* engine) {
+    close(engine->stop_fds[0]);
+    close(engine->stop_fds[1]);
+    pthread_mutex_destroy(&engine->control_mutex);
+    pthread_cond_destroy(&engine->control_cond);
+}
+
+void engine_config_init(engine_config_t* config) {
+    if (!config) return;
+
+    memset(config, 0, sizeof(engine_config_t));
+    config->max_connections = 1000;
+    config->worker_threads = 10;
+    config->mode = ENGINE_MODE_THREADED;
+    config->event_loops = 0;
+    config->histogram_significant_digits = HISTOGRAM_DEFAULT_SIGNIFICANT_DIGITS;
+    config->histogram_max_us = HISTOGRAM_DEFAULT_HIGHEST_US;
+    config->metrics_window_ms = 1000;
+    config->metrics_window_capacity = 120;
+    config->saturation_threshold = 0.1;
+}
+
+engine_t* engine_create(int max_connections, int worker_threads) {
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = max_connections;
+    config.worker_threads = worker_threads;
+    return engine_create_with_config(&config);
+}
+
+engine_t* engine_create_with_config(const engine_config_t* config) {
+    if (!config) return NULL;
+
+    int max_connections = config->max_connections;
+    int worker_threads = config->worker_threads;
+    if (max_connections <= 0 || worker_threads <= 0 || config->event_loops < 0 ||
+        config->metrics_window_ms < 0 || (config->metrics_window_ms > 0 && config->metrics_window_capacity <= 0) ||
+        config->tcp_pool_size < 0 || config->udp_pool_size < 0 || config->mqtt_pool_size < 0 ||
+        config->websocket_pool_size < 0 || config->database_pool_size < 0 ||
+        config->cpu_count < 0 || config->cpu_count > ENGINE_MAX_CPUS ||
+        config->source_address_count < 0 || config->source_address_count > ENGINE_MAX_SOURCE_ADDRESSES ||
+        config->source_port_min < 0 || config->source_port_max > 65535 ||
+        (config->source_port_min > 0) != (config->source_port_max > 0) ||
+        config->source_port_min > config->source_port_max ||
+        !(config->saturation_threshold > 0.0 && config->saturation_threshold <= 1.0)) {
+        return NULL;
+    }
+    for (int i = 0; i < config->cpu_count; i++) {
+        if (config->cpus[i] < 0 || config->cpus[i] >= PLACEMENT_MAX_CPU) return NULL;
+    }
+    for (int i = 0; i < config->source_address_count; i++) {
+        if (!memchr(config->source_addresses[i], '\0', ENGINE_SOURCE_ADDRESS_MAX) ||
+            !source_address_valid(config->source_addresses[i])) {
+            return NULL;
+        }
+    }
+    if ((config->tcp_pool_size > 0 && tcp_set_pool_size(config->tcp_pool_size) != 0) ||
+        (config->udp_pool_size > 0 && udp_set_pool_size(config->udp_pool_size) != 0) ||
+        (config->mqtt_pool_size > 0 && mqtt_set_pool_size(config->mqtt_pool_size) != 0) ||
+        (config->websocket_pool_size > 0 && websocket_set_pool_size(config->websocket_pool_size) != 0) ||
+        (config->database_pool_size > 0 && database_set_pool_size(config->database_pool_size) != 0)) {
+        return NULL;
+    }
+    
+    if (config->scratch_hugepages) scratch_arena_set_hugepages(true);
+    
+    engine_t* engine = malloc(sizeof(engine_t));
+    if (!engine) return NULL;
+    
+    memset(engine, 0, sizeof(engine_t));
+    
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        free(engine);
+        return NULL;
+    }
+    
+    engine->multi_handle = curl_multi_init();
+    if (!engine->multi_handle) {
+        curl_global_cleanup();
+        free(engine);
+        return NULL;
+    }
+    
+    engine->max_connections = max_connections;
+    engine->num_workers = worker_threads;
+    engine->mode = config->mode;
+    if (engine->mode == ENGINE_MODE_EVENT && !event_loop_supported()) {
+        fprintf(stderr, "[LoadSpiker] Event-driven mode not supported on this platform, using threaded mode\n");
+        engine->mode = ENGINE_MODE_THREADED;
+    }
+    engine->event_loops = config->event_loops;
+    if (engine->event_loops == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        engine->event_loops = cpus > 0 ? (int)cpus : 1;
+    }
+    if (histogram_layout_init(&engine->latency_layout, config->histogram_max_us,
+                              config->histogram_significant_digits) != 0) {
+        curl_multi_cleanup(engine->multi_handle);
+        curl_global_cleanup();
+        free(engine);
+        return NULL;
+    }
+    
+    if (pthread_mutex_init(&engine->queue_mutex, NULL) != 0 ||
+        pthread_mutex_init(&engine->users_mutex, NULL) != 0 ||
+        pthread_cond_init(&engine->users_cond, NULL) != 0 ||
+        pthread_mutex_init(&engine->labels_mutex, NULL) != 0 ||
+        engine_control_init(engine) != 0) {
+        curl_multi_cleanup(engine->multi_handle);
+        curl_global_cleanup();
+        free(engine);
+        return NULL;
+    }
+    
+    engine->request_queue = mpmc_queue_create(sizeof(http_request_t), (size_t)max_connections * 2);
+    engine->workers = malloc(sizeof(worker_thread_t) * worker_threads);
+    
+    if (!engine->request_queue || !engine->workers || metric_shards_create(engine) != 0 ||
+        metrics_windows_create(engine, config) != 0) {
+        metrics_windows_free(engine);
+        mpmc_queue_destroy(engine->request_queue);
+        free(engine->workers);
+        free(engine->metric_shards);
+        free(engine->shard_taken);
+        free(engine->latency_counts);
+        pthread_mutex_destroy(&engine->queue_mutex);
+        pthread_mutex_destroy(&engine->users_mutex);
+        pthread_cond_destroy(&engine->users_cond);
+        pthread_mutex_destroy(&engine->labels_mutex);
+        engine_control_free(engine);
+        curl_multi_cleanup(engine->multi_handle);
+        curl_global_cleanup();
+        free(engine);
+        return NULL;
+    }
+    engine_placement_init(engine, config);
+    metric_shards_place(engine);
+    engine->saturation_threshold = config->saturation_threshold;
+    engine->health_cpus = engine->cpu_count > 0 ? engine->cpu_count : placement_available_cpus();
+    
+    for (int i = 0; i < worker_threads; i++) {
+        engine->workers[i].engine = engine;
+        engine->workers[i].thread_id = i;
+        engine->workers[i].active = true;
+        if (pthread_create(&engine->workers[i].thread, NULL, worker_thread_func, &engine->workers[i]) != 0) {
+            // Clean up on thread creation failure
+            engine->workers[i].active = false;
+            engine_stop_pool_workers(engine, i);
+            metrics_windows_free(engine);
+            mpmc_queue_destroy(engine->request_queue);
+            free(engine->workers);
+            free(engine->metric_shards);
+            free(engine->shard_taken);
+            free(engine->latency_counts);
+            pthread_mutex_destroy(&engine->queue_mutex);
+            pthread_mutex_destroy(&engine->users_mutex);
+            pthread_cond_destroy(&engine->users_cond);
+            pthread_mutex_destroy(&engine->labels_mutex);
+            engine_control_free(engine);
+            curl_multi_cleanup(engine->multi_handle);
+            curl_global_cleanup();
+            free(engine);
+            return NULL;
+        }
+    }
+    
+    engine_share_init(engine);
+    
+    return engine;
+}
+
+void engine_destroy(engine_t* engine) {
+    if (!engine) return;
+    
+    engine_stop_pool_workers(engine, engine->num_workers);
+    request_loop_destroy(engine->request_loop);
+    
+    // Clean up all protocol connection pools
+    tcp_cleanup_all();
+    udp_cleanup_all();
+    mqtt_cleanup_all();
+    websocket_cleanup_all();
+    database_cleanup_all();
+    
+    curl_multi_cleanup(engine->multi_handle);
+    if (engine->share_handle) {
+        curl_share_cleanup(engine->share_handle);
+    }
+    if (engine->session_share_handle) {
+        curl_share_cleanup(engine->session_share_handle);
+    }
+    curl_global_cleanup();
+    
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&engine->share_locks[i]);
+    }
+    pthread_mutex_destroy(&engine->queue_mutex);
+    pthread_mutex_destroy(&engine->users_mutex);
+    pthread_cond_destroy(&engine->users_cond);
+    pthread_mutex_destroy(&engine->labels_mutex);
+    engine_control_free(engine);
+    
+    metrics_windows_free(engine);
+    metric_labels_free(engine);
+    free(engine->metric_shards);
+    free(engine->shard_taken);
+    free(engine->latency_counts);
+    free(engine->workers);
+    mpmc_queue_destroy(engine->request_queue);
+    free(engine);
+}
+
+int engine_execute_request_sync(engine_t* engine, const http_request_t* request, http_response_t* response) {
+    if (!engine || !request || !response) return -1;
+    
+    // The body and headers are written straight into the response
+    response->status_code = 0;
+    response->headers[0] = '\0';
+    response->body[0] = '\0';
+    response->response_time_us = 0;
+    response->success = false;
+    response->error_message[0] = '\0';
+    
+    CURL* curl = curl_easy_init();
+    if (!curl) return -1;
+    
+    response_buffer_t buffer = {response->body, 0, MAX_BODY_LENGTH};
+    header_buffer_t headers = {response->headers, 0, MAX_HEADER_LENGTH};
+    /* The header list is built in this thread's scratch arena */
+    scratch_arena_t* arena = scratch_arena_thread();
+    if (arena) scratch_arena_reset(arena);
+    
+    uint64_t start_time = get_time_us();
+    
+    curl_easy_setopt(curl, CURLOPT_URL, request->url);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request->method);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, engine_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, engine_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &headers);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, request->timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+    
+    if (strlen(request->body) > 0) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request->body);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, strlen(request->body));
+    }
+    
+    void* header_heap = NULL;
+    struct curl_slist* header_list = engine_scratch_headers(arena, request->headers, &header_heap);
+    if (header_list) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
+    
+    CURLcode res = curl_easy_perform(curl);
+    uint64_t end_time = get_time_us();
+    uint64_t response_time = end_time - start_time;
+    
+    long response_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    
+    // Fill response structure safely
+    response->status_code = response_code;
+    response->response_time_us = response_time;
+    response->success = (res == CURLE_OK && response_code >= 200 && response_code < 400);
+    
+    // Copy error message if there was an error
+    if (res != CURLE_OK) {
+        const char* error_str = curl_easy_strerror(res);
+        strncpy(response->error_message, error_str, sizeof(response->error_message) - 1);
+        response->error_message[sizeof(response->error_message) - 1] = '\0';
+    } else {
+        response->error_message[0] = '\0';
+    }
+    
+    // Update metrics
+    engine_record_http_result(engine, -1, response_time, response_code, res);
+    
+    curl_easy_cleanup(curl);
+    free(header_heap);
+    
+    return 0;
+}
+
+int engine_execute_request(engine_t* engine, const http_request_t* request, http_response_t* response) {
+    if (!engine || !request || !response) return -1;
+    
+    http_request_t* slot = mpmc_queue_reserve(engine->request_queue);
+    if (!slot) return -1; // Queue full
+    
+    memcpy(slot, request, sizeof(http_request_t));
+    mpmc_queue_publish(engine->request_queue, slot);
+    
+    return 0;
+}
+
+/* Add every shard's latency (or queue-delay) counts into `out`, which must
+   use engine->latency_layout */
+static void engine_merge_counts(engine_t* engine, histogram_t* out, bool queue_delay) {
+    int counts_len = engine->latency_layout.counts_len;
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        metrics_shard_t* shard = &engine->metric_shards[s];
+        _Atomic uint64_t* counts = queue_delay ? shard->queue_delay_counts : shard->latency_counts;
+        for (int i = 0; i < counts_len; i++) {
+            uint64_t count = atomic_load_explicit(&counts[i], memory_order_relaxed);
+            out->counts[i] += count;
+            out->total_count += count;
+        }
+        uint64_t max_us = atomic_load_explicit(queue_delay ? &shard->max_queue_delay_us : &shard->max_response_time_us,
+                                               memory_order_relaxed);
+        if (max_us > out->max_value) {
+            out->max_value = max_us;
+        }
+    }
+}
+
+static histogram_t* engine_snapshot_counts(engine_t* engine, bool queue_delay) {
+    if (!engine) return NULL;
+
+    histogram_t* merged = histogram_create(&engine->latency_layout);
+    if (!merged) return NULL;
+
+    engine_merge_counts(engine, merged, queue_delay);
+    return merged;
+}
+
+static int engine_percentiles_of(engine_t* engine, bool queue_delay, const double* percentiles,
+                                 uint64_t* values_us, int count) {
+    if (!engine || !percentiles || !values_us || count < 0) return -1;
+
+    histogram_t* merged = engine_snapshot_counts(engine, queue_delay);
+    if (!merged) return -1;
+
+    for (int i = 0; i < count; i++) {
+        values_us[i] = histogram_value_at_percentile(merged, percentiles[i]);
+    }
+    histogram_destroy(merged);
+    return 0;
+}
+
+/* Merge shards' counters and min/max into `metrics`; writers keep going, so
+   the result is per-field consistent rather than a single instant, which is
+   fine for reporting. */
+static void engine_sum_totals(engine_t* engine, metrics_t* metrics) {
+    memset(metrics, 0, sizeof(metrics_t));
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        metrics_shard_t* shard = &engine->metric_shards[s];
+        uint64_t total = atomic_load_explicit(&shard->total_requests, memory_order_relaxed);
+        uint64_t failed = atomic_load_explicit(&shard->failed_requests, memory_order_relaxed);
+        if (total == 0 && failed == 0) continue;
+
+        metrics->total_requests += total;
+        metrics->successful_requests += atomic_load_explicit(&shard->successful_requests, memory_order_relaxed);
+        metrics->failed_requests += failed;
+        metrics->total_response_time_us += atomic_load_explicit(&shard->total_response_time_us, memory_order_relaxed);
+
+        uint64_t min_us = atomic_load_explicit(&shard->min_response_time_us, memory_order_relaxed);
+        if (min_us != 0 && (metrics->min_response_time_us == 0 || min_us < metrics->min_response_time_us)) {
+            metrics->min_response_time_us = min_us;
+        }
+        uint64_t max_us = atomic_load_explicit(&shard->max_response_time_us, memory_order_relaxed);
+        if (max_us > metrics->max_response_time_us) {
+            metrics->max_response_time_us = max_us;
+        }
+    }
+}
+
+void engine_get_metrics(engine_t* engine, metrics_t* metrics) {
+    if (!engine || !metrics) return;
+
+    engine_sum_totals(engine, metrics);
 
     /* RPS: use wall-clock elapsed time, not cumulative response time */
     struct timeval now;
@@ -885,231 +1774,1720 @@ void engine_get_metrics(engine_t* engine, metrics_t* metrics) {
     if (elapsed_sec > 0.0 && metrics->total_requests > 0) {
         metrics->requests_per_second = (double)metrics->total_requests / elapsed_sec;
     } else {
-        metrics->requests_per_second = 0.0;
+        metrics->requests_per_second = 0.0;
+    }
+
+    /* Percentile computation from histogram */
+    if (metrics->total_requests > 0) {
+        static const double percentiles[] = {50.0, 90.0, 95.0, 99.0, 99.9, 99.99};
+        uint64_t values[6] = {0};
+        engine_get_latency_percentiles(engine, percentiles, values, 6);
+        metrics->p50_us = values[0];
+        metrics->p90_us = values[1];
+        metrics->p95_us = values[2];
+        metrics->p99_us = values[3];
+        metrics->p999_us = values[4];
+        metrics->p9999_us = values[5];
+
+        static const double queue_percentiles[] = {50.0, 99.0, 100.0};
+        uint64_t queue_values[3] = {0};
+        engine_get_queue_delay_percentiles(engine, queue_percentiles, queue_values, 3);
+        metrics->queue_delay_p50_us = queue_values[0];
+        metrics->queue_delay_p99_us = queue_values[1];
+        metrics->queue_delay_max_us = queue_values[2];
+    }
+}
+
+int engine_get_latency_percentiles(engine_t* engine, const double* percentiles, uint64_t* values_us, int count) {
+    return engine_percentiles_of(engine, false, percentiles, values_us, count);
+}
+
+histogram_t* engine_get_latency_histogram(engine_t* engine) {
+    return engine_snapshot_counts(engine, false);
+}
+
+int engine_get_queue_delay_percentiles(engine_t* engine, const double* percentiles, uint64_t* values_us, int count) {
+    return engine_percentiles_of(engine, true, percentiles, values_us, count);
+}
+
+histogram_t* engine_get_queue_delay_histogram(engine_t* engine) {
+    return engine_snapshot_counts(engine, true);
+}
+
+static const char* const phase_names[ENGINE_PHASES] = { "dns", "connect", "tls", "ttfb", "transfer" };
+
+const char* engine_phase_name(engine_phase_t phase) {
+    return (unsigned)phase < ENGINE_PHASES ? phase_names[phase] : "unknown";
+}
+
+/* Merge one generator series over every shard into a new histogram, and
+   sum its totals into *total_us */
+static histogram_t* engine_snapshot_series(engine_t* engine, engine_series_t series, uint64_t* total_us) {
+    histogram_t* merged = histogram_create(&engine->latency_layout);
+    if (!merged) return NULL;
+
+    uint64_t total = 0;
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        series_shard_t* stats = &engine->metric_shards[s].series[series];
+        _Atomic uint64_t* counts = atomic_load_explicit(&stats->counts, memory_order_acquire);
+        if (!counts) continue;
+        for (int i = 0; i < engine->latency_layout.counts_len; i++) {
+            uint64_t count = atomic_load_explicit(&counts[i], memory_order_relaxed);
+            merged->counts[i] += count;
+            merged->total_count += count;
+        }
+        total += atomic_load_explicit(&stats->total_us, memory_order_relaxed);
+        uint64_t max_us = atomic_load_explicit(&stats->max_us, memory_order_relaxed);
+        if (max_us > merged->max_value) merged->max_value = max_us;
+    }
+    if (total_us) *total_us = total;
+    return merged;
+}
+
+static int engine_series_summary(engine_t* engine, engine_series_t series, phase_metrics_t* metrics) {
+    memset(metrics, 0, sizeof(phase_metrics_t));
+    histogram_t* merged = engine_snapshot_series(engine, series, &metrics->total_us);
+    if (!merged) return -1;
+
+    metrics->count = merged->total_count;
+    if (metrics->count > 0) {
+        metrics->p50_us = histogram_value_at_percentile(merged, 50.0);
+        metrics->p90_us = histogram_value_at_percentile(merged, 90.0);
+        metrics->p99_us = histogram_value_at_percentile(merged, 99.0);
+        metrics->max_us = merged->max_value;
+    }
+    histogram_destroy(merged);
+    return 0;
+}
+
+int engine_get_protocol_metrics(engine_t* engine, protocol_metrics_t* metrics) {
+    if (!engine || !metrics) return -1;
+
+    memset(metrics, 0, sizeof(protocol_metrics_t));
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        metrics_shard_t* shard = &engine->metric_shards[s];
+        for (int i = 0; i < ENGINE_HTTP_VERSIONS; i++) {
+            metrics->streams_by_version[i] += atomic_load_explicit(&shard->http_versions[i], memory_order_relaxed);
+        }
+        metrics->connections += atomic_load_explicit(&shard->connections_opened, memory_order_relaxed);
+    }
+    for (int i = 0; i < ENGINE_HTTP_VERSIONS; i++) metrics->streams += metrics->streams_by_version[i];
+    if (metrics->connections > 0) {
+        metrics->streams_per_connection = (double)metrics->streams / (double)metrics->connections;
+    }
+    return 0;
+}
+
+int engine_get_phase_metrics(engine_t* engine, engine_phase_t phase, phase_metrics_t* metrics) {
+    if (!engine || !metrics || (unsigned)phase >= ENGINE_PHASES) return -1;
+    return engine_series_summary(engine, (engine_series_t)phase, metrics);
+}
+
+histogram_t* engine_get_phase_histogram(engine_t* engine, engine_phase_t phase) {
+    if (!engine || (unsigned)phase >= ENGINE_PHASES) return NULL;
+    return engine_snapshot_series(engine, (engine_series_t)phase, NULL);
+}
+
+int engine_get_generator_health(engine_t* engine, generator_health_t* health) {
+    if (!engine || !health) return -1;
+
+    memset(health, 0, sizeof(generator_health_t));
+    double threshold = engine->saturation_threshold;
+    health->saturation_threshold = threshold;
+    uint64_t start_us = atomic_load(&engine->health_start_us);
+    if (start_us == 0) return 0;  /* no test yet */
+
+    /* A finished test reports its own span; a running one everything so far */
+    uint64_t end_us = atomic_load(&engine->health_end_us);
+    bool running = end_us == 0;
+    uint64_t now_us = running ? get_time_us() : end_us;
+    health->elapsed_us = now_us > start_us ? now_us - start_us : 0;
+
+    phase_metrics_t lag, loop;
+    if (engine_series_summary(engine, ENGINE_SERIES_SCHEDULER_LAG, &lag) != 0 ||
+        engine_series_summary(engine, ENGINE_SERIES_LOOP_ITERATION, &loop) != 0) {
+        return -1;
+    }
+    health->scheduler_lag_count = lag.count;
+    health->scheduler_lag_p50_us = lag.p50_us;
+    health->scheduler_lag_p99_us = lag.p99_us;
+    health->scheduler_lag_max_us = lag.max_us;
+    health->loop_iterations = loop.count;
+    health->loop_iteration_p50_us = loop.p50_us;
+    health->loop_iteration_p99_us = loop.p99_us;
+    health->loop_iteration_max_us = loop.max_us;
+
+    uint64_t cpu_us = (running ? process_cpu_us() : atomic_load(&engine->health_cpu_end_us)) -
+                      atomic_load(&engine->health_cpu_base_us);
+    if (health->elapsed_us > 0) {
+        health->process_cpu_utilization = (double)cpu_us / ((double)health->elapsed_us * engine->health_cpus);
+    }
+    health->max_thread_cpu_utilization = (double)atomic_load(&engine->max_thread_busy_ppm) / 1e6;
+    health->threads_measured = atomic_load(&engine->threads_measured);
+
+    lock_site_stats_t now_locks[LOCK_SITES];
+    if (running) lock_stats_read(now_locks);
+    for (int i = 0; i < LOCK_SITES; i++) {
+        uint64_t contended = running ? now_locks[i].contended : atomic_load(&engine->health_lock_end_contended[i]);
+        uint64_t wait_ns = running ? now_locks[i].wait_ns : atomic_load(&engine->health_lock_end_wait_ns[i]);
+        health->lock_sites[i].contended = contended - atomic_load(&engine->health_lock_contended[i]);
+        health->lock_sites[i].wait_ns = wait_ns - atomic_load(&engine->health_lock_wait_ns[i]);
+        health->lock_contentions += health->lock_sites[i].contended;
+        health->lock_wait_us += health->lock_sites[i].wait_ns / 1000;
+    }
+
+    /* Each overhead against the part of the results it distorts */
+    metrics_t totals;
+    engine_sum_totals(engine, &totals);
+    static const double percentiles[] = {50.0, 99.0};
+    uint64_t latency[2] = {0, 0};
+    if (totals.total_requests > 0) engine_get_latency_percentiles(engine, percentiles, latency, 2);
+    if (latency[1] > 0) health->scheduler_lag_fraction = (double)lag.p99_us / (double)latency[1];
+    if (totals.total_response_time_us > 0) {
+        health->lock_wait_fraction = (double)health->lock_wait_us / (double)totals.total_response_time_us;
+    }
+    if (latency[0] > 0) health->loop_iteration_fraction = (double)loop.p99_us / (double)latency[0];
+
+    health->overhead_fraction = health->scheduler_lag_fraction;
+    if (health->lock_wait_fraction > health->overhead_fraction) health->overhead_fraction = health->lock_wait_fraction;
+    if (health->loop_iteration_fraction > health->overhead_fraction) {
+        health->overhead_fraction = health->loop_iteration_fraction;
+    }
+
+    if (health->max_thread_cpu_utilization >= 1.0 - threshold || health->process_cpu_utilization >= 1.0 - threshold) {
+        health->saturation_reasons |= ENGINE_SATURATED_CPU;
+    }
+    if (health->scheduler_lag_fraction > threshold) health->saturation_reasons |= ENGINE_SATURATED_SCHEDULER;
+    if (health->lock_wait_fraction > threshold) health->saturation_reasons |= ENGINE_SATURATED_LOCKS;
+    if (health->loop_iteration_fraction > threshold) health->saturation_reasons |= ENGINE_SATURATED_EVENT_LOOP;
+    health->saturated = health->saturation_reasons != 0;
+    return 0;
+}
+
+int engine_get_label_count(engine_t* engine) {
+    if (!engine) return 0;
+    pthread_mutex_lock(&engine->labels_mutex);
+    int count = engine->label_count;
+    pthread_mutex_unlock(&engine->labels_mutex);
+    return count;
+}
+
+int engine_get_alloc_stats(engine_t* engine, scratch_stats_t* stats) {
+    if (!engine || !stats) return -1;
+    scratch_stats_get(stats);
+    return 0;
+}
+
+int engine_get_assertion_count(engine_t* engine) {
+    if (!engine) return 0;
+    pthread_mutex_lock(&engine->labels_mutex);
+    int count = engine->assertion_count;
+    pthread_mutex_unlock(&engine->labels_mutex);
+    return count;
+}
+
+int engine_get_assertion_metrics(engine_t* engine, int assertion, assertion_metrics_t* metrics) {
+    if (!engine || !metrics || assertion < 0) return -1;
+
+    memset(metrics, 0, sizeof(assertion_metrics_t));
+    pthread_mutex_lock(&engine->labels_mutex);
+    if (assertion >= engine->assertion_count) {
+        pthread_mutex_unlock(&engine->labels_mutex);
+        return -1;
+    }
+    snprintf(metrics->name, sizeof(metrics->name), "%s", engine->assertions[assertion].name);
+    pthread_mutex_unlock(&engine->labels_mutex);
+
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        metrics_shard_t* shard = &engine->metric_shards[s];
+        metrics->checked += atomic_load_explicit(&shard->assertion_checks, memory_order_relaxed);
+        metrics->failed += atomic_load_explicit(&shard->assertion_failures[assertion], memory_order_relaxed);
+    }
+    return 0;
+}
+
+int engine_get_label_metrics(engine_t* engine, int label, label_metrics_t* metrics) {
+    if (!engine || !metrics || label < 0) return -1;
+
+    memset(metrics, 0, sizeof(label_metrics_t));
+    pthread_mutex_lock(&engine->labels_mutex);
+    if (label >= engine->label_count) {
+        pthread_mutex_unlock(&engine->labels_mutex);
+        return -1;
+    }
+    snprintf(metrics->name, sizeof(metrics->name), "%s", engine->label_names[label]);
+    pthread_mutex_unlock(&engine->labels_mutex);
+
+    histogram_t* merged = histogram_create(&engine->latency_layout);
+    if (!merged) return -1;
+
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        label_shard_t* stats = &engine->metric_shards[s].labels[label];
+        uint64_t total = atomic_load_explicit(&stats->total_requests, memory_order_relaxed);
+        if (total == 0) continue;
+
+        metrics->total_requests += total;
+        metrics->successful_requests += atomic_load_explicit(&stats->successful_requests, memory_order_relaxed);
+        metrics->failed_requests += atomic_load_explicit(&stats->failed_requests, memory_order_relaxed);
+        metrics->total_response_time_us += atomic_load_explicit(&stats->total_response_time_us, memory_order_relaxed);
+        for (int c = 0; c < 6; c++) {
+            metrics->status_classes[c] += atomic_load_explicit(&stats->status_classes[c], memory_order_relaxed);
+        }
+        uint64_t max_us = atomic_load_explicit(&stats->max_response_time_us, memory_order_relaxed);
+        if (max_us > metrics->max_response_time_us) {
+            metrics->max_response_time_us = max_us;
+        }
+
+        _Atomic uint64_t* counts = atomic_load_explicit(&stats->latency_counts, memory_order_acquire);
+        if (!counts) continue;
+        for (int i = 0; i < merged->layout.counts_len; i++) {
+            uint64_t count = atomic_load_explicit(&counts[i], memory_order_relaxed);
+            merged->counts[i] += count;
+            merged->total_count += count;
+        }
+    }
+    merged->max_value = metrics->max_response_time_us;
+
+    metrics->p50_us = histogram_value_at_percentile(merged, 50.0);
+    metrics->p90_us = histogram_value_at_percentile(merged, 90.0);
+    metrics->p95_us = histogram_value_at_percentile(merged, 95.0);
+    metrics->p99_us = histogram_value_at_percentile(merged, 99.0);
+    histogram_destroy(merged);
+    return 0;
+}
+
+static int engine_sum_breakdown(engine_t* engine, bool errors, uint64_t* counts, int len) {
+    if (!engine || !counts || len < 0) return -1;
+
+    int limit = errors ? ENGINE_ERROR_CODES : ENGINE_STATUS_CODES;
+    if (len > limit) {
+        memset(counts + limit, 0, sizeof(uint64_t) * (size_t)(len - limit));
+        len = limit;
+    }
+    memset(counts, 0, sizeof(uint64_t) * (size_t)len);
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        metrics_shard_t* shard = &engine->metric_shards[s];
+        _Atomic uint64_t* source = errors ? shard->error_counts : shard->status_counts;
+        for (int i = 0; i < len; i++) {
+            counts[i] += atomic_load_explicit(&source[i], memory_order_relaxed);
+        }
+    }
+    return 0;
+}
+
+int engine_get_status_counts(engine_t* engine, uint64_t* counts, int len) {
+    return engine_sum_breakdown(engine, false, counts, len);
+}
+
+int engine_get_error_counts(engine_t* engine, uint64_t* counts, int len) {
+    return engine_sum_breakdown(engine, true, counts, len);
+}
+
+const char* engine_error_string(int code) {
+    return curl_easy_strerror((CURLcode)code);
+}
+
+/* Counters only grow, except across engine_reset_metrics(); a window that
+   spans a reset counts from zero instead of underflowing */
+static uint64_t window_delta(uint64_t now, uint64_t base) {
+    return now >= base ? now - base : now;
+}
+
+static void health_lock_snapshot(_Atomic uint64_t* contended, _Atomic uint64_t* wait_ns) {
+    lock_site_stats_t locks[LOCK_SITES];
+    lock_stats_read(locks);
+    for (int i = 0; i < LOCK_SITES; i++) {
+        atomic_store_explicit(&contended[i], locks[i].contended, memory_order_relaxed);
+        atomic_store_explicit(&wait_ns[i], locks[i].wait_ns, memory_order_relaxed);
+    }
+}
+
+/* Controller thread: start a test's generator-health accounting, before
+   its back-end threads start */
+static void engine_health_begin(engine_t* engine) {
+    health_lock_snapshot(engine->health_lock_contended, engine->health_lock_wait_ns);
+    atomic_store(&engine->health_cpu_base_us, process_cpu_us());
+    atomic_store(&engine->threads_measured, 0);
+    atomic_store(&engine->max_thread_busy_ppm, 0);
+    atomic_store(&engine->health_end_us, 0);
+    atomic_store(&engine->health_start_us, engine->test_start_us);
+}
+
+/* Controller thread: the test's threads are joined; freeze its totals */
+static void engine_health_end(engine_t* engine) {
+    health_lock_snapshot(engine->health_lock_end_contended, engine->health_lock_end_wait_ns);
+    atomic_store(&engine->health_cpu_end_us, process_cpu_us());
+    atomic_store(&engine->health_end_us, get_time_us());
+}
+
+/* Controller thread: open the first window of a load test */
+static void engine_window_begin(engine_t* engine, uint64_t now_us) {
+    if (!engine->windows) return;
+
+    histogram_reset(engine->window_base_counts);
+    engine_merge_counts(engine, engine->window_base_counts, false);
+    engine_sum_totals(engine, &engine->window_base);
+    engine->window_start_us = now_us;
+}
+
+/* Controller thread: publish everything completed since the open window
+   started, then open the next one at now_us */
+static void engine_window_close(engine_t* engine, uint64_t now_us) {
+    if (!engine->windows || now_us <= engine->window_start_us) return;
+
+    histogram_t* now_counts = engine->window_now_counts;
+    histogram_t* counts = engine->window_counts;
+    histogram_reset(now_counts);
+    engine_merge_counts(engine, now_counts, false);
+    metrics_t totals;
+    engine_sum_totals(engine, &totals);
+
+    uint64_t highest = 0;
+    counts->total_count = 0;
+    for (int i = 0; i < counts->layout.counts_len; i++) {
+        counts->counts[i] = window_delta(now_counts->counts[i], engine->window_base_counts->counts[i]);
+        if (counts->counts[i] > 0) {
+            counts->total_count += counts->counts[i];
+            highest = histogram_highest_at_index(&counts->layout, i);
+        }
+    }
+    counts->max_value = highest < totals.max_response_time_us ? highest : totals.max_response_time_us;
+
+    const metrics_t* base = &engine->window_base;
+    metrics_window_t window;
+    memset(&window, 0, sizeof(window));
+    window.start_us = engine->window_start_us - engine->test_start_us;
+    window.duration_us = now_us - engine->window_start_us;
+    window.total_requests = window_delta(totals.total_requests, base->total_requests);
+    window.successful_requests = window_delta(totals.successful_requests, base->successful_requests);
+    window.failed_requests = window_delta(totals.failed_requests, base->failed_requests);
+    window.total_response_time_us = window_delta(totals.total_response_time_us, base->total_response_time_us);
+    window.requests_per_second = (double)window.total_requests * 1000000.0 / (double)window.duration_us;
+    window.p50_us = histogram_value_at_percentile(counts, 50.0);
+    window.p90_us = histogram_value_at_percentile(counts, 90.0);
+    window.p99_us = histogram_value_at_percentile(counts, 99.0);
+    window.max_us = counts->max_value;
+    window.active_users = atomic_load(&engine->active_users);
+    metrics_ring_publish(engine->windows, &window, counts->counts);
+
+    /* The cumulative counts just taken are the next window's baseline */
+    engine->window_now_counts = engine->window_base_counts;
+    engine->window_base_counts = now_counts;
+    engine->window_base = totals;
+    engine->window_start_us = now_us;
+}
+
+int engine_next_metrics_window(engine_t* engine, metrics_window_t* window, histogram_t* interval) {
+    if (!engine || !window) return -1;
+    if (!engine->windows) return 0;
+    return metrics_ring_consume(engine->windows, window, interval);
+}
+
+void engine_reset_metrics(engine_t* engine) {
+    if (!engine) return;
+    
+    /* Field-wise stores: a sample recorded concurrently with a reset may
+       survive partially, exactly as it could land just before or after it. */
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        metrics_shard_t* shard = &engine->metric_shards[s];
+        atomic_store_explicit(&shard->total_requests, 0, memory_order_relaxed);
+        atomic_store_explicit(&shard->successful_requests, 0, memory_order_relaxed);
+        atomic_store_explicit(&shard->failed_requests, 0, memory_order_relaxed);
+        atomic_store_explicit(&shard->total_response_time_us, 0, memory_order_relaxed);
+        atomic_store_explicit(&shard->min_response_time_us, 0, memory_order_relaxed);
+        atomic_store_explicit(&shard->max_response_time_us, 0, memory_order_relaxed);
+        atomic_store_explicit(&shard->max_queue_delay_us, 0, memory_order_relaxed);
+        for (int i = 0; i < engine->latency_layout.counts_len; i++) {
+            atomic_store_explicit(&shard->latency_counts[i], 0, memory_order_relaxed);
+            atomic_store_explicit(&shard->queue_delay_counts[i], 0, memory_order_relaxed);
+        }
+        for (int i = 0; i < ENGINE_STATUS_CODES; i++) {
+            atomic_store_explicit(&shard->status_counts[i], 0, memory_order_relaxed);
+        }
+        for (int i = 0; i < ENGINE_ERROR_CODES; i++) {
+            atomic_store_explicit(&shard->error_counts[i], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&shard->assertion_checks, 0, memory_order_relaxed);
+        for (int i = 0; i < RESPONSE_ASSERT_MAX; i++) {
+            atomic_store_explicit(&shard->assertion_failures[i], 0, memory_order_relaxed);
+        }
+        for (int i = 0; i < ENGINE_HTTP_VERSIONS; i++) {
+            atomic_store_explicit(&shard->http_versions[i], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&shard->connections_opened, 0, memory_order_relaxed);
+
+        /* Label names stay registered; only their numbers restart */
+        for (int l = 0; l < ENGINE_MAX_LABELS; l++) {
+            label_shard_t* stats = &shard->labels[l];
+            atomic_store_explicit(&stats->total_requests, 0, memory_order_relaxed);
+            atomic_store_explicit(&stats->successful_requests, 0, memory_order_relaxed);
+            atomic_store_explicit(&stats->failed_requests, 0, memory_order_relaxed);
+            atomic_store_explicit(&stats->total_response_time_us, 0, memory_order_relaxed);
+            atomic_store_explicit(&stats->max_response_time_us, 0, memory_order_relaxed);
+            for (int c = 0; c < 6; c++) {
+                atomic_store_explicit(&stats->status_classes[c], 0, memory_order_relaxed);
+            }
+            _Atomic uint64_t* counts = atomic_load_explicit(&stats->latency_counts, memory_order_acquire);
+            if (!counts) continue;
+            for (int i = 0; i < engine->latency_layout.counts_len; i++) {
+                atomic_store_explicit(&counts[i], 0, memory_order_relaxed);
+            }
+        }
+
+        for (int k = 0; k < ENGINE_SERIES; k++) {
+            series_shard_t* stats = &shard->series[k];
+            atomic_store_explicit(&stats->total_us, 0, memory_order_relaxed);
+            atomic_store_explicit(&stats->max_us, 0, memory_order_relaxed);
+            _Atomic uint64_t* counts = atomic_load_explicit(&stats->counts, memory_order_acquire);
+            if (!counts) continue;
+            for (int i = 0; i < engine->latency_layout.counts_len; i++) {
+                atomic_store_explicit(&counts[i], 0, memory_order_relaxed);
+            }
+        }
+    }
+}
+
+/* Block until get_time_us() reaches deadline_us */
+static void sleep_until_us(uint64_t deadline_us) {
+    if (deadline_us <= get_time_us()) return;
+
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline_us / 1000000);
+    ts.tv_nsec = (long)(deadline_us % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+/* Open model: sleep until a request's slot, unless the test is aborted
+   first (false). poll() on the stop pipe covers whole milliseconds, the
+   rest is slept exactly. */
+static bool engine_wait_until(engine_t* engine, uint64_t deadline_us) {
+    for (;;) {
+        if (engine_aborting(engine)) return false;
+        uint64_t now_us = get_time_us();
+        if (now_us >= deadline_us) return true;
+        uint64_t remaining_ms = (deadline_us - now_us) / 1000;
+        if (remaining_ms == 0) {
+            sleep_until_us(deadline_us);
+            return true;
+        }
+        struct pollfd stop = { engine->stop_fds[0], POLLIN, 0 };
+        poll(&stop, 1, remaining_ms > 1000 ? 1000 : (int)remaining_ms);
+    }
+}
+
+/* Park a ramped-down user until the profile wants it again; false once the
+   test is stopping. */
+static bool engine_wait_for_turn(engine_t* engine, int user_id) {
+    pthread_mutex_lock(&engine->users_mutex);
+    while (!atomic_load(&engine->stop_flag) && !engine_user_active(engine, user_id)) {
+        pthread_cond_wait(&engine->users_cond, &engine->users_mutex);
+    }
+    pthread_mutex_unlock(&engine->users_mutex);
+    return !atomic_load(&engine->stop_flag);
+}
+
+static void* load_test_worker_func(void* arg) {
+    worker_thread_t* worker = (worker_thread_t*)arg;
+    if (!worker || !worker->engine) return NULL;
+    engine_t* engine = worker->engine;
+    engine_place_thread(engine, worker->thread_id);
+
+    /* Every user owns one easy handle for the whole test. Keep-alive users
+       also keep its connection (and, via the share handle, DNS/TLS state);
+       the others reconnect per request as before. */
+    bool keep_alive = engine->test_options.connection_mode == CONNECTION_MODE_KEEP_ALIVE;
+    CURL* curl = curl_easy_init();
+    /* Transfers run on a private multi handle so an abort can interrupt them */
+    CURLM* multi = curl_multi_init();
+    /* Data-driven tests substitute into this worker's own buffer */
+    param_scratch_t scratch;
+    if (engine_param_scratch_init(engine, &scratch) != 0) {
+        if (curl) curl_easy_cleanup(curl);
+        if (multi) curl_multi_cleanup(multi);
+        return NULL;
+    }
+
+    /* Responses stream through the assertions (or are dropped) unbuffered */
+    response_match_t match;
+    response_match_init(&match, engine->assertions, engine->assertion_count);
+    curl_write_callback on_body = match.count ? response_match_body : response_discard;
+    curl_write_callback on_header = match.header_mask ? response_match_header : response_discard;
+
+    request_view_t request;
+    uint64_t intended_us = 0;
+    while (!atomic_load(&engine->stop_flag)) {
+        if (!engine_user_active(engine, worker->thread_id) && !engine_wait_for_turn(engine, worker->thread_id)) {
+            break;  /* stopped while ramped down */
+        }
+        if (!engine_next_request(engine, &request, &intended_us)) {
+            break;  /* every request dispatched — this worker is done */
+        }
+        uint64_t claimed_us = get_time_us();
+
+        if (!curl && !(curl = curl_easy_init())) {
+            engine_count_failure(engine);
+            continue;
+        }
+
+        /* reset drops the previous request's options but keeps the live connection */
+        curl_easy_reset(curl);
+        engine_bind_source(engine, curl, worker->thread_id, engine->test_users);
+        if (keep_alive && engine->share_handle) {
+            curl_easy_setopt(curl, CURLOPT_SHARE, engine->share_handle);
+        }
+
+        /* Open model: wait for the request's slot in the arrival schedule. A
+           worker that claims it late (all users were busy) sends at once. */
+        if (intended_us && !engine_wait_until(engine, intended_us)) {
+            break;
+        }
+
+        uint64_t start_us = get_time_us();
+        if (intended_us) {
+            /* Lag counts from when this user could have sent: the schedule,
+               or the claim when every user was busy at that time */
+            uint64_t ready_us = intended_us > claimed_us ? intended_us : claimed_us;
+            engine_record_queue_delay(engine, start_us > intended_us ? start_us - intended_us : 0);
+            engine_record_series(engine, ENGINE_SERIES_SCHEDULER_LAG, start_us > ready_us ? start_us - ready_us : 0);
+        }
+
+        bool own_headers = engine_param_expand(engine, &scratch, &request, worker->thread_id);
+        request_template_apply(curl, &engine->templates.templates[request.template_id], &request);
+        if (own_headers) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, scratch.headers);
+        engine_apply_http_version(engine, curl);
+        response_match_reset(&match);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, on_body);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &match);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, on_header);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &match);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+        if (!keep_alive) {
+            /* The multi handle would otherwise keep the connection for the next request */
+            curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 1L);
+            curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L);
+        }
+
+        /* A drain lets this transfer finish; an abort drops it unrecorded */
+        bool aborted = false;
+        CURLcode res = engine_perform(engine, multi, curl, &aborted);
+        uint64_t response_time = get_time_us() - (intended_us ? intended_us : start_us);
+
+        if (!aborted) {
+            long response_code = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+            engine_record_checked_result(engine, request.label_id, response_time, response_code, res, &match);
+            engine_record_phases(engine, curl);
+        }
+    }
+
+    if (curl) curl_easy_cleanup(curl);
+    if (multi) curl_multi_cleanup(multi);
+    engine_param_scratch_free(&scratch);
+    engine_thread_exit(engine);
+    return NULL;
+}
+
+void engine_load_test_options_init(load_test_options_t* options) {
+    if (!options) return;
+
+    memset(options, 0, sizeof(load_test_options_t));
+    options->concurrent_users = 10;
+    options->duration_seconds = 60;
+    options->connection_mode = CONNECTION_MODE_PER_REQUEST;
+    options->loop_requests = false;
+    options->stages = NULL;
+    options->num_stages = 0;
+    options->arrival_mode = ARRIVAL_MODE_CLOSED;
+    options->arrival_rate = 0.0;
+    options->arrival_seed = 0;
+    options->replay_speed = 1.0;
+}
+
+int engine_start_load_test(engine_t* engine, const http_request_t* requests, int num_requests, int concurrent_users, int duration_seconds) {
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = concurrent_users;
+    options.duration_seconds = duration_seconds;
+    return engine_start_load_test_with_options(engine, requests, num_requests, &options);
+}
+
+int engine_start_load_test_with_options(engine_t* engine, const http_request_t* requests, int num_requests, const load_test_options_t* options) {
+    if (!engine || !requests || num_requests <= 0 || !options || options->concurrent_users <= 0) return -1;
+
+    request_table_t table;
+    request_table_init(&table);
+    for (int i = 0; i < num_requests; i++) {
+        const http_request_t* r = &requests[i];
+        if (request_table_add(&table, r->method, r->url, r->headers, r->body,
+                              strnlen(r->body, sizeof(r->body)), r->timeout_ms) < 0) {
+            request_table_free(&table);
+            return -1;
+        }
+    }
+
+    int rc = engine_start_load_test_table(engine, &table, options);
+    request_table_free(&table);
+    return rc;
+}
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Poisson arrivals: each claim draws its own exponential gap from a
+   per-thread stream, and the gaps are summed on one shared atomic clock. */
+static atomic_uint arrival_stream_counter;
+static _Thread_local uint64_t arrival_rng_state;
+
+static uint64_t arrival_gap_ns(engine_t* engine) {
+    if (arrival_rng_state == 0) {
+        uint64_t stream = atomic_fetch_add_explicit(&arrival_stream_counter, 1, memory_order_relaxed) + 1;
+        arrival_rng_state = engine->arrival_seed ^ (stream * 0xd1b54a32d192ed03ULL);
+    }
+    /* -ln(U) * mean with U uniform in (0, 1] */
+    double u = ((double)(splitmix64(&arrival_rng_state) >> 11) + 1.0) / 9007199254740992.0;
+    return (uint64_t)(-log(u) * engine->arrival_interval_us * 1000.0);
+}
+
+bool engine_next_request(engine_t* engine, request_view_t* view, uint64_t* intended_us) {
+    const request_table_t* table = engine->load_requests;
+    replay_log_t* replay = engine->load_replay;
+    uint64_t seq = atomic_fetch_add_explicit(&engine->next_request, 1, memory_order_relaxed);
+    if ((!table && !replay) || seq >= engine->dispatch_limit) return false;
+
+    uint64_t index = engine->test_options.loop_requests ? seq % engine->request_count : seq;
+    uint64_t recorded_us = 0;
+    if (replay) {
+        if (replay_log_get(replay, index, view, &recorded_us) != 0) return false;
+        view->label_id = engine->request_labels[view->label_id];
+    } else {
+        if (request_table_get(table, (int)index, view) != 0) return false;
+        view->template_id = engine->templates.by_request[index];
+        view->label_id = engine->request_labels[index];
+        if (view->timestamp_us > engine->recorded_origin_us) {
+            recorded_us = (uint64_t)(view->timestamp_us - engine->recorded_origin_us);
+        }
     }
 
-    /* Percentile computation from histogram */
-    if (metrics->total_requests > 0) {
-        uint64_t p95_target = (uint64_t)(metrics->total_requests * 0.95);
-        uint64_t p99_target = (uint64_t)(metrics->total_requests * 0.99);
-        uint64_t cumulative = 0;
-        bool p95_set = false, p99_set = false;
-
-        for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
-            cumulative += metrics->histogram_buckets[i];
-            if (!p95_set && cumulative >= p95_target) {
-                metrics->p95_us = (uint64_t)(i + 1) * 1000;
-                p95_set = true;
-            }
-            if (!p99_set && cumulative >= p99_target) {
-                metrics->p99_us = (uint64_t)(i + 1) * 1000;
-                p99_set = true;
-                break;
-            }
+    *intended_us = 0;
+    if (engine->test_options.arrival_mode != ARRIVAL_MODE_CLOSED) {
+        uint64_t offset_us;
+        if (engine->test_options.arrival_mode == ARRIVAL_MODE_POISSON) {
+            offset_us = atomic_fetch_add_explicit(&engine->next_arrival_ns, arrival_gap_ns(engine),
+                                                  memory_order_relaxed) / 1000;
+        } else if (engine->test_options.arrival_mode == ARRIVAL_MODE_RECORDED) {
+            double pass_us = (double)(seq / engine->request_count) * engine->recorded_cycle_us;
+            offset_us = (uint64_t)((pass_us + (double)recorded_us) / engine->test_options.replay_speed);
+        } else {
+            offset_us = (uint64_t)((double)seq * engine->arrival_interval_us);  /* no accumulated drift */
         }
-        /* If not set (all in overflow bucket), use max */
-        if (!p95_set) metrics->p95_us = metrics->max_response_time_us;
-        if (!p99_set) metrics->p99_us = metrics->max_response_time_us;
-    } else {
-        metrics->p95_us = 0;
-        metrics->p99_us = 0;
+        /* the schedule ends with the test rather than waiting for later arrivals */
+        if (offset_us >= engine->arrival_limit_us) return false;
+        *intended_us = engine->test_start_us + offset_us;
     }
 
-    pthread_mutex_unlock(&engine->metrics_mutex);
+    view->sequence = seq;
+
+    /* The last request is out: the controller can end the test now */
+    if (seq + 1 == engine->dispatch_limit) engine_wake_controller(engine);
+    return true;
 }
 
-void engine_reset_metrics(engine_t* engine) {
-    if (!engine) return;
-    
-    pthread_mutex_lock(&engine->metrics_mutex);
-    memset(&engine->metrics, 0, sizeof(metrics_t));
-    pthread_mutex_unlock(&engine->metrics_mutex);
+int engine_param_scratch_init(engine_t* engine, param_scratch_t* scratch) {
+    memset(scratch, 0, sizeof(param_scratch_t));
+    if (!engine->params.data) return 0;
+    scratch->buffer = malloc(engine->params.max_expanded ? engine->params.max_expanded : 1);
+    if (engine->params.max_header_lines > 0) {
+        scratch->nodes = malloc(sizeof(struct curl_slist) * (size_t)engine->params.max_header_lines);
+    }
+    if (!scratch->buffer || (engine->params.max_header_lines > 0 && !scratch->nodes)) {
+        engine_param_scratch_free(scratch);
+        return -1;
+    }
+    return 0;
 }
 
-static void* load_test_worker_func(void* arg) {
-    worker_thread_t* worker = (worker_thread_t*)arg;
-    if (!worker || !worker->engine) return NULL;
-    engine_t* engine = worker->engine;
+void engine_param_scratch_free(param_scratch_t* scratch) {
+    free(scratch->buffer);
+    free(scratch->nodes);
+    memset(scratch, 0, sizeof(param_scratch_t));
+}
 
-    while (!atomic_load(&engine->stop_flag)) {
-        pthread_mutex_lock(&engine->queue_mutex);
+bool engine_param_expand(engine_t* engine, param_scratch_t* scratch, request_view_t* request, int user) {
+    const param_plans_t* plans = &engine->params;
+    if (!plans->data || !scratch->buffer || !param_plan_active(plans, request->index)) return false;
 
-        if (engine->queue_head == engine->queue_tail) {
-            pthread_mutex_unlock(&engine->queue_mutex);
-            break;  /* queue empty — this worker is done */
-        }
+    uint32_t row = param_row(plans, request->sequence / engine->request_count, user);
+    param_expand(plans, request, row, scratch->buffer);
+    if (!plans->plans[request->index].headers.count) return false;
 
-        http_request_t request = engine->request_queue[engine->queue_head];
-        engine->queue_head = (engine->queue_head + 1) % engine->queue_size;
-        pthread_mutex_unlock(&engine->queue_mutex);
+    /* The block is ours to split: param_expand() just wrote it into scratch */
+    scratch->headers = request_headers_split((char*)request->headers, request->headers_len,
+                                             scratch->nodes, plans->max_header_lines);
+    return true;
+}
 
-        http_response_t response;
-        memset(&response, 0, sizeof(response));
+/* Validate the stage list; returns the test duration in seconds and the
+   largest user count it reaches, or -1 if it is unusable. */
+static int load_profile_check(const load_test_options_t* options, int* max_users) {
+    if (options->num_stages <= 0 || !options->stages) {
+        *max_users = options->concurrent_users;
+        return options->duration_seconds;
+    }
 
-        CURL* curl = curl_easy_init();
-        if (!curl) {
-            pthread_mutex_lock(&engine->metrics_mutex);
-            engine->metrics.failed_requests++;
-            pthread_mutex_unlock(&engine->metrics_mutex);
-            continue;
+    int total = 0;
+    *max_users = 0;
+    for (int i = 0; i < options->num_stages; i++) {
+        const load_stage_t* stage = &options->stages[i];
+        if (stage->target_users < 0 || stage->duration_seconds < 0 ||
+            (stage->ramp != STAGE_RAMP_LINEAR && stage->ramp != STAGE_RAMP_STEP) ||
+            stage->target_users > MAX_CONNECTIONS || total > INT32_MAX - stage->duration_seconds) {
+            return -1;
         }
+        total += stage->duration_seconds;
+        if (stage->target_users > *max_users) *max_users = stage->target_users;
+    }
+    return (total > 0 && *max_users > 0) ? total : -1;
+}
 
-        response_buffer_t buffer = {0};
-        buffer.data = malloc(MAX_BODY_LENGTH);
-        if (!buffer.data) { curl_easy_cleanup(curl); continue; }
-        buffer.capacity = MAX_BODY_LENGTH;
-        buffer.data[0] = '\0';
+/* Active users `elapsed_us` into a staged test */
+static int load_profile_users(const load_test_options_t* options, uint64_t elapsed_us) {
+    int previous = 0;
+    uint64_t stage_start_us = 0;
+    for (int i = 0; i < options->num_stages; i++) {
+        const load_stage_t* stage = &options->stages[i];
+        uint64_t stage_us = (uint64_t)stage->duration_seconds * 1000000;
+        if (elapsed_us < stage_start_us + stage_us) {
+            if (stage->ramp == STAGE_RAMP_STEP) return stage->target_users;
+            double progress = (double)(elapsed_us - stage_start_us) / (double)stage_us;
+            double users = previous + (stage->target_users - previous) * progress;
+            /* round towards the target so a ramp starts moving immediately */
+            return (int)(stage->target_users >= previous ? ceil(users) : floor(users));
+        }
+        previous = stage->target_users;
+        stage_start_us += stage_us;
+    }
+    return previous;
+}
 
-        header_buffer_t headers = {0};
-        headers.data = malloc(MAX_HEADER_LENGTH);
-        if (!headers.data) { free(buffer.data); curl_easy_cleanup(curl); continue; }
-        headers.capacity = MAX_HEADER_LENGTH;
-        headers.data[0] = '\0';
+/* Publish a new active-user count and wake users it re-activates */
+static void engine_set_active_users(engine_t* engine, int users) {
+    pthread_mutex_lock(&engine->users_mutex);
+    int previous = atomic_exchange(&engine->active_users, users);
+    if (users > previous) pthread_cond_broadcast(&engine->users_cond);
+    pthread_mutex_unlock(&engine->users_mutex);
+}
 
-        uint64_t start_us = get_time_us();
+/* Raise stop_flag to `how` and release every parked user */
+static void engine_stop_users(engine_t* engine, int how) {
+    engine_raise_stop(engine, how);
+    pthread_mutex_lock(&engine->users_mutex);
+    pthread_cond_broadcast(&engine->users_cond);
+    pthread_mutex_unlock(&engine->users_mutex);
+}
 
-        curl_easy_setopt(curl, CURLOPT_URL, request.url);
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request.method);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
-        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
-        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &headers);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, request.timeout_ms > 0 ? request.timeout_ms : 30000);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+int engine_stop(engine_t* engine) {
+    if (!engine) return -1;
+
+    /* load_test_active and the reset of stop_flag change together under
+       queue_mutex, so a stop that gets in cannot be undone by the start */
+    pthread_mutex_lock(&engine->queue_mutex);
+    bool running = engine->load_test_active;
+    if (running) engine_stop_users(engine, ENGINE_STOP_ABORT);
+    pthread_mutex_unlock(&engine->queue_mutex);
+    return running ? 0 : -1;
+}
+
+int engine_claim(engine_t* engine) {
+    if (!engine) return -1;
+    pthread_mutex_lock(&engine->queue_mutex);
+    bool busy = engine->test_claimed || engine->load_test_active;
+    if (!busy) engine->test_claimed = true;
+    pthread_mutex_unlock(&engine->queue_mutex);
+    if (busy) errno = EBUSY;
+    return busy ? -1 : 0;
+}
+
+void engine_release(engine_t* engine) {
+    if (!engine) return;
+    pthread_mutex_lock(&engine->queue_mutex);
+    engine->test_claimed = false;
+    pthread_mutex_unlock(&engine->queue_mutex);
+}
 
-        if (strlen(request.body) > 0) {
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body);
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, strlen(request.body));
+static uint64_t label_hash(const char* name) {
+    uint64_t hash = 1469598103934665603ULL;  /* FNV-1a */
+    for (const char* p = name; *p; p++) {
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Map every request to a label, registering new names. Labels are never
+   renumbered, so metrics keep accumulating per name across tests; names
+   beyond the limit all report as "(other)". */
+static int engine_resolve_labels(engine_t* engine, const request_table_t* requests) {
+    engine->request_labels = malloc(sizeof(int) * (size_t)requests->count);
+    int buckets[ENGINE_MAX_LABELS * 2];   /* label index, -1 = empty */
+    if (!engine->request_labels) return -1;
+    memset(buckets, 0xff, sizeof(buckets));
+
+    pthread_mutex_lock(&engine->labels_mutex);
+    for (int l = 0; l < engine->label_count; l++) {
+        size_t slot = (size_t)label_hash(engine->label_names[l]) & (ENGINE_MAX_LABELS * 2 - 1);
+        while (buckets[slot] >= 0) slot = (slot + 1) & (ENGINE_MAX_LABELS * 2 - 1);
+        buckets[slot] = l;
+    }
+
+    int result = 0;
+    for (int i = 0; i < requests->count; i++) {
+        request_view_t request;
+        char name[ENGINE_LABEL_NAME_MAX];
+        request_table_get(requests, i, &request);
+        request_label_name(&request, name, sizeof(name));
+
+        size_t slot = (size_t)label_hash(name) & (ENGINE_MAX_LABELS * 2 - 1);
+        int found = -1;
+        while (buckets[slot] >= 0) {
+            if (strcmp(engine->label_names[buckets[slot]], name) == 0) {
+                found = buckets[slot];
+                break;
+            }
+            slot = (slot + 1) & (ENGINE_MAX_LABELS * 2 - 1);
         }
 
-        struct curl_slist* header_list = NULL;
-        if (strlen(request.headers) > 0) {
-            char* header_copy = strdup(request.headers);
-            if (header_copy) {
-                char* token = strtok(header_copy, "\n");
-                while (token) {
-                    header_list = curl_slist_append(header_list, token);
-                    token = strtok(NULL, "\n");
+        if (found < 0 && engine->label_count < ENGINE_LABEL_OTHER) {
+            char* copy = strdup(name);
+            if (!copy) {
+                result = -1;
+                break;
+            }
+            found = engine->label_count++;
+            engine->label_names[found] = copy;
+            buckets[slot] = found;
+        } else if (found < 0) {
+            if (engine->label_count == ENGINE_LABEL_OTHER) {
+                char* other = strdup("(other)");
+                if (!other) {
+                    result = -1;
+                    break;
                 }
-                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
-                free(header_copy);
+                engine->label_names[engine->label_count++] = other;
             }
+            found = ENGINE_LABEL_OTHER;
         }
+        engine->request_labels[i] = found;
+    }
+    pthread_mutex_unlock(&engine->labels_mutex);
+
+    if (result != 0) {
+        free(engine->request_labels);
+        engine->request_labels = NULL;
+    }
+    return result;
+}
 
-        CURLcode res = curl_easy_perform(curl);
-        /* stop_flag=1 does not abort an in-flight perform; it only prevents the next request */
-        uint64_t response_time = get_time_us() - start_us;
+/* Drop what engine_run_http_test() derived from the requests */
+static void engine_release_test_requests(engine_t* engine) {
+    param_plans_free(&engine->params);
+    request_templates_free(&engine->templates);
+    free(engine->request_labels);
+    engine->request_labels = NULL;
+}
 
-        long response_code = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+/* One controller tick: close the metrics window if it is due, then sleep
+   50ms, until the next window closes or until deadline_us (0 = none),
+   whichever comes first. engine_wake_controller() ends the sleep early, so
+   a stop or the end of the work is acted on at once rather than next tick. */
+static void engine_controller_wait(engine_t* engine, uint64_t now_us, uint64_t deadline_us) {
+    uint64_t wait_us = 50000;
+    if (engine->windows) {
+        uint64_t window_end_us = engine->window_start_us + engine->window_interval_us;
+        if (now_us >= window_end_us) {
+            engine_window_close(engine, now_us);
+            window_end_us = now_us + engine->window_interval_us;
+        }
+        if (window_end_us - now_us < wait_us) wait_us = window_end_us - now_us;
+    }
+    if (deadline_us > now_us && deadline_us - now_us < wait_us) wait_us = deadline_us - now_us;
 
-        bool success = (res == CURLE_OK && response_code >= 200 && response_code < 400);
-        update_metrics(engine, response_time, success);
+    uint64_t until_us = now_us + wait_us;
+    struct timespec until;
+    until.tv_sec = (time_t)(until_us / 1000000);
+    until.tv_nsec = (long)(until_us % 1000000) * 1000;
 
-        if (header_list) curl_slist_free_all(header_list);
-        curl_easy_cleanup(curl);
-        free(buffer.data);
-        free(headers.data);
+    pthread_mutex_lock(&engine->control_mutex);
+    while (!engine->control_wake) {
+        if (pthread_cond_timedwait(&engine->control_cond, &engine->control_mutex, &until) == ETIMEDOUT) break;
     }
+    engine->control_wake = false;
+    pthread_mutex_unlock(&engine->control_mutex);
+}
 
-    return NULL;
+/* Threaded mode: make sure users 0..wanted-1 have a thread */
+static int spawn_test_workers(engine_t* engine, worker_thread_t* workers, int spawned, int wanted) {
+    for (int i = spawned; i < wanted; i++) {
+        workers[i].engine    = engine;
+        workers[i].thread_id = i;
+        workers[i].active    = pthread_create(&workers[i].thread, NULL, load_test_worker_func, &workers[i]) == 0;
+    }
+    return wanted > spawned ? wanted : spawned;
 }
 
-int engine_start_load_test(engine_t* engine, const http_request_t* requests, int num_requests, int concurrent_users, int duration_seconds) {
-    if (!engine || !requests || num_requests <= 0 || concurrent_users <= 0) return -1;
+/* Templates and labels of a replay log: both were grouped when the log was
+   converted, so this is one entry per template and per label name */
+static int engine_compile_replay(engine_t* engine, const replay_log_t* log) {
+    int count = log->info.templates;
+    request_view_t* shapes = malloc(sizeof(request_view_t) * (size_t)count);
+    if (!shapes) return -1;
+    int result = 0;
+    for (int i = 0; i < count && result == 0; i++) result = replay_log_template(log, i, &shapes[i]);
+    if (result == 0) result = request_templates_build(&engine->templates, shapes, count);
+    free(shapes);
+    if (result != 0) return -1;
+
+    request_table_t names;
+    request_table_init(&names);
+    for (int i = 0; i < log->info.labels && result == 0; i++) {
+        if (request_table_add_labeled(&names, "GET", "", NULL, NULL, 0, 0, replay_log_label(log, i)) < 0) result = -1;
+    }
+    if (result == 0) result = engine_resolve_labels(engine, &names);
+    request_table_free(&names);
+    if (result != 0) request_templates_free(&engine->templates);
+    return result;
+}
 
-    /* 1. Resize queue to hold all requests, fill it, and block pool workers */
-    pthread_mutex_lock(&engine->queue_mutex);
+/* ARRIVAL_MODE_RECORDED over a table: every request needs a timestamp.
+   Sets *origin_us and returns the recorded span, or -1. */
+static int64_t recorded_table_span(const request_table_t* requests, int64_t* origin_us) {
+    int64_t first = requests->entries[0].timestamp_us;
+    int64_t last = first;
+    for (int i = 0; i < requests->count; i++) {
+        int64_t ts = requests->entries[i].timestamp_us;
+        if (ts < 0) return -1;
+        if (ts > last) last = ts;
+    }
+    *origin_us = first;
+    return last > first ? last - first : 0;
+}
+
+/* Body of engine_start_load_test_table() and engine_start_replay_test():
+   exactly one of requests and log is set */
+static int engine_run_http_test(engine_t* engine, const request_table_t* requests, replay_log_t* log,
+                                const load_test_options_t* options) {
+    if (!options || options->concurrent_users <= 0) return -1;
+    bool recorded = options->arrival_mode == ARRIVAL_MODE_RECORDED;
+    if ((options->arrival_mode == ARRIVAL_MODE_CONSTANT || options->arrival_mode == ARRIVAL_MODE_POISSON) &&
+        !(options->arrival_rate > 0.0)) {
+        return -1;
+    }
+    if (recorded && !(options->replay_speed > 0.0)) return -1;
+    if (!engine_http_version_supported(options->http_version) || options->max_streams < 0) return -1;
+    /* A replay log's requests are already final */
+    if (options->data && log) return -1;
+    if (options->num_assertions < 0 || options->num_assertions > RESPONSE_ASSERT_MAX ||
+        (options->num_assertions > 0 && !options->assertions)) {
+        return -1;
+    }
+    for (int i = 0; i < options->num_assertions; i++) {
+        response_assert_t assertion = options->assertions[i];
+        if (response_assert_prepare(&assertion) != 0) return -1;
+    }
+
+    uint64_t request_count = log ? log->info.requests : (uint64_t)requests->count;
+    int64_t span_us = 0;
+    int64_t origin_us = 0;
+    if (recorded) {
+        span_us = log ? (log->info.timestamps ? (int64_t)log->info.span_us : -1) : recorded_table_span(requests, &origin_us);
+        if (span_us < 0) return -1;
+    }
 
-    if (num_requests > engine->queue_size - 1) {
-        http_request_t* new_queue = realloc(engine->request_queue,
-                                            sizeof(http_request_t) * (num_requests + 1));
-        if (!new_queue) {
-            pthread_mutex_unlock(&engine->queue_mutex);
+    int max_users = 0;
+    int duration_seconds = load_profile_check(options, &max_users);
+    if (duration_seconds < 0) return -1;
+    bool staged = options->num_stages > 0;
+    bool looping = options->loop_requests;
+    /* Looping, staged and open-model tests end when their time is up; a
+       plain closed-model test, or a recorded replay without a duration,
+       ends when its requests run out */
+    bool timed = looping || staged ||
+                 (options->arrival_mode != ARRIVAL_MODE_CLOSED && (!recorded || duration_seconds > 0));
+    if (looping && duration_seconds <= 0) return -1;
+
+    /* 1. Take the engine, compile request templates, resolve labels and
+          publish the requests. Workers are created after this, so
+          pthread_create orders these writes for them. */
+    if (engine_begin_test(engine) != 0) return -1;
+    engine->recorded_origin_us = origin_us;
+    if (log) {
+        if (engine_compile_replay(engine, log) != 0) {
+            engine_end_test(engine);
+            return -1;
+        }
+    } else {
+        if (request_templates_compile(&engine->templates, requests) != 0) {
+            engine_end_test(engine);
+            return -1;
+        }
+        if (engine_resolve_labels(engine, requests) != 0) {
+            request_templates_free(&engine->templates);
+            engine_end_test(engine);
+            return -1;
+        }
+        if (options->data &&
+            param_plans_compile(&engine->params, requests, options->data, options->data_strategy,
+                                options->data_seed ? options->data_seed : get_time_us()) != 0) {
+            engine_release_test_requests(engine);
+            engine_end_test(engine);
             return -1;
         }
-        engine->request_queue = new_queue;
-        engine->queue_size    = num_requests + 1;
     }
 
-    engine->queue_head = 0;
-    engine->queue_tail = 0;
-    for (int i = 0; i < num_requests; i++) {
-        memcpy(&engine->request_queue[engine->queue_tail], &requests[i], sizeof(http_request_t));
-        engine->queue_tail = (engine->queue_tail + 1) % engine->queue_size;
+    /* The assertions' counts start over with their definitions */
+    pthread_mutex_lock(&engine->labels_mutex);
+    for (int i = 0; i < options->num_assertions; i++) {
+        engine->assertions[i] = options->assertions[i];
+        response_assert_prepare(&engine->assertions[i]);
+    }
+    engine->assertion_count = options->num_assertions;
+    pthread_mutex_unlock(&engine->labels_mutex);
+    for (int s = 0; s < engine->metric_shard_count; s++) {
+        atomic_store_explicit(&engine->metric_shards[s].assertion_checks, 0, memory_order_relaxed);
+        for (int i = 0; i < RESPONSE_ASSERT_MAX; i++) {
+            atomic_store_explicit(&engine->metric_shards[s].assertion_failures[i], 0, memory_order_relaxed);
+        }
     }
 
-    atomic_store(&engine->stop_flag, 0);
-    engine->load_test_active = true;
+    pthread_mutex_lock(&engine->queue_mutex);
+
+    engine->load_requests = requests;
+    engine->load_replay = log;
+    engine->request_count = request_count;
+    engine->dispatch_limit = looping ? UINT64_MAX : request_count;
+    /* Unique rows: one pass of the table per data row at most */
+    if (options->data && options->data_strategy == PARAM_ROWS_UNIQUE &&
+        (uint64_t)options->data->row_count * request_count < engine->dispatch_limit) {
+        engine->dispatch_limit = (uint64_t)options->data->row_count * request_count;
+    }
+    atomic_store(&engine->next_request, 0);
+    engine->arrival_interval_us = options->arrival_mode == ARRIVAL_MODE_CONSTANT ||
+                                  options->arrival_mode == ARRIVAL_MODE_POISSON ? 1000000.0 / options->arrival_rate : 0.0;
+    /* A looping replay starts its next pass one average gap after the last request */
+    engine->recorded_cycle_us = request_count > 1 && span_us > 0
+                                ? (double)span_us * (double)request_count / (double)(request_count - 1) : 1000000.0;
+    engine->arrival_limit_us = duration_seconds > 0 ? (uint64_t)duration_seconds * 1000000 : UINT64_MAX;
+    engine->arrival_seed = options->arrival_seed ? options->arrival_seed : get_time_us();
+    atomic_store(&engine->next_arrival_ns, 0);
+    engine->test_options = *options;  /* the caller's stage array outlives this call */
 
     pthread_mutex_unlock(&engine->queue_mutex);
 
-    /* 2. Record wall-clock start for RPS calculation */
+    /* Without looping, users beyond the request count would have nothing to do */
+    if (!looping && (uint64_t)max_users > engine->dispatch_limit) max_users = (int)request_count;
+    engine->test_users = max_users;
+    int initial_users = staged ? load_profile_users(options, 0) : max_users;
+    atomic_store(&engine->active_users, initial_users < max_users ? initial_users : max_users);
+
+    /* 2. Record wall-clock start for RPS calculation, and the monotonic
+          origin of the arrival schedule */
     gettimeofday(&engine->test_start_time, NULL);
+    engine->test_start_us = get_time_us();
+    engine_window_begin(engine, engine->test_start_us);
+    engine_health_begin(engine);
+
+    /* 3. Spawn worker threads for the active users (more join in place as a
+          staged profile ramps up), or hand the table to the event loops,
+          which multiplex all users over a few threads */
+    worker_thread_t* test_workers = NULL;
+    event_loop_group_t* loops = NULL;
+    int spawned = 0;
 
-    /* 3. Spawn per-test worker threads (capped at num_requests) */
-    int actual_workers = (concurrent_users < num_requests) ? concurrent_users : num_requests;
-    worker_thread_t* test_workers = malloc(sizeof(worker_thread_t) * actual_workers);
-    if (!test_workers) {
-        pthread_mutex_lock(&engine->queue_mutex);
-        engine->load_test_active = false;
-        pthread_mutex_unlock(&engine->queue_mutex);
-        return -1;
-    }
+    if (engine->mode == ENGINE_MODE_EVENT) {
+        loops = event_loop_start(engine, max_users);
+        if (!loops) {
+            engine_end_test(engine);
+            engine_release_test_requests(engine);
+            return -1;
+        }
+    } else {
+        test_workers = malloc(sizeof(worker_thread_t) * max_users);
+        if (!test_workers) {
+            engine_end_test(engine);
+            engine_release_test_requests(engine);
+            return -1;
+        }
 
-    int spawned = 0;
-    for (int i = 0; i < actual_workers; i++) {
-        test_workers[i].engine    = engine;
-        test_workers[i].thread_id = i;
-        test_workers[i].active    = true;
-        if (pthread_create(&test_workers[i].thread, NULL, load_test_worker_func, &test_workers[i]) != 0) {
-            test_workers[i].active = false;
-        } else {
-            spawned++;
+        spawned = spawn_test_workers(engine, test_workers, 0, atomic_load(&engine->active_users));
+        bool any = false;
+        for (int i = 0; i < spawned; i++) any = any || test_workers[i].active;
+        if (spawned > 0 && !any) {
+            engine_end_test(engine);
+            engine_release_test_requests(engine);
+            free(test_workers);
+            return -1;
         }
     }
 
-    if (spawned == 0) {
-        pthread_mutex_lock(&engine->queue_mutex);
-        engine->load_test_active = false;
-        pthread_mutex_unlock(&engine->queue_mutex);
-        free(test_workers);
-        return -1;
+    /* 4. Follow the load profile until the requests run out or the test's
+          time is up; untimed tests get a hard stop at duration + 5s (or
+          5s after a recorded replay's last arrival) */
+    uint64_t duration_us = (uint64_t)(duration_seconds > 0 ? duration_seconds : 0) * 1000000;
+    uint64_t schedule_us = duration_us;
+    if (recorded && !looping && (uint64_t)((double)span_us / options->replay_speed) > schedule_us) {
+        schedule_us = (uint64_t)((double)span_us / options->replay_speed);
     }
-
-    /* 4. Wait until queue drains or hard timeout (duration + 5s grace period) */
-    time_t hard_stop = time(NULL) + duration_seconds + 5;
+    uint64_t hard_stop_us = engine->test_start_us + schedule_us + 5000000;
 
     for (;;) {
-        pthread_mutex_lock(&engine->queue_mutex);
-        int empty = (engine->queue_head == engine->queue_tail);
-        pthread_mutex_unlock(&engine->queue_mutex);
-
-        if (empty || time(NULL) >= hard_stop) {
-            /* Signal workers to stop starting new requests */
-            atomic_store(&engine->stop_flag, 1);
+        uint64_t now_us = get_time_us();
+        bool exhausted = atomic_load(&engine->next_request) >= engine->dispatch_limit;
+        bool expired = timed && duration_us > 0 && now_us - engine->test_start_us >= duration_us;
+        bool stopped = atomic_load(&engine->stop_flag);
+
+        if (exhausted || expired || stopped || now_us >= hard_stop_us) {
+            /* Requests already claimed from a finished table still complete;
+               at the time limit whatever is in flight is abandoned */
+            engine_stop_users(engine, exhausted && !expired && now_us < hard_stop_us ? ENGINE_STOP_DRAIN
+                                                                                     : ENGINE_STOP_ABORT);
             break;
         }
 
-        /* Poll every 50ms — avoids busy-wait */
-        struct timeval tv = {0, 50000};
-        select(0, NULL, NULL, NULL, &tv);
+        if (staged) {
+            int users = load_profile_users(options, now_us - engine->test_start_us);
+            if (users > max_users) users = max_users;
+            if (users != atomic_load(&engine->active_users)) {
+                if (test_workers) spawned = spawn_test_workers(engine, test_workers, spawned, users);
+                engine_set_active_users(engine, users);
+            }
+        }
+
+        engine_controller_wait(engine, now_us, timed && duration_us > 0 ? engine->test_start_us + duration_us
+                                                                        : hard_stop_us);
     }
 
-    /* 5. Join all worker threads (each finishes its current in-flight request then exits) */
-    for (int i = 0; i < actual_workers; i++) {
-        if (test_workers[i].active) {
-            pthread_join(test_workers[i].thread, NULL);
+    /* 5. Join all worker threads / event loops (each finishes or drops its in-flight requests, then exits) */
+    if (loops) {
+        event_loop_join(loops);
+    } else {
+        for (int i = 0; i < spawned; i++) {
+            if (test_workers[i].active) {
+                pthread_join(test_workers[i].thread, NULL);
+            }
         }
     }
 
-    /* 6. Unblock persistent pool workers */
+    /* The last window also picks up the requests that were still in flight */
+    engine_window_close(engine, get_time_us());
+    engine_health_end(engine);
+
+    /* 6. Clear the test's stop and unblock persistent pool workers */
     pthread_mutex_lock(&engine->queue_mutex);
+    engine_clear_stop(engine);
     engine->load_test_active = false;
-    pthread_cond_broadcast(&engine->queue_cond);
+    engine->load_requests = NULL;
+    engine->load_replay = NULL;
+    engine->test_options.stages = NULL;
+    engine->test_options.num_stages = 0;
     pthread_mutex_unlock(&engine->queue_mutex);
+    mpmc_queue_wake_all(engine->request_queue);
 
+    engine_release_test_requests(engine);
     free(test_workers);
     return 0;
 }
+
+int engine_start_load_test_table(engine_t* engine, const request_table_t* requests, const load_test_options_t* options) {
+    if (!engine || !requests || requests->count <= 0) return -1;
+    return engine_run_http_test(engine, requests, NULL, options);
+}
+
+int engine_start_replay_test(engine_t* engine, replay_log_t* log, const load_test_options_t* options) {
+    if (!engine || !log || log->info.requests == 0) return -1;
+    return engine_run_http_test(engine, NULL, log, options);
+}
+
+void engine_socket_test_options_init(socket_test_options_t* options) {
+    if (!options) return;
+    memset(options, 0, sizeof(socket_test_options_t));
+    options->protocol = PROTOCOL_TCP;
+    options->connections = 10;
+    options->iterations = 1;
+    options->timeout_ms = 5000;
+}
+
+static int socket_test_check(const socket_test_options_t* options) {
+    if (options->protocol != PROTOCOL_TCP && options->protocol != PROTOCOL_UDP) return -1;
+    if (!options->targets || options->num_targets <= 0 || options->connections <= 0) return -1;
+    if (options->num_steps < 0 || (options->num_steps > 0 && !options->steps)) return -1;
+    /* A UDP flow without steps would never touch the network */
+    if (options->protocol == PROTOCOL_UDP && options->num_steps == 0) return -1;
+    if (options->duration_seconds < 0 || options->iterations < 0) return -1;
+    if (options->duration_seconds == 0 && options->iterations == 0) return -1;
+    if (options->timeout_ms <= 0) return -1;
+
+    for (int i = 0; i < options->num_targets; i++) {
+        const socket_target_t* target = &options->targets[i];
+        if (!target->host || target->host[0] == '\0' || target->port <= 0 || target->port > 65535) return -1;
+    }
+    for (int i = 0; i < options->num_steps; i++) {
+        const socket_step_t* step = &options->steps[i];
+        if (step->type == SOCKET_STEP_EXPECT_BYTES) {
+            if (step->len == 0) return -1;
+        } else if (step->type == SOCKET_STEP_SEND || step->type == SOCKET_STEP_EXPECT_UNTIL) {
+            if (!step->data || step->len == 0) return -1;
+            if (step->type == SOCKET_STEP_EXPECT_UNTIL && step->len >= MAX_BODY_LENGTH) return -1;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int socket_target_resolve(const char* host, int port, int socktype,
+                                 struct sockaddr_storage* addr, socklen_t* addr_len) {
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = socktype;
+    int gai_err = getaddrinfo(host, port_str, &hints, &res);
+    if (gai_err != 0) {
+        fprintf(stderr, "[LoadSpiker] cannot resolve %s: %s\n", host, gai_strerror(gai_err));
+        return -1;
+    }
+    memcpy(addr, res->ai_addr, res->ai_addrlen);
+    *addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+/* Resolve every target once, up front, so the loops never block on DNS */
+static int socket_plan_resolve(socket_plan_t* plan) {
+    const socket_test_options_t* options = &plan->options;
+    plan->addrs = calloc((size_t)options->num_targets, sizeof(struct sockaddr_storage));
+    plan->addr_lens = calloc((size_t)options->num_targets, sizeof(socklen_t));
+    if (!plan->addrs || !plan->addr_lens) return -1;
+
+    int socktype = options->protocol == PROTOCOL_UDP ? SOCK_DGRAM : SOCK_STREAM;
+    for (int i = 0; i < options->num_targets; i++) {
+        if (socket_target_resolve(options->targets[i].host, options->targets[i].port, socktype,
+                                  &plan->addrs[i], &plan->addr_lens[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Register the test's labels: the connect (TCP), then one per step */
+static int socket_plan_labels(engine_t* engine, socket_plan_t* plan) {
+    const socket_test_options_t* options = &plan->options;
+    const char* proto = options->protocol == PROTOCOL_UDP ? "UDP" : "TCP";
+    bool tcp = options->protocol == PROTOCOL_TCP;
+    request_table_t names;
+    request_table_init(&names);
+
+    int result = 0;
+    if (tcp) {
+        char name[ENGINE_LABEL_NAME_MAX];
+        snprintf(name, sizeof(name), "%s connect", proto);
+        if (request_table_add_labeled(&names, proto, "", NULL, NULL, 0, 0, name) < 0) result = -1;
+    }
+    for (int i = 0; i < options->num_steps && result == 0; i++) {
+        const socket_step_t* step = &options->steps[i];
+        char name[ENGINE_LABEL_NAME_MAX];
+        if (step->name && step->name[0] != '\0') {
+            snprintf(name, sizeof(name), "%s", step->name);
+        } else {
+            snprintf(name, sizeof(name), "%s %s #%d", proto,
+                     step->type == SOCKET_STEP_SEND ? "send" : "expect", i + 1);
+        }
+        if (request_table_add_labeled(&names, proto, "", NULL, NULL, 0, 0, name) < 0) result = -1;
+    }
+    if (result == 0) result = engine_resolve_labels(engine, &names);
+    request_table_free(&names);
+    if (result != 0) return -1;
+
+    plan->connect_label = tcp ? engine->request_labels[0] : -1;
+    plan->step_labels = engine->request_labels + (tcp ? 1 : 0);
+    return 0;
+}
+
+int engine_start_socket_test(engine_t* engine, const socket_test_options_t* options) {
+    if (!engine || !options || socket_test_check(options) != 0) return -1;
+
+    socket_plan_t plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.options = *options;
+
+    /* 1. Take the engine; pool workers stay parked while the test runs */
+    if (engine_begin_test(engine) != 0) return -1;
+    if (socket_plan_resolve(&plan) != 0 || socket_plan_labels(engine, &plan) != 0) {
+        engine_end_test(engine);
+        free(plan.addrs);
+        free(plan.addr_lens);
+        return -1;
+    }
+    atomic_store(&engine->active_users, options->connections);
+
+    gettimeofday(&engine->test_start_time, NULL);
+    engine->test_start_us = get_time_us();
+    engine_window_begin(engine, engine->test_start_us);
+    engine_health_begin(engine);
+
+    /* 2. Hand the connections to the socket loops */
+    socket_loop_group_t* loops = socket_loop_start(engine, &plan);
+    int result = loops ? 0 : -1;
+
+    /* 3. Stop starting iterations once the time is up, and let the loops
+          finish the ones in flight */
+    uint64_t duration_us = (uint64_t)options->duration_seconds * 1000000;
+    while (loops && !socket_loop_done(loops)) {
+        uint64_t now_us = get_time_us();
+        if (duration_us > 0 && now_us - engine->test_start_us >= duration_us) {
+            engine_stop_users(engine, ENGINE_STOP_DRAIN);
+        }
+        engine_controller_wait(engine, now_us, duration_us > 0 ? engine->test_start_us + duration_us : 0);
+    }
+    socket_loop_join(loops);
+    engine_window_close(engine, get_time_us());
+    engine_health_end(engine);
+
+    /* 4. Unblock persistent pool workers */
+    engine_end_test(engine);
+
+    engine_release_test_requests(engine);
+    free(plan.addrs);
+    free(plan.addr_lens);
+    return result;
+}
+
+void engine_udp_blast_options_init(udp_blast_options_t* options) {
+    if (!options) return;
+    memset(options, 0, sizeof(udp_blast_options_t));
+    options->flows = 1;
+    options->payload_size = 64;
+    options->duration_seconds = 10;
+    options->batch_size = UDP_BATCH_MAX;
+    options->linger_ms = 1000;
+}
+
+int engine_start_udp_blast(engine_t* engine, const udp_blast_options_t* options, udp_blast_result_t* result) {
+    if (!engine || !options || !result) return -1;
+    if (!options->host || options->host[0] == '\0' || options->port <= 0 || options->port > 65535) return -1;
+    if (options->flows <= 0 || options->duration_seconds <= 0 || options->linger_ms < 0) return -1;
+    if (options->payload_size < 16 || options->payload_size > 65507) return -1;
+    if (options->batch_size < 1 || options->batch_size > 1024 || options->rate_pps < 0.0) return -1;
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+    if (socket_target_resolve(options->host, options->port, SOCK_DGRAM, &addr, &addr_len) != 0) return -1;
+
+    /* 1. Take the engine; pool workers stay parked while the test runs */
+    if (engine_begin_test(engine) != 0) return -1;
+    request_table_t names;
+    request_table_init(&names);
+    int rc = request_table_add_labeled(&names, "UDP", "", NULL, NULL, 0, 0, "UDP echo") < 0 ? -1 :
+             engine_resolve_labels(engine, &names);
+    request_table_free(&names);
+    if (rc != 0) {
+        engine_end_test(engine);
+        return -1;
+    }
+    atomic_store(&engine->active_users, options->flows);
+
+    gettimeofday(&engine->test_start_time, NULL);
+    engine->test_start_us = get_time_us();
+    engine_window_begin(engine, engine->test_start_us);
+    engine_health_begin(engine);
+
+    /* 2. Send for the duration, then let the threads collect late echoes */
+    udp_blast_group_t* blast = udp_blast_start(engine, options, &addr, addr_len, engine->request_labels[0]);
+    uint64_t duration_us = (uint64_t)options->duration_seconds * 1000000;
+    while (blast && !udp_blast_done(blast)) {
+        uint64_t now_us = get_time_us();
+        if (now_us - engine->test_start_us >= duration_us) engine_stop_users(engine, ENGINE_STOP_DRAIN);
+        engine_controller_wait(engine, now_us, duration_us > 0 ? engine->test_start_us + duration_us : 0);
+    }
+    udp_blast_join(blast, result);
+    engine_window_close(engine, get_time_us());
+    engine_health_end(engine);
+
+    if (blast) {
+        uint64_t sent = result->datagrams_sent;
+        result->drop_rate = !options->expect_echo ? -1.0 :
+                            sent && result->datagrams_received < sent ? 1.0 - (double)result->datagrams_received / (double)sent : 0.0;
+    }
+
+    /* 3. Unblock persistent pool workers */
+    engine_end_test(engine);
+
+    engine_release_test_requests(engine);
+    return blast ? 0 : -1;
+}
+
+void engine_mqtt_test_options_init(mqtt_test_options_t* options) {
+    if (!options) return;
+    memset(options, 0, sizeof(mqtt_test_options_t));
+    options->port = 1883;
+    options->topic = "loadspiker/test";
+    options->client_id_prefix = "loadspiker";
+    options->publishers = 10;
+    options->subscribers = 1;
+    options->inflight = 16;
+    options->payload_size = 64;
+    options->duration_seconds = 10;
+    options->timeout_ms = 5000;
+    options->keep_alive_seconds = 60;
+    options->linger_ms = 1000;
+}
+
+static int mqtt_test_check(const mqtt_test_options_t* options) {
+    if (!options->host || options->host[0] == '\0' || options->port <= 0 || options->port > 65535) return -1;
+    if (!options->topic || options->topic[0] == '\0' || strpbrk(options->topic, "+#")) return -1;
+    if (strlen(options->topic) >= MAX_MQTT_TOPIC_LENGTH) return -1;
+    if (options->subscribe_topic && (options->subscribe_topic[0] == '\0' ||
+                                     strlen(options->subscribe_topic) >= MAX_MQTT_TOPIC_LENGTH)) return -1;
+    if (options->client_id_prefix && strlen(options->client_id_prefix) > MAX_MQTT_CLIENT_ID_LENGTH - 32) return -1;
+    if (options->publishers <= 0 || options->subscribers < 0) return -1;
+    if (options->qos < MQTT_QOS_0 || options->qos > MQTT_QOS_2) return -1;
+    if (options->inflight < 1 || options->inflight > 65535) return -1;
+    if (options->payload_size < 16 || options->payload_size > MAX_MQTT_MESSAGE_LENGTH) return -1;
+    if (options->messages < 0 || options->duration_seconds < 0 || options->rate < 0.0) return -1;
+    if (options->messages == 0 && options->duration_seconds == 0) return -1;
+    if (options->timeout_ms <= 0 || options->linger_ms < 0) return -1;
+    if (options->keep_alive_seconds < 0 || options->keep_alive_seconds > 65535) return -1;
+    return 0;
+}
+
+int engine_start_mqtt_test(engine_t* engine, const mqtt_test_options_t* options, mqtt_test_result_t* result) {
+    if (!engine || !options || !result || mqtt_test_check(options) != 0) return -1;
+
+    mqtt_plan_t plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.options = *options;
+    if (!plan.options.subscribe_topic) plan.options.subscribe_topic = options->topic;
+    if (!plan.options.client_id_prefix || plan.options.client_id_prefix[0] == '\0') {
+        plan.options.client_id_prefix = "loadspiker";
+    }
+    if (socket_target_resolve(options->host, options->port, SOCK_STREAM, &plan.addr, &plan.addr_len) != 0) return -1;
+
+    /* 1. Take the engine; pool workers stay parked while the test runs */
+    if (engine_begin_test(engine) != 0) return -1;
+    static const char* const names[] = {"MQTT connect", "MQTT subscribe", "MQTT publish", "MQTT deliver"};
+    request_table_t table;
+    request_table_init(&table);
+    int rc = 0;
+    for (int i = 0; i < 4 && rc == 0; i++) {
+        if (request_table_add_labeled(&table, "MQTT", "", NULL, NULL, 0, 0, names[i]) < 0) rc = -1;
+    }
+    if (rc == 0) rc = engine_resolve_labels(engine, &table);
+    request_table_free(&table);
+    if (rc != 0) {
+        engine_end_test(engine);
+        return -1;
+    }
+    plan.connect_label = engine->request_labels[0];
+    plan.subscribe_label = engine->request_labels[1];
+    plan.publish_label = engine->request_labels[2];
+    plan.deliver_label = engine->request_labels[3];
+
+    atomic_store(&engine->active_users, options->publishers + options->subscribers);
+
+    gettimeofday(&engine->test_start_time, NULL);
+    engine->test_start_us = get_time_us();
+    engine_window_begin(engine, engine->test_start_us);
+    engine_health_begin(engine);
+
+    /* 2. Publish for the duration (or the message count), then let the
+          publishers drain their windows and the subscribers catch up */
+    mqtt_loop_group_t* loops = mqtt_loop_start(engine, &plan);
+    uint64_t duration_us = (uint64_t)options->duration_seconds * 1000000;
+    while (loops && !mqtt_loop_done(loops)) {
+        uint64_t now_us = get_time_us();
+        if (duration_us > 0 && now_us - engine->test_start_us >= duration_us) engine_stop_users(engine, ENGINE_STOP_DRAIN);
+        engine_controller_wait(engine, now_us, duration_us > 0 ? engine->test_start_us + duration_us : 0);
+    }
+    mqtt_loop_join(loops, result);
+    engine_window_close(engine, get_time_us());
+    engine_health_end(engine);
+
+    /* 3. Unblock persistent pool workers */
+    engine_end_test(engine);
+
+    engine_release_test_requests(engine);
+    return loops ? 0 : -1;
+}
+
+void engine_websocket_test_options_init(websocket_test_options_t* options) {
+    if (!options) return;
+    memset(options, 0, sizeof(websocket_test_options_t));
+    options->connections = 100;
+    options->mode = WEBSOCKET_MODE_ROUND_TRIP;
+    options->payload_size = 64;
+    options->duration_seconds = 10;
+    options->timeout_ms = 5000;
+    options->linger_ms = 1000;
+}
+
+static int websocket_test_check(const websocket_test_options_t* options) {
+    if (!options->url) return -1;
+    if (options->connections <= 0 || options->connect_rate < 0.0 || options->rate < 0.0) return -1;
+    if (options->mode != WEBSOCKET_MODE_ROUND_TRIP && options->mode != WEBSOCKET_MODE_RATE) return -1;
+    if (options->payload_size < 32 || options->payload_size > (1 << 20)) return -1;
+    if (options->messages < 0 || options->duration_seconds < 0) return -1;
+    if (options->messages == 0 && options->duration_seconds == 0) return -1;
+    if (options->timeout_ms <= 0 || options->linger_ms < 0) return -1;
+    if (options->subprotocol && strlen(options->subprotocol) >= 256) return -1;
+    if (options->origin && strlen(options->origin) >= 1024) return -1;
+    return 0;
+}
+
+int engine_start_websocket_test(engine_t* engine, const websocket_test_options_t* options,
+                                websocket_test_result_t* result) {
+    if (!engine || !options || !result || websocket_test_check(options) != 0) return -1;
+
+    ws_plan_t plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.options = *options;
+    if (websocket_parse_url(options->url, plan.host, sizeof(plan.host), &plan.port,
+                            plan.resource, sizeof(plan.resource)) != 0) return -1;
+    if (socket_target_resolve(plan.host, plan.port, SOCK_STREAM, &plan.addr, &plan.addr_len) != 0) return -1;
+
+    /* 1. Take the engine; pool workers stay parked while the test runs */
+    if (engine_begin_test(engine) != 0) return -1;
+    static const char* const names[] = {"WS connect", "WS message"};
+    request_table_t table;
+    request_table_init(&table);
+    int rc = 0;
+    for (int i = 0; i < 2 && rc == 0; i++) {
+        if (request_table_add_labeled(&table, "WS", "", NULL, NULL, 0, 0, names[i]) < 0) rc = -1;
+    }
+    if (rc == 0) rc = engine_resolve_labels(engine, &table);
+    request_table_free(&table);
+    if (rc != 0) {
+        engine_end_test(engine);
+        return -1;
+    }
+    plan.connect_label = engine->request_labels[0];
+    plan.message_label = engine->request_labels[1];
+
+    atomic_store(&engine->active_users, options->connections);
+
+    gettimeofday(&engine->test_start_time, NULL);
+    engine->test_start_us = get_time_us();
+    engine_window_begin(engine, engine->test_start_us);
+    engine_health_begin(engine);
+
+    /* 2. Send for the duration (or the message count), then let every
+          connection collect its echoes and close */
+    ws_loop_group_t* loops = ws_loop_start(engine, &plan);
+    uint64_t duration_us = (uint64_t)options->duration_seconds * 1000000;
+    while (loops && !ws_loop_done(loops)) {
+        uint64_t now_us = get_time_us();
+        if (duration_us > 0 && now_us - engine->test_start_us >= duration_us) engine_stop_users(engine, ENGINE_STOP_DRAIN);
+        engine_controller_wait(engine, now_us, duration_us > 0 ? engine->test_start_us + duration_us : 0);
+    }
+    ws_loop_join(loops, result);
+    engine_window_close(engine, get_time_us());
+    engine_health_end(engine);
+
+    /* 3. Unblock persistent pool workers */
+    engine_end_test(engine);
+
+    engine_release_test_requests(engine);
+    return loops ? 0 : -1;
+}
+
+void engine_database_test_options_init(database_test_options_t* options) {
+    if (!options) return;
+    memset(options, 0, sizeof(database_test_options_t));
+    options->connections = 10;
+    options->pipeline_depth = 16;
+    options->duration_seconds = 10;
+    options->timeout_ms = 5000;
+    options->prepared = true;
+}
+
+static int database_test_check(const database_test_options_t* options) {
+    if (!options->connection_string || !options->queries) return -1;
+    if (database_type_from_url(options->connection_string) != DB_TYPE_POSTGRESQL) return -1;
+    if (options->num_queries <= 0 || options->num_queries > DATABASE_TEST_MAX_QUERIES) return -1;
+    for (int i = 0; i < options->num_queries; i++) {
+        if (!options->queries[i] || !options->queries[i][0]) return -1;
+    }
+    if (options->connections <= 0 || options->pipeline_depth <= 0 || options->pipeline_depth > 4096) return -1;
+    if (options->rate < 0.0 || options->iterations < 0 || options->duration_seconds < 0) return -1;
+    if (options->iterations == 0 && options->duration_seconds == 0) return -1;
+    if (options->timeout_ms <= 0) return -1;
+    return 0;
+}
+
+int engine_start_database_test(engine_t* engine, const database_test_options_t* options,
+                               database_test_result_t* result) {
+    if (!engine || !options || !result || database_test_check(options) != 0) return -1;
+    if (!database_driver_available(DB_TYPE_POSTGRESQL)) {
+        fprintf(stderr, "[LoadSpiker] Database test: built without libpq\n");
+        return -1;
+    }
+
+    db_plan_t plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.options = *options;
+
+    /* 1. Take the engine; pool workers stay parked while the test runs */
+    if (engine_begin_test(engine) != 0) return -1;
+    request_table_t table;
+    request_table_init(&table);
+    int rc = request_table_add_labeled(&table, "DB", "", NULL, NULL, 0, 0, "DB connect") < 0 ? -1 : 0;
+    for (int i = 0; i < options->num_queries && rc == 0; i++) {
+        char name[64];
+        if (options->names && options->names[i] && options->names[i][0]) {
+            snprintf(name, sizeof(name), "%s", options->names[i]);
+        } else if (options->num_queries == 1) {
+            snprintf(name, sizeof(name), "DB query");
+        } else {
+            snprintf(name, sizeof(name), "DB query #%d", i + 1);
+        }
+        if (request_table_add_labeled(&table, "DB", "", NULL, NULL, 0, 0, name) < 0) rc = -1;
+    }
+    if (rc == 0) rc = engine_resolve_labels(engine, &table);
+    request_table_free(&table);
+    if (rc != 0) {
+        engine_end_test(engine);
+        return -1;
+    }
+    plan.connect_label = engine->request_labels[0];
+    for (int i = 0; i < options->num_queries; i++) plan.query_labels[i] = engine->request_labels[i + 1];
+
+    atomic_store(&engine->active_users, options->connections);
+
+    gettimeofday(&engine->test_start_time, NULL);
+    engine->test_start_us = get_time_us();
+    engine_window_begin(engine, engine->test_start_us);
+    engine_health_begin(engine);
+
+    /* 2. Query for the duration (or the iterations), then let every
+          connection collect its pending results and close */
+    db_loop_group_t* loops = db_loop_start(engine, &plan);
+    uint64_t duration_us = (uint64_t)options->duration_seconds * 1000000;
+    while (loops && !db_loop_done(loops)) {
+        uint64_t now_us = get_time_us();
+        if (duration_us > 0 && now_us - engine->test_start_us >= duration_us) engine_stop_users(engine, ENGINE_STOP_DRAIN);
+        engine_controller_wait(engine, now_us, duration_us > 0 ? engine->test_start_us + duration_us : 0);
+    }
+    db_loop_join(loops, result);
+    engine_window_close(engine, get_time_us());
+    engine_health_end(engine);
+
+    /* 3. Unblock persistent pool workers */
+    engine_end_test(engine);
+
+    engine_release_test_requests(engine);
+    return loops ? 0 : -1;
+}
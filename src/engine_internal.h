@@ -0,0 +1,513 @@
+#ifndef ENGINE_INTERNAL_H
+#define ENGINE_INTERNAL_H
+
+/*
+ * Private engine definitions shared between engine.c and the engine's
+ * execution back-ends (event_loop.c, socket_loop.c, udp_blast.c,
+ * mqtt_loop.c, ws_loop.c, db_loop.c, request_loop.c). Nothing
+ * in here is part of the public API — include engine.h from protocol code
+ * and bindings instead.
+ */
+
+#include "engine.h"
+#include "metrics_ring.h"
+#include "mpmc_queue.h"
+#include "request_template.h"
+#include <curl/curl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} response_buffer_t;
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} header_buffer_t;
+
+/*
+ * Per-thread metrics shard. The engine has one for each of its pool workers
+ * and back-end loop threads plus ENGINE_METRIC_SHARDS spares; every engine
+ * thread takes a free shard while it runs, so a shard has a single writer
+ * and its cache lines never bounce between cores. Threads from outside the
+ * engine share the spares. Fields are relaxed atomics so a shared shard
+ * (outside threads, or more threaded-mode users than spares) and concurrent
+ * readers stay correct without a lock. engine_get_metrics() merges all
+ * shards.
+ */
+#define ENGINE_METRIC_SHARDS 32
+#define ENGINE_CACHE_LINE 64
+#define ENGINE_LABEL_OTHER (ENGINE_MAX_LABELS - 1)  /* shared by names past the label limit */
+#define ENGINE_DISPATCH_BATCH 8   /* most queued requests a pool worker claims at once */
+
+/* One label's counters within a shard. Its latency counts are allocated on
+   the label's first sample in that shard, so unused (shard, label) pairs
+   cost no histogram. */
+typedef struct {
+    _Atomic uint64_t total_requests;
+    _Atomic uint64_t successful_requests;
+    _Atomic uint64_t failed_requests;
+    _Atomic uint64_t total_response_time_us;
+    _Atomic uint64_t max_response_time_us;
+    _Atomic uint64_t status_classes[6];
+    _Atomic(_Atomic uint64_t*) latency_counts;
+} label_shard_t;
+
+/* The generator's own timings, kept beside the latency histograms: HTTP
+   transfer phases (one series per engine_phase_t), scheduler lag and
+   event-loop iteration time */
+typedef enum {
+    ENGINE_SERIES_SCHEDULER_LAG = ENGINE_PHASES,
+    ENGINE_SERIES_LOOP_ITERATION,
+    ENGINE_SERIES
+} engine_series_t;
+
+/* One series within a shard; like a label's, its counts are allocated on
+   the series' first sample in that shard */
+typedef struct {
+    _Atomic uint64_t total_us;
+    _Atomic uint64_t max_us;
+    _Atomic(_Atomic uint64_t*) counts;
+} series_shard_t;
+
+typedef struct {
+    _Atomic uint64_t total_requests;
+    _Atomic uint64_t successful_requests;
+    _Atomic uint64_t failed_requests;
+    _Atomic uint64_t total_response_time_us;
+    _Atomic uint64_t min_response_time_us;   /* 0 = no sample yet */
+    _Atomic uint64_t max_response_time_us;
+    _Atomic uint64_t* latency_counts;        /* engine->latency_layout.counts_len entries */
+    _Atomic uint64_t max_queue_delay_us;
+    _Atomic uint64_t* queue_delay_counts;    /* same layout; open-model tests only */
+    _Atomic uint64_t status_counts[ENGINE_STATUS_CODES];
+    _Atomic uint64_t error_counts[ENGINE_ERROR_CODES];
+    _Atomic uint64_t assertion_checks;       /* responses checked against the test's assertions */
+    _Atomic uint64_t assertion_failures[RESPONSE_ASSERT_MAX];
+    _Atomic uint64_t http_versions[ENGINE_HTTP_VERSIONS];  /* responses (streams) by HTTP version */
+    _Atomic uint64_t connections_opened;
+    label_shard_t labels[ENGINE_MAX_LABELS];
+    series_shard_t series[ENGINE_SERIES];
+} __attribute__((aligned(ENGINE_CACHE_LINE))) metrics_shard_t;
+
+typedef struct worker_thread {
+    pthread_t thread;
+    engine_t* engine;
+    int thread_id;
+    bool active;
+} worker_thread_t;
+
+struct engine {
+    CURLM* multi_handle;
+    CURLSH* share_handle;     /* DNS, TLS session and connection cache shared by keep-alive users */
+    CURLSH* session_share_handle;  /* DNS and TLS sessions only, for multiplexing event loops */
+    pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+    worker_thread_t* workers;
+    int num_workers;
+    int max_connections;
+    engine_mode_t mode;
+    int event_loops;          /* ENGINE_MODE_EVENT: resolved event-loop thread count */
+
+    metrics_shard_t* metric_shards;  /* metric_shard_count entries, cache-line aligned */
+    int metric_shard_count;          /* num_workers + event_loops + ENGINE_METRIC_SHARDS */
+    _Atomic bool* shard_taken;       /* per shard: held by a live engine thread */
+    _Atomic unsigned next_shared_shard;  /* round-robin for threads without a shard of their own */
+    uint64_t metric_epoch;           /* tells this engine's thread-local shard from an earlier one's */
+    histogram_layout_t latency_layout;
+    _Atomic uint64_t* latency_counts; /* backing store for every shard's latency and queue-delay counts */
+
+    pthread_mutex_t queue_mutex;      /* serializes test start/stop (load_test_active, stop_flag reset) */
+    mpmc_queue_t* request_queue;      /* http_request_t items for the pool workers (engine_execute_request) */
+    _Atomic bool shutdown;            /* pool workers exit; set before waking request_queue's sleepers */
+    _Atomic int stop_flag;    /* cooperative cancel signal: 0 or ENGINE_STOP_DRAIN / ENGINE_STOP_ABORT */
+    int stop_fds[2];          /* pipe, readable once stop_flag reaches ENGINE_STOP_ABORT */
+    _Atomic bool load_test_active;  /* true while a load test is running; pool workers park until it ends */
+    bool test_claimed;        /* engine_claim() holds the engine; under queue_mutex */
+    struct timeval test_start_time;  /* wall-clock time when load test started */
+    load_test_options_t test_options; /* options of the running (or last) load test */
+    const request_table_t* load_requests;  /* caller-owned, read-only during a load test */
+    replay_log_t* load_replay;        /* caller-owned; replaces load_requests for a replay test */
+    uint64_t request_count;           /* requests in load_requests or load_replay */
+    _Atomic uint64_t next_request;    /* dispatch sequence number; also the table index unless looping */
+    uint64_t dispatch_limit;          /* requests this test dispatches; UINT64_MAX when looping */
+    uint64_t test_start_us;           /* get_time_us() at test start; arrival times count from here */
+    double arrival_interval_us;       /* open model: mean gap between arrivals */
+    uint64_t arrival_limit_us;        /* open model: no arrivals at or after this offset */
+    uint64_t arrival_seed;            /* ARRIVAL_MODE_POISSON: resolved PRNG seed */
+    _Atomic uint64_t next_arrival_ns; /* ARRIVAL_MODE_POISSON: offset of the next arrival */
+    int64_t recorded_origin_us;       /* ARRIVAL_MODE_RECORDED: timestamp of the first table request */
+    double recorded_cycle_us;         /* ARRIVAL_MODE_RECORDED: recorded time of one pass when looping */
+    _Atomic int active_users;         /* users 0..n-1 may send; the rest park on users_cond */
+    pthread_mutex_t users_mutex;
+    pthread_cond_t users_cond;
+    pthread_mutex_t control_mutex;    /* leaf lock: guards control_wake */
+    pthread_cond_t control_cond;      /* CLOCK_MONOTONIC; the controller's tick waits here */
+    bool control_wake;                /* set by engine_wake_controller() until the controller wakes */
+    request_templates_t templates;    /* compiled from load_requests (or the log's templates) at test start */
+    int* request_labels;              /* request index (log label id) -> label, resolved at test start */
+    param_plans_t params;             /* options.data's substitution plans; params.data NULL without data */
+    response_assert_t assertions[RESPONSE_ASSERT_MAX];  /* the HTTP test's, copied at test start */
+    int assertion_count;              /* written at test start under labels_mutex */
+
+    /* Label names, append-only so a label keeps its number across tests.
+       Written when a test starts; readers hold labels_mutex. */
+    pthread_mutex_t labels_mutex;
+    char* label_names[ENGINE_MAX_LABELS];
+    int label_count;
+
+    /* Windowed snapshots. The load-test controller thread diffs cumulative
+       shard counts at each window boundary and publishes the difference, so
+       recording threads never see the windows. window_* fields are owned by
+       that thread; consumers only touch the ring. */
+    metrics_ring_t* windows;          /* NULL when metrics_window_ms is 0 */
+    uint64_t window_interval_us;
+    uint64_t window_start_us;         /* get_time_us() at the open window's start */
+    metrics_t window_base;            /* cumulative totals at window_start_us */
+    histogram_t* window_base_counts;  /* cumulative latency counts at window_start_us */
+    histogram_t* window_now_counts;   /* scratch: cumulative counts at the boundary */
+    histogram_t* window_counts;       /* scratch: the closing window's own counts */
+
+    /* Placement and source spreading, copied from engine_config_t */
+    int cpus[ENGINE_MAX_CPUS];
+    int cpu_shards[ENGINE_MAX_CPUS];  /* metrics shard of the threads on cpus[i], on the same node */
+    int cpu_nodes[ENGINE_MAX_CPUS];   /* NUMA node of cpus[i]; -1 unknown or numa_local off */
+    int cpu_count;
+    _Atomic bool pin_warned;
+    char source_interfaces[ENGINE_MAX_SOURCE_ADDRESSES][ENGINE_SOURCE_ADDRESS_MAX + 5];  /* "host!<addr>" */
+    int source_address_count;
+    int source_port_min;
+    int source_port_max;
+    int test_users;                   /* most users the running test reaches; set before they start */
+
+    /* Generator health of the running (or last) test. The health_* values
+       are set by the controller at test start and end and read by any
+       thread; back-end threads add their CPU accounting as they exit. */
+    double saturation_threshold;
+    int health_cpus;                  /* CPUs the process may run on: the pin list, else its affinity */
+    _Atomic uint64_t health_start_us;
+    _Atomic uint64_t health_end_us;   /* 0 while the test runs */
+    _Atomic uint64_t health_cpu_base_us;  /* process user + system time at test start */
+    _Atomic uint64_t health_cpu_end_us;   /* ... and at its end */
+    _Atomic uint64_t health_lock_contended[LOCK_SITES];  /* lock_stats_read() at test start */
+    _Atomic uint64_t health_lock_wait_ns[LOCK_SITES];
+    _Atomic uint64_t health_lock_end_contended[LOCK_SITES];  /* ... and at its end */
+    _Atomic uint64_t health_lock_end_wait_ns[LOCK_SITES];
+    _Atomic int threads_measured;
+    _Atomic uint64_t max_thread_busy_ppm; /* busiest exited thread: CPU time per million of run time */
+
+    /* Non-blocking single requests; created on first use under queue_mutex */
+    struct request_loop* request_loop;
+};
+
+/* libcurl callbacks that fill response_buffer_t / header_buffer_t */
+size_t engine_write_callback(void* contents, size_t size, size_t nmemb, response_buffer_t* buffer);
+size_t engine_header_callback(void* contents, size_t size, size_t nmemb, header_buffer_t* buffer);
+
+/* Pin the calling engine thread (pool worker, user or event loop `index`)
+   per the engine's CPU list (no-op without one) and start its CPU accounting */
+void engine_place_thread(engine_t* engine, int index);
+/* A load-test back-end thread is exiting: add its CPU utilization since
+   engine_place_thread() to the test's generator health */
+void engine_thread_exit(engine_t* engine);
+/* Move memory that thread `index` works on to its CPU's NUMA node */
+void engine_place_memory(engine_t* engine, int index, void* addr, size_t len);
+/* Bind a transfer of user `user` (of `users`) to its source address and ports */
+void engine_bind_source(engine_t* engine, CURL* curl, int user, int users);
+/* Whether the running load test multiplexes HTTP/2 or HTTP/3 streams: an
+   event-mode keep-alive test asking for either */
+bool engine_http_multiplexed(engine_t* engine);
+/* Ask for the running load test's HTTP version on a transfer; multiplexed
+   transfers also wait for a connection that can take another stream rather
+   than open a new one */
+void engine_apply_http_version(engine_t* engine, CURL* curl);
+
+/* Record one completed operation into the calling thread's metrics shard */
+void engine_update_metrics(engine_t* engine, uint64_t response_time_us, bool success);
+
+/* Record one completed HTTP request: latency plus its label (-1 = none),
+   status-code and libcurl error breakdowns */
+void engine_record_http_result(engine_t* engine, int label, uint64_t response_time_us,
+                               long status_code, CURLcode result);
+
+/* Same for a load-test response, first checking it against the test's
+   assertions (match is the transfer's, or NULL when the test has none): a
+   response failing any of them counts as a failure */
+void engine_record_checked_result(engine_t* engine, int label, uint64_t response_time_us,
+                                  long status_code, CURLcode result, const response_match_t* match);
+
+/* Record one socket-test operation: latency, label (-1 = none) and, when it
+   failed, the libcurl error code closest to what went wrong */
+void engine_record_socket_result(engine_t* engine, int label, uint64_t response_time_us, CURLcode result);
+
+/* Count a request that failed before it could be timed (no latency sample) */
+void engine_count_failure(engine_t* engine);
+
+/* Open model: record how late a request was sent relative to its schedule */
+void engine_record_queue_delay(engine_t* engine, uint64_t delay_us);
+
+/* Record one sample of a generator series (phase, scheduler lag, loop iteration) */
+void engine_record_series(engine_t* engine, engine_series_t series, uint64_t value_us);
+
+/* Record the phases of a finished HTTP transfer from the handle's timings,
+   and the HTTP version and new connections it used */
+void engine_record_phases(engine_t* engine, CURL* curl);
+
+/* Event-loop back-ends call this just before each epoll wait, with the
+   time the previous wait returned (0 before the first): the time since is
+   one loop iteration */
+void engine_record_loop_iteration(engine_t* engine, uint64_t woke_us);
+
+/* Claim the next load-test request; false once every request is dispatched
+   (or, in an open-model test, once arrivals pass the test duration).
+   Lock-free: workers race on an atomic sequence number into
+   engine->load_requests (or load_replay), wrapping around when the test
+   loops. The view's template_id and label_id index engine->templates and
+   the engine's labels. *intended_us receives the request's scheduled get_time_us() send time in
+   an open-model test and 0 otherwise. Open-model latency is measured from
+   that instant, not the actual send, so a stalled target cannot hide its
+   backlog (coordinated omission). */
+bool engine_next_request(engine_t* engine, request_view_t* view, uint64_t* intended_us);
+
+/* A sending slot's substitution space (one per worker thread or event-loop
+   transfer), allocated once per test so parameterized requests never
+   allocate. The expanded request lives here until its transfer ends. */
+typedef struct {
+    char* buffer;                     /* engine->params.max_expanded bytes */
+    struct curl_slist* nodes;         /* engine->params.max_header_lines entries */
+    struct curl_slist* headers;       /* the expanded request's header list, built from nodes */
+} param_scratch_t;
+
+/* Both return 0 without allocating when the test has no data */
+int engine_param_scratch_init(engine_t* engine, param_scratch_t* scratch);
+void engine_param_scratch_free(param_scratch_t* scratch);
+
+/* Substitute the data row of a claimed request sent by virtual user `user`
+   into scratch, repointing the view's url, headers and body. Call before
+   request_template_apply(); true means the request's headers had
+   placeholders, so CURLOPT_HTTPHEADER must then be set to scratch->headers. */
+bool engine_param_expand(engine_t* engine, param_scratch_t* scratch, request_view_t* request, int user);
+
+/* Split a '\n'-separated header block (e.g. http_request_t.headers) into a
+   curl_slist whose copy of the block and nodes come from `arena`. When
+   they do not fit, they come from one counted malloc returned in *heap,
+   which the caller frees once the transfer is done (NULL otherwise). */
+struct curl_slist* engine_scratch_headers(scratch_arena_t* arena, const char* headers, void** heap);
+
+/* stop_flag values. Drain stops new requests and lets the ones in flight
+   finish (a fixed request table ran out); abort also abandons in-flight HTTP
+   transfers without recording them (engine_stop(), a timed test's end).
+   ABORT includes the DRAIN bit, so stop_flag stays truthy for both. */
+#define ENGINE_STOP_DRAIN 1
+#define ENGINE_STOP_ABORT 3
+
+static inline bool engine_aborting(engine_t* engine) {
+    return atomic_load_explicit(&engine->stop_flag, memory_order_relaxed) == ENGINE_STOP_ABORT;
+}
+
+/* Cut the load-test controller's current tick short, e.g. because a
+   back-end's threads have all exited or the last request was claimed */
+void engine_wake_controller(engine_t* engine);
+
+/* Users a staged test currently runs are 0..active_users-1 */
+static inline bool engine_user_active(engine_t* engine, int user_id) {
+    return user_id < atomic_load_explicit(&engine->active_users, memory_order_relaxed);
+}
+
+/*
+ * Scaffolding shared by the connection-per-client epoll back-ends
+ * (mqtt_loop.c, ws_loop.c, db_loop.c).
+ */
+#define ENGINE_LOOP_IDLE_WAIT_MS 50   /* longest epoll_wait, so stop_flag and timeouts are seen */
+#define ENGINE_FD_HEADROOM 256        /* descriptors kept free beyond a test's connections */
+
+/* Room for `connections` descriptors plus `headroom`: raise the soft
+   RLIMIT_NOFILE if it is short, and warn (as "<what>: ...") when the hard
+   limit does not allow it */
+void engine_raise_fd_limit(int connections, int headroom, const char* what);
+
+/* Set the epoll interest of fd, registered with data.ptr = ptr, to
+   `events`; *registered caches the current interest so an unchanged one
+   costs no syscall (Linux only) */
+void engine_loop_watch(int epoll_fd, int fd, void* ptr, uint32_t* registered, uint32_t events);
+
+/* Record a socket-test operation that started at start_us and ends now */
+void engine_record_socket_since(engine_t* engine, int label, uint64_t start_us, CURLcode result);
+
+/* A connection's output not written yet: data[off..len) */
+typedef struct {
+    char* data;
+    size_t off;
+    size_t len;
+    size_t cap;
+} out_buffer_t;
+
+/* Room for `need` more bytes at data + len, compacting before growing */
+bool out_buffer_reserve(out_buffer_t* out, size_t need);
+/* Write what the non-blocking socket takes (Linux only). Returns the bytes
+   written, or -1 with errno set on a socket error (not EAGAIN); once
+   everything is out the buffer is empty again. */
+ssize_t out_buffer_send(out_buffer_t* out, int fd);
+static inline size_t out_buffer_pending(const out_buffer_t* out) {
+    return out->len - out->off;
+}
+void out_buffer_free(out_buffer_t* out);
+
+/*
+ * Event-driven load test back-end (event_loop.c).
+ *
+ * event_loop_start() spawns up to engine->event_loops threads, each driving
+ * its share of concurrent_users transfers through curl_multi_socket_action
+ * and epoll. User u belongs to loop u % loops, so a loop only fills the
+ * slots of its currently active users. Loops pull from the request table
+ * until it is exhausted or stop_flag is set, then finish their in-flight
+ * transfers (or drop them, once engine_aborting()) and exit. If any loop
+ * cannot be set up or started, event_loop_start() returns NULL having sent
+ * nothing. event_loop_join() waits for the loops and frees the group.
+ */
+typedef struct event_loop_group event_loop_group_t;
+
+event_loop_group_t* event_loop_start(engine_t* engine, int concurrent_users);
+void event_loop_join(event_loop_group_t* group);
+
+/* True when the event-driven back-end is compiled in for this platform */
+bool event_loop_supported(void);
+
+/*
+ * Native socket load test back-end (socket_loop.c).
+ *
+ * A plan is what engine_start_socket_test() resolved up front: target
+ * addresses and the label of every operation. socket_loop_start() spreads
+ * the plan's connections over up to engine->event_loops threads; each runs
+ * its connections' scripts until they have done their iterations or
+ * stop_flag is set and their current iteration has finished.
+ * socket_loop_done() turns true once every loop has exited.
+ */
+typedef struct {
+    socket_test_options_t options;
+    struct sockaddr_storage* addrs;   /* one per target */
+    socklen_t* addr_lens;
+    int connect_label;                /* TCP connect; -1 for UDP */
+    int* step_labels;                 /* one per step */
+} socket_plan_t;
+
+typedef struct socket_loop_group socket_loop_group_t;
+
+socket_loop_group_t* socket_loop_start(engine_t* engine, const socket_plan_t* plan);
+bool socket_loop_done(socket_loop_group_t* group);
+void socket_loop_join(socket_loop_group_t* group);
+
+/*
+ * UDP blast back-end (udp_blast.c).
+ *
+ * udp_blast_start() opens options->flows sockets connected to addr, spreads
+ * them and the rate over up to engine->event_loops threads and starts
+ * sending; it returns NULL, having sent nothing, if any socket cannot be
+ * set up. Threads send until stop_flag is set, then wait up to linger_ms
+ * for outstanding echoes. Every echo is recorded under `label`.
+ * udp_blast_join() merges the threads' counters and RTT histograms.
+ */
+typedef struct udp_blast_group udp_blast_group_t;
+
+udp_blast_group_t* udp_blast_start(engine_t* engine, const udp_blast_options_t* options,
+                                   const struct sockaddr_storage* addr, socklen_t addr_len, int label);
+bool udp_blast_done(udp_blast_group_t* group);
+void udp_blast_join(udp_blast_group_t* group, udp_blast_result_t* result);
+
+/*
+ * Pipelined MQTT back-end (mqtt_loop.c).
+ *
+ * mqtt_loop_start() spreads the publishers and subscribers over up to
+ * engine->event_loops threads. Subscribers connect and subscribe first;
+ * publishing opens once every one of them has its SUBACK (or has failed).
+ * Publishers stop when they have sent options.messages or stop_flag is set,
+ * wait for their outstanding acks and disconnect; subscribers then read
+ * until every expected delivery is in or linger_ms has passed.
+ * mqtt_loop_join() merges the loops' counters and histograms.
+ */
+typedef struct {
+    mqtt_test_options_t options;      /* defaults applied */
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int connect_label;
+    int subscribe_label;
+    int publish_label;
+    int deliver_label;
+} mqtt_plan_t;
+
+typedef struct mqtt_loop_group mqtt_loop_group_t;
+
+mqtt_loop_group_t* mqtt_loop_start(engine_t* engine, const mqtt_plan_t* plan);
+bool mqtt_loop_done(mqtt_loop_group_t* group);
+void mqtt_loop_join(mqtt_loop_group_t* group, mqtt_test_result_t* result);
+
+/*
+ * WebSocket back-end (ws_loop.c).
+ *
+ * ws_loop_start() spreads options.connections over up to engine->event_loops
+ * threads, opening them at connect_rate or all at once. Each connection
+ * upgrades, then sends until it has sent options.messages or stop_flag is
+ * set, waits for its outstanding echoes (the ROUND_TRIP timeout or
+ * linger_ms) and closes with a close handshake. ws_loop_join() merges the
+ * loops' counters and RTT histograms.
+ */
+typedef struct {
+    websocket_test_options_t options;  /* defaults applied */
+    char host[256];
+    int port;
+    char resource[1024];
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int connect_label;
+    int message_label;
+} ws_plan_t;
+
+typedef struct ws_loop_group ws_loop_group_t;
+
+ws_loop_group_t* ws_loop_start(engine_t* engine, const ws_plan_t* plan);
+bool ws_loop_done(ws_loop_group_t* group);
+void ws_loop_join(ws_loop_group_t* group, websocket_test_result_t* result);
+
+/*
+ * PostgreSQL back-end (db_loop.c), built only with libpq.
+ *
+ * db_loop_start() spreads options.connections over up to
+ * engine->event_loops threads. Each connection connects without blocking,
+ * enters pipeline mode, prepares the queries (options.prepared) and sends
+ * them in turn, up to pipeline_depth in flight, until it has run
+ * options.iterations passes or stop_flag is set; then it collects the
+ * results still pending and closes. db_loop_join() merges the loops'
+ * counters and latency histograms.
+ */
+typedef struct {
+    database_test_options_t options;  /* defaults applied */
+    int connect_label;
+    int query_labels[DATABASE_TEST_MAX_QUERIES];
+} db_plan_t;
+
+typedef struct db_loop_group db_loop_group_t;
+
+db_loop_group_t* db_loop_start(engine_t* engine, const db_plan_t* plan);
+bool db_loop_done(db_loop_group_t* group);
+void db_loop_join(db_loop_group_t* group, database_test_result_t* result);
+
+/*
+ * Non-blocking single requests (request_loop.c).
+ *
+ * The loop is one thread driving engine->multi_handle with curl_multi_poll.
+ * engine_submit_request() configures an easy handle on the caller's thread
+ * and hands it over through a locked list and curl_multi_wakeup(); finished
+ * requests go onto a completion list, and a pipe stays readable while that
+ * list is non-empty. request_loop_destroy() abandons the requests still in
+ * flight or uncollected, joins the thread and frees the loop.
+ */
+typedef struct request_loop request_loop_t;
+
+void request_loop_destroy(request_loop_t* loop);
+
+#endif /* ENGINE_INTERNAL_H */
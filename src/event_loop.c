@@ -0,0 +1,482 @@
+#include "engine_internal.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * Event-driven HTTP load test back-end.
+ *
+ * Instead of one blocking thread per virtual user, each event loop owns a
+ * private CURLM handle and an epoll set and keeps up to `capacity` transfers
+ * in flight. libcurl tells us which sockets to watch through the socket
+ * callback and when to fire timeouts through the timer callback; we feed
+ * readiness back with curl_multi_socket_action(). A finished transfer frees
+ * its slot, which is immediately refilled from the request table, so each
+ * slot behaves like a closed-model virtual user. In an open-model test a
+ * loop holds the request it claimed until its scheduled send time, and the
+ * epoll wait is shortened so it fires on time. The engine's stop pipe sits in
+ * every epoll set, so an abort ends the loop mid-wait; the transfers still in
+ * flight are removed unrecorded when the loop is destroyed.
+ *
+ * A loop owns a fixed share of the users, so the group starts whole or not
+ * at all: the threads wait at a gate until every loop is set up and
+ * running, and a loop that fails either way fails the start.
+ */
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#define EVENT_LOOP_MAX_EVENTS 256
+#define EVENT_LOOP_IDLE_WAIT_MS 100   /* upper bound on one epoll_wait so a drain or ramp is noticed */
+
+typedef struct transfer {
+    CURL* easy;
+    response_match_t match;       /* the response streams through the test's assertions */
+    bool prepared;                /* params allocated on first use */
+    uint64_t start_us;
+    uint64_t intended_us;         /* open model: scheduled send time, 0 = closed model */
+    int label;                    /* label of the request in flight */
+    param_scratch_t params;       /* data-driven tests: the request in flight, substituted */
+    bool in_multi;
+    struct transfer* next_free;
+} transfer_t;
+
+typedef struct {
+    pthread_t thread;
+    engine_t* engine;
+    struct event_loop_group* group;
+    int loop_id;
+    bool started;
+    int epoll_fd;
+    CURLM* multi;
+    uint64_t timer_deadline_us;   /* 0 = no libcurl timeout pending */
+    int capacity;                 /* virtual users multiplexed on this loop */
+    int loop_count;               /* loops in the group; user u runs on loop u % loop_count */
+    int in_flight;
+    transfer_t* transfers;
+    transfer_t* free_list;
+    request_view_t pending;       /* claimed but not yet due (open model) */
+    uint64_t pending_intended_us;
+    uint64_t pending_claimed_us;
+    bool has_pending;
+    bool exhausted;               /* the engine has no more requests to hand out */
+} event_loop_t;
+
+typedef enum {
+    GATE_WAIT = 0,
+    GATE_OPEN,
+    GATE_CANCELLED            /* a loop could not start: the others exit unrun */
+} loop_gate_t;
+
+struct event_loop_group {
+    event_loop_t* loops;
+    int count;
+    pthread_mutex_t gate_mutex;
+    pthread_cond_t gate_cond;
+    loop_gate_t gate;         /* under gate_mutex */
+};
+
+/* Block until the group's start is decided; false if it was cancelled */
+static bool loop_wait_gate(event_loop_group_t* group) {
+    pthread_mutex_lock(&group->gate_mutex);
+    while (group->gate == GATE_WAIT) pthread_cond_wait(&group->gate_cond, &group->gate_mutex);
+    bool open = group->gate == GATE_OPEN;
+    pthread_mutex_unlock(&group->gate_mutex);
+    return open;
+}
+
+static void loop_set_gate(event_loop_group_t* group, loop_gate_t gate) {
+    pthread_mutex_lock(&group->gate_mutex);
+    group->gate = gate;
+    pthread_cond_broadcast(&group->gate_cond);
+    pthread_mutex_unlock(&group->gate_mutex);
+}
+
+bool event_loop_supported(void) {
+    return true;
+}
+
+static int loop_socket_cb(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp) {
+    (void)easy;
+    event_loop_t* loop = (event_loop_t*)userp;
+
+    if (what == CURL_POLL_REMOVE) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, s, NULL);
+        return 0;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = s;
+    if (what & CURL_POLL_IN) ev.events |= EPOLLIN;
+    if (what & CURL_POLL_OUT) ev.events |= EPOLLOUT;
+
+    if (socketp) {
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, s, &ev) != 0 && errno == ENOENT) {
+            epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, s, &ev);
+        }
+    } else {
+        /* fd numbers are recycled; a stale registration means MOD is what we want */
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, s, &ev) != 0 && errno == EEXIST) {
+            epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, s, &ev);
+        }
+        curl_multi_assign(loop->multi, s, loop);
+    }
+    return 0;
+}
+
+static int loop_timer_cb(CURLM* multi, long timeout_ms, void* userp) {
+    (void)multi;
+    event_loop_t* loop = (event_loop_t*)userp;
+    loop->timer_deadline_us = (timeout_ms < 0) ? 0 : get_time_us() + (uint64_t)timeout_ms * 1000;
+    return 0;
+}
+
+/* Take the next request and add it to the multi handle. Returns false when
+   there is no free slot, every request has been dispatched, or the claimed
+   request is not due yet (it stays in loop->pending). */
+static bool loop_start_transfer(event_loop_t* loop) {
+    engine_t* engine = loop->engine;
+    transfer_t* t = loop->free_list;
+    if (!t) return false;
+
+    if (!t->prepared) {
+        if (engine_param_scratch_init(engine, &t->params) != 0) return false;
+        response_match_init(&t->match, engine->assertions, engine->assertion_count);
+        t->prepared = true;
+    }
+    response_match_reset(&t->match);
+
+    /* Configure straight from the request table and its compiled template;
+       both stay untouched until every loop has been joined. */
+    if (!loop->has_pending) {
+        if (!engine_next_request(engine, &loop->pending, &loop->pending_intended_us)) {
+            loop->exhausted = true;
+            return false;
+        }
+        loop->pending_claimed_us = get_time_us();
+        loop->has_pending = true;
+    }
+    uint64_t intended_us = loop->pending_intended_us;
+    if (intended_us > get_time_us()) return false;
+    loop->has_pending = false;
+    request_view_t* request = &loop->pending;
+
+    CURL* curl = t->easy;
+    curl_easy_reset(curl);
+    int user = loop->loop_id + (int)(t - loop->transfers) * loop->loop_count;
+    engine_bind_source(engine, curl, user, engine->test_users);
+    bool own_headers = engine_param_expand(engine, &t->params, request, user);
+    request_template_apply(curl, &engine->templates.templates[request->template_id], request);
+    if (own_headers) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, t->params.headers);
+    engine_apply_http_version(engine, curl);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, t->match.count ? response_match_body : response_discard);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &t->match);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, t->match.header_mask ? response_match_header : response_discard);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &t->match);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, t);
+    if (engine->test_options.connection_mode == CONNECTION_MODE_KEEP_ALIVE) {
+        /* The slot's handle is reused for this virtual user's next request;
+           idle connections stay in the cache for it to pick up. Multiplexed
+           connections stay in this loop's own cache: a transfer waiting to
+           multiplex onto another loop's connection would never be woken. */
+        CURLSH* share = engine_http_multiplexed(engine) ? engine->session_share_handle : engine->share_handle;
+        if (share) {
+            curl_easy_setopt(curl, CURLOPT_SHARE, share);
+        }
+    } else {
+        curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 1L);
+        curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L);
+    }
+
+    loop->free_list = t->next_free;
+    t->next_free = NULL;
+    t->start_us = get_time_us();
+    t->intended_us = intended_us;
+    t->label = request->label_id;
+    if (intended_us) {
+        /* Lag counts from the schedule, or from the claim when no slot was free then */
+        uint64_t ready_us = intended_us > loop->pending_claimed_us ? intended_us : loop->pending_claimed_us;
+        engine_record_queue_delay(engine, t->start_us > intended_us ? t->start_us - intended_us : 0);
+        engine_record_series(engine, ENGINE_SERIES_SCHEDULER_LAG, t->start_us > ready_us ? t->start_us - ready_us : 0);
+    }
+
+    if (curl_multi_add_handle(loop->multi, curl) != CURLM_OK) {
+        engine_record_http_result(engine, t->label, get_time_us() - (intended_us ? intended_us : t->start_us), 0,
+                                  CURLE_FAILED_INIT);
+        t->next_free = loop->free_list;
+        loop->free_list = t;
+        return true;  /* request consumed; keep filling */
+    }
+
+    t->in_multi = true;
+    loop->in_flight++;
+    return true;
+}
+
+static void loop_drain_completed(event_loop_t* loop) {
+    CURLMsg* msg;
+    int pending = 0;
+
+    while ((msg = curl_multi_info_read(loop->multi, &pending)) != NULL) {
+        if (msg->msg != CURLMSG_DONE) continue;
+
+        CURL* curl = msg->easy_handle;
+        CURLcode res = msg->data.result;
+        transfer_t* t = NULL;
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char**)&t);
+        if (!t) continue;
+
+        uint64_t response_time = get_time_us() - (t->intended_us ? t->intended_us : t->start_us);
+        long response_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+        engine_record_checked_result(loop->engine, t->label, response_time, response_code, res, &t->match);
+        engine_record_phases(loop->engine, curl);
+
+        curl_multi_remove_handle(loop->multi, curl);
+        t->in_multi = false;
+
+        t->next_free = loop->free_list;
+        loop->free_list = t;
+        loop->in_flight--;
+    }
+}
+
+/* Slots this loop may fill: its share of the engine's active users, or all
+   of them once stopping so a claimed request still goes out */
+static int loop_active_slots(event_loop_t* loop) {
+    if (atomic_load(&loop->engine->stop_flag)) return loop->capacity;
+
+    int active = atomic_load_explicit(&loop->engine->active_users, memory_order_relaxed);
+    int share = active > loop->loop_id ? (active - 1 - loop->loop_id) / loop->loop_count + 1 : 0;
+    return share < loop->capacity ? share : loop->capacity;
+}
+
+static void* event_loop_thread_func(void* arg) {
+    event_loop_t* loop = (event_loop_t*)arg;
+    engine_t* engine = loop->engine;
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    int running = 0;
+    uint64_t woke_us = 0;
+
+    if (!loop_wait_gate(loop->group)) return NULL;
+
+    /* Pinned loops keep their transfer table on their own node */
+    engine_place_thread(engine, loop->loop_id);
+    engine_place_memory(engine, loop->loop_id, loop->transfers, sizeof(transfer_t) * (size_t)loop->capacity);
+
+    for (;;) {
+        if (engine_aborting(engine)) break;
+
+        /* Refill idle slots; once every request is dispatched only in-flight
+           work remains. A request already claimed is sent even after stop_flag. */
+        int slots = loop_active_slots(loop);
+        while ((loop->has_pending || !atomic_load(&engine->stop_flag)) && loop->in_flight < slots) {
+            if (!loop_start_transfer(loop)) break;
+        }
+
+        /* A ramped-down loop idles here until the profile gives it users again */
+        if (loop->in_flight == 0 && !loop->has_pending && (loop->exhausted || atomic_load(&engine->stop_flag))) break;
+
+        int wait_ms = EVENT_LOOP_IDLE_WAIT_MS;
+        uint64_t now = get_time_us();
+        if (loop->timer_deadline_us) {
+            uint64_t until = loop->timer_deadline_us > now ? loop->timer_deadline_us - now : 0;
+            if (until < (uint64_t)wait_ms * 1000) wait_ms = (int)((until + 999) / 1000);
+        }
+        if (loop->has_pending && loop->in_flight < slots) {
+            uint64_t due_us = loop->pending_intended_us;
+            uint64_t until = due_us > now ? due_us - now : 0;
+            if (until < (uint64_t)wait_ms * 1000) wait_ms = (int)((until + 999) / 1000);
+        }
+
+        engine_record_loop_iteration(engine, woke_us);
+        int n = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_MAX_EVENTS, wait_ms);
+        woke_us = get_time_us();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "[LoadSpiker] event loop %d: epoll_wait failed: %s\n", loop->loop_id, strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == engine->stop_fds[0]) continue;  /* seen at the top of the loop */
+            int flags = 0;
+            if (events[i].events & EPOLLIN) flags |= CURL_CSELECT_IN;
+            if (events[i].events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+            curl_multi_socket_action(loop->multi, events[i].data.fd, flags, &running);
+        }
+
+        if (loop->timer_deadline_us && get_time_us() >= loop->timer_deadline_us) {
+            loop->timer_deadline_us = 0;
+            curl_multi_socket_action(loop->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+        }
+
+        loop_drain_completed(loop);
+    }
+
+    engine_thread_exit(engine);
+    return NULL;
+}
+
+static void loop_destroy(event_loop_t* loop) {
+    if (loop->transfers) {
+        for (int i = 0; i < loop->capacity; i++) {
+            transfer_t* t = &loop->transfers[i];
+            if (t->easy) {
+                if (t->in_multi) curl_multi_remove_handle(loop->multi, t->easy);
+                curl_easy_cleanup(t->easy);
+            }
+            engine_param_scratch_free(&t->params);
+        }
+        free(loop->transfers);
+        loop->transfers = NULL;
+    }
+    if (loop->multi) {
+        curl_multi_cleanup(loop->multi);
+        loop->multi = NULL;
+    }
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+        loop->epoll_fd = -1;
+    }
+}
+
+static int loop_init(event_loop_t* loop, engine_t* engine, int loop_id, int capacity) {
+    memset(loop, 0, sizeof(event_loop_t));
+    loop->engine = engine;
+    loop->loop_id = loop_id;
+    loop->capacity = capacity;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) return -1;
+
+    struct epoll_event stop;
+    memset(&stop, 0, sizeof(stop));
+    stop.events = EPOLLIN;
+    stop.data.fd = engine->stop_fds[0];
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, engine->stop_fds[0], &stop) != 0) return -1;
+
+    loop->multi = curl_multi_init();
+    if (!loop->multi) return -1;
+    curl_multi_setopt(loop->multi, CURLMOPT_SOCKETFUNCTION, loop_socket_cb);
+    curl_multi_setopt(loop->multi, CURLMOPT_SOCKETDATA, loop);
+    curl_multi_setopt(loop->multi, CURLMOPT_TIMERFUNCTION, loop_timer_cb);
+    curl_multi_setopt(loop->multi, CURLMOPT_TIMERDATA, loop);
+    curl_multi_setopt(loop->multi, CURLMOPT_MAXCONNECTS, (long)capacity);
+    /* HTTP/2 and HTTP/3 transfers on this loop share connections, up to
+       max_streams each (libcurl multiplexes by default since 7.62.0) */
+    curl_multi_setopt(loop->multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+#if LIBCURL_VERSION_NUM >= 0x074300  /* CURLMOPT_MAX_CONCURRENT_STREAMS needs libcurl 7.67.0 */
+    if (engine->test_options.max_streams > 0) {
+        curl_multi_setopt(loop->multi, CURLMOPT_MAX_CONCURRENT_STREAMS, (long)engine->test_options.max_streams);
+    }
+#endif
+
+    loop->transfers = calloc((size_t)capacity, sizeof(transfer_t));
+    if (!loop->transfers) return -1;
+
+    for (int i = capacity - 1; i >= 0; i--) {
+        transfer_t* t = &loop->transfers[i];
+        t->easy = curl_easy_init();
+        if (!t->easy) return -1;
+        t->next_free = loop->free_list;
+        loop->free_list = t;
+    }
+    return 0;
+}
+
+event_loop_group_t* event_loop_start(engine_t* engine, int concurrent_users) {
+    if (!engine || concurrent_users <= 0) return NULL;
+
+    int count = engine->event_loops;
+    if (count > concurrent_users) count = concurrent_users;
+    if (count <= 0) count = 1;
+
+    event_loop_group_t* group = calloc(1, sizeof(event_loop_group_t));
+    if (!group) return NULL;
+    group->loops = calloc((size_t)count, sizeof(event_loop_t));
+    if (!group->loops || pthread_mutex_init(&group->gate_mutex, NULL) != 0) {
+        free(group->loops);
+        free(group);
+        return NULL;
+    }
+    if (pthread_cond_init(&group->gate_cond, NULL) != 0) {
+        pthread_mutex_destroy(&group->gate_mutex);
+        free(group->loops);
+        free(group);
+        return NULL;
+    }
+    group->count = count;
+    group->gate = GATE_WAIT;
+
+    /* User u runs on loop u % count, so every loop must start or none does */
+    bool failed = false;
+    for (int i = 0; i < count; i++) {
+        event_loop_t* loop = &group->loops[i];
+        int capacity = concurrent_users / count + (i < concurrent_users % count ? 1 : 0);
+
+        if (loop_init(loop, engine, i, capacity) != 0) {
+            fprintf(stderr, "[LoadSpiker] event loop %d: initialisation failed\n", i);
+            loop_destroy(loop);
+            failed = true;
+            break;
+        }
+        loop->group = group;
+        loop->loop_count = count;
+        if (pthread_create(&loop->thread, NULL, event_loop_thread_func, loop) != 0) {
+            fprintf(stderr, "[LoadSpiker] event loop %d: cannot start its thread\n", i);
+            loop_destroy(loop);
+            failed = true;
+            break;
+        }
+        loop->started = true;
+    }
+
+    loop_set_gate(group, failed ? GATE_CANCELLED : GATE_OPEN);
+    if (failed) {
+        event_loop_join(group);
+        return NULL;
+    }
+    return group;
+}
+
+void event_loop_join(event_loop_group_t* group) {
+    if (!group) return;
+
+    for (int i = 0; i < group->count; i++) {
+        event_loop_t* loop = &group->loops[i];
+        if (!loop->started) continue;
+        pthread_join(loop->thread, NULL);
+        loop_destroy(loop);
+    }
+    pthread_cond_destroy(&group->gate_cond);
+    pthread_mutex_destroy(&group->gate_mutex);
+    free(group->loops);
+    free(group);
+}
+
+#else /* !__linux__ */
+
+bool event_loop_supported(void) {
+    return false;
+}
+
+event_loop_group_t* event_loop_start(engine_t* engine, int concurrent_users) {
+    (void)engine;
+    (void)concurrent_users;
+    return NULL;
+}
+
+void event_loop_join(event_loop_group_t* group) {
+    (void)group;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,242 @@
+#include "histogram.h"
+#include <stdlib.h>
+#include <string.h>
+
+int histogram_layout_init(histogram_layout_t* layout, uint64_t highest_trackable_value, int significant_digits) {
+    if (!layout || significant_digits < 1 || significant_digits > HISTOGRAM_MAX_SIGNIFICANT_DIGITS ||
+        highest_trackable_value < 2) {
+        return -1;
+    }
+
+    memset(layout, 0, sizeof(histogram_layout_t));
+    layout->highest_trackable_value = highest_trackable_value;
+    layout->significant_digits = significant_digits;
+
+    /* Enough linear sub-buckets that one unit is 10^-digits of the bucket's
+       smallest value: 2 * 10^digits, rounded up to a power of two. */
+    uint64_t largest_single_unit = 2;
+    for (int i = 0; i < significant_digits; i++) {
+        largest_single_unit *= 10;
+    }
+    int magnitude = 0;
+    while ((1ULL << magnitude) < largest_single_unit) {
+        magnitude++;
+    }
+
+    layout->sub_bucket_count_magnitude = magnitude;
+    layout->sub_bucket_half_count_magnitude = magnitude - 1;
+    layout->sub_bucket_count = 1 << magnitude;
+    layout->sub_bucket_half_count = layout->sub_bucket_count / 2;
+    layout->sub_bucket_mask = (uint64_t)layout->sub_bucket_count - 1;
+
+    uint64_t smallest_untrackable = (uint64_t)layout->sub_bucket_count;
+    int buckets = 1;
+    while (smallest_untrackable <= highest_trackable_value) {
+        if (smallest_untrackable > UINT64_MAX / 2) {
+            buckets++;
+            break;
+        }
+        smallest_untrackable <<= 1;
+        buckets++;
+    }
+    layout->bucket_count = buckets;
+    layout->counts_len = (buckets + 1) * layout->sub_bucket_half_count;
+
+    return 0;
+}
+
+int histogram_counts_index(const histogram_layout_t* layout, uint64_t value) {
+    if (value > layout->highest_trackable_value) {
+        value = layout->highest_trackable_value;
+    }
+
+    int pow2_ceiling = 64 - __builtin_clzll(value | layout->sub_bucket_mask);
+    int bucket_index = pow2_ceiling - layout->sub_bucket_count_magnitude;
+    int sub_bucket_index = (int)(value >> bucket_index);
+
+    return ((bucket_index + 1) << layout->sub_bucket_half_count_magnitude) +
+           (sub_bucket_index - layout->sub_bucket_half_count);
+}
+
+static void index_to_bucket(const histogram_layout_t* layout, int index, int* bucket_index, int* sub_bucket_index) {
+    *bucket_index = (index >> layout->sub_bucket_half_count_magnitude) - 1;
+    *sub_bucket_index = (index & (layout->sub_bucket_half_count - 1)) + layout->sub_bucket_half_count;
+    if (*bucket_index < 0) {
+        *sub_bucket_index -= layout->sub_bucket_half_count;
+        *bucket_index = 0;
+    }
+}
+
+uint64_t histogram_lowest_at_index(const histogram_layout_t* layout, int index) {
+    int bucket_index, sub_bucket_index;
+    index_to_bucket(layout, index, &bucket_index, &sub_bucket_index);
+    return (uint64_t)sub_bucket_index << bucket_index;
+}
+
+uint64_t histogram_highest_at_index(const histogram_layout_t* layout, int index) {
+    int bucket_index, sub_bucket_index;
+    index_to_bucket(layout, index, &bucket_index, &sub_bucket_index);
+    return ((uint64_t)sub_bucket_index << bucket_index) + (1ULL << bucket_index) - 1;
+}
+
+histogram_t* histogram_create(const histogram_layout_t* layout) {
+    if (!layout || layout->counts_len <= 0) return NULL;
+
+    histogram_t* histogram = malloc(sizeof(histogram_t));
+    if (!histogram) return NULL;
+
+    histogram->counts = calloc((size_t)layout->counts_len, sizeof(uint64_t));
+    if (!histogram->counts) {
+        free(histogram);
+        return NULL;
+    }
+    histogram->layout = *layout;
+    histogram->total_count = 0;
+    histogram->max_value = 0;
+    return histogram;
+}
+
+void histogram_destroy(histogram_t* histogram) {
+    if (!histogram) return;
+    free(histogram->counts);
+    free(histogram);
+}
+
+void histogram_reset(histogram_t* histogram) {
+    if (!histogram) return;
+    memset(histogram->counts, 0, sizeof(uint64_t) * (size_t)histogram->layout.counts_len);
+    histogram->total_count = 0;
+    histogram->max_value = 0;
+}
+
+void histogram_record(histogram_t* histogram, uint64_t value) {
+    if (!histogram) return;
+    histogram->counts[histogram_counts_index(&histogram->layout, value)]++;
+    histogram->total_count++;
+    if (value > histogram->max_value) {
+        histogram->max_value = value;
+    }
+}
+
+int histogram_add(histogram_t* dst, const histogram_t* src) {
+    if (!dst || !src) return -1;
+    if (memcmp(&dst->layout, &src->layout, sizeof(histogram_layout_t)) != 0) return -1;
+
+    for (int i = 0; i < dst->layout.counts_len; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total_count += src->total_count;
+    if (src->max_value > dst->max_value) {
+        dst->max_value = src->max_value;
+    }
+    return 0;
+}
+
+uint64_t histogram_value_at_percentile(const histogram_t* histogram, double percentile) {
+    if (!histogram || histogram->total_count == 0) return 0;
+    if (percentile >= 100.0) return histogram->max_value;
+    if (percentile < 0.0) percentile = 0.0;
+
+    uint64_t target = (uint64_t)(percentile / 100.0 * (double)histogram->total_count + 0.5);
+    if (target < 1) target = 1;
+
+    uint64_t cumulative = 0;
+    for (int i = 0; i < histogram->layout.counts_len; i++) {
+        cumulative += histogram->counts[i];
+        if (cumulative >= target) {
+            uint64_t value = histogram_highest_at_index(&histogram->layout, i);
+            return value < histogram->max_value ? value : histogram->max_value;
+        }
+    }
+    return histogram->max_value;
+}
+
+/* Encoding: "LSH1", then LEB128 varints: significant digits, highest
+   trackable value, max value, and a (gap, count) pair per non-zero counter,
+   where gap is the number of zero counters skipped since the previous one. */
+#define HISTOGRAM_MAGIC "LSH1"
+#define HISTOGRAM_MAGIC_LEN 4
+#define VARINT_MAX_LEN 10
+
+static uint8_t* varint_put(uint8_t* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+/* Advance *pos past one varint; false if it runs off the end or overflows */
+static bool varint_get(const uint8_t* data, size_t len, size_t* pos, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*pos >= len) return false;
+        uint8_t byte = data[(*pos)++];
+        if (shift == 63 && byte > 1) return false;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t* histogram_encode(const histogram_t* histogram, size_t* len) {
+    if (!histogram || !len) return NULL;
+
+    size_t nonzero = 0;
+    for (int i = 0; i < histogram->layout.counts_len; i++) {
+        if (histogram->counts[i] > 0) nonzero++;
+    }
+    uint8_t* data = malloc(HISTOGRAM_MAGIC_LEN + (3 + 2 * nonzero) * VARINT_MAX_LEN);
+    if (!data) return NULL;
+
+    memcpy(data, HISTOGRAM_MAGIC, HISTOGRAM_MAGIC_LEN);
+    uint8_t* out = data + HISTOGRAM_MAGIC_LEN;
+    out = varint_put(out, (uint64_t)histogram->layout.significant_digits);
+    out = varint_put(out, histogram->layout.highest_trackable_value);
+    out = varint_put(out, histogram->max_value);
+
+    int previous = -1;
+    for (int i = 0; i < histogram->layout.counts_len; i++) {
+        if (histogram->counts[i] == 0) continue;
+        out = varint_put(out, (uint64_t)(i - previous - 1));
+        out = varint_put(out, histogram->counts[i]);
+        previous = i;
+    }
+    *len = (size_t)(out - data);
+    return data;
+}
+
+histogram_t* histogram_decode(const uint8_t* data, size_t len) {
+    if (!data || len < HISTOGRAM_MAGIC_LEN || memcmp(data, HISTOGRAM_MAGIC, HISTOGRAM_MAGIC_LEN) != 0) return NULL;
+
+    size_t pos = HISTOGRAM_MAGIC_LEN;
+    uint64_t digits, highest, max_value;
+    if (!varint_get(data, len, &pos, &digits) || !varint_get(data, len, &pos, &highest) ||
+        !varint_get(data, len, &pos, &max_value) || digits > HISTOGRAM_MAX_SIGNIFICANT_DIGITS) {
+        return NULL;
+    }
+
+    histogram_layout_t layout;
+    if (histogram_layout_init(&layout, highest, (int)digits) != 0) return NULL;
+    histogram_t* histogram = histogram_create(&layout);
+    if (!histogram) return NULL;
+    histogram->max_value = max_value;
+
+    uint64_t next = 0;   /* first index the next gap counts from */
+    while (pos < len) {
+        uint64_t gap, count;
+        if (!varint_get(data, len, &pos, &gap) || !varint_get(data, len, &pos, &count) || count == 0 ||
+            gap >= (uint64_t)layout.counts_len - next || histogram->total_count > UINT64_MAX - count) {
+            histogram_destroy(histogram);
+            return NULL;
+        }
+        next += gap;
+        histogram->counts[next++] = count;
+        histogram->total_count += count;
+    }
+    return histogram;
+}
@@ -0,0 +1,71 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/*
+ * Log-linear latency histogram (HdrHistogram bucket layout).
+ *
+ * Values are microseconds. The range [0, highest_trackable_value] is split
+ * into power-of-two buckets, each holding the same number of linear
+ * sub-buckets, so every recorded value is resolved to within
+ * 10^-significant_digits of itself regardless of magnitude. With the default
+ * of 2 digits and a one-hour ceiling that is ~3300 counters.
+ *
+ * histogram_layout_t only describes the bucket geometry; it lets callers
+ * own the counts array (the engine keeps atomic per-thread counters) and
+ * still share indexing and percentile logic with histogram_t.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HISTOGRAM_DEFAULT_SIGNIFICANT_DIGITS 2
+#define HISTOGRAM_DEFAULT_HIGHEST_US (3600ULL * 1000000ULL)  /* one hour */
+#define HISTOGRAM_MAX_SIGNIFICANT_DIGITS 5
+
+typedef struct {
+    uint64_t highest_trackable_value;
+    int significant_digits;
+    int sub_bucket_count_magnitude;
+    int sub_bucket_half_count_magnitude;
+    int sub_bucket_count;
+    int sub_bucket_half_count;
+    uint64_t sub_bucket_mask;
+    int bucket_count;
+    int counts_len;
+} histogram_layout_t;
+
+typedef struct histogram {
+    histogram_layout_t layout;
+    uint64_t total_count;
+    uint64_t max_value;       /* exact largest recorded value (before clamping) */
+    uint64_t* counts;         /* layout.counts_len entries */
+} histogram_t;
+
+// Layout: returns -1 for digits outside 1..HISTOGRAM_MAX_SIGNIFICANT_DIGITS or highest < 2
+int histogram_layout_init(histogram_layout_t* layout, uint64_t highest_trackable_value, int significant_digits);
+int histogram_counts_index(const histogram_layout_t* layout, uint64_t value);   // clamps to the top bucket
+uint64_t histogram_lowest_at_index(const histogram_layout_t* layout, int index);
+uint64_t histogram_highest_at_index(const histogram_layout_t* layout, int index);
+
+// Owned histograms
+histogram_t* histogram_create(const histogram_layout_t* layout);
+void histogram_destroy(histogram_t* histogram);
+void histogram_reset(histogram_t* histogram);
+void histogram_record(histogram_t* histogram, uint64_t value);
+int histogram_add(histogram_t* dst, const histogram_t* src);   // -1 if layouts differ
+
+// Value at or below which `percentile` (0..100) of samples fall, reported as
+// the upper edge of its bucket and capped at max_value. 0 when empty.
+uint64_t histogram_value_at_percentile(const histogram_t* histogram, double percentile);
+
+// Sparse, byte-order independent encoding for moving a histogram between
+// processes: the layout, max_value and only the non-zero counters, so a
+// decoded histogram adds to any other of the same layout without losing a
+// sample. Returns a malloc'd buffer (free() it) of *len bytes, NULL when out
+// of memory.
+uint8_t* histogram_encode(const histogram_t* histogram, size_t* len);
+// NULL if the data is not an encoded histogram; free with histogram_destroy()
+histogram_t* histogram_decode(const uint8_t* data, size_t len);
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,46 @@
+#include "lock_stats.h"
+#include <stdatomic.h>
+#include <time.h>
+
+#define CACHE_LINE 64
+
+typedef struct {
+    _Atomic uint64_t contended;
+    _Atomic uint64_t wait_ns;
+} __attribute__((aligned(CACHE_LINE))) lock_site_counters_t;
+
+static lock_site_counters_t lock_sites[LOCK_SITES];
+
+static const char* const lock_site_names[LOCK_SITES] = {
+    "curl_share",
+    "conn_table",
+    "request_loop",
+};
+
+static uint64_t lock_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void lock_stats_wait(pthread_mutex_t* mutex, lock_site_t site) {
+    uint64_t start_ns = lock_clock_ns();
+    pthread_mutex_lock(mutex);
+    uint64_t waited_ns = lock_clock_ns() - start_ns;
+
+    if ((unsigned)site >= LOCK_SITES) return;
+    atomic_fetch_add_explicit(&lock_sites[site].contended, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&lock_sites[site].wait_ns, waited_ns, memory_order_relaxed);
+}
+
+void lock_stats_read(lock_site_stats_t* stats) {
+    if (!stats) return;
+    for (int i = 0; i < LOCK_SITES; i++) {
+        stats[i].contended = atomic_load_explicit(&lock_sites[i].contended, memory_order_relaxed);
+        stats[i].wait_ns = atomic_load_explicit(&lock_sites[i].wait_ns, memory_order_relaxed);
+    }
+}
+
+const char* lock_stats_site_name(lock_site_t site) {
+    return (unsigned)site < LOCK_SITES ? lock_site_names[site] : "unknown";
+}
@@ -0,0 +1,47 @@
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+/*
+ * Contention counters for the locks load generation takes on its hot path.
+ *
+ * lock_stats_lock() is pthread_mutex_lock() with a trylock fast path: an
+ * uncontended acquisition costs nothing extra and touches no shared
+ * counter. Only when the lock is already held does the slow path time the
+ * wait and add it to the site's process-wide totals, so the counters measure
+ * how long generator threads sat blocked on each other rather than how
+ * often they locked. Each site's totals sit on their own cache line.
+ *
+ * The engine reads the totals when a test starts and reports the difference
+ * (engine_get_generator_health), so tests of other engines in the same
+ * process show up in each other's numbers while they overlap.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+
+typedef enum {
+    LOCK_SITE_CURL_SHARE = 0,   // DNS / TLS session / connection cache shared by keep-alive users
+    LOCK_SITE_CONN_TABLE = 1,   // TCP, UDP, MQTT and WebSocket connection pools (table and slot locks)
+    LOCK_SITE_REQUEST_LOOP = 2, // non-blocking single requests handed to the request loop
+    LOCK_SITES = 3
+} lock_site_t;
+
+typedef struct {
+    uint64_t contended;         // acquisitions that found the lock held
+    uint64_t wait_ns;           // time spent waiting in those acquisitions
+} lock_site_stats_t;
+
+// Slow path of lock_stats_lock(): block on mutex and account the wait
+void lock_stats_wait(pthread_mutex_t* mutex, lock_site_t site);
+
+static inline void lock_stats_lock(pthread_mutex_t* mutex, lock_site_t site) {
+    if (pthread_mutex_trylock(mutex) != 0) lock_stats_wait(mutex, site);
+}
+
+// Copy every site's totals since the process started into stats[LOCK_SITES]
+void lock_stats_read(lock_site_stats_t* stats);
+
+// "curl_share", "conn_table", "request_loop"
+const char* lock_stats_site_name(lock_site_t site);
+
+#endif /* LOCK_STATS_H */
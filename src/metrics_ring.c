@@ -0,0 +1,132 @@
+#include "metrics_ring.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WINDOW_WORDS ((sizeof(metrics_window_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+typedef struct {
+    _Atomic uint64_t seq;                   /* 2n+1 while window n is written, 2n+2 once readable */
+    _Atomic uint64_t window[WINDOW_WORDS];  /* metrics_window_t, word by word */
+    _Atomic uint64_t* counts;
+} metrics_ring_slot_t;
+
+struct metrics_ring {
+    histogram_layout_t layout;
+    int capacity;
+    metrics_ring_slot_t* slots;
+    _Atomic uint64_t* counts;    /* capacity * layout.counts_len, one block per slot */
+    _Atomic uint64_t head;       /* windows published so far */
+    _Atomic uint64_t cursor;     /* next window a consumer will read */
+};
+
+metrics_ring_t* metrics_ring_create(const histogram_layout_t* layout, int capacity) {
+    if (!layout || layout->counts_len <= 0 || capacity <= 0) return NULL;
+
+    metrics_ring_t* ring = calloc(1, sizeof(metrics_ring_t));
+    if (!ring) return NULL;
+
+    ring->slots = calloc((size_t)capacity, sizeof(metrics_ring_slot_t));
+    ring->counts = calloc((size_t)capacity * (size_t)layout->counts_len, sizeof(uint64_t));
+    if (!ring->slots || !ring->counts) {
+        free(ring->slots);
+        free(ring->counts);
+        free(ring);
+        return NULL;
+    }
+
+    ring->layout = *layout;
+    ring->capacity = capacity;
+    for (int i = 0; i < capacity; i++) {
+        ring->slots[i].counts = ring->counts + (size_t)i * (size_t)layout->counts_len;
+    }
+    return ring;
+}
+
+void metrics_ring_destroy(metrics_ring_t* ring) {
+    if (!ring) return;
+    free(ring->slots);
+    free(ring->counts);
+    free(ring);
+}
+
+void metrics_ring_publish(metrics_ring_t* ring, metrics_window_t* window, const uint64_t* counts) {
+    if (!ring || !window || !counts) return;
+
+    uint64_t n = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    metrics_ring_slot_t* slot = &ring->slots[n % (uint64_t)ring->capacity];
+    window->sequence = n;
+
+    uint64_t words[WINDOW_WORDS] = {0};
+    memcpy(words, window, sizeof(metrics_window_t));
+
+    atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < WINDOW_WORDS; i++) {
+        atomic_store_explicit(&slot->window[i], words[i], memory_order_relaxed);
+    }
+    for (int i = 0; i < ring->layout.counts_len; i++) {
+        atomic_store_explicit(&slot->counts[i], counts[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+    atomic_store_explicit(&ring->head, n + 1, memory_order_release);
+}
+
+int metrics_ring_consume(metrics_ring_t* ring, metrics_window_t* window, histogram_t* interval) {
+    if (!ring || !window) return -1;
+    if (interval && memcmp(&interval->layout, &ring->layout, sizeof(histogram_layout_t)) != 0) return -1;
+
+    uint64_t capacity = (uint64_t)ring->capacity;
+    for (;;) {
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t cur = atomic_load_explicit(&ring->cursor, memory_order_relaxed);
+        if (cur >= head) return 0;
+
+        /* Fell behind: the oldest windows are gone, resume at the oldest kept */
+        if (head - cur > capacity) {
+            atomic_compare_exchange_weak_explicit(&ring->cursor, &cur, head - capacity,
+                                                  memory_order_relaxed, memory_order_relaxed);
+            continue;
+        }
+
+        metrics_ring_slot_t* slot = &ring->slots[cur % capacity];
+        uint64_t expected = 2 * cur + 2;
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != expected) {
+            /* The producer is already overwriting this slot with a newer window */
+            if (seq > expected) {
+                atomic_compare_exchange_weak_explicit(&ring->cursor, &cur, cur + 1,
+                                                      memory_order_relaxed, memory_order_relaxed);
+            }
+            continue;
+        }
+
+        uint64_t words[WINDOW_WORDS];
+        for (size_t i = 0; i < WINDOW_WORDS; i++) {
+            words[i] = atomic_load_explicit(&slot->window[i], memory_order_relaxed);
+        }
+        if (interval) {
+            for (int i = 0; i < ring->layout.counts_len; i++) {
+                interval->counts[i] = atomic_load_explicit(&slot->counts[i], memory_order_relaxed);
+            }
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) continue;
+
+        /* Another consumer may have taken this window meanwhile */
+        if (!atomic_compare_exchange_strong_explicit(&ring->cursor, &cur, cur + 1,
+                                                     memory_order_relaxed, memory_order_relaxed)) {
+            continue;
+        }
+
+        memcpy(window, words, sizeof(metrics_window_t));
+        if (interval) {
+            interval->total_count = 0;
+            for (int i = 0; i < ring->layout.counts_len; i++) {
+                interval->total_count += interval->counts[i];
+            }
+            interval->max_value = window->max_us;
+        }
+        return 1;
+    }
+}
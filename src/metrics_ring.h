@@ -0,0 +1,34 @@
+#ifndef METRICS_RING_H
+#define METRICS_RING_H
+
+/*
+ * Fixed-capacity ring of windowed metrics snapshots.
+ *
+ * One producer (the load-test controller thread) publishes a
+ * metrics_window_t plus that window's interval latency counts once per
+ * window; any number of consumers drain them in order. Nothing blocks:
+ * every slot is a seqlock, the producer always overwrites the oldest
+ * window, and a consumer that falls more than `capacity` windows behind
+ * skips ahead (the gap shows up in metrics_window_t.sequence). All slot
+ * words are relaxed atomics, so torn reads are detected and retried
+ * rather than being data races.
+ */
+
+#include "engine.h"
+#include "histogram.h"
+
+typedef struct metrics_ring metrics_ring_t;
+
+metrics_ring_t* metrics_ring_create(const histogram_layout_t* layout, int capacity);
+void metrics_ring_destroy(metrics_ring_t* ring);
+
+// Producer only. window->sequence is assigned by the ring; counts holds
+// layout->counts_len interval counts.
+void metrics_ring_publish(metrics_ring_t* ring, metrics_window_t* window, const uint64_t* counts);
+
+// Copy the oldest unread window (and, when interval is non-NULL, its counts).
+// Returns 1 when a window was read, 0 when none is pending, -1 if interval's
+// layout differs from the ring's.
+int metrics_ring_consume(metrics_ring_t* ring, metrics_window_t* window, histogram_t* interval);
+
+#endif /* METRICS_RING_H */
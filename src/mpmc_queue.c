@@ -0,0 +1,212 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   /* syscall */
+#endif
+#include "mpmc_queue.h"
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <pthread.h>
+#endif
+
+#define CACHE_LINE 64
+
+/* Each cell: its sequence number, then the item (CACHE_LINE-aligned stride) */
+typedef struct {
+    _Atomic size_t sequence;   /* pos: free for the producer of pos; pos+1: holds item pos */
+} mpmc_cell_t;
+
+#define CELL_HEADER ((sizeof(mpmc_cell_t) + 15) & ~(size_t)15)
+
+struct mpmc_queue {
+    char* cells;
+    size_t stride;
+    size_t mask;
+    _Alignas(CACHE_LINE) _Atomic size_t tail;      /* next position to reserve */
+    _Alignas(CACHE_LINE) _Atomic size_t head;      /* next position to claim */
+    _Alignas(CACHE_LINE) _Atomic uint32_t epoch;   /* bumped by every wake-up */
+    _Atomic int sleepers;
+#ifndef __linux__
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+static inline mpmc_cell_t* cell_at(const mpmc_queue_t* queue, size_t pos) {
+    return (mpmc_cell_t*)(queue->cells + (pos & queue->mask) * queue->stride);
+}
+
+static inline mpmc_cell_t* cell_of(void* item) {
+    return (mpmc_cell_t*)((char*)item - CELL_HEADER);
+}
+
+mpmc_queue_t* mpmc_queue_create(size_t item_size, size_t capacity) {
+    if (item_size == 0 || capacity == 0 || capacity > ((size_t)1 << 30)) return NULL;
+    size_t cells = 1;
+    while (cells < capacity) cells <<= 1;
+
+    mpmc_queue_t* queue = NULL;
+    if (posix_memalign((void**)&queue, CACHE_LINE, sizeof(mpmc_queue_t)) != 0) return NULL;
+    memset(queue, 0, sizeof(*queue));
+    queue->stride = (CELL_HEADER + item_size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    queue->mask = cells - 1;
+    if (posix_memalign((void**)&queue->cells, CACHE_LINE, cells * queue->stride) != 0) {
+        free(queue);
+        return NULL;
+    }
+#ifndef __linux__
+    if (pthread_mutex_init(&queue->lock, NULL) != 0) {
+        free(queue->cells);
+        free(queue);
+        return NULL;
+    }
+    if (pthread_cond_init(&queue->cond, NULL) != 0) {
+        pthread_mutex_destroy(&queue->lock);
+        free(queue->cells);
+        free(queue);
+        return NULL;
+    }
+#endif
+    /* Only the sequence words are touched: item storage is faulted in as it is used */
+    for (size_t i = 0; i < cells; i++) {
+        atomic_init(&cell_at(queue, i)->sequence, i);
+    }
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->epoch, 0);
+    atomic_init(&queue->sleepers, 0);
+    return queue;
+}
+
+void mpmc_queue_destroy(mpmc_queue_t* queue) {
+    if (!queue) return;
+#ifndef __linux__
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+#endif
+    free(queue->cells);
+    free(queue);
+}
+
+size_t mpmc_queue_capacity(const mpmc_queue_t* queue) {
+    return queue->mask + 1;
+}
+
+size_t mpmc_queue_depth(const mpmc_queue_t* queue) {
+    /* head first: the tail read after it can only be further along */
+    size_t head = atomic_load_explicit(&((mpmc_queue_t*)queue)->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&((mpmc_queue_t*)queue)->tail, memory_order_relaxed);
+    return tail - head;
+}
+
+void* mpmc_queue_reserve(mpmc_queue_t* queue) {
+    size_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    for (;;) {
+        mpmc_cell_t* cell = cell_at(queue, pos);
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t lag = (intptr_t)(sequence - pos);
+        if (lag == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                return (char*)cell + CELL_HEADER;
+            }
+        } else if (lag < 0) {
+            return NULL;   /* the cell a lap back is still queued or claimed */
+        } else {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+}
+
+static void queue_wake(mpmc_queue_t* queue, bool all) {
+    /* Pairs with the fence in prepare_wait(): either the sleeper sees the
+       new item, or this sees the sleeper */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&queue->sleepers, memory_order_relaxed) == 0) return;
+#ifdef __linux__
+    atomic_fetch_add_explicit(&queue->epoch, 1, memory_order_relaxed);
+    syscall(SYS_futex, (uint32_t*)&queue->epoch, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&queue->lock);
+    atomic_fetch_add_explicit(&queue->epoch, 1, memory_order_relaxed);
+    if (all) pthread_cond_broadcast(&queue->cond);
+    else pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+#endif
+}
+
+void mpmc_queue_publish(mpmc_queue_t* queue, void* item) {
+    mpmc_cell_t* cell = cell_of(item);
+    size_t pos = atomic_load_explicit(&cell->sequence, memory_order_relaxed);
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    queue_wake(queue, false);
+}
+
+int mpmc_queue_claim(mpmc_queue_t* queue, void** items, int max) {
+    if (max <= 0) return 0;
+    size_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    for (;;) {
+        /* The run of published cells from pos on, then one CAS for all of them */
+        int ready = 0;
+        while (ready < max) {
+            size_t sequence = atomic_load_explicit(&cell_at(queue, pos + (size_t)ready)->sequence,
+                                                   memory_order_acquire);
+            if (sequence != pos + (size_t)ready + 1) break;
+            ready++;
+        }
+        if (ready == 0) {
+            size_t sequence = atomic_load_explicit(&cell_at(queue, pos)->sequence, memory_order_acquire);
+            if ((intptr_t)(sequence - (pos + 1)) < 0) return 0;   /* empty, or not published yet */
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + (size_t)ready,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            for (int i = 0; i < ready; i++) {
+                items[i] = (char*)cell_at(queue, pos + (size_t)i) + CELL_HEADER;
+            }
+            return ready;
+        }
+    }
+}
+
+void mpmc_queue_release(mpmc_queue_t* queue, void* item) {
+    mpmc_cell_t* cell = cell_of(item);
+    size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_relaxed);
+    /* pos+1 -> pos+capacity: free for the producer one lap on */
+    atomic_store_explicit(&cell->sequence, sequence + queue->mask, memory_order_release);
+}
+
+uint32_t mpmc_queue_prepare_wait(mpmc_queue_t* queue) {
+    atomic_fetch_add_explicit(&queue->sleepers, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&queue->epoch, memory_order_relaxed);
+}
+
+void mpmc_queue_wait(mpmc_queue_t* queue, uint32_t key) {
+#ifdef __linux__
+    /* Returns at once when the epoch has moved on since prepare_wait() */
+    syscall(SYS_futex, (uint32_t*)&queue->epoch, FUTEX_WAIT_PRIVATE, key, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&queue->lock);
+    while (atomic_load_explicit(&queue->epoch, memory_order_relaxed) == key) {
+        pthread_cond_wait(&queue->cond, &queue->lock);
+    }
+    pthread_mutex_unlock(&queue->lock);
+#endif
+    atomic_fetch_sub_explicit(&queue->sleepers, 1, memory_order_relaxed);
+}
+
+void mpmc_queue_cancel_wait(mpmc_queue_t* queue) {
+    atomic_fetch_sub_explicit(&queue->sleepers, 1, memory_order_relaxed);
+}
+
+void mpmc_queue_wake_all(mpmc_queue_t* queue) {
+    queue_wake(queue, true);
+}
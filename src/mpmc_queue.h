@@ -0,0 +1,59 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+/*
+ * Bounded lock-free multi-producer / multi-consumer queue of fixed-size items.
+ *
+ * Every cell carries a sequence number (Vyukov's bounded MPMC design), so
+ * producers and consumers each need only one compare-and-swap on their own
+ * cache line and never touch a lock. Items are written and read in place:
+ * a producer reserves a cell, fills it and publishes it; a consumer claims
+ * up to `max` consecutive published cells with a single CAS, uses them
+ * where they are and releases each one when done. A claimed cell stays
+ * occupied until it is released, so the capacity bounds items queued plus
+ * items being worked on.
+ *
+ * Idle consumers park on the queue's event count (a futex on Linux) rather
+ * than on a mutex and condition variable: producers only make a system
+ * call when someone is actually asleep.
+ *
+ *     uint32_t key = mpmc_queue_prepare_wait(q);
+ *     if (nothing to do) mpmc_queue_wait(q, key); else mpmc_queue_cancel_wait(q);
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct mpmc_queue mpmc_queue_t;
+
+// capacity is rounded up to a power of two
+mpmc_queue_t* mpmc_queue_create(size_t item_size, size_t capacity);
+void mpmc_queue_destroy(mpmc_queue_t* queue);
+size_t mpmc_queue_capacity(const mpmc_queue_t* queue);
+// Items reserved or queued but not claimed yet, as of some recent moment
+size_t mpmc_queue_depth(const mpmc_queue_t* queue);
+
+// Producer: a cell to fill, or NULL when the queue is full. Every reserved
+// cell must be published.
+void* mpmc_queue_reserve(mpmc_queue_t* queue);
+// Hand a filled cell to consumers and wake one parked consumer
+void mpmc_queue_publish(mpmc_queue_t* queue, void* item);
+
+// Consumer: claim up to max of the oldest items, in order, into items[].
+// Returns how many (0 when none is ready).
+int mpmc_queue_claim(mpmc_queue_t* queue, void** items, int max);
+// Give a claimed cell back to producers
+void mpmc_queue_release(mpmc_queue_t* queue, void* item);
+
+// Event count for parking consumers. prepare_wait() registers a sleeper
+// and returns its key; re-check the condition, then either wait() with the
+// key (returns at once if anything was published or woken since) or
+// cancel_wait().
+uint32_t mpmc_queue_prepare_wait(mpmc_queue_t* queue);
+void mpmc_queue_wait(mpmc_queue_t* queue, uint32_t key);
+void mpmc_queue_cancel_wait(mpmc_queue_t* queue);
+// Wake parked consumers after changing a condition they wait on
+void mpmc_queue_wake_all(mpmc_queue_t* queue);
+
+#endif /* MPMC_QUEUE_H */
@@ -0,0 +1,828 @@
+#include "engine_internal.h"
+#include "common.h"
+#include "histogram.h"
+#include "protocols/mqtt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * Pipelined MQTT back-end behind engine_start_mqtt_test().
+ *
+ * Each loop owns an epoll set and its share of the clients, every one a
+ * non-blocking MQTT 3.1.1 connection driven as a state machine: TCP
+ * connect, CONNECT/CONNACK, then SUBSCRIBE/SUBACK for subscribers. Packets
+ * are built with the builders in protocols/mqtt.c into a per-client output
+ * buffer and written whenever the socket takes them, so a publisher keeps
+ * up to `inflight` QoS 1/2 publishes on the wire instead of one round trip
+ * per message.
+ *
+ * A publisher's in-flight window is a slot table indexed by packet ID - 1:
+ * PUBACK (QoS 1) or PUBREC -> PUBREL -> PUBCOMP (QoS 2) walks the slot back
+ * to free, and the ack latency is taken from the send time kept there.
+ * Payloads start with the run's 64-bit tag and their publish time, so a
+ * subscriber times every delivery without shared state, and messages left
+ * over from another run (retained or queued) are ignored.
+ */
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#define MQTT_LOOP_MAX_EVENTS 256
+#define MQTT_LOOP_OPENING_WAIT_MS 5      /* while waiting for publishing to open */
+#define MQTT_STAMP_LEN 16
+#define MQTT_READ_CHUNK 16384
+#define MQTT_MAX_PACKET (1 << 20)        /* larger incoming packets are treated as garbage */
+#define MQTT_OUT_HIGH_WATER 65536        /* queue no more publishes above this much unsent output */
+#define MQTT_PUBLISH_BURST 64            /* publishes per client per pass, so one cannot hog its loop */
+#define MQTT_SWEEP_US 50000              /* how often in-flight publishes are checked for timeouts */
+
+typedef enum {
+    CLIENT_CONNECTING = 0,  /* TCP handshake */
+    CLIENT_CONNACK,         /* CONNECT sent */
+    CLIENT_SUBACK,          /* subscriber: SUBSCRIBE sent */
+    CLIENT_RUNNING,
+    CLIENT_DRAINING,        /* publisher: done publishing, waiting for its acks */
+    CLIENT_DONE
+} client_phase_t;
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_PUBACK,            /* QoS 1 publish sent */
+    SLOT_PUBREC,            /* QoS 2 publish sent */
+    SLOT_PUBCOMP            /* QoS 2 PUBREL sent */
+} slot_state_t;
+
+typedef struct {
+    uint64_t sent_us;
+    uint8_t state;
+} inflight_slot_t;
+
+typedef struct {
+    mqtt_connection_t conn;       /* client_id, socket_fd, is_connected, last_error */
+    bool subscriber;
+    bool settled;                 /* subscriber: counted out of subscribers_pending */
+    client_phase_t phase;
+    uint64_t op_start_us;         /* start of the connect or subscribe */
+    uint64_t last_send_us;        /* for keep-alive */
+    uint32_t events;              /* registered epoll interest */
+    out_buffer_t out;             /* packets not written yet */
+    char* in;                     /* bytes of packets not complete yet */
+    size_t in_len;
+    size_t in_cap;
+    inflight_slot_t* slots;       /* packet ID n is slots[n - 1] */
+    uint16_t* free_slots;         /* stack of free slot indexes */
+    int free_count;
+    uint64_t published;
+} mqtt_client_t;
+
+typedef struct {
+    pthread_t thread;
+    bool started;
+    engine_t* engine;
+    const mqtt_plan_t* plan;
+    struct mqtt_loop_group* group;
+    int loop_id;
+    int epoll_fd;
+    mqtt_client_t* clients;
+    int count;
+    int open;                     /* clients not yet CLIENT_DONE */
+    char* payload;                /* message template, stamped before every publish */
+    double rate;                  /* per publisher; 0 = unthrottled */
+    bool busy;                    /* a publisher stopped at its burst limit */
+    uint64_t next_sweep_us;
+
+    uint64_t acknowledged;
+    uint64_t ack_timeouts;
+    uint64_t connect_failures;
+    histogram_t* ack;
+    histogram_t* latency;
+} mqtt_loop_t;
+
+struct mqtt_loop_group {
+    mqtt_loop_t* loops;
+    int count;
+    _Atomic int running;
+    _Atomic int subscribers_pending;  /* not yet subscribed or failed */
+    _Atomic int subscribed;
+    _Atomic int publishers_left;
+    _Atomic uint64_t publish_start_us;   /* 0 until publishing opens */
+    _Atomic uint64_t publish_end_us;     /* 0 until the last publisher is done */
+    _Atomic uint64_t published;
+    _Atomic uint64_t delivered;
+    uint64_t tag;
+};
+
+static void client_watch(mqtt_loop_t* loop, mqtt_client_t* c, uint32_t events) {
+    engine_loop_watch(loop->epoll_fd, c->conn.socket_fd, c, &c->events, events);
+}
+
+static bool client_idle_window(const mqtt_loop_t* loop, const mqtt_client_t* c) {
+    return loop->plan->options.qos == MQTT_QOS_0 || c->free_count == loop->plan->options.inflight;
+}
+
+/* Subscribers are counted out of subscribers_pending once, subscribed or
+   not; the last one opens publishing */
+static void client_settle(mqtt_loop_t* loop, mqtt_client_t* c, bool subscribed) {
+    if (!c->subscriber || c->settled) return;
+    c->settled = true;
+    if (subscribed) atomic_fetch_add(&loop->group->subscribed, 1);
+    if (atomic_fetch_sub(&loop->group->subscribers_pending, 1) == 1) {
+        atomic_store(&loop->group->publish_start_us, get_time_us());
+    }
+}
+
+static void client_finish(mqtt_loop_t* loop, mqtt_client_t* c) {
+    if (c->conn.socket_fd >= 0) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, c->conn.socket_fd, NULL);
+        close(c->conn.socket_fd);
+        c->conn.socket_fd = -1;
+    }
+    c->conn.is_connected = false;
+    client_settle(loop, c, false);
+    if (!c->subscriber && atomic_fetch_sub(&loop->group->publishers_left, 1) == 1) {
+        atomic_store(&loop->group->publish_end_us, get_time_us());
+    }
+    c->phase = CLIENT_DONE;
+    loop->open--;
+}
+
+/* The connection is unusable: one failed sample for what it was doing (for
+   a publisher, one per unacknowledged publish), then the client is done */
+static void client_fail(mqtt_loop_t* loop, mqtt_client_t* c, CURLcode result, int err) {
+    const mqtt_plan_t* plan = loop->plan;
+    snprintf(c->conn.last_error, sizeof(c->conn.last_error), "%s",
+             err ? strerror(err) : curl_easy_strerror(result));
+
+    if (c->phase == CLIENT_CONNECTING || c->phase == CLIENT_CONNACK) {
+        engine_record_socket_since(loop->engine, plan->connect_label, c->op_start_us, result);
+        loop->connect_failures++;
+    } else if (c->phase == CLIENT_SUBACK) {
+        engine_record_socket_since(loop->engine, plan->subscribe_label, c->op_start_us, result);
+        loop->connect_failures++;
+    } else if (c->subscriber) {
+        engine_record_socket_since(loop->engine, plan->deliver_label, get_time_us(), result);
+    } else if (client_idle_window(loop, c)) {
+        engine_record_socket_since(loop->engine, plan->publish_label, get_time_us(), result);
+    } else {
+        for (int i = 0; i < plan->options.inflight; i++) {
+            if (c->slots[i].state == SLOT_FREE) continue;
+            engine_record_socket_since(loop->engine, plan->publish_label, c->slots[i].sent_us, result);
+            c->slots[i].state = SLOT_FREE;
+        }
+    }
+    client_finish(loop, c);
+}
+
+/* Queue a 4-byte ack-style packet (PUBACK, PUBREC, PUBREL, PUBCOMP) */
+static bool client_queue_ack(mqtt_client_t* c, unsigned char type, uint16_t packet_id) {
+    if (!out_buffer_reserve(&c->out, 4)) return false;
+    char* p = c->out.data + c->out.len;
+    p[0] = (char)type;
+    p[1] = 0x02;
+    p[2] = (char)(packet_id >> 8);
+    p[3] = (char)(packet_id & 0xFF);
+    c->out.len += 4;
+    return true;
+}
+
+static bool client_queue_bytes(mqtt_client_t* c, unsigned char first, unsigned char second) {
+    if (!out_buffer_reserve(&c->out, 2)) return false;
+    c->out.data[c->out.len++] = (char)first;
+    c->out.data[c->out.len++] = (char)second;
+    return true;
+}
+
+/* Write what the socket takes; watch EPOLLOUT while anything is left.
+   Returns -1 once the client has failed. */
+static int client_flush(mqtt_loop_t* loop, mqtt_client_t* c) {
+    ssize_t n = out_buffer_send(&c->out, c->conn.socket_fd);
+    if (n < 0) {
+        client_fail(loop, c, CURLE_SEND_ERROR, errno);
+        return -1;
+    }
+    if (n > 0) c->last_send_us = get_time_us();
+    client_watch(loop, c, out_buffer_pending(&c->out) > 0 ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    return 0;
+}
+
+static bool client_publishing_done(const mqtt_loop_t* loop, const mqtt_client_t* c) {
+    int messages = loop->plan->options.messages;
+    return atomic_load(&loop->engine->stop_flag) || (messages > 0 && c->published >= (uint64_t)messages);
+}
+
+/* Queue as many publishes as the rate, the in-flight window, the output
+   buffer and the burst limit allow */
+static bool client_publish(mqtt_loop_t* loop, mqtt_client_t* c, uint64_t now_us) {
+    const mqtt_test_options_t* options = &loop->plan->options;
+    uint64_t start_us = atomic_load(&loop->group->publish_start_us);
+
+    for (int burst = 0; burst < MQTT_PUBLISH_BURST; burst++) {
+        if (client_publishing_done(loop, c)) {
+            c->phase = CLIENT_DRAINING;
+            return true;
+        }
+        if (start_us == 0) return true;   /* subscribers are not all in yet */
+        if (loop->rate > 0.0) {
+            uint64_t credit = (uint64_t)((double)(now_us - start_us) * loop->rate / 1e6) + 1;
+            if (c->published >= credit) return true;
+        }
+        if (options->qos != MQTT_QOS_0 && c->free_count == 0) return true;
+        if (out_buffer_pending(&c->out) >= MQTT_OUT_HIGH_WATER) return true;
+
+        size_t need = strlen(options->topic) + (size_t)options->payload_size + 16;
+        if (!out_buffer_reserve(&c->out, need)) return false;
+
+        uint16_t packet_id = 0;
+        if (options->qos != MQTT_QOS_0) {
+            int slot = c->free_slots[--c->free_count];
+            c->slots[slot].sent_us = now_us;
+            c->slots[slot].state = options->qos == MQTT_QOS_1 ? SLOT_PUBACK : SLOT_PUBREC;
+            packet_id = (uint16_t)(slot + 1);
+        }
+        memcpy(loop->payload, &loop->group->tag, sizeof(uint64_t));
+        memcpy(loop->payload + sizeof(uint64_t), &now_us, sizeof(uint64_t));
+        c->out.len += (size_t)mqtt_create_publish_packet(c->out.data + c->out.len, options->topic, loop->payload,
+                                                         (size_t)options->payload_size, (mqtt_qos_t)options->qos,
+                                                         false, packet_id);
+        c->published++;
+        atomic_fetch_add_explicit(&loop->group->published, 1, memory_order_relaxed);
+        /* Nothing to wait for at QoS 0: the sample is the publish itself */
+        if (options->qos == MQTT_QOS_0) engine_record_socket_result(loop->engine, loop->plan->publish_label, 0, CURLE_OK);
+    }
+    loop->busy = true;
+    return true;
+}
+
+/* Publish what is due, disconnect a drained publisher, write the output */
+static void client_service(mqtt_loop_t* loop, mqtt_client_t* c) {
+    if (c->phase == CLIENT_RUNNING && !c->subscriber && !client_publish(loop, c, get_time_us())) {
+        client_fail(loop, c, CURLE_OUT_OF_MEMORY, 0);
+        return;
+    }
+    if (c->phase == CLIENT_DRAINING && client_idle_window(loop, c) && out_buffer_pending(&c->out) == 0) {
+        /* best effort: a clean DISCONNECT keeps the broker from publishing a will */
+        static const char disconnect[2] = {(char)MQTT_DISCONNECT, 0x00};
+        send(c->conn.socket_fd, disconnect, sizeof(disconnect), MSG_NOSIGNAL | MSG_DONTWAIT);
+        client_finish(loop, c);
+        return;
+    }
+    client_flush(loop, c);
+}
+
+static void client_slot_done(mqtt_loop_t* loop, mqtt_client_t* c, int slot) {
+    uint64_t now_us = get_time_us();
+    uint64_t ack_us = now_us > c->slots[slot].sent_us ? now_us - c->slots[slot].sent_us : 0;
+    engine_record_socket_result(loop->engine, loop->plan->publish_label, ack_us, CURLE_OK);
+    histogram_record(loop->ack, ack_us);
+    loop->acknowledged++;
+    c->slots[slot].state = SLOT_FREE;
+    c->free_slots[c->free_count++] = (uint16_t)slot;
+}
+
+/* A PUBLISH from the broker: time it if it is ours, and ack it */
+static CURLcode client_on_publish(mqtt_loop_t* loop, mqtt_client_t* c, unsigned char flags,
+                                  const char* body, size_t len) {
+    int qos = (flags >> 1) & 0x03;
+    if (len < 2) return CURLE_WEIRD_SERVER_REPLY;
+    size_t topic_len = ((size_t)(unsigned char)body[0] << 8) | (unsigned char)body[1];
+    size_t pos = 2 + topic_len + (qos > 0 ? 2 : 0);
+    if (pos > len) return CURLE_WEIRD_SERVER_REPLY;
+    uint16_t packet_id = qos > 0 ? (uint16_t)(((unsigned char)body[pos - 2] << 8) | (unsigned char)body[pos - 1]) : 0;
+
+    const char* payload = body + pos;
+    if (c->subscriber && len - pos >= MQTT_STAMP_LEN && memcmp(payload, &loop->group->tag, sizeof(uint64_t)) == 0) {
+        uint64_t sent_us;
+        memcpy(&sent_us, payload + sizeof(uint64_t), sizeof(uint64_t));
+        uint64_t now_us = get_time_us();
+        uint64_t latency_us = now_us > sent_us ? now_us - sent_us : 0;
+        histogram_record(loop->latency, latency_us);
+        engine_record_socket_result(loop->engine, loop->plan->deliver_label, latency_us, CURLE_OK);
+        atomic_fetch_add_explicit(&loop->group->delivered, 1, memory_order_relaxed);
+    }
+    if (qos == 0 || client_queue_ack(c, qos == 1 ? MQTT_PUBACK : MQTT_PUBREC, packet_id)) return CURLE_OK;
+    return CURLE_OUT_OF_MEMORY;
+}
+
+/* Act on one complete packet; false when the client has failed */
+static bool client_on_packet(mqtt_loop_t* loop, mqtt_client_t* c, unsigned char header,
+                             const char* body, size_t len) {
+    const mqtt_plan_t* plan = loop->plan;
+    unsigned char type = header & 0xF0;
+    uint16_t packet_id = len >= 2 ? (uint16_t)(((unsigned char)body[0] << 8) | (unsigned char)body[1]) : 0;
+    int slot = (int)packet_id - 1;
+    bool own = slot >= 0 && slot < plan->options.inflight && !c->subscriber && plan->options.qos != MQTT_QOS_0;
+
+    switch (type) {
+    case MQTT_CONNACK:
+        if (c->phase != CLIENT_CONNACK) return true;
+        if (len < 2 || body[1] != 0) {
+            client_fail(loop, c, CURLE_LOGIN_DENIED, 0);
+            return false;
+        }
+        engine_record_socket_since(loop->engine, plan->connect_label, c->op_start_us, CURLE_OK);
+        c->op_start_us = get_time_us();
+        if (!c->subscriber) {
+            c->phase = CLIENT_RUNNING;
+            return true;
+        }
+        {
+            const char* filter = plan->options.subscribe_topic;
+            if (!out_buffer_reserve(&c->out, strlen(filter) + 16)) {
+                client_fail(loop, c, CURLE_OUT_OF_MEMORY, 0);
+                return false;
+            }
+            c->out.len += (size_t)mqtt_create_subscribe_packet(c->out.data + c->out.len, filter,
+                                                               (mqtt_qos_t)plan->options.qos, 1);
+            c->phase = CLIENT_SUBACK;
+        }
+        return true;
+
+    case MQTT_SUBACK:
+        if (c->phase != CLIENT_SUBACK) return true;
+        if (len < 3 || (unsigned char)body[2] == 0x80) {
+            client_fail(loop, c, CURLE_REMOTE_ACCESS_DENIED, 0);
+            return false;
+        }
+        engine_record_socket_since(loop->engine, plan->subscribe_label, c->op_start_us, CURLE_OK);
+        c->phase = CLIENT_RUNNING;
+        client_settle(loop, c, true);
+        return true;
+
+    case MQTT_PUBLISH: {
+        CURLcode result = client_on_publish(loop, c, header & 0x0F, body, len);
+        if (result != CURLE_OK) {
+            client_fail(loop, c, result, 0);
+            return false;
+        }
+        return true;
+    }
+
+    case MQTT_PUBACK:
+        if (own && c->slots[slot].state == SLOT_PUBACK) client_slot_done(loop, c, slot);
+        return true;
+
+    case MQTT_PUBREC:
+        /* The broker holds the message until PUBREL, so always release it */
+        if (own && c->slots[slot].state == SLOT_PUBREC) c->slots[slot].state = SLOT_PUBCOMP;
+        if (!client_queue_ack(c, MQTT_PUBREL, packet_id)) {
+            client_fail(loop, c, CURLE_OUT_OF_MEMORY, 0);
+            return false;
+        }
+        return true;
+
+    case MQTT_PUBREL & 0xF0:
+        if (!client_queue_ack(c, MQTT_PUBCOMP, packet_id)) {
+            client_fail(loop, c, CURLE_OUT_OF_MEMORY, 0);
+            return false;
+        }
+        return true;
+
+    case MQTT_PUBCOMP:
+        if (own && c->slots[slot].state == SLOT_PUBCOMP) client_slot_done(loop, c, slot);
+        return true;
+
+    default:
+        return true;   /* PINGRESP, UNSUBACK */
+    }
+}
+
+/* Read everything queued and act on each complete packet */
+static void client_read(mqtt_loop_t* loop, mqtt_client_t* c) {
+    for (;;) {
+        if (c->in_cap - c->in_len < MQTT_READ_CHUNK) {
+            size_t cap = c->in_cap ? c->in_cap * 2 : MQTT_READ_CHUNK * 2;
+            char* in = realloc(c->in, cap);
+            if (!in) {
+                client_fail(loop, c, CURLE_OUT_OF_MEMORY, 0);
+                return;
+            }
+            c->in = in;
+            c->in_cap = cap;
+        }
+        ssize_t n = recv(c->conn.socket_fd, c->in + c->in_len, c->in_cap - c->in_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0) {
+            client_fail(loop, c, CURLE_RECV_ERROR, errno);
+            return;
+        }
+        if (n == 0) {
+            client_fail(loop, c, CURLE_GOT_NOTHING, 0);  /* closed by the broker */
+            return;
+        }
+        c->in_len += (size_t)n;
+
+        /* Fixed header: type byte, then the remaining length in 1-4 bytes */
+        size_t pos = 0;
+        while (c->in_len - pos >= 2) {
+            size_t length = 0;
+            size_t header = 1;
+            int shift = 0;
+            bool complete = false;
+            while (pos + header < c->in_len && header <= 4) {
+                unsigned char byte = (unsigned char)c->in[pos + header];
+                length |= (size_t)(byte & 0x7F) << shift;
+                shift += 7;
+                header++;
+                if (!(byte & 0x80)) {
+                    complete = true;
+                    break;
+                }
+            }
+            if (!complete && header > 4) {
+                client_fail(loop, c, CURLE_WEIRD_SERVER_REPLY, 0);
+                return;
+            }
+            if (!complete || c->in_len - pos - header < length) {
+                if (length > MQTT_MAX_PACKET) {
+                    client_fail(loop, c, CURLE_WEIRD_SERVER_REPLY, 0);
+                    return;
+                }
+                break;
+            }
+            if (!client_on_packet(loop, c, (unsigned char)c->in[pos], c->in + pos + header, length)) return;
+            pos += header + length;
+        }
+        memmove(c->in, c->in + pos, c->in_len - pos);
+        c->in_len -= pos;
+    }
+}
+
+/* The TCP handshake is done: send CONNECT */
+static void client_on_connected(mqtt_loop_t* loop, mqtt_client_t* c) {
+    const mqtt_test_options_t* options = &loop->plan->options;
+    c->conn.is_connected = true;
+    size_t need = strlen(c->conn.client_id) + 32;
+    if (options->username) need += strlen(options->username);
+    if (options->password) need += strlen(options->password);
+    if (!out_buffer_reserve(&c->out, need)) {
+        client_fail(loop, c, CURLE_OUT_OF_MEMORY, 0);
+        return;
+    }
+    c->out.len += (size_t)mqtt_create_connect_packet(c->out.data + c->out.len, c->conn.client_id, options->username,
+                                                     options->password, options->keep_alive_seconds);
+    c->phase = CLIENT_CONNACK;
+    client_flush(loop, c);
+}
+
+static void client_connect(mqtt_loop_t* loop, mqtt_client_t* c) {
+    const mqtt_plan_t* plan = loop->plan;
+    c->phase = CLIENT_CONNECTING;
+    c->op_start_us = get_time_us();
+
+    int fd = socket(plan->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        client_fail(loop, c, CURLE_COULDNT_CONNECT, errno);
+        return;
+    }
+    c->conn.socket_fd = fd;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    ev.data.ptr = c;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        client_fail(loop, c, CURLE_FAILED_INIT, errno);
+        return;
+    }
+    c->events = EPOLLOUT;
+
+    int rc;
+    do {
+        rc = connect(fd, (const struct sockaddr*)&plan->addr, plan->addr_len);
+    } while (rc != 0 && errno == EINTR);
+    if (rc == 0) {
+        client_on_connected(loop, c);
+    } else if (errno != EINPROGRESS) {
+        client_fail(loop, c, CURLE_COULDNT_CONNECT, errno);
+    }
+}
+
+static void client_on_event(mqtt_loop_t* loop, mqtt_client_t* c, uint32_t events) {
+    if (c->phase == CLIENT_DONE) return;
+    if (c->phase == CLIENT_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(c->conn.socket_fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) err = errno;
+        if (err == 0 && (events & EPOLLOUT)) {
+            client_on_connected(loop, c);
+        } else {
+            client_fail(loop, c, CURLE_COULDNT_CONNECT, err);
+        }
+        return;
+    }
+    /* errors and hang-ups surface through recv() */
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        client_read(loop, c);
+        if (c->phase == CLIENT_DONE) return;
+    }
+    client_service(loop, c);
+}
+
+/* Timeouts, keep-alive and the end of a subscriber's run */
+static void client_tick(mqtt_loop_t* loop, mqtt_client_t* c, uint64_t now_us, bool sweep) {
+    const mqtt_test_options_t* options = &loop->plan->options;
+    uint64_t timeout_us = (uint64_t)options->timeout_ms * 1000;
+
+    if (c->phase == CLIENT_CONNECTING || c->phase == CLIENT_CONNACK || c->phase == CLIENT_SUBACK) {
+        if (now_us - c->op_start_us >= timeout_us) client_fail(loop, c, CURLE_OPERATION_TIMEDOUT, 0);
+        return;
+    }
+
+    if (sweep && !c->subscriber && !client_idle_window(loop, c)) {
+        /* A late ack for a timed-out packet ID that has been reused is
+           credited to the newer publish; the broker should not send one */
+        for (int i = 0; i < options->inflight; i++) {
+            if (c->slots[i].state == SLOT_FREE || now_us - c->slots[i].sent_us < timeout_us) continue;
+            engine_record_socket_since(loop->engine, loop->plan->publish_label, c->slots[i].sent_us,
+                                       CURLE_OPERATION_TIMEDOUT);
+            loop->ack_timeouts++;
+            c->slots[i].state = SLOT_FREE;
+            c->free_slots[c->free_count++] = (uint16_t)i;
+        }
+    }
+
+    if (c->subscriber) {
+        uint64_t end_us = atomic_load(&loop->group->publish_end_us);
+        uint64_t expected = atomic_load(&loop->group->published) * (uint64_t)atomic_load(&loop->group->subscribed);
+        if (end_us != 0 && (atomic_load(&loop->group->delivered) >= expected ||
+                            now_us >= end_us + (uint64_t)options->linger_ms * 1000)) {
+            static const char disconnect[2] = {(char)MQTT_DISCONNECT, 0x00};
+            send(c->conn.socket_fd, disconnect, sizeof(disconnect), MSG_NOSIGNAL | MSG_DONTWAIT);
+            client_finish(loop, c);
+            return;
+        }
+    }
+
+    if (options->keep_alive_seconds > 0 && out_buffer_pending(&c->out) == 0 &&
+        now_us - c->last_send_us >= (uint64_t)options->keep_alive_seconds * 500000) {
+        if (!client_queue_bytes(c, MQTT_PINGREQ, 0x00)) {
+            client_fail(loop, c, CURLE_OUT_OF_MEMORY, 0);
+            return;
+        }
+    }
+    client_service(loop, c);
+}
+
+static void* mqtt_loop_thread_func(void* arg) {
+    mqtt_loop_t* loop = (mqtt_loop_t*)arg;
+    struct epoll_event events[MQTT_LOOP_MAX_EVENTS];
+    engine_place_thread(loop->engine, loop->loop_id);
+    uint64_t woke_us = 0;
+
+    for (int i = 0; i < loop->count; i++) client_connect(loop, &loop->clients[i]);
+
+    uint64_t next_tick_us = 0;
+    while (loop->open > 0) {
+        uint64_t now_us = get_time_us();
+        if (now_us >= next_tick_us || loop->busy) {
+            bool sweep = now_us >= loop->next_sweep_us;
+            if (sweep) loop->next_sweep_us = now_us + MQTT_SWEEP_US;
+            loop->busy = false;
+            for (int i = 0; i < loop->count; i++) {
+                if (loop->clients[i].phase != CLIENT_DONE) client_tick(loop, &loop->clients[i], now_us, sweep);
+            }
+            if (loop->open == 0) break;
+
+            int tick_ms = ENGINE_LOOP_IDLE_WAIT_MS;
+            if (atomic_load(&loop->group->publish_start_us) == 0) tick_ms = MQTT_LOOP_OPENING_WAIT_MS;
+            if (loop->rate > 0.0) tick_ms = 1;
+            next_tick_us = get_time_us() + (uint64_t)tick_ms * 1000;
+        }
+
+        int wait_ms = 0;
+        if (!loop->busy) {
+            now_us = get_time_us();
+            wait_ms = next_tick_us > now_us ? (int)((next_tick_us - now_us + 999) / 1000) : 0;
+        }
+        engine_record_loop_iteration(loop->engine, woke_us);
+        int n = epoll_wait(loop->epoll_fd, events, MQTT_LOOP_MAX_EVENTS, wait_ms);
+        woke_us = get_time_us();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "[LoadSpiker] MQTT loop %d: epoll_wait failed: %s\n", loop->loop_id, strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            client_on_event(loop, (mqtt_client_t*)events[i].data.ptr, events[i].events);
+        }
+    }
+
+    /* The last loop out lets the controller finish without waiting a tick */
+    engine_thread_exit(loop->engine);
+    if (atomic_fetch_sub(&loop->group->running, 1) == 1) engine_wake_controller(loop->engine);
+    return NULL;
+}
+
+static void loop_destroy(mqtt_loop_t* loop) {
+    if (loop->clients) {
+        for (int i = 0; i < loop->count; i++) {
+            mqtt_client_t* c = &loop->clients[i];
+            if (c->conn.socket_fd >= 0) close(c->conn.socket_fd);
+            out_buffer_free(&c->out);
+            free(c->in);
+            free(c->slots);
+            free(c->free_slots);
+        }
+        free(loop->clients);
+        loop->clients = NULL;
+    }
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+        loop->epoll_fd = -1;
+    }
+    free(loop->payload);
+    loop->payload = NULL;
+    histogram_destroy(loop->ack);
+    histogram_destroy(loop->latency);
+    loop->ack = loop->latency = NULL;
+}
+
+/* Client i is a subscriber for i < subscribers, and belongs to loop
+   i % loops; run_id keeps concurrent runs' client IDs apart */
+static int loop_init(mqtt_loop_t* loop, engine_t* engine, const mqtt_plan_t* plan, int loop_id,
+                     int loop_count, unsigned int run_id) {
+    const mqtt_test_options_t* options = &plan->options;
+    int total = options->subscribers + options->publishers;
+    loop->engine = engine;
+    loop->plan = plan;
+    loop->loop_id = loop_id;
+    loop->count = total / loop_count + (loop_id < total % loop_count ? 1 : 0);
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->clients = calloc((size_t)loop->count, sizeof(mqtt_client_t));
+    loop->payload = malloc((size_t)options->payload_size);
+    loop->ack = histogram_create(&engine->latency_layout);
+    loop->latency = histogram_create(&engine->latency_layout);
+    if (loop->clients) {
+        for (int k = 0; k < loop->count; k++) loop->clients[k].conn.socket_fd = -1;
+    }
+    if (loop->epoll_fd < 0 || !loop->clients || !loop->payload || !loop->ack || !loop->latency) return -1;
+    for (int b = MQTT_STAMP_LEN; b < options->payload_size; b++) loop->payload[b] = (char)('a' + b % 26);
+
+    for (int k = 0; k < loop->count; k++) {
+        mqtt_client_t* c = &loop->clients[k];
+        int index = k * loop_count + loop_id;
+        c->conn.port = options->port;
+        c->conn.keep_alive_seconds = options->keep_alive_seconds;
+        snprintf(c->conn.host, sizeof(c->conn.host), "%s", options->host);
+        c->subscriber = index < options->subscribers;
+        snprintf(c->conn.client_id, sizeof(c->conn.client_id), "%s-%08x-%c%d", options->client_id_prefix, run_id,
+                 c->subscriber ? 's' : 'p', c->subscriber ? index : index - options->subscribers);
+        if (c->subscriber || options->qos == MQTT_QOS_0) continue;
+
+        c->slots = calloc((size_t)options->inflight, sizeof(inflight_slot_t));
+        c->free_slots = malloc(sizeof(uint16_t) * (size_t)options->inflight);
+        if (!c->slots || !c->free_slots) return -1;
+        for (int s = 0; s < options->inflight; s++) c->free_slots[s] = (uint16_t)(options->inflight - 1 - s);
+        c->free_count = options->inflight;
+    }
+    if (options->rate > 0.0) loop->rate = options->rate / options->publishers;
+    loop->open = loop->count;
+    return 0;
+}
+
+mqtt_loop_group_t* mqtt_loop_start(engine_t* engine, const mqtt_plan_t* plan) {
+    if (!engine || !plan || plan->options.publishers <= 0) return NULL;
+    const mqtt_test_options_t* options = &plan->options;
+
+    int total = options->publishers + options->subscribers;
+    int count = engine->event_loops;
+    if (count > total) count = total;
+    if (count <= 0) count = 1;
+    engine_raise_fd_limit(total, ENGINE_FD_HEADROOM, "MQTT test");
+
+    mqtt_loop_group_t* group = calloc(1, sizeof(mqtt_loop_group_t));
+    if (!group) return NULL;
+    group->loops = calloc((size_t)count, sizeof(mqtt_loop_t));
+    if (!group->loops) {
+        free(group);
+        return NULL;
+    }
+    group->count = count;
+    uint64_t seed = get_time_us() ^ (uint64_t)(uintptr_t)group;
+    group->tag = (seed ^ (seed >> 31)) * 0x9e3779b97f4a7c15ULL;
+    atomic_store(&group->subscribers_pending, options->subscribers);
+    atomic_store(&group->publishers_left, options->publishers);
+    if (options->subscribers == 0) atomic_store(&group->publish_start_us, get_time_us());
+
+    /* Set every loop up before any starts, so a failure connects nothing */
+    for (int i = 0; i < count; i++) {
+        mqtt_loop_t* loop = &group->loops[i];
+        loop->epoll_fd = -1;
+        loop->group = group;
+        if (loop_init(loop, engine, plan, i, count, (unsigned int)(group->tag >> 32)) != 0) {
+            fprintf(stderr, "[LoadSpiker] MQTT loop %d: initialisation failed\n", i);
+            for (int j = 0; j <= i; j++) loop_destroy(&group->loops[j]);
+            free(group->loops);
+            free(group);
+            return NULL;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        mqtt_loop_t* loop = &group->loops[i];
+        atomic_fetch_add(&group->running, 1);
+        if (pthread_create(&loop->thread, NULL, mqtt_loop_thread_func, loop) != 0) {
+            /* its clients never run: count them out so the others finish */
+            atomic_fetch_sub(&group->running, 1);
+            for (int k = 0; k < loop->count; k++) {
+                mqtt_client_t* c = &loop->clients[k];
+                c->phase = CLIENT_CONNACK;
+                c->op_start_us = get_time_us();
+                client_fail(loop, c, CURLE_FAILED_INIT, 0);
+            }
+            continue;
+        }
+        loop->started = true;
+    }
+    return group;
+}
+
+bool mqtt_loop_done(mqtt_loop_group_t* group) {
+    return !group || atomic_load(&group->running) == 0;
+}
+
+void mqtt_loop_join(mqtt_loop_group_t* group, mqtt_test_result_t* result) {
+    if (!group) return;
+
+    memset(result, 0, sizeof(mqtt_test_result_t));
+    histogram_t* ack = NULL;
+    histogram_t* latency = NULL;
+    for (int i = 0; i < group->count; i++) {
+        mqtt_loop_t* loop = &group->loops[i];
+        if (loop->started) pthread_join(loop->thread, NULL);
+        result->acknowledged += loop->acknowledged;
+        result->ack_timeouts += loop->ack_timeouts;
+        result->connect_failures += loop->connect_failures;
+        if (!ack) {
+            ack = loop->ack;
+            latency = loop->latency;
+            loop->ack = loop->latency = NULL;
+        } else {
+            if (loop->ack) histogram_add(ack, loop->ack);
+            if (loop->latency) histogram_add(latency, loop->latency);
+        }
+        loop_destroy(loop);
+    }
+
+    result->published = atomic_load(&group->published);
+    result->delivered = atomic_load(&group->delivered);
+    int subscribed = atomic_load(&group->subscribed);
+    result->expected = result->published * (uint64_t)subscribed;
+    uint64_t start_us = atomic_load(&group->publish_start_us);
+    uint64_t end_us = atomic_load(&group->publish_end_us);
+    if (start_us != 0 && end_us > start_us) result->elapsed_seconds = (double)(end_us - start_us) / 1e6;
+    if (result->elapsed_seconds > 0.0) {
+        result->publish_rate = (double)result->published / result->elapsed_seconds;
+        result->delivery_rate = (double)result->delivered / result->elapsed_seconds;
+    }
+    result->loss_rate = -1.0;
+    if (subscribed > 0) {
+        result->loss_rate = result->expected && result->delivered < result->expected ?
+                            1.0 - (double)result->delivered / (double)result->expected : 0.0;
+    }
+    if (ack) {
+        result->ack_p50_us = histogram_value_at_percentile(ack, 50.0);
+        result->ack_p99_us = histogram_value_at_percentile(ack, 99.0);
+        result->ack_max_us = ack->max_value;
+        histogram_destroy(ack);
+    }
+    if (latency) {
+        result->latency_p50_us = histogram_value_at_percentile(latency, 50.0);
+        result->latency_p90_us = histogram_value_at_percentile(latency, 90.0);
+        result->latency_p99_us = histogram_value_at_percentile(latency, 99.0);
+        result->latency_max_us = latency->max_value;
+        histogram_destroy(latency);
+    }
+
+    free(group->loops);
+    free(group);
+}
+
+#else /* !__linux__ */
+
+mqtt_loop_group_t* mqtt_loop_start(engine_t* engine, const mqtt_plan_t* plan) {
+    (void)engine;
+    (void)plan;
+    return NULL;
+}
+
+bool mqtt_loop_done(mqtt_loop_group_t* group) {
+    (void)group;
+    return true;
+}
+
+void mqtt_loop_join(mqtt_loop_group_t* group, mqtt_test_result_t* result) {
+    (void)group;
+    (void)result;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,540 @@
+#include "param_table.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PARAM_TABLE_INITIAL_ARENA 4096
+#define PARAM_TABLE_INITIAL_ROWS 64
+#define PARAM_PLANS_INITIAL_SEGMENTS 64
+
+void param_table_init(param_table_t* table, const char* name) {
+    if (!table) return;
+    memset(table, 0, sizeof(param_table_t));
+    snprintf(table->name, sizeof(table->name), "%s", name && name[0] ? name : "data");
+}
+
+void param_table_free(param_table_t* table) {
+    if (!table) return;
+    if (table->columns) {
+        for (int c = 0; c < table->column_count; c++) free(table->columns[c]);
+    }
+    free(table->columns);
+    free(table->column_names);
+    free(table->column_max);
+    free(table->arena);
+    memset(table, 0, sizeof(param_table_t));
+}
+
+static int arena_reserve(param_table_t* table, size_t extra) {
+    if (extra > SIZE_MAX - table->arena_size) return -1;
+    size_t needed = table->arena_size + extra;
+    if (needed <= table->arena_capacity) return 0;
+
+    size_t capacity = table->arena_capacity ? table->arena_capacity : PARAM_TABLE_INITIAL_ARENA;
+    while (capacity < needed) {
+        if (capacity > SIZE_MAX / 2) {
+            capacity = needed;
+            break;
+        }
+        capacity *= 2;
+    }
+    char* arena = realloc(table->arena, capacity);
+    if (!arena) return -1;
+    table->arena = arena;
+    table->arena_capacity = capacity;
+    return 0;
+}
+
+/* Copy len bytes plus a terminating NUL; arena space must already be reserved */
+static size_t arena_push(param_table_t* table, const char* data, size_t len) {
+    size_t off = table->arena_size;
+    if (len > 0) memcpy(table->arena + off, data, len);
+    table->arena[off + len] = '\0';
+    table->arena_size += len + 1;
+    return off;
+}
+
+int param_table_column(const param_table_t* table, const char* name, size_t len) {
+    if (!table || !name) return -1;
+    for (int c = 0; c < table->column_count; c++) {
+        const char* column = table->arena + table->column_names[c];
+        if (strlen(column) == len && memcmp(column, name, len) == 0) return c;
+    }
+    return -1;
+}
+
+int param_table_set_columns(param_table_t* table, const char* const* names, const size_t* lens, int count) {
+    if (!table || !names || !lens || count <= 0 || table->column_count > 0) return -1;
+
+    size_t bytes = 0;
+    for (int c = 0; c < count; c++) {
+        if (!names[c] || lens[c] == 0 || lens[c] > SIZE_MAX / 2 - bytes) return -1;
+        bytes += lens[c] + 1;
+    }
+    table->column_names = calloc((size_t)count, sizeof(size_t));
+    table->columns = calloc((size_t)count, sizeof(param_cell_t*));
+    table->column_max = calloc((size_t)count, sizeof(uint32_t));
+    if (!table->column_names || !table->columns || !table->column_max || arena_reserve(table, bytes) != 0) {
+        free(table->column_names);
+        free(table->columns);
+        free(table->column_max);
+        table->column_names = NULL;
+        table->columns = NULL;
+        table->column_max = NULL;
+        return -1;
+    }
+
+    size_t mark = table->arena_size;
+    for (int c = 0; c < count; c++) {
+        table->column_names[c] = arena_push(table, names[c], lens[c]);
+        table->column_count = c;   /* only the names pushed so far are searched */
+        if (param_table_column(table, names[c], lens[c]) >= 0) {
+            table->arena_size = mark;
+            table->column_count = 0;
+            free(table->column_names);
+            free(table->columns);
+            free(table->column_max);
+            table->column_names = NULL;
+            table->columns = NULL;
+            table->column_max = NULL;
+            return -1;
+        }
+    }
+    table->column_count = count;
+    return 0;
+}
+
+static int rows_reserve(param_table_t* table) {
+    if (table->row_count < table->row_capacity) return 0;
+    if (table->row_count == INT_MAX) return -1;
+    int capacity = table->row_capacity ? table->row_capacity : PARAM_TABLE_INITIAL_ROWS;
+    while (capacity <= table->row_count) capacity = capacity > INT_MAX / 2 ? INT_MAX : capacity * 2;
+
+    for (int c = 0; c < table->column_count; c++) {
+        param_cell_t* cells = realloc(table->columns[c], sizeof(param_cell_t) * (size_t)capacity);
+        if (!cells) return -1;   /* columns already grown keep their larger arrays */
+        table->columns[c] = cells;
+    }
+    table->row_capacity = capacity;
+    return 0;
+}
+
+int param_table_add_row(param_table_t* table, const char* const* values, const size_t* lens) {
+    if (!table || !values || !lens || table->column_count <= 0) return -1;
+
+    size_t bytes = 0;
+    for (int c = 0; c < table->column_count; c++) {
+        if (lens[c] > UINT32_MAX - 1 || lens[c] > SIZE_MAX / 2 - bytes) return -1;
+        bytes += lens[c] + 1;
+    }
+    if (rows_reserve(table) != 0 || arena_reserve(table, bytes) != 0) return -1;
+
+    int row = table->row_count++;
+    for (int c = 0; c < table->column_count; c++) {
+        param_cell_t* cell = &table->columns[c][row];
+        cell->off = arena_push(table, values[c] ? values[c] : "", values[c] ? lens[c] : 0);
+        cell->len = values[c] ? (uint32_t)lens[c] : 0;
+        if (cell->len > table->column_max[c]) table->column_max[c] = cell->len;
+    }
+    return row;
+}
+
+/* ---- CSV --------------------------------------------------------------- */
+
+typedef struct {
+    char* data;                /* unquoted fields of one record, back to back */
+    size_t size;
+    size_t capacity;
+    size_t* starts;
+    size_t* lens;
+    int count;
+    int capacity_fields;
+} csv_record_t;
+
+static int record_push_byte(csv_record_t* record, char c) {
+    if (record->size == record->capacity) {
+        size_t capacity = record->capacity ? record->capacity * 2 : 256;
+        char* data = realloc(record->data, capacity);
+        if (!data) return -1;
+        record->data = data;
+        record->capacity = capacity;
+    }
+    record->data[record->size++] = c;
+    return 0;
+}
+
+static int record_end_field(csv_record_t* record, size_t start) {
+    if (record->count == record->capacity_fields) {
+        int capacity = record->capacity_fields ? record->capacity_fields * 2 : 16;
+        size_t* starts = realloc(record->starts, sizeof(size_t) * (size_t)capacity);
+        if (!starts) return -1;
+        record->starts = starts;
+        size_t* lens = realloc(record->lens, sizeof(size_t) * (size_t)capacity);
+        if (!lens) return -1;
+        record->lens = lens;
+        record->capacity_fields = capacity;
+    }
+    record->starts[record->count] = start;
+    record->lens[record->count] = record->size - start;
+    record->count++;
+    return 0;
+}
+
+/* Parse one record starting at *pos; advances past its line end. Returns 1
+   for a record, 0 at the end of input, -1 on a malformed quote. *lines
+   counts the newlines consumed (a quoted field may span several). */
+static int csv_next_record(const char* data, size_t len, size_t* pos, char delimiter,
+                           csv_record_t* record, int* lines) {
+    record->size = 0;
+    record->count = 0;
+    size_t i = *pos;
+    if (i >= len) return 0;
+
+    size_t start = 0;
+    bool quoted = false;
+    bool field_quoted = false;
+    for (;;) {
+        if (i >= len) {
+            if (quoted) return -1;
+            break;
+        }
+        char c = data[i++];
+        if (quoted) {
+            if (c == '"') {
+                if (i < len && data[i] == '"') {
+                    if (record_push_byte(record, '"') != 0) return -1;
+                    i++;
+                } else {
+                    quoted = false;
+                }
+            } else {
+                if (c == '\n') (*lines)++;
+                if (record_push_byte(record, c) != 0) return -1;
+            }
+        } else if (c == '"' && record->size == start && !field_quoted) {
+            quoted = true;
+            field_quoted = true;
+        } else if (c == delimiter) {
+            if (record_end_field(record, start) != 0) return -1;
+            start = record->size;
+            field_quoted = false;
+        } else if (c == '\n') {
+            (*lines)++;
+            break;
+        } else if (c == '\r' && (i >= len || data[i] == '\n')) {
+            continue;
+        } else {
+            if (record_push_byte(record, c) != 0) return -1;
+        }
+    }
+    if (record_end_field(record, start) != 0) return -1;
+    *pos = i;
+    return 1;
+}
+
+static bool record_blank(const csv_record_t* record) {
+    return record->count == 1 && record->lens[0] == 0;
+}
+
+int param_table_load_csv(param_table_t* table, const char* data, size_t len, char delimiter,
+                         char* error, size_t error_len) {
+    if (error && error_len > 0) error[0] = '\0';
+    if (!table || (!data && len > 0) || delimiter == '"' || delimiter == '\n' || delimiter == '\r') return -1;
+
+    csv_record_t record;
+    memset(&record, 0, sizeof(record));
+    const char** values = NULL;
+    size_t pos = 0;
+    int line = 1;
+    int added = 0;
+    int rc = 0;
+    bool header = table->column_count == 0;
+
+    /* Skip a UTF-8 byte order mark */
+    if (len >= 3 && memcmp(data, "\xef\xbb\xbf", 3) == 0) pos = 3;
+
+    for (;;) {
+        int record_line = line;
+        int got = csv_next_record(data, len, &pos, delimiter, &record, &line);
+        if (got == 0) break;
+        if (got < 0) {
+            snprintf(error, error_len, "line %d: unterminated quoted field", record_line);
+            rc = -1;
+            break;
+        }
+        if (record_blank(&record)) continue;
+
+        if (!values) {
+            values = malloc(sizeof(char*) * (size_t)record.count);
+            if (!values) {
+                rc = -1;
+                break;
+            }
+        }
+        for (int c = 0; c < record.count && (header || c < table->column_count); c++) {
+            values[c] = record.data + record.starts[c];
+        }
+
+        if (header) {
+            /* Column names are trimmed */
+            for (int c = 0; c < record.count; c++) {
+                while (record.lens[c] > 0 && (*values[c] == ' ' || *values[c] == '\t')) {
+                    values[c]++;
+                    record.lens[c]--;
+                }
+                while (record.lens[c] > 0 && (values[c][record.lens[c] - 1] == ' ' || values[c][record.lens[c] - 1] == '\t')) {
+                    record.lens[c]--;
+                }
+            }
+            if (param_table_set_columns(table, values, record.lens, record.count) != 0) {
+                snprintf(error, error_len, "line %d: column names must be unique and not empty", record_line);
+                rc = -1;
+                break;
+            }
+            header = false;
+            continue;
+        }
+
+        if (record.count != table->column_count) {
+            snprintf(error, error_len, "line %d: %d fields, expected %d", record_line, record.count,
+                     table->column_count);
+            rc = -1;
+            break;
+        }
+        if (param_table_add_row(table, values, record.lens) < 0) {
+            snprintf(error, error_len, "line %d: out of memory", record_line);
+            rc = -1;
+            break;
+        }
+        added++;
+    }
+
+    if (rc == -1 && error && error[0] == '\0') snprintf(error, error_len, "out of memory");
+    if (rc == 0 && header) {
+        snprintf(error, error_len, "no header row");
+        rc = -1;
+    }
+    free(values);
+    free(record.data);
+    free(record.starts);
+    free(record.lens);
+    return rc == 0 ? added : -1;
+}
+
+int param_table_load_csv_file(param_table_t* table, const char* path, char delimiter,
+                              char* error, size_t error_len) {
+    if (!table || !path) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -2;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -2;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+        return -2;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return param_table_load_csv(table, "", 0, delimiter, error, error_len);
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = saved;
+        return -2;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+    int rc = param_table_load_csv(table, map, (size_t)st.st_size, delimiter, error, error_len);
+    munmap(map, (size_t)st.st_size);
+    return rc;
+}
+
+/* ---- Plans -------------------------------------------------------------- */
+
+void param_plans_free(param_plans_t* plans) {
+    if (!plans) return;
+    free(plans->plans);
+    free(plans->segments);
+    memset(plans, 0, sizeof(param_plans_t));
+}
+
+static int plans_push(param_plans_t* plans, const char* text, size_t len, int column) {
+    if (plans->segment_count == plans->segment_capacity) {
+        if (plans->segment_capacity > INT_MAX / 2) return -1;
+        int capacity = plans->segment_capacity ? plans->segment_capacity * 2 : PARAM_PLANS_INITIAL_SEGMENTS;
+        param_segment_t* segments = realloc(plans->segments, sizeof(param_segment_t) * (size_t)capacity);
+        if (!segments) return -1;
+        plans->segments = segments;
+        plans->segment_capacity = capacity;
+    }
+    param_segment_t* segment = &plans->segments[plans->segment_count++];
+    segment->text = text;
+    segment->len = (uint32_t)len;
+    segment->column = column;
+    return 0;
+}
+
+/* Column named by the placeholder body: "column" or "<table name>.column" */
+static int placeholder_column(const param_table_t* data, const char* name, size_t len) {
+    size_t prefix = strlen(data->name);
+    if (len > prefix + 1 && memcmp(name, data->name, prefix) == 0 && name[prefix] == '.') {
+        int column = param_table_column(data, name + prefix + 1, len - prefix - 1);
+        if (column >= 0) return column;
+    }
+    return param_table_column(data, name, len);
+}
+
+/* Split text into segments; *expanded gets the most bytes it can become.
+   A field without a known placeholder gets no segments. */
+static int plan_field(param_plans_t* plans, const char* text, size_t len, param_field_t* field, size_t* expanded) {
+    field->first = plans->segment_count;
+    field->count = 0;
+    *expanded = len;
+
+    const param_table_t* data = plans->data;
+    size_t literal = 0;
+    bool any = false;
+    size_t max = 0;
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (text[i] != '$' || text[i + 1] != '{') continue;
+        const char* close = memchr(text + i + 2, '}', len - i - 2);
+        if (!close) break;
+        size_t name_len = (size_t)(close - (text + i + 2));
+        int column = name_len > 0 ? placeholder_column(data, text + i + 2, name_len) : -1;
+        if (column < 0) continue;
+
+        if (i > literal && plans_push(plans, text + literal, i - literal, -1) != 0) return -1;
+        if (plans_push(plans, NULL, 0, column) != 0) return -1;
+        max += (i - literal) + data->column_max[column];
+        literal = (size_t)(close - text) + 1;
+        i = literal - 1;
+        any = true;
+    }
+    if (!any) {
+        plans->segment_count = field->first;
+        return 0;
+    }
+    if (len > literal && plans_push(plans, text + literal, len - literal, -1) != 0) return -1;
+    field->count = plans->segment_count - field->first;
+    *expanded = max + (len - literal);
+    return 0;
+}
+
+int param_plans_compile(param_plans_t* plans, const request_table_t* requests, const param_table_t* data,
+                        param_strategy_t strategy, uint64_t seed) {
+    if (!plans || !requests || requests->count <= 0 || !data || data->row_count <= 0) return -1;
+    if (strategy < PARAM_ROWS_SEQUENTIAL || strategy > PARAM_ROWS_SHARED) return -1;
+    memset(plans, 0, sizeof(param_plans_t));
+    plans->data = data;
+    plans->strategy = strategy;
+    plans->seed = seed;
+    plans->plans = calloc((size_t)requests->count, sizeof(param_plan_t));
+    if (!plans->plans) return -1;
+    plans->count = requests->count;
+
+    for (int i = 0; i < requests->count; i++) {
+        request_view_t request;
+        request_table_get(requests, i, &request);
+        param_plan_t* plan = &plans->plans[i];
+        size_t url_len, headers_len, body_len;
+        if (plan_field(plans, request.url, strlen(request.url), &plan->url, &url_len) != 0 ||
+            plan_field(plans, request.headers, request.headers_len, &plan->headers, &headers_len) != 0 ||
+            plan_field(plans, request.body, request.body_len, &plan->body, &body_len) != 0) {
+            param_plans_free(plans);
+            return -1;
+        }
+        if (!param_plan_active(plans, i)) continue;
+
+        size_t expanded = url_len + headers_len + body_len + 3;
+        if (expanded > plans->max_expanded) plans->max_expanded = expanded;
+        if (plan->headers.count) {
+            int lines = 1;
+            for (size_t j = 0; j < request.headers_len; j++) lines += request.headers[j] == '\n';
+            if (lines > plans->max_header_lines) plans->max_header_lines = lines;
+        }
+    }
+    return 0;
+}
+
+static uint64_t splitmix64_mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+uint32_t param_row(const param_plans_t* plans, uint64_t pass, int user) {
+    uint64_t rows = (uint64_t)plans->data->row_count;
+    switch (plans->strategy) {
+    case PARAM_ROWS_SEQUENTIAL:
+        return (uint32_t)((uint64_t)(user > 0 ? user : 0) % rows);
+    case PARAM_ROWS_CIRCULAR:
+        return (uint32_t)(pass % rows);
+    case PARAM_ROWS_RANDOM:
+        return (uint32_t)(splitmix64_mix(plans->seed ^ splitmix64_mix(pass)) % rows);
+    case PARAM_ROWS_UNIQUE:
+        return (uint32_t)(pass < rows ? pass : rows - 1);   /* the engine stops dispatch at rows passes */
+    case PARAM_ROWS_SHARED:
+    default:
+        return 0;
+    }
+}
+
+/* Write one field; header values lose CR/LF so a cell cannot add header lines */
+static char* expand_field(const param_plans_t* plans, const param_field_t* field, uint32_t row, char* out,
+                          bool header) {
+    for (int s = field->first; s < field->first + field->count; s++) {
+        const param_segment_t* segment = &plans->segments[s];
+        if (segment->text) {
+            memcpy(out, segment->text, segment->len);
+            out += segment->len;
+            continue;
+        }
+        uint32_t len;
+        const char* cell = param_table_cell(plans->data, segment->column, (int)row, &len);
+        memcpy(out, cell, len);
+        if (header) {
+            for (uint32_t i = 0; i < len; i++) {
+                if (out[i] == '\r' || out[i] == '\n') out[i] = ' ';
+            }
+        }
+        out += len;
+    }
+    return out;
+}
+
+void param_expand(const param_plans_t* plans, request_view_t* request, uint32_t row, char* out) {
+    const param_plan_t* plan = &plans->plans[request->index];
+    if (plan->url.count) {
+        request->url = out;
+        out = expand_field(plans, &plan->url, row, out, false);
+        *out++ = '\0';
+    }
+    if (plan->headers.count) {
+        char* headers = out;
+        out = expand_field(plans, &plan->headers, row, out, true);
+        request->headers = headers;
+        request->headers_len = (size_t)(out - headers);
+        *out++ = '\0';
+    }
+    if (plan->body.count) {
+        char* body = out;
+        out = expand_field(plans, &plan->body, row, out, false);
+        request->body = body;
+        request->body_len = (size_t)(out - body);
+        *out = '\0';
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef PARAM_TABLE_H
+#define PARAM_TABLE_H
+
+/*
+ * Data-driven load-test parameters, substituted in C at send time.
+ *
+ * A param table is a columnar set of string cells (a CSV file, or rows
+ * handed over from Python) loaded once before the test, with every cell
+ * stored once in one arena. Requests refer to its columns with ${column}
+ * or ${name.column} placeholders in their URL, headers and body.
+ *
+ * When the test starts, param_plans_compile() splits every request that
+ * uses a placeholder into literal and column segments, and works out the
+ * most bytes any request can expand to. Workers call param_expand() with
+ * the row chosen for the request and a scratch buffer of that size, so
+ * substitution needs no GIL, no parsing and no allocation per request.
+ * Placeholders that name no column are sent as written.
+ */
+
+#include "request_table.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PARAM_TABLE_NAME_MAX 64
+
+// Which data row a request uses. A "pass" is one trip through the request
+// table: every request of a pass shares its row.
+typedef enum {
+    PARAM_ROWS_SEQUENTIAL = 0,  // per virtual user: user u gets row u % rows
+    PARAM_ROWS_CIRCULAR = 1,    // the next row for every pass, wrapping around
+    PARAM_ROWS_RANDOM = 2,      // a random row for every pass (seeded)
+    PARAM_ROWS_UNIQUE = 3,      // a fresh row for every pass; dispatch ends when they run out
+    PARAM_ROWS_SHARED = 4       // every request uses the first row
+} param_strategy_t;
+
+typedef struct {
+    size_t off;                // into the arena; NUL-terminated
+    uint32_t len;
+} param_cell_t;
+
+typedef struct {
+    char name[PARAM_TABLE_NAME_MAX];   // source name for ${name.column}
+    char* arena;
+    size_t arena_size;
+    size_t arena_capacity;
+    int column_count;
+    size_t* column_names;      // arena offsets
+    param_cell_t** columns;    // columns[c][row]
+    uint32_t* column_max;      // longest cell of each column
+    int row_count;
+    int row_capacity;
+} param_table_t;
+
+// name NULL or "" = "data"
+void param_table_init(param_table_t* table, const char* name);
+void param_table_free(param_table_t* table);
+
+// Set the column names of an empty table (once). Returns 0, or -1 on
+// duplicate or empty names / out of memory.
+int param_table_set_columns(param_table_t* table, const char* const* names, const size_t* lens, int count);
+// Append one row of column_count values; returns its index or -1
+int param_table_add_row(param_table_t* table, const char* const* values, const size_t* lens);
+
+// Load CSV: a header row of column names, then one row per line. Fields
+// may be quoted ("a ""quoted"", field"), blank lines are skipped and CRLF
+// is accepted. Returns the rows added, or -1 with "line N: reason" in error.
+int param_table_load_csv(param_table_t* table, const char* data, size_t len, char delimiter,
+                         char* error, size_t error_len);
+// Same from a file; -2 with errno set when it cannot be read
+int param_table_load_csv_file(param_table_t* table, const char* path, char delimiter,
+                              char* error, size_t error_len);
+
+// Index of the column called name[0..len), or -1
+int param_table_column(const param_table_t* table, const char* name, size_t len);
+
+static inline const char* param_table_cell(const param_table_t* table, int column, int row, uint32_t* len) {
+    const param_cell_t* cell = &table->columns[column][row];
+    *len = cell->len;
+    return table->arena + cell->off;
+}
+
+/* ---- Per-test substitution plans ---------------------------------------- */
+
+typedef struct {
+    const char* text;          // literal bytes, or NULL for a column
+    uint32_t len;
+    int column;
+} param_segment_t;
+
+typedef struct {
+    int first;                 // into segments
+    int count;                 // 0 = the field has no placeholder
+} param_field_t;
+
+typedef struct {
+    param_field_t url;
+    param_field_t headers;
+    param_field_t body;
+} param_plan_t;
+
+typedef struct {
+    const param_table_t* data;
+    param_strategy_t strategy;
+    uint64_t seed;             // PARAM_ROWS_RANDOM
+    param_plan_t* plans;       // per request
+    int count;
+    param_segment_t* segments;
+    int segment_count;
+    int segment_capacity;
+    size_t max_expanded;       // most bytes param_expand() writes for any request
+    int max_header_lines;      // most header lines of a request with parameterized headers
+} param_plans_t;
+
+// Plan every request of `requests` against `data` (both must outlive the plans)
+int param_plans_compile(param_plans_t* plans, const request_table_t* requests, const param_table_t* data,
+                        param_strategy_t strategy, uint64_t seed);
+void param_plans_free(param_plans_t* plans);
+
+static inline bool param_plan_active(const param_plans_t* plans, int index) {
+    const param_plan_t* plan = &plans->plans[index];
+    return plan->url.count || plan->headers.count || plan->body.count;
+}
+
+// Row for pass `pass` of the request table, sent by virtual user `user`
+uint32_t param_row(const param_plans_t* plans, uint64_t pass, int user);
+
+// Write request `request`'s url, headers and body for data row `row` into
+// out (max_expanded bytes) and point request's fields at them. Fields
+// without placeholders keep pointing into the request table.
+void param_expand(const param_plans_t* plans, request_view_t* request, uint32_t row, char* out);
+
+#endif /* PARAM_TABLE_H */
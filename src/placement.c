@@ -0,0 +1,141 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   /* pthread_setaffinity_np, syscall */
+#endif
+#include "placement.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define NODE_MASK_WORDS (PLACEMENT_MAX_CPU / (8 * sizeof(unsigned long)))
+
+int placement_parse_cpus(const char* list, int* cpus, int max) {
+    if (!list || !cpus || max <= 0) return -1;
+
+    int count = 0;
+    const char* p = list;
+    while (*p) {
+        while (isspace((unsigned char)*p)) p++;
+        if (!isdigit((unsigned char)*p)) return -1;
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            p++;
+            if (!isdigit((unsigned char)*p)) return -1;
+            last = strtol(p, &end, 10);
+            p = end;
+        }
+        if (first < 0 || last < first || last >= PLACEMENT_MAX_CPU) return -1;
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (count == max) return -1;
+            cpus[count++] = (int)cpu;
+        }
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == ',') {
+            p++;
+            if (*p == '\0') return -1;
+        } else if (*p) {
+            return -1;
+        }
+    }
+    return count;
+}
+
+#ifdef __linux__
+
+int placement_pin_thread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return -1;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+int placement_available_cpus(void) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) return CPU_COUNT(&set);
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? (int)online : 1;
+}
+
+int placement_cpu_node(int cpu) {
+    if (cpu < 0 || cpu >= PLACEMENT_MAX_CPU) return -1;
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dir = opendir(path);
+    if (!dir) return -1;
+
+    /* The CPU's directory links to its node as "node<N>" */
+    int node = -1;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char* name = entry->d_name;
+        if (strncmp(name, "node", 4) != 0 || !isdigit((unsigned char)name[4])) continue;
+        char* end;
+        long n = strtol(name + 4, &end, 10);
+        if (*end == '\0' && n < PLACEMENT_MAX_CPU) {
+            node = (int)n;
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+int placement_bind_node(void* addr, size_t len, int node) {
+    if (!addr || node < 0 || node >= PLACEMENT_MAX_CPU) return -1;
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) return -1;
+
+    uintptr_t start = ((uintptr_t)addr + (uintptr_t)page - 1) & ~((uintptr_t)page - 1);
+    uintptr_t end = ((uintptr_t)addr + len) & ~((uintptr_t)page - 1);
+    if (end <= start) return 0;   /* no whole page inside: nothing to move */
+
+    unsigned long mask[NODE_MASK_WORDS];
+    memset(mask, 0, sizeof(mask));
+    mask[(size_t)node / (8 * sizeof(unsigned long))] = 1UL << ((size_t)node % (8 * sizeof(unsigned long)));
+    long rc = syscall(SYS_mbind, (void*)start, (unsigned long)(end - start), MPOL_PREFERRED, mask,
+                      (unsigned long)PLACEMENT_MAX_CPU + 1, MPOL_MF_MOVE);
+    return rc == 0 ? 0 : -1;
+}
+
+#else /* !__linux__ */
+
+#include <unistd.h>
+
+int placement_pin_thread(int cpu) {
+    (void)cpu;
+    return -1;
+}
+
+int placement_available_cpus(void) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? (int)online : 1;
+}
+
+int placement_cpu_node(int cpu) {
+    (void)cpu;
+    return -1;
+}
+
+int placement_bind_node(void* addr, size_t len, int node) {
+    (void)addr;
+    (void)len;
+    (void)node;
+    return -1;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,44 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+/*
+ * Thread and memory placement for load-generator threads.
+ *
+ * An engine configured with a CPU list pins each of its threads (pool
+ * workers, load-test users, event loops) to one of those CPUs as the thread
+ * starts, before it touches any per-thread memory. Memory the thread maps
+ * or first writes from then on (its scratch arena, parameter buffers, label
+ * histograms) is placed on that CPU's NUMA node by the kernel's first-touch
+ * policy. Memory allocated up front by the creating thread (metrics shards,
+ * event-loop transfer tables) is moved to its node explicitly with
+ * placement_bind_node().
+ *
+ * Linux only, and without libnuma: the node of a CPU comes from sysfs and
+ * memory policy from mbind(2). Elsewhere the calls fail harmlessly and
+ * threads run unpinned.
+ */
+
+#include <stddef.h>
+
+#define PLACEMENT_MAX_CPU 4096   // CPU numbers and NUMA nodes are below this
+
+// Parse a CPU list such as "0-3,8,10-11" into cpus[] (at most max entries,
+// in the order given). Returns the count, or -1 on a malformed list, a CPU
+// at or above PLACEMENT_MAX_CPU or more than max entries.
+int placement_parse_cpus(const char* list, int* cpus, int max);
+
+// Pin the calling thread to cpu; 0, or -1 if it cannot be (or on other platforms)
+int placement_pin_thread(int cpu);
+
+// CPUs the process may run on (its affinity mask), or the online CPU count
+// where that mask is unavailable; at least 1
+int placement_available_cpus(void);
+
+// NUMA node of cpu, or -1 when unknown (no NUMA, no sysfs, non-Linux)
+int placement_cpu_node(int cpu);
+
+// Prefer node for the whole pages inside [addr, addr + len), moving pages
+// already allocated elsewhere. 0, or -1 if the kernel refused.
+int placement_bind_node(void* addr, size_t len, int node);
+
+#endif /* PLACEMENT_H */
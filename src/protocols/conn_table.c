@@ -0,0 +1,352 @@
+#include "conn_table.h"
+#include "../lock_stats.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONN_ALIGN(n) (((n) + _Alignof(max_align_t) - 1) & ~(size_t)(_Alignof(max_align_t) - 1))
+#define CONN_HEADER_SIZE CONN_ALIGN(sizeof(conn_slot_t))
+#define CONN_TABLE_MIN_BUCKETS 128
+
+static uint64_t conn_key_hash(const char* host, int port, const char* client_id) {
+    uint64_t hash = 1469598103934665603ULL;  /* FNV-1a */
+    for (const char* p = host; *p; p++) {
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    hash = (hash ^ (uint64_t)(uint32_t)port) * 1099511628211ULL;
+    for (const char* p = client_id; *p; p++) {
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Keys are stored truncated, so compare against the truncated form */
+static bool conn_key_matches(const conn_slot_t* slot, const char* host, int port, const char* client_id) {
+    return slot->in_use && slot->port == port &&
+           strncmp(slot->host, host, CONN_TABLE_HOST_MAX - 1) == 0 &&
+           strncmp(slot->client_id, client_id, CONN_TABLE_CLIENT_ID_MAX - 1) == 0;
+}
+
+static size_t conn_stride(const conn_table_t* table) {
+    return CONN_HEADER_SIZE + CONN_ALIGN(table->entry_size);
+}
+
+/* Chunk k holds slots FIRST * (2^k - 1) .. FIRST * (2^(k+1) - 1) - 1 */
+static void conn_locate(int slot, int* chunk, int* index) {
+    unsigned int q = (unsigned int)slot / CONN_TABLE_FIRST_CHUNK + 1;
+    int k = 31 - __builtin_clz(q);
+    *chunk = k;
+    *index = slot - CONN_TABLE_FIRST_CHUNK * ((1 << k) - 1);
+}
+
+static conn_slot_t* conn_slot(conn_table_t* table, int slot) {
+    int chunk, index;
+    conn_locate(slot, &chunk, &index);
+    return (conn_slot_t*)((char*)table->chunks[chunk] + (size_t)index * conn_stride(table));
+}
+
+void* conn_table_entry(conn_table_t* table, int slot) {
+    return (char*)conn_slot(table, slot) + CONN_HEADER_SIZE;
+}
+
+/* Caller holds table->mutex. Returns the slot, or -1 with *bucket_out set to
+   the empty bucket where the key would go. */
+static int conn_table_probe(conn_table_t* table, uint64_t hash, const char* host, int port,
+                            const char* client_id, int* bucket_out) {
+    if (!table->buckets) {
+        if (bucket_out) *bucket_out = -1;
+        return -1;
+    }
+    int bucket = (int)(hash & (uint64_t)table->bucket_mask);
+    while (table->buckets[bucket] != 0) {
+        int slot = table->buckets[bucket] - 1;
+        conn_slot_t* entry = conn_slot(table, slot);
+        if (entry->hash == hash && conn_key_matches(entry, host, port, client_id)) {
+            return slot;
+        }
+        bucket = (bucket + 1) & table->bucket_mask;
+    }
+    if (bucket_out) *bucket_out = bucket;
+    return -1;
+}
+
+/* Caller holds table->mutex: keep the buckets at least twice the slots in use */
+static int conn_table_grow_buckets(conn_table_t* table, int needed) {
+    int current = table->buckets ? table->bucket_mask + 1 : 0;
+    if (current >= 2 * needed) return 0;
+
+    int size = current ? current : CONN_TABLE_MIN_BUCKETS;
+    while (size < 2 * needed) size *= 2;
+    int* buckets = calloc((size_t)size, sizeof(int));
+    if (!buckets) return -1;
+
+    int mask = size - 1;
+    for (int i = 0; i < current; i++) {
+        if (table->buckets[i] == 0) continue;
+        int bucket = (int)(conn_slot(table, table->buckets[i] - 1)->hash & (uint64_t)mask);
+        while (buckets[bucket] != 0) bucket = (bucket + 1) & mask;
+        buckets[bucket] = table->buckets[i];
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_mask = mask;
+    return 0;
+}
+
+/* Caller holds table->mutex: take the slot out of its bucket, shifting later
+   entries of the same probe run back so lookups never stop early */
+static void conn_table_unlink(conn_table_t* table, int slot) {
+    int mask = table->bucket_mask;
+    int bucket = (int)(conn_slot(table, slot)->hash & (uint64_t)mask);
+    while (table->buckets[bucket] != slot + 1) {
+        if (table->buckets[bucket] == 0) return;
+        bucket = (bucket + 1) & mask;
+    }
+
+    int hole = bucket;
+    for (int next = (hole + 1) & mask; table->buckets[next] != 0; next = (next + 1) & mask) {
+        int home = (int)(conn_slot(table, table->buckets[next] - 1)->hash & (uint64_t)mask);
+        /* Move it into the hole unless its home lies cyclically in (hole, next] */
+        bool stays = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (!stays) {
+            table->buckets[hole] = table->buckets[next];
+            hole = next;
+        }
+    }
+    table->buckets[hole] = 0;
+}
+
+/* Caller holds table->mutex: a free slot number, allocating its chunk on first
+   use; -1 when out of memory or past CONN_TABLE_MAX_SLOTS */
+static int conn_table_new_slot(conn_table_t* table) {
+    if (table->free_head >= 0) {
+        int slot = table->free_head;
+        table->free_head = conn_slot(table, slot)->next_free;
+        return slot;
+    }
+    if (table->allocated >= CONN_TABLE_MAX_SLOTS) return -1;
+
+    int slot = table->allocated;
+    int chunk, index;
+    conn_locate(slot, &chunk, &index);
+    if (index == 0) {
+        size_t slots = (size_t)CONN_TABLE_FIRST_CHUNK << chunk;
+        char* memory = calloc(slots, conn_stride(table));
+        if (!memory) return -1;
+        for (size_t i = 0; i < slots; i++) {
+            conn_slot_t* entry = (conn_slot_t*)(memory + i * conn_stride(table));
+            pthread_mutex_init(&entry->lock, NULL);
+            entry->fd = -1;
+            entry->next_free = -1;
+        }
+        table->chunks[chunk] = memory;
+    }
+    table->allocated++;
+    return slot;
+}
+
+int conn_table_acquire(conn_table_t* table, const char* host, int port, const char* client_id,
+                       bool create, bool* created) {
+    if (!client_id) client_id = "";
+    if (created) *created = false;
+    uint64_t hash = conn_key_hash(host, port, client_id);
+
+    for (;;) {
+        lock_stats_lock(&table->mutex, LOCK_SITE_CONN_TABLE);
+        int bucket = 0;
+        int slot = conn_table_probe(table, hash, host, port, client_id, &bucket);
+
+        if (slot >= 0) {
+            /* Never wait for a busy connection while holding the table */
+            pthread_mutex_unlock(&table->mutex);
+            conn_slot_t* entry = conn_slot(table, slot);
+            lock_stats_lock(&entry->lock, LOCK_SITE_CONN_TABLE);
+            /* A retire or reset may have recycled the slot while we waited */
+            if (conn_key_matches(entry, host, port, client_id)) return slot;
+            pthread_mutex_unlock(&entry->lock);
+            continue;
+        }
+
+        if (!create) {
+            pthread_mutex_unlock(&table->mutex);
+            return -1;
+        }
+        if (table->count >= table->limit) {
+            if (!table->warned) {
+                fprintf(stderr, "[LoadSpiker] %s pool full (%d connections) — raise its pool size\n",
+                        table->name, table->limit);
+                table->warned = true;
+            }
+            pthread_mutex_unlock(&table->mutex);
+            return -2;
+        }
+        if (conn_table_grow_buckets(table, table->count + 1) != 0) {
+            pthread_mutex_unlock(&table->mutex);
+            return -2;
+        }
+        conn_table_probe(table, hash, host, port, client_id, &bucket);
+        slot = conn_table_new_slot(table);
+        if (slot < 0) {
+            pthread_mutex_unlock(&table->mutex);
+            return -2;
+        }
+
+        /* A fresh slot is locked before it becomes findable, so the caller
+           initialises it before any other thread can use it */
+        conn_slot_t* entry = conn_slot(table, slot);
+        pthread_mutex_lock(&entry->lock);
+        snprintf(entry->host, sizeof(entry->host), "%s", host);
+        snprintf(entry->client_id, sizeof(entry->client_id), "%s", client_id);
+        entry->port = port;
+        entry->hash = hash;
+        entry->in_use = true;
+        entry->next_free = -1;
+        table->buckets[bucket] = slot + 1;
+        table->count++;
+        pthread_mutex_unlock(&table->mutex);
+
+        if (created) *created = true;
+        return slot;
+    }
+}
+
+void conn_table_release(conn_table_t* table, int slot) {
+    pthread_mutex_unlock(&conn_slot(table, slot)->lock);
+}
+
+/* Caller holds table->mutex and the slot lock */
+static void conn_table_forget(conn_table_t* table, int slot) {
+    conn_slot_t* entry = conn_slot(table, slot);
+    conn_table_set_fd(table, slot, -1);
+    /* Threads still holding this slot number see the key change and retry */
+    entry->in_use = false;
+    entry->host[0] = '\0';
+    entry->client_id[0] = '\0';
+    entry->port = -1;
+}
+
+void conn_table_retire(conn_table_t* table, int slot, bool (*is_idle)(int slot)) {
+    conn_slot_t* entry = conn_slot(table, slot);
+    char host[CONN_TABLE_HOST_MAX];
+    char client_id[CONN_TABLE_CLIENT_ID_MAX];
+    int port = entry->port;
+    memcpy(host, entry->host, sizeof(host));
+    memcpy(client_id, entry->client_id, sizeof(client_id));
+    pthread_mutex_unlock(&entry->lock);
+
+    /* Relock in table -> slot order; someone may have reconnected meanwhile */
+    pthread_mutex_lock(&table->mutex);
+    pthread_mutex_lock(&entry->lock);
+    if (conn_key_matches(entry, host, port, client_id) && (!is_idle || is_idle(slot))) {
+        conn_table_unlink(table, slot);
+        conn_table_forget(table, slot);
+        entry->next_free = table->free_head;
+        table->free_head = slot;
+        table->count--;
+    }
+    pthread_mutex_unlock(&entry->lock);
+    pthread_mutex_unlock(&table->mutex);
+}
+
+int conn_table_find(conn_table_t* table, const char* host, int port, const char* client_id) {
+    if (!client_id) client_id = "";
+    uint64_t hash = conn_key_hash(host, port, client_id);
+
+    pthread_mutex_lock(&table->mutex);
+    int slot = conn_table_probe(table, hash, host, port, client_id, NULL);
+    pthread_mutex_unlock(&table->mutex);
+    return slot;
+}
+
+int conn_table_set_fd(conn_table_t* table, int slot, int fd) {
+    conn_slot_t* entry = conn_slot(table, slot);
+    int rc = 0;
+
+    pthread_mutex_lock(&table->fd_mutex);
+    if (entry->fd >= 0 && entry->fd < table->fd_capacity && table->fd_slots[entry->fd] == slot + 1) {
+        table->fd_slots[entry->fd] = 0;
+    }
+    entry->fd = -1;
+    if (fd >= 0 && fd >= table->fd_capacity) {
+        int capacity = table->fd_capacity ? table->fd_capacity : 1024;
+        while (capacity <= fd) capacity *= 2;
+        int* fd_slots = realloc(table->fd_slots, sizeof(int) * (size_t)capacity);
+        if (fd_slots) {
+            memset(fd_slots + table->fd_capacity, 0, sizeof(int) * (size_t)(capacity - table->fd_capacity));
+            table->fd_slots = fd_slots;
+            table->fd_capacity = capacity;
+        }
+    }
+    if (fd >= 0 && fd < table->fd_capacity) {
+        table->fd_slots[fd] = slot + 1;
+        entry->fd = fd;
+    } else if (fd >= 0) {
+        errno = ENOMEM;
+        rc = -1;
+    }
+    pthread_mutex_unlock(&table->fd_mutex);
+    return rc;
+}
+
+int conn_table_find_fd(conn_table_t* table, int fd, char* host_out, int* port_out) {
+    if (fd < 0) return -1;
+
+    int found = -1;
+    pthread_mutex_lock(&table->fd_mutex);
+    if (fd < table->fd_capacity && table->fd_slots[fd] != 0) {
+        /* Keys only change after their fd is unpublished, under this mutex */
+        conn_slot_t* entry = conn_slot(table, table->fd_slots[fd] - 1);
+        snprintf(host_out, CONN_TABLE_HOST_MAX, "%s", entry->host);
+        *port_out = entry->port;
+        found = 0;
+    }
+    pthread_mutex_unlock(&table->fd_mutex);
+    return found;
+}
+
+int conn_table_set_limit(conn_table_t* table, int limit) {
+    if (limit <= 0 || limit > CONN_TABLE_MAX_SLOTS) return -1;
+
+    pthread_mutex_lock(&table->mutex);
+    table->limit = limit;
+    table->warned = false;
+    pthread_mutex_unlock(&table->mutex);
+    return 0;
+}
+
+int conn_table_get_limit(conn_table_t* table) {
+    pthread_mutex_lock(&table->mutex);
+    int limit = table->limit;
+    pthread_mutex_unlock(&table->mutex);
+    return limit;
+}
+
+int conn_table_get_count(conn_table_t* table) {
+    pthread_mutex_lock(&table->mutex);
+    int count = table->count;
+    pthread_mutex_unlock(&table->mutex);
+    return count;
+}
+
+void conn_table_reset(conn_table_t* table, void (*close_slot)(int slot)) {
+    pthread_mutex_lock(&table->mutex);
+    table->free_head = -1;
+    /* Rebuild the free list so the lowest slots are reused first */
+    for (int i = table->allocated - 1; i >= 0; i--) {
+        conn_slot_t* entry = conn_slot(table, i);
+        pthread_mutex_lock(&entry->lock);
+        if (entry->in_use) {
+            if (close_slot) close_slot(i);
+            conn_table_forget(table, i);
+        }
+        entry->next_free = table->free_head;
+        table->free_head = i;
+        pthread_mutex_unlock(&entry->lock);
+    }
+    if (table->buckets) {
+        memset(table->buckets, 0, sizeof(int) * (size_t)(table->bucket_mask + 1));
+    }
+    table->count = 0;
+    pthread_mutex_unlock(&table->mutex);
+}
@@ -0,0 +1,103 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+/*
+ * Hashed connection pool shared by the TCP, UDP and MQTT protocols.
+ *
+ * Maps (host, port, client_id) to a slot number and stores each slot's
+ * protocol struct (entry_size bytes, see conn_table_entry()) next to it. The
+ * table mutex covers probing, slot allocation and freeing only and is never
+ * held across I/O. Every slot has its own lock, held for the whole operation
+ * on that connection, so a blocking connect or receive only ever waits for
+ * work on the same connection.
+ *
+ * Slots live in chunks that double in size and are allocated on first use,
+ * so an idle pool costs a few hundred bytes whatever its limit. Chunks never
+ * move or shrink: a slot number, and its entry pointer, stays valid for the
+ * life of the process. A closed connection keeps its slot for reconnects
+ * until the protocol hands it back with conn_table_retire(); retired slots
+ * go on a free list and are reused before any new memory is touched.
+ *
+ * Lock order is table mutex, then slot lock, then the fd index mutex.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONN_TABLE_HOST_MAX 256
+#define CONN_TABLE_CLIENT_ID_MAX 128
+#define CONN_TABLE_FIRST_CHUNK 64      /* slots in chunk 0; chunk k holds 64 << k */
+#define CONN_TABLE_MAX_CHUNKS 20       /* up to 64 * (2^20 - 1) slots */
+#define CONN_TABLE_MAX_SLOTS (CONN_TABLE_FIRST_CHUNK * ((1 << CONN_TABLE_MAX_CHUNKS) - 1))
+
+typedef struct {
+    char host[CONN_TABLE_HOST_MAX];
+    int port;
+    char client_id[CONN_TABLE_CLIENT_ID_MAX];   /* "" for TCP/UDP */
+    uint64_t hash;
+    pthread_mutex_t lock;
+    bool in_use;                                /* keyed; written under both locks */
+    int fd;                                     /* published socket, or -1; guarded by fd_mutex */
+    int next_free;                              /* free list link, guarded by the table mutex */
+} conn_slot_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    const char* name;          /* pool name for the "pool full" warning */
+    size_t entry_size;         /* protocol struct stored with every slot */
+    int limit;                 /* most slots in use at once */
+    int count;                 /* slots in use */
+    int allocated;             /* slots ever handed out: 0..allocated-1 are initialised */
+    int free_head;             /* first retired slot, or -1 */
+    int bucket_mask;           /* 0 until the first insert */
+    int* buckets;              /* slot + 1, 0 = empty; at least twice count */
+    void* chunks[CONN_TABLE_MAX_CHUNKS];
+    bool warned;
+
+    pthread_mutex_t fd_mutex;  /* leaf lock for the fd -> slot index */
+    int* fd_slots;             /* fd_slots[fd] = slot + 1, 0 = none */
+    int fd_capacity;
+} conn_table_t;
+
+/* Static pool storing `entry_type` per connection, at most `max_slots` at once */
+#define CONN_TABLE_INIT(pool_name, entry_type, max_slots) {                       \
+    .mutex = PTHREAD_MUTEX_INITIALIZER, .name = (pool_name),                      \
+    .entry_size = sizeof(entry_type), .limit = (max_slots), .free_head = -1,      \
+    .fd_mutex = PTHREAD_MUTEX_INITIALIZER }
+
+// Look up (host, port, client_id) and lock its slot. With `create`, an
+// unknown key gets a fresh slot and *created is set so the caller can
+// initialise its entry before anyone else sees it.
+// Returns the locked slot, -1 if not found, or -2 if the pool is full.
+int conn_table_acquire(conn_table_t* table, const char* host, int port, const char* client_id,
+                       bool create, bool* created);
+void conn_table_release(conn_table_t* table, int slot);
+// Release a locked slot and, if is_idle(slot) still holds once the table is
+// locked, forget its key and put it on the free list
+void conn_table_retire(conn_table_t* table, int slot, bool (*is_idle)(int slot));
+
+// Slot of the key without locking it, or -1
+int conn_table_find(conn_table_t* table, const char* host, int port, const char* client_id);
+// The protocol struct of a slot
+void* conn_table_entry(conn_table_t* table, int slot);
+
+// Publish the slot's socket for conn_table_find_fd(); caller holds the slot.
+// Returns -1 (errno ENOMEM) if the fd index cannot grow to take fd, which is
+// then left unpublished; unpublishing (fd -1) always succeeds.
+int conn_table_set_fd(conn_table_t* table, int slot, int fd);
+// Host and port of the slot that currently owns fd; 0 on success, -1 if none
+int conn_table_find_fd(conn_table_t* table, int fd, char* host_out, int* port_out);
+
+// Change how many slots may be in use at once (1..CONN_TABLE_MAX_SLOTS).
+// Lowering it below the current count only stops new connections.
+int conn_table_set_limit(conn_table_t* table, int limit);
+int conn_table_get_limit(conn_table_t* table);
+int conn_table_get_count(conn_table_t* table);
+
+// Call close_slot() on every slot in use with its lock held, then free them
+// all; the memory is kept for reuse
+void conn_table_reset(conn_table_t* table, void (*close_slot)(int slot));
+
+#endif /* CONN_TABLE_H */
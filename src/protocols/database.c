@@ -1,30 +1,40 @@
 #include "database.h"
+#include "db_driver.h"
 #include "../common.h"
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
-#include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 
-/* Per-thread RNG seed — initialized lazily on first use */
-static __thread unsigned int thread_rng_seed = 0;
-
-/* Inline helper to lazily initialize seed from pthread_self() */
-static inline unsigned int get_thread_seed(void) {
-    if (thread_rng_seed == 0) {
-        thread_rng_seed = (unsigned int)(uintptr_t)pthread_self();
-        if (thread_rng_seed == 0) thread_rng_seed = 1; /* avoid all-zero seed */
-    }
-    return thread_rng_seed;
-}
-
-// Connection pool for database connections
-#define MAX_DB_CONNECTIONS 100
-static db_connection_t db_connections[MAX_DB_CONNECTIONS];
-static int db_connection_count = 0;
-static pthread_mutex_t db_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int db_pool_warned = 0;
+/*
+ * Per-thread connection pools.
+ *
+ * A thread's pool is created on its first database call and registered in
+ * pool_list so database_cleanup_all() can reach it; a thread-specific key
+ * destructor closes it when the thread exits. Each pool has its own mutex,
+ * taken only by its thread and by cleanup, so it is never contended while
+ * queries run.
+ */
+
+#define DB_POOL_BUCKETS 64
+
+typedef struct db_thread_pool {
+    pthread_mutex_t mutex;
+    db_connection_t* buckets[DB_POOL_BUCKETS];
+    int count;
+    struct db_thread_pool* next;
+} db_thread_pool_t;
+
+static __thread db_thread_pool_t* thread_pool = NULL;
+static db_thread_pool_t* pool_list = NULL;
+static pthread_mutex_t pool_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t pool_key;
+static pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
+static _Atomic int db_pool_limit = MAX_DB_CONNECTIONS_DEFAULT;
+static _Atomic int db_pool_warned = 0;
 
 
 db_type_t database_parse_type(const char* db_type_str) {
@@ -48,6 +58,23 @@ const char* database_type_to_string(db_type_t type) {
     }
 }
 
+db_type_t database_type_from_url(const char* connection_string) {
+    if (!connection_string) return DB_TYPE_UNKNOWN;
+    if (strncmp(connection_string, "mysql://", 8) == 0) return DB_TYPE_MYSQL;
+    if (strncmp(connection_string, "postgresql://", 13) == 0) return DB_TYPE_POSTGRESQL;
+    if (strncmp(connection_string, "postgres://", 11) == 0) return DB_TYPE_POSTGRESQL;
+    if (strncmp(connection_string, "mongodb://", 10) == 0) return DB_TYPE_MONGODB;
+    if (strncmp(connection_string, "mongodb+srv://", 14) == 0) return DB_TYPE_MONGODB;
+    return DB_TYPE_UNKNOWN;
+}
+
+/* Copy at most 255 bytes: every output of the parser below holds 256 */
+static void copy_part(char* out, const char* start, size_t len) {
+    if (len > 255) len = 255;
+    memcpy(out, start, len);
+    out[len] = '\0';
+}
+
 int database_parse_connection_string(const char* connection_string, char* host, int* port, char* database, char* username, char* password) {
     if (!connection_string || !host || !port || !database || !username || !password) {
         return -1;
@@ -77,18 +104,12 @@ int database_parse_connection_string(const char* connection_string, char* host,
     if (at_sign) {
         const char* colon = strchr(url_part, ':');
         if (colon && colon < at_sign) {
-            // Extract username
-            size_t username_len = colon - url_part;
-            strncpy(username, url_part, username_len);
-            username[username_len] = '\0';
-
-            // Extract password
-            size_t password_len = at_sign - colon - 1;
-            strncpy(password, colon + 1, password_len);
-            password[password_len] = '\0';
-
-            url_part = at_sign + 1;
+            copy_part(username, url_part, (size_t)(colon - url_part));
+            copy_part(password, colon + 1, (size_t)(at_sign - colon - 1));
+        } else {
+            copy_part(username, url_part, (size_t)(at_sign - url_part));
         }
+        url_part = at_sign + 1;
     }
 
     // Extract host and port
@@ -97,59 +118,207 @@ int database_parse_connection_string(const char* connection_string, char* host,
 
     if (colon && (!slash || colon < slash)) {
         // Host with port
-        size_t host_len = colon - url_part;
-        strncpy(host, url_part, host_len);
-        host[host_len] = '\0';
+        copy_part(host, url_part, (size_t)(colon - url_part));
 
         // Extract port
         *port = atoi(colon + 1);
     } else {
         // Host without port
-        size_t host_len = slash ? (slash - url_part) : strlen(url_part);
-        strncpy(host, url_part, host_len);
-        host[host_len] = '\0';
+        copy_part(host, url_part, slash ? (size_t)(slash - url_part) : strlen(url_part));
 
         // Set default ports
         if (strstr(connection_string, "mysql://")) {
-            *port = 3306;
-        } else if (strstr(connection_string, "postgresql://")) {
-            *port = 5432;
+            *port = MYSQL_DEFAULT_PORT;
+        } else if (strstr(connection_string, "postgresql://") || strstr(connection_string, "postgres://")) {
+            *port = POSTGRESQL_DEFAULT_PORT;
         } else if (strstr(connection_string, "mongodb://")) {
-            *port = 27017;
+            *port = MONGODB_DEFAULT_PORT;
         }
     }
 
-    // Extract database name
+    // Extract database name, without any ?options
     if (slash) {
-        strcpy(database, slash + 1);
+        const char* query = strchr(slash + 1, '?');
+        copy_part(database, slash + 1, query ? (size_t)(query - slash - 1) : strlen(slash + 1));
     }
 
     return 0;
 }
 
-static db_connection_t* find_connection(const char* connection_string) {
-    for (int i = 0; i < db_connection_count; i++) {
-        if (strcmp(db_connections[i].connection_string, connection_string) == 0) {
-            return &db_connections[i];
-        }
+static const db_driver_t* driver_for(db_type_t type) {
+    switch (type) {
+        case DB_TYPE_POSTGRESQL: return db_postgres_driver();
+        case DB_TYPE_MYSQL: return db_mysql_driver();
+        default: return NULL;
     }
-    return NULL;
 }
 
-static db_connection_t* create_connection(const char* connection_string, db_type_t type) {
-    if (db_connection_count >= MAX_DB_CONNECTIONS) {
-        return NULL;
+bool database_driver_available(db_type_t type) {
+    return driver_for(type) != NULL;
+}
+
+int database_set_pool_size(int max_connections) {
+    if (max_connections <= 0) return -1;
+    atomic_store(&db_pool_limit, max_connections);
+    return 0;
+}
+
+int database_get_pool_size(void) {
+    return atomic_load(&db_pool_limit);
+}
+
+bool db_result_append(char* out, size_t cap, size_t* len, const char* text, size_t text_len, bool last_in_row) {
+    bool quote = memchr(text, ',', text_len) || memchr(text, '"', text_len) || memchr(text, '\n', text_len);
+    /* worst case every byte is a doubled quote, plus quotes and separator */
+    size_t need = (quote ? 2 * text_len + 2 : text_len) + 1;
+    if (*len + need >= cap) return false;
+
+    char* p = out + *len;
+    if (quote) *p++ = '"';
+    for (size_t i = 0; i < text_len; i++) {
+        if (quote && text[i] == '"') *p++ = '"';
+        *p++ = text[i];
     }
+    if (quote) *p++ = '"';
+    *p++ = last_in_row ? '\n' : ',';
+    *p = '\0';
+    *len = (size_t)(p - out);
+    return true;
+}
 
-    db_connection_t* conn = &db_connections[db_connection_count++];
-    memset(conn, 0, sizeof(db_connection_t));
+/* ---- Pools ---------------------------------------------------------------- */
 
-    strncpy(conn->connection_string, connection_string, sizeof(conn->connection_string) - 1);
-    conn->type = type;
-    conn->is_connected = false;
+static uint64_t hash_string(const char* s) {
+    uint64_t h = 1469598103934665603ULL;   /* FNV-1a */
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+/* Server-side statements die with the session, so closing frees only the
+   client's side and sends nothing but the driver's own goodbye */
+static void connection_close(db_connection_t* conn) {
+    const db_driver_t* driver = driver_for(conn->type);
+    for (int i = 0; i < DB_STATEMENT_CACHE; i++) {
+        db_statement_t* stmt = &conn->statements[i];
+        if (stmt->hash == 0) continue;
+        free(stmt->query);
+        stmt->query = NULL;
+        stmt->hash = 0;
+    }
+    if (driver && conn->connection_handle) driver->close(conn);
     conn->connection_handle = NULL;
+    conn->is_connected = false;
+}
+
+/* Close and free every connection of pool; caller holds pool->mutex */
+static void pool_drain(db_thread_pool_t* pool) {
+    for (int b = 0; b < DB_POOL_BUCKETS; b++) {
+        db_connection_t* conn = pool->buckets[b];
+        while (conn) {
+            db_connection_t* next = conn->next;
+            connection_close(conn);
+            free(conn);
+            conn = next;
+        }
+        pool->buckets[b] = NULL;
+    }
+    pool->count = 0;
+}
+
+/* Thread exit: close the thread's connections and forget its pool */
+static void pool_destroy(void* arg) {
+    db_thread_pool_t* pool = (db_thread_pool_t*)arg;
+    pthread_mutex_lock(&pool_list_mutex);
+    for (db_thread_pool_t** p = &pool_list; *p; p = &(*p)->next) {
+        if (*p == pool) {
+            *p = pool->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_list_mutex);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool_drain(pool);
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+    thread_pool = NULL;
+}
+
+static void pool_key_create(void) {
+    pthread_key_create(&pool_key, pool_destroy);
+}
+
+/* The calling thread's pool, locked; NULL if it cannot be created */
+static db_thread_pool_t* pool_lock(bool create) {
+    if (!thread_pool) {
+        if (!create) return NULL;
+        pthread_once(&pool_key_once, pool_key_create);
+        db_thread_pool_t* pool = calloc(1, sizeof(db_thread_pool_t));
+        if (!pool) return NULL;
+        pthread_mutex_init(&pool->mutex, NULL);
+        pthread_mutex_lock(&pool_list_mutex);
+        pool->next = pool_list;
+        pool_list = pool;
+        pthread_mutex_unlock(&pool_list_mutex);
+        pthread_setspecific(pool_key, pool);
+        thread_pool = pool;
+    }
+    pthread_mutex_lock(&thread_pool->mutex);
+    return thread_pool;
+}
+
+static db_connection_t** pool_find(db_thread_pool_t* pool, const char* connection_string) {
+    db_connection_t** p = &pool->buckets[hash_string(connection_string) % DB_POOL_BUCKETS];
+    while (*p && strcmp((*p)->connection_string, connection_string) != 0) p = &(*p)->next;
+    return p;
+}
+
+/* ---- Statement cache ---------------------------------------------------- */
+
+/* The cached statement for query, or a fresh slot for it (*prepare = true),
+   evicting the least recently used one when the cache is full */
+static db_statement_t* statement_lookup(db_connection_t* conn, const db_driver_t* driver,
+                                        const char* query, bool* prepare) {
+    uint64_t hash = hash_string(query);
+    db_statement_t* slot = NULL;
+    for (int i = 0; i < DB_STATEMENT_CACHE; i++) {
+        db_statement_t* stmt = &conn->statements[i];
+        if (stmt->hash == hash && strcmp(stmt->query, query) == 0) {
+            stmt->last_used = ++conn->statement_clock;
+            *prepare = false;
+            return stmt;
+        }
+        if (!slot || (slot->hash != 0 && (stmt->hash == 0 || stmt->last_used < slot->last_used))) slot = stmt;
+    }
+
+    char* copy = strdup(query);
+    if (!copy) return NULL;
+    if (slot->hash != 0) {
+        driver->release_statement(conn, slot);
+        free(slot->query);
+    }
+    memset(slot, 0, sizeof(db_statement_t));
+    slot->hash = hash;
+    slot->query = copy;
+    slot->last_used = ++conn->statement_clock;
+    snprintf(slot->name, sizeof(slot->name), "ls_%llu", (unsigned long long)conn->statements_prepared);
+    *prepare = true;
+    return slot;
+}
+
+static void statement_forget(db_statement_t* stmt) {
+    free(stmt->query);
+    memset(stmt, 0, sizeof(db_statement_t));
+}
+
+/* ---- Blocking API ------------------------------------------------------- */
 
-    return conn;
+static const char* driver_library(db_type_t type) {
+    return type == DB_TYPE_POSTGRESQL ? "libpq" : "libmysqlclient";
 }
 
 int database_connect(const char* connection_string, const char* db_type_str, response_t* response) {
@@ -157,85 +326,88 @@ int database_connect(const char* connection_string, const char* db_type_str, res
         return -1;
     }
 
-    // Initialize response
-    memset(response, 0, sizeof(response_t));
-    response->protocol = PROTOCOL_DATABASE;
+    INIT_RESPONSE(response, PROTOCOL_DATABASE);
     uint64_t start_time = get_time_us();
+    char message[256];
 
     db_type_t db_type = database_parse_type(db_type_str);
     if (db_type == DB_TYPE_UNKNOWN) {
-        response->success = false;
-        response->status_code = 400;
-        snprintf(response->error_message, sizeof(response->error_message),
-                "Unsupported database type: %s", db_type_str);
-        response->response_time_us = get_time_us() - start_time;
+        snprintf(message, sizeof(message), "Unsupported database type: %.200s", db_type_str);
+        SET_ERROR_RESPONSE(response, 400, start_time, message);
+        return -1;
+    }
+    const db_driver_t* driver = driver_for(db_type);
+    if (!driver) {
+        if (db_type == DB_TYPE_MONGODB) {
+            snprintf(message, sizeof(message), "Unsupported database type: MongoDB has no driver");
+        } else {
+            snprintf(message, sizeof(message), "%s support was not compiled in (build with %s)",
+                     database_type_to_string(db_type), driver_library(db_type));
+        }
+        SET_ERROR_RESPONSE(response, 501, start_time, message);
         return -1;
     }
 
-    pthread_mutex_lock(&db_pool_mutex);
+    db_params_t params;
+    if (strlen(connection_string) >= MAX_URL_LENGTH ||
+        database_parse_connection_string(connection_string, params.host, &params.port, params.database,
+                                         params.username, params.password) != 0) {
+        SET_ERROR_RESPONSE(response, 400, start_time, "Invalid connection string format");
+        return -1;
+    }
+
+    db_thread_pool_t* pool = pool_lock(true);
+    if (!pool) {
+        SET_ERROR_RESPONSE(response, 500, start_time, "Out of memory");
+        return -1;
+    }
 
     // Check if connection already exists
-    db_connection_t* conn = find_connection(connection_string);
-    if (conn && conn->is_connected) {
-        response->success = true;
-        response->status_code = 200;
+    db_connection_t** slot = pool_find(pool, connection_string);
+    if (*slot && (*slot)->is_connected) {
         strcpy(response->body, "Connection already established");
-        response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&db_pool_mutex);
+        SET_SUCCESS_RESPONSE(response, 200, start_time);
+        pthread_mutex_unlock(&pool->mutex);
         return 0;
     }
 
-    // Create new connection if needed
-    if (!conn) {
-        if (db_connection_count >= MAX_DB_CONNECTIONS) {
-            if (!db_pool_warned) {
-                fprintf(stderr, "[LoadSpiker] DB pool full — increase MAX_DB_CONNECTIONS\n");
-                db_pool_warned = 1;
-            }
-            response->success = false;
-            response->status_code = 500;
-            strcpy(response->error_message, "Too many database connections");
-            response->response_time_us = get_time_us() - start_time;
-            pthread_mutex_unlock(&db_pool_mutex);
-            return -1;
+    if (pool->count >= atomic_load(&db_pool_limit)) {
+        if (!atomic_exchange(&db_pool_warned, 1)) {
+            fprintf(stderr, "[LoadSpiker] DB pool full (%d connections per thread) — raise database_pool_size\n",
+                    atomic_load(&db_pool_limit));
         }
-        conn = create_connection(connection_string, db_type);
+        SET_ERROR_RESPONSE(response, 500, start_time, "Too many database connections");
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
     }
 
-    // Parse connection parameters
-    char host[256], database[256], username[256], password[256];
-    int port;
-
-    if (database_parse_connection_string(connection_string, host, &port, database, username, password) != 0) {
-        response->success = false;
-        response->status_code = 400;
-        strcpy(response->error_message, "Invalid connection string format");
-        response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&db_pool_mutex);
+    db_connection_t* conn = calloc(1, sizeof(db_connection_t));
+    if (!conn) {
+        SET_ERROR_RESPONSE(response, 500, start_time, "Out of memory");
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+    strcpy(conn->connection_string, connection_string);
+    conn->type = db_type;
+
+    if (driver->connect(conn, &params, conn->last_error, sizeof(conn->last_error)) != 0) {
+        SET_ERROR_RESPONSE(response, 503, start_time, conn->last_error);
+        connection_close(conn);
+        free(conn);
+        pthread_mutex_unlock(&pool->mutex);
         return -1;
     }
-
-    // Simulate database connection (in a real implementation, this would use actual database drivers)
-    // For now, we'll simulate a successful connection
     conn->is_connected = true;
-    conn->connection_handle = (void*)1; // Placeholder
+    *slot = conn;
+    pool->count++;
 
-    // Populate response
-    response->success = true;
-    response->status_code = 200;
     snprintf(response->body, sizeof(response->body),
             "Connected to %s database at %s:%d/%s",
-            database_type_to_string(db_type), host, port, database);
-
-    // Set database-specific response data
-    database_response_data_t* db_data = (database_response_data_t*)response->protocol_data.protocol_data;
-    db_data->rows_affected = 0;
-    db_data->rows_returned = 0;
-    strcpy(db_data->result_set, "Connection established");
+            database_type_to_string(db_type), params.host, params.port, params.database);
+    strcpy(response->protocol_data.database.result_set, "Connection established");
+    SET_SUCCESS_RESPONSE(response, 200, start_time);
 
-    response->response_time_us = get_time_us() - start_time;
-
-    pthread_mutex_unlock(&db_pool_mutex);
+    pthread_mutex_unlock(&pool->mutex);
     return 0;
 }
 
@@ -244,78 +416,51 @@ int database_execute_query(const char* connection_string, const char* query, res
         return -1;
     }
 
-    // Initialize response
-    memset(response, 0, sizeof(response_t));
-    response->protocol = PROTOCOL_DATABASE;
+    INIT_RESPONSE(response, PROTOCOL_DATABASE);
     uint64_t start_time = get_time_us();
 
-    pthread_mutex_lock(&db_pool_mutex);
-
-    // Find existing connection
-    db_connection_t* conn = find_connection(connection_string);
+    db_thread_pool_t* pool = pool_lock(false);
+    db_connection_t** slot = pool ? pool_find(pool, connection_string) : NULL;
+    db_connection_t* conn = slot ? *slot : NULL;
     if (!conn || !conn->is_connected) {
-        response->success = false;
-        response->status_code = 400;
-        strcpy(response->error_message, "No active database connection");
-        response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&db_pool_mutex);
+        SET_ERROR_RESPONSE(response, 400, start_time, "No active database connection");
+        if (pool) pthread_mutex_unlock(&pool->mutex);
         return -1;
     }
 
-    // Simulate query execution based on query type
-    // In a real implementation, this would use actual database drivers
-
-    bool is_select = (strncasecmp(query, "SELECT", 6) == 0);
-    bool is_insert = (strncasecmp(query, "INSERT", 6) == 0);
-    bool is_update = (strncasecmp(query, "UPDATE", 6) == 0);
-    bool is_delete = (strncasecmp(query, "DELETE", 6) == 0);
-
-    // Simulate query execution time (100-500ms) using per-thread RNG
-    get_thread_seed();
-    usleep((100 + (rand_r(&thread_rng_seed) % 400)) * 1000);
-
-    response->success = true;
-    response->status_code = 200;
-
-    // Set database-specific response data
-    database_response_data_t* db_data = (database_response_data_t*)response->protocol_data.protocol_data;
-
-    if (is_select) {
-        // Simulate SELECT result
-        db_data->rows_returned = 3;
-        db_data->rows_affected = 0;
-        strcpy(db_data->result_set, "id,name,email\n1,John,john@example.com\n2,Jane,jane@example.com\n3,Bob,bob@example.com");
-        snprintf(response->body, sizeof(response->body), "Query executed successfully. %d rows returned.", db_data->rows_returned);
-    } else if (is_insert) {
-        // Simulate INSERT result
-        db_data->rows_affected = 1;
-        db_data->rows_returned = 0;
-        strcpy(db_data->result_set, "");
-        snprintf(response->body, sizeof(response->body), "Query executed successfully. %d row(s) inserted.", db_data->rows_affected);
-    } else if (is_update) {
-        // Simulate UPDATE result
-        db_data->rows_affected = 2;
-        db_data->rows_returned = 0;
-        strcpy(db_data->result_set, "");
-        snprintf(response->body, sizeof(response->body), "Query executed successfully. %d row(s) updated.", db_data->rows_affected);
-    } else if (is_delete) {
-        // Simulate DELETE result
-        db_data->rows_affected = 1;
-        db_data->rows_returned = 0;
-        strcpy(db_data->result_set, "");
-        snprintf(response->body, sizeof(response->body), "Query executed successfully. %d row(s) deleted.", db_data->rows_affected);
-    } else {
-        // Generic query
-        db_data->rows_affected = 0;
-        db_data->rows_returned = 0;
-        strcpy(db_data->result_set, "");
-        strcpy(response->body, "Query executed successfully.");
+    const db_driver_t* driver = driver_for(conn->type);
+    bool prepare = false;
+    db_statement_t* stmt = statement_lookup(conn, driver, query, &prepare);
+    if (!stmt) {
+        SET_ERROR_RESPONSE(response, 500, start_time, "Out of memory");
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
     }
 
-    response->response_time_us = get_time_us() - start_time;
+    int rc = driver->execute(conn, stmt, prepare, response);
+    conn->queries++;
+    if (rc == 0 && prepare) conn->statements_prepared++;
+    if (rc != 0 && prepare) {
+        /* the driver has dropped whatever it prepared: start over next time */
+        statement_forget(stmt);
+    }
 
-    pthread_mutex_unlock(&db_pool_mutex);
-    return 0;
+    if (rc == 0) {
+        SET_SUCCESS_RESPONSE(response, 200, start_time);
+    } else if (rc == -1) {
+        SET_ERROR_RESPONSE(response, 500, start_time, conn->last_error);
+    } else {
+        /* the connection is gone: drop it so the next connect starts fresh */
+        SET_ERROR_RESPONSE(response, 503, start_time, conn->last_error);
+        *slot = conn->next;
+        pool->count--;
+        conn->is_connected = false;
+        connection_close(conn);
+        free(conn);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+    return rc == 0 ? 0 : -1;
 }
 
 int database_disconnect(const char* connection_string, response_t* response) {
@@ -323,43 +468,37 @@ int database_disconnect(const char* connection_string, response_t* response) {
         return -1;
     }
 
-    // Initialize response
-    memset(response, 0, sizeof(response_t));
-    response->protocol = PROTOCOL_DATABASE;
+    INIT_RESPONSE(response, PROTOCOL_DATABASE);
     uint64_t start_time = get_time_us();
 
-    pthread_mutex_lock(&db_pool_mutex);
-
-    // Find existing connection
-    db_connection_t* conn = find_connection(connection_string);
+    db_thread_pool_t* pool = pool_lock(false);
+    db_connection_t** slot = pool ? pool_find(pool, connection_string) : NULL;
+    db_connection_t* conn = slot ? *slot : NULL;
     if (!conn || !conn->is_connected) {
-        response->success = false;
-        response->status_code = 400;
-        strcpy(response->error_message, "No active database connection to disconnect");
-        response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&db_pool_mutex);
+        SET_ERROR_RESPONSE(response, 400, start_time, "No active database connection to disconnect");
+        if (pool) pthread_mutex_unlock(&pool->mutex);
         return -1;
     }
 
-    // Disconnect
-    conn->is_connected = false;
-    conn->connection_handle = NULL;
+    *slot = conn->next;
+    pool->count--;
+    connection_close(conn);
+    free(conn);
 
-    response->success = true;
-    response->status_code = 200;
     strcpy(response->body, "Database connection closed successfully");
-    response->response_time_us = get_time_us() - start_time;
+    SET_SUCCESS_RESPONSE(response, 200, start_time);
 
-    pthread_mutex_unlock(&db_pool_mutex);
+    pthread_mutex_unlock(&pool->mutex);
     return 0;
 }
 
 void database_cleanup_all(void) {
-    pthread_mutex_lock(&db_pool_mutex);
-    for (int i = 0; i < db_connection_count; i++) {
-        db_connections[i].is_connected = false;
-        db_connections[i].connection_handle = NULL;
+    pthread_mutex_lock(&pool_list_mutex);
+    for (db_thread_pool_t* pool = pool_list; pool; pool = pool->next) {
+        pthread_mutex_lock(&pool->mutex);
+        pool_drain(pool);
+        pthread_mutex_unlock(&pool->mutex);
     }
-    db_connection_count = 0;
-    pthread_mutex_unlock(&db_pool_mutex);
+    pthread_mutex_unlock(&pool_list_mutex);
+    atomic_store(&db_pool_warned, 0);
 }
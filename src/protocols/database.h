@@ -5,6 +5,23 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/*
+ * Database client behind the blocking database_* API.
+ *
+ * Every thread owns its own pool of connections keyed by the connection
+ * string, so threads never contend for a connection or a lock on the query
+ * path; a connection opened on one thread is not visible from another.
+ * Each connection keeps a cache of prepared statements keyed by query
+ * text, so a repeated query is parsed and planned by the server once.
+ *
+ * The drivers are optional at build time: PostgreSQL needs libpq
+ * (LOADSPIKER_HAVE_LIBPQ) and MySQL needs libmysqlclient
+ * (LOADSPIKER_HAVE_MYSQL). A type whose driver is missing fails with
+ * status 501. MongoDB is recognised but not supported.
+ */
+
+#define DB_STATEMENT_CACHE 32          /* prepared statements kept per connection */
+
 // Database types
 typedef enum {
     DB_TYPE_MYSQL,
@@ -13,13 +30,27 @@ typedef enum {
     DB_TYPE_UNKNOWN
 } db_type_t;
 
-// Database connection structure
+// One cached prepared statement
 typedef struct {
+    uint64_t hash;                  /* of the query text, 0 = empty slot */
+    char* query;
+    void* handle;                   /* driver's statement: MYSQL_STMT*, or NULL for PostgreSQL */
+    char name[24];                  /* server-side name (PostgreSQL) */
+    uint64_t last_used;
+} db_statement_t;
+
+// Database connection structure
+typedef struct db_connection {
     char connection_string[MAX_URL_LENGTH];
     db_type_t type;
-    void* connection_handle;
+    void* connection_handle;        /* PGconn* or MYSQL* */
     bool is_connected;
     char last_error[256];
+    db_statement_t statements[DB_STATEMENT_CACHE];
+    uint64_t statement_clock;       /* last_used stamp source */
+    uint64_t statements_prepared;   /* over the connection's lifetime */
+    uint64_t queries;
+    struct db_connection* next;     /* hash chain of the owning thread's pool */
 } db_connection_t;
 
 // Database-specific response data
@@ -41,8 +72,16 @@ int database_disconnect(const char* connection_string, response_t* response);
 db_type_t database_parse_type(const char* db_type_str);
 const char* database_type_to_string(db_type_t type);
 int database_parse_connection_string(const char* connection_string, char* host, int* port, char* database, char* username, char* password);
+// Which database a connection string names by its scheme, DB_TYPE_UNKNOWN if none
+db_type_t database_type_from_url(const char* connection_string);
+// Whether the driver for type was compiled in
+bool database_driver_available(db_type_t type);
+
+// Pool sizing: most connections one thread may hold open (default 100)
+int database_set_pool_size(int max_connections);
+int database_get_pool_size(void);
 
-// Cleanup function - resets all database connections
+// Cleanup function - closes every thread's database connections
 void database_cleanup_all(void);
 
 #endif // DATABASE_H
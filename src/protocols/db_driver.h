@@ -0,0 +1,47 @@
+#ifndef DB_DRIVER_H
+#define DB_DRIVER_H
+
+#include "database.h"
+#include <stddef.h>
+
+/*
+ * Driver interface between database.c (pools, statement cache, responses)
+ * and one client library. A driver whose library was not compiled in is
+ * simply absent: its getter returns NULL.
+ *
+ * All calls run on the thread that owns the connection.
+ */
+
+// Parsed form of a URL-style connection string
+typedef struct {
+    char host[256];
+    int port;
+    char database[256];
+    char username[256];
+    char password[256];
+} db_params_t;
+
+typedef struct {
+    const char* name;            /* "PostgreSQL", for messages */
+    /* Open conn->connection_handle; -1 with error filled on failure */
+    int (*connect)(db_connection_t* conn, const db_params_t* params, char* error, size_t error_len);
+    /* Run query through stmt, preparing it first if stmt->query is not yet
+       prepared on this connection (prepare set). Fills the
+       response's body and database data. Returns 0, -1 for an error the
+       server reported (the connection stays usable) or -2 when the
+       connection is gone. A failed call with prepare set leaves nothing
+       prepared behind. */
+    int (*execute)(db_connection_t* conn, db_statement_t* stmt, bool prepare, response_t* response);
+    /* Drop a statement evicted from the cache (best effort); close() frees the rest */
+    void (*release_statement)(db_connection_t* conn, db_statement_t* stmt);
+    void (*close)(db_connection_t* conn);
+} db_driver_t;
+
+const db_driver_t* db_postgres_driver(void);
+const db_driver_t* db_mysql_driver(void);
+
+// Append text to a CSV result set, quoting it when it has a comma, quote or
+// newline. Returns false once the buffer is full (the set is truncated).
+bool db_result_append(char* out, size_t cap, size_t* len, const char* text, size_t text_len, bool last_in_row);
+
+#endif // DB_DRIVER_H
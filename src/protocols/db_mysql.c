@@ -0,0 +1,176 @@
+#include "db_driver.h"
+
+#ifdef LOADSPIKER_HAVE_MYSQL
+
+#include <mysql.h>
+#include <errmsg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * MySQL / MariaDB driver over the libmysqlclient prepared-statement API.
+ * Each cached statement holds its MYSQL_STMT, so a repeated query is only
+ * executed, never re-parsed.
+ */
+
+#define MYSQL_FIELD_BUFFER 4096        /* longer values are truncated in the result set */
+
+/* my_bool in MariaDB and MySQL < 8, bool after */
+typedef __typeof__(*((MYSQL_BIND*)0)->is_null) mysql_null_t;
+
+static int mysql_gone(unsigned int err) {
+    return err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST || err == CR_CONNECTION_ERROR;
+}
+
+static int my_connect(db_connection_t* conn, const db_params_t* params, char* error, size_t error_len) {
+    MYSQL* my = mysql_init(NULL);
+    if (!my) {
+        snprintf(error, error_len, "Out of memory");
+        return -1;
+    }
+    unsigned int timeout = 10;
+    mysql_options(my, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+
+    if (!mysql_real_connect(my, params->host, params->username, params->password,
+                            params->database[0] ? params->database : NULL,
+                            (unsigned int)params->port, NULL, 0)) {
+        snprintf(error, error_len, "Connection failed: %s", mysql_error(my));
+        mysql_close(my);
+        return -1;
+    }
+    conn->connection_handle = my;
+    return 0;
+}
+
+static int stmt_fail(db_connection_t* conn, MYSQL_STMT* ms, const char* prefix) {
+    snprintf(conn->last_error, sizeof(conn->last_error), "%s%s", prefix, mysql_stmt_error(ms));
+    return mysql_gone(mysql_stmt_errno(ms)) ? -2 : -1;
+}
+
+/* Fetch every row of an executed statement into the response as CSV */
+static int my_fetch(db_connection_t* conn, MYSQL_STMT* ms, MYSQL_RES* meta, response_t* response) {
+    database_response_data_t* db = &response->protocol_data.database;
+    unsigned int cols = mysql_num_fields(meta);
+    MYSQL_FIELD* fields = mysql_fetch_fields(meta);
+    MYSQL_BIND* binds = calloc(cols, sizeof(MYSQL_BIND));
+    char* buffers = malloc((size_t)cols * MYSQL_FIELD_BUFFER);
+    unsigned long* lengths = calloc(cols, sizeof(unsigned long));
+    mysql_null_t* nulls = calloc(cols, sizeof(mysql_null_t));
+    if (!binds || !buffers || !lengths || !nulls) {
+        free(binds); free(buffers); free(lengths); free(nulls);
+        snprintf(conn->last_error, sizeof(conn->last_error), "Out of memory");
+        return -1;
+    }
+    for (unsigned int c = 0; c < cols; c++) {
+        binds[c].buffer_type = MYSQL_TYPE_STRING;
+        binds[c].buffer = buffers + (size_t)c * MYSQL_FIELD_BUFFER;
+        binds[c].buffer_length = MYSQL_FIELD_BUFFER;
+        binds[c].length = &lengths[c];
+        binds[c].is_null = &nulls[c];
+    }
+
+    int rc = 0;
+    if (mysql_stmt_bind_result(ms, binds) != 0 || mysql_stmt_store_result(ms) != 0) {
+        rc = stmt_fail(conn, ms, "Query failed: ");
+    } else {
+        size_t cap = sizeof(db->result_set), len = 0;
+        bool room = true;
+        for (unsigned int c = 0; c < cols && room; c++) {
+            room = db_result_append(db->result_set, cap, &len, fields[c].name, strlen(fields[c].name), c == cols - 1);
+        }
+        int rows = 0, status;
+        while ((status = mysql_stmt_fetch(ms)) == 0 || status == MYSQL_DATA_TRUNCATED) {
+            rows++;
+            for (unsigned int c = 0; c < cols && room; c++) {
+                size_t n = nulls[c] ? 0 : lengths[c];
+                if (n > MYSQL_FIELD_BUFFER) n = MYSQL_FIELD_BUFFER;
+                room = db_result_append(db->result_set, cap, &len, binds[c].buffer, n, c == cols - 1);
+            }
+        }
+        if (status == 1) rc = stmt_fail(conn, ms, "Fetch failed: ");
+        db->rows_returned = rows;
+        snprintf(response->body, sizeof(response->body),
+                 "Query executed successfully. %d rows returned.", rows);
+        mysql_stmt_free_result(ms);
+    }
+
+    free(binds); free(buffers); free(lengths); free(nulls);
+    return rc;
+}
+
+static int my_execute(db_connection_t* conn, db_statement_t* stmt, bool prepare, response_t* response) {
+    MYSQL* my = (MYSQL*)conn->connection_handle;
+
+    if (prepare) {
+        MYSQL_STMT* ms = mysql_stmt_init(my);
+        if (!ms) {
+            snprintf(conn->last_error, sizeof(conn->last_error), "Prepare failed: %s", mysql_error(my));
+            return mysql_gone(mysql_errno(my)) ? -2 : -1;
+        }
+        if (mysql_stmt_prepare(ms, stmt->query, strlen(stmt->query)) != 0) {
+            int rc = stmt_fail(conn, ms, "Prepare failed: ");
+            mysql_stmt_close(ms);
+            return rc;
+        }
+        stmt->handle = ms;
+    }
+
+    MYSQL_STMT* ms = (MYSQL_STMT*)stmt->handle;
+    int rc;
+    if (mysql_stmt_execute(ms) != 0) {
+        rc = stmt_fail(conn, ms, "Query failed: ");
+    } else {
+        MYSQL_RES* meta = mysql_stmt_result_metadata(ms);
+        if (meta) {
+            rc = my_fetch(conn, ms, meta, response);
+            mysql_free_result(meta);
+        } else {
+            database_response_data_t* db = &response->protocol_data.database;
+            db->rows_affected = (int)mysql_stmt_affected_rows(ms);
+            snprintf(response->body, sizeof(response->body),
+                     "Query executed successfully. %d row(s) affected.", db->rows_affected);
+            rc = 0;
+        }
+    }
+
+    if (rc != 0 && prepare) {
+        mysql_stmt_close(ms);
+        stmt->handle = NULL;
+    }
+    return rc;
+}
+
+static void my_release_statement(db_connection_t* conn, db_statement_t* stmt) {
+    (void)conn;
+    if (stmt->handle) mysql_stmt_close((MYSQL_STMT*)stmt->handle);
+    stmt->handle = NULL;
+}
+
+static void my_close(db_connection_t* conn) {
+    for (int i = 0; i < DB_STATEMENT_CACHE; i++) {
+        my_release_statement(conn, &conn->statements[i]);
+    }
+    mysql_close((MYSQL*)conn->connection_handle);
+    conn->connection_handle = NULL;
+}
+
+static const db_driver_t mysql_driver = {
+    .name = "MySQL",
+    .connect = my_connect,
+    .execute = my_execute,
+    .release_statement = my_release_statement,
+    .close = my_close,
+};
+
+const db_driver_t* db_mysql_driver(void) {
+    return &mysql_driver;
+}
+
+#else /* !LOADSPIKER_HAVE_MYSQL */
+
+const db_driver_t* db_mysql_driver(void) {
+    return NULL;
+}
+
+#endif
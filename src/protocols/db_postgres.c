@@ -0,0 +1,142 @@
+#include "db_driver.h"
+
+#ifdef LOADSPIKER_HAVE_LIBPQ
+
+#include <libpq-fe.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * PostgreSQL driver over libpq. The connection string is handed to libpq
+ * as-is (expand_dbname), so every URI option libpq knows (sslmode,
+ * options, ...) works; connect_timeout and application_name are only
+ * defaults the URI may override.
+ */
+
+static void pg_error(db_connection_t* conn, const char* prefix, const char* message) {
+    snprintf(conn->last_error, sizeof(conn->last_error), "%s%s", prefix, message ? message : "unknown error");
+    /* libpq messages end in a newline */
+    size_t len = strlen(conn->last_error);
+    while (len > 0 && (conn->last_error[len - 1] == '\n' || conn->last_error[len - 1] == ' ')) {
+        conn->last_error[--len] = '\0';
+    }
+}
+
+static int pg_connect(db_connection_t* conn, const db_params_t* params, char* error, size_t error_len) {
+    (void)params;
+    const char* keywords[] = {"connect_timeout", "application_name", "dbname", NULL};
+    const char* values[] = {"10", "loadspiker", conn->connection_string, NULL};
+
+    PGconn* pg = PQconnectdbParams(keywords, values, 1);
+    if (!pg) {
+        snprintf(error, error_len, "Out of memory");
+        return -1;
+    }
+    if (PQstatus(pg) != CONNECTION_OK) {
+        pg_error(conn, "Connection failed: ", PQerrorMessage(pg));
+        if (error != conn->last_error) snprintf(error, error_len, "%s", conn->last_error);
+        PQfinish(pg);
+        return -1;
+    }
+    conn->connection_handle = pg;
+    return 0;
+}
+
+/* Failure of res: -2 when it took the connection with it, else -1 */
+static int pg_fail(db_connection_t* conn, PGconn* pg, PGresult* res, const char* prefix) {
+    pg_error(conn, prefix, res ? PQresultErrorMessage(res) : PQerrorMessage(pg));
+    if (conn->last_error[strlen(prefix)] == '\0') pg_error(conn, prefix, PQerrorMessage(pg));
+    if (res) PQclear(res);
+    return PQstatus(pg) == CONNECTION_OK ? -1 : -2;
+}
+
+static void pg_deallocate(PGconn* pg, const char* name) {
+    char sql[64];
+    snprintf(sql, sizeof(sql), "DEALLOCATE %s", name);
+    PQclear(PQexec(pg, sql));
+}
+
+static void pg_fill_result(PGresult* res, response_t* response) {
+    database_response_data_t* db = &response->protocol_data.database;
+    char* out = db->result_set;
+    size_t cap = sizeof(db->result_set), len = 0;
+    int rows = PQntuples(res), cols = PQnfields(res);
+
+    bool room = true;
+    for (int c = 0; c < cols && room; c++) {
+        const char* name = PQfname(res, c);
+        room = db_result_append(out, cap, &len, name, strlen(name), c == cols - 1);
+    }
+    for (int r = 0; r < rows && room; r++) {
+        for (int c = 0; c < cols && room; c++) {
+            room = db_result_append(out, cap, &len, PQgetvalue(res, r, c),
+                                    (size_t)PQgetlength(res, r, c), c == cols - 1);
+        }
+    }
+
+    db->rows_returned = rows;
+    const char* affected = PQcmdTuples(res);
+    db->rows_affected = affected[0] ? atoi(affected) : 0;
+    if (cols > 0) {
+        snprintf(response->body, sizeof(response->body),
+                 "Query executed successfully. %d rows returned.", rows);
+    } else {
+        snprintf(response->body, sizeof(response->body),
+                 "Query executed successfully. %d row(s) affected.", db->rows_affected);
+    }
+}
+
+static int pg_execute(db_connection_t* conn, db_statement_t* stmt, bool prepare, response_t* response) {
+    PGconn* pg = (PGconn*)conn->connection_handle;
+
+    if (prepare) {
+        PGresult* res = PQprepare(pg, stmt->name, stmt->query, 0, NULL);
+        if (!res || PQresultStatus(res) != PGRES_COMMAND_OK) {
+            return pg_fail(conn, pg, res, "Prepare failed: ");
+        }
+        PQclear(res);
+    }
+
+    PGresult* res = PQexecPrepared(pg, stmt->name, 0, NULL, NULL, NULL, 0);
+    ExecStatusType status = res ? PQresultStatus(res) : PGRES_FATAL_ERROR;
+    if (status != PGRES_TUPLES_OK && status != PGRES_COMMAND_OK) {
+        int rc = pg_fail(conn, pg, res, "Query failed: ");
+        if (prepare && rc == -1) pg_deallocate(pg, stmt->name);
+        return rc;
+    }
+
+    pg_fill_result(res, response);
+    PQclear(res);
+    return 0;
+}
+
+static void pg_release_statement(db_connection_t* conn, db_statement_t* stmt) {
+    PGconn* pg = (PGconn*)conn->connection_handle;
+    if (pg && PQstatus(pg) == CONNECTION_OK) pg_deallocate(pg, stmt->name);
+}
+
+static void pg_close(db_connection_t* conn) {
+    PQfinish((PGconn*)conn->connection_handle);
+    conn->connection_handle = NULL;
+}
+
+static const db_driver_t postgres_driver = {
+    .name = "PostgreSQL",
+    .connect = pg_connect,
+    .execute = pg_execute,
+    .release_statement = pg_release_statement,
+    .close = pg_close,
+};
+
+const db_driver_t* db_postgres_driver(void) {
+    return &postgres_driver;
+}
+
+#else /* !LOADSPIKER_HAVE_LIBPQ */
+
+const db_driver_t* db_postgres_driver(void) {
+    return NULL;
+}
+
+#endif
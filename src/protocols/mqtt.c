@@ -1,4 +1,5 @@
 #include "mqtt.h"
+#include "conn_table.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -24,23 +25,20 @@ static inline unsigned int get_thread_seed(void) {
     return thread_rng_seed;
 }
 
-// Connection pool for MQTT connections
-#define MAX_MQTT_CONNECTIONS 50
-static mqtt_connection_t mqtt_connections[MAX_MQTT_CONNECTIONS];
-static int mqtt_connection_count = 0;
-static pthread_mutex_t mqtt_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int mqtt_pool_warned = 0;
-
-// MQTT packet types
-#define MQTT_CONNECT     0x10
-#define MQTT_CONNACK     0x20
-#define MQTT_PUBLISH     0x30
-#define MQTT_PUBACK      0x40
-#define MQTT_SUBSCRIBE   0x82
-#define MQTT_SUBACK      0x90
-#define MQTT_UNSUBSCRIBE 0xA2
-#define MQTT_UNSUBACK    0xB0
-#define MQTT_DISCONNECT  0xE0
+// Connection pool for MQTT connections: each slot of mqtt_table (keyed by
+// host, port and client ID) stores its mqtt_connection_t, guarded by that
+// slot's lock
+#define MQTT_DEFAULT_POOL_SIZE 50
+static conn_table_t mqtt_table = CONN_TABLE_INIT("MQTT", mqtt_connection_t, MQTT_DEFAULT_POOL_SIZE);
+
+static mqtt_connection_t* mqtt_connection_at(int slot) {
+    return conn_table_entry(&mqtt_table, slot);
+}
+
+/* A disconnected slot can go back on the free list */
+static bool mqtt_slot_idle(int slot) {
+    return !mqtt_connection_at(slot)->is_connected;
+}
 
 
 int mqtt_parse_url(const char* url, char* host, int* port, char* client_id) {
@@ -97,35 +95,8 @@ int mqtt_parse_url(const char* url, char* host, int* port, char* client_id) {
     return 0;
 }
 
-mqtt_connection_t* mqtt_find_connection(const char* host, int port, const char* client_id) {
-    pthread_mutex_lock(&mqtt_pool_mutex);
-    mqtt_connection_t* result = NULL;
-    for (int i = 0; i < mqtt_connection_count; i++) {
-        if (strcmp(mqtt_connections[i].host, host) == 0 &&
-            mqtt_connections[i].port == port &&
-            strcmp(mqtt_connections[i].client_id, client_id) == 0) {
-            result = &mqtt_connections[i];
-            break;
-        }
-    }
-    pthread_mutex_unlock(&mqtt_pool_mutex);
-    return result;
-}
-
-mqtt_connection_t* mqtt_create_connection(const char* host, int port, const char* client_id) {
-    pthread_mutex_lock(&mqtt_pool_mutex);
-    if (mqtt_connection_count >= MAX_MQTT_CONNECTIONS) {
-        if (!mqtt_pool_warned) {
-            fprintf(stderr, "[LoadSpiker] MQTT pool full — increase MAX_MQTT_CONNECTIONS\n");
-            mqtt_pool_warned = 1;
-        }
-        pthread_mutex_unlock(&mqtt_pool_mutex);
-        return NULL;
-    }
-
-    mqtt_connection_t* conn = &mqtt_connections[mqtt_connection_count++];
+static void mqtt_init_connection(mqtt_connection_t* conn, const char* host, int port, const char* client_id) {
     memset(conn, 0, sizeof(mqtt_connection_t));
-
     strncpy(conn->host, host, sizeof(conn->host) - 1);
     conn->port = port;
     strncpy(conn->client_id, client_id, sizeof(conn->client_id) - 1);
@@ -133,14 +104,25 @@ mqtt_connection_t* mqtt_create_connection(const char* host, int port, const char
     conn->socket_fd = -1;
     conn->packet_id = 1;
     conn->keep_alive_seconds = 60;
+}
 
-    pthread_mutex_unlock(&mqtt_pool_mutex);
-    return conn;
+mqtt_connection_t* mqtt_find_connection(const char* host, int port, const char* client_id) {
+    int slot = conn_table_find(&mqtt_table, host, port, client_id);
+    return slot >= 0 ? mqtt_connection_at(slot) : NULL;
 }
 
-static int mqtt_create_connect_packet(char* buffer, const char* client_id,
-                                     const char* username, const char* password,
-                                     int keep_alive) {
+mqtt_connection_t* mqtt_create_connection(const char* host, int port, const char* client_id) {
+    bool created = false;
+    int slot = conn_table_acquire(&mqtt_table, host, port, client_id, true, &created);
+    if (slot < 0) return NULL;
+    if (created) mqtt_init_connection(mqtt_connection_at(slot), host, port, client_id);
+    conn_table_release(&mqtt_table, slot);
+    return mqtt_connection_at(slot);
+}
+
+int mqtt_create_connect_packet(char* buffer, const char* client_id,
+                               const char* username, const char* password,
+                               int keep_alive) {
     int pos = 0;
 
     // Fixed header
@@ -217,9 +199,9 @@ static int mqtt_create_connect_packet(char* buffer, const char* client_id,
     return pos;
 }
 
-static int mqtt_create_publish_packet(char* buffer, const char* topic,
-                                     const char* message, mqtt_qos_t qos,
-                                     bool retain, uint16_t packet_id) {
+int mqtt_create_publish_packet(char* buffer, const char* topic,
+                              const char* message, size_t message_len, mqtt_qos_t qos,
+                              bool retain, uint16_t packet_id) {
     int pos = 0;
 
     // Fixed header
@@ -230,8 +212,7 @@ static int mqtt_create_publish_packet(char* buffer, const char* topic,
 
     // Calculate remaining length
     int topic_len = strlen(topic);
-    int message_len = strlen(message);
-    int remaining_length = 2 + topic_len + message_len;
+    int remaining_length = 2 + topic_len + (int)message_len;
     if (qos > 0) remaining_length += 2; // Packet ID for QoS > 0
 
     // Encode remaining length
@@ -270,59 +251,34 @@ int mqtt_connect(const char* host, int port, const char* client_id,
         return -1;
     }
 
-    pthread_mutex_lock(&mqtt_pool_mutex);
-
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_MQTT;
     uint64_t start_time = get_time_us();
 
-    // Check if connection already exists (inline find — mutex already held)
-    bool new_entry = false;
-    mqtt_connection_t* conn = NULL;
-    for (int i = 0; i < mqtt_connection_count; i++) {
-        if (strcmp(mqtt_connections[i].host, host) == 0 &&
-            mqtt_connections[i].port == port &&
-            strcmp(mqtt_connections[i].client_id, client_id) == 0) {
-            conn = &mqtt_connections[i];
-            break;
-        }
+    // Find or create the connection; its slot stays locked until we return
+    bool created = false;
+    int slot = conn_table_acquire(&mqtt_table, host, port, client_id, true, &created);
+    if (slot < 0) {
+        response->status_code = 500;
+        response->success = false;
+        strcpy(response->error_message, "Too many MQTT connections");
+        response->response_time_us = get_time_us() - start_time;
+        return -1;
     }
-    if (conn && conn->is_connected) {
+    mqtt_connection_t* conn = mqtt_connection_at(slot);
+    if (created) mqtt_init_connection(conn, host, port, client_id);
+
+    if (conn->is_connected) {
         response->status_code = 200;
         response->success = true;
         snprintf(response->body, sizeof(response->body),
                 "MQTT connection already established to %s:%d with client ID %s",
                 host, port, client_id);
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_release(&mqtt_table, slot);
         return 0;
     }
 
-    if (!conn) {
-        if (mqtt_connection_count >= MAX_MQTT_CONNECTIONS) {
-            if (!mqtt_pool_warned) {
-                fprintf(stderr, "[LoadSpiker] MQTT pool full — increase MAX_MQTT_CONNECTIONS\n");
-                mqtt_pool_warned = 1;
-            }
-            response->status_code = 500;
-            response->success = false;
-            strcpy(response->error_message, "Too many MQTT connections");
-            response->response_time_us = get_time_us() - start_time;
-            pthread_mutex_unlock(&mqtt_pool_mutex);
-            return -1;
-        }
-        conn = &mqtt_connections[mqtt_connection_count++];
-        memset(conn, 0, sizeof(mqtt_connection_t));
-        strncpy(conn->host, host, sizeof(conn->host) - 1);
-        conn->port = port;
-        strncpy(conn->client_id, client_id, sizeof(conn->client_id) - 1);
-        conn->is_connected = false;
-        conn->socket_fd = -1;
-        conn->packet_id = 1;
-        conn->keep_alive_seconds = 60;
-        new_entry = true;
-    }
-
     // Create socket
     conn->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (conn->socket_fd < 0) {
@@ -331,7 +287,7 @@ int mqtt_connect(const char* host, int port, const char* client_id,
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to create socket: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_retire(&mqtt_table, slot, mqtt_slot_idle);
         return -1;
     }
 
@@ -345,12 +301,13 @@ int mqtt_connect(const char* host, int port, const char* client_id,
     int gai_err = getaddrinfo(host, port_str, &hints, &res);
     if (gai_err != 0) {
         close(conn->socket_fd);
+        conn->socket_fd = -1;
         response->status_code = 500;
         response->success = false;
         snprintf(response->error_message, sizeof(response->error_message),
                 "DNS resolution failed for %s: %s", host, gai_strerror(gai_err));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_retire(&mqtt_table, slot, mqtt_slot_idle);
         return -1;
     }
 
@@ -358,12 +315,13 @@ int mqtt_connect(const char* host, int port, const char* client_id,
     if (connect(conn->socket_fd, res->ai_addr, res->ai_addrlen) < 0) {
         freeaddrinfo(res);
         close(conn->socket_fd);
+        conn->socket_fd = -1;
         response->status_code = 500;
         response->success = false;
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to connect to MQTT broker: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_retire(&mqtt_table, slot, mqtt_slot_idle);
         return -1;
     }
 
@@ -376,12 +334,13 @@ int mqtt_connect(const char* host, int port, const char* client_id,
 
     if (send(conn->socket_fd, connect_packet, packet_len, 0) < 0) {
         close(conn->socket_fd);
+        conn->socket_fd = -1;
         response->status_code = 500;
         response->success = false;
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to send CONNECT packet: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_retire(&mqtt_table, slot, mqtt_slot_idle);
         return -1;
     }
 
@@ -391,17 +350,12 @@ int mqtt_connect(const char* host, int port, const char* client_id,
     if (connack_len < 0) {
         close(conn->socket_fd);
         conn->socket_fd = -1;
-        /* Remove pool entry only if it was newly allocated for this call */
-        if (new_entry) {
-            mqtt_connection_count--;
-            memset(&mqtt_connections[mqtt_connection_count], 0, sizeof(mqtt_connection_t));
-        }
         response->status_code = 500;
         response->success = false;
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to receive CONNACK: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_retire(&mqtt_table, slot, mqtt_slot_idle);
         return -1;
     }
     if (connack_len < 4 ||
@@ -409,13 +363,9 @@ int mqtt_connect(const char* host, int port, const char* client_id,
         (unsigned char)connack[1] != 0x02 ||
         (unsigned char)connack[2] != 0x00 ||
         (unsigned char)connack[3] != 0x00) {
+        /* Rejected: the slot goes back on the free list */
         close(conn->socket_fd);
         conn->socket_fd = -1;
-        /* Remove pool entry — bad CONNACK means connection was rejected; leave no half-open slot */
-        if (new_entry) {
-            mqtt_connection_count--;
-            memset(&mqtt_connections[mqtt_connection_count], 0, sizeof(mqtt_connection_t));
-        }
         response->status_code = 500;
         response->success = false;
         if (connack_len >= 4 && (unsigned char)connack[0] == 0x20 && (unsigned char)connack[1] == 0x02) {
@@ -431,7 +381,7 @@ int mqtt_connect(const char* host, int port, const char* client_id,
                     connack_len);
         }
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_retire(&mqtt_table, slot, mqtt_slot_idle);
         return -1;
     }
 
@@ -461,7 +411,7 @@ int mqtt_connect(const char* host, int port, const char* client_id,
     mqtt_data->qos_level = MQTT_QOS_0;
     mqtt_data->retained = false;
 
-    pthread_mutex_unlock(&mqtt_pool_mutex);
+    conn_table_release(&mqtt_table, slot);
     return 0;
 }
 
@@ -472,34 +422,25 @@ int mqtt_publish(const char* host, int port, const char* client_id,
         return -1;
     }
 
-    pthread_mutex_lock(&mqtt_pool_mutex);
-
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_MQTT;
     uint64_t start_time = get_time_us();
 
-    // Find existing connection
-    mqtt_connection_t* conn = NULL;
-    for (int i = 0; i < mqtt_connection_count; i++) {
-        if (strcmp(mqtt_connections[i].host, host) == 0 &&
-            mqtt_connections[i].port == port &&
-            strcmp(mqtt_connections[i].client_id, client_id) == 0) {
-            conn = &mqtt_connections[i];
-            break;
-        }
-    }
+    // Find existing connection and hold it for the whole operation
+    int slot = conn_table_acquire(&mqtt_table, host, port, client_id, false, NULL);
+    mqtt_connection_t* conn = slot >= 0 ? mqtt_connection_at(slot) : NULL;
     if (!conn || !conn->is_connected) {
         response->status_code = 400;
         response->success = false;
         strcpy(response->error_message, "No active MQTT connection");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        if (conn) conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
     // Create PUBLISH packet
     char publish_packet[MAX_MQTT_MESSAGE_LENGTH + 512];
-    int packet_len = mqtt_create_publish_packet(publish_packet, topic, message,
+    int packet_len = mqtt_create_publish_packet(publish_packet, topic, message, strlen(message),
                                                qos, retain, conn->packet_id++);
 
     // Send PUBLISH packet
@@ -509,7 +450,7 @@ int mqtt_publish(const char* host, int port, const char* client_id,
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to send PUBLISH packet: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -530,12 +471,12 @@ int mqtt_publish(const char* host, int port, const char* client_id,
     mqtt_data->retained = retain;
     mqtt_data->publish_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&mqtt_pool_mutex);
+    conn_table_release(&mqtt_table, slot);
     return 0;
 }
 
-static int mqtt_create_subscribe_packet(char* buffer, const char* topic,
-                                       mqtt_qos_t qos, uint16_t packet_id) {
+int mqtt_create_subscribe_packet(char* buffer, const char* topic,
+                                mqtt_qos_t qos, uint16_t packet_id) {
     int pos = 0;
     int topic_len = strlen(topic);
 
@@ -578,28 +519,19 @@ int mqtt_subscribe(const char* host, int port, const char* client_id,
         return -1;
     }
 
-    pthread_mutex_lock(&mqtt_pool_mutex);
-
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_MQTT;
     uint64_t start_time = get_time_us();
 
-    // Find existing connection
-    mqtt_connection_t* conn = NULL;
-    for (int i = 0; i < mqtt_connection_count; i++) {
-        if (strcmp(mqtt_connections[i].host, host) == 0 &&
-            mqtt_connections[i].port == port &&
-            strcmp(mqtt_connections[i].client_id, client_id) == 0) {
-            conn = &mqtt_connections[i];
-            break;
-        }
-    }
+    // Find existing connection and hold it for the whole operation
+    int slot = conn_table_acquire(&mqtt_table, host, port, client_id, false, NULL);
+    mqtt_connection_t* conn = slot >= 0 ? mqtt_connection_at(slot) : NULL;
     if (!conn || !conn->is_connected) {
         response->status_code = 400;
         response->success = false;
         strcpy(response->error_message, "No active MQTT connection");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        if (conn) conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -615,7 +547,7 @@ int mqtt_subscribe(const char* host, int port, const char* client_id,
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to send SUBSCRIBE packet: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -628,7 +560,7 @@ int mqtt_subscribe(const char* host, int port, const char* client_id,
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to receive SUBACK: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -639,7 +571,7 @@ int mqtt_subscribe(const char* host, int port, const char* client_id,
         snprintf(response->error_message, sizeof(response->error_message),
                 "Invalid SUBACK response (got 0x%02X)", (unsigned char)suback[0]);
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -654,7 +586,7 @@ int mqtt_subscribe(const char* host, int port, const char* client_id,
     strncpy(mqtt_data->topic, topic, sizeof(mqtt_data->topic) - 1);
     mqtt_data->qos_level = qos;
 
-    pthread_mutex_unlock(&mqtt_pool_mutex);
+    conn_table_release(&mqtt_table, slot);
     return 0;
 }
 
@@ -698,28 +630,19 @@ int mqtt_unsubscribe(const char* host, int port, const char* client_id,
         return -1;
     }
 
-    pthread_mutex_lock(&mqtt_pool_mutex);
-
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_MQTT;
     uint64_t start_time = get_time_us();
 
-    // Find existing connection
-    mqtt_connection_t* conn = NULL;
-    for (int i = 0; i < mqtt_connection_count; i++) {
-        if (strcmp(mqtt_connections[i].host, host) == 0 &&
-            mqtt_connections[i].port == port &&
-            strcmp(mqtt_connections[i].client_id, client_id) == 0) {
-            conn = &mqtt_connections[i];
-            break;
-        }
-    }
+    // Find existing connection and hold it for the whole operation
+    int slot = conn_table_acquire(&mqtt_table, host, port, client_id, false, NULL);
+    mqtt_connection_t* conn = slot >= 0 ? mqtt_connection_at(slot) : NULL;
     if (!conn || !conn->is_connected) {
         response->status_code = 400;
         response->success = false;
         strcpy(response->error_message, "No active MQTT connection");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        if (conn) conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -735,7 +658,7 @@ int mqtt_unsubscribe(const char* host, int port, const char* client_id,
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to send UNSUBSCRIBE packet: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -748,7 +671,7 @@ int mqtt_unsubscribe(const char* host, int port, const char* client_id,
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to receive UNSUBACK: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -759,7 +682,7 @@ int mqtt_unsubscribe(const char* host, int port, const char* client_id,
         snprintf(response->error_message, sizeof(response->error_message),
                 "Invalid UNSUBACK response (got 0x%02X)", (unsigned char)unsuback[0]);
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -769,7 +692,7 @@ int mqtt_unsubscribe(const char* host, int port, const char* client_id,
             "Unsubscribed from topic '%s'", topic);
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&mqtt_pool_mutex);
+    conn_table_release(&mqtt_table, slot);
     return 0;
 }
 
@@ -778,28 +701,19 @@ int mqtt_disconnect(const char* host, int port, const char* client_id, response_
         return -1;
     }
 
-    pthread_mutex_lock(&mqtt_pool_mutex);
-
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_MQTT;
     uint64_t start_time = get_time_us();
 
-    // Find existing connection
-    mqtt_connection_t* conn = NULL;
-    for (int i = 0; i < mqtt_connection_count; i++) {
-        if (strcmp(mqtt_connections[i].host, host) == 0 &&
-            mqtt_connections[i].port == port &&
-            strcmp(mqtt_connections[i].client_id, client_id) == 0) {
-            conn = &mqtt_connections[i];
-            break;
-        }
-    }
+    // Find existing connection and hold it for the whole operation
+    int slot = conn_table_acquire(&mqtt_table, host, port, client_id, false, NULL);
+    mqtt_connection_t* conn = slot >= 0 ? mqtt_connection_at(slot) : NULL;
     if (!conn || !conn->is_connected) {
         response->status_code = 400;
         response->success = false;
         strcpy(response->error_message, "No active MQTT connection to disconnect");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&mqtt_pool_mutex);
+        if (conn) conn_table_release(&mqtt_table, slot);
         return -1;
     }
 
@@ -818,22 +732,35 @@ int mqtt_disconnect(const char* host, int port, const char* client_id, response_
             "MQTT connection to %s:%d closed successfully", host, port);
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&mqtt_pool_mutex);
+    conn_table_retire(&mqtt_table, slot, mqtt_slot_idle);
     return 0;
 }
 
-void mqtt_cleanup_all(void) {
-    pthread_mutex_lock(&mqtt_pool_mutex);
-    for (int i = 0; i < mqtt_connection_count; i++) {
-        if (mqtt_connections[i].socket_fd >= 0) {
-            // Try to send DISCONNECT packet before closing
-            char disconnect_packet[2] = {MQTT_DISCONNECT, 0x00};
-            send(mqtt_connections[i].socket_fd, disconnect_packet, 2, MSG_NOSIGNAL);
-            close(mqtt_connections[i].socket_fd);
-            mqtt_connections[i].socket_fd = -1;
-        }
-        mqtt_connections[i].is_connected = false;
+/* Caller holds the slot: say goodbye to the broker and close the socket */
+static void mqtt_close_slot(int slot) {
+    mqtt_connection_t* conn = mqtt_connection_at(slot);
+    if (conn->socket_fd >= 0) {
+        // Try to send DISCONNECT packet before closing
+        char disconnect_packet[2] = {MQTT_DISCONNECT, 0x00};
+        send(conn->socket_fd, disconnect_packet, 2, MSG_NOSIGNAL);
+        close(conn->socket_fd);
+        conn->socket_fd = -1;
     }
-    mqtt_connection_count = 0;
-    pthread_mutex_unlock(&mqtt_pool_mutex);
+    conn->is_connected = false;
+}
+
+int mqtt_set_pool_size(int max_connections) {
+    return conn_table_set_limit(&mqtt_table, max_connections);
+}
+
+int mqtt_get_pool_size(void) {
+    return conn_table_get_limit(&mqtt_table);
+}
+
+int mqtt_get_pool_in_use(void) {
+    return conn_table_get_count(&mqtt_table);
+}
+
+void mqtt_cleanup_all(void) {
+    conn_table_reset(&mqtt_table, mqtt_close_slot);
 }
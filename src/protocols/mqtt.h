@@ -12,6 +12,22 @@
 #define MAX_MQTT_USERNAME_LENGTH 256
 #define MAX_MQTT_PASSWORD_LENGTH 256
 
+// MQTT packet types (first byte of the fixed header, with any required flags)
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH     0x30
+#define MQTT_PUBACK      0x40
+#define MQTT_PUBREC      0x50
+#define MQTT_PUBREL      0x62
+#define MQTT_PUBCOMP     0x70
+#define MQTT_SUBSCRIBE   0x82
+#define MQTT_SUBACK      0x90
+#define MQTT_UNSUBSCRIBE 0xA2
+#define MQTT_UNSUBACK    0xB0
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+
 // MQTT Quality of Service levels
 typedef enum {
     MQTT_QOS_0 = 0,  // At most once delivery
@@ -75,11 +91,30 @@ int mqtt_unsubscribe(const char* host, int port, const char* client_id,
 
 int mqtt_disconnect(const char* host, int port, const char* client_id, response_t* response);
 
+// Packet builders, shared with the engine's pipelined MQTT back-end. Each
+// writes one packet to buffer and returns its length; the caller sizes
+// buffer (16 bytes plus the strings and payload is always enough).
+int mqtt_create_connect_packet(char* buffer, const char* client_id,
+                               const char* username, const char* password,
+                               int keep_alive);
+int mqtt_create_publish_packet(char* buffer, const char* topic,
+                              const char* message, size_t message_len, mqtt_qos_t qos,
+                              bool retain, uint16_t packet_id);
+int mqtt_create_subscribe_packet(char* buffer, const char* topic,
+                                mqtt_qos_t qos, uint16_t packet_id);
+
 // Helper functions
 int mqtt_parse_url(const char* url, char* host, int* port, char* client_id);
 mqtt_connection_t* mqtt_find_connection(const char* host, int port, const char* client_id);
 mqtt_connection_t* mqtt_create_connection(const char* host, int port, const char* client_id);
 
+// Pool sizing: most MQTT clients connected at once (default 50). Slots of
+// disconnected clients are reused; memory grows with the clients actually
+// connected.
+int mqtt_set_pool_size(int max_connections);
+int mqtt_get_pool_size(void);
+int mqtt_get_pool_in_use(void);
+
 // Cleanup function - closes all MQTT connections
 void mqtt_cleanup_all(void);
 
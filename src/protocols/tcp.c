@@ -1,4 +1,5 @@
 #include "tcp.h"
+#include "conn_table.h"
 #include "../common.h"
 #include <stdlib.h>
 #include <string.h>
@@ -10,14 +11,41 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
 
-// Connection pool for TCP connections
-#define MAX_TCP_CONNECTIONS 100
-static tcp_connection_t tcp_connections[MAX_TCP_CONNECTIONS];
-static int tcp_connection_count = 0;
-static pthread_mutex_t tcp_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int tcp_pool_warned = 0;
+// Connection pool for TCP connections: each slot of tcp_table stores its
+// tcp_connection_t, guarded by that slot's lock
+#define TCP_DEFAULT_POOL_SIZE 100
+static conn_table_t tcp_table = CONN_TABLE_INIT("TCP", tcp_connection_t, TCP_DEFAULT_POOL_SIZE);
+
+static tcp_connection_t* tcp_connection_at(int slot) {
+    return conn_table_entry(&tcp_table, slot);
+}
+
+static void tcp_init_connection(tcp_connection_t* conn, const char* host, int port) {
+    memset(conn, 0, sizeof(tcp_connection_t));
+    strncpy(conn->host, host, sizeof(conn->host) - 1);
+    conn->port = port;
+    conn->socket_fd = -1;
+    conn->is_connected = false;
+}
+
+/* Caller holds the slot: close the socket and unpublish its fd */
+static void tcp_close_slot(int slot) {
+    tcp_connection_t* conn = tcp_connection_at(slot);
+    if (conn->socket_fd >= 0) {
+        close(conn->socket_fd);
+        conn->socket_fd = -1;
+    }
+    conn->is_connected = false;
+    conn_table_set_fd(&tcp_table, slot, -1);
+}
+
+/* A disconnected slot can go back on the free list */
+static bool tcp_slot_idle(int slot) {
+    return !tcp_connection_at(slot)->is_connected;
+}
 
 
 int tcp_parse_url(const char* url, char* host, int* port) {
@@ -59,55 +87,21 @@ int tcp_parse_url(const char* url, char* host, int* port) {
 }
 
 tcp_connection_t* tcp_find_connection(const char* host, int port) {
-    pthread_mutex_lock(&tcp_pool_mutex);
-    tcp_connection_t* result = NULL;
-    for (int i = 0; i < tcp_connection_count; i++) {
-        if (strcmp(tcp_connections[i].host, host) == 0 && tcp_connections[i].port == port) {
-            result = &tcp_connections[i];
-            break;
-        }
-    }
-    pthread_mutex_unlock(&tcp_pool_mutex);
-    return result;
+    int slot = conn_table_find(&tcp_table, host, port, NULL);
+    return slot >= 0 ? tcp_connection_at(slot) : NULL;
 }
 
 tcp_connection_t* tcp_create_connection(const char* host, int port) {
-    pthread_mutex_lock(&tcp_pool_mutex);
-    if (tcp_connection_count >= MAX_TCP_CONNECTIONS) {
-        if (!tcp_pool_warned) {
-            fprintf(stderr, "[LoadSpiker] TCP pool full — increase MAX_TCP_CONNECTIONS\n");
-            tcp_pool_warned = 1;
-        }
-        pthread_mutex_unlock(&tcp_pool_mutex);
-        return NULL;
-    }
-
-    tcp_connection_t* conn = &tcp_connections[tcp_connection_count++];
-    memset(conn, 0, sizeof(tcp_connection_t));
-
-    strncpy(conn->host, host, sizeof(conn->host) - 1);
-    conn->port = port;
-    conn->socket_fd = -1;
-    conn->is_connected = false;
-
-    pthread_mutex_unlock(&tcp_pool_mutex);
-    return conn;
+    bool created = false;
+    int slot = conn_table_acquire(&tcp_table, host, port, NULL, true, &created);
+    if (slot < 0) return NULL;
+    if (created) tcp_init_connection(tcp_connection_at(slot), host, port);
+    conn_table_release(&tcp_table, slot);
+    return tcp_connection_at(slot);
 }
 
 int tcp_lookup_by_fd(int socket_fd, char* host_out, int* port_out) {
-    pthread_mutex_lock(&tcp_pool_mutex);
-    int found = 0;
-    for (int i = 0; i < tcp_connection_count; i++) {
-        if (tcp_connections[i].socket_fd == socket_fd && tcp_connections[i].is_connected) {
-            strncpy(host_out, tcp_connections[i].host, 255);
-            host_out[255] = '\0';
-            *port_out = tcp_connections[i].port;
-            found = 1;
-            break;
-        }
-    }
-    pthread_mutex_unlock(&tcp_pool_mutex);
-    return found ? 0 : -1;
+    return conn_table_find_fd(&tcp_table, socket_fd, host_out, port_out);
 }
 
 int tcp_connect(const char* host, int port, response_t* response) {
@@ -115,52 +109,33 @@ int tcp_connect(const char* host, int port, response_t* response) {
         return -1;
     }
 
-    pthread_mutex_lock(&tcp_pool_mutex);
-
     // Initialize response
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_TCP;
     uint64_t start_time = get_time_us();
 
-    // Check if connection already exists
-    tcp_connection_t* conn = NULL;
-    for (int i = 0; i < tcp_connection_count; i++) {
-        if (strcmp(tcp_connections[i].host, host) == 0 && tcp_connections[i].port == port) {
-            conn = &tcp_connections[i];
-            break;
-        }
+    // Find or create the connection; its slot stays locked until we return
+    bool created = false;
+    int slot = conn_table_acquire(&tcp_table, host, port, NULL, true, &created);
+    if (slot < 0) {
+        response->success = false;
+        response->status_code = 500;
+        strcpy(response->error_message, "Too many TCP connections");
+        response->response_time_us = get_time_us() - start_time;
+        return -1;
     }
-    if (conn && conn->is_connected) {
+    tcp_connection_t* conn = tcp_connection_at(slot);
+    if (created) tcp_init_connection(conn, host, port);
+
+    if (conn->is_connected) {
         response->success = true;
         response->status_code = 200;
         snprintf(response->body, sizeof(response->body), "TCP connection already established to %s:%d", host, port);
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        conn_table_release(&tcp_table, slot);
         return 0;
     }
 
-    // Create new connection if needed
-    if (!conn) {
-        if (tcp_connection_count >= MAX_TCP_CONNECTIONS) {
-            if (!tcp_pool_warned) {
-                fprintf(stderr, "[LoadSpiker] TCP pool full — increase MAX_TCP_CONNECTIONS\n");
-                tcp_pool_warned = 1;
-            }
-            response->success = false;
-            response->status_code = 500;
-            strcpy(response->error_message, "Too many TCP connections");
-            response->response_time_us = get_time_us() - start_time;
-            pthread_mutex_unlock(&tcp_pool_mutex);
-            return -1;
-        }
-        conn = &tcp_connections[tcp_connection_count++];
-        memset(conn, 0, sizeof(tcp_connection_t));
-        strncpy(conn->host, host, sizeof(conn->host) - 1);
-        conn->port = port;
-        conn->socket_fd = -1;
-        conn->is_connected = false;
-    }
-
     // Create socket
     conn->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (conn->socket_fd < 0) {
@@ -169,7 +144,7 @@ int tcp_connect(const char* host, int port, response_t* response) {
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to create socket: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        conn_table_retire(&tcp_table, slot, tcp_slot_idle);
         return -1;
     }
 
@@ -189,7 +164,7 @@ int tcp_connect(const char* host, int port, response_t* response) {
         snprintf(response->error_message, sizeof(response->error_message),
                 "DNS resolution failed for %s: %s", host, gai_strerror(gai_err));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        conn_table_retire(&tcp_table, slot, tcp_slot_idle);
         return -1;
     }
 
@@ -209,21 +184,16 @@ int tcp_connect(const char* host, int port, response_t* response) {
         snprintf(response->error_message, sizeof(response->error_message),
                 "Connection failed: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        conn_table_retire(&tcp_table, slot, tcp_slot_idle);
         return -1;
     }
 
-    // Wait for connection to complete (with timeout)
-    fd_set write_fds;
-    struct timeval timeout;
-    FD_ZERO(&write_fds);
-    FD_SET(conn->socket_fd, &write_fds);
-    timeout.tv_sec = 5;  // 5 second timeout
-    timeout.tv_usec = 0;
+    // Wait for connection to complete (with timeout). poll() rather than
+    // select(): pooled descriptors can be past FD_SETSIZE.
+    struct pollfd pfd = {.fd = conn->socket_fd, .events = POLLOUT, .revents = 0};
+    int poll_result = poll(&pfd, 1, 5000);  // 5 second timeout
 
-    int select_result = select(conn->socket_fd + 1, NULL, &write_fds, NULL, &timeout);
-
-    if (select_result <= 0) {
+    if (poll_result <= 0) {
         freeaddrinfo(res);
         close(conn->socket_fd);
         conn->socket_fd = -1;
@@ -231,7 +201,7 @@ int tcp_connect(const char* host, int port, response_t* response) {
         response->status_code = 408;
         strcpy(response->error_message, "Connection timeout");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        conn_table_retire(&tcp_table, slot, tcp_slot_idle);
         return -1;
     }
 
@@ -247,7 +217,7 @@ int tcp_connect(const char* host, int port, response_t* response) {
         snprintf(response->error_message, sizeof(response->error_message),
                 "Connection failed: %s", strerror(socket_error));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        conn_table_retire(&tcp_table, slot, tcp_slot_idle);
         return -1;
     }
 
@@ -257,6 +227,19 @@ int tcp_connect(const char* host, int port, response_t* response) {
     // DNS result no longer needed after successful connect
     freeaddrinfo(res);
 
+    // Publish the socket for tcp_lookup_by_fd(); an unindexed one is a failed connect
+    if (conn_table_set_fd(&tcp_table, slot, conn->socket_fd) != 0) {
+        close(conn->socket_fd);
+        conn->socket_fd = -1;
+        response->success = false;
+        response->status_code = 500;
+        snprintf(response->error_message, sizeof(response->error_message),
+                "Connection failed: %s", strerror(errno));
+        response->response_time_us = get_time_us() - start_time;
+        conn_table_retire(&tcp_table, slot, tcp_slot_idle);
+        return -1;
+    }
+
     // Connection successful
     conn->is_connected = true;
     response->success = true;
@@ -271,7 +254,7 @@ int tcp_connect(const char* host, int port, response_t* response) {
 
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&tcp_pool_mutex);
+    conn_table_release(&tcp_table, slot);
     return 0;
 }
 
@@ -280,27 +263,20 @@ int tcp_send(const char* host, int port, const char* data, response_t* response)
         return -1;
     }
 
-    pthread_mutex_lock(&tcp_pool_mutex);
-
     // Initialize response
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_TCP;
     uint64_t start_time = get_time_us();
 
-    // Find existing connection
-    tcp_connection_t* conn = NULL;
-    for (int i = 0; i < tcp_connection_count; i++) {
-        if (strcmp(tcp_connections[i].host, host) == 0 && tcp_connections[i].port == port) {
-            conn = &tcp_connections[i];
-            break;
-        }
-    }
+    // Find existing connection and hold it for the whole operation
+    int slot = conn_table_acquire(&tcp_table, host, port, NULL, false, NULL);
+    tcp_connection_t* conn = slot >= 0 ? tcp_connection_at(slot) : NULL;
     if (!conn || !conn->is_connected) {
         response->success = false;
         response->status_code = 400;
         strcpy(response->error_message, "No active TCP connection");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        if (conn) conn_table_release(&tcp_table, slot);
         return -1;
     }
 
@@ -319,7 +295,7 @@ int tcp_send(const char* host, int port, const char* data, response_t* response)
             snprintf(response->error_message, sizeof(response->error_message),
                     "Send failed after %zu bytes: %s", total_sent, strerror(errno));
             response->response_time_us = get_time_us() - start_time;
-            pthread_mutex_unlock(&tcp_pool_mutex);
+            conn_table_release(&tcp_table, slot);
             return -1;
         }
         total_sent += (size_t)bytes_sent;
@@ -336,7 +312,7 @@ int tcp_send(const char* host, int port, const char* data, response_t* response)
 
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&tcp_pool_mutex);
+    conn_table_release(&tcp_table, slot);
     return 0;
 }
 
@@ -345,27 +321,20 @@ int tcp_receive(const char* host, int port, response_t* response) {
         return -1;
     }
 
-    pthread_mutex_lock(&tcp_pool_mutex);
-
     // Initialize response
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_TCP;
     uint64_t start_time = get_time_us();
 
-    // Find existing connection
-    tcp_connection_t* conn = NULL;
-    for (int i = 0; i < tcp_connection_count; i++) {
-        if (strcmp(tcp_connections[i].host, host) == 0 && tcp_connections[i].port == port) {
-            conn = &tcp_connections[i];
-            break;
-        }
-    }
+    // Find existing connection and hold it for the whole operation
+    int slot = conn_table_acquire(&tcp_table, host, port, NULL, false, NULL);
+    tcp_connection_t* conn = slot >= 0 ? tcp_connection_at(slot) : NULL;
     if (!conn || !conn->is_connected) {
         response->success = false;
         response->status_code = 400;
         strcpy(response->error_message, "No active TCP connection");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        if (conn) conn_table_release(&tcp_table, slot);
         return -1;
     }
 
@@ -374,22 +343,16 @@ int tcp_receive(const char* host, int port, response_t* response) {
     fcntl(conn->socket_fd, F_SETFL, flags | O_NONBLOCK);
 
     // Wait for data with timeout
-    fd_set read_fds;
-    struct timeval timeout;
-    FD_ZERO(&read_fds);
-    FD_SET(conn->socket_fd, &read_fds);
-    timeout.tv_sec = 5;  // 5 second timeout per CONTEXT.md
-    timeout.tv_usec = 0;
+    struct pollfd pfd = {.fd = conn->socket_fd, .events = POLLIN, .revents = 0};
+    int poll_result = poll(&pfd, 1, 5000);  // 5 second timeout per CONTEXT.md
 
-    int select_result = select(conn->socket_fd + 1, &read_fds, NULL, NULL, &timeout);
-
-    if (select_result <= 0) {
+    if (poll_result <= 0) {
         fcntl(conn->socket_fd, F_SETFL, flags);
         response->success = true;
         response->status_code = 204;
         strcpy(response->body, "No data available");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        conn_table_release(&tcp_table, slot);
         return 0;
     }
 
@@ -406,20 +369,18 @@ int tcp_receive(const char* host, int port, response_t* response) {
         snprintf(response->error_message, sizeof(response->error_message),
                 "Receive failed: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        conn_table_release(&tcp_table, slot);
         return -1;
     }
 
     if (bytes_received == 0) {
         // Connection closed by peer
-        conn->is_connected = false;
-        close(conn->socket_fd);
-        conn->socket_fd = -1;
+        tcp_close_slot(slot);
         response->success = false;
         response->status_code = 410;
         strcpy(response->error_message, "Connection closed by peer");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        conn_table_retire(&tcp_table, slot, tcp_slot_idle);
         return -1;
     }
 
@@ -435,7 +396,7 @@ int tcp_receive(const char* host, int port, response_t* response) {
 
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&tcp_pool_mutex);
+    conn_table_release(&tcp_table, slot);
     return 0;
 }
 
@@ -444,27 +405,20 @@ int tcp_disconnect(const char* host, int port, response_t* response) {
         return -1;
     }
 
-    pthread_mutex_lock(&tcp_pool_mutex);
-
     // Initialize response
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_TCP;
     uint64_t start_time = get_time_us();
 
-    // Find existing connection
-    tcp_connection_t* conn = NULL;
-    for (int i = 0; i < tcp_connection_count; i++) {
-        if (strcmp(tcp_connections[i].host, host) == 0 && tcp_connections[i].port == port) {
-            conn = &tcp_connections[i];
-            break;
-        }
-    }
+    // Find existing connection and hold it for the whole operation
+    int slot = conn_table_acquire(&tcp_table, host, port, NULL, false, NULL);
+    tcp_connection_t* conn = slot >= 0 ? tcp_connection_at(slot) : NULL;
     if (!conn || !conn->is_connected) {
         response->success = false;
         response->status_code = 400;
         strcpy(response->error_message, "No active TCP connection to disconnect");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&tcp_pool_mutex);
+        if (conn) conn_table_release(&tcp_table, slot);
         return -1;
     }
 
@@ -484,6 +438,7 @@ int tcp_disconnect(const char* host, int port, response_t* response) {
     }
 
     conn->is_connected = false;
+    conn_table_set_fd(&tcp_table, slot, -1);
 
     response->success = true;
     response->status_code = 200;
@@ -491,19 +446,22 @@ int tcp_disconnect(const char* host, int port, response_t* response) {
             "TCP connection to %s:%d closed successfully", host, port);
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&tcp_pool_mutex);
+    conn_table_retire(&tcp_table, slot, tcp_slot_idle);
     return 0;
 }
 
+int tcp_set_pool_size(int max_connections) {
+    return conn_table_set_limit(&tcp_table, max_connections);
+}
+
+int tcp_get_pool_size(void) {
+    return conn_table_get_limit(&tcp_table);
+}
+
+int tcp_get_pool_in_use(void) {
+    return conn_table_get_count(&tcp_table);
+}
+
 void tcp_cleanup_all(void) {
-    pthread_mutex_lock(&tcp_pool_mutex);
-    for (int i = 0; i < tcp_connection_count; i++) {
-        if (tcp_connections[i].socket_fd >= 0) {
-            close(tcp_connections[i].socket_fd);
-            tcp_connections[i].socket_fd = -1;
-        }
-        tcp_connections[i].is_connected = false;
-    }
-    tcp_connection_count = 0;
-    pthread_mutex_unlock(&tcp_pool_mutex);
+    conn_table_reset(&tcp_table, tcp_close_slot);
 }
@@ -35,6 +35,13 @@ tcp_connection_t* tcp_find_connection(const char* host, int port);
 tcp_connection_t* tcp_create_connection(const char* host, int port);
 int tcp_lookup_by_fd(int socket_fd, char* host_out, int* port_out);
 
+// Pool sizing: most TCP connections open at once (default 100). Slots of
+// disconnected connections are reused; memory grows with the connections
+// actually opened.
+int tcp_set_pool_size(int max_connections);
+int tcp_get_pool_size(void);
+int tcp_get_pool_in_use(void);
+
 // Cleanup function - closes all TCP connections
 void tcp_cleanup_all(void);
 
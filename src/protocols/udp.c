@@ -1,4 +1,8 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   /* sendmmsg, recvmmsg */
+#endif
 #include "udp.h"
+#include "conn_table.h"
 #include "../common.h"
 #include <stdlib.h>
 #include <string.h>
@@ -10,15 +14,53 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
 
-// Endpoint pool for UDP endpoints
-#define MAX_UDP_ENDPOINTS 100
-static udp_endpoint_t udp_endpoints[MAX_UDP_ENDPOINTS];
-static int udp_endpoint_count = 0;
-static pthread_mutex_t udp_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int udp_pool_warned = 0;
+// Endpoint pool for UDP endpoints: each slot of udp_table stores its
+// udp_endpoint_t, guarded by that slot's lock
+#define UDP_DEFAULT_POOL_SIZE 100
+static conn_table_t udp_table = CONN_TABLE_INIT("UDP", udp_endpoint_t, UDP_DEFAULT_POOL_SIZE);
 
+static udp_endpoint_t* udp_endpoint_at(int slot) {
+    return conn_table_entry(&udp_table, slot);
+}
+
+static void udp_init_endpoint(udp_endpoint_t* endpoint, const char* host, int port) {
+    memset(endpoint, 0, sizeof(udp_endpoint_t));
+    strncpy(endpoint->host, host, sizeof(endpoint->host) - 1);
+    endpoint->port = port;
+    endpoint->socket_fd = -1;
+    endpoint->is_bound = false;
+}
+
+/* Caller holds the slot: close the socket and unpublish its fd */
+static void udp_close_slot(int slot) {
+    udp_endpoint_t* endpoint = udp_endpoint_at(slot);
+    if (endpoint->socket_fd >= 0) {
+        close(endpoint->socket_fd);
+        endpoint->socket_fd = -1;
+    }
+    endpoint->is_bound = false;
+    conn_table_set_fd(&udp_table, slot, -1);
+}
+
+/* A closed endpoint can go back on the free list */
+static bool udp_slot_idle(int slot) {
+    return !udp_endpoint_at(slot)->is_bound;
+}
+
+/* For receiving, bind the endpoint to its own port. This fails harmlessly
+   once the socket has sent, as it is then bound to an ephemeral port that
+   the peer replies to. */
+static void udp_bind_for_receive(int socket_fd, int port) {
+    struct sockaddr_in local_addr;
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_addr.s_addr = INADDR_ANY;
+    local_addr.sin_port = htons(port);
+    (void)bind(socket_fd, (struct sockaddr*)&local_addr, sizeof(local_addr));
+}
 
 int udp_parse_url(const char* url, char* host, int* port) {
     if (!url || !host || !port) {
@@ -59,55 +101,21 @@ int udp_parse_url(const char* url, char* host, int* port) {
 }
 
 udp_endpoint_t* udp_find_endpoint(const char* host, int port) {
-    pthread_mutex_lock(&udp_pool_mutex);
-    udp_endpoint_t* result = NULL;
-    for (int i = 0; i < udp_endpoint_count; i++) {
-        if (strcmp(udp_endpoints[i].host, host) == 0 && udp_endpoints[i].port == port) {
-            result = &udp_endpoints[i];
-            break;
-        }
-    }
-    pthread_mutex_unlock(&udp_pool_mutex);
-    return result;
+    int slot = conn_table_find(&udp_table, host, port, NULL);
+    return slot >= 0 ? udp_endpoint_at(slot) : NULL;
 }
 
 udp_endpoint_t* udp_create_endpoint_struct(const char* host, int port) {
-    pthread_mutex_lock(&udp_pool_mutex);
-    if (udp_endpoint_count >= MAX_UDP_ENDPOINTS) {
-        if (!udp_pool_warned) {
-            fprintf(stderr, "[LoadSpiker] UDP pool full — increase MAX_UDP_ENDPOINTS\n");
-            udp_pool_warned = 1;
-        }
-        pthread_mutex_unlock(&udp_pool_mutex);
-        return NULL;
-    }
-
-    udp_endpoint_t* endpoint = &udp_endpoints[udp_endpoint_count++];
-    memset(endpoint, 0, sizeof(udp_endpoint_t));
-
-    strncpy(endpoint->host, host, sizeof(endpoint->host) - 1);
-    endpoint->port = port;
-    endpoint->socket_fd = -1;
-    endpoint->is_bound = false;
-
-    pthread_mutex_unlock(&udp_pool_mutex);
-    return endpoint;
+    bool created = false;
+    int slot = conn_table_acquire(&udp_table, host, port, NULL, true, &created);
+    if (slot < 0) return NULL;
+    if (created) udp_init_endpoint(udp_endpoint_at(slot), host, port);
+    conn_table_release(&udp_table, slot);
+    return udp_endpoint_at(slot);
 }
 
 int udp_lookup_by_fd(int socket_fd, char* host_out, int* port_out) {
-    pthread_mutex_lock(&udp_pool_mutex);
-    int found = 0;
-    for (int i = 0; i < udp_endpoint_count; i++) {
-        if (udp_endpoints[i].socket_fd == socket_fd && udp_endpoints[i].is_bound) {
-            strncpy(host_out, udp_endpoints[i].host, 255);
-            host_out[255] = '\0';
-            *port_out = udp_endpoints[i].port;
-            found = 1;
-            break;
-        }
-    }
-    pthread_mutex_unlock(&udp_pool_mutex);
-    return found ? 0 : -1;
+    return conn_table_find_fd(&udp_table, socket_fd, host_out, port_out);
 }
 
 int udp_create_endpoint(const char* host, int port, response_t* response) {
@@ -115,52 +123,33 @@ int udp_create_endpoint(const char* host, int port, response_t* response) {
         return -1;
     }
 
-    pthread_mutex_lock(&udp_pool_mutex);
-
     // Initialize response
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_UDP;
     uint64_t start_time = get_time_us();
 
-    // Check if endpoint already exists
-    udp_endpoint_t* endpoint = NULL;
-    for (int i = 0; i < udp_endpoint_count; i++) {
-        if (strcmp(udp_endpoints[i].host, host) == 0 && udp_endpoints[i].port == port) {
-            endpoint = &udp_endpoints[i];
-            break;
-        }
+    // Find or create the endpoint; its slot stays locked until we return
+    bool created = false;
+    int slot = conn_table_acquire(&udp_table, host, port, NULL, true, &created);
+    if (slot < 0) {
+        response->success = false;
+        response->status_code = 500;
+        strcpy(response->error_message, "Too many UDP endpoints");
+        response->response_time_us = get_time_us() - start_time;
+        return -1;
     }
-    if (endpoint && endpoint->is_bound) {
+    udp_endpoint_t* endpoint = udp_endpoint_at(slot);
+    if (created) udp_init_endpoint(endpoint, host, port);
+
+    if (endpoint->is_bound) {
         response->success = true;
         response->status_code = 200;
         snprintf(response->body, sizeof(response->body), "UDP endpoint already created for %s:%d", host, port);
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&udp_pool_mutex);
+        conn_table_release(&udp_table, slot);
         return 0;
     }
 
-    // Create new endpoint if needed
-    if (!endpoint) {
-        if (udp_endpoint_count >= MAX_UDP_ENDPOINTS) {
-            if (!udp_pool_warned) {
-                fprintf(stderr, "[LoadSpiker] UDP pool full — increase MAX_UDP_ENDPOINTS\n");
-                udp_pool_warned = 1;
-            }
-            response->success = false;
-            response->status_code = 500;
-            strcpy(response->error_message, "Too many UDP endpoints");
-            response->response_time_us = get_time_us() - start_time;
-            pthread_mutex_unlock(&udp_pool_mutex);
-            return -1;
-        }
-        endpoint = &udp_endpoints[udp_endpoint_count++];
-        memset(endpoint, 0, sizeof(udp_endpoint_t));
-        strncpy(endpoint->host, host, sizeof(endpoint->host) - 1);
-        endpoint->port = port;
-        endpoint->socket_fd = -1;
-        endpoint->is_bound = false;
-    }
-
     // Create UDP socket
     endpoint->socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
     if (endpoint->socket_fd < 0) {
@@ -169,7 +158,7 @@ int udp_create_endpoint(const char* host, int port, response_t* response) {
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to create UDP socket: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&udp_pool_mutex);
+        conn_table_retire(&udp_table, slot, udp_slot_idle);
         return -1;
     }
 
@@ -183,7 +172,20 @@ int udp_create_endpoint(const char* host, int port, response_t* response) {
         snprintf(response->error_message, sizeof(response->error_message),
                 "Failed to set socket options: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&udp_pool_mutex);
+        conn_table_retire(&udp_table, slot, udp_slot_idle);
+        return -1;
+    }
+
+    // Publish the socket for udp_lookup_by_fd(); an unindexed one is a failed create
+    if (conn_table_set_fd(&udp_table, slot, endpoint->socket_fd) != 0) {
+        close(endpoint->socket_fd);
+        endpoint->socket_fd = -1;
+        response->success = false;
+        response->status_code = 500;
+        snprintf(response->error_message, sizeof(response->error_message),
+                "Failed to create UDP socket: %s", strerror(errno));
+        response->response_time_us = get_time_us() - start_time;
+        conn_table_retire(&udp_table, slot, udp_slot_idle);
         return -1;
     }
 
@@ -205,80 +207,89 @@ int udp_create_endpoint(const char* host, int port, response_t* response) {
 
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&udp_pool_mutex);
+    conn_table_release(&udp_table, slot);
     return 0;
 }
 
-int udp_send(const char* host, int port, const char* data, response_t* response) {
-    if (!host || port <= 0 || !data || !response) {
+// Resolve host:port (thread-safe getaddrinfo) before touching the pool, so a
+// slow lookup holds no lock at all, then find its endpoint, auto-creating one
+// and its socket for sending. Returns the held slot and sets *res_out, or
+// fills in response and returns -1.
+static int udp_acquire_for_send(const char* host, int port, struct addrinfo** res_out,
+                                response_t* response, uint64_t start_time) {
+    char port_str[12];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    int gai_err = getaddrinfo(host, port_str, &hints, &res);
+    if (gai_err != 0) {
+        response->success = false;
+        response->status_code = 404;
+        snprintf(response->error_message, sizeof(response->error_message),
+                "DNS resolution failed for %s: %s", host, gai_strerror(gai_err));
+        response->response_time_us = get_time_us() - start_time;
         return -1;
     }
 
-    pthread_mutex_lock(&udp_pool_mutex);
-
-    // Initialize response
-    memset(response, 0, sizeof(response_t));
-    response->protocol = PROTOCOL_UDP;
-    uint64_t start_time = get_time_us();
-
-    // Find or check endpoint
-    udp_endpoint_t* endpoint = NULL;
-    for (int i = 0; i < udp_endpoint_count; i++) {
-        if (strcmp(udp_endpoints[i].host, host) == 0 && udp_endpoints[i].port == port) {
-            endpoint = &udp_endpoints[i];
-            break;
-        }
+    bool created = false;
+    int slot = conn_table_acquire(&udp_table, host, port, NULL, true, &created);
+    if (slot < 0) {
+        freeaddrinfo(res);
+        response->success = false;
+        response->status_code = 500;
+        strcpy(response->error_message, "Too many UDP endpoints");
+        response->response_time_us = get_time_us() - start_time;
+        return -1;
     }
+    udp_endpoint_t* endpoint = udp_endpoint_at(slot);
+    if (created) udp_init_endpoint(endpoint, host, port);
 
-    if (!endpoint || !endpoint->is_bound) {
-        // Auto-create endpoint for sending (inline, since we hold the lock)
-        if (udp_endpoint_count >= MAX_UDP_ENDPOINTS) {
-            if (!udp_pool_warned) {
-                fprintf(stderr, "[LoadSpiker] UDP pool full — increase MAX_UDP_ENDPOINTS\n");
-                udp_pool_warned = 1;
-            }
+    if (!endpoint->is_bound) {
+        endpoint->socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (endpoint->socket_fd < 0) {
+            freeaddrinfo(res);
             response->success = false;
-            response->status_code = 500;
-            strcpy(response->error_message, "Too many UDP endpoints");
+            response->status_code = 400;
+            strcpy(response->error_message, "Failed to create UDP endpoint");
             response->response_time_us = get_time_us() - start_time;
-            pthread_mutex_unlock(&udp_pool_mutex);
+            conn_table_retire(&udp_table, slot, udp_slot_idle);
             return -1;
         }
-        endpoint = &udp_endpoints[udp_endpoint_count++];
-        memset(endpoint, 0, sizeof(udp_endpoint_t));
-        strncpy(endpoint->host, host, sizeof(endpoint->host) - 1);
-        endpoint->port = port;
-        endpoint->socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
-        if (endpoint->socket_fd < 0) {
-            udp_endpoint_count--;
+        if (conn_table_set_fd(&udp_table, slot, endpoint->socket_fd) != 0) {
+            close(endpoint->socket_fd);
+            endpoint->socket_fd = -1;
+            freeaddrinfo(res);
             response->success = false;
             response->status_code = 400;
             strcpy(response->error_message, "Failed to create UDP endpoint");
             response->response_time_us = get_time_us() - start_time;
-            pthread_mutex_unlock(&udp_pool_mutex);
+            conn_table_retire(&udp_table, slot, udp_slot_idle);
             return -1;
         }
         endpoint->is_bound = true;
     }
 
-    // Resolve hostname (thread-safe getaddrinfo)
-    char port_str[8];
-    snprintf(port_str, sizeof(port_str), "%d", port);
-    struct addrinfo hints, *res;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_DGRAM;
-    int gai_err = getaddrinfo(host, port_str, &hints, &res);
-    if (gai_err != 0) {
-        response->success = false;
-        response->status_code = 404;
-        snprintf(response->error_message, sizeof(response->error_message),
-                "DNS resolution failed for %s: %s", host, gai_strerror(gai_err));
-        response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&udp_pool_mutex);
+    *res_out = res;
+    return slot;
+}
+
+int udp_send(const char* host, int port, const char* data, response_t* response) {
+    if (!host || port <= 0 || !data || !response) {
         return -1;
     }
 
+    // Initialize response
+    memset(response, 0, sizeof(response_t));
+    response->protocol = PROTOCOL_UDP;
+    uint64_t start_time = get_time_us();
+
+    struct addrinfo* res;
+    int slot = udp_acquire_for_send(host, port, &res, response, start_time);
+    if (slot < 0) return -1;
+    udp_endpoint_t* endpoint = udp_endpoint_at(slot);
+
     // Send UDP datagram
     size_t data_len = strlen(data);
     ssize_t bytes_sent = sendto(endpoint->socket_fd, data, data_len, 0,
@@ -291,7 +302,7 @@ int udp_send(const char* host, int port, const char* data, response_t* response)
         snprintf(response->error_message, sizeof(response->error_message),
                 "UDP send failed: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&udp_pool_mutex);
+        conn_table_release(&udp_table, slot);
         return -1;
     }
 
@@ -310,7 +321,7 @@ int udp_send(const char* host, int port, const char* data, response_t* response)
 
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&udp_pool_mutex);
+    conn_table_release(&udp_table, slot);
     return 0;
 }
 
@@ -319,64 +330,41 @@ int udp_receive(const char* host, int port, response_t* response) {
         return -1;
     }
 
-    pthread_mutex_lock(&udp_pool_mutex);
-
     // Initialize response
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_UDP;
     uint64_t start_time = get_time_us();
 
-    // Find existing endpoint
-    udp_endpoint_t* endpoint = NULL;
-    for (int i = 0; i < udp_endpoint_count; i++) {
-        if (strcmp(udp_endpoints[i].host, host) == 0 && udp_endpoints[i].port == port) {
-            endpoint = &udp_endpoints[i];
-            break;
-        }
-    }
+    // Find existing endpoint and hold it for the whole operation
+    int slot = conn_table_acquire(&udp_table, host, port, NULL, false, NULL);
+    udp_endpoint_t* endpoint = slot >= 0 ? udp_endpoint_at(slot) : NULL;
     if (!endpoint || !endpoint->is_bound) {
         response->success = false;
         response->status_code = 400;
         strcpy(response->error_message, "No UDP endpoint available");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&udp_pool_mutex);
+        if (endpoint) conn_table_release(&udp_table, slot);
         return -1;
     }
 
-    // For receiving, we need to bind to the local port
-    struct sockaddr_in local_addr;
-    memset(&local_addr, 0, sizeof(local_addr));
-    local_addr.sin_family = AF_INET;
-    local_addr.sin_addr.s_addr = INADDR_ANY;
-    local_addr.sin_port = htons(port);
-
-    // Try to bind if not already bound to this port
-    if (bind(endpoint->socket_fd, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
-        // Binding failed, but socket might already be in use for sending
-        // Continue with receive attempt
-    }
+    udp_bind_for_receive(endpoint->socket_fd, port);
 
     // Set socket to non-blocking for timeout control
     int flags = fcntl(endpoint->socket_fd, F_GETFL, 0);
     fcntl(endpoint->socket_fd, F_SETFL, flags | O_NONBLOCK);
 
-    // Wait for data with timeout
-    fd_set read_fds;
-    struct timeval timeout;
-    FD_ZERO(&read_fds);
-    FD_SET(endpoint->socket_fd, &read_fds);
-    timeout.tv_sec = 5;  // 5 second timeout per CONTEXT.md
-    timeout.tv_usec = 0;
-
-    int select_result = select(endpoint->socket_fd + 1, &read_fds, NULL, NULL, &timeout);
+    // Wait for data with timeout. poll() rather than select(): pooled
+    // descriptors can be past FD_SETSIZE.
+    struct pollfd pfd = {.fd = endpoint->socket_fd, .events = POLLIN, .revents = 0};
+    int poll_result = poll(&pfd, 1, 5000);  // 5 second timeout per CONTEXT.md
 
-    if (select_result <= 0) {
+    if (poll_result <= 0) {
         fcntl(endpoint->socket_fd, F_SETFL, flags);
         response->success = true;
         response->status_code = 204;
         strcpy(response->body, "No UDP data available");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&udp_pool_mutex);
+        conn_table_release(&udp_table, slot);
         return 0;
     }
 
@@ -397,7 +385,7 @@ int udp_receive(const char* host, int port, response_t* response) {
         snprintf(response->error_message, sizeof(response->error_message),
                 "UDP receive failed: %s", strerror(errno));
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&udp_pool_mutex);
+        conn_table_release(&udp_table, slot);
         return -1;
     }
 
@@ -421,36 +409,250 @@ int udp_receive(const char* host, int port, response_t* response) {
 
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&udp_pool_mutex);
+    conn_table_release(&udp_table, slot);
     return 0;
 }
 
-int udp_close_endpoint(const char* host, int port, response_t* response) {
-    if (!host || port <= 0 || !response) {
+/* Send datagrams[0..count) through one system call per UDP_BATCH_MAX;
+   returns how many went out before the first failure */
+static int udp_sendmmsg_all(int socket_fd, const udp_datagram_t* datagrams, int count,
+                            const struct sockaddr* addr, socklen_t addr_len, size_t* bytes_out, int* err_out) {
+    int sent = 0;
+    *bytes_out = 0;
+    *err_out = 0;
+#ifdef __linux__
+    struct mmsghdr msgs[UDP_BATCH_MAX];
+    struct iovec iovs[UDP_BATCH_MAX];
+    while (sent < count) {
+        int n = count - sent < UDP_BATCH_MAX ? count - sent : UDP_BATCH_MAX;
+        memset(msgs, 0, sizeof(struct mmsghdr) * (size_t)n);
+        for (int i = 0; i < n; i++) {
+            iovs[i].iov_base = (void*)datagrams[sent + i].data;
+            iovs[i].iov_len = datagrams[sent + i].len;
+            msgs[i].msg_hdr.msg_name = (void*)addr;
+            msgs[i].msg_hdr.msg_namelen = addr_len;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int done = sendmmsg(socket_fd, msgs, (unsigned int)n, 0);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) {
+            *err_out = done < 0 ? errno : EIO;
+            break;
+        }
+        for (int i = 0; i < done; i++) *bytes_out += msgs[i].msg_len;
+        sent += done;
+    }
+#else
+    while (sent < count) {
+        ssize_t n = sendto(socket_fd, datagrams[sent].data, datagrams[sent].len, 0, addr, addr_len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            *err_out = errno;
+            break;
+        }
+        *bytes_out += (size_t)n;
+        sent++;
+    }
+#endif
+    return sent;
+}
+
+int udp_send_batch(const char* host, int port, const udp_datagram_t* datagrams, int count, response_t* response) {
+    if (!host || port <= 0 || !datagrams || count <= 0 || !response) {
         return -1;
     }
 
-    pthread_mutex_lock(&udp_pool_mutex);
+    // Initialize response
+    memset(response, 0, sizeof(response_t));
+    response->protocol = PROTOCOL_UDP;
+    uint64_t start_time = get_time_us();
+
+    for (int i = 0; i < count; i++) {
+        if (!datagrams[i].data && datagrams[i].len > 0) {
+            response->success = false;
+            response->status_code = 400;
+            strcpy(response->error_message, "Datagram without data");
+            response->response_time_us = get_time_us() - start_time;
+            return -1;
+        }
+    }
+
+    // Resolve once for the whole batch
+    struct addrinfo* res;
+    int slot = udp_acquire_for_send(host, port, &res, response, start_time);
+    if (slot < 0) return -1;
+    udp_endpoint_t* endpoint = udp_endpoint_at(slot);
+
+    size_t bytes_sent = 0;
+    int err = 0;
+    int sent = udp_sendmmsg_all(endpoint->socket_fd, datagrams, count, res->ai_addr, res->ai_addrlen,
+                                &bytes_sent, &err);
+    freeaddrinfo(res);
+
+    udp_response_data_t* udp_data = &response->protocol_data.udp;
+    udp_data->socket_fd = endpoint->socket_fd;
+    udp_data->bytes_sent = bytes_sent;
+    strncpy(udp_data->sender_address, host, sizeof(udp_data->sender_address) - 1);
+    udp_data->sender_port = port;
+
+    if (sent < count) {
+        response->success = false;
+        response->status_code = 500;
+        snprintf(response->error_message, sizeof(response->error_message),
+                "UDP batch send stopped after %d of %d datagrams: %s", sent, count, strerror(err));
+    } else {
+        response->success = true;
+        response->status_code = 200;
+        snprintf(response->body, sizeof(response->body),
+                "Sent %d datagrams (%zu bytes) to %s:%d via UDP", sent, bytes_sent, host, port);
+    }
+    response->response_time_us = get_time_us() - start_time;
+
+    conn_table_release(&udp_table, slot);
+    return sent > 0 ? sent : -1;
+}
+
+static void udp_message_sender(udp_message_t* message, const struct sockaddr_in* addr) {
+    inet_ntop(AF_INET, &addr->sin_addr, message->sender_address, sizeof(message->sender_address));
+    message->sender_port = ntohs(addr->sin_port);
+}
+
+int udp_receive_batch(const char* host, int port, udp_message_t* messages, int count, int timeout_ms,
+                      response_t* response) {
+    if (!host || port <= 0 || !messages || count <= 0 || !response) {
+        return -1;
+    }
 
     // Initialize response
     memset(response, 0, sizeof(response_t));
     response->protocol = PROTOCOL_UDP;
     uint64_t start_time = get_time_us();
 
-    // Find existing endpoint
-    udp_endpoint_t* endpoint = NULL;
-    for (int i = 0; i < udp_endpoint_count; i++) {
-        if (strcmp(udp_endpoints[i].host, host) == 0 && udp_endpoints[i].port == port) {
-            endpoint = &udp_endpoints[i];
+    // Find existing endpoint and hold it for the whole operation
+    int slot = conn_table_acquire(&udp_table, host, port, NULL, false, NULL);
+    udp_endpoint_t* endpoint = slot >= 0 ? udp_endpoint_at(slot) : NULL;
+    if (!endpoint || !endpoint->is_bound) {
+        response->success = false;
+        response->status_code = 400;
+        strcpy(response->error_message, "No UDP endpoint available");
+        response->response_time_us = get_time_us() - start_time;
+        if (endpoint) conn_table_release(&udp_table, slot);
+        return -1;
+    }
+
+    udp_bind_for_receive(endpoint->socket_fd, port);
+
+    struct pollfd pfd = {.fd = endpoint->socket_fd, .events = POLLIN, .revents = 0};
+    if (poll(&pfd, 1, timeout_ms > 0 ? timeout_ms : 0) <= 0) {
+        response->success = true;
+        response->status_code = 204;
+        strcpy(response->body, "No UDP data available");
+        response->response_time_us = get_time_us() - start_time;
+        conn_table_release(&udp_table, slot);
+        return 0;
+    }
+
+    int received = 0;
+    int err = 0;
+    size_t bytes_received = 0;
+#ifdef __linux__
+    struct mmsghdr msgs[UDP_BATCH_MAX];
+    struct iovec iovs[UDP_BATCH_MAX];
+    struct sockaddr_in senders[UDP_BATCH_MAX];
+    while (received < count) {
+        int n = count - received < UDP_BATCH_MAX ? count - received : UDP_BATCH_MAX;
+        memset(msgs, 0, sizeof(struct mmsghdr) * (size_t)n);
+        for (int i = 0; i < n; i++) {
+            iovs[i].iov_base = messages[received + i].data;
+            iovs[i].iov_len = messages[received + i].capacity;
+            msgs[i].msg_hdr.msg_name = &senders[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        /* Take what is queued now; the wait above already happened */
+        int done = recvmmsg(endpoint->socket_fd, msgs, (unsigned int)n, MSG_DONTWAIT, NULL);
+        if (done < 0 && errno == EINTR) continue;
+        if (done < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) err = errno;
+            break;
+        }
+        for (int i = 0; i < done; i++) {
+            udp_message_t* message = &messages[received + i];
+            message->len = msgs[i].msg_len;
+            bytes_received += msgs[i].msg_len;
+            udp_message_sender(message, &senders[i]);
+        }
+        received += done;
+        if (done < n) break;
+    }
+#else
+    while (received < count) {
+        udp_message_t* message = &messages[received];
+        struct sockaddr_in sender;
+        socklen_t sender_len = sizeof(sender);
+        ssize_t n = recvfrom(endpoint->socket_fd, message->data, message->capacity, MSG_DONTWAIT,
+                             (struct sockaddr*)&sender, &sender_len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) err = errno;
             break;
         }
+        message->len = (size_t)n;
+        bytes_received += (size_t)n;
+        udp_message_sender(message, &sender);
+        received++;
     }
+#endif
+
+    udp_response_data_t* udp_data = &response->protocol_data.udp;
+    udp_data->socket_fd = endpoint->socket_fd;
+    udp_data->bytes_received = bytes_received;
+    if (received > 0) {
+        strncpy(udp_data->sender_address, messages[0].sender_address, sizeof(udp_data->sender_address) - 1);
+        udp_data->sender_port = messages[0].sender_port;
+    }
+
+    if (received == 0 && err != 0) {
+        response->success = false;
+        response->status_code = 500;
+        snprintf(response->error_message, sizeof(response->error_message),
+                "UDP batch receive failed: %s", strerror(err));
+        response->response_time_us = get_time_us() - start_time;
+        conn_table_release(&udp_table, slot);
+        return -1;
+    }
+
+    response->success = true;
+    response->status_code = received > 0 ? 200 : 204;
+    snprintf(response->body, sizeof(response->body),
+            "Received %d datagrams (%zu bytes) via UDP", received, bytes_received);
+    response->response_time_us = get_time_us() - start_time;
+
+    conn_table_release(&udp_table, slot);
+    return received;
+}
+
+int udp_close_endpoint(const char* host, int port, response_t* response) {
+    if (!host || port <= 0 || !response) {
+        return -1;
+    }
+
+    // Initialize response
+    memset(response, 0, sizeof(response_t));
+    response->protocol = PROTOCOL_UDP;
+    uint64_t start_time = get_time_us();
+
+    // Find existing endpoint and hold it for the whole operation
+    int slot = conn_table_acquire(&udp_table, host, port, NULL, false, NULL);
+    udp_endpoint_t* endpoint = slot >= 0 ? udp_endpoint_at(slot) : NULL;
     if (!endpoint || !endpoint->is_bound) {
         response->success = false;
         response->status_code = 400;
         strcpy(response->error_message, "No UDP endpoint to close");
         response->response_time_us = get_time_us() - start_time;
-        pthread_mutex_unlock(&udp_pool_mutex);
+        if (endpoint) conn_table_release(&udp_table, slot);
         return -1;
     }
 
@@ -461,6 +663,7 @@ int udp_close_endpoint(const char* host, int port, response_t* response) {
     }
 
     endpoint->is_bound = false;
+    conn_table_set_fd(&udp_table, slot, -1);
 
     response->success = true;
     response->status_code = 200;
@@ -468,19 +671,22 @@ int udp_close_endpoint(const char* host, int port, response_t* response) {
             "UDP endpoint for %s:%d closed successfully", host, port);
     response->response_time_us = get_time_us() - start_time;
 
-    pthread_mutex_unlock(&udp_pool_mutex);
+    conn_table_retire(&udp_table, slot, udp_slot_idle);
     return 0;
 }
 
+int udp_set_pool_size(int max_endpoints) {
+    return conn_table_set_limit(&udp_table, max_endpoints);
+}
+
+int udp_get_pool_size(void) {
+    return conn_table_get_limit(&udp_table);
+}
+
+int udp_get_pool_in_use(void) {
+    return conn_table_get_count(&udp_table);
+}
+
 void udp_cleanup_all(void) {
-    pthread_mutex_lock(&udp_pool_mutex);
-    for (int i = 0; i < udp_endpoint_count; i++) {
-        if (udp_endpoints[i].socket_fd >= 0) {
-            close(udp_endpoints[i].socket_fd);
-            udp_endpoints[i].socket_fd = -1;
-        }
-        udp_endpoints[i].is_bound = false;
-    }
-    udp_endpoint_count = 0;
-    pthread_mutex_unlock(&udp_pool_mutex);
+    conn_table_reset(&udp_table, udp_close_slot);
 }
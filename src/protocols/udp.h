@@ -30,12 +30,27 @@ int udp_send(const char* host, int port, const char* data, response_t* response)
 int udp_receive(const char* host, int port, response_t* response);
 int udp_close_endpoint(const char* host, int port, response_t* response);
 
+// Batched forms: one sendmmsg()/recvmmsg() per UDP_BATCH_MAX datagrams on
+// Linux, a sendto()/recvfrom() loop elsewhere. Both return the number of
+// datagrams transferred, or -1.
+#define UDP_BATCH_MAX 64
+int udp_send_batch(const char* host, int port, const udp_datagram_t* datagrams, int count, response_t* response);
+int udp_receive_batch(const char* host, int port, udp_message_t* messages, int count, int timeout_ms,
+                      response_t* response);
+
 // Helper functions
 int udp_parse_url(const char* url, char* host, int* port);
 udp_endpoint_t* udp_find_endpoint(const char* host, int port);
 udp_endpoint_t* udp_create_endpoint_struct(const char* host, int port);
 int udp_lookup_by_fd(int socket_fd, char* host_out, int* port_out);
 
+// Pool sizing: most UDP endpoints open at once (default 100). Slots of
+// closed endpoints are reused; memory grows with the endpoints actually
+// created.
+int udp_set_pool_size(int max_endpoints);
+int udp_get_pool_size(void);
+int udp_get_pool_in_use(void);
+
 // Cleanup function - closes all UDP endpoints
 void udp_cleanup_all(void);
 
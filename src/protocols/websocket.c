@@ -1,191 +1,847 @@
 #include "websocket.h"
-#include "../engine.h"
+#include "../common.h"
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
-#include <sys/time.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
-// Local get_time_us implementation
-static uint64_t ws_get_time_us() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000000ULL + tv.tv_usec;
-}
-
-// Simplified WebSocket connection context for Phase 1
-typedef struct {
-    char url[MAX_URL_LENGTH];
-    char subprotocol[256];
-    bool connected;
-    uint64_t messages_sent;
-    uint64_t messages_received;
-    uint64_t bytes_sent;
-    uint64_t bytes_received;
-} websocket_context_t;
-
-// Simple connection management
-#define MAX_WS_CONNECTIONS 1000
-static websocket_context_t* ws_connections[MAX_WS_CONNECTIONS] = {0};
-static pthread_mutex_t ws_connections_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-// Find or create WebSocket connection context
-static websocket_context_t* get_websocket_connection(const char* url) {
-    pthread_mutex_lock(&ws_connections_mutex);
-    
-    // Look for existing connection
-    for (int i = 0; i < MAX_WS_CONNECTIONS; i++) {
-        if (ws_connections[i] && strcmp(ws_connections[i]->url, url) == 0) {
-            pthread_mutex_unlock(&ws_connections_mutex);
-            return ws_connections[i];
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define WS_IO_TIMEOUT_MS 5000           /* connect, handshake and each send */
+#define WS_CLOSE_TIMEOUT_MS 1000        /* wait for the server's close frame */
+#define WS_READ_CHUNK 16384
+#define WS_MAX_MESSAGE (16 << 20)       /* larger incoming frames are treated as garbage */
+
+static const char ws_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// Connection pool for the blocking API: each slot of ws_table (keyed by
+// host, port and resource) stores its websocket_connection_t, guarded by
+// that slot's lock
+static conn_table_t ws_table = CONN_TABLE_INIT("WebSocket", websocket_connection_t, MAX_WS_CONNECTIONS_DEFAULT);
+
+static websocket_connection_t* ws_connection_at(int slot) {
+    return conn_table_entry(&ws_table, slot);
+}
+
+/* Caller holds the slot: close the socket and unpublish its fd */
+static void ws_close_slot(int slot) {
+    websocket_connection_t* conn = ws_connection_at(slot);
+    if (conn->socket_fd >= 0) {
+        close(conn->socket_fd);
+        conn->socket_fd = -1;
+    }
+    conn->is_connected = false;
+    free(conn->in);
+    conn->in = NULL;
+    conn->in_len = conn->in_cap = 0;
+    conn->in_fragment = false;
+    conn_table_set_fd(&ws_table, slot, -1);
+}
+
+/* A closed slot can go back on the free list */
+static bool ws_slot_idle(int slot) {
+    return !ws_connection_at(slot)->is_connected;
+}
+
+static void ws_init_connection(websocket_connection_t* conn, const char* host, int port, const char* resource) {
+    memset(conn, 0, sizeof(websocket_connection_t));
+    snprintf(conn->host, sizeof(conn->host), "%s", host);
+    conn->port = port;
+    snprintf(conn->resource, sizeof(conn->resource), "%s", resource);
+    conn->socket_fd = -1;
+}
+
+/* ---------------------------------------------------------------------------
+ * SHA-1 and base64, for Sec-WebSocket-Accept only
+ * ------------------------------------------------------------------------- */
+
+static uint32_t ws_rol32(uint32_t v, int n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+static void ws_sha1_block(uint32_t h[5], const unsigned char* p) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 80; i++) w[i] = ws_rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
         }
+        uint32_t t = ws_rol32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ws_rol32(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+static void ws_sha1(const unsigned char* data, size_t len, unsigned char digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t full = len / 64 * 64;
+    for (size_t off = 0; off < full; off += 64) ws_sha1_block(h, data + off);
+
+    unsigned char tail[128];
+    memset(tail, 0, sizeof(tail));
+    size_t rest = len - full;
+    memcpy(tail, data + full, rest);
+    tail[rest] = 0x80;
+    size_t tail_len = rest + 9 <= 64 ? 64 : 128;
+    uint64_t bits = (uint64_t)len * 8;
+    for (int i = 0; i < 8; i++) tail[tail_len - 1 - i] = (unsigned char)(bits >> (8 * i));
+    for (size_t off = 0; off < tail_len; off += 64) ws_sha1_block(h, tail + off);
+
+    for (int i = 0; i < 20; i++) digest[i] = (unsigned char)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static void ws_base64(const unsigned char* in, size_t len, char* out) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+        out[o++] = table[(v >> 18) & 63];
+        out[o++] = table[(v >> 12) & 63];
+        out[o++] = i + 1 < len ? table[(v >> 6) & 63] : '=';
+        out[o++] = i + 2 < len ? table[v & 63] : '=';
+    }
+    out[o] = '\0';
+}
+
+/* ---------------------------------------------------------------------------
+ * Handshake and framing helpers
+ * ------------------------------------------------------------------------- */
+
+int websocket_parse_url(const char* url, char* host, size_t host_len, int* port,
+                        char* resource, size_t resource_len) {
+    if (!url || !host || !port || !resource || host_len == 0 || resource_len < 2) return -1;
+    if (strncasecmp(url, "wss://", 6) == 0) return -2;
+    if (strncasecmp(url, "ws://", 5) != 0) return -1;
+
+    // Host, or [IPv6 literal]
+    const char* p = url + 5;
+    const char* host_start = p;
+    const char* host_end;
+    if (*p == '[') {
+        host_start = p + 1;
+        host_end = strchr(host_start, ']');
+        if (!host_end) return -1;
+        p = host_end + 1;
+    } else {
+        host_end = p + strcspn(p, ":/?#");
+        p = host_end;
+    }
+    size_t n = (size_t)(host_end - host_start);
+    if (n == 0 || n >= host_len) return -1;
+    memcpy(host, host_start, n);
+    host[n] = '\0';
+
+    *port = WS_DEFAULT_PORT;
+    if (*p == ':') {
+        char* end;
+        long value = strtol(p + 1, &end, 10);
+        if (end == p + 1 || value <= 0 || value > 65535) return -1;
+        *port = (int)value;
+        p = end;
+    }
+    if (*p != '\0' && *p != '/' && *p != '?' && *p != '#') return -1;
+
+    // Path and query; the fragment never goes on the wire
+    size_t r = strcspn(p, "#");
+    size_t prefix = *p == '/' ? 0 : 1;
+    if (prefix + r >= resource_len) return -1;
+    resource[0] = '/';
+    memcpy(resource + prefix, p, r);
+    resource[prefix + r] = '\0';
+    return 0;
+}
+
+/* Per-thread splitmix64, seeded from the clock and the thread */
+static __thread uint64_t ws_rng_state = 0;
+
+void websocket_random_bytes(unsigned char* out, size_t len) {
+    if (ws_rng_state == 0) ws_rng_state = (get_time_us() ^ ((uint64_t)(uintptr_t)&ws_rng_state << 16)) | 1;
+    while (len > 0) {
+        uint64_t z = (ws_rng_state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        size_t n = len < sizeof(z) ? len : sizeof(z);
+        memcpy(out, &z, n);
+        out += n;
+        len -= n;
     }
-    
-    // Create new connection
-    for (int i = 0; i < MAX_WS_CONNECTIONS; i++) {
-        if (!ws_connections[i]) {
-            ws_connections[i] = malloc(sizeof(websocket_context_t));
-            memset(ws_connections[i], 0, sizeof(websocket_context_t));
-            strncpy(ws_connections[i]->url, url, sizeof(ws_connections[i]->url) - 1);
-            pthread_mutex_unlock(&ws_connections_mutex);
-            return ws_connections[i];
+}
+
+void websocket_make_key(char* key) {
+    unsigned char nonce[16];
+    websocket_random_bytes(nonce, sizeof(nonce));
+    ws_base64(nonce, sizeof(nonce), key);
+}
+
+void websocket_accept_for_key(const char* key, char* accept) {
+    unsigned char input[WS_KEY_LENGTH + sizeof(ws_guid)];
+    size_t key_len = strlen(key);
+    if (key_len > WS_KEY_LENGTH) key_len = WS_KEY_LENGTH;
+    memcpy(input, key, key_len);
+    memcpy(input + key_len, ws_guid, sizeof(ws_guid) - 1);
+    unsigned char digest[20];
+    ws_sha1(input, key_len + sizeof(ws_guid) - 1, digest);
+    ws_base64(digest, sizeof(digest), accept);
+}
+
+int websocket_build_upgrade(char* buf, size_t cap, const char* host, int port, const char* resource,
+                            const char* key, const char* subprotocol, const char* origin) {
+    bool ipv6 = strchr(host, ':') != NULL;
+    char port_part[8] = "";
+    if (port != WS_DEFAULT_PORT) snprintf(port_part, sizeof(port_part), ":%d", port);
+
+    int n = snprintf(buf, cap,
+                     "GET %s HTTP/1.1\r\n"
+                     "Host: %s%s%s%s\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: %s\r\n"
+                     "Sec-WebSocket-Version: 13\r\n",
+                     resource, ipv6 ? "[" : "", host, ipv6 ? "]" : "", port_part, key);
+    if (n < 0 || (size_t)n >= cap) return -1;
+    if (subprotocol && subprotocol[0]) {
+        int m = snprintf(buf + n, cap - (size_t)n, "Sec-WebSocket-Protocol: %s\r\n", subprotocol);
+        if (m < 0 || (size_t)m >= cap - (size_t)n) return -1;
+        n += m;
+    }
+    if (origin && origin[0]) {
+        int m = snprintf(buf + n, cap - (size_t)n, "Origin: %s\r\n", origin);
+        if (m < 0 || (size_t)m >= cap - (size_t)n) return -1;
+        n += m;
+    }
+    if (cap - (size_t)n < 3) return -1;
+    memcpy(buf + n, "\r\n", 3);
+    return n + 2;
+}
+
+size_t websocket_find_headers_end(const char* buf, size_t len) {
+    for (size_t i = 3; i < len; i++) {
+        if (buf[i] == '\n' && buf[i - 1] == '\r' && buf[i - 2] == '\n' && buf[i - 3] == '\r') return i + 1;
+    }
+    return 0;
+}
+
+/* Whether the comma-separated list value[0..len) holds token (any case) */
+static bool ws_has_token(const char* value, size_t len, const char* token) {
+    size_t token_len = strlen(token);
+    size_t i = 0;
+    while (i < len) {
+        while (i < len && (value[i] == ' ' || value[i] == '\t' || value[i] == ',')) i++;
+        size_t start = i;
+        while (i < len && value[i] != ',') i++;
+        size_t end = i;
+        while (end > start && (value[end - 1] == ' ' || value[end - 1] == '\t')) end--;
+        if (end - start == token_len && strncasecmp(value + start, token, token_len) == 0) return true;
+    }
+    return false;
+}
+
+int websocket_check_upgrade(const char* buf, size_t len, const char* key, const char* offered,
+                            int* status, char* subprotocol, size_t subprotocol_len) {
+    *status = 0;
+    if (subprotocol_len > 0) subprotocol[0] = '\0';
+    if (len < 12 || strncmp(buf, "HTTP/1.", 7) != 0) return -1;
+    *status = atoi(buf + 9);
+    if (*status != 101) return -1;
+
+    char expected[WS_ACCEPT_LENGTH + 1];
+    websocket_accept_for_key(key, expected);
+    bool upgrade = false, connection = false, accepted = false;
+
+    const char* line = memchr(buf, '\n', len);
+    const char* end = buf + len;
+    while (line && ++line < end) {
+        const char* eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) break;
+        const char* colon = memchr(line, ':', (size_t)(eol - line));
+        if (colon) {
+            size_t name_len = (size_t)(colon - line);
+            const char* value = colon + 1;
+            const char* value_end = eol;
+            while (value < value_end && (*value == ' ' || *value == '\t')) value++;
+            while (value_end > value && (value_end[-1] == '\r' || value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+            size_t value_len = (size_t)(value_end - value);
+
+            if (name_len == 7 && strncasecmp(line, "Upgrade", 7) == 0) {
+                upgrade = value_len == 9 && strncasecmp(value, "websocket", 9) == 0;
+            } else if (name_len == 10 && strncasecmp(line, "Connection", 10) == 0) {
+                connection = ws_has_token(value, value_len, "upgrade");
+            } else if (name_len == 20 && strncasecmp(line, "Sec-WebSocket-Accept", 20) == 0) {
+                accepted = value_len == WS_ACCEPT_LENGTH && memcmp(value, expected, WS_ACCEPT_LENGTH) == 0;
+            } else if (name_len == 22 && strncasecmp(line, "Sec-WebSocket-Protocol", 22) == 0) {
+                // The server may only pick one of the subprotocols we offered
+                char chosen[256];
+                if (value_len >= sizeof(chosen)) return -1;
+                memcpy(chosen, value, value_len);
+                chosen[value_len] = '\0';
+                if (!offered || !ws_has_token(offered, strlen(offered), chosen)) return -1;
+                if (subprotocol_len > 0) snprintf(subprotocol, subprotocol_len, "%s", chosen);
+            } else if (name_len == 24 && strncasecmp(line, "Sec-WebSocket-Extensions", 24) == 0) {
+                if (value_len > 0) return -1;   /* we offered none */
+            }
         }
+        line = eol;
     }
-    
-    pthread_mutex_unlock(&ws_connections_mutex);
-    return NULL; // No available slots
+    return upgrade && connection && accepted ? 0 : -1;
+}
+
+void websocket_mask(unsigned char* dst, const unsigned char* src, size_t len,
+                    const unsigned char mask[4], size_t offset) {
+    // The key rotated to start at this offset, repeated over a word
+    unsigned char pattern[8];
+    for (int i = 0; i < 8; i++) pattern[i] = mask[(offset + (size_t)i) & 3];
+    uint64_t word;
+    memcpy(&word, pattern, sizeof(word));
+
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i wide = _mm256_set1_epi64x((long long)word);
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(const void*)(src + i));
+        _mm256_storeu_si256((__m256i*)(void*)(dst + i), _mm256_xor_si256(v, wide));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i lane = _mm_set1_epi64x((long long)word);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(const void*)(src + i));
+        _mm_storeu_si128((__m128i*)(void*)(dst + i), _mm_xor_si128(v, lane));
+    }
+#endif
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, src + i, sizeof(v));
+        v ^= word;
+        memcpy(dst + i, &v, sizeof(v));
+    }
+    for (; i < len; i++) dst[i] = src[i] ^ pattern[i & 3];
+}
+
+size_t websocket_encode_frame(unsigned char* out, int opcode, bool fin, const void* payload,
+                              size_t len, const unsigned char mask[4]) {
+    size_t pos = 0;
+    out[pos++] = (unsigned char)((fin ? 0x80 : 0x00) | (opcode & 0x0F));
+    if (len < 126) {
+        out[pos++] = (unsigned char)(0x80 | len);
+    } else if (len <= 0xFFFF) {
+        out[pos++] = 0x80 | 126;
+        out[pos++] = (unsigned char)(len >> 8);
+        out[pos++] = (unsigned char)(len & 0xFF);
+    } else {
+        out[pos++] = 0x80 | 127;
+        for (int i = 7; i >= 0; i--) out[pos++] = (unsigned char)((uint64_t)len >> (8 * i));
+    }
+    memcpy(out + pos, mask, 4);
+    pos += 4;
+    if (len > 0) websocket_mask(out + pos, payload, len, mask, 0);
+    return pos + len;
+}
+
+int websocket_parse_frame(const unsigned char* buf, size_t len, websocket_frame_t* frame) {
+    if (len < 2) return 0;
+    unsigned char b0 = buf[0];
+    unsigned char b1 = buf[1];
+    if (b0 & 0x70) return -1;   /* no extension was negotiated */
+    int opcode = b0 & 0x0F;
+    if ((opcode > WS_OPCODE_BINARY && opcode < WS_OPCODE_CLOSE) || opcode > WS_OPCODE_PONG) return -1;
+
+    size_t pos = 2;
+    uint64_t payload_len = b1 & 0x7F;
+    if (payload_len == 126) {
+        if (len < 4) return 0;
+        payload_len = (uint64_t)buf[2] << 8 | buf[3];
+        pos = 4;
+    } else if (payload_len == 127) {
+        if (len < 10) return 0;
+        payload_len = 0;
+        for (int i = 0; i < 8; i++) payload_len = payload_len << 8 | buf[2 + i];
+        if (payload_len >> 63) return -1;
+        pos = 10;
+    }
+    frame->masked = (b1 & 0x80) != 0;
+    if (frame->masked) {
+        if (len < pos + 4) return 0;
+        memcpy(frame->mask, buf + pos, 4);
+        pos += 4;
+    }
+    frame->fin = (b0 & 0x80) != 0;
+    if ((opcode & 0x08) && (!frame->fin || payload_len > WS_MAX_CONTROL_PAYLOAD)) return -1;
+    frame->opcode = opcode;
+    frame->payload_len = payload_len;
+    frame->header_len = pos;
+    return 1;
+}
+
+/* ---------------------------------------------------------------------------
+ * Blocking per-URL API
+ * ------------------------------------------------------------------------- */
+
+/* Wait for events on fd until deadline_us: 1 = ready, 0 = timed out, -1 = error */
+static int ws_wait(int fd, short events, uint64_t deadline_us) {
+    for (;;) {
+        uint64_t now_us = get_time_us();
+        int wait_ms = deadline_us > now_us ? (int)((deadline_us - now_us + 999) / 1000) : 0;
+        struct pollfd pfd = {.fd = fd, .events = events, .revents = 0};
+        int rc = poll(&pfd, 1, wait_ms);
+        if (rc < 0 && errno == EINTR) continue;
+        if (rc < 0) return -1;
+        return rc > 0 ? 1 : 0;
+    }
+}
+
+static int ws_send_all(websocket_connection_t* conn, const void* data, size_t len, uint64_t deadline_us) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = send(conn->socket_fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            int rc = ws_wait(conn->socket_fd, POLLOUT, deadline_us);
+            if (rc <= 0) {
+                snprintf(conn->last_error, sizeof(conn->last_error), "%s", rc == 0 ? "Send timeout" : strerror(errno));
+                return -1;
+            }
+            continue;
+        }
+        if (n < 0) {
+            snprintf(conn->last_error, sizeof(conn->last_error), "Send failed: %s", strerror(errno));
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Wait until deadline_us for input and append what is queued: bytes read,
+   0 if the peer closed, -1 on error, -2 on timeout */
+static ssize_t ws_read_more(websocket_connection_t* conn, uint64_t deadline_us) {
+    if (conn->in_cap - conn->in_len < WS_READ_CHUNK) {
+        size_t cap = conn->in_cap ? conn->in_cap * 2 : WS_READ_CHUNK * 2;
+        unsigned char* in = realloc(conn->in, cap);
+        if (!in) return -1;
+        conn->in = in;
+        conn->in_cap = cap;
+    }
+    for (;;) {
+        ssize_t n = recv(conn->socket_fd, conn->in + conn->in_len, conn->in_cap - conn->in_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            int rc = ws_wait(conn->socket_fd, POLLIN, deadline_us);
+            if (rc < 0) return -1;
+            if (rc == 0) return -2;
+            continue;
+        }
+        if (n > 0) conn->in_len += (size_t)n;
+        return n;
+    }
+}
+
+static int ws_send_frame(websocket_connection_t* conn, int opcode, const void* payload, size_t len,
+                         uint64_t deadline_us) {
+    unsigned char stack_frame[WS_MAX_FRAME_HEADER + WS_MAX_CONTROL_PAYLOAD];
+    unsigned char* frame = len <= WS_MAX_CONTROL_PAYLOAD ? stack_frame : malloc(len + WS_MAX_FRAME_HEADER);
+    if (!frame) return -1;
+    unsigned char mask[4];
+    websocket_random_bytes(mask, sizeof(mask));
+    size_t frame_len = websocket_encode_frame(frame, opcode, true, payload, len, mask);
+    int rc = ws_send_all(conn, frame, frame_len, deadline_us);
+    if (frame != stack_frame) free(frame);
+    return rc;
+}
+
+/* Act on every complete frame buffered: count data messages, answer pings
+   and the server's close. Sets *close_code (0 = none) once the server has
+   closed; returns -1 on a protocol error. */
+static int ws_handle_frames(websocket_connection_t* conn, int* close_code) {
+    size_t pos = 0;
+    int rc = 0;
+    while (rc == 0) {
+        websocket_frame_t frame;
+        int parsed = websocket_parse_frame(conn->in + pos, conn->in_len - pos, &frame);
+        if (parsed < 0 || (parsed > 0 && frame.payload_len > WS_MAX_MESSAGE)) {
+            snprintf(conn->last_error, sizeof(conn->last_error), "WebSocket protocol error");
+            rc = -1;
+            break;
+        }
+        if (parsed == 0 || conn->in_len - pos - frame.header_len < frame.payload_len) break;
+
+        unsigned char* payload = conn->in + pos + frame.header_len;
+        size_t len = (size_t)frame.payload_len;
+        if (frame.masked) websocket_mask(payload, payload, len, frame.mask, 0);
+        pos += frame.header_len + len;
+
+        switch (frame.opcode) {
+        case WS_OPCODE_TEXT:
+        case WS_OPCODE_BINARY:
+        case WS_OPCODE_CONTINUATION:
+            if ((frame.opcode == WS_OPCODE_CONTINUATION) != conn->in_fragment) {
+                snprintf(conn->last_error, sizeof(conn->last_error), "Unexpected WebSocket continuation");
+                rc = -1;
+                break;
+            }
+            conn->bytes_received += len;
+            conn->in_fragment = !frame.fin;
+            if (frame.fin) conn->messages_received++;
+            break;
+        case WS_OPCODE_PING:
+            if (ws_send_frame(conn, WS_OPCODE_PONG, payload, len, get_time_us() + WS_IO_TIMEOUT_MS * 1000ULL) != 0) rc = -1;
+            break;
+        case WS_OPCODE_CLOSE:
+            *close_code = len >= 2 ? (payload[0] << 8 | payload[1]) : WS_CLOSE_NORMAL;
+            rc = 1;
+            break;
+        default:
+            break;   /* PONG */
+        }
+    }
+    memmove(conn->in, conn->in + pos, conn->in_len - pos);
+    conn->in_len -= pos;
+    return rc < 0 ? -1 : 0;
+}
+
+/* Take whatever the server has already sent, without waiting */
+static int ws_drain(websocket_connection_t* conn, int* close_code) {
+    for (;;) {
+        ssize_t n = ws_read_more(conn, 0);
+        if (n == -2) return 0;
+        if (n < 0) return -1;
+        if (n == 0) {
+            *close_code = -1;   /* dropped without a close frame */
+            return 0;
+        }
+        if (ws_handle_frames(conn, close_code) != 0) return -1;
+        if (*close_code) return 0;
+    }
+}
+
+/* TCP connect with a deadline; the socket stays non-blocking */
+static int ws_tcp_connect(websocket_connection_t* conn, uint64_t deadline_us, int* status) {
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", conn->port);
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int gai_err = getaddrinfo(conn->host, port_str, &hints, &res);
+    if (gai_err != 0) {
+        *status = 404;
+        snprintf(conn->last_error, sizeof(conn->last_error), "DNS resolution failed for %.200s: %s",
+                 conn->host, gai_strerror(gai_err));
+        return -1;
+    }
+
+    int fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        *status = 500;
+        snprintf(conn->last_error, sizeof(conn->last_error), "Failed to create socket: %s", strerror(errno));
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    int rc = connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc != 0 && errno == EINPROGRESS) {
+        rc = ws_wait(fd, POLLOUT, deadline_us);
+        if (rc <= 0) {
+            close(fd);
+            *status = 408;
+            snprintf(conn->last_error, sizeof(conn->last_error), "Connection timeout");
+            return -1;
+        }
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) err = errno;
+        errno = err;
+        rc = err == 0 ? 0 : -1;
+    }
+    if (rc != 0) {
+        close(fd);
+        *status = 500;
+        snprintf(conn->last_error, sizeof(conn->last_error), "Connection failed: %s", strerror(errno));
+        return -1;
+    }
+    conn->socket_fd = fd;
+    return 0;
+}
+
+/* Send the upgrade request and check the answer; frames the server sent
+   right after its headers stay in conn->in */
+static int ws_handshake(websocket_connection_t* conn, const char* subprotocol, uint64_t deadline_us,
+                        response_t* response, int* status) {
+    char key[WS_KEY_LENGTH + 1];
+    websocket_make_key(key);
+    char request[WS_MAX_HANDSHAKE];
+    int len = websocket_build_upgrade(request, sizeof(request), conn->host, conn->port, conn->resource,
+                                      key, subprotocol, NULL);
+    if (len < 0) {
+        *status = 400;
+        snprintf(conn->last_error, sizeof(conn->last_error), "Upgrade request too long");
+        return -1;
+    }
+    if (ws_send_all(conn, request, (size_t)len, deadline_us) != 0) {
+        *status = 500;
+        return -1;
+    }
+
+    size_t headers_end = 0;
+    while ((headers_end = websocket_find_headers_end((const char*)conn->in, conn->in_len)) == 0) {
+        if (conn->in_len >= WS_MAX_HANDSHAKE) {
+            *status = 502;
+            snprintf(conn->last_error, sizeof(conn->last_error), "Upgrade response too long");
+            return -1;
+        }
+        ssize_t n = ws_read_more(conn, deadline_us);
+        if (n <= 0) {
+            *status = n == -2 ? 408 : 502;
+            snprintf(conn->last_error, sizeof(conn->last_error), "%s",
+                     n == -2 ? "Upgrade timeout" : n == 0 ? "Connection closed during upgrade" : strerror(errno));
+            return -1;
+        }
+    }
+
+    size_t copy = headers_end < sizeof(response->headers) - 1 ? headers_end : sizeof(response->headers) - 1;
+    memcpy(response->headers, conn->in, copy);
+    response->headers[copy] = '\0';
+
+    int http_status = 0;
+    if (websocket_check_upgrade((const char*)conn->in, headers_end, key, subprotocol, &http_status,
+                                conn->subprotocol, sizeof(conn->subprotocol)) != 0) {
+        *status = http_status && http_status != 101 ? http_status : 502;
+        if (http_status && http_status != 101) {
+            snprintf(conn->last_error, sizeof(conn->last_error), "Upgrade rejected with HTTP %d", http_status);
+        } else {
+            snprintf(conn->last_error, sizeof(conn->last_error), "Invalid upgrade response");
+        }
+        return -1;
+    }
+    memmove(conn->in, conn->in + headers_end, conn->in_len - headers_end);
+    conn->in_len -= headers_end;
+    return 0;
+}
+
+/* Key of url in ws_table; fills response and returns -1 if it is unusable */
+static int ws_url_key(const char* url, char* host, size_t host_len, int* port, char* resource,
+                      response_t* response, uint64_t start_time) {
+    int rc = websocket_parse_url(url, host, host_len, port, resource, WS_MAX_RESOURCE_LENGTH);
+    if (rc == 0) return 0;
+    SET_ERROR_RESPONSE(response, 400, start_time,
+                       rc == -2 ? "wss:// needs TLS, which is not supported; use ws://" : "Invalid WebSocket URL");
+    return -1;
+}
+
+static void ws_fill_counters(const websocket_connection_t* conn, response_t* response) {
+    websocket_response_data_t* ws = &response->protocol_data.websocket;
+    snprintf(ws->subprotocol, sizeof(ws->subprotocol), "%s", conn->subprotocol);
+    ws->messages_sent = (int)conn->messages_sent;
+    ws->messages_received = (int)conn->messages_received;
+    ws->bytes_sent = conn->bytes_sent;
+    ws->bytes_received = conn->bytes_received;
 }
 
 int websocket_connect(const char* url, const char* subprotocol, response_t* response) {
     if (!url || !response) return -1;
-    
-    websocket_context_t* ctx = get_websocket_connection(url);
-    if (!ctx) {
-        strncpy(response->error_message, "Too many WebSocket connections", sizeof(response->error_message) - 1);
+
+    INIT_RESPONSE(response, PROTOCOL_WEBSOCKET);
+    uint64_t start_time = get_time_us();
+    char host[CONN_TABLE_HOST_MAX];
+    char resource[WS_MAX_RESOURCE_LENGTH];
+    int port = 0;
+    if (ws_url_key(url, host, sizeof(host), &port, resource, response, start_time) != 0) return -1;
+
+    // Find or create the connection; its slot stays locked until we return
+    bool created = false;
+    int slot = conn_table_acquire(&ws_table, host, port, resource, true, &created);
+    if (slot < 0) {
+        SET_ERROR_RESPONSE(response, 500, start_time, "Too many WebSocket connections");
+        return -1;
+    }
+    websocket_connection_t* conn = ws_connection_at(slot);
+    if (created) ws_init_connection(conn, host, port, resource);
+
+    if (conn->is_connected) {
+        ws_fill_counters(conn, response);
+        snprintf(response->body, sizeof(response->body), "WebSocket connection already established to %s", url);
+        SET_SUCCESS_RESPONSE(response, 101, start_time);
+        conn_table_release(&ws_table, slot);
+        return 0;
+    }
+
+    conn->in_len = 0;
+    conn->in_fragment = false;
+    conn->subprotocol[0] = '\0';
+    uint64_t deadline_us = start_time + WS_IO_TIMEOUT_MS * 1000ULL;
+    int status = 500;
+    if (ws_tcp_connect(conn, deadline_us, &status) != 0 ||
+        ws_handshake(conn, subprotocol, deadline_us, response, &status) != 0) {
+        SET_ERROR_RESPONSE(response, status, start_time, conn->last_error);
+        ws_close_slot(slot);
+        conn_table_retire(&ws_table, slot, ws_slot_idle);
         return -1;
     }
-    
-    if (ctx->connected) {
-        response->success = true;
-        response->status_code = 101; // Switching Protocols
-        return 0; // Already connected
-    }
-    
-    uint64_t start_time = ws_get_time_us();
-    
-    // Simulate WebSocket connection (Phase 1 implementation)
-    // In a full implementation, this would do actual WebSocket handshake
-    
-    // Set up connection context
-    if (subprotocol && strlen(subprotocol) > 0) {
-        strncpy(ctx->subprotocol, subprotocol, sizeof(ctx->subprotocol) - 1);
-    }
-    
-    // Simulate connection delay
-    usleep(10000); // 10ms delay to simulate network
-    
-    ctx->connected = true;
-    
-    uint64_t end_time = ws_get_time_us();
-    response->response_time_us = end_time - start_time;
-    response->success = true;
-    response->status_code = 101; // Switching Protocols
-    response->protocol = PROTOCOL_WEBSOCKET;
-    
-    // Set response data
-    strncpy(response->body, "WebSocket connection established (simulated)", sizeof(response->body) - 1);
-    strncpy(response->headers, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade", sizeof(response->headers) - 1);
-    
-    // Set WebSocket-specific response data
-    strncpy(response->protocol_data.websocket.subprotocol, ctx->subprotocol, sizeof(response->protocol_data.websocket.subprotocol) - 1);
-    
+
+    // Publish the socket by fd; an unindexed one is a failed connect
+    if (conn_table_set_fd(&ws_table, slot, conn->socket_fd) != 0) {
+        SET_ERROR_RESPONSE(response, 500, start_time, "Connection failed: out of memory");
+        ws_close_slot(slot);
+        conn_table_retire(&ws_table, slot, ws_slot_idle);
+        return -1;
+    }
+
+    conn->is_connected = true;
+    conn->messages_sent = conn->messages_received = 0;
+    conn->bytes_sent = conn->bytes_received = 0;
+    ws_fill_counters(conn, response);
+    snprintf(response->body, sizeof(response->body), "WebSocket connection established to %s", url);
+    SET_SUCCESS_RESPONSE(response, 101, start_time);   /* Switching Protocols */
+    conn_table_release(&ws_table, slot);
     return 0;
 }
 
 int websocket_send_message(const char* url, const char* message, response_t* response) {
     if (!url || !message || !response) return -1;
-    
-    websocket_context_t* ctx = get_websocket_connection(url);
-    if (!ctx || !ctx->connected) {
-        strncpy(response->error_message, "WebSocket not connected", sizeof(response->error_message) - 1);
+
+    INIT_RESPONSE(response, PROTOCOL_WEBSOCKET);
+    uint64_t start_time = get_time_us();
+    char host[CONN_TABLE_HOST_MAX];
+    char resource[WS_MAX_RESOURCE_LENGTH];
+    int port = 0;
+    if (ws_url_key(url, host, sizeof(host), &port, resource, response, start_time) != 0) return -1;
+
+    // Find existing connection and hold it for the whole operation
+    int slot = conn_table_acquire(&ws_table, host, port, resource, false, NULL);
+    websocket_connection_t* conn = slot >= 0 ? ws_connection_at(slot) : NULL;
+    if (!conn || !conn->is_connected) {
+        SET_ERROR_RESPONSE(response, 400, start_time, "WebSocket not connected");
+        if (conn) conn_table_release(&ws_table, slot);
         return -1;
     }
-    
-    uint64_t start_time = ws_get_time_us();
-    
-    int message_len = strlen(message);
-    
-    // Simulate message sending (Phase 1 implementation)
-    // In a full implementation, this would send actual WebSocket frames
-    usleep(1000); // 1ms delay to simulate network
-    
-    ctx->messages_sent++;
-    ctx->bytes_sent += message_len;
-    
-    uint64_t end_time = ws_get_time_us();
-    
-    response->success = true;
-    response->status_code = 200;
-    response->response_time_us = end_time - start_time;
-    response->protocol = PROTOCOL_WEBSOCKET;
-    response->protocol_data.websocket.messages_sent = ctx->messages_sent;
-    response->protocol_data.websocket.bytes_sent = ctx->bytes_sent;
-    
-    snprintf(response->body, sizeof(response->body), "Message sent: %d bytes (simulated)", message_len);
-    
+
+    size_t message_len = strlen(message);
+    if (ws_send_frame(conn, WS_OPCODE_TEXT, message, message_len, start_time + WS_IO_TIMEOUT_MS * 1000ULL) != 0) {
+        SET_ERROR_RESPONSE(response, 500, start_time, conn->last_error[0] ? conn->last_error : "Send failed");
+        ws_close_slot(slot);
+        conn_table_retire(&ws_table, slot, ws_slot_idle);
+        return -1;
+    }
+    conn->messages_sent++;
+    conn->bytes_sent += message_len;
+
+    // Count replies that are already in and answer pings; a server close
+    // ends the connection once this send is reported
+    int close_code = 0;
+    int drained = ws_drain(conn, &close_code);
+    ws_fill_counters(conn, response);
+    snprintf(response->body, sizeof(response->body), "Message sent: %zu bytes", message_len);
+    SET_SUCCESS_RESPONSE(response, 200, start_time);
+    if (drained != 0 || close_code != 0) {
+        if (close_code > 0) {
+            unsigned char code[2] = {(unsigned char)(close_code >> 8), (unsigned char)(close_code & 0xFF)};
+            ws_send_frame(conn, WS_OPCODE_CLOSE, code, sizeof(code), get_time_us() + WS_CLOSE_TIMEOUT_MS * 1000ULL);
+        }
+        ws_close_slot(slot);
+        conn_table_retire(&ws_table, slot, ws_slot_idle);
+        return 0;
+    }
+    conn_table_release(&ws_table, slot);
     return 0;
 }
 
 int websocket_close_connection(const char* url, response_t* response) {
     if (!url || !response) return -1;
-    
-    websocket_context_t* ctx = get_websocket_connection(url);
-    if (!ctx || !ctx->connected) {
-        response->success = true; // Already closed
-        response->status_code = 200;
-        response->protocol = PROTOCOL_WEBSOCKET;
+
+    INIT_RESPONSE(response, PROTOCOL_WEBSOCKET);
+    uint64_t start_time = get_time_us();
+    char host[CONN_TABLE_HOST_MAX];
+    char resource[WS_MAX_RESOURCE_LENGTH];
+    int port = 0;
+    if (ws_url_key(url, host, sizeof(host), &port, resource, response, start_time) != 0) return -1;
+
+    int slot = conn_table_acquire(&ws_table, host, port, resource, false, NULL);
+    websocket_connection_t* conn = slot >= 0 ? ws_connection_at(slot) : NULL;
+    if (!conn || !conn->is_connected) {
         strcpy(response->body, "WebSocket connection already closed");
+        SET_SUCCESS_RESPONSE(response, 200, start_time);
+        if (conn) conn_table_retire(&ws_table, slot, ws_slot_idle);
         return 0;
     }
-    
-    uint64_t start_time = ws_get_time_us();
-    
-    // Simulate connection close (Phase 1 implementation)
-    usleep(5000); // 5ms delay to simulate network
-    
-    ctx->connected = false;
-    
-    uint64_t end_time = ws_get_time_us();
-    
-    response->success = true;
-    response->status_code = 200;
-    response->response_time_us = end_time - start_time;
-    response->protocol = PROTOCOL_WEBSOCKET;
-    
-    strcpy(response->body, "WebSocket connection closed (simulated)");
-    
-    // Clean up connection context
-    pthread_mutex_lock(&ws_connections_mutex);
-    for (int i = 0; i < MAX_WS_CONNECTIONS; i++) {
-        if (ws_connections[i] == ctx) {
-            free(ws_connections[i]);
-            ws_connections[i] = NULL;
-            break;
+
+    // Close handshake: our close frame, then the server's (or EOF)
+    uint64_t deadline_us = start_time + WS_CLOSE_TIMEOUT_MS * 1000ULL;
+    unsigned char code[2] = {WS_CLOSE_NORMAL >> 8, WS_CLOSE_NORMAL & 0xFF};
+    int close_code = 0;
+    if (ws_send_frame(conn, WS_OPCODE_CLOSE, code, sizeof(code), deadline_us) == 0) {
+        while (close_code == 0 && ws_handle_frames(conn, &close_code) == 0 && close_code == 0) {
+            if (ws_read_more(conn, deadline_us) <= 0) break;
         }
     }
-    pthread_mutex_unlock(&ws_connections_mutex);
-    
+    shutdown(conn->socket_fd, SHUT_RDWR);
+    ws_fill_counters(conn, response);
+    ws_close_slot(slot);
+
+    if (close_code > 0) {
+        snprintf(response->body, sizeof(response->body), "WebSocket connection closed (server status %d)", close_code);
+    } else {
+        strcpy(response->body, "WebSocket connection closed");
+    }
+    SET_SUCCESS_RESPONSE(response, 200, start_time);
+    conn_table_retire(&ws_table, slot, ws_slot_idle);
     return 0;
 }
 
+int websocket_set_pool_size(int max_connections) {
+    return conn_table_set_limit(&ws_table, max_connections);
+}
+
+int websocket_get_pool_size(void) {
+    return conn_table_get_limit(&ws_table);
+}
+
+int websocket_get_pool_in_use(void) {
+    return conn_table_get_count(&ws_table);
+}
+
 void websocket_cleanup_all(void) {
-    pthread_mutex_lock(&ws_connections_mutex);
-    for (int i = 0; i < MAX_WS_CONNECTIONS; i++) {
-        if (ws_connections[i]) {
-            free(ws_connections[i]);
-            ws_connections[i] = NULL;
-        }
-    }
-    pthread_mutex_unlock(&ws_connections_mutex);
+    conn_table_reset(&ws_table, ws_close_slot);
 }
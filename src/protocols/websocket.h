@@ -2,15 +2,125 @@
 #define WEBSOCKET_H
 
 #include "../engine.h"
+#include "conn_table.h"
 #include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/time.h>
 
+/*
+ * RFC 6455 WebSocket client over plain TCP (ws://).
+ *
+ * The frame and handshake helpers below are shared by the blocking
+ * per-URL API (websocket_connect() and friends) and the event-driven load
+ * back-end in ws_loop.c. Client frames are always masked; the helpers mask
+ * while copying the payload into the output buffer, so a frame costs one
+ * pass over its payload and no intermediate copy. wss:// needs TLS, which
+ * this client does not do.
+ */
+
+#define WS_DEFAULT_PORT 80
+#define WS_MAX_RESOURCE_LENGTH CONN_TABLE_CLIENT_ID_MAX   /* path and query, part of the pool key */
+#define WS_KEY_LENGTH 24                 /* base64 of 16 random bytes */
+#define WS_ACCEPT_LENGTH 28              /* base64 of a SHA-1 digest */
+#define WS_MAX_FRAME_HEADER 14           /* 2 + 8-byte length + 4-byte mask */
+#define WS_MAX_HANDSHAKE 8192            /* longest upgrade response accepted */
+#define WS_MAX_CONTROL_PAYLOAD 125
+
+// Opcodes
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT 0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CLOSE 0x8
+#define WS_OPCODE_PING 0x9
+#define WS_OPCODE_PONG 0xA
+
+// Close status codes
+#define WS_CLOSE_NORMAL 1000
+#define WS_CLOSE_GOING_AWAY 1001
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+
+// One pooled connection of the blocking API, keyed by (host, port, resource)
+typedef struct {
+    char host[256];
+    int port;
+    char resource[WS_MAX_RESOURCE_LENGTH];
+    char subprotocol[256];          /* chosen by the server, "" = none */
+    int socket_fd;
+    bool is_connected;
+    unsigned char* in;              /* received bytes of frames not handled yet */
+    size_t in_len;
+    size_t in_cap;
+    bool in_fragment;               /* a fragmented data message is being received */
+    uint64_t messages_sent;
+    uint64_t messages_received;
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    char last_error[256];
+} websocket_connection_t;
+
+// A parsed frame header; the payload follows header_len bytes in
+typedef struct {
+    bool fin;
+    int opcode;
+    bool masked;
+    unsigned char mask[4];
+    uint64_t payload_len;
+    size_t header_len;
+} websocket_frame_t;
+
 // WebSocket connection functions
 int websocket_connect(const char* url, const char* subprotocol, response_t* response);
 int websocket_send_message(const char* url, const char* message, response_t* response);
 int websocket_close_connection(const char* url, response_t* response);
 
-// Cleanup function - frees all WebSocket connections
+// Split ws://host[:port][/resource] (IPv6 hosts in brackets). Returns 0,
+// -1 if malformed, or -2 for wss:// (TLS is not supported)
+int websocket_parse_url(const char* url, char* host, size_t host_len, int* port,
+                        char* resource, size_t resource_len);
+
+// Fill out with random bytes from a per-thread generator (mask and
+// handshake keys: unpredictable enough for RFC 6455, not cryptographic)
+void websocket_random_bytes(unsigned char* out, size_t len);
+// A fresh Sec-WebSocket-Key; key holds WS_KEY_LENGTH + 1 bytes
+void websocket_make_key(char* key);
+// The Sec-WebSocket-Accept a server must answer key with; accept holds
+// WS_ACCEPT_LENGTH + 1 bytes
+void websocket_accept_for_key(const char* key, char* accept);
+
+// Write the GET upgrade request to buf; returns its length, or -1 if it
+// does not fit. subprotocol and origin may be NULL or "".
+int websocket_build_upgrade(char* buf, size_t cap, const char* host, int port, const char* resource,
+                            const char* key, const char* subprotocol, const char* origin);
+// Offset just past the "\r\n\r\n" ending the response headers in buf, or 0
+size_t websocket_find_headers_end(const char* buf, size_t len);
+// Check the upgrade response headers (buf[0..len), up to and including the
+// blank line): status 101, Upgrade/Connection, the accept key, and a
+// subprotocol we offered. Stores the HTTP status and the chosen
+// subprotocol; returns 0 if the connection is open, -1 otherwise.
+int websocket_check_upgrade(const char* buf, size_t len, const char* key, const char* offered,
+                            int* status, char* subprotocol, size_t subprotocol_len);
+
+// XOR len bytes of src with the 4-byte mask into dst (dst may be src).
+// offset is the position of src[0] within the payload. Uses SSE2/AVX2 when
+// the compiler targets them, 8-byte words otherwise.
+void websocket_mask(unsigned char* dst, const unsigned char* src, size_t len,
+                    const unsigned char mask[4], size_t offset);
+// Encode one masked client frame into out, which needs
+// len + WS_MAX_FRAME_HEADER bytes; returns the frame length
+size_t websocket_encode_frame(unsigned char* out, int opcode, bool fin, const void* payload,
+                              size_t len, const unsigned char mask[4]);
+// Parse the frame header at buf: 1 = header complete (payload may still be
+// short), 0 = need more bytes, -1 = protocol error (reserved bits, unknown
+// opcode, fragmented or oversized control frame)
+int websocket_parse_frame(const unsigned char* buf, size_t len, websocket_frame_t* frame);
+
+// Pool sizing: most blocking-API connections open at once (default 1000)
+int websocket_set_pool_size(int max_connections);
+int websocket_get_pool_size(void);
+int websocket_get_pool_in_use(void);
+
+// Cleanup function - closes all WebSocket connections
 void websocket_cleanup_all(void);
 
 #endif
@@ -0,0 +1,547 @@
+#include "replay_log.h"
+#include "request_jsonl.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REPLAY_LOG_LABEL_NAME_MAX 128     /* ENGINE_LABEL_NAME_MAX */
+#define REPLAY_LOG_COPY_BUFFER (1 << 20)
+
+_Static_assert(sizeof(replay_log_header_t) == 88, "replay log header layout");
+_Static_assert(sizeof(replay_log_record_t) == 32, "replay log record layout");
+_Static_assert(sizeof(replay_log_template_t) == 24, "replay log template layout");
+
+static bool host_little_endian(void) {
+    const uint16_t probe = 1;
+    return *(const uint8_t*)&probe == 1;
+}
+
+static uint64_t fnv1a(uint64_t hash, const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* ---- conversion ------------------------------------------------------------ */
+
+/* Templates, label names and the strings they point at, collected while
+   converting and written after the records */
+typedef struct {
+    char* strings;                    /* offsets below are relative to this */
+    size_t strings_len;
+    size_t strings_cap;
+    replay_log_template_t templates[REPLAY_LOG_MAX_TEMPLATES];
+    int template_slots[REPLAY_LOG_MAX_TEMPLATES * 2];   /* template id, -1 = empty */
+    int template_count;
+    uint64_t labels[REPLAY_LOG_MAX_LABELS + 1];          /* + "(other)" */
+    int label_slots[(REPLAY_LOG_MAX_LABELS + 1) * 2];
+    int label_count;
+} convert_meta_t;
+
+static int meta_put(convert_meta_t* meta, const char* data, size_t len, uint64_t* off) {
+    if (meta->strings_len + len + 1 > meta->strings_cap) {
+        size_t cap = meta->strings_cap ? meta->strings_cap : 4096;
+        while (cap < meta->strings_len + len + 1) cap *= 2;
+        char* grown = realloc(meta->strings, cap);
+        if (!grown) return -1;
+        meta->strings = grown;
+        meta->strings_cap = cap;
+    }
+    *off = meta->strings_len;
+    memcpy(meta->strings + meta->strings_len, data, len);
+    meta->strings[meta->strings_len + len] = '\0';
+    meta->strings_len += len + 1;
+    return 0;
+}
+
+/* Template id of the request's (method, headers, timeout); -1 when full or out of memory */
+static int meta_template(convert_meta_t* meta, const request_view_t* request) {
+    size_t method_len = strlen(request->method);
+    uint64_t hash = fnv1a(1469598103934665603ULL, request->method, method_len + 1);
+    hash = fnv1a(hash, request->headers, request->headers_len);
+    hash = (hash ^ (uint64_t)(uint32_t)request->timeout_ms) * 1099511628211ULL;
+
+    size_t mask = REPLAY_LOG_MAX_TEMPLATES * 2 - 1;
+    size_t slot = (size_t)hash & mask;
+    while (meta->template_slots[slot] >= 0) {
+        const replay_log_template_t* t = &meta->templates[meta->template_slots[slot]];
+        if (t->timeout_ms == request->timeout_ms && t->headers_len == request->headers_len &&
+            strcmp(meta->strings + t->method_off, request->method) == 0 &&
+            memcmp(meta->strings + t->headers_off, request->headers, request->headers_len) == 0) {
+            return meta->template_slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    if (meta->template_count == REPLAY_LOG_MAX_TEMPLATES) return -1;
+
+    replay_log_template_t* t = &meta->templates[meta->template_count];
+    if (meta_put(meta, request->method, method_len, &t->method_off) != 0 ||
+        meta_put(meta, request->headers, request->headers_len, &t->headers_off) != 0) {
+        return -1;
+    }
+    t->headers_len = (uint32_t)request->headers_len;
+    t->timeout_ms = request->timeout_ms;
+    meta->template_slots[slot] = meta->template_count;
+    return meta->template_count++;
+}
+
+/* Label id of the request; names past REPLAY_LOG_MAX_LABELS share "(other)" */
+static int meta_label(convert_meta_t* meta, const request_view_t* request) {
+    char name[REPLAY_LOG_LABEL_NAME_MAX];
+    request_label_name(request, name, sizeof(name));
+    const char* lookup = name;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t len = strlen(lookup);
+        size_t mask = (REPLAY_LOG_MAX_LABELS + 1) * 2 - 1;
+        size_t slot = (size_t)fnv1a(1469598103934665603ULL, lookup, len) & mask;
+        while (meta->label_slots[slot] >= 0) {
+            if (strcmp(meta->strings + meta->labels[meta->label_slots[slot]], lookup) == 0) {
+                return meta->label_slots[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        /* The last slot is kept for "(other)" */
+        if (meta->label_count < REPLAY_LOG_MAX_LABELS || pass == 1) {
+            if (meta_put(meta, lookup, len, &meta->labels[meta->label_count]) != 0) return -1;
+            meta->label_slots[slot] = meta->label_count;
+            return meta->label_count++;
+        }
+        lookup = "(other)";
+    }
+    return -1;
+}
+
+static int convert_fail(char* error, size_t error_len, const char* reason) {
+    if (error) snprintf(error, error_len, "%s", reason);
+    return -1;
+}
+
+static int copy_file(FILE* from, FILE* to) {
+    char* buffer = malloc(REPLAY_LOG_COPY_BUFFER);
+    if (!buffer) return -1;
+    rewind(from);
+    size_t n;
+    int rc = 0;
+    while ((n = fread(buffer, 1, REPLAY_LOG_COPY_BUFFER, from)) > 0) {
+        if (fwrite(buffer, 1, n, to) != n) {
+            rc = -1;
+            break;
+        }
+    }
+    if (ferror(from)) rc = -1;
+    free(buffer);
+    return rc;
+}
+
+/* Parse and write map[0..len) a chunk at a time */
+static int convert_requests(const char* map, size_t len, int threads, FILE* out, FILE* records,
+                            convert_meta_t* meta, replay_log_header_t* header,
+                            char* error, size_t error_len) {
+    request_table_t table;
+    request_table_init(&table);
+    long page = sysconf(_SC_PAGESIZE);
+    size_t released = 0;
+    int lines_before = 0;
+    int64_t first_us = -1;
+    uint64_t last_at_us = 0;
+    bool timestamps = true;
+    uint64_t data_off = sizeof(replay_log_header_t);
+    int rc = 0;
+
+    for (size_t pos = 0; pos < len && rc == 0;) {
+        size_t end = len - pos > REPLAY_LOG_CONVERT_CHUNK ? pos + REPLAY_LOG_CONVERT_CHUNK : len;
+        if (end < len) {
+            const char* nl = memchr(map + end, '\n', len - end);
+            end = nl ? (size_t)(nl - map) + 1 : len;
+        }
+
+        char chunk_error[256] = "";
+        request_table_clear(&table);
+        if (request_table_load_jsonl(&table, map + pos, end - pos, threads, chunk_error, sizeof(chunk_error)) < 0) {
+            int line = 0, consumed = 0;
+            if (sscanf(chunk_error, "line %d: %n", &line, &consumed) == 1 && consumed > 0) {
+                snprintf(error, error_len, "line %d: %s", lines_before + line, chunk_error + consumed);
+            } else {
+                snprintf(error, error_len, "%s", chunk_error[0] ? chunk_error : "parse failed");
+            }
+            rc = -1;
+            break;
+        }
+        if ((uint64_t)table.count > (uint64_t)INT32_MAX - header->count) {
+            rc = convert_fail(error, error_len, "too many requests");
+            break;
+        }
+
+        for (int i = 0; i < table.count; i++) {
+            request_view_t request;
+            request_table_get(&table, i, &request);
+            int template_id = meta_template(meta, &request);
+            if (template_id < 0) {
+                rc = convert_fail(error, error_len, meta->template_count == REPLAY_LOG_MAX_TEMPLATES
+                                  ? "more than 65536 distinct method/headers/timeout combinations"
+                                  : "out of memory");
+                break;
+            }
+            int label_id = meta_label(meta, &request);
+            if (label_id < 0) {
+                rc = convert_fail(error, error_len, "out of memory");
+                break;
+            }
+
+            /* Recorded offsets from the first request, kept in order */
+            uint64_t at_us = 0;
+            if (request.timestamp_us < 0) {
+                timestamps = false;
+            } else if (timestamps) {
+                if (first_us < 0) first_us = request.timestamp_us;
+                at_us = request.timestamp_us > first_us ? (uint64_t)(request.timestamp_us - first_us) : 0;
+                if (at_us < last_at_us) at_us = last_at_us;
+                last_at_us = at_us;
+            }
+
+            size_t url_len = strlen(request.url);
+            if (url_len > UINT32_MAX - 1 || request.body_len > UINT32_MAX - 1) {
+                rc = convert_fail(error, error_len, "request too large");
+                break;
+            }
+            replay_log_record_t record = {at_us, data_off, (uint32_t)url_len, (uint32_t)request.body_len,
+                                          (uint32_t)template_id, (uint32_t)label_id};
+            if (fwrite(request.url, 1, url_len + 1, out) != url_len + 1 ||
+                (request.body_len > 0 && fwrite(request.body, 1, request.body_len, out) != request.body_len) ||
+                fputc('\0', out) == EOF || fwrite(&record, sizeof(record), 1, records) != 1) {
+                rc = -2;
+                break;
+            }
+            data_off += url_len + request.body_len + 2;
+            header->count++;
+        }
+
+        for (const char* p = map + pos; (p = memchr(p, '\n', (size_t)(map + end - p))) != NULL; p++) lines_before++;
+
+        /* The input has been read: keep only the next chunk resident */
+        size_t drop = end & ~((size_t)page - 1);
+        if (drop > released) {
+            madvise((void*)(map + released), drop - released, MADV_DONTNEED);
+            released = drop;
+        }
+        pos = end;
+    }
+    request_table_free(&table);
+
+    if (timestamps && header->count > 0) {
+        header->flags |= REPLAY_LOG_TIMESTAMPS;
+        header->span_us = last_at_us;
+    }
+    header->records_off = data_off;
+    return rc;
+}
+
+int replay_log_convert_jsonl(const char* jsonl_path, const char* out_path, int threads,
+                             replay_log_info_t* info, char* error, size_t error_len) {
+    if (!jsonl_path || !out_path) return -1;
+    if (error && error_len > 0) error[0] = '\0';
+    if (!host_little_endian()) return convert_fail(error, error_len, "replay logs need a little-endian host");
+
+    int fd = open(jsonl_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -2;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        int saved = errno ? errno : EINVAL;
+        if (fstat(fd, &st) == 0 && S_ISDIR(st.st_mode)) saved = EISDIR;
+        close(fd);
+        errno = saved;
+        return -2;
+    }
+    const char* map = NULL;
+    if (st.st_size > 0) {
+        void* mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        int saved = errno;
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            errno = saved;
+            return -2;
+        }
+        map = mapped;
+        madvise(mapped, (size_t)st.st_size, MADV_SEQUENTIAL);
+    } else {
+        close(fd);
+    }
+
+    convert_meta_t* meta = calloc(1, sizeof(convert_meta_t));
+    FILE* out = fopen(out_path, "wb");
+    FILE* records = tmpfile();
+    int rc = 0;
+    int saved_errno = 0;
+    if (!meta) {
+        rc = convert_fail(error, error_len, "out of memory");
+    } else if (!out || !records) {
+        saved_errno = errno;
+        rc = -2;
+    }
+
+    replay_log_header_t header;
+    memset(&header, 0, sizeof(header));
+    if (rc == 0) {
+        memset(meta->template_slots, 0xff, sizeof(meta->template_slots));
+        memset(meta->label_slots, 0xff, sizeof(meta->label_slots));
+        /* Placeholder until the offsets are known */
+        if (fwrite(&header, sizeof(header), 1, out) != 1) rc = -2;
+    }
+    if (rc == 0) {
+        rc = convert_requests(map, (size_t)st.st_size, threads, out, records, meta, &header, error, error_len);
+        if (rc == -2) saved_errno = errno;
+    }
+    if (map) munmap((void*)map, (size_t)st.st_size);
+    if (rc == 0 && header.count == 0) rc = convert_fail(error, error_len, "no requests in the input");
+
+    if (rc == 0) {
+        static const char padding[8] = {0};
+        size_t pad = (size_t)(-header.records_off & 7);
+        header.records_off += pad;
+        header.data_off = sizeof(header);
+        header.templates_off = header.records_off + header.count * sizeof(replay_log_record_t);
+        header.labels_off = header.templates_off + (uint64_t)meta->template_count * sizeof(replay_log_template_t);
+        header.strings_off = header.labels_off + (uint64_t)meta->label_count * sizeof(uint64_t);
+        header.file_size = header.strings_off + meta->strings_len;
+        header.template_count = (uint32_t)meta->template_count;
+        header.label_count = (uint32_t)meta->label_count;
+        memcpy(header.magic, REPLAY_LOG_MAGIC, sizeof(header.magic));
+        header.version = REPLAY_LOG_VERSION;
+
+        for (int i = 0; i < meta->template_count; i++) {
+            meta->templates[i].method_off += header.strings_off;
+            meta->templates[i].headers_off += header.strings_off;
+        }
+        for (int i = 0; i < meta->label_count; i++) meta->labels[i] += header.strings_off;
+
+        if ((pad > 0 && fwrite(padding, 1, pad, out) != pad) || copy_file(records, out) != 0 ||
+            fwrite(meta->templates, sizeof(replay_log_template_t), (size_t)meta->template_count, out) !=
+                (size_t)meta->template_count ||
+            fwrite(meta->labels, sizeof(uint64_t), (size_t)meta->label_count, out) != (size_t)meta->label_count ||
+            fwrite(meta->strings, 1, meta->strings_len, out) != meta->strings_len ||
+            fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1) {
+            saved_errno = errno;
+            rc = -2;
+        }
+    }
+
+    if (out && fclose(out) != 0 && rc == 0) {
+        saved_errno = errno;
+        rc = -2;
+    }
+    if (records) fclose(records);
+    if (rc == 0 && info) {
+        info->requests = header.count;
+        info->templates = meta->template_count;
+        info->labels = meta->label_count;
+        info->timestamps = (header.flags & REPLAY_LOG_TIMESTAMPS) != 0;
+        info->span_us = header.span_us;
+    }
+    if (meta) free(meta->strings);
+    free(meta);
+    if (rc != 0 && out) unlink(out_path);
+    if (rc == -2) errno = saved_errno;
+    return rc;
+}
+
+/* ---- replay ---------------------------------------------------------------- */
+
+static bool string_in(const replay_log_t* log, uint64_t off, uint64_t len) {
+    const replay_log_header_t* h = log->header;
+    return off >= h->strings_off && off <= h->file_size && len < h->file_size - off &&
+           log->map[off + len] == '\0';
+}
+
+static replay_log_t* open_fail(replay_log_t* log, char* error, size_t error_len, const char* reason) {
+    if (error) snprintf(error, error_len, "%s", reason);
+    replay_log_close(log);
+    errno = 0;
+    return NULL;
+}
+
+replay_log_t* replay_log_open(const char* path, char* error, size_t error_len) {
+    if (error && error_len > 0) error[0] = '\0';
+    if (!path) return NULL;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+        return NULL;
+    }
+
+    replay_log_t* log = calloc(1, sizeof(replay_log_t));
+    if (!log) {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(replay_log_header_t)) {
+        close(fd);
+        return open_fail(log, error, error_len, "not a replay log (too short)");
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        free(log);
+        errno = saved;
+        return NULL;
+    }
+    log->map = map;
+    log->map_len = (size_t)st.st_size;
+    long page = sysconf(_SC_PAGESIZE);
+    log->page_size = page > 0 ? (size_t)page : 4096;
+
+    const replay_log_header_t* h = (const replay_log_header_t*)log->map;
+    log->header = h;
+    if (memcmp(h->magic, REPLAY_LOG_MAGIC, sizeof(h->magic)) != 0) {
+        return open_fail(log, error, error_len, "not a replay log");
+    }
+    if (!host_little_endian()) return open_fail(log, error, error_len, "replay logs need a little-endian host");
+    if (h->version != REPLAY_LOG_VERSION) return open_fail(log, error, error_len, "unsupported replay log version");
+
+    /* Sections in order, each where the previous one ends */
+    if (h->file_size != (uint64_t)st.st_size || h->data_off != sizeof(replay_log_header_t) ||
+        h->count == 0 || h->count > INT32_MAX || h->records_off < h->data_off || h->records_off % 8 != 0 ||
+        h->template_count == 0 || h->template_count > REPLAY_LOG_MAX_TEMPLATES ||
+        h->label_count == 0 || h->label_count > REPLAY_LOG_MAX_LABELS + 1 ||
+        h->records_off > h->file_size || h->count > (h->file_size - h->records_off) / sizeof(replay_log_record_t) ||
+        h->templates_off != h->records_off + h->count * sizeof(replay_log_record_t) ||
+        h->labels_off != h->templates_off + (uint64_t)h->template_count * sizeof(replay_log_template_t) ||
+        h->strings_off != h->labels_off + (uint64_t)h->label_count * sizeof(uint64_t) ||
+        h->strings_off > h->file_size) {
+        return open_fail(log, error, error_len, "corrupt replay log (bad section offsets)");
+    }
+    log->records = (const replay_log_record_t*)(log->map + h->records_off);
+    log->templates = (const replay_log_template_t*)(log->map + h->templates_off);
+    log->labels = (const uint64_t*)(log->map + h->labels_off);
+
+    /* Templates and labels are few; check them all now, records as they are read */
+    for (uint32_t i = 0; i < h->template_count; i++) {
+        const replay_log_template_t* t = &log->templates[i];
+        if (!string_in(log, t->method_off, strnlen((const char*)log->map + t->method_off,
+                                                   t->method_off < h->file_size ? h->file_size - t->method_off : 0)) ||
+            !string_in(log, t->headers_off, t->headers_len)) {
+            return open_fail(log, error, error_len, "corrupt replay log (bad template)");
+        }
+    }
+    for (uint32_t i = 0; i < h->label_count; i++) {
+        uint64_t off = log->labels[i];
+        if (!string_in(log, off, strnlen((const char*)log->map + off, off < h->file_size ? h->file_size - off : 0))) {
+            return open_fail(log, error, error_len, "corrupt replay log (bad label)");
+        }
+    }
+
+    log->data.start = h->data_off;
+    log->data.end = h->records_off;
+    atomic_init(&log->data.mark, h->data_off);
+    log->record_stream.start = h->records_off;
+    log->record_stream.end = h->templates_off;
+    atomic_init(&log->record_stream.mark, h->records_off);
+    madvise(map, (size_t)h->templates_off, MADV_SEQUENTIAL);
+    size_t meta_start = (size_t)h->templates_off & ~(log->page_size - 1);
+    madvise((uint8_t*)map + meta_start, log->map_len - meta_start, MADV_WILLNEED);
+
+    log->info.requests = h->count;
+    log->info.templates = (int)h->template_count;
+    log->info.labels = (int)h->label_count;
+    log->info.timestamps = (h->flags & REPLAY_LOG_TIMESTAMPS) != 0;
+    log->info.span_us = log->info.timestamps ? h->span_us : 0;
+    return log;
+}
+
+void replay_log_close(replay_log_t* log) {
+    if (!log) return;
+    if (log->map) munmap((void*)log->map, log->map_len);
+    free(log);
+}
+
+/* Drop the pages of `stream` that dispatch, now at pos, has left well behind */
+static void stream_release(replay_log_t* log, replay_log_stream_t* stream, uint64_t pos) {
+    uint64_t mark = atomic_load_explicit(&stream->mark, memory_order_relaxed);
+    uint64_t page_mask = ~((uint64_t)log->page_size - 1);
+    if (pos >= mark + 2 * (uint64_t)REPLAY_LOG_RELEASE_BYTES) {
+        uint64_t upto = (pos - REPLAY_LOG_RELEASE_BYTES) & page_mask;
+        uint64_t from = mark & page_mask;
+        if (upto > from && atomic_compare_exchange_strong(&stream->mark, &mark, upto)) {
+            madvise((void*)(log->map + from), (size_t)(upto - from), MADV_DONTNEED);
+        }
+    } else if (pos + 2 * (uint64_t)REPLAY_LOG_RELEASE_BYTES < mark) {
+        /* A looping test wrapped around; the last pass left its tail resident */
+        uint64_t from = mark & page_mask;
+        if (atomic_compare_exchange_strong(&stream->mark, &mark, stream->start) && stream->end > from) {
+            madvise((void*)(log->map + from), (size_t)(stream->end - from), MADV_DONTNEED);
+        }
+    }
+}
+
+int replay_log_get(replay_log_t* log, uint64_t index, request_view_t* view, uint64_t* at_us) {
+    if (!log || !view || index >= log->header->count) return -1;
+    const replay_log_header_t* h = log->header;
+    const replay_log_record_t* record = &log->records[index];
+    if (record->template_id >= h->template_count || record->label_id >= h->label_count ||
+        record->data_off < h->data_off || record->data_off > h->records_off ||
+        (uint64_t)record->url_len + record->body_len + 2 > h->records_off - record->data_off) {
+        return -1;
+    }
+    const char* url = (const char*)log->map + record->data_off;
+    if (url[record->url_len] != '\0' || url[record->url_len + 1 + record->body_len] != '\0') return -1;
+
+    stream_release(log, &log->record_stream, h->records_off + index * sizeof(replay_log_record_t));
+    stream_release(log, &log->data, record->data_off);
+
+    const replay_log_template_t* t = &log->templates[record->template_id];
+    view->index = (int)index;
+    view->method = (const char*)log->map + t->method_off;
+    view->url = url;
+    view->headers = (const char*)log->map + t->headers_off;
+    view->headers_len = t->headers_len;
+    view->body = url + record->url_len + 1;
+    view->body_len = record->body_len;
+    view->label = (const char*)log->map + log->labels[record->label_id];
+    view->timeout_ms = t->timeout_ms;
+    view->template_id = (int)record->template_id;
+    view->label_id = (int)record->label_id;
+    view->sequence = 0;
+    view->timestamp_us = log->info.timestamps ? (int64_t)record->at_us : -1;
+    if (at_us) *at_us = log->info.timestamps ? record->at_us : 0;
+    return 0;
+}
+
+int replay_log_template(const replay_log_t* log, int id, request_view_t* view) {
+    if (!log || !view || id < 0 || (uint32_t)id >= log->header->template_count) return -1;
+    const replay_log_template_t* t = &log->templates[id];
+    memset(view, 0, sizeof(*view));
+    view->index = id;
+    view->method = (const char*)log->map + t->method_off;
+    view->url = "";
+    view->headers = (const char*)log->map + t->headers_off;
+    view->headers_len = t->headers_len;
+    view->body = "";
+    view->label = "";
+    view->timeout_ms = t->timeout_ms;
+    view->timestamp_us = -1;
+    view->template_id = id;
+    view->label_id = -1;
+    return 0;
+}
+
+const char* replay_log_label(const replay_log_t* log, int id) {
+    if (!log || id < 0 || (uint32_t)id >= log->header->label_count) return NULL;
+    return (const char*)log->map + log->labels[id];
+}
@@ -0,0 +1,130 @@
+#ifndef REPLAY_LOG_H
+#define REPLAY_LOG_H
+
+/*
+ * Memory-mapped replay logs: request sets too large to hold in memory.
+ *
+ * A replay log is a compact binary file built once from JSON Lines (the
+ * request_jsonl.h format). Everything a load test derives per request up
+ * front is resolved at conversion time: requests that share a method,
+ * header block and timeout share one template, and every request carries
+ * the id of its metrics label. An open log is only an mmap of the file.
+ * Dispatch reads records in order through MADV_SEQUENTIAL read-ahead and
+ * drops the pages it has passed, so resident memory stays at a few
+ * read-ahead windows however long the log is.
+ *
+ * File layout, all integers little-endian:
+ *
+ *   header      replay_log_header_t
+ *   data        per request, in order: url NUL body NUL
+ *   records     count x replay_log_record_t (8-byte aligned)
+ *   templates   template_count x replay_log_template_t
+ *   labels      label_count x uint64_t, offsets of NUL-terminated names
+ *   strings     template methods, header blocks and label names
+ *
+ * Offsets are from the start of the file. With REPLAY_LOG_TIMESTAMPS set
+ * each record's at_us is its recorded send time relative to the first
+ * request (never decreasing), so a test can reproduce the original
+ * inter-arrival gaps.
+ */
+
+#include "request_table.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REPLAY_LOG_MAGIC "LSREPLAY"
+#define REPLAY_LOG_VERSION 1
+#define REPLAY_LOG_TIMESTAMPS 0x1u          /* every record has a recorded at_us */
+#define REPLAY_LOG_MAX_TEMPLATES 65536      /* distinct (method, headers, timeout) combinations */
+#define REPLAY_LOG_MAX_LABELS 63            /* as many as the engine tracks; the rest share "(other)" */
+#define REPLAY_LOG_CONVERT_CHUNK (64u << 20)      /* JSONL bytes parsed per batch while converting */
+#define REPLAY_LOG_RELEASE_BYTES (16u << 20)      /* dispatch drops pages this far behind itself */
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t count;
+    uint64_t span_us;              /* at_us of the last record */
+    uint64_t data_off;
+    uint64_t records_off;
+    uint64_t templates_off;
+    uint64_t labels_off;
+    uint64_t strings_off;
+    uint64_t file_size;
+    uint32_t template_count;
+    uint32_t label_count;
+} replay_log_header_t;
+
+typedef struct {
+    uint64_t at_us;
+    uint64_t data_off;             /* url, then body */
+    uint32_t url_len;
+    uint32_t body_len;
+    uint32_t template_id;
+    uint32_t label_id;
+} replay_log_record_t;
+
+typedef struct {
+    uint64_t method_off;
+    uint64_t headers_off;
+    uint32_t headers_len;
+    int32_t timeout_ms;
+} replay_log_template_t;
+
+typedef struct {
+    uint64_t requests;
+    int templates;
+    int labels;
+    bool timestamps;
+    uint64_t span_us;
+} replay_log_info_t;
+
+/* One mapped region consumed front to back; pages before `mark` are gone */
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    _Atomic uint64_t mark;
+} replay_log_stream_t;
+
+typedef struct replay_log {
+    const uint8_t* map;
+    size_t map_len;
+    size_t page_size;
+    const replay_log_header_t* header;
+    const replay_log_record_t* records;
+    const replay_log_template_t* templates;
+    const uint64_t* labels;
+    replay_log_stream_t data;
+    replay_log_stream_t record_stream;
+    replay_log_info_t info;
+} replay_log_t;
+
+// Convert the JSONL file at jsonl_path into a replay log at out_path,
+// parsing REPLAY_LOG_CONVERT_CHUNK at a time on `threads` threads (<= 0:
+// one per CPU), so memory use does not grow with the input. Timestamps are
+// kept when every line has one. Returns 0 and fills info (may be NULL);
+// -1 with "line N: reason" (or another reason) in error; -2 with errno set
+// when a file cannot be read or written. out_path is removed on failure.
+int replay_log_convert_jsonl(const char* jsonl_path, const char* out_path, int threads,
+                             replay_log_info_t* info, char* error, size_t error_len);
+
+// Map the replay log at path and check its structure. NULL with the reason
+// in error, and errno set when the file itself could not be opened.
+replay_log_t* replay_log_open(const char* path, char* error, size_t error_len);
+void replay_log_close(replay_log_t* log);
+
+// Request `index` (0..count-1), pointing into the mapping; *at_us gets its
+// recorded offset (0 without timestamps). template_id and label_id are the
+// log's own ids. Drops the pages dispatch has left behind; safe to call
+// from many threads at once.
+int replay_log_get(replay_log_t* log, uint64_t index, request_view_t* view, uint64_t* at_us);
+
+// Template `id` as a request view (method, headers, timeout; no url/body),
+// and label `id`'s name
+int replay_log_template(const replay_log_t* log, int id, request_view_t* view);
+const char* replay_log_label(const replay_log_t* log, int id);
+
+#endif /* REPLAY_LOG_H */
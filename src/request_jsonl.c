@@ -0,0 +1,518 @@
+#include "request_jsonl.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define JSONL_MAX_DEPTH 64          /* nesting allowed inside ignored values */
+#define JSONL_DEFAULT_TIMEOUT_MS 30000
+
+typedef struct {
+    const char* p;
+    const char* end;
+} cursor_t;
+
+/* Decoded strings of the line being parsed, NUL-separated; fields hold
+   offsets because the buffer grows */
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} scratch_t;
+
+typedef struct {
+    size_t off;
+    size_t len;
+    bool set;
+} field_t;
+
+/* One thread's share of the input */
+typedef struct {
+    const char* start;
+    const char* end;
+    request_table_t table;
+    scratch_t scratch;
+    int lines;                  /* newlines seen, for numbering errors of later chunks */
+    int error_line;             /* 1-based within the chunk, 0 = no error */
+    char error[128];
+} jsonl_chunk_t;
+
+static int parse_fail(jsonl_chunk_t* chunk, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(chunk->error, sizeof(chunk->error), fmt, ap);
+    va_end(ap);
+    return -1;
+}
+
+static void skip_ws(cursor_t* c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r')) c->p++;
+}
+
+static int scratch_put(scratch_t* s, const char* data, size_t len) {
+    if (s->len + len > s->cap) {
+        size_t cap = s->cap ? s->cap : 1024;
+        while (cap < s->len + len) cap *= 2;
+        char* grown = realloc(s->data, cap);
+        if (!grown) return -1;
+        s->data = grown;
+        s->cap = cap;
+    }
+    memcpy(s->data + s->len, data, len);
+    s->len += len;
+    return 0;
+}
+
+static int hex4(const char* p, unsigned* out) {
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) {
+        char h = p[i];
+        v <<= 4;
+        if (h >= '0' && h <= '9') v |= (unsigned)(h - '0');
+        else if (h >= 'a' && h <= 'f') v |= (unsigned)(h - 'a' + 10);
+        else if (h >= 'A' && h <= 'F') v |= (unsigned)(h - 'A' + 10);
+        else return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+/* Decode the string at c (opening quote included) onto the scratch buffer,
+   or just step over it when out is NULL */
+static int parse_string(jsonl_chunk_t* chunk, cursor_t* c, scratch_t* out) {
+    if (c->p >= c->end || *c->p != '"') return parse_fail(chunk, "expected a string");
+    c->p++;
+    for (;;) {
+        const char* run = c->p;
+        while (c->p < c->end && *c->p != '"' && *c->p != '\\') c->p++;
+        if (out && c->p > run && scratch_put(out, run, (size_t)(c->p - run)) != 0) {
+            return parse_fail(chunk, "out of memory");
+        }
+        if (c->p >= c->end) return parse_fail(chunk, "unterminated string");
+        if (*c->p == '"') {
+            c->p++;
+            return 0;
+        }
+
+        /* escape */
+        if (c->end - c->p < 2) return parse_fail(chunk, "unterminated string");
+        char esc = c->p[1];
+        c->p += 2;
+        char byte;
+        switch (esc) {
+            case '"': byte = '"'; break;
+            case '\\': byte = '\\'; break;
+            case '/': byte = '/'; break;
+            case 'b': byte = '\b'; break;
+            case 'f': byte = '\f'; break;
+            case 'n': byte = '\n'; break;
+            case 'r': byte = '\r'; break;
+            case 't': byte = '\t'; break;
+            case 'u': {
+                unsigned cp;
+                if (c->end - c->p < 4 || hex4(c->p, &cp) != 0) return parse_fail(chunk, "invalid \\u escape");
+                c->p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    unsigned low;
+                    if (c->end - c->p < 6 || c->p[0] != '\\' || c->p[1] != 'u' || hex4(c->p + 2, &low) != 0 ||
+                        low < 0xDC00 || low > 0xDFFF) {
+                        return parse_fail(chunk, "invalid \\u escape");
+                    }
+                    c->p += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return parse_fail(chunk, "invalid \\u escape");
+                }
+                char utf8[4];
+                size_t n;
+                if (cp < 0x80) {
+                    utf8[0] = (char)cp;
+                    n = 1;
+                } else if (cp < 0x800) {
+                    utf8[0] = (char)(0xC0 | (cp >> 6));
+                    utf8[1] = (char)(0x80 | (cp & 0x3F));
+                    n = 2;
+                } else if (cp < 0x10000) {
+                    utf8[0] = (char)(0xE0 | (cp >> 12));
+                    utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    utf8[2] = (char)(0x80 | (cp & 0x3F));
+                    n = 3;
+                } else {
+                    utf8[0] = (char)(0xF0 | (cp >> 18));
+                    utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+                    utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    utf8[3] = (char)(0x80 | (cp & 0x3F));
+                    n = 4;
+                }
+                if (out && scratch_put(out, utf8, n) != 0) return parse_fail(chunk, "out of memory");
+                continue;
+            }
+            default:
+                return parse_fail(chunk, "invalid escape '\\%c'", esc);
+        }
+        if (out && scratch_put(out, &byte, 1) != 0) return parse_fail(chunk, "out of memory");
+    }
+}
+
+/* A string value into f, NUL-terminated on the scratch buffer */
+static int parse_field(jsonl_chunk_t* chunk, cursor_t* c, field_t* f, const char* key) {
+    if (c->p < c->end && *c->p != '"') {
+        if (c->end - c->p >= 4 && memcmp(c->p, "null", 4) == 0) {
+            c->p += 4;
+            f->set = false;
+            return 0;
+        }
+        return parse_fail(chunk, "\"%s\" must be a string", key);
+    }
+    f->off = chunk->scratch.len;
+    if (parse_string(chunk, c, &chunk->scratch) != 0) return -1;
+    f->len = chunk->scratch.len - f->off;
+    f->set = true;
+    return scratch_put(&chunk->scratch, "", 1) == 0 ? 0 : parse_fail(chunk, "out of memory");
+}
+
+static int skip_value(jsonl_chunk_t* chunk, cursor_t* c, int depth) {
+    if (depth > JSONL_MAX_DEPTH) return parse_fail(chunk, "nesting too deep");
+    skip_ws(c);
+    if (c->p >= c->end) return parse_fail(chunk, "expected a value");
+    char open = *c->p;
+    if (open == '"') return parse_string(chunk, c, NULL);
+    if (open == '{' || open == '[') {
+        char close = open == '{' ? '}' : ']';
+        c->p++;
+        skip_ws(c);
+        if (c->p < c->end && *c->p == close) {
+            c->p++;
+            return 0;
+        }
+        for (;;) {
+            if (open == '{') {
+                skip_ws(c);
+                if (parse_string(chunk, c, NULL) != 0) return -1;
+                skip_ws(c);
+                if (c->p >= c->end || *c->p != ':') return parse_fail(chunk, "expected ':'");
+                c->p++;
+            }
+            if (skip_value(chunk, c, depth + 1) != 0) return -1;
+            skip_ws(c);
+            if (c->p < c->end && *c->p == ',') {
+                c->p++;
+                continue;
+            }
+            if (c->p < c->end && *c->p == close) {
+                c->p++;
+                return 0;
+            }
+            return parse_fail(chunk, "expected ',' or '%c'", close);
+        }
+    }
+    /* number, true, false, null */
+    const char* start = c->p;
+    while (c->p < c->end && ((*c->p && strchr("+-.eE", *c->p)) || (*c->p >= '0' && *c->p <= '9') ||
+                             (*c->p >= 'a' && *c->p <= 'z'))) {
+        c->p++;
+    }
+    return c->p > start ? 0 : parse_fail(chunk, "unexpected '%c'", *start);
+}
+
+/* A JSON number at c; -1.0 when there is none (callers only accept >= 0) */
+static double parse_number(cursor_t* c) {
+    char number[32];
+    size_t n = 0;
+    while (c->p < c->end && n < sizeof(number) - 1 &&
+           ((*c->p && strchr("+-.eE", *c->p)) || (*c->p >= '0' && *c->p <= '9'))) {
+        number[n++] = *c->p++;
+    }
+    number[n] = '\0';
+    char* tail;
+    double v = n > 0 ? strtod(number, &tail) : -1.0;
+    return n > 0 && *tail == '\0' ? v : -1.0;
+}
+
+static int parse_timeout(jsonl_chunk_t* chunk, cursor_t* c, int* timeout_ms) {
+    double v = parse_number(c);
+    if (v < 0.0 || v > INT_MAX || v != (double)(int)v) {
+        return parse_fail(chunk, "\"timeout_ms\" must be a whole number of milliseconds");
+    }
+    *timeout_ms = (int)v;
+    return 0;
+}
+
+/* "timestamp": when the request was recorded, in seconds (epoch or any origin) */
+static int parse_timestamp(jsonl_chunk_t* chunk, cursor_t* c, int64_t* timestamp_us) {
+    double v = parse_number(c);
+    if (!(v >= 0.0 && v < 9.0e12)) {
+        return parse_fail(chunk, "\"timestamp\" must be a number of seconds >= 0");
+    }
+    *timestamp_us = (int64_t)(v * 1000000.0 + 0.5);
+    return 0;
+}
+
+/* "headers": {"Name": "value", ...} becomes "Name: value\nName: value" */
+static int parse_headers(jsonl_chunk_t* chunk, cursor_t* c, field_t* f) {
+    if (c->p >= c->end || *c->p != '{') return parse_field(chunk, c, f, "headers");
+    scratch_t* s = &chunk->scratch;
+    c->p++;
+    f->off = s->len;
+    f->set = true;
+    bool first = true;
+    skip_ws(c);
+    if (c->p < c->end && *c->p == '}') {
+        c->p++;
+    } else {
+        for (;;) {
+            skip_ws(c);
+            if (!first && scratch_put(s, "\n", 1) != 0) return parse_fail(chunk, "out of memory");
+            first = false;
+            if (parse_string(chunk, c, s) != 0) return -1;
+            skip_ws(c);
+            if (c->p >= c->end || *c->p != ':') return parse_fail(chunk, "expected ':'");
+            c->p++;
+            skip_ws(c);
+            if (c->p >= c->end || *c->p != '"') return parse_fail(chunk, "header values must be strings");
+            if (scratch_put(s, ": ", 2) != 0) return parse_fail(chunk, "out of memory");
+            if (parse_string(chunk, c, s) != 0) return -1;
+            skip_ws(c);
+            if (c->p < c->end && *c->p == ',') {
+                c->p++;
+                continue;
+            }
+            if (c->p < c->end && *c->p == '}') {
+                c->p++;
+                break;
+            }
+            return parse_fail(chunk, "expected ',' or '}'");
+        }
+    }
+    f->len = s->len - f->off;
+    return scratch_put(s, "", 1) == 0 ? 0 : parse_fail(chunk, "out of memory");
+}
+
+static int parse_line(jsonl_chunk_t* chunk, const char* line, const char* end) {
+    cursor_t c = {line, end};
+    skip_ws(&c);
+    if (c.p == c.end) return 0;          /* blank line */
+    if (*c.p != '{') return parse_fail(chunk, "expected a JSON object");
+    c.p++;
+
+    chunk->scratch.len = 0;
+    field_t method = {0}, url = {0}, headers = {0}, body = {0}, name = {0};
+    int timeout_ms = JSONL_DEFAULT_TIMEOUT_MS;
+    int64_t timestamp_us = -1;
+
+    skip_ws(&c);
+    if (c.p < c.end && *c.p == '}') {
+        c.p++;
+    } else {
+        for (;;) {
+            skip_ws(&c);
+            /* Keys are matched raw: the ones we know need no escapes */
+            if (c.p >= c.end || *c.p != '"') return parse_fail(chunk, "expected a key");
+            const char* key = c.p + 1;
+            if (parse_string(chunk, &c, NULL) != 0) return -1;
+            size_t key_len = (size_t)(c.p - key - 1);
+            skip_ws(&c);
+            if (c.p >= c.end || *c.p != ':') return parse_fail(chunk, "expected ':'");
+            c.p++;
+            skip_ws(&c);
+
+#define KEY_IS(k) (key_len == sizeof(k) - 1 && memcmp(key, k, key_len) == 0)
+            int rc;
+            if (KEY_IS("url")) rc = parse_field(chunk, &c, &url, "url");
+            else if (KEY_IS("method")) rc = parse_field(chunk, &c, &method, "method");
+            else if (KEY_IS("headers")) rc = parse_headers(chunk, &c, &headers);
+            else if (KEY_IS("body")) rc = parse_field(chunk, &c, &body, "body");
+            else if (KEY_IS("name")) rc = parse_field(chunk, &c, &name, "name");
+            else if (KEY_IS("timeout_ms")) rc = parse_timeout(chunk, &c, &timeout_ms);
+            else if (KEY_IS("timestamp")) rc = parse_timestamp(chunk, &c, &timestamp_us);
+            else rc = skip_value(chunk, &c, 0);
+#undef KEY_IS
+            if (rc != 0) return -1;
+
+            skip_ws(&c);
+            if (c.p < c.end && *c.p == ',') {
+                c.p++;
+                continue;
+            }
+            if (c.p < c.end && *c.p == '}') {
+                c.p++;
+                break;
+            }
+            return parse_fail(chunk, "expected ',' or '}'");
+        }
+    }
+    skip_ws(&c);
+    if (c.p != c.end) return parse_fail(chunk, "trailing characters after the object");
+    if (!url.set || url.len == 0) return parse_fail(chunk, "missing \"url\"");
+
+    const char* s = chunk->scratch.data;
+    int index = request_table_add_labeled(&chunk->table,
+                                          method.set ? s + method.off : NULL,
+                                          s + url.off,
+                                          headers.set ? s + headers.off : NULL,
+                                          body.set ? s + body.off : NULL, body.set ? body.len : 0,
+                                          timeout_ms,
+                                          name.set ? s + name.off : NULL);
+    if (index < 0) return parse_fail(chunk, "out of memory");
+    chunk->table.entries[index].timestamp_us = timestamp_us;
+    return 0;
+}
+
+static void* parse_chunk(void* arg) {
+    jsonl_chunk_t* chunk = (jsonl_chunk_t*)arg;
+    const char* p = chunk->start;
+    while (p < chunk->end) {
+        const char* nl = memchr(p, '\n', (size_t)(chunk->end - p));
+        const char* line_end = nl ? nl : chunk->end;
+        if (parse_line(chunk, p, line_end) != 0) {
+            chunk->error_line = chunk->lines + 1;
+            break;
+        }
+        if (!nl) break;
+        chunk->lines++;
+        p = nl + 1;
+    }
+    return NULL;
+}
+
+static int jsonl_threads(int threads, size_t len) {
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    size_t by_size = len / REQUEST_JSONL_MIN_CHUNK + 1;
+    if ((size_t)threads > by_size) threads = (int)by_size;
+    if (threads > REQUEST_JSONL_MAX_THREADS) threads = REQUEST_JSONL_MAX_THREADS;
+    return threads;
+}
+
+int request_table_load_jsonl(request_table_t* table, const char* data, size_t len, int threads,
+                             char* error, size_t error_len) {
+    if (!table || (!data && len > 0)) return -1;
+    if (error && error_len > 0) error[0] = '\0';
+    int n = jsonl_threads(threads, len);
+
+    jsonl_chunk_t* chunks = calloc((size_t)n, sizeof(jsonl_chunk_t));
+    pthread_t* tids = calloc((size_t)n, sizeof(pthread_t));
+    bool* started = calloc((size_t)n, sizeof(bool));
+    if (!chunks || !tids || !started) {
+        free(chunks); free(tids); free(started);
+        if (error) snprintf(error, error_len, "out of memory");
+        return -1;
+    }
+
+    /* Cut at the first newline at or after each even split */
+    const char* end = data + len;
+    const char* p = data;
+    for (int i = 0; i < n; i++) {
+        chunks[i].start = p;
+        const char* cut = i == n - 1 ? end : data + len / (size_t)n * (size_t)(i + 1);
+        if (cut < p) cut = p;
+        if (cut < end) {
+            const char* nl = memchr(cut, '\n', (size_t)(end - cut));
+            cut = nl ? nl + 1 : end;
+        }
+        chunks[i].end = cut;
+        request_table_init(&chunks[i].table);
+        p = cut;
+    }
+
+    /* Chunk 0 runs here; a thread that fails to start is parsed here too */
+    for (int i = 1; i < n; i++) {
+        started[i] = pthread_create(&tids[i], NULL, parse_chunk, &chunks[i]) == 0;
+    }
+    parse_chunk(&chunks[0]);
+    for (int i = 1; i < n; i++) {
+        if (started[i]) pthread_join(tids[i], NULL);
+        else parse_chunk(&chunks[i]);
+    }
+
+    int rc = 0;
+    int line_base = 0;
+    for (int i = 0; i < n; i++) {
+        if (chunks[i].error_line) {
+            if (error) snprintf(error, error_len, "line %d: %s", line_base + chunks[i].error_line, chunks[i].error);
+            rc = -1;
+            break;
+        }
+        line_base += chunks[i].lines;
+    }
+
+    if (rc == 0) {
+        int total = 0;
+        for (int i = 0; i < n; i++) {
+            if (chunks[i].table.count > INT_MAX - table->count - total) {
+                if (error) snprintf(error, error_len, "too many requests");
+                rc = -1;
+                break;
+            }
+            total += chunks[i].table.count;
+        }
+        if (rc == 0) {
+            /* Merge into a private table first so a failure leaves table untouched */
+            request_table_t merged;
+            request_table_init(&merged);
+            for (int i = 0; i < n && rc == 0; i++) {
+                if (request_table_append(&merged, &chunks[i].table) != 0) rc = -1;
+            }
+            if (rc == 0 && request_table_append(table, &merged) != 0) rc = -1;
+            if (rc != 0 && error) snprintf(error, error_len, "out of memory");
+            request_table_free(&merged);
+            if (rc == 0) rc = total;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        request_table_free(&chunks[i].table);
+        free(chunks[i].scratch.data);
+    }
+    free(chunks);
+    free(tids);
+    free(started);
+    return rc;
+}
+
+int request_table_load_jsonl_file(request_table_t* table, const char* path, int threads,
+                                  char* error, size_t error_len) {
+    if (!table || !path) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -2;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -2;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+        return -2;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return request_table_load_jsonl(table, "", 0, threads, error, error_len);
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = saved;
+        return -2;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    int rc = request_table_load_jsonl(table, (const char*)map, (size_t)st.st_size, threads, error, error_len);
+    munmap(map, (size_t)st.st_size);
+    return rc;
+}
@@ -0,0 +1,39 @@
+#ifndef REQUEST_JSONL_H
+#define REQUEST_JSONL_H
+
+/*
+ * Bulk loading of load-test requests from JSON Lines.
+ *
+ * One JSON object per line, with the same keys start_load_test() takes in
+ * a request dict:
+ *
+ *   {"method": "POST", "url": "http://host/api", "headers": {"X-Id": "7"},
+ *    "body": "{\"a\": 1}", "timeout_ms": 5000, "name": "create"}
+ *
+ * Only "url" is required. "headers" is an object or a string of '\n'-
+ * separated "Name: value" lines; "timestamp" (seconds, from any origin) is
+ * when the request was recorded, which replay logs can reproduce; other keys
+ * are ignored and blank lines skipped. The input is cut into chunks at line boundaries and each chunk
+ * is parsed on its own thread into a private table, so neither the caller's
+ * lock (the GIL) nor a shared allocator is touched per request; the chunks
+ * are then appended to the caller's table in input order.
+ */
+
+#include "request_table.h"
+#include <stddef.h>
+
+#define REQUEST_JSONL_MAX_THREADS 16
+#define REQUEST_JSONL_MIN_CHUNK (1 << 20)   /* bytes per thread before another one is worth starting */
+
+// Append the requests in data[0..len) to table. threads <= 0 picks one per
+// CPU, capped by the input size. Returns the number of requests added, or
+// -1 with "line N: reason" in error; table is left as it was on failure.
+int request_table_load_jsonl(request_table_t* table, const char* data, size_t len, int threads,
+                             char* error, size_t error_len);
+
+// Same, reading the file at path. Returns -2 with errno set when the file
+// cannot be read.
+int request_table_load_jsonl_file(request_table_t* table, const char* path, int threads,
+                                  char* error, size_t error_len);
+
+#endif /* REQUEST_JSONL_H */
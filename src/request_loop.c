@@ -0,0 +1,365 @@
+#include "engine_internal.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Non-blocking single requests.
+ *
+ * engine_execute_request_sync() ties up its calling thread for the whole
+ * transfer, so a caller that wants many requests in flight needs as many
+ * threads. Here every request becomes an easy handle on the engine's own
+ * multi handle, driven by one loop thread: callers submit and go on, and
+ * collect finished responses when the completion pipe turns readable (from
+ * their own event loop, e.g. asyncio's add_reader). Connections stay in the
+ * multi handle's cache between requests, up to max_connections open.
+ *
+ * Collected jobs go back to a spare list with their easy handle, and a
+ * job's header list is built in its own scratch, so a steady stream of
+ * requests allocates nothing once the spare list has filled.
+ */
+
+#define REQUEST_LOOP_IDLE_WAIT_MS 1000   /* curl_multi_poll bound; submits and shutdown wake it early */
+#define REQUEST_LOOP_SPARE_JOBS 64       /* collected jobs kept for reuse */
+#define REQUEST_JOB_SCRATCH (MAX_HEADER_LENGTH + 128 * sizeof(struct curl_slist))
+
+typedef struct request_job {
+    struct request_job* next;       /* submitted / active / done list */
+    struct request_job* prev;       /* active list only */
+    uint64_t ticket;
+    CURL* easy;                     /* kept across reuses */
+    void* header_heap;              /* headers that outgrew scratch, or NULL */
+    response_buffer_t body;         /* write straight into response.body / .headers */
+    header_buffer_t headers;
+    uint64_t start_us;
+    http_response_t response;
+    scratch_arena_t scratch;        /* over scratch_space */
+    char scratch_space[REQUEST_JOB_SCRATCH];
+} request_job_t;
+
+struct request_loop {
+    engine_t* engine;
+    pthread_t thread;
+    pthread_mutex_t mutex;          /* guards everything below but `active` */
+    request_job_t* submitted;       /* waiting for the loop thread, oldest first */
+    request_job_t* submitted_tail;
+    request_job_t* done;            /* waiting to be collected, oldest first */
+    request_job_t* done_tail;
+    request_job_t* spare;           /* collected, ready for reuse */
+    int spare_count;
+    uint64_t next_ticket;
+    bool shutdown;
+    bool signalled;                 /* the pipe holds one byte; true iff done is non-empty */
+    int notify_fds[2];
+    request_job_t* active;          /* in the multi handle; loop thread only */
+};
+
+static void job_free(request_job_t* job) {
+    if (job->easy) curl_easy_cleanup(job->easy);
+    free(job->header_heap);
+    free(job);
+}
+
+/* A spare job, or a new one */
+static request_job_t* job_take(request_loop_t* loop) {
+    lock_stats_lock(&loop->mutex, LOCK_SITE_REQUEST_LOOP);
+    request_job_t* job = loop->spare;
+    if (job) {
+        loop->spare = job->next;
+        loop->spare_count--;
+    }
+    pthread_mutex_unlock(&loop->mutex);
+
+    if (job) {
+        curl_easy_reset(job->easy);
+        job->response.status_code = 0;
+        job->response.headers[0] = '\0';
+        job->response.body[0] = '\0';
+        job->response.response_time_us = 0;
+        job->response.success = false;
+        job->response.error_message[0] = '\0';
+        job->body.size = 0;
+        job->headers.size = 0;
+        job->next = job->prev = NULL;
+        return job;
+    }
+
+    job = calloc(1, sizeof(request_job_t));
+    if (!job) return NULL;
+    scratch_count_heap_allocation();
+    job->easy = curl_easy_init();
+    if (!job->easy) {
+        free(job);
+        return NULL;
+    }
+    job->body.data = job->response.body;
+    job->body.capacity = MAX_BODY_LENGTH;
+    job->headers.data = job->response.headers;
+    job->headers.capacity = MAX_HEADER_LENGTH;
+    scratch_arena_wrap(&job->scratch, job->scratch_space, sizeof(job->scratch_space));
+    return job;
+}
+
+/* Keep a collected job for the next submit, or free it once enough are kept */
+static void job_recycle(request_loop_t* loop, request_job_t* job) {
+    free(job->header_heap);
+    job->header_heap = NULL;
+    lock_stats_lock(&loop->mutex, LOCK_SITE_REQUEST_LOOP);
+    if (loop->spare_count < REQUEST_LOOP_SPARE_JOBS) {
+        job->next = loop->spare;
+        loop->spare = job;
+        loop->spare_count++;
+        job = NULL;
+    }
+    pthread_mutex_unlock(&loop->mutex);
+    if (job) job_free(job);
+}
+
+/* Configure a request's easy handle on the submitting thread */
+static request_job_t* job_create(request_loop_t* loop, const http_request_t* request) {
+    request_job_t* job = job_take(loop);
+    if (!job) return NULL;
+
+    CURL* curl = job->easy;
+    curl_easy_setopt(curl, CURLOPT_URL, request->url);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request->method);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, (curl_write_callback)engine_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &job->body);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, (curl_write_callback)engine_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &job->headers);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)request->timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, job);
+
+    /* The caller's request is gone by the time the loop sends it */
+    size_t body_len = strlen(request->body);
+    if (body_len > 0) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)body_len);
+        curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, request->body);
+    }
+    scratch_arena_reset(&job->scratch);
+    struct curl_slist* header_list = engine_scratch_headers(&job->scratch, request->headers, &job->header_heap);
+    if (header_list) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
+    return job;
+}
+
+/* Fill in a finished request's response, record it and queue it for collection */
+static void job_finish(request_loop_t* loop, request_job_t* job, CURLcode res) {
+    http_response_t* response = &job->response;
+    long response_code = 0;
+    curl_easy_getinfo(job->easy, CURLINFO_RESPONSE_CODE, &response_code);
+
+    response->status_code = (int)response_code;
+    response->response_time_us = get_time_us() - job->start_us;
+    response->success = (res == CURLE_OK && response_code >= 200 && response_code < 400);
+    if (res != CURLE_OK) {
+        snprintf(response->error_message, sizeof(response->error_message), "%s", curl_easy_strerror(res));
+    }
+    engine_record_http_result(loop->engine, -1, response->response_time_us, response_code, res);
+    engine_record_phases(loop->engine, job->easy);
+
+    lock_stats_lock(&loop->mutex, LOCK_SITE_REQUEST_LOOP);
+    job->next = NULL;
+    if (loop->done_tail) loop->done_tail->next = job;
+    else loop->done = job;
+    loop->done_tail = job;
+    if (!loop->signalled) {
+        char byte = 1;
+        loop->signalled = write(loop->notify_fds[1], &byte, 1) == 1;
+    }
+    pthread_mutex_unlock(&loop->mutex);
+}
+
+static void active_unlink(request_loop_t* loop, request_job_t* job) {
+    if (job->prev) job->prev->next = job->next;
+    else loop->active = job->next;
+    if (job->next) job->next->prev = job->prev;
+    job->next = job->prev = NULL;
+}
+
+static void* request_loop_thread(void* arg) {
+    request_loop_t* loop = (request_loop_t*)arg;
+    CURLM* multi = loop->engine->multi_handle;
+
+    for (;;) {
+        lock_stats_lock(&loop->mutex, LOCK_SITE_REQUEST_LOOP);
+        request_job_t* incoming = loop->submitted;
+        loop->submitted = loop->submitted_tail = NULL;
+        bool shutdown = loop->shutdown;
+        pthread_mutex_unlock(&loop->mutex);
+
+        while (incoming) {
+            request_job_t* job = incoming;
+            incoming = job->next;
+            job->next = NULL;
+            if (shutdown) {
+                job_free(job);
+            } else if (curl_multi_add_handle(multi, job->easy) != CURLM_OK) {
+                job_finish(loop, job, CURLE_FAILED_INIT);
+            } else {
+                job->next = loop->active;
+                if (loop->active) loop->active->prev = job;
+                loop->active = job;
+            }
+        }
+        if (shutdown) break;
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        CURLMsg* msg;
+        int pending = 0;
+        while ((msg = curl_multi_info_read(multi, &pending)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            CURL* curl = msg->easy_handle;
+            CURLcode res = msg->data.result;
+            request_job_t* job = NULL;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char**)&job);
+            curl_multi_remove_handle(multi, curl);
+            if (!job) continue;
+            active_unlink(loop, job);
+            job_finish(loop, job, res);
+        }
+
+        if (curl_multi_poll(multi, NULL, 0, REQUEST_LOOP_IDLE_WAIT_MS, NULL) != CURLM_OK) {
+            fprintf(stderr, "[LoadSpiker] request loop: curl_multi_poll failed\n");
+            break;
+        }
+    }
+
+    /* Abandon what is still in flight; nobody will collect it */
+    while (loop->active) {
+        request_job_t* job = loop->active;
+        active_unlink(loop, job);
+        curl_multi_remove_handle(multi, job->easy);
+        job_free(job);
+    }
+    return NULL;
+}
+
+static request_loop_t* request_loop_create(engine_t* engine) {
+    request_loop_t* loop = calloc(1, sizeof(request_loop_t));
+    if (!loop) return NULL;
+    loop->engine = engine;
+    loop->next_ticket = 1;
+    loop->notify_fds[0] = loop->notify_fds[1] = -1;
+
+    if (pipe(loop->notify_fds) != 0) {
+        fprintf(stderr, "[LoadSpiker] request loop: pipe failed: %s\n", strerror(errno));
+        free(loop);
+        return NULL;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(loop->notify_fds[i], F_SETFL, fcntl(loop->notify_fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(loop->notify_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    if (pthread_mutex_init(&loop->mutex, NULL) != 0) {
+        close(loop->notify_fds[0]);
+        close(loop->notify_fds[1]);
+        free(loop);
+        return NULL;
+    }
+
+    curl_multi_setopt(engine->multi_handle, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)engine->max_connections);
+    curl_multi_setopt(engine->multi_handle, CURLMOPT_MAXCONNECTS, (long)engine->max_connections);
+
+    if (pthread_create(&loop->thread, NULL, request_loop_thread, loop) != 0) {
+        pthread_mutex_destroy(&loop->mutex);
+        close(loop->notify_fds[0]);
+        close(loop->notify_fds[1]);
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void request_loop_destroy(request_loop_t* loop) {
+    if (!loop) return;
+
+    pthread_mutex_lock(&loop->mutex);
+    loop->shutdown = true;
+    pthread_mutex_unlock(&loop->mutex);
+    curl_multi_wakeup(loop->engine->multi_handle);
+    pthread_join(loop->thread, NULL);
+
+    while (loop->done) {
+        request_job_t* job = loop->done;
+        loop->done = job->next;
+        job_free(job);
+    }
+    while (loop->spare) {
+        request_job_t* job = loop->spare;
+        loop->spare = job->next;
+        job_free(job);
+    }
+    pthread_mutex_destroy(&loop->mutex);
+    close(loop->notify_fds[0]);
+    close(loop->notify_fds[1]);
+    free(loop);
+}
+
+/* The engine's loop, started on first use */
+static request_loop_t* request_loop_get(engine_t* engine) {
+    pthread_mutex_lock(&engine->queue_mutex);
+    if (!engine->request_loop) engine->request_loop = request_loop_create(engine);
+    request_loop_t* loop = engine->request_loop;
+    pthread_mutex_unlock(&engine->queue_mutex);
+    return loop;
+}
+
+uint64_t engine_submit_request(engine_t* engine, const http_request_t* request) {
+    if (!engine || !request) return 0;
+    request_loop_t* loop = request_loop_get(engine);
+    if (!loop) return 0;
+
+    request_job_t* job = job_create(loop, request);
+    if (!job) return 0;
+    job->start_us = get_time_us();
+
+    lock_stats_lock(&loop->mutex, LOCK_SITE_REQUEST_LOOP);
+    job->ticket = loop->next_ticket++;
+    if (loop->submitted_tail) loop->submitted_tail->next = job;
+    else loop->submitted = job;
+    loop->submitted_tail = job;
+    uint64_t ticket = job->ticket;
+    pthread_mutex_unlock(&loop->mutex);
+
+    curl_multi_wakeup(engine->multi_handle);
+    return ticket;
+}
+
+int engine_collect_response(engine_t* engine, uint64_t* ticket, http_response_t* response) {
+    if (!engine || !ticket || !response) return -1;
+    request_loop_t* loop = request_loop_get(engine);
+    if (!loop) return -1;
+
+    lock_stats_lock(&loop->mutex, LOCK_SITE_REQUEST_LOOP);
+    request_job_t* job = loop->done;
+    if (job) {
+        loop->done = job->next;
+        if (!loop->done) loop->done_tail = NULL;
+    }
+    if (!loop->done && loop->signalled) {
+        char byte;
+        loop->signalled = read(loop->notify_fds[0], &byte, 1) != 1;
+    }
+    pthread_mutex_unlock(&loop->mutex);
+
+    if (!job) return 0;
+    *ticket = job->ticket;
+    memcpy(response, &job->response, sizeof(http_response_t));
+    job_recycle(loop, job);
+    return 1;
+}
+
+int engine_completion_fd(engine_t* engine) {
+    if (!engine) return -1;
+    request_loop_t* loop = request_loop_get(engine);
+    return loop ? loop->notify_fds[0] : -1;
+}
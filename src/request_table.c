@@ -0,0 +1,178 @@
+#include "request_table.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REQUEST_TABLE_INITIAL_ENTRIES 64
+#define REQUEST_TABLE_INITIAL_ARENA 4096
+
+void request_table_init(request_table_t* table) {
+    if (!table) return;
+    memset(table, 0, sizeof(request_table_t));
+}
+
+void request_table_free(request_table_t* table) {
+    if (!table) return;
+    free(table->entries);
+    free(table->arena);
+    memset(table, 0, sizeof(request_table_t));
+}
+
+void request_table_clear(request_table_t* table) {
+    if (!table) return;
+    table->count = 0;
+    table->arena_size = 0;
+}
+
+static int arena_reserve(request_table_t* table, size_t extra) {
+    if (extra > SIZE_MAX - table->arena_size) return -1;
+    size_t needed = table->arena_size + extra;
+    if (needed <= table->arena_capacity) return 0;
+
+    size_t capacity = table->arena_capacity ? table->arena_capacity : REQUEST_TABLE_INITIAL_ARENA;
+    while (capacity < needed) {
+        if (capacity > SIZE_MAX / 2) {
+            capacity = needed;
+            break;
+        }
+        capacity *= 2;
+    }
+
+    char* arena = realloc(table->arena, capacity);
+    if (!arena) return -1;
+    table->arena = arena;
+    table->arena_capacity = capacity;
+    return 0;
+}
+
+/* Copy len bytes plus a terminating NUL; arena space must already be reserved */
+static size_t arena_push(request_table_t* table, const char* data, size_t len) {
+    size_t off = table->arena_size;
+    if (len > 0) memcpy(table->arena + off, data, len);
+    table->arena[off + len] = '\0';
+    table->arena_size += len + 1;
+    return off;
+}
+
+static int entries_reserve(request_table_t* table, int extra) {
+    if (extra > INT_MAX - table->count) return -1;
+    int needed = table->count + extra;
+    if (needed <= table->capacity) return 0;
+
+    int capacity = table->capacity ? table->capacity : REQUEST_TABLE_INITIAL_ENTRIES;
+    while (capacity < needed) {
+        capacity = capacity > INT_MAX / 2 ? needed : capacity * 2;
+    }
+    request_entry_t* entries = realloc(table->entries, sizeof(request_entry_t) * (size_t)capacity);
+    if (!entries) return -1;
+    table->entries = entries;
+    table->capacity = capacity;
+    return 0;
+}
+
+int request_table_add(request_table_t* table, const char* method, const char* url,
+                      const char* headers, const char* body, size_t body_len, int timeout_ms) {
+    return request_table_add_labeled(table, method, url, headers, body, body_len, timeout_ms, NULL);
+}
+
+int request_table_add_labeled(request_table_t* table, const char* method, const char* url,
+                              const char* headers, const char* body, size_t body_len, int timeout_ms,
+                              const char* label) {
+    if (!table || !url || (body_len > 0 && !body)) return -1;
+
+    if (entries_reserve(table, 1) != 0) return -1;
+
+    if (!method || method[0] == '\0') method = "GET";
+    if (!headers) headers = "";
+    if (!label) label = "";
+    size_t method_len = strlen(method);
+    size_t url_len = strlen(url);
+    size_t headers_len = strlen(headers);
+    size_t label_len = strlen(label);
+
+    if (arena_reserve(table, method_len + url_len + headers_len + body_len + label_len + 5) != 0) return -1;
+
+    request_entry_t* entry = &table->entries[table->count];
+    entry->method_off = arena_push(table, method, method_len);
+    entry->url_off = arena_push(table, url, url_len);
+    entry->headers_off = arena_push(table, headers, headers_len);
+    entry->headers_len = headers_len;
+    entry->body_off = arena_push(table, body, body_len);
+    entry->body_len = body_len;
+    entry->label_off = arena_push(table, label, label_len);
+    entry->timeout_ms = timeout_ms;
+    entry->timestamp_us = -1;
+
+    return table->count++;
+}
+
+int request_table_append(request_table_t* table, request_table_t* src) {
+    if (!table || !src) return -1;
+    if (src->count == 0) return 0;
+
+    /* Nothing to merge with: take src's allocations as they are */
+    if (table->count == 0) {
+        free(table->entries);
+        free(table->arena);
+        *table = *src;
+        request_table_init(src);
+        return 0;
+    }
+
+    if (entries_reserve(table, src->count) != 0 || arena_reserve(table, src->arena_size) != 0) return -1;
+    size_t base = table->arena_size;
+    memcpy(table->arena + base, src->arena, src->arena_size);
+    table->arena_size += src->arena_size;
+    for (int i = 0; i < src->count; i++) {
+        request_entry_t entry = src->entries[i];
+        entry.method_off += base;
+        entry.url_off += base;
+        entry.headers_off += base;
+        entry.body_off += base;
+        entry.label_off += base;
+        table->entries[table->count++] = entry;
+    }
+    request_table_free(src);
+    return 0;
+}
+
+int request_table_get(const request_table_t* table, int index, request_view_t* view) {
+    if (!table || !view || index < 0 || index >= table->count) return -1;
+
+    const request_entry_t* entry = &table->entries[index];
+    view->index = index;
+    view->method = table->arena + entry->method_off;
+    view->url = table->arena + entry->url_off;
+    view->headers = table->arena + entry->headers_off;
+    view->headers_len = entry->headers_len;
+    view->body = table->arena + entry->body_off;
+    view->body_len = entry->body_len;
+    view->label = table->arena + entry->label_off;
+    view->timeout_ms = entry->timeout_ms;
+    view->timestamp_us = entry->timestamp_us;
+    view->template_id = -1;
+    view->label_id = -1;
+    view->sequence = 0;
+    return 0;
+}
+
+void request_label_name(const request_view_t* request, char* out, size_t out_len) {
+    if (request->label[0] != '\0') {
+        snprintf(out, out_len, "%s", request->label);
+        return;
+    }
+
+    const char* path = request->url;
+    const char* scheme = strstr(path, "://");
+    if (scheme) {
+        path = strchr(scheme + 3, '/');
+        if (!path) path = "/";
+    }
+    int path_len = (int)strcspn(path, "?#");
+    if (path_len == 0) {
+        path = "/";
+        path_len = 1;
+    }
+    snprintf(out, out_len, "%s %.*s", request->method, path_len, path);
+}
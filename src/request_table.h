@@ -0,0 +1,80 @@
+#ifndef REQUEST_TABLE_H
+#define REQUEST_TABLE_H
+
+/*
+ * Compact, variable-length storage for load-test requests.
+ *
+ * Every string lives once, NUL-terminated, in a single growable arena; a
+ * request entry only records offsets and lengths into it. A 100k-request
+ * scenario therefore costs roughly the bytes it actually contains instead
+ * of ~100 KB per request, and bodies are not limited to MAX_BODY_LENGTH.
+ *
+ * Build the table on one thread, then treat it as read-only: views returned
+ * by request_table_get() point into the arena and stay valid until the next
+ * request_table_add*() or request_table_free().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    size_t method_off;
+    size_t url_off;
+    size_t headers_off;
+    size_t headers_len;
+    size_t body_off;
+    size_t body_len;
+    size_t label_off;
+    int timeout_ms;
+    int64_t timestamp_us;      // recorded send time (JSONL "timestamp"), -1 = none
+} request_entry_t;
+
+typedef struct request_table {
+    request_entry_t* entries;
+    int count;
+    int capacity;
+    char* arena;
+    size_t arena_size;
+    size_t arena_capacity;
+} request_table_t;
+
+// Read-only view of one request; strings are NUL-terminated
+typedef struct {
+    int index;                 // position in the table
+    const char* method;
+    const char* url;
+    const char* headers;       // '\n'-separated "Name: value" lines, may be ""
+    size_t headers_len;
+    const char* body;          // may contain NULs; use body_len
+    size_t body_len;
+    const char* label;         // metrics label, "" when unnamed
+    int timeout_ms;
+    int64_t timestamp_us;      // recorded send time, -1 = none
+    int template_id;           // set by the engine's dispatcher, -1 from request_table_get()
+    int label_id;              // likewise: the engine label the request records under
+    uint64_t sequence;         // likewise: the dispatch sequence number, 0 from request_table_get()
+} request_view_t;
+
+void request_table_init(request_table_t* table);
+void request_table_free(request_table_t* table);
+void request_table_clear(request_table_t* table);   // keep allocations for reuse
+
+// Append a request; NULL method/headers/body mean "GET"/none/empty.
+// Returns the new request's index, or -1 on invalid input / out of memory.
+int request_table_add(request_table_t* table, const char* method, const char* url,
+                      const char* headers, const char* body, size_t body_len, int timeout_ms);
+// Same, reporting the request's metrics under `label` (NULL/"" = derive one from method and path)
+int request_table_add_labeled(request_table_t* table, const char* method, const char* url,
+                              const char* headers, const char* body, size_t body_len, int timeout_ms,
+                              const char* label);
+
+// Move every request of src to the end of table and empty src. On failure
+// (out of memory) both are left unchanged and -1 is returned.
+int request_table_append(request_table_t* table, request_table_t* src);
+
+int request_table_get(const request_table_t* table, int index, request_view_t* view);
+
+// A request's metrics label: its name, or "METHOD /path" with the query dropped
+void request_label_name(const request_view_t* request, char* out, size_t out_len);
+
+#endif /* REQUEST_TABLE_H */
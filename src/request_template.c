@@ -0,0 +1,201 @@
+#include "request_template.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t template_hash(const request_view_t* request) {
+    uint64_t hash = 1469598103934665603ULL;  /* FNV-1a */
+    for (const char* p = request->method; *p; p++) {
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    hash = (hash ^ 0xff) * 1099511628211ULL;
+    for (size_t i = 0; i < request->headers_len; i++) {
+        hash = (hash ^ (unsigned char)request->headers[i]) * 1099511628211ULL;
+    }
+    return (hash ^ (uint64_t)(uint32_t)request->timeout_ms) * 1099511628211ULL;
+}
+
+static template_method_t classify_method(const char* method) {
+    if (strcmp(method, "GET") == 0) return TEMPLATE_METHOD_GET;
+    if (strcmp(method, "POST") == 0) return TEMPLATE_METHOD_POST;
+    if (strcmp(method, "HEAD") == 0) return TEMPLATE_METHOD_HEAD;
+    return TEMPLATE_METHOD_CUSTOM;
+}
+
+/* Split the '\n'-separated block into a fresh slist (done once per template) */
+static int build_header_list(const request_view_t* request, struct curl_slist** out) {
+    *out = NULL;
+    if (request->headers_len == 0) return 0;
+
+    char* copy = strdup(request->headers);
+    if (!copy) return -1;
+
+    char* saveptr = NULL;
+    for (char* line = strtok_r(copy, "\n", &saveptr); line; line = strtok_r(NULL, "\n", &saveptr)) {
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\r') line[--len] = '\0';
+        if (len == 0) continue;
+
+        struct curl_slist* list = curl_slist_append(*out, line);
+        if (!list) {
+            curl_slist_free_all(*out);
+            *out = NULL;
+            free(copy);
+            return -1;
+        }
+        *out = list;
+    }
+    free(copy);
+    return 0;
+}
+
+int request_templates_compile(request_templates_t* compiled, const request_table_t* table) {
+    if (!compiled || !table || table->count <= 0) return -1;
+    memset(compiled, 0, sizeof(request_templates_t));
+
+    size_t slots = 16;
+    while (slots < (size_t)table->count * 2) slots *= 2;
+
+    int* buckets = malloc(sizeof(int) * slots);   /* template index, -1 = empty */
+    compiled->by_request = malloc(sizeof(int) * (size_t)table->count);
+    compiled->templates = malloc(sizeof(request_template_t) * (size_t)table->count);
+    request_view_t* first = malloc(sizeof(request_view_t) * (size_t)table->count);
+    if (!buckets || !compiled->by_request || !compiled->templates || !first) {
+        free(buckets);
+        free(first);
+        request_templates_free(compiled);
+        return -1;
+    }
+    memset(buckets, 0xff, sizeof(int) * slots);
+    compiled->request_count = table->count;
+
+    for (int i = 0; i < table->count; i++) {
+        request_view_t request;
+        request_table_get(table, i, &request);
+
+        size_t slot = (size_t)template_hash(&request) & (slots - 1);
+        int found = -1;
+        while (buckets[slot] >= 0) {
+            const request_view_t* other = &first[buckets[slot]];
+            if (other->timeout_ms == request.timeout_ms && other->headers_len == request.headers_len &&
+                strcmp(other->method, request.method) == 0 &&
+                memcmp(other->headers, request.headers, request.headers_len) == 0) {
+                found = buckets[slot];
+                break;
+            }
+            slot = (slot + 1) & (slots - 1);
+        }
+
+        if (found < 0) {
+            found = compiled->count;
+            request_template_t* tmpl = &compiled->templates[found];
+            tmpl->method = request.method;
+            tmpl->method_kind = classify_method(request.method);
+            tmpl->timeout_ms = request.timeout_ms > 0 ? request.timeout_ms : DEFAULT_HTTP_TIMEOUT_MS;
+            if (build_header_list(&request, &tmpl->headers) != 0) {
+                free(buckets);
+                free(first);
+                request_templates_free(compiled);
+                return -1;
+            }
+            first[found] = request;
+            buckets[slot] = found;
+            compiled->count++;
+        }
+        compiled->by_request[i] = found;
+    }
+
+    free(buckets);
+    free(first);
+    return 0;
+}
+
+int request_templates_build(request_templates_t* compiled, const request_view_t* shapes, int count) {
+    if (!compiled || !shapes || count <= 0) return -1;
+    memset(compiled, 0, sizeof(request_templates_t));
+    compiled->templates = malloc(sizeof(request_template_t) * (size_t)count);
+    if (!compiled->templates) return -1;
+
+    for (int i = 0; i < count; i++) {
+        request_template_t* tmpl = &compiled->templates[i];
+        tmpl->method = shapes[i].method;
+        tmpl->method_kind = classify_method(shapes[i].method);
+        tmpl->timeout_ms = shapes[i].timeout_ms > 0 ? shapes[i].timeout_ms : DEFAULT_HTTP_TIMEOUT_MS;
+        if (build_header_list(&shapes[i], &tmpl->headers) != 0) {
+            request_templates_free(compiled);
+            return -1;
+        }
+        compiled->count++;
+    }
+    return 0;
+}
+
+void request_templates_free(request_templates_t* compiled) {
+    if (!compiled) return;
+    if (compiled->templates) {
+        for (int i = 0; i < compiled->count; i++) {
+            curl_slist_free_all(compiled->templates[i].headers);
+        }
+    }
+    free(compiled->templates);
+    free(compiled->by_request);
+    memset(compiled, 0, sizeof(request_templates_t));
+}
+
+void request_template_apply(CURL* curl, const request_template_t* tmpl, const request_view_t* request) {
+    curl_easy_setopt(curl, CURLOPT_URL, request->url);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, tmpl->timeout_ms);
+    if (tmpl->headers) {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, tmpl->headers);
+    }
+
+    switch (tmpl->method_kind) {
+    case TEMPLATE_METHOD_GET:
+        /* A GET with a body has to stay a GET rather than become a POST */
+        if (request->body_len > 0) curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, tmpl->method);
+        break;
+    case TEMPLATE_METHOD_POST:
+        /* POSTFIELDS implies POST; an empty one keeps libcurl from reading stdin */
+        if (request->body_len == 0) {
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, 0L);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "");
+        }
+        break;
+    case TEMPLATE_METHOD_HEAD:
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+        break;
+    case TEMPLATE_METHOD_CUSTOM:
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, tmpl->method);
+        break;
+    }
+
+    if (request->body_len > 0) {
+        /* the request table outlives the transfer, so libcurl can use the body in place */
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)request->body_len);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request->body);
+    }
+}
+
+struct curl_slist* request_headers_split(char* headers, size_t len, struct curl_slist* nodes, int capacity) {
+    struct curl_slist* head = NULL;
+    struct curl_slist* tail = NULL;
+    int used = 0;
+    size_t start = 0;
+    while (start < len && used < capacity) {
+        char* line = headers + start;
+        char* end = memchr(line, '\n', len - start);
+        size_t line_len = end ? (size_t)(end - line) : len - start;
+        start += line_len + 1;
+        line[line_len] = '\0';   /* the newline, or the block's own NUL */
+        if (line_len > 0 && line[line_len - 1] == '\r') line[--line_len] = '\0';
+        if (line_len == 0) continue;
+
+        struct curl_slist* node = &nodes[used++];
+        node->data = line;
+        node->next = NULL;
+        if (tail) tail->next = node;
+        else head = node;
+        tail = node;
+    }
+    return head;
+}
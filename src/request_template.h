@@ -0,0 +1,58 @@
+#ifndef REQUEST_TEMPLATE_H
+#define REQUEST_TEMPLATE_H
+
+/*
+ * Load-test request templates, compiled once per test.
+ *
+ * Scenarios replay a handful of distinct request shapes many times. Before
+ * workers start, request_templates_compile() groups the request table by
+ * (method, headers, timeout), parses each group's header block into one
+ * immutable curl_slist and classifies the method. Workers then configure a
+ * handle with request_template_apply() — no strdup/strtok, no slist
+ * building and no strlen on the hot path. libcurl only reads the slists, so
+ * all threads share them for the duration of the test.
+ */
+
+#include "request_table.h"
+#include <curl/curl.h>
+
+typedef enum {
+    TEMPLATE_METHOD_GET = 0,
+    TEMPLATE_METHOD_POST,
+    TEMPLATE_METHOD_HEAD,
+    TEMPLATE_METHOD_CUSTOM     // anything else, sent via CURLOPT_CUSTOMREQUEST
+} template_method_t;
+
+typedef struct {
+    const char* method;            // points into the request table arena
+    template_method_t method_kind;
+    struct curl_slist* headers;    // NULL when the template has no headers
+    long timeout_ms;
+} request_template_t;
+
+typedef struct {
+    request_template_t* templates;
+    int count;
+    int* by_request;               // request index -> template index (NULL when built from shapes)
+    int request_count;
+} request_templates_t;
+
+int request_templates_compile(request_templates_t* compiled, const request_table_t* table);
+// One template per shape, already grouped (a replay log's templates); by_request stays NULL
+int request_templates_build(request_templates_t* compiled, const request_view_t* shapes, int count);
+void request_templates_free(request_templates_t* compiled);
+
+static inline const request_template_t* request_template_for(const request_templates_t* compiled, int request_index) {
+    return &compiled->templates[compiled->by_request[request_index]];
+}
+
+// Set URL, method, headers, timeout and body for one request on `curl`
+void request_template_apply(CURL* curl, const request_template_t* tmpl, const request_view_t* request);
+
+// Split a writable header block in place into a list built from the caller's
+// `nodes` (capacity entries), with the same rules as a template's list: one
+// header per line, CR dropped, empty lines skipped. Nothing is allocated;
+// returns the list, or NULL when it has no headers.
+struct curl_slist* request_headers_split(char* headers, size_t len, struct curl_slist* nodes, int capacity);
+
+#endif /* REQUEST_TEMPLATE_H */
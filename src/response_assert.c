@@ -0,0 +1,184 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   /* memmem */
+#endif
+#include "response_assert.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+/* The name a test reports an assertion under when it was given none */
+static void derive_name(response_assert_t* a) {
+    switch (a->kind) {
+    case RESPONSE_ASSERT_STATUS:
+        if (a->status_min == a->status_max) snprintf(a->name, sizeof(a->name), "status %d", a->status_min);
+        else snprintf(a->name, sizeof(a->name), "status %d-%d", a->status_min, a->status_max);
+        break;
+    case RESPONSE_ASSERT_HEADER: {
+        /* A long header name is cut to what fits after the prefix, and the
+           needle to what is left after it */
+        int room = (int)(sizeof(a->name) - sizeof("header "));
+        int len = snprintf(a->name, sizeof(a->name), "header %.*s", room, a->header);
+        if (a->text_len && len >= 0 && (size_t)len < sizeof(a->name) - 1) {
+            snprintf(a->name + len, sizeof(a->name) - (size_t)len, " contains %.*s", (int)a->text_len, a->text);
+        }
+        break;
+    }
+    case RESPONSE_ASSERT_BODY_CONTAINS:
+        snprintf(a->name, sizeof(a->name), "body contains %.*s", (int)a->text_len, a->text);
+        break;
+    case RESPONSE_ASSERT_BODY_EXCLUDES:
+        snprintf(a->name, sizeof(a->name), "body excludes %.*s", (int)a->text_len, a->text);
+        break;
+    case RESPONSE_ASSERT_LATENCY:
+        snprintf(a->name, sizeof(a->name), "latency <= %.6g ms", (double)a->max_latency_us / 1000.0);
+        break;
+    }
+}
+
+int response_assert_prepare(response_assert_t* a) {
+    if (!a) return -1;
+    switch (a->kind) {
+    case RESPONSE_ASSERT_STATUS:
+        if (a->status_min < 0 || a->status_max > 999 || a->status_min > a->status_max) return -1;
+        break;
+    case RESPONSE_ASSERT_HEADER:
+        a->header[sizeof(a->header) - 1] = '\0';
+        if (a->header[0] == '\0' || strchr(a->header, ':') || a->text_len > RESPONSE_ASSERT_TEXT_MAX) return -1;
+        break;
+    case RESPONSE_ASSERT_BODY_CONTAINS:
+    case RESPONSE_ASSERT_BODY_EXCLUDES:
+        if (a->text_len == 0 || a->text_len > RESPONSE_ASSERT_TEXT_MAX) return -1;
+        break;
+    case RESPONSE_ASSERT_LATENCY:
+        break;
+    default:
+        return -1;
+    }
+    a->name[sizeof(a->name) - 1] = '\0';
+    if (a->name[0] == '\0') derive_name(a);
+    return 0;
+}
+
+void response_match_init(response_match_t* match, const response_assert_t* assertions, int count) {
+    memset(match, 0, offsetof(response_match_t, window));
+    match->assertions = assertions;
+    match->count = count < 0 ? 0 : count > RESPONSE_ASSERT_MAX ? RESPONSE_ASSERT_MAX : count;
+    for (int i = 0; i < match->count; i++) {
+        const response_assert_t* a = &assertions[i];
+        if (a->kind == RESPONSE_ASSERT_BODY_CONTAINS || a->kind == RESPONSE_ASSERT_BODY_EXCLUDES) {
+            match->body_mask |= 1u << i;
+            if (a->text_len - 1 > match->keep) match->keep = a->text_len - 1;
+        } else if (a->kind == RESPONSE_ASSERT_HEADER) {
+            match->header_mask |= 1u << i;
+        }
+    }
+}
+
+void response_match_reset(response_match_t* match) {
+    match->found = 0;
+    match->carry_len = 0;
+}
+
+/* Mark every undecided body needle that occurs in data[0..len) */
+static void scan_body(response_match_t* match, const char* data, size_t len) {
+    uint32_t pending = match->body_mask & ~match->found;
+    while (pending) {
+        int i = __builtin_ctz(pending);
+        pending &= pending - 1;
+        const response_assert_t* a = &match->assertions[i];
+        if (a->text_len <= len && memmem(data, len, a->text, a->text_len)) match->found |= 1u << i;
+    }
+}
+
+size_t response_match_body(char* data, size_t size, size_t nmemb, void* userp) {
+    response_match_t* match = (response_match_t*)userp;
+    size_t len = size * nmemb;
+    /* Every needle decided: the rest of the body goes unread */
+    if ((match->body_mask & ~match->found) == 0 || len == 0) return len;
+
+    size_t keep = match->keep;
+    size_t carried = match->carry_len;
+    if (carried > 0) {
+        /* A needle split across chunks: the carried tail plus this chunk's head */
+        size_t take = len < keep ? len : keep;
+        memcpy(match->window + carried, data, take);
+        scan_body(match, match->window, carried + take);
+    }
+    scan_body(match, data, len);
+
+    if (keep == 0) return len;
+    if (len >= keep) {
+        memcpy(match->window, data + len - keep, keep);
+        match->carry_len = keep;
+    } else {
+        if (carried == 0) memcpy(match->window, data, len);
+        size_t total = carried + len;
+        if (total > keep) {
+            memmove(match->window, match->window + total - keep, keep);
+            total = keep;
+        }
+        match->carry_len = total;
+    }
+    return len;
+}
+
+size_t response_match_header(char* data, size_t size, size_t nmemb, void* userp) {
+    response_match_t* match = (response_match_t*)userp;
+    size_t len = size * nmemb;
+    if (!match->header_mask) return len;
+
+    /* A redirect or 1xx starts a new response: only the final one's headers count */
+    if (len >= 5 && memcmp(data, "HTTP/", 5) == 0) {
+        match->found &= ~match->header_mask;
+        return len;
+    }
+    while (len > 0 && (data[len - 1] == '\n' || data[len - 1] == '\r')) len--;
+
+    uint32_t pending = match->header_mask & ~match->found;
+    while (pending) {
+        int i = __builtin_ctz(pending);
+        pending &= pending - 1;
+        const response_assert_t* a = &match->assertions[i];
+        size_t name_len = strlen(a->header);
+        if (len <= name_len || data[name_len] != ':' || strncasecmp(data, a->header, name_len) != 0) continue;
+
+        const char* value = data + name_len + 1;
+        size_t value_len = len - name_len - 1;
+        if (a->text_len == 0 || (a->text_len <= value_len && memmem(value, value_len, a->text, a->text_len))) {
+            match->found |= 1u << i;
+        }
+    }
+    return size * nmemb;
+}
+
+size_t response_discard(char* data, size_t size, size_t nmemb, void* userp) {
+    (void)data;
+    (void)userp;
+    return size * nmemb;
+}
+
+uint32_t response_match_finish(const response_match_t* match, long status_code, uint64_t response_time_us) {
+    uint32_t failed = 0;
+    for (int i = 0; i < match->count; i++) {
+        const response_assert_t* a = &match->assertions[i];
+        bool found = (match->found >> i) & 1u;
+        bool ok = true;
+        switch (a->kind) {
+        case RESPONSE_ASSERT_STATUS:
+            ok = status_code >= a->status_min && status_code <= a->status_max;
+            break;
+        case RESPONSE_ASSERT_HEADER:
+        case RESPONSE_ASSERT_BODY_CONTAINS:
+            ok = found;
+            break;
+        case RESPONSE_ASSERT_BODY_EXCLUDES:
+            ok = !found;
+            break;
+        case RESPONSE_ASSERT_LATENCY:
+            ok = response_time_us <= a->max_latency_us;
+            break;
+        }
+        if (!ok) failed |= 1u << i;
+    }
+    return failed;
+}
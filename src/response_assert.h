@@ -0,0 +1,77 @@
+#ifndef RESPONSE_ASSERT_H
+#define RESPONSE_ASSERT_H
+
+/*
+ * Load-test response assertions, checked by the workers as responses stream in.
+ *
+ * A test's assertions are a small fixed set of checks on every response:
+ * status range, header presence (optionally with a value substring), body
+ * substring present or absent, and a latency ceiling. A response_match_t
+ * rides along with each transfer as libcurl's header and write callback
+ * data. Header lines are matched as they arrive and body chunks are scanned
+ * with memmem() plus a short carry-over for needles split across chunks,
+ * then dropped, so no response is ever buffered. Once every body needle
+ * has been decided, the rest of the body is discarded unread.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESPONSE_ASSERT_MAX 32           // assertions per test (one bit each)
+#define RESPONSE_ASSERT_NAME_MAX 128
+#define RESPONSE_ASSERT_HEADER_MAX 128
+#define RESPONSE_ASSERT_TEXT_MAX 256     // longest body or header-value needle
+
+typedef enum {
+    RESPONSE_ASSERT_STATUS = 0,          // status_min <= status <= status_max
+    RESPONSE_ASSERT_HEADER = 1,          // header present; its value contains text when text_len > 0
+    RESPONSE_ASSERT_BODY_CONTAINS = 2,   // body contains text
+    RESPONSE_ASSERT_BODY_EXCLUDES = 3,   // body does not contain text
+    RESPONSE_ASSERT_LATENCY = 4          // response time <= max_latency_us
+} response_assert_kind_t;
+
+typedef struct {
+    response_assert_kind_t kind;
+    char name[RESPONSE_ASSERT_NAME_MAX];      // metrics name; "" = derived from the check
+    int status_min;
+    int status_max;
+    char header[RESPONSE_ASSERT_HEADER_MAX];  // RESPONSE_ASSERT_HEADER: name, matched case-insensitively
+    char text[RESPONSE_ASSERT_TEXT_MAX];      // needle; may contain NULs
+    size_t text_len;
+    uint64_t max_latency_us;
+} response_assert_t;
+
+// 0 if the assertion is well formed; -1 otherwise (empty needle or header
+// name, inverted status range, ...). Fills in a derived name when it has none.
+int response_assert_prepare(response_assert_t* assertion);
+
+// Per-transfer matching state
+typedef struct {
+    const response_assert_t* assertions;
+    int count;
+    uint32_t body_mask;            // assertions that look at the body
+    uint32_t header_mask;
+    uint32_t found;                // needles seen so far (body) / headers seen (current response)
+    size_t keep;                   // bytes carried between chunks: longest body needle - 1
+    size_t carry_len;
+    char window[2 * RESPONSE_ASSERT_TEXT_MAX];
+} response_match_t;
+
+// Set up `match` for a test's assertions (count may be 0)
+void response_match_init(response_match_t* match, const response_assert_t* assertions, int count);
+// Forget the previous response before the next transfer
+void response_match_reset(response_match_t* match);
+
+// libcurl CURLOPT_WRITEFUNCTION / CURLOPT_HEADERFUNCTION with a
+// response_match_t* as their data
+size_t response_match_body(char* data, size_t size, size_t nmemb, void* userp);
+size_t response_match_header(char* data, size_t size, size_t nmemb, void* userp);
+
+// libcurl callback that drops the data, for tests without assertions
+size_t response_discard(char* data, size_t size, size_t nmemb, void* userp);
+
+// Bit i set = assertion i failed for a finished response
+uint32_t response_match_finish(const response_match_t* match, long status_code, uint64_t response_time_us);
+
+#endif /* RESPONSE_ASSERT_H */
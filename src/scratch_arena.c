@@ -0,0 +1,114 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   /* MAP_HUGETLB, MADV_HUGEPAGE */
+#endif
+#include "scratch_arena.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+
+static __thread scratch_arena_t* thread_arena = NULL;
+static pthread_key_t arena_key;
+static pthread_once_t arena_key_once = PTHREAD_ONCE_INIT;
+static _Atomic bool arena_hugepages = false;
+
+static _Atomic uint64_t stat_arenas;
+static _Atomic uint64_t stat_hugepage_arenas;
+static _Atomic uint64_t stat_arena_bytes;
+static _Atomic uint64_t stat_high_water;
+static _Atomic uint64_t stat_heap_allocations;
+
+/* Thread exit: unmap the arena (its header lives at the front of the mapping) */
+static void arena_destroy(void* arg) {
+    scratch_arena_t* arena = (scratch_arena_t*)arg;
+    if (!arena) return;
+    atomic_fetch_sub_explicit(&stat_arenas, 1, memory_order_relaxed);
+    if (arena->hugepages) atomic_fetch_sub_explicit(&stat_hugepage_arenas, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&stat_arena_bytes, SCRATCH_ARENA_SIZE, memory_order_relaxed);
+    munmap(arena, SCRATCH_ARENA_SIZE);
+    thread_arena = NULL;
+}
+
+static void arena_key_create(void) {
+    pthread_key_create(&arena_key, arena_destroy);
+}
+
+static void* arena_map(bool* hugepages) {
+    void* block = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (*hugepages) {
+        block = mmap(NULL, SCRATCH_ARENA_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (block != MAP_FAILED) return block;
+
+    /* No reserved huge pages: ordinary pages, promoted by THP when allowed */
+    block = mmap(NULL, SCRATCH_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+    if (*hugepages && madvise(block, SCRATCH_ARENA_SIZE, MADV_HUGEPAGE) == 0) return block;
+#endif
+    *hugepages = false;
+    return block;
+}
+
+scratch_arena_t* scratch_arena_thread(void) {
+    if (thread_arena) return thread_arena;
+
+    pthread_once(&arena_key_once, arena_key_create);
+    bool hugepages = atomic_load_explicit(&arena_hugepages, memory_order_relaxed);
+    char* block = arena_map(&hugepages);
+    if (!block) return NULL;
+
+    scratch_arena_t* arena = (scratch_arena_t*)block;
+    size_t header = (sizeof(scratch_arena_t) + SCRATCH_ARENA_ALIGN - 1) & ~(size_t)(SCRATCH_ARENA_ALIGN - 1);
+    memset(arena, 0, sizeof(*arena));
+    arena->base = block + header;
+    arena->capacity = SCRATCH_ARENA_SIZE - header;
+    arena->hugepages = hugepages;
+    if (pthread_setspecific(arena_key, arena) != 0) {
+        munmap(block, SCRATCH_ARENA_SIZE);
+        return NULL;
+    }
+
+    atomic_fetch_add_explicit(&stat_arenas, 1, memory_order_relaxed);
+    if (hugepages) atomic_fetch_add_explicit(&stat_hugepage_arenas, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stat_arena_bytes, SCRATCH_ARENA_SIZE, memory_order_relaxed);
+    thread_arena = arena;
+    return arena;
+}
+
+void scratch_arena_wrap(scratch_arena_t* arena, void* storage, size_t size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->base = (char*)storage;
+    arena->capacity = size;
+}
+
+void scratch_arena_set_hugepages(bool enabled) {
+    atomic_store_explicit(&arena_hugepages, enabled, memory_order_relaxed);
+}
+
+void scratch_arena_reset(scratch_arena_t* arena) {
+    if (arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+        uint64_t cur = atomic_load_explicit(&stat_high_water, memory_order_relaxed);
+        while (arena->used > cur &&
+               !atomic_compare_exchange_weak_explicit(&stat_high_water, &cur, arena->used,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+        }
+    }
+    arena->used = 0;
+}
+
+void scratch_count_heap_allocation(void) {
+    atomic_fetch_add_explicit(&stat_heap_allocations, 1, memory_order_relaxed);
+}
+
+void scratch_stats_get(scratch_stats_t* stats) {
+    stats->arenas = atomic_load_explicit(&stat_arenas, memory_order_relaxed);
+    stats->hugepage_arenas = atomic_load_explicit(&stat_hugepage_arenas, memory_order_relaxed);
+    stats->arena_bytes = atomic_load_explicit(&stat_arena_bytes, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&stat_high_water, memory_order_relaxed);
+    stats->heap_allocations = atomic_load_explicit(&stat_heap_allocations, memory_order_relaxed);
+}
@@ -0,0 +1,71 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+/*
+ * Reusable scratch memory for building requests.
+ *
+ * A scratch arena is one block handed out by bumping an offset and reset
+ * before the next request rather than freed, so steady-state requests
+ * never touch the heap. Every thread that prepares requests (the engine's
+ * queue workers, callers of the blocking request API) gets its own arena
+ * from scratch_arena_thread(): mapped the first time it is needed and
+ * unmapped when the thread exits. Buffers that live with a request beyond
+ * the calling thread (non-blocking requests) can wrap their own storage
+ * with scratch_arena_wrap().
+ *
+ * Thread arenas can be backed by huge pages: explicit ones (MAP_HUGETLB)
+ * when the system has some reserved, else transparent huge pages through
+ * madvise(). Whatever does not fit an arena falls back to malloc and is
+ * counted in scratch_stats_t.heap_allocations, as is every other heap
+ * allocation left on a request path, so a test can confirm it ran at zero.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCRATCH_ARENA_SIZE (2u << 20)    // per thread: one 2 MB huge page
+#define SCRATCH_ARENA_ALIGN 16
+
+typedef struct {
+    char* base;
+    size_t capacity;
+    size_t used;
+    size_t high_water;             // most bytes one request took here
+    bool hugepages;
+} scratch_arena_t;
+
+// Process-wide counters, for all engines
+typedef struct {
+    uint64_t arenas;              // thread arenas mapped now
+    uint64_t hugepage_arenas;     // of which backed by explicit or transparent huge pages
+    uint64_t arena_bytes;         // mapped by them
+    uint64_t high_water;          // most scratch one request has taken
+    uint64_t heap_allocations;    // request-path heap allocations since the process started
+} scratch_stats_t;
+
+// The calling thread's arena, mapped on first use; NULL if it cannot be
+// mapped (callers then fall back to malloc)
+scratch_arena_t* scratch_arena_thread(void);
+// An arena over caller-owned storage, which it never frees
+void scratch_arena_wrap(scratch_arena_t* arena, void* storage, size_t size);
+
+// Back thread arenas mapped from now on with huge pages (default off)
+void scratch_arena_set_hugepages(bool enabled);
+
+// SCRATCH_ARENA_ALIGN-aligned bytes, or NULL when the arena is full
+static inline void* scratch_arena_alloc(scratch_arena_t* arena, size_t size) {
+    size_t start = (arena->used + SCRATCH_ARENA_ALIGN - 1) & ~(size_t)(SCRATCH_ARENA_ALIGN - 1);
+    if (start > arena->capacity || size > arena->capacity - start) return NULL;
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+// Release everything allocated since the last reset
+void scratch_arena_reset(scratch_arena_t* arena);
+
+// Count a request-path allocation that had to come from the heap
+void scratch_count_heap_allocation(void);
+void scratch_stats_get(scratch_stats_t* stats);
+
+#endif /* SCRATCH_ARENA_H */
@@ -0,0 +1,527 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   /* memmem */
+#endif
+#include "engine_internal.h"
+#include "common.h"
+#include "protocols/tcp.h"
+#include "protocols/udp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * Native TCP/UDP socket load test back-end.
+ *
+ * Each loop owns an epoll set and its share of the test's connections. A
+ * connection is a small state machine running the script against its
+ * target: a non-blocking connect, then sends and expects driven purely by
+ * readiness, so one thread keeps thousands of sockets busy. A connection
+ * watches only the direction its current step needs, and a finished
+ * iteration goes on the loop's ready list instead of starting the next one
+ * in place, so a fast connection cannot starve the others.
+ *
+ * Every wait uses the same timeout, so arming order is deadline order: the
+ * per-loop timeout list is a plain FIFO and expiry only ever looks at its
+ * head.
+ */
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#define SOCKET_LOOP_MAX_EVENTS 256
+#define SOCKET_LOOP_IDLE_WAIT_MS 100     /* upper bound on one epoll_wait so stop_flag is noticed */
+#define SOCKET_READ_CHUNK 4096
+#define SOCKET_BUFFER_MAX MAX_BODY_LENGTH
+
+typedef enum {
+    CONN_IDLE = 0,      /* between iterations, on the ready list */
+    CONN_CONNECTING,
+    CONN_RUNNING,
+    CONN_DONE
+} conn_phase_t;
+
+typedef struct socket_conn {
+    /* udp_endpoint_t has tcp_connection_t's layout; common fields are read through .tcp */
+    union {
+        tcp_connection_t tcp;
+        udp_endpoint_t udp;
+    } link;
+    int target;
+    conn_phase_t phase;
+    int step;
+    size_t progress;              /* SEND: bytes written; EXPECT_BYTES: bytes consumed */
+    uint64_t op_start_us;
+    uint64_t deadline_us;         /* 0 = not on the timeout list */
+    uint32_t events;              /* registered epoll interest */
+    int iterations_done;
+    char* buf;                    /* received bytes not consumed by a step yet */
+    size_t buf_len;
+    size_t buf_cap;
+    struct socket_conn* timer_prev;
+    struct socket_conn* timer_next;
+    struct socket_conn* ready_next;
+} socket_conn_t;
+
+typedef struct {
+    pthread_t thread;
+    engine_t* engine;
+    const socket_plan_t* plan;
+    struct socket_loop_group* group;
+    int loop_id;
+    bool started;
+    int epoll_fd;
+    int capacity;
+    socket_conn_t* conns;
+    int open;                     /* connections not yet CONN_DONE */
+    socket_conn_t* timer_head;
+    socket_conn_t* timer_tail;
+    socket_conn_t* ready_head;
+} socket_loop_t;
+
+struct socket_loop_group {
+    socket_loop_t* loops;
+    int count;
+    _Atomic int running;
+};
+
+static void conn_arm(socket_loop_t* loop, socket_conn_t* c) {
+    if (c->deadline_us) return;
+    c->deadline_us = get_time_us() + (uint64_t)loop->plan->options.timeout_ms * 1000;
+    c->timer_prev = loop->timer_tail;
+    c->timer_next = NULL;
+    if (loop->timer_tail) loop->timer_tail->timer_next = c;
+    else loop->timer_head = c;
+    loop->timer_tail = c;
+}
+
+static void conn_disarm(socket_loop_t* loop, socket_conn_t* c) {
+    if (!c->deadline_us) return;
+    if (c->timer_prev) c->timer_prev->timer_next = c->timer_next;
+    else loop->timer_head = c->timer_next;
+    if (c->timer_next) c->timer_next->timer_prev = c->timer_prev;
+    else loop->timer_tail = c->timer_prev;
+    c->timer_prev = c->timer_next = NULL;
+    c->deadline_us = 0;
+}
+
+static void conn_ready(socket_loop_t* loop, socket_conn_t* c) {
+    c->phase = CONN_IDLE;
+    c->ready_next = loop->ready_head;
+    loop->ready_head = c;
+}
+
+/* Watch exactly `events` on the connection's socket */
+static void conn_watch(socket_loop_t* loop, socket_conn_t* c, uint32_t events) {
+    if (c->events == events) return;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = c;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, c->link.tcp.socket_fd, &ev);
+    c->events = events;
+}
+
+static void conn_close(socket_loop_t* loop, socket_conn_t* c) {
+    if (c->link.tcp.socket_fd >= 0) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, c->link.tcp.socket_fd, NULL);
+        close(c->link.tcp.socket_fd);
+        c->link.tcp.socket_fd = -1;
+    }
+    c->link.tcp.is_connected = false;
+    c->events = 0;
+    c->buf_len = 0;
+}
+
+static int conn_label(socket_loop_t* loop, socket_conn_t* c) {
+    if (c->phase == CONN_CONNECTING) return loop->plan->connect_label;
+    return loop->plan->step_labels[c->step];
+}
+
+static void conn_record(socket_loop_t* loop, socket_conn_t* c, CURLcode result) {
+    engine_record_socket_result(loop->engine, conn_label(loop, c), get_time_us() - c->op_start_us, result);
+}
+
+/* The iteration is over, successfully or not; a failed one always drops its
+   connection so stale bytes cannot leak into the next iteration */
+static void conn_end_iteration(socket_loop_t* loop, socket_conn_t* c, bool failed) {
+    conn_disarm(loop, c);
+    c->iterations_done++;
+    if (failed || loop->plan->options.reconnect || loop->plan->options.num_steps == 0) {
+        conn_close(loop, c);
+    }
+    conn_ready(loop, c);
+}
+
+static void conn_fail(socket_loop_t* loop, socket_conn_t* c, CURLcode result, int err) {
+    conn_record(loop, c, result);
+    snprintf(c->link.tcp.last_error, sizeof(c->link.tcp.last_error), "%s",
+             err ? strerror(err) : curl_easy_strerror(result));
+    conn_end_iteration(loop, c, true);
+}
+
+/* Run steps until one has to wait for the socket or the iteration ends */
+static void conn_drive(socket_loop_t* loop, socket_conn_t* c) {
+    const socket_test_options_t* options = &loop->plan->options;
+    int fd = c->link.tcp.socket_fd;
+
+    while (c->step < options->num_steps) {
+        const socket_step_t* step = &options->steps[c->step];
+
+        if (step->type == SOCKET_STEP_SEND) {
+            while (c->progress < step->len) {
+                ssize_t n = send(fd, step->data + c->progress, step->len - c->progress, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    conn_watch(loop, c, EPOLLOUT);
+                    conn_arm(loop, c);
+                    return;
+                }
+                if (n < 0) {
+                    conn_fail(loop, c, CURLE_SEND_ERROR, errno);
+                    return;
+                }
+                /* a datagram goes out whole or not at all */
+                c->progress += options->protocol == PROTOCOL_UDP ? step->len : (size_t)n;
+            }
+        } else {
+            bool satisfied = false;
+            while (!satisfied) {
+                if (step->type == SOCKET_STEP_EXPECT_BYTES) {
+                    size_t take = step->len - c->progress;
+                    if (take > c->buf_len) take = c->buf_len;
+                    memmove(c->buf, c->buf + take, c->buf_len - take);
+                    c->buf_len -= take;
+                    c->progress += take;
+                    satisfied = c->progress >= step->len;
+                } else if (c->buf_len >= step->len) {
+                    char* hit = memmem(c->buf, c->buf_len, step->data, step->len);
+                    if (hit) {
+                        size_t used = (size_t)(hit - c->buf) + step->len;
+                        memmove(c->buf, c->buf + used, c->buf_len - used);
+                        c->buf_len -= used;
+                        satisfied = true;
+                    } else if (c->buf_len == c->buf_cap && c->buf_cap >= SOCKET_BUFFER_MAX) {
+                        /* keep only what could still start the delimiter */
+                        size_t keep = step->len - 1;
+                        memmove(c->buf, c->buf + c->buf_len - keep, keep);
+                        c->buf_len = keep;
+                    }
+                }
+                if (satisfied) break;
+
+                if (c->buf_cap - c->buf_len < SOCKET_READ_CHUNK && c->buf_cap < SOCKET_BUFFER_MAX) {
+                    size_t cap = c->buf_cap ? c->buf_cap * 2 : SOCKET_READ_CHUNK;
+                    if (cap > SOCKET_BUFFER_MAX) cap = SOCKET_BUFFER_MAX;
+                    char* buf = realloc(c->buf, cap);
+                    if (!buf) {
+                        conn_fail(loop, c, CURLE_OUT_OF_MEMORY, 0);
+                        return;
+                    }
+                    c->buf = buf;
+                    c->buf_cap = cap;
+                }
+
+                ssize_t n = recv(fd, c->buf + c->buf_len, c->buf_cap - c->buf_len, 0);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    conn_watch(loop, c, EPOLLIN);
+                    conn_arm(loop, c);
+                    return;
+                }
+                if (n < 0) {
+                    conn_fail(loop, c, CURLE_RECV_ERROR, errno);
+                    return;
+                }
+                if (n == 0 && options->protocol == PROTOCOL_TCP) {
+                    conn_fail(loop, c, CURLE_GOT_NOTHING, 0);  /* closed by peer */
+                    return;
+                }
+                c->buf_len += (size_t)n;
+            }
+        }
+
+        /* Step complete: one sample, then straight on to the next */
+        conn_disarm(loop, c);
+        conn_record(loop, c, CURLE_OK);
+        c->step++;
+        c->progress = 0;
+        c->op_start_us = get_time_us();
+    }
+
+    conn_end_iteration(loop, c, false);
+}
+
+/* The connection is up (TCP handshake done, or UDP socket connected) */
+static void conn_established(socket_loop_t* loop, socket_conn_t* c) {
+    conn_disarm(loop, c);
+    if (c->phase == CONN_CONNECTING) conn_record(loop, c, CURLE_OK);
+    c->link.tcp.is_connected = true;
+    c->phase = CONN_RUNNING;
+    c->op_start_us = get_time_us();
+    conn_drive(loop, c);
+}
+
+static void conn_begin_iteration(socket_loop_t* loop, socket_conn_t* c) {
+    const socket_test_options_t* options = &loop->plan->options;
+    if (atomic_load(&loop->engine->stop_flag) ||
+        (options->iterations > 0 && c->iterations_done >= options->iterations)) {
+        conn_close(loop, c);
+        c->phase = CONN_DONE;
+        loop->open--;
+        return;
+    }
+
+    c->step = 0;
+    c->progress = 0;
+    c->op_start_us = get_time_us();
+    if (c->link.tcp.socket_fd >= 0) {
+        c->phase = CONN_RUNNING;
+        conn_drive(loop, c);
+        return;
+    }
+
+    const struct sockaddr_storage* addr = &loop->plan->addrs[c->target];
+    socklen_t addr_len = loop->plan->addr_lens[c->target];
+    bool tcp = options->protocol == PROTOCOL_TCP;
+    c->phase = CONN_CONNECTING;
+
+    int fd = socket(addr->ss_family, (tcp ? SOCK_STREAM : SOCK_DGRAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        c->phase = tcp ? CONN_CONNECTING : CONN_RUNNING;
+        conn_fail(loop, c, CURLE_COULDNT_CONNECT, errno);
+        return;
+    }
+    c->link.tcp.socket_fd = fd;
+    if (tcp) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = tcp ? EPOLLOUT : 0;
+    ev.data.ptr = c;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        if (!tcp) c->phase = CONN_RUNNING;
+        conn_fail(loop, c, CURLE_FAILED_INIT, errno);
+        return;
+    }
+    c->events = ev.events;
+
+    int rc;
+    do {
+        rc = connect(fd, (const struct sockaddr*)addr, addr_len);
+    } while (rc != 0 && errno == EINTR);
+
+    if (rc == 0) {
+        /* UDP only records its steps; the connect just fixes the peer */
+        if (!tcp) c->phase = CONN_RUNNING;
+        conn_established(loop, c);
+    } else if (tcp && errno == EINPROGRESS) {
+        conn_arm(loop, c);
+    } else {
+        if (!tcp) c->phase = CONN_RUNNING;
+        conn_fail(loop, c, CURLE_COULDNT_CONNECT, errno);
+    }
+}
+
+static void conn_on_event(socket_loop_t* loop, socket_conn_t* c, uint32_t events) {
+    if (c->phase == CONN_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(c->link.tcp.socket_fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) err = errno;
+        if (err == 0 && (events & EPOLLOUT)) {
+            conn_established(loop, c);
+        } else {
+            conn_fail(loop, c, CURLE_COULDNT_CONNECT, err);
+        }
+    } else if (c->phase == CONN_RUNNING) {
+        /* errors and hang-ups surface through the next send() or recv() */
+        conn_drive(loop, c);
+    }
+}
+
+static void loop_expire(socket_loop_t* loop) {
+    uint64_t now = get_time_us();
+    while (loop->timer_head && loop->timer_head->deadline_us <= now) {
+        conn_fail(loop, loop->timer_head, CURLE_OPERATION_TIMEDOUT, 0);
+    }
+}
+
+static void* socket_loop_thread_func(void* arg) {
+    socket_loop_t* loop = (socket_loop_t*)arg;
+    struct epoll_event events[SOCKET_LOOP_MAX_EVENTS];
+    engine_place_thread(loop->engine, loop->loop_id);
+    uint64_t woke_us = 0;
+
+    while (loop->open > 0) {
+        /* Start the iterations queued since the last pass; ones that finish
+           right away queue up for the pass after */
+        socket_conn_t* batch = loop->ready_head;
+        loop->ready_head = NULL;
+        while (batch) {
+            socket_conn_t* c = batch;
+            batch = c->ready_next;
+            c->ready_next = NULL;
+            conn_begin_iteration(loop, c);
+        }
+        if (loop->open == 0) break;
+
+        int wait_ms = SOCKET_LOOP_IDLE_WAIT_MS;
+        if (loop->ready_head) {
+            wait_ms = 0;
+        } else if (loop->timer_head) {
+            uint64_t now = get_time_us();
+            uint64_t until = loop->timer_head->deadline_us > now ? loop->timer_head->deadline_us - now : 0;
+            if (until < (uint64_t)wait_ms * 1000) wait_ms = (int)((until + 999) / 1000);
+        }
+
+        engine_record_loop_iteration(loop->engine, woke_us);
+        int n = epoll_wait(loop->epoll_fd, events, SOCKET_LOOP_MAX_EVENTS, wait_ms);
+        woke_us = get_time_us();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "[LoadSpiker] socket loop %d: epoll_wait failed: %s\n", loop->loop_id, strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            conn_on_event(loop, (socket_conn_t*)events[i].data.ptr, events[i].events);
+        }
+        loop_expire(loop);
+    }
+
+    /* The last loop out lets the controller finish without waiting a tick */
+    engine_thread_exit(loop->engine);
+    if (atomic_fetch_sub(&loop->group->running, 1) == 1) engine_wake_controller(loop->engine);
+    return NULL;
+}
+
+static void loop_destroy(socket_loop_t* loop) {
+    if (loop->conns) {
+        for (int i = 0; i < loop->capacity; i++) {
+            if (loop->conns[i].link.tcp.socket_fd >= 0) close(loop->conns[i].link.tcp.socket_fd);
+            free(loop->conns[i].buf);
+        }
+        free(loop->conns);
+        loop->conns = NULL;
+    }
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+        loop->epoll_fd = -1;
+    }
+}
+
+static int loop_init(socket_loop_t* loop, engine_t* engine, const socket_plan_t* plan, int loop_id,
+                     int loop_count, int capacity) {
+    memset(loop, 0, sizeof(socket_loop_t));
+    loop->engine = engine;
+    loop->plan = plan;
+    loop->loop_id = loop_id;
+    loop->capacity = capacity;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) return -1;
+
+    loop->conns = calloc((size_t)capacity, sizeof(socket_conn_t));
+    if (!loop->conns) return -1;
+
+    /* Connection i of the test is loop i % loops' connection i / loops */
+    for (int i = capacity - 1; i >= 0; i--) {
+        socket_conn_t* c = &loop->conns[i];
+        int index = i * loop_count + loop_id;
+        const socket_target_t* target = &plan->options.targets[index % plan->options.num_targets];
+        c->target = index % plan->options.num_targets;
+        snprintf(c->link.tcp.host, sizeof(c->link.tcp.host), "%s", target->host);
+        c->link.tcp.port = target->port;
+        c->link.tcp.socket_fd = -1;
+        conn_ready(loop, c);
+    }
+    loop->open = capacity;
+    return 0;
+}
+
+socket_loop_group_t* socket_loop_start(engine_t* engine, const socket_plan_t* plan) {
+    if (!engine || !plan || plan->options.connections <= 0) return NULL;
+
+    int connections = plan->options.connections;
+    int count = engine->event_loops;
+    if (count > connections) count = connections;
+    if (count <= 0) count = 1;
+
+    socket_loop_group_t* group = calloc(1, sizeof(socket_loop_group_t));
+    if (!group) return NULL;
+    group->loops = calloc((size_t)count, sizeof(socket_loop_t));
+    if (!group->loops) {
+        free(group);
+        return NULL;
+    }
+    group->count = count;
+
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        socket_loop_t* loop = &group->loops[i];
+        int capacity = connections / count + (i < connections % count ? 1 : 0);
+
+        if (loop_init(loop, engine, plan, i, count, capacity) != 0) {
+            fprintf(stderr, "[LoadSpiker] socket loop %d: initialisation failed\n", i);
+            loop_destroy(loop);
+            continue;
+        }
+        loop->group = group;
+        atomic_fetch_add(&group->running, 1);
+        if (pthread_create(&loop->thread, NULL, socket_loop_thread_func, loop) != 0) {
+            atomic_fetch_sub(&group->running, 1);
+            loop_destroy(loop);
+            continue;
+        }
+        loop->started = true;
+        started++;
+    }
+
+    if (started == 0) {
+        free(group->loops);
+        free(group);
+        return NULL;
+    }
+    return group;
+}
+
+bool socket_loop_done(socket_loop_group_t* group) {
+    return !group || atomic_load(&group->running) == 0;
+}
+
+void socket_loop_join(socket_loop_group_t* group) {
+    if (!group) return;
+
+    for (int i = 0; i < group->count; i++) {
+        socket_loop_t* loop = &group->loops[i];
+        if (!loop->started) continue;
+        pthread_join(loop->thread, NULL);
+        loop_destroy(loop);
+    }
+    free(group->loops);
+    free(group);
+}
+
+#else /* !__linux__ */
+
+socket_loop_group_t* socket_loop_start(engine_t* engine, const socket_plan_t* plan) {
+    (void)engine;
+    (void)plan;
+    return NULL;
+}
+
+bool socket_loop_done(socket_loop_group_t* group) {
+    (void)group;
+    return true;
+}
+
+void socket_loop_join(socket_loop_group_t* group) {
+    (void)group;
+}
+
+#endif /* __linux__ */
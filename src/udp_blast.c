@@ -0,0 +1,421 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   /* sendmmsg, recvmmsg */
+#endif
+#include "engine_internal.h"
+#include "common.h"
+#include "histogram.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * Datagram blaster behind engine_start_udp_blast().
+ *
+ * Every thread owns a share of the flows, each one UDP socket connected to
+ * the target, and a share of the rate. Pacing is by credit: at any moment a
+ * thread may have sent rate * elapsed datagrams, and whatever it is behind
+ * goes out in bursts of up to batch_size, one sendmmsg() (or one
+ * UDP_SEGMENT super-datagram) per burst. Below ~1000 pps per thread that is
+ * one datagram per wake-up; above it the bursts grow so the system call
+ * rate stays bounded.
+ *
+ * Each datagram starts with this blast's 64-bit tag and its send time, so
+ * echoes are matched without per-datagram state: RTT is now minus the
+ * carried timestamp, and anything without the tag (a previous blast's
+ * stragglers) is ignored.
+ */
+
+#ifdef __linux__
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define BLAST_HEADER_LEN 16
+#define BLAST_MAX_WAIT_MS 10        /* longest sleep, so stop_flag is seen promptly */
+#define BLAST_GSO_MAX_SEGMENTS 64   /* UDP_MAX_SEGMENTS on older kernels */
+#define BLAST_GSO_MAX_BYTES 65000
+
+typedef struct {
+    pthread_t thread;
+    bool started;
+    engine_t* engine;
+    const udp_blast_options_t* options;
+    struct udp_blast_group* group;
+    int* fds;
+    struct pollfd* pfds;
+    int flows;
+    int next_flow;
+    double rate_pps;               /* this thread's share; 0 = unthrottled */
+    bool gso;                      /* all of this thread's flows have UDP_SEGMENT set */
+    int gso_segments;
+
+    char* send_buf;                /* batch_size (or gso_segments) stamped copies of the payload */
+    struct mmsghdr* send_msgs;
+    struct iovec* send_iovs;
+    char* recv_buf;
+    struct mmsghdr* recv_msgs;
+    struct iovec* recv_iovs;
+
+    uint64_t sent;                 /* datagrams of credit used, including send_errors */
+    uint64_t received;
+    uint64_t send_errors;
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint64_t send_end_us;
+    histogram_t* rtt;
+} blast_thread_t;
+
+struct udp_blast_group {
+    blast_thread_t* threads;
+    int count;
+    _Atomic int running;
+    uint64_t start_us;
+    uint64_t tag;
+    int label;
+};
+
+static void blast_stamp(const blast_thread_t* t, char* datagram, uint64_t now_us) {
+    memcpy(datagram, &t->group->tag, sizeof(uint64_t));
+    memcpy(datagram + sizeof(uint64_t), &now_us, sizeof(uint64_t));
+}
+
+/* Send up to `want` datagrams on the next flow; returns the credit used
+   (datagrams sent, plus any the kernel refused) */
+static int blast_send_burst(blast_thread_t* t, int want) {
+    const udp_blast_options_t* options = t->options;
+    size_t size = (size_t)options->payload_size;
+    int fd = t->fds[t->next_flow];
+    t->next_flow = (t->next_flow + 1) % t->flows;
+    uint64_t now_us = get_time_us();
+
+    if (t->gso) {
+        int segments = want < t->gso_segments ? want : t->gso_segments;
+        for (int i = 0; i < segments; i++) blast_stamp(t, t->send_buf + (size_t)i * size, now_us);
+        ssize_t n = send(fd, t->send_buf, (size_t)segments * size, MSG_DONTWAIT);
+        if (n >= 0) {
+            t->bytes_sent += (uint64_t)n;
+            return segments;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ENOBUFS) return 0;
+        if (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP) {
+            /* no segmentation offload on this path after all: plain batches from now on */
+            int off = 0;
+            for (int i = 0; i < t->flows; i++) setsockopt(t->fds[i], SOL_UDP, UDP_SEGMENT, &off, sizeof(off));
+            t->gso = false;
+            return 0;
+        }
+        t->send_errors += (uint64_t)segments;
+        return segments;
+    }
+
+    int n = want < options->batch_size ? want : options->batch_size;
+    for (int i = 0; i < n; i++) blast_stamp(t, t->send_buf + (size_t)i * size, now_us);
+    int done = sendmmsg(fd, t->send_msgs, (unsigned int)n, MSG_DONTWAIT);
+    if (done > 0) {
+        t->bytes_sent += (uint64_t)done * size;
+        return done;
+    }
+    if (done < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ENOBUFS)) return 0;
+    /* e.g. ECONNREFUSED from an earlier ICMP port unreachable: the kernel
+       reports it instead of sending, so the whole burst is refused */
+    t->send_errors += (uint64_t)n;
+    return n;
+}
+
+/* Drain the echoes queued on one flow */
+static void blast_receive(blast_thread_t* t, int fd) {
+    const udp_blast_options_t* options = t->options;
+    for (;;) {
+        for (int i = 0; i < options->batch_size; i++) t->recv_msgs[i].msg_len = 0;
+        int done = recvmmsg(fd, t->recv_msgs, (unsigned int)options->batch_size, MSG_DONTWAIT, NULL);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return;   /* EAGAIN, or a queued ICMP error consumed */
+
+        uint64_t now_us = get_time_us();
+        for (int i = 0; i < done; i++) {
+            const char* data = t->recv_iovs[i].iov_base;
+            if (t->recv_msgs[i].msg_len < BLAST_HEADER_LEN || memcmp(data, &t->group->tag, sizeof(uint64_t)) != 0) continue;
+            uint64_t sent_us;
+            memcpy(&sent_us, data + sizeof(uint64_t), sizeof(uint64_t));
+            uint64_t rtt_us = now_us > sent_us ? now_us - sent_us : 0;
+            t->received++;
+            t->bytes_received += t->recv_msgs[i].msg_len;
+            histogram_record(t->rtt, rtt_us);
+            engine_record_socket_result(t->engine, t->group->label, rtt_us, CURLE_OK);
+        }
+        if (done < options->batch_size) return;
+    }
+}
+
+/* Wait up to wait_ms for echoes (or just sleep without expect_echo) */
+static void blast_wait(blast_thread_t* t, int wait_ms) {
+    if (!t->options->expect_echo) {
+        if (wait_ms > 0) poll(NULL, 0, wait_ms);
+        return;
+    }
+    if (poll(t->pfds, (nfds_t)t->flows, wait_ms) <= 0) return;
+    for (int i = 0; i < t->flows; i++) {
+        if (t->pfds[i].revents & (POLLIN | POLLERR)) blast_receive(t, t->fds[i]);
+    }
+}
+
+static void* blast_thread_func(void* arg) {
+    blast_thread_t* t = (blast_thread_t*)arg;
+    const udp_blast_options_t* options = t->options;
+    uint64_t start_us = t->group->start_us;
+    engine_place_thread(t->engine, (int)(t - t->group->threads));
+
+    while (!atomic_load(&t->engine->stop_flag)) {
+        uint64_t now_us = get_time_us();
+        uint64_t credit = UINT64_MAX;
+        if (t->rate_pps > 0.0) credit = (uint64_t)((double)(now_us - start_us) * t->rate_pps / 1e6) + 1;
+
+        if (credit > t->sent) {
+            uint64_t behind = credit - t->sent;
+            int want = behind > (uint64_t)options->batch_size ? options->batch_size : (int)behind;
+            int sent = blast_send_burst(t, want);
+            t->sent += (uint64_t)sent;
+            /* Unthrottled, or still behind: only pick up echoes on the way */
+            blast_wait(t, sent > 0 ? 0 : 1);
+            continue;
+        }
+
+        /* Ahead of schedule: wait for the next datagram's turn */
+        double next_us = (double)(t->sent) * 1e6 / t->rate_pps;
+        uint64_t due_us = start_us + (uint64_t)next_us;
+        /* At least 1ms: faster rates then go out as small bursts instead of
+           a thread spinning between datagrams */
+        int wait_ms = due_us > now_us ? (int)((due_us - now_us + 999) / 1000) : 1;
+        if (wait_ms > BLAST_MAX_WAIT_MS) wait_ms = BLAST_MAX_WAIT_MS;
+        blast_wait(t, wait_ms);
+    }
+    t->send_end_us = get_time_us();
+
+    /* Trailing echoes: until all are back or the linger time is up */
+    if (options->expect_echo) {
+        uint64_t linger_end_us = t->send_end_us + (uint64_t)options->linger_ms * 1000;
+        for (;;) {
+            uint64_t now_us = get_time_us();
+            if (t->received >= t->sent - t->send_errors || now_us >= linger_end_us) break;
+            uint64_t left_ms = (linger_end_us - now_us + 999) / 1000;
+            blast_wait(t, left_ms < BLAST_MAX_WAIT_MS ? (int)left_ms : BLAST_MAX_WAIT_MS);
+        }
+    }
+
+    /* The last thread out lets the controller finish without waiting a tick */
+    engine_thread_exit(t->engine);
+    if (atomic_fetch_sub(&t->group->running, 1) == 1) engine_wake_controller(t->engine);
+    return NULL;
+}
+
+static void blast_thread_free(blast_thread_t* t) {
+    if (t->fds) {
+        for (int i = 0; i < t->flows; i++) {
+            if (t->fds[i] >= 0) close(t->fds[i]);
+        }
+    }
+    free(t->fds);
+    free(t->pfds);
+    free(t->send_buf);
+    free(t->send_msgs);
+    free(t->send_iovs);
+    free(t->recv_buf);
+    free(t->recv_msgs);
+    free(t->recv_iovs);
+    histogram_destroy(t->rtt);
+    memset(t, 0, sizeof(blast_thread_t));
+}
+
+static int blast_thread_init(blast_thread_t* t, engine_t* engine, const udp_blast_options_t* options,
+                             const struct sockaddr_storage* addr, socklen_t addr_len, int flows) {
+    size_t size = (size_t)options->payload_size;
+    int batch = options->batch_size;
+    t->engine = engine;
+    t->options = options;
+    t->flows = flows;
+    t->fds = malloc(sizeof(int) * (size_t)flows);
+    t->pfds = calloc((size_t)flows, sizeof(struct pollfd));
+    t->rtt = histogram_create(&engine->latency_layout);
+    if (!t->fds || !t->pfds || !t->rtt) return -1;
+    for (int i = 0; i < flows; i++) t->fds[i] = -1;
+
+    t->gso = false;
+    for (int i = 0; i < flows; i++) {
+        int fd = socket(addr->ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        t->fds[i] = fd;
+        if (connect(fd, (const struct sockaddr*)addr, addr_len) != 0) return -1;
+        t->pfds[i].fd = fd;
+        t->pfds[i].events = POLLIN;
+    }
+
+#ifdef UDP_SEGMENT
+    if (options->use_gso && flows > 0) {
+        int segment = options->payload_size;
+        t->gso = true;
+        for (int i = 0; i < flows && t->gso; i++) {
+            t->gso = setsockopt(t->fds[i], SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment)) == 0;
+        }
+        t->gso_segments = BLAST_GSO_MAX_BYTES / options->payload_size;
+        if (t->gso_segments > BLAST_GSO_MAX_SEGMENTS) t->gso_segments = BLAST_GSO_MAX_SEGMENTS;
+        if (t->gso_segments > batch) t->gso_segments = batch;
+        if (t->gso_segments < 2) t->gso = false;
+    }
+#endif
+
+    /* One stamped copy of the payload per datagram of a burst */
+    int copies = batch > t->gso_segments ? batch : t->gso_segments;
+    t->send_buf = calloc((size_t)copies, size);
+    t->send_msgs = calloc((size_t)batch, sizeof(struct mmsghdr));
+    t->send_iovs = calloc((size_t)batch, sizeof(struct iovec));
+    if (!t->send_buf || !t->send_msgs || !t->send_iovs) return -1;
+    for (int i = 0; i < copies; i++) {
+        char* datagram = t->send_buf + (size_t)i * size;
+        for (size_t b = BLAST_HEADER_LEN; b < size; b++) datagram[b] = (char)('a' + b % 26);
+    }
+    for (int i = 0; i < batch; i++) {
+        t->send_iovs[i].iov_base = t->send_buf + (size_t)i * size;
+        t->send_iovs[i].iov_len = size;
+        t->send_msgs[i].msg_hdr.msg_iov = &t->send_iovs[i];
+        t->send_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    if (options->expect_echo) {
+        t->recv_buf = malloc((size_t)batch * size);
+        t->recv_msgs = calloc((size_t)batch, sizeof(struct mmsghdr));
+        t->recv_iovs = calloc((size_t)batch, sizeof(struct iovec));
+        if (!t->recv_buf || !t->recv_msgs || !t->recv_iovs) return -1;
+        for (int i = 0; i < batch; i++) {
+            t->recv_iovs[i].iov_base = t->recv_buf + (size_t)i * size;
+            t->recv_iovs[i].iov_len = size;
+            t->recv_msgs[i].msg_hdr.msg_iov = &t->recv_iovs[i];
+            t->recv_msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+    return 0;
+}
+
+udp_blast_group_t* udp_blast_start(engine_t* engine, const udp_blast_options_t* options,
+                                   const struct sockaddr_storage* addr, socklen_t addr_len, int label) {
+    if (!engine || !options || !addr || options->flows <= 0) return NULL;
+
+    int count = engine->event_loops;
+    if (count > options->flows) count = options->flows;
+    if (count <= 0) count = 1;
+
+    udp_blast_group_t* group = calloc(1, sizeof(udp_blast_group_t));
+    if (!group) return NULL;
+    group->threads = calloc((size_t)count, sizeof(blast_thread_t));
+    if (!group->threads) {
+        free(group);
+        return NULL;
+    }
+    group->count = count;
+    group->label = label;
+    group->start_us = get_time_us();
+    uint64_t seed = group->start_us ^ (uint64_t)(uintptr_t)group;
+    group->tag = (seed ^ (seed >> 31)) * 0x9e3779b97f4a7c15ULL;
+
+    /* Set every thread up before any starts, so a failure sends nothing */
+    for (int i = 0; i < count; i++) {
+        blast_thread_t* t = &group->threads[i];
+        int flows = options->flows / count + (i < options->flows % count ? 1 : 0);
+        t->group = group;
+        if (blast_thread_init(t, engine, options, addr, addr_len, flows) != 0) {
+            fprintf(stderr, "[LoadSpiker] UDP blast: flow setup failed: %s\n", strerror(errno));
+            for (int j = 0; j <= i; j++) blast_thread_free(&group->threads[j]);
+            free(group->threads);
+            free(group);
+            return NULL;
+        }
+        t->rate_pps = options->rate_pps * flows / options->flows;
+    }
+
+    group->start_us = get_time_us();
+    for (int i = 0; i < count; i++) {
+        blast_thread_t* t = &group->threads[i];
+        atomic_fetch_add(&group->running, 1);
+        if (pthread_create(&t->thread, NULL, blast_thread_func, t) != 0) {
+            atomic_fetch_sub(&group->running, 1);
+            continue;
+        }
+        t->started = true;
+    }
+    return group;
+}
+
+bool udp_blast_done(udp_blast_group_t* group) {
+    return !group || atomic_load(&group->running) == 0;
+}
+
+void udp_blast_join(udp_blast_group_t* group, udp_blast_result_t* result) {
+    if (!group) return;
+
+    memset(result, 0, sizeof(udp_blast_result_t));
+    histogram_t* rtt = NULL;
+    uint64_t send_end_us = group->start_us;
+    bool gso = true;
+    for (int i = 0; i < group->count; i++) {
+        blast_thread_t* t = &group->threads[i];
+        if (t->started) pthread_join(t->thread, NULL);
+        result->datagrams_sent += t->sent - t->send_errors;
+        result->datagrams_received += t->received;
+        result->send_errors += t->send_errors;
+        result->bytes_sent += t->bytes_sent;
+        result->bytes_received += t->bytes_received;
+        if (t->send_end_us > send_end_us) send_end_us = t->send_end_us;
+        gso = gso && t->gso;
+        if (!rtt) {
+            rtt = t->rtt;
+            t->rtt = NULL;
+        } else if (t->rtt) {
+            histogram_add(rtt, t->rtt);
+        }
+        blast_thread_free(t);
+    }
+
+    result->gso_used = gso;
+    result->elapsed_seconds = (double)(send_end_us - group->start_us) / 1e6;
+    if (result->elapsed_seconds > 0.0) {
+        result->send_pps = (double)result->datagrams_sent / result->elapsed_seconds;
+        result->receive_pps = (double)result->datagrams_received / result->elapsed_seconds;
+    }
+    if (rtt) {
+        result->rtt_p50_us = histogram_value_at_percentile(rtt, 50.0);
+        result->rtt_p90_us = histogram_value_at_percentile(rtt, 90.0);
+        result->rtt_p99_us = histogram_value_at_percentile(rtt, 99.0);
+        result->rtt_max_us = rtt->max_value;
+        histogram_destroy(rtt);
+    }
+
+    free(group->threads);
+    free(group);
+}
+
+#else /* !__linux__ */
+
+udp_blast_group_t* udp_blast_start(engine_t* engine, const udp_blast_options_t* options,
+                                   const struct sockaddr_storage* addr, socklen_t addr_len, int label) {
+    (void)engine;
+    (void)options;
+    (void)addr;
+    (void)addr_len;
+    (void)label;
+    return NULL;
+}
+
+bool udp_blast_done(udp_blast_group_t* group) {
+    (void)group;
+    return true;
+}
+
+void udp_blast_join(udp_blast_group_t* group, udp_blast_result_t* result) {
+    (void)group;
+    (void)result;
+}
+
+#endif /* __linux__ */
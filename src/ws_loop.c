@@ -0,0 +1,747 @@
+#include "engine_internal.h"
+#include "common.h"
+#include "histogram.h"
+#include "protocols/websocket.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+ * WebSocket back-end behind engine_start_websocket_test().
+ *
+ * Each loop owns an epoll set and its share of the connections, every one
+ * a non-blocking RFC 6455 client driven as a state machine: TCP connect,
+ * HTTP upgrade, then data frames until it is done sending, its echoes are
+ * in, and the close handshake has run. Frames are built with the helpers
+ * in protocols/websocket.c straight into a per-connection output buffer -
+ * the payload template is masked while it is copied there - and a pass
+ * queues up to WS_SEND_BURST of them before the single send() that writes
+ * the batch.
+ *
+ * Payloads start with the run's tag and their send time as 32 hex digits,
+ * so text frames stay valid UTF-8 and an echo is timed without per-message
+ * state. In ROUND_TRIP mode a connection keeps one message in flight and
+ * matches the echo by its send time; in RATE mode it sends on schedule and
+ * times whatever echoes come back.
+ */
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#define WS_LOOP_MAX_EVENTS 256
+#define WS_STAMP_LEN 32                  /* 16 hex digits of tag, 16 of send time */
+#define WS_READ_CHUNK 16384
+#define WS_MAX_MESSAGE (16 << 20)        /* larger incoming frames are treated as garbage */
+#define WS_OUT_HIGH_WATER 65536          /* queue no more messages above this much unsent output */
+#define WS_SEND_BURST 64                 /* frames per connection per pass, so one cannot hog its loop */
+#define WS_SWEEP_US 50000                /* how often round trips are checked for timeouts */
+#define WS_CLOSE_WAIT_US 1000000         /* how long to wait for the server's close frame */
+
+typedef enum {
+    CLIENT_IDLE = 0,        /* not connected yet (connect_rate) */
+    CLIENT_CONNECTING,      /* TCP handshake */
+    CLIENT_UPGRADING,       /* upgrade request sent */
+    CLIENT_OPEN,
+    CLIENT_DRAINING,        /* done sending, waiting for echoes */
+    CLIENT_CLOSING,         /* close frame sent */
+    CLIENT_DONE
+} client_phase_t;
+
+typedef struct {
+    int fd;
+    client_phase_t phase;
+    bool upgraded;                /* counted in open_now */
+    bool send_done;               /* counted out of senders_left */
+    bool in_fragment;             /* a fragmented data message is being received */
+    uint64_t fragment_sent_us;    /* stamp of that message, 0 = not ours */
+    uint64_t op_start_us;         /* start of the connect, the drain or the close */
+    uint64_t open_us;             /* upgrade done: the rate schedule starts here */
+    uint64_t pending_us;          /* ROUND_TRIP: send time of the message in flight, 0 = none */
+    uint32_t events;              /* registered epoll interest */
+    char key[WS_KEY_LENGTH + 1];
+    out_buffer_t out;             /* frames not written yet */
+    unsigned char* in;            /* bytes of frames not complete yet */
+    size_t in_len;
+    size_t in_cap;
+    uint64_t sent;
+    uint64_t echoes;
+} ws_client_t;
+
+typedef struct {
+    pthread_t thread;
+    bool started;
+    engine_t* engine;
+    const ws_plan_t* plan;
+    struct ws_loop_group* group;
+    int loop_id;
+    int epoll_fd;
+    ws_client_t* clients;
+    int count;
+    int next_connect;             /* clients[next_connect..] are still CLIENT_IDLE */
+    int open;                     /* clients not yet CLIENT_DONE */
+    unsigned char* payload;       /* message template, stamped before every send */
+    double rate;                  /* messages per second per connection; 0 = unthrottled */
+    double connect_rate;          /* connections per second on this loop; 0 = all at once */
+    bool busy;                    /* a connection stopped at its burst limit */
+    uint64_t next_sweep_us;
+
+    uint64_t connected;
+    uint64_t connect_failures;
+    uint64_t closed_by_server;
+    uint64_t messages_sent;
+    uint64_t messages_received;
+    uint64_t echoes;
+    uint64_t timeouts;
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    histogram_t* rtt;
+} ws_loop_t;
+
+struct ws_loop_group {
+    ws_loop_t* loops;
+    int count;
+    _Atomic int running;
+    _Atomic int open_now;
+    _Atomic int peak_open;
+    _Atomic int senders_left;
+    _Atomic uint64_t send_end_us;       /* 0 until the last connection is done sending */
+    uint64_t start_us;
+    uint64_t tag;
+    unsigned char tag_hex[16];
+};
+
+static void stamp_hex(unsigned char* out, uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 15; i >= 0; i--) {
+        out[i] = (unsigned char)digits[value & 15];
+        value >>= 4;
+    }
+}
+
+/* Send time of a message carrying this run's stamp, or 0 */
+static uint64_t stamp_parse(const ws_loop_t* loop, const unsigned char* payload, size_t len) {
+    if (len < WS_STAMP_LEN || memcmp(payload, loop->group->tag_hex, 16) != 0) return 0;
+    uint64_t value = 0;
+    for (int i = 16; i < WS_STAMP_LEN; i++) {
+        unsigned char ch = payload[i];
+        int digit = ch >= '0' && ch <= '9' ? ch - '0' : ch >= 'a' && ch <= 'f' ? ch - 'a' + 10 : -1;
+        if (digit < 0) return 0;
+        value = value << 4 | (uint64_t)digit;
+    }
+    return value;
+}
+
+static void client_watch(ws_loop_t* loop, ws_client_t* c, uint32_t events) {
+    engine_loop_watch(loop->epoll_fd, c->fd, c, &c->events, events);
+}
+
+/* A connection is counted out of senders_left once, sent or not; the last
+   one ends the send phase */
+static void client_end_sending(ws_loop_t* loop, ws_client_t* c) {
+    if (c->send_done) return;
+    c->send_done = true;
+    if (atomic_fetch_sub(&loop->group->senders_left, 1) == 1) {
+        atomic_store(&loop->group->send_end_us, get_time_us());
+    }
+}
+
+static void client_finish(ws_loop_t* loop, ws_client_t* c) {
+    if (c->fd >= 0) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        c->fd = -1;
+    }
+    if (c->upgraded) {
+        atomic_fetch_sub(&loop->group->open_now, 1);
+        c->upgraded = false;
+    }
+    client_end_sending(loop, c);
+    c->phase = CLIENT_DONE;
+    loop->open--;
+}
+
+/* The connection is unusable: one failed sample for what it was doing,
+   then it is done */
+static void client_fail(ws_loop_t* loop, ws_client_t* c, CURLcode result) {
+    const ws_plan_t* plan = loop->plan;
+    if (c->phase == CLIENT_CONNECTING || c->phase == CLIENT_UPGRADING) {
+        engine_record_socket_since(loop->engine, plan->connect_label, c->op_start_us, result);
+        loop->connect_failures++;
+    } else if (c->phase == CLIENT_OPEN || c->phase == CLIENT_DRAINING) {
+        engine_record_socket_since(loop->engine, plan->message_label,
+                                   c->pending_us ? c->pending_us : get_time_us(), result);
+        loop->closed_by_server++;
+    }
+    client_finish(loop, c);
+}
+
+/* Mask payload straight into the output buffer behind its header */
+static bool client_queue_frame(ws_client_t* c, int opcode, const void* payload, size_t len) {
+    if (!out_buffer_reserve(&c->out, len + WS_MAX_FRAME_HEADER)) return false;
+    unsigned char mask[4];
+    websocket_random_bytes(mask, sizeof(mask));
+    c->out.len += websocket_encode_frame((unsigned char*)c->out.data + c->out.len, opcode, true, payload, len, mask);
+    return true;
+}
+
+static bool client_queue_close(ws_client_t* c, int code) {
+    unsigned char body[2] = {(unsigned char)(code >> 8), (unsigned char)(code & 0xFF)};
+    return client_queue_frame(c, WS_OPCODE_CLOSE, body, sizeof(body));
+}
+
+/* Write what the socket takes; watch EPOLLOUT while anything is left.
+   Returns -1 once the client has failed. */
+static int client_flush(ws_loop_t* loop, ws_client_t* c) {
+    if (out_buffer_send(&c->out, c->fd) < 0) {
+        client_fail(loop, c, CURLE_SEND_ERROR);
+        return -1;
+    }
+    client_watch(loop, c, out_buffer_pending(&c->out) > 0 ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    return 0;
+}
+
+static bool client_sending_done(const ws_loop_t* loop, const ws_client_t* c) {
+    int messages = loop->plan->options.messages;
+    return atomic_load(&loop->engine->stop_flag) || (messages > 0 && c->sent >= (uint64_t)messages);
+}
+
+/* Queue as many messages as the mode, the rate, the output buffer and the
+   burst limit allow */
+static bool client_send(ws_loop_t* loop, ws_client_t* c, uint64_t now_us) {
+    const websocket_test_options_t* options = &loop->plan->options;
+    bool round_trip = options->mode == WEBSOCKET_MODE_ROUND_TRIP;
+    int opcode = options->binary ? WS_OPCODE_BINARY : WS_OPCODE_TEXT;
+
+    for (int burst = 0; burst < WS_SEND_BURST; burst++) {
+        if (client_sending_done(loop, c)) {
+            client_end_sending(loop, c);
+            c->phase = CLIENT_DRAINING;
+            c->op_start_us = now_us;
+            return true;
+        }
+        if (round_trip && c->pending_us != 0) return true;
+        if (loop->rate > 0.0) {
+            uint64_t credit = (uint64_t)((double)(now_us - c->open_us) * loop->rate / 1e6) + 1;
+            if (c->sent >= credit) return true;
+        }
+        if (out_buffer_pending(&c->out) >= WS_OUT_HIGH_WATER) return true;
+
+        stamp_hex(loop->payload + 16, now_us);
+        if (!client_queue_frame(c, opcode, loop->payload, (size_t)options->payload_size)) return false;
+        c->sent++;
+        loop->messages_sent++;
+        loop->bytes_sent += (uint64_t)options->payload_size;
+        if (round_trip) {
+            c->pending_us = now_us;
+            return true;
+        }
+    }
+    loop->busy = true;
+    return true;
+}
+
+/* Every echo this connection can still expect is in (or given up on) */
+static bool client_drained(const ws_loop_t* loop, const ws_client_t* c, uint64_t now_us) {
+    const websocket_test_options_t* options = &loop->plan->options;
+    if (options->mode == WEBSOCKET_MODE_ROUND_TRIP) return c->pending_us == 0;
+    return c->echoes >= c->sent || now_us - c->op_start_us >= (uint64_t)options->linger_ms * 1000;
+}
+
+/* Send what is due, start the close of a drained connection, write the output */
+static void client_service(ws_loop_t* loop, ws_client_t* c, uint64_t now_us) {
+    if (c->phase == CLIENT_OPEN && !client_send(loop, c, now_us)) {
+        client_fail(loop, c, CURLE_OUT_OF_MEMORY);
+        return;
+    }
+    if (c->phase == CLIENT_DRAINING && client_drained(loop, c, now_us)) {
+        if (!client_queue_close(c, WS_CLOSE_NORMAL)) {
+            client_fail(loop, c, CURLE_OUT_OF_MEMORY);
+            return;
+        }
+        c->phase = CLIENT_CLOSING;
+        c->op_start_us = now_us;
+    }
+    client_flush(loop, c);
+}
+
+/* A complete data message, timed if it is ours */
+static void client_on_message(ws_loop_t* loop, ws_client_t* c, uint64_t sent_us) {
+    loop->messages_received++;
+    if (sent_us == 0) return;
+    if (loop->plan->options.mode == WEBSOCKET_MODE_ROUND_TRIP) {
+        if (sent_us != c->pending_us) return;   /* late echo of a timed-out message */
+        c->pending_us = 0;
+    }
+    uint64_t now_us = get_time_us();
+    uint64_t rtt_us = now_us > sent_us ? now_us - sent_us : 0;
+    histogram_record(loop->rtt, rtt_us);
+    engine_record_socket_result(loop->engine, loop->plan->message_label, rtt_us, CURLE_OK);
+    loop->echoes++;
+    c->echoes++;
+}
+
+/* Act on one complete frame; false when the client is done */
+static bool client_on_frame(ws_loop_t* loop, ws_client_t* c, const websocket_frame_t* frame,
+                            unsigned char* payload, size_t len) {
+    switch (frame->opcode) {
+    case WS_OPCODE_TEXT:
+    case WS_OPCODE_BINARY:
+    case WS_OPCODE_CONTINUATION:
+        if ((frame->opcode == WS_OPCODE_CONTINUATION) != c->in_fragment) {
+            client_fail(loop, c, CURLE_WEIRD_SERVER_REPLY);
+            return false;
+        }
+        if (!c->in_fragment) c->fragment_sent_us = stamp_parse(loop, payload, len);
+        loop->bytes_received += len;
+        c->in_fragment = !frame->fin;
+        if (frame->fin) client_on_message(loop, c, c->fragment_sent_us);
+        return true;
+
+    case WS_OPCODE_PING:
+        if (!client_queue_frame(c, WS_OPCODE_PONG, payload, len)) {
+            client_fail(loop, c, CURLE_OUT_OF_MEMORY);
+            return false;
+        }
+        return true;
+
+    case WS_OPCODE_CLOSE:
+        if (c->phase != CLIENT_CLOSING) {
+            /* The server closed first: answer with its code, best effort */
+            int code = len >= 2 ? (payload[0] << 8 | payload[1]) : WS_CLOSE_NORMAL;
+            if (client_queue_close(c, code)) {
+                send(c->fd, c->out.data + c->out.off, out_buffer_pending(&c->out), MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
+            client_fail(loop, c, CURLE_GOT_NOTHING);
+            return false;
+        }
+        client_finish(loop, c);
+        return false;
+
+    default:
+        return true;   /* PONG */
+    }
+}
+
+/* The upgrade response is complete at in[0..end): check it, open the
+   connection; false when the client has failed */
+static bool client_on_upgrade(ws_loop_t* loop, ws_client_t* c, size_t end) {
+    const ws_plan_t* plan = loop->plan;
+    int status = 0;
+    if (websocket_check_upgrade((const char*)c->in, end, c->key, plan->options.subprotocol, &status, NULL, 0) != 0) {
+        client_fail(loop, c, status && status != 101 ? CURLE_HTTP_RETURNED_ERROR : CURLE_WEIRD_SERVER_REPLY);
+        return false;
+    }
+    engine_record_socket_since(loop->engine, plan->connect_label, c->op_start_us, CURLE_OK);
+    loop->connected++;
+
+    int now_open = atomic_fetch_add(&loop->group->open_now, 1) + 1;
+    int peak = atomic_load(&loop->group->peak_open);
+    while (now_open > peak && !atomic_compare_exchange_weak(&loop->group->peak_open, &peak, now_open)) {
+    }
+    c->upgraded = true;
+    c->phase = CLIENT_OPEN;
+    c->open_us = get_time_us();
+    memmove(c->in, c->in + end, c->in_len - end);
+    c->in_len -= end;
+    return true;
+}
+
+/* Read everything queued and act on each complete frame */
+static void client_read(ws_loop_t* loop, ws_client_t* c) {
+    for (;;) {
+        if (c->in_cap - c->in_len < WS_READ_CHUNK) {
+            size_t cap = c->in_cap ? c->in_cap * 2 : WS_READ_CHUNK * 2;
+            unsigned char* in = realloc(c->in, cap);
+            if (!in) {
+                client_fail(loop, c, CURLE_OUT_OF_MEMORY);
+                return;
+            }
+            c->in = in;
+            c->in_cap = cap;
+        }
+        ssize_t n = recv(c->fd, c->in + c->in_len, c->in_cap - c->in_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            /* A hang-up after our close frame is the end of the handshake */
+            if (c->phase == CLIENT_CLOSING) {
+                client_finish(loop, c);
+            } else {
+                client_fail(loop, c, n == 0 ? CURLE_GOT_NOTHING : CURLE_RECV_ERROR);
+            }
+            return;
+        }
+        c->in_len += (size_t)n;
+
+        if (c->phase == CLIENT_UPGRADING) {
+            size_t end = websocket_find_headers_end((const char*)c->in, c->in_len);
+            if (end == 0) {
+                if (c->in_len >= WS_MAX_HANDSHAKE) {
+                    client_fail(loop, c, CURLE_WEIRD_SERVER_REPLY);
+                    return;
+                }
+                continue;
+            }
+            if (!client_on_upgrade(loop, c, end)) return;
+        }
+
+        size_t pos = 0;
+        for (;;) {
+            websocket_frame_t frame;
+            int parsed = websocket_parse_frame(c->in + pos, c->in_len - pos, &frame);
+            if (parsed < 0 || (parsed > 0 && frame.payload_len > WS_MAX_MESSAGE)) {
+                client_fail(loop, c, CURLE_WEIRD_SERVER_REPLY);
+                return;
+            }
+            if (parsed == 0 || c->in_len - pos - frame.header_len < frame.payload_len) break;
+            unsigned char* payload = c->in + pos + frame.header_len;
+            size_t len = (size_t)frame.payload_len;
+            if (frame.masked) websocket_mask(payload, payload, len, frame.mask, 0);
+            pos += frame.header_len + len;
+            if (!client_on_frame(loop, c, &frame, payload, len)) return;
+        }
+        memmove(c->in, c->in + pos, c->in_len - pos);
+        c->in_len -= pos;
+    }
+}
+
+/* The TCP handshake is done: send the upgrade request */
+static void client_on_connected(ws_loop_t* loop, ws_client_t* c) {
+    const ws_plan_t* plan = loop->plan;
+    const websocket_test_options_t* options = &plan->options;
+    size_t need = strlen(plan->host) + strlen(plan->resource) + 256;
+    if (options->subprotocol) need += strlen(options->subprotocol);
+    if (options->origin) need += strlen(options->origin);
+    if (!out_buffer_reserve(&c->out, need)) {
+        client_fail(loop, c, CURLE_OUT_OF_MEMORY);
+        return;
+    }
+    websocket_make_key(c->key);
+    int len = websocket_build_upgrade(c->out.data + c->out.len, c->out.cap - c->out.len, plan->host, plan->port,
+                                      plan->resource, c->key, options->subprotocol, options->origin);
+    if (len < 0) {
+        client_fail(loop, c, CURLE_FAILED_INIT);
+        return;
+    }
+    c->out.len += (size_t)len;
+    c->phase = CLIENT_UPGRADING;
+    client_flush(loop, c);
+}
+
+static void client_connect(ws_loop_t* loop, ws_client_t* c) {
+    const ws_plan_t* plan = loop->plan;
+    c->phase = CLIENT_CONNECTING;
+    c->op_start_us = get_time_us();
+
+    int fd = socket(plan->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        client_fail(loop, c, CURLE_COULDNT_CONNECT);
+        return;
+    }
+    c->fd = fd;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    ev.data.ptr = c;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        client_fail(loop, c, CURLE_FAILED_INIT);
+        return;
+    }
+    c->events = EPOLLOUT;
+
+    int rc;
+    do {
+        rc = connect(fd, (const struct sockaddr*)&plan->addr, plan->addr_len);
+    } while (rc != 0 && errno == EINTR);
+    if (rc == 0) {
+        client_on_connected(loop, c);
+    } else if (errno != EINPROGRESS) {
+        client_fail(loop, c, CURLE_COULDNT_CONNECT);
+    }
+}
+
+static void client_on_event(ws_loop_t* loop, ws_client_t* c, uint32_t events) {
+    if (c->phase == CLIENT_DONE) return;
+    if (c->phase == CLIENT_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) err = errno;
+        if (err == 0 && (events & EPOLLOUT)) {
+            client_on_connected(loop, c);
+        } else {
+            client_fail(loop, c, CURLE_COULDNT_CONNECT);
+        }
+        return;
+    }
+    /* errors and hang-ups surface through recv() */
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        client_read(loop, c);
+        if (c->phase == CLIENT_DONE) return;
+    }
+    client_service(loop, c, get_time_us());
+}
+
+/* Timeouts, the end of a drain and the close handshake */
+static void client_tick(ws_loop_t* loop, ws_client_t* c, uint64_t now_us, bool sweep) {
+    uint64_t timeout_us = (uint64_t)loop->plan->options.timeout_ms * 1000;
+
+    if (c->phase == CLIENT_CONNECTING || c->phase == CLIENT_UPGRADING) {
+        if (now_us - c->op_start_us >= timeout_us) client_fail(loop, c, CURLE_OPERATION_TIMEDOUT);
+        return;
+    }
+    if (c->phase == CLIENT_CLOSING) {
+        if (now_us - c->op_start_us >= WS_CLOSE_WAIT_US) client_finish(loop, c);
+        return;
+    }
+    if (sweep && c->pending_us != 0 && now_us - c->pending_us >= timeout_us) {
+        engine_record_socket_since(loop->engine, loop->plan->message_label, c->pending_us, CURLE_OPERATION_TIMEDOUT);
+        loop->timeouts++;
+        c->pending_us = 0;
+    }
+    client_service(loop, c, now_us);
+}
+
+/* Open the connections that are due; once stop_flag is set the rest never
+   connect */
+static void loop_connect_due(ws_loop_t* loop, uint64_t now_us) {
+    while (loop->next_connect < loop->count) {
+        ws_client_t* c = &loop->clients[loop->next_connect];
+        if (atomic_load(&loop->engine->stop_flag)) {
+            client_finish(loop, c);
+        } else if (loop->connect_rate > 0.0 &&
+                   (uint64_t)loop->next_connect >= (uint64_t)((double)(now_us - loop->group->start_us) * loop->connect_rate / 1e6) + 1) {
+            return;
+        } else {
+            client_connect(loop, c);
+        }
+        loop->next_connect++;
+    }
+}
+
+static void* ws_loop_thread_func(void* arg) {
+    ws_loop_t* loop = (ws_loop_t*)arg;
+    struct epoll_event events[WS_LOOP_MAX_EVENTS];
+    engine_place_thread(loop->engine, loop->loop_id);
+    uint64_t woke_us = 0;
+
+    uint64_t next_tick_us = 0;
+    while (loop->open > 0) {
+        uint64_t now_us = get_time_us();
+        if (now_us >= next_tick_us || loop->busy) {
+            bool sweep = now_us >= loop->next_sweep_us;
+            if (sweep) loop->next_sweep_us = now_us + WS_SWEEP_US;
+            loop->busy = false;
+            loop_connect_due(loop, now_us);
+            now_us = get_time_us();   /* not before the connects just started */
+            for (int i = 0; i < loop->next_connect; i++) {
+                if (loop->clients[i].phase != CLIENT_DONE) client_tick(loop, &loop->clients[i], now_us, sweep);
+            }
+            if (loop->open == 0) break;
+
+            int tick_ms = ENGINE_LOOP_IDLE_WAIT_MS;
+            if (loop->rate > 0.0 || (loop->connect_rate > 0.0 && loop->next_connect < loop->count)) tick_ms = 1;
+            next_tick_us = get_time_us() + (uint64_t)tick_ms * 1000;
+        }
+
+        int wait_ms = 0;
+        if (!loop->busy) {
+            now_us = get_time_us();
+            wait_ms = next_tick_us > now_us ? (int)((next_tick_us - now_us + 999) / 1000) : 0;
+        }
+        engine_record_loop_iteration(loop->engine, woke_us);
+        int n = epoll_wait(loop->epoll_fd, events, WS_LOOP_MAX_EVENTS, wait_ms);
+        woke_us = get_time_us();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "[LoadSpiker] WebSocket loop %d: epoll_wait failed: %s\n", loop->loop_id, strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            client_on_event(loop, (ws_client_t*)events[i].data.ptr, events[i].events);
+        }
+    }
+
+    /* The last loop out lets the controller finish without waiting a tick */
+    engine_thread_exit(loop->engine);
+    if (atomic_fetch_sub(&loop->group->running, 1) == 1) engine_wake_controller(loop->engine);
+    return NULL;
+}
+
+static void loop_destroy(ws_loop_t* loop) {
+    if (loop->clients) {
+        for (int i = 0; i < loop->count; i++) {
+            ws_client_t* c = &loop->clients[i];
+            if (c->fd >= 0) close(c->fd);
+            out_buffer_free(&c->out);
+            free(c->in);
+        }
+        free(loop->clients);
+        loop->clients = NULL;
+    }
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+        loop->epoll_fd = -1;
+    }
+    free(loop->payload);
+    loop->payload = NULL;
+    histogram_destroy(loop->rtt);
+    loop->rtt = NULL;
+}
+
+static int loop_init(ws_loop_t* loop, engine_t* engine, const ws_plan_t* plan, int loop_id, int loop_count) {
+    const websocket_test_options_t* options = &plan->options;
+    loop->engine = engine;
+    loop->plan = plan;
+    loop->loop_id = loop_id;
+    loop->count = options->connections / loop_count + (loop_id < options->connections % loop_count ? 1 : 0);
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->clients = calloc((size_t)loop->count, sizeof(ws_client_t));
+    loop->payload = malloc((size_t)options->payload_size);
+    loop->rtt = histogram_create(&engine->latency_layout);
+    if (loop->clients) {
+        for (int k = 0; k < loop->count; k++) loop->clients[k].fd = -1;
+    }
+    if (loop->epoll_fd < 0 || !loop->clients || !loop->payload || !loop->rtt) return -1;
+
+    memcpy(loop->payload, loop->group->tag_hex, 16);
+    for (int b = WS_STAMP_LEN; b < options->payload_size; b++) loop->payload[b] = (unsigned char)('a' + b % 26);
+    if (options->rate > 0.0) loop->rate = options->rate / options->connections;
+    if (options->connect_rate > 0.0) loop->connect_rate = options->connect_rate / loop_count;
+    loop->open = loop->count;
+    return 0;
+}
+
+ws_loop_group_t* ws_loop_start(engine_t* engine, const ws_plan_t* plan) {
+    if (!engine || !plan || plan->options.connections <= 0) return NULL;
+    const websocket_test_options_t* options = &plan->options;
+
+    int count = engine->event_loops;
+    if (count > options->connections) count = options->connections;
+    if (count <= 0) count = 1;
+    engine_raise_fd_limit(options->connections, ENGINE_FD_HEADROOM, "WebSocket test");
+
+    ws_loop_group_t* group = calloc(1, sizeof(ws_loop_group_t));
+    if (!group) return NULL;
+    group->loops = calloc((size_t)count, sizeof(ws_loop_t));
+    if (!group->loops) {
+        free(group);
+        return NULL;
+    }
+    group->count = count;
+    group->start_us = get_time_us();
+    uint64_t seed = group->start_us ^ (uint64_t)(uintptr_t)group;
+    group->tag = (seed ^ (seed >> 31)) * 0x9e3779b97f4a7c15ULL;
+    stamp_hex(group->tag_hex, group->tag);
+    atomic_store(&group->senders_left, options->connections);
+
+    /* Set every loop up before any starts, so a failure connects nothing */
+    for (int i = 0; i < count; i++) {
+        ws_loop_t* loop = &group->loops[i];
+        loop->epoll_fd = -1;
+        loop->group = group;
+        if (loop_init(loop, engine, plan, i, count) != 0) {
+            fprintf(stderr, "[LoadSpiker] WebSocket loop %d: initialisation failed\n", i);
+            for (int j = 0; j <= i; j++) loop_destroy(&group->loops[j]);
+            free(group->loops);
+            free(group);
+            return NULL;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        ws_loop_t* loop = &group->loops[i];
+        atomic_fetch_add(&group->running, 1);
+        if (pthread_create(&loop->thread, NULL, ws_loop_thread_func, loop) != 0) {
+            /* its connections never run: count them out so the others finish */
+            atomic_fetch_sub(&group->running, 1);
+            for (int k = 0; k < loop->count; k++) {
+                ws_client_t* c = &loop->clients[k];
+                c->phase = CLIENT_CONNECTING;
+                c->op_start_us = get_time_us();
+                client_fail(loop, c, CURLE_FAILED_INIT);
+            }
+            continue;
+        }
+        loop->started = true;
+    }
+    return group;
+}
+
+bool ws_loop_done(ws_loop_group_t* group) {
+    return !group || atomic_load(&group->running) == 0;
+}
+
+void ws_loop_join(ws_loop_group_t* group, websocket_test_result_t* result) {
+    if (!group) return;
+
+    memset(result, 0, sizeof(websocket_test_result_t));
+    histogram_t* rtt = NULL;
+    for (int i = 0; i < group->count; i++) {
+        ws_loop_t* loop = &group->loops[i];
+        if (loop->started) pthread_join(loop->thread, NULL);
+        result->connected += loop->connected;
+        result->connect_failures += loop->connect_failures;
+        result->closed_by_server += loop->closed_by_server;
+        result->messages_sent += loop->messages_sent;
+        result->messages_received += loop->messages_received;
+        result->echoes += loop->echoes;
+        result->timeouts += loop->timeouts;
+        result->bytes_sent += loop->bytes_sent;
+        result->bytes_received += loop->bytes_received;
+        if (!rtt) {
+            rtt = loop->rtt;
+            loop->rtt = NULL;
+        } else if (loop->rtt) {
+            histogram_add(rtt, loop->rtt);
+        }
+        loop_destroy(loop);
+    }
+
+    result->peak_open = (uint64_t)atomic_load(&group->peak_open);
+    uint64_t end_us = atomic_load(&group->send_end_us);
+    if (end_us > group->start_us) result->elapsed_seconds = (double)(end_us - group->start_us) / 1e6;
+    if (result->elapsed_seconds > 0.0) {
+        result->send_rate = (double)result->messages_sent / result->elapsed_seconds;
+        result->receive_rate = (double)result->messages_received / result->elapsed_seconds;
+    }
+    result->loss_rate = result->messages_sent && result->echoes < result->messages_sent ?
+                        1.0 - (double)result->echoes / (double)result->messages_sent : 0.0;
+    if (rtt) {
+        result->rtt_p50_us = histogram_value_at_percentile(rtt, 50.0);
+        result->rtt_p90_us = histogram_value_at_percentile(rtt, 90.0);
+        result->rtt_p99_us = histogram_value_at_percentile(rtt, 99.0);
+        result->rtt_max_us = rtt->max_value;
+        histogram_destroy(rtt);
+    }
+
+    free(group->loops);
+    free(group);
+}
+
+#else /* !__linux__ */
+
+ws_loop_group_t* ws_loop_start(engine_t* engine, const ws_plan_t* plan) {
+    (void)engine;
+    (void)plan;
+    return NULL;
+}
+
+bool ws_loop_done(ws_loop_group_t* group) {
+    (void)group;
+    return true;
+}
+
+void ws_loop_join(ws_loop_group_t* group, websocket_test_result_t* result) {
+    (void)group;
+    (void)result;
+}
+
+#endif /* __linux__ */
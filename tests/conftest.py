@@ -12,6 +12,12 @@ import pytest
 import threading
 import time
 import socket
+import http.server
+import socketserver
+import base64
+import hashlib
+import re
+import struct
 
 # Add parent directory to Python path for imports
 sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
@@ -153,4 +159,680 @@ def mock_udp_server():
     server = MockUDPServer()
     server.start()
     yield server, server.port
-    server.stop()
\ No newline at end of file
+    server.stop()
+
+
+# ---------------------------------------------------------------------------
+# Mock HTTP Server
+# ---------------------------------------------------------------------------
+
+class _MockHTTPHandler(http.server.BaseHTTPRequestHandler):
+    """Answers every method with 200 "ok"; paths under /missing return 404,
+    paths under /slow answer after 50 ms and paths under /hang after 5 s.
+    Paths under /large answer with 256 KB of "x" followed by "<end>"."""
+
+    protocol_version = "HTTP/1.1"
+    # Headers and body go out as separate writes; without TCP_NODELAY a reused
+    # connection waits on the client's delayed ACK (~40 ms) for every body
+    disable_nagle_algorithm = True
+
+    def setup(self):
+        super().setup()
+        with self.server.stats_lock:
+            self.server.connection_count += 1
+            self.server.peers.append(self.client_address)
+
+    def _respond(self):
+        length = int(self.headers.get('Content-Length') or 0)
+        payload = self.rfile.read(length) if length else b""
+        received = len(payload)
+        with self.server.stats_lock:
+            self.server.bytes_received += received
+            self.server.request_count += 1
+            self.server.seen.append((self.command, self.headers.get('X-LoadSpiker-Test')))
+            self.server.sent.append((self.path, payload))
+            self.server.in_flight += 1
+            self.server.concurrency.append((time.monotonic(), self.server.in_flight))
+        if self.path.startswith('/slow'):
+            time.sleep(0.05)
+        elif self.path.startswith('/hang'):
+            time.sleep(5)
+        with self.server.stats_lock:
+            self.server.in_flight -= 1
+        body = b"x" * 262144 + b"<end>" if self.path.startswith('/large') else b"ok"
+        self.send_response(404 if self.path.startswith('/missing') else 200)
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        if self.command != 'HEAD':
+            self.wfile.write(body)
+
+    do_GET = do_POST = do_PUT = do_DELETE = do_HEAD = do_PATCH = _respond
+
+    def log_message(self, *args):
+        pass
+
+
+class _ThreadingHTTPServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+    request_queue_size = 256
+
+
+class MockHTTPServer:
+    """Reusable local HTTP server so load-test tests do not need the network."""
+
+    def __init__(self, host='127.0.0.1', port=0):
+        self.server = _ThreadingHTTPServer((host, port), _MockHTTPHandler)
+        self.server.stats_lock = threading.Lock()   # handlers run on concurrent threads
+        self.server.request_count = 0
+        self.server.connection_count = 0
+        self.server.bytes_received = 0
+        self.server.seen = []       # (method, X-LoadSpiker-Test header) per request
+        self.server.sent = []       # (path, body) per request
+        self.server.in_flight = 0
+        self.server.concurrency = []  # (monotonic time, requests in flight) at each arrival
+        self.server.peers = []      # (client address, port) per connection
+        self.host, self.port = self.server.server_address
+        self.thread = None
+
+    @property
+    def url(self):
+        return f"http://{self.host}:{self.port}"
+
+    def start(self):
+        self.thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+        self.thread.start()
+        return self.port
+
+    def stop(self):
+        self.server.shutdown()
+        self.server.server_close()
+        if self.thread:
+            self.thread.join(timeout=1)
+
+
+@pytest.fixture
+def mock_http_server():
+    """Fixture providing a local HTTP server."""
+    server = MockHTTPServer()
+    server.start()
+    yield server
+    server.stop()
+
+
+# ---------------------------------------------------------------------------
+# Mock MQTT Broker
+# ---------------------------------------------------------------------------
+
+class MockMQTTBroker:
+    """Minimal MQTT 3.1.1 broker: CONNECT, SUBSCRIBE with exact or trailing
+    '#' filters, PUBLISH at QoS 0-2 with the matching acks, fan-out to
+    subscribers at min(publish, subscription) QoS, and PINGREQ.
+
+    Set refuse_connect to answer CONNACK with "not authorized", or
+    drop_acks to swallow PUBACK/PUBREC so publishes time out."""
+
+    def __init__(self, host='127.0.0.1', port=0):
+        self.host = host
+        self.port = port
+        self.server_socket = None
+        self.running = False
+        self.thread = None
+        self.lock = threading.Lock()
+        self.subscriptions = []     # (client socket, write lock, filter, qos)
+        self.client_ids = []
+        self.publish_count = 0
+        self.refuse_connect = False
+        self.drop_acks = False
+
+    def start(self):
+        self.server_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.server_socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.server_socket.bind((self.host, self.port))
+        self.server_socket.listen(128)
+        self.port = self.server_socket.getsockname()[1]
+        self.running = True
+        self.thread = threading.Thread(target=self._run, daemon=True)
+        self.thread.start()
+        return self.port
+
+    def stop(self):
+        self.running = False
+        if self.server_socket:
+            self.server_socket.close()
+        if self.thread:
+            self.thread.join(timeout=1)
+
+    def _run(self):
+        while self.running:
+            try:
+                client, _ = self.server_socket.accept()
+                client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                threading.Thread(target=self._handle, args=(client,), daemon=True).start()
+            except OSError:
+                break
+
+    @staticmethod
+    def _recv_exact(client, n):
+        data = b''
+        while len(data) < n:
+            chunk = client.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError
+            data += chunk
+        return data
+
+    def _read_packet(self, client):
+        header = self._recv_exact(client, 1)[0]
+        length, shift = 0, 0
+        while True:
+            byte = self._recv_exact(client, 1)[0]
+            length |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        return header, self._recv_exact(client, length) if length else b''
+
+    @staticmethod
+    def _encode(header, body):
+        length, encoded = len(body), bytearray()
+        while True:
+            byte, length = length % 128, length // 128
+            encoded.append(byte | (0x80 if length else 0))
+            if not length:
+                break
+        return bytes([header]) + bytes(encoded) + body
+
+    @staticmethod
+    def _matches(filter_, topic):
+        if filter_.endswith('#'):
+            return topic.startswith(filter_[:-1])
+        return filter_ == topic
+
+    def _fan_out(self, topic, payload, qos):
+        with self.lock:
+            targets = [s for s in self.subscriptions if self._matches(s[2], topic)]
+        name = len(topic).to_bytes(2, 'big') + topic.encode()
+        for sock, write_lock, _, sub_qos in targets:
+            out_qos = min(qos, sub_qos)
+            body = name + (b'\x00\x01' if out_qos else b'') + payload
+            try:
+                with write_lock:
+                    sock.sendall(self._encode(0x30 | (out_qos << 1), body))
+            except OSError:
+                pass
+
+    def _handle(self, client):
+        write_lock = threading.Lock()
+
+        def send(data):
+            with write_lock:
+                client.sendall(data)
+
+        try:
+            while self.running:
+                header, body = self._read_packet(client)
+                kind = header & 0xF0
+                if kind == 0x10:    # CONNECT: skip protocol name, level, flags, keep-alive
+                    name_len = int.from_bytes(body[0:2], 'big')
+                    pos = 2 + name_len + 4
+                    id_len = int.from_bytes(body[pos:pos + 2], 'big')
+                    with self.lock:
+                        self.client_ids.append(body[pos + 2:pos + 2 + id_len].decode())
+                    send(b'\x20\x02\x00' + (b'\x05' if self.refuse_connect else b'\x00'))
+                elif kind == 0x80:  # SUBSCRIBE
+                    packet_id, filter_len = body[0:2], int.from_bytes(body[2:4], 'big')
+                    filter_, qos = body[4:4 + filter_len].decode(), body[4 + filter_len]
+                    with self.lock:
+                        self.subscriptions.append((client, write_lock, filter_, qos))
+                    send(b'\x90\x03' + packet_id + bytes([qos]))
+                elif kind == 0x30:  # PUBLISH
+                    qos = (header >> 1) & 0x03
+                    topic_len = int.from_bytes(body[0:2], 'big')
+                    topic = body[2:2 + topic_len].decode()
+                    pos = 2 + topic_len
+                    packet_id = body[pos:pos + 2] if qos else b''
+                    payload = body[pos + (2 if qos else 0):]
+                    with self.lock:
+                        self.publish_count += 1
+                    self._fan_out(topic, payload, qos)
+                    if qos and not self.drop_acks:
+                        send((b'\x40\x02' if qos == 1 else b'\x50\x02') + packet_id)
+                elif kind == 0x60:  # PUBREL
+                    send(b'\x70\x02' + body[0:2])
+                elif kind == 0xC0:  # PINGREQ
+                    send(b'\xd0\x00')
+                elif kind == 0xE0:  # DISCONNECT
+                    break
+        except (OSError, ConnectionError, IndexError):
+            pass
+        finally:
+            with self.lock:
+                self.subscriptions = [s for s in self.subscriptions if s[0] is not client]
+            client.close()
+
+
+@pytest.fixture
+def mock_mqtt_broker():
+    """Fixture providing a local MQTT broker."""
+    broker = MockMQTTBroker()
+    broker.start()
+    yield broker
+    broker.stop()
+
+
+# ---------------------------------------------------------------------------
+# Mock WebSocket Server
+# ---------------------------------------------------------------------------
+
+class MockWebSocketServer:
+    """Minimal RFC 6455 echo server: the upgrade handshake, unmasking,
+    reassembly of fragmented messages, ping/pong and the close handshake.
+
+    Set reject_upgrade to answer the upgrade with 403, no_echo to swallow
+    data frames, or close_after to close each connection with 1001 after
+    that many messages. subprotocols lists the ones it agrees to."""
+
+    GUID = b'258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+
+    def __init__(self, host='127.0.0.1', port=0):
+        self.host = host
+        self.port = port
+        self.server_socket = None
+        self.running = False
+        self.thread = None
+        self.lock = threading.Lock()
+        self.connections = 0
+        self.message_count = 0
+        self.opcodes = set()
+        self.paths = []
+        self.reject_upgrade = False
+        self.no_echo = False
+        self.close_after = 0
+        self.subprotocols = []
+
+    def start(self):
+        self.server_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.server_socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.server_socket.bind((self.host, self.port))
+        self.server_socket.listen(256)
+        self.port = self.server_socket.getsockname()[1]
+        self.running = True
+        self.thread = threading.Thread(target=self._run, daemon=True)
+        self.thread.start()
+        return self.port
+
+    def stop(self):
+        self.running = False
+        if self.server_socket:
+            self.server_socket.close()
+        if self.thread:
+            self.thread.join(timeout=1)
+
+    def url(self, path='/'):
+        return 'ws://%s:%d%s' % (self.host, self.port, path)
+
+    def _run(self):
+        while self.running:
+            try:
+                client, _ = self.server_socket.accept()
+                client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                threading.Thread(target=self._handle, args=(client,), daemon=True).start()
+            except OSError:
+                break
+
+    @staticmethod
+    def _recv_exact(client, n):
+        data = b''
+        while len(data) < n:
+            chunk = client.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError
+            data += chunk
+        return data
+
+    def _handshake(self, client):
+        request = b''
+        while b'\r\n\r\n' not in request:
+            chunk = client.recv(4096)
+            if not chunk:
+                raise ConnectionError
+            request += chunk
+        lines = request.split(b'\r\n\r\n', 1)[0].decode('latin-1').split('\r\n')
+        headers = {}
+        for line in lines[1:]:
+            name, _, value = line.partition(':')
+            headers[name.strip().lower()] = value.strip()
+        with self.lock:
+            self.paths.append(lines[0].split(' ')[1])
+        if self.reject_upgrade:
+            client.sendall(b'HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n')
+            return False
+        accept = base64.b64encode(hashlib.sha1(headers['sec-websocket-key'].encode() + self.GUID).digest())
+        response = (b'HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n'
+                    b'Connection: Upgrade\r\nSec-WebSocket-Accept: ' + accept + b'\r\n')
+        offered = [p.strip() for p in headers.get('sec-websocket-protocol', '').split(',')]
+        chosen = [p for p in offered if p in self.subprotocols]
+        if chosen:
+            response += b'Sec-WebSocket-Protocol: ' + chosen[0].encode() + b'\r\n'
+        client.sendall(response + b'\r\n')
+        return True
+
+    def _read_frame(self, client):
+        first, second = self._recv_exact(client, 2)
+        length = second & 0x7F
+        if length == 126:
+            length = int.from_bytes(self._recv_exact(client, 2), 'big')
+        elif length == 127:
+            length = int.from_bytes(self._recv_exact(client, 8), 'big')
+        mask = self._recv_exact(client, 4) if second & 0x80 else b'\x00' * 4
+        payload = self._recv_exact(client, length)
+        payload = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        return bool(first & 0x80), first & 0x0F, payload
+
+    @staticmethod
+    def _encode(opcode, payload):
+        length = len(payload)
+        if length < 126:
+            header = bytes([0x80 | opcode, length])
+        elif length < 65536:
+            header = bytes([0x80 | opcode, 126]) + length.to_bytes(2, 'big')
+        else:
+            header = bytes([0x80 | opcode, 127]) + length.to_bytes(8, 'big')
+        return header + payload
+
+    def _handle(self, client):
+        try:
+            with self.lock:
+                self.connections += 1
+            if not self._handshake(client):
+                return
+            message, message_opcode, received = b'', 0, 0
+            while self.running:
+                fin, opcode, payload = self._read_frame(client)
+                if opcode == 0x8:       # close: echo the status code back
+                    client.sendall(self._encode(0x8, payload[:2]))
+                    break
+                if opcode == 0x9:       # ping
+                    client.sendall(self._encode(0xA, payload))
+                    continue
+                if opcode == 0xA:
+                    continue
+                if opcode:
+                    message_opcode, message = opcode, payload
+                else:
+                    message += payload
+                if not fin:
+                    continue
+                received += 1
+                with self.lock:
+                    self.message_count += 1
+                    self.opcodes.add(message_opcode)
+                if not self.no_echo:
+                    client.sendall(self._encode(message_opcode, message))
+                if self.close_after and received >= self.close_after:
+                    client.sendall(self._encode(0x8, (1001).to_bytes(2, 'big')))
+                    self._read_frame(client)
+                    break
+        except (OSError, ConnectionError, ValueError, KeyError):
+            pass
+        finally:
+            client.close()
+
+
+@pytest.fixture
+def mock_websocket_server():
+    """Fixture providing a local WebSocket echo server."""
+    server = MockWebSocketServer()
+    server.start()
+    yield server
+    server.stop()
+
+
+class MockPostgresServer:
+    """Minimal PostgreSQL server speaking protocol 3.0: startup with
+    cleartext password authentication (SSL and GSS encryption declined),
+    simple queries and the extended protocol (Parse/Bind/Describe/Execute/
+    Sync/Close), including pipelined batches.
+
+    Every SELECT returns the same three rows of (id int4, name text);
+    INSERT, UPDATE and DELETE report 1, 2 and 1 rows. A query mentioning
+    "missing" fails with 42P01 at parse time, and one with pg_sleep(n)
+    stalls n seconds before its result. max_batch is the most Execute
+    messages that arrived in a single read - more than one means the
+    client pipelined."""
+
+    ROWS = [(b'1', b'alice'), (b'2', b'bob'), (b'3', b'carol')]
+    COLUMNS = [(b'id', 23), (b'name', 25)]
+
+    def __init__(self, host='127.0.0.1', port=0, password='pass'):
+        self.host = host
+        self.port = port
+        self.password = password
+        self.server_socket = None
+        self.running = False
+        self.thread = None
+        self.lock = threading.Lock()
+        self.connections = 0
+        self.authenticated = 0
+        self.parse_count = 0
+        self.execute_count = 0
+        self.simple_queries = []
+        self.startup_params = []
+        self.max_batch = 0
+        self.clients = []
+
+    def start(self):
+        self.server_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.server_socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.server_socket.bind((self.host, self.port))
+        self.server_socket.listen(256)
+        self.port = self.server_socket.getsockname()[1]
+        self.running = True
+        self.thread = threading.Thread(target=self._run, daemon=True)
+        self.thread.start()
+        return self.port
+
+    def stop(self):
+        self.running = False
+        if self.server_socket:
+            self.server_socket.close()
+        with self.lock:
+            clients, self.clients = self.clients, []
+        for client in clients:
+            try:
+                client.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+        if self.thread:
+            self.thread.join(timeout=1)
+
+    def url(self, database='db', user='user', password='pass'):
+        return 'postgresql://%s:%s@%s:%d/%s' % (user, password, self.host, self.port, database)
+
+    def _run(self):
+        while self.running:
+            try:
+                client, _ = self.server_socket.accept()
+                client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                with self.lock:
+                    self.clients.append(client)
+                threading.Thread(target=self._handle, args=(client,), daemon=True).start()
+            except OSError:
+                break
+
+    @staticmethod
+    def _message(kind, body=b''):
+        return kind + struct.pack('!I', len(body) + 4) + body
+
+    def _error(self, code, text):
+        body = b'SERROR\0VERROR\0C' + code.encode() + b'\0M' + text.encode() + b'\0\0'
+        return self._message(b'E', body)
+
+    @staticmethod
+    def _recv_exact(client, n):
+        data = b''
+        while len(data) < n:
+            chunk = client.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError
+            data += chunk
+        return data
+
+    def _startup(self, client):
+        while True:
+            length, code = struct.unpack('!II', self._recv_exact(client, 8))
+            body = self._recv_exact(client, length - 8)
+            if code in (80877103, 80877104):    # SSLRequest, GSSENCRequest
+                client.sendall(b'N')
+                continue
+            if code != 196608:
+                return False
+            break
+        fields = body.split(b'\0')
+        params = dict(zip(fields[0::2], fields[1::2]))
+        with self.lock:
+            self.startup_params.append({k.decode(): v.decode() for k, v in params.items() if k})
+        if self.password is not None:
+            client.sendall(self._message(b'R', struct.pack('!I', 3)))
+            kind = self._recv_exact(client, 1)
+            length = struct.unpack('!I', self._recv_exact(client, 4))[0]
+            password = self._recv_exact(client, length - 4).rstrip(b'\0').decode()
+            if kind != b'p' or password != self.password:
+                client.sendall(self._error('28P01', 'password authentication failed for user "%s"'
+                                           % params.get(b'user', b'').decode()))
+                return False
+        out = self._message(b'R', struct.pack('!I', 0))
+        for name, value in ((b'server_version', b'15.0'), (b'client_encoding', b'UTF8'),
+                            (b'DateStyle', b'ISO, MDY'), (b'integer_datetimes', b'on'),
+                            (b'standard_conforming_strings', b'on')):
+            out += self._message(b'S', name + b'\0' + value + b'\0')
+        out += self._message(b'K', struct.pack('!II', 4242, 1234))
+        out += self._message(b'Z', b'I')
+        client.sendall(out)
+        with self.lock:
+            self.authenticated += 1
+        return True
+
+    def _describe(self, query):
+        if not query.lstrip().upper().startswith('SELECT'):
+            return self._message(b'n')
+        body = struct.pack('!H', len(self.COLUMNS))
+        for name, oid in self.COLUMNS:
+            body += name + b'\0' + struct.pack('!IHIhiH', 0, 0, oid, -1, -1, 0)
+        return self._message(b'T', body)
+
+    def _execute(self, query):
+        sleep = re.search(r'pg_sleep\(([0-9.]+)\)', query)
+        if sleep:
+            time.sleep(float(sleep.group(1)))
+        verb = query.lstrip().split(' ', 1)[0].upper()
+        if verb == 'SELECT':
+            out = b''
+            for row in self.ROWS:
+                body = struct.pack('!H', len(row))
+                for value in row:
+                    body += struct.pack('!I', len(value)) + value
+                out += self._message(b'D', body)
+            tag = 'SELECT %d' % len(self.ROWS)
+        else:
+            out = b''
+            tag = {'INSERT': 'INSERT 0 1', 'UPDATE': 'UPDATE 2', 'DELETE': 'DELETE 1'}.get(verb, verb)
+        return out + self._message(b'C', tag.encode() + b'\0')
+
+    def _handle(self, client):
+        statements, portals = {}, {}
+        try:
+            with self.lock:
+                self.connections += 1
+            if not self._startup(client):
+                return
+            buffer = b''
+            failed = False          # extended protocol: skip to the next Sync
+            while self.running:
+                chunk = client.recv(65536)
+                if not chunk:
+                    break
+                buffer += chunk
+                out = b''
+                executes = 0
+                while len(buffer) >= 5:
+                    kind = buffer[:1]
+                    length = struct.unpack('!I', buffer[1:5])[0]
+                    if len(buffer) < 1 + length:
+                        break
+                    body = buffer[5:1 + length]
+                    buffer = buffer[1 + length:]
+                    if kind == b'X':
+                        return
+                    if kind == b'S':
+                        failed = False
+                        out += self._message(b'Z', b'I')
+                        continue
+                    if kind == b'Q':
+                        query = body.rstrip(b'\0').decode()
+                        with self.lock:
+                            self.simple_queries.append(query)
+                        if 'missing' in query:
+                            out += self._error('42P01', 'relation "missing" does not exist')
+                        elif query.upper().startswith('DEALLOCATE'):
+                            statements.pop(query.split()[-1], None)
+                            out += self._message(b'C', b'DEALLOCATE\0')
+                        else:
+                            out += self._describe(query) if query.upper().startswith('SELECT') else b''
+                            out += self._execute(query)
+                        out += self._message(b'Z', b'I')
+                        continue
+                    if failed or kind == b'H':
+                        continue
+                    if kind == b'P':
+                        name, query = body.split(b'\0')[:2]
+                        with self.lock:
+                            self.parse_count += 1
+                        if b'missing' in query:
+                            out += self._error('42P01', 'relation "missing" does not exist')
+                            failed = True
+                            continue
+                        statements[name.decode()] = query.decode()
+                        out += self._message(b'1')
+                    elif kind == b'B':
+                        portal, statement = body.split(b'\0')[:2]
+                        if statement.decode() not in statements:
+                            out += self._error('26000', 'prepared statement "%s" does not exist'
+                                               % statement.decode())
+                            failed = True
+                            continue
+                        portals[portal.decode()] = statements[statement.decode()]
+                        out += self._message(b'2')
+                    elif kind == b'D':
+                        name = body[1:].rstrip(b'\0').decode()
+                        if body[:1] == b'S':
+                            out += self._message(b't', struct.pack('!H', 0)) + self._describe(statements.get(name, ''))
+                        else:
+                            out += self._describe(portals.get(name, ''))
+                    elif kind == b'E':
+                        portal = body.split(b'\0')[0].decode()
+                        executes += 1
+                        with self.lock:
+                            self.execute_count += 1
+                        out += self._execute(portals.get(portal, ''))
+                    elif kind == b'C':
+                        if body[:1] == b'S':
+                            statements.pop(body[1:].rstrip(b'\0').decode(), None)
+                        out += self._message(b'3')
+                with self.lock:
+                    self.max_batch = max(self.max_batch, executes)
+                if out:
+                    client.sendall(out)
+        except (OSError, ConnectionError, ValueError, struct.error):
+            pass
+        finally:
+            client.close()
+
+
+@pytest.fixture
+def mock_postgres_server():
+    """Fixture providing a local PostgreSQL protocol server."""
+    server = MockPostgresServer()
+    server.start()
+    yield server
+    server.stop()
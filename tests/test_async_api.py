@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Asynchronous API Tests
+=================================
+
+Tests for the non-blocking Python API against a local HTTP server:
+- start_load_test_async handles: poll, wait, stop, live metrics
+- Stops and timed test ends not waiting for requests in flight
+- One load test per engine at a time
+- execute_request releasing the GIL for concurrent Python threads
+- Awaitable execute_request_async on the engine's request loop
+- No request-path heap allocations once the engine is warm
+"""
+
+import sys
+import os
+import asyncio
+import threading
+import time
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+
+def _requests(base_url, path="/ok"):
+    return [{"url": base_url + path, "method": "GET"}]
+
+
+@_skip_no_c
+class TestLoadTestHandle:
+    """start_load_test_async returns straight away with a handle on the test."""
+
+    def test_runs_to_completion(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        test = engine.start_load_test_async(_requests(mock_http_server.url) * 50, users=2, duration=0)
+        assert test.wait(10) is True
+        assert test.poll() is True
+        assert test.metrics()['total_requests'] == 50
+        assert mock_http_server.server.request_count == 50
+
+    def test_stop_ends_a_long_test(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        started = time.monotonic()
+        test = engine.start_load_test_async(_requests(mock_http_server.url), users=2,
+                                            duration=60, loop=True)
+        assert test.poll() is False
+        assert test.wait(0.3) is False
+
+        live = test.metrics()['total_requests']
+        assert live > 0
+        test.stop()
+        assert test.wait(5) is True
+        assert time.monotonic() - started < 5
+        assert test.metrics()['total_requests'] >= live
+
+    def test_stop_before_the_test_is_set_up(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        test = engine.start_load_test_async(_requests(mock_http_server.url), users=2,
+                                            duration=60, loop=True)
+        test.stop()
+        assert test.wait(5) is True
+
+    def test_event_mode_and_windows(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1, mode="event",
+                        event_loops=1, metrics_window_ms=100)
+        with engine.start_load_test_async(_requests(mock_http_server.url), users=4,
+                                          duration=60, loop=True) as test:
+            time.sleep(0.5)
+            assert len(test.windows()) >= 2
+        assert test.poll() is True
+
+    def test_one_test_per_engine(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        test = engine.start_load_test_async(_requests(mock_http_server.url), users=1,
+                                            duration=60, loop=True)
+        with pytest.raises(RuntimeError):
+            engine.start_load_test_async(_requests(mock_http_server.url), users=1, duration=1)
+        with pytest.raises(RuntimeError):
+            engine.run_requests(_requests(mock_http_server.url), users=1, duration=1)
+        test.stop()
+        assert test.wait(5)
+
+        # Free again once the first test is over
+        engine.run_requests(_requests(mock_http_server.url) * 3, users=1, duration=0)
+
+    def test_dropping_the_handle_stops_the_test(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        started = time.monotonic()
+        test = engine.start_load_test_async(_requests(mock_http_server.url), users=1,
+                                            duration=60, loop=True)
+        del test
+        assert time.monotonic() - started < 5
+        engine.run_requests(_requests(mock_http_server.url), users=1, duration=0)
+
+    def test_bad_arguments_raise_before_starting(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(ValueError):
+            engine.start_load_test_async([], users=1, duration=1)
+        with pytest.raises(ValueError):
+            engine.start_load_test_async(_requests(mock_http_server.url), users=1, duration=0, loop=True)
+        # A failed start does not leave the engine marked busy
+        test = engine.start_load_test_async(_requests(mock_http_server.url), users=1, duration=0)
+        assert test.wait(5)
+
+
+@_skip_no_c
+class TestBoundedStop:
+    """Requests in flight are abandoned instead of holding the test open."""
+
+    def _hanging(self, base_url):
+        return [{"url": base_url + "/hang", "method": "GET", "timeout_ms": 30000}]
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_stop_abandons_requests_in_flight(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        test = engine.start_load_test_async(self._hanging(mock_http_server.url), users=3,
+                                            duration=60, loop=True)
+        time.sleep(0.3)
+        started = time.monotonic()
+        test.stop()
+        assert test.wait(2) is True
+        assert time.monotonic() - started < 1
+        assert test.metrics()['total_requests'] == 0
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_timed_test_ends_on_time(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        started = time.monotonic()
+        metrics = engine.run_requests(self._hanging(mock_http_server.url), users=2, duration=1, loop=True)
+        assert time.monotonic() - started < 2
+        assert metrics['total_requests'] == 0
+
+    def test_fixed_requests_still_complete(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        started = time.monotonic()
+        metrics = engine.run_requests(_requests(mock_http_server.url, "/slow") * 4, users=4, duration=0)
+        # The last responses are waited for, and the test ends as soon as they are in
+        assert metrics['total_requests'] == 4
+        assert metrics['successful_requests'] == 4
+        assert time.monotonic() - started < 0.5
+
+
+@_skip_no_c
+class TestConcurrentRequests:
+    """Single requests no longer serialize on the GIL."""
+
+    def test_threads_overlap(self, mock_http_server):
+        engine = Engine(max_connections=20, worker_threads=1)
+        url = mock_http_server.url + "/slow"
+        results = []
+
+        def worker():
+            results.append(engine.execute_request(url))
+
+        threads = [threading.Thread(target=worker) for _ in range(8)]
+        started = time.monotonic()
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        # Eight 50 ms requests one after the other would take 400 ms
+        assert time.monotonic() - started < 0.3
+        assert all(r['status_code'] == 200 for r in results)
+        assert max(n for _, n in mock_http_server.server.concurrency) > 1
+
+    def test_awaitable_requests(self, mock_http_server):
+        engine = Engine(max_connections=50, worker_threads=1)
+        url = mock_http_server.url
+
+        async def main():
+            return await asyncio.gather(
+                *[engine.execute_request_async(url + "/slow", headers={"X-LoadSpiker-Test": str(i)})
+                  for i in range(20)],
+                engine.execute_request_async(url + "/missing"))
+
+        started = time.monotonic()
+        responses = asyncio.run(main())
+        assert time.monotonic() - started < 0.5
+        assert [r['status_code'] for r in responses] == [200] * 20 + [404]
+        assert responses[0]['body'] == "ok"
+        tags = [h for _, h in mock_http_server.server.seen if h is not None]
+        assert sorted(tags) == sorted(str(i) for i in range(20))
+
+        metrics = engine.get_metrics()
+        assert metrics['total_requests'] == 21
+        assert metrics['failed_requests'] == 1
+
+    def test_awaitable_requests_across_event_loops(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        url = mock_http_server.url + "/ok"
+        for _ in range(2):
+            response = asyncio.run(engine.execute_request_async(url))
+            assert response['status_code'] == 200
+
+    def test_awaitable_request_errors(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        response = asyncio.run(engine.execute_request_async("http://127.0.0.1:1/", timeout_ms=2000))
+        assert response['status_code'] == 0
+        assert response['success'] is False
+        assert response['error_message']
+
+    def test_cancelled_request_is_dropped(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        url = mock_http_server.url
+
+        async def main():
+            task = asyncio.ensure_future(engine.execute_request_async(url + "/slow"))
+            await asyncio.sleep(0.01)
+            task.cancel()
+            with pytest.raises(asyncio.CancelledError):
+                await task
+            response = await engine.execute_request_async(url + "/ok")
+            await asyncio.sleep(0.1)   # the cancelled request still completes in C
+            return response
+
+        assert asyncio.run(main())['status_code'] == 200
+
+
+@_skip_no_c
+class TestScratchAllocations:
+    """Requests are built in per-thread arenas and reused jobs."""
+
+    def test_alloc_stats_keys(self):
+        stats = Engine(max_connections=10, worker_threads=1, hugepages=True).get_alloc_stats()
+        assert set(stats) == {'arenas', 'hugepage_arenas', 'arena_bytes', 'high_water', 'heap_allocations'}
+        assert stats['hugepage_arenas'] <= stats['arenas']
+
+    def test_warm_requests_do_not_allocate(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        url = mock_http_server.url + "/ok"
+        headers = {"X-LoadSpiker-Test": "warm", "Accept": "text/plain"}
+
+        async def send(count):
+            for _ in range(count):
+                response = await engine.execute_request_async(url, headers=headers)
+                assert response['status_code'] == 200
+
+        engine.execute_request(url, headers=headers)
+        asyncio.run(send(2))
+        before = engine.get_alloc_stats()
+        for _ in range(10):
+            assert engine.execute_request(url, headers=headers)['status_code'] == 200
+        asyncio.run(send(10))
+        after = engine.get_alloc_stats()
+
+        assert after['heap_allocations'] == before['heap_allocations']
+        assert after['arenas'] >= 1
+        assert after['high_water'] > 0
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Database Load Test Tests
+===================================
+
+Tests for engine_start_database_test against a local PostgreSQL mock:
+- Pipelined prepared queries over many connections
+- Rate and duration bounds, per-query labels
+- Server errors, refused connections and stalled queries
+- Argument validation
+"""
+
+import sys
+import os
+import socket
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+_has_libpq = False
+if _c_extension_available:
+    from loadspiker import loadspiker_c
+    _has_libpq = loadspiker_c.database_drivers['postgresql']
+
+_skip_no_libpq = pytest.mark.skipif(not _has_libpq,
+    reason="C extension built without libpq")
+
+
+def _closed_port():
+    """A local TCP port nothing listens on"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.bind(('127.0.0.1', 0))
+    port = sock.getsockname()[1]
+    sock.close()
+    return port
+
+
+@_skip_no_libpq
+class TestDatabasePipelining:
+    """Connections held open on the event loops, queries pipelined."""
+
+    def test_fixed_iterations(self, mock_postgres_server):
+        engine = Engine(max_connections=10, worker_threads=1, event_loops=2)
+        result = engine.run_database_test(mock_postgres_server.url(),
+                                          ["SELECT id, name FROM users", "UPDATE users SET seen = 1"],
+                                          connections=4, iterations=50, duration_seconds=0)
+        assert result['connected'] == 4
+        assert result['queries_sent'] == 400
+        assert result['queries_ok'] == 400
+        assert result['query_errors'] == 0
+        assert result['timeouts'] == 0
+        assert result['rows_returned'] == 200 * 3
+        assert 0 < result['latency_p50_us'] <= result['latency_p99_us'] <= result['latency_max_us']
+
+        # Each connection parses each query once, then only binds and executes
+        assert result['statements_prepared'] == 8
+        assert mock_postgres_server.parse_count == 8
+        assert mock_postgres_server.execute_count == 400
+        assert mock_postgres_server.max_batch > 1
+
+        labels = engine.get_metrics()['labels']
+        assert labels['DB connect']['successful_requests'] == 4
+        assert labels['DB query #1']['successful_requests'] == 200
+        assert labels['DB query #2']['successful_requests'] == 200
+
+    def test_unprepared_depth_one(self, mock_postgres_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_database_test(mock_postgres_server.url(), "SELECT 1", connections=2,
+                                          pipeline_depth=1, iterations=20, duration_seconds=0,
+                                          prepared=False)
+        assert result['queries_ok'] == 40
+        assert result['statements_prepared'] == 0
+        assert mock_postgres_server.max_batch == 1
+
+        labels = engine.get_metrics()['labels']
+        assert labels['DB query']['successful_requests'] == 40
+
+    def test_rate_and_names(self, mock_postgres_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_database_test(mock_postgres_server.url(),
+                                          ["SELECT 1", "SELECT * FROM missing"], names=["ok", "bad"],
+                                          connections=2, rate=200, duration_seconds=1)
+        assert 150 <= result['queries_sent'] <= 250
+        assert result['queries_ok'] + result['query_errors'] == result['queries_sent']
+        assert result['query_errors'] > 0
+
+        labels = engine.get_metrics()['labels']
+        assert labels['ok']['failed_requests'] == 0
+        assert labels['bad']['successful_requests'] == 0
+        assert labels['bad']['failed_requests'] == result['query_errors']
+
+
+@_skip_no_libpq
+class TestDatabaseFailures:
+    """Broken servers show up as failed samples, not hangs."""
+
+    def test_refused_connect(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_database_test('postgresql://u:p@127.0.0.1:%d/db' % _closed_port(),
+                                          "SELECT 1", connections=3, iterations=5, duration_seconds=0)
+        assert result['connect_failures'] == 3
+        assert result['queries_sent'] == 0
+        assert engine.get_metrics()['labels']['DB connect']['failed_requests'] == 3
+
+    def test_stalled_queries_time_out(self, mock_postgres_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_database_test(mock_postgres_server.url(), "SELECT pg_sleep(2)",
+                                          connections=2, pipeline_depth=3, iterations=3,
+                                          duration_seconds=0, timeout_ms=300)
+        assert result['timeouts'] == 6
+        assert result['queries_ok'] == 0
+        assert result['elapsed_seconds'] < 2
+
+
+@_skip_no_libpq
+class TestDatabaseArguments:
+    """Bad arguments are rejected before anything connects."""
+
+    def test_non_postgres_url(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(ValueError):
+            engine.run_database_test("mysql://u:p@localhost/db", "SELECT 1")
+
+    def test_bad_counts(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(ValueError):
+            engine.run_database_test("postgresql://u:p@localhost/db", "SELECT 1", connections=0)
+        with pytest.raises(ValueError):
+            engine.run_database_test("postgresql://u:p@localhost/db", "SELECT 1", pipeline_depth=0)
+        with pytest.raises(ValueError):
+            engine.run_database_test("postgresql://u:p@localhost/db", [])
+
+    def test_names_must_match_queries(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(ValueError):
+            engine.run_database_test("postgresql://u:p@localhost/db", ["SELECT 1", "SELECT 2"],
+                                     names=["one"])
+
+    def test_non_string_query(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(TypeError):
+            engine.run_database_test("postgresql://u:p@localhost/db", ["SELECT 1", 2])
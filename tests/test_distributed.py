@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Distributed Load Generation Tests
+============================================
+
+Tests for mergeable histograms and the coordinator/agent mode:
+- Encoded histograms round-trip and add up losslessly
+- Windows carrying their histograms
+- A test sharded across two local agents, merged back into one result
+- Agent failures surfacing as errors
+"""
+
+import sys
+import os
+import socket
+import threading
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+if _c_extension_available:
+    from loadspiker.loadspiker_c import histogram_merge, histogram_percentiles
+    from loadspiker.distributed import Agent, Coordinator
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+
+def _requests(base_url, path="/ok"):
+    return [{"url": base_url + path, "method": "GET"}]
+
+
+@pytest.fixture
+def agents():
+    """Two agents on localhost, each serving coordinators on its own thread"""
+    started = [Agent("127.0.0.1", 0, max_connections=20, worker_threads=1) for _ in range(2)]
+    for agent in started:
+        threading.Thread(target=agent.serve_forever, daemon=True).start()
+    yield started
+    for agent in started:
+        agent.close()
+
+
+@_skip_no_c
+class TestHistogramMerge:
+    """Histograms leave the engine whole and add up exactly."""
+
+    def test_round_trip(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine.run_requests(_requests(mock_http_server.url) * 40, users=2, duration=0)
+        data = engine.get_latency_histogram()
+        assert isinstance(data, bytes)
+
+        values = histogram_percentiles(data, [50, 90, 99])
+        assert values['count'] == 40
+        percentiles = engine.get_percentiles([50, 90, 99])
+        for p in (50, 90, 99):
+            assert values[float(p)] == percentiles[float(p)]
+
+    def test_merge_adds_counts(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine.run_requests(_requests(mock_http_server.url) * 20, users=2, duration=0)
+        data = engine.get_latency_histogram()
+
+        merged = histogram_merge([data, data, bytearray(data)])
+        values = histogram_percentiles(merged, [50, 99])
+        alone = histogram_percentiles(data, [50, 99])
+        assert values['count'] == 60
+        assert values[50.0] == alone[50.0]
+        assert values[99.0] == alone[99.0]
+        assert values['max'] == alone['max']
+
+    def test_empty_histogram(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        values = histogram_percentiles(engine.get_latency_histogram(queue_delay=True), [99])
+        assert values == {99.0: 0, 'count': 0, 'max': 0}
+
+    def test_bad_input(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        data = engine.get_latency_histogram()
+        with pytest.raises(ValueError):
+            histogram_merge([])
+        with pytest.raises(ValueError):
+            histogram_merge([b"not a histogram"])
+        with pytest.raises(ValueError):
+            histogram_merge([data[:-1] + b"\xff"])
+        with pytest.raises(ValueError):
+            histogram_percentiles(data, [101])
+
+    def test_layouts_must_match(self):
+        coarse = Engine(max_connections=10, worker_threads=1, histogram_significant_digits=1)
+        fine = Engine(max_connections=10, worker_threads=1, histogram_significant_digits=3)
+        with pytest.raises(ValueError):
+            histogram_merge([coarse.get_latency_histogram(), fine.get_latency_histogram()])
+
+    def test_windows_carry_histograms(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1, metrics_window_ms=100)
+        engine.run_requests(_requests(mock_http_server.url, "/slow"), users=2, duration=1, loop=True)
+        windows = engine.get_metrics_windows(histograms=True)
+        assert windows
+        for window in windows:
+            values = histogram_percentiles(window['histogram'], [99])
+            assert values['count'] == window['total_requests']
+            assert values['max'] == window['max_us']
+            assert values[99.0] == window['p99_us']
+
+
+@_skip_no_c
+class TestCoordinator:
+    """One test spread over several agents reads like one engine's test."""
+
+    def _coordinator(self, agents, **kwargs):
+        return Coordinator([agent.address for agent in agents], lead_time=0.2, **kwargs)
+
+    def test_requests_dealt_out_once(self, agents, mock_http_server):
+        coordinator = self._coordinator(agents)
+        metrics = coordinator.run(_requests(mock_http_server.url) * 30, users=4, duration=0)
+        assert metrics['total_requests'] == 30
+        assert metrics['successful_requests'] == 30
+        assert metrics['status_codes'] == {200: 30}
+        assert mock_http_server.server.request_count == 30
+        assert [a['total_requests'] for a in metrics['agents']] == [15, 15]
+        assert 0 < metrics['p50_us'] <= metrics['p99_us'] <= metrics['max_response_time_us']
+        assert metrics['labels']['GET /ok']['total_requests'] == 30
+
+    def test_users_and_windows_merged(self, agents, mock_http_server):
+        coordinator = self._coordinator(agents, metrics_window_ms=200)
+        windows = []
+        metrics = coordinator.run(_requests(mock_http_server.url), users=3, duration=1, loop=True,
+                                  on_window=windows.append)
+        assert [a['users'] for a in metrics['agents']] == [2, 1]
+        assert metrics['total_requests'] == sum(a['total_requests'] for a in metrics['agents'])
+        assert coordinator.get_metrics() is metrics
+
+        assert len(windows) >= 3
+        assert [w['sequence'] for w in windows] == sorted(w['sequence'] for w in windows)
+        assert sum(w['total_requests'] for w in windows) == metrics['total_requests']
+        for window in windows:
+            assert histogram_percentiles(window['histogram'], [99])[99.0] == window['p99_us']
+        assert max(w['agents'] for w in windows) == 2
+
+    def test_rate_split(self, agents, mock_http_server):
+        coordinator = self._coordinator(agents)
+        metrics = coordinator.run(_requests(mock_http_server.url), users=10, duration=1,
+                                  arrival_rate=100, loop=True)
+        assert 70 <= metrics['total_requests'] <= 120
+        assert all(a['total_requests'] > 30 for a in metrics['agents'])
+
+    def test_fewer_users_than_agents(self, agents, mock_http_server):
+        coordinator = self._coordinator(agents)
+        metrics = coordinator.run(_requests(mock_http_server.url) * 5, users=1, duration=0)
+        assert len(metrics['agents']) == 1
+        assert metrics['total_requests'] == 5
+
+    def test_jsonl_source(self, agents, mock_http_server):
+        lines = b"".join(b'{"url": "%s/ok", "name": "line %d"}\n' % (mock_http_server.url.encode(), i)
+                         for i in range(6))
+        coordinator = self._coordinator(agents)
+        metrics = coordinator.run(lines, users=2, duration=0)
+        assert metrics['total_requests'] == 6
+        assert sorted(metrics['labels']) == ["line %d" % i for i in range(6)]
+
+    def test_unreachable_agent(self):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.bind(('127.0.0.1', 0))
+        port = sock.getsockname()[1]
+        sock.close()
+        with pytest.raises(RuntimeError):
+            Coordinator([("127.0.0.1", port)], connect_timeout=1).run([{"url": "http://127.0.0.1/"}])
+
+    def test_agent_error_is_raised(self, agents, mock_http_server):
+        coordinator = self._coordinator(agents)
+        with pytest.raises(RuntimeError):
+            coordinator.run(_requests(mock_http_server.url), users=2, duration=0, loop=True)
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Generator Health Tests
+=================================
+
+Tests for the engine's self-measurement against a local HTTP server:
+- Per-phase HTTP timings (DNS, connect, TLS, time to first byte, transfer)
+- Scheduler lag of open-model arrivals
+- Generator CPU, lock wait and event loop iteration accounting
+- The saturation verdict and its threshold
+"""
+
+import sys
+import os
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+_PHASES = ("dns", "connect", "tls", "ttfb", "transfer")
+_REASONS = {"cpu", "scheduler_lag", "lock_wait", "loop_iteration"}
+
+
+def _requests(base_url, count, path="/ok"):
+    return [{"url": base_url + path, "method": "GET"} for _ in range(count)]
+
+
+@_skip_no_c
+class TestPhaseMetrics:
+    """Every completed request contributes its phases."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_phases_per_request(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=2, mode=mode, event_loops=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 30),
+                                       concurrent_users=3, duration_seconds=10,
+                                       keep_alive=True)
+        phases = engine.get_phase_metrics()
+        assert set(phases) == set(_PHASES)
+        assert phases["ttfb"]["count"] == 30
+        assert phases["transfer"]["count"] == 30
+        # Keep-alive users only connect once each; plain HTTP never does TLS
+        assert 1 <= phases["connect"]["count"] <= 3
+        assert phases["tls"]["count"] == 0
+        ttfb = phases["ttfb"]
+        assert ttfb["p50_us"] <= ttfb["p90_us"] <= ttfb["p99_us"] <= ttfb["max_us"]
+
+    def test_reset_clears_phases(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 5),
+                                       concurrent_users=1, duration_seconds=10)
+        assert engine.get_phase_metrics()["ttfb"]["count"] == 5
+        engine.reset_metrics()
+        assert engine.get_phase_metrics()["ttfb"]["count"] == 0
+
+
+@_skip_no_c
+class TestGeneratorHealth:
+    """The engine reports on itself after a load test."""
+
+    def test_no_test_yet(self):
+        health = Engine(max_connections=10, worker_threads=1).get_generator_health()
+        assert health["saturated"] is False
+        assert health["elapsed_s"] == 0
+        assert health["threads_measured"] == 0
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_open_model_health(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=2, mode=mode, event_loops=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1),
+                                       concurrent_users=4, duration_seconds=1, loop=True,
+                                       arrival_rate=100.0, keep_alive=True)
+        health = engine.get_generator_health()
+        assert health["elapsed_s"] > 0.5
+        assert health["scheduler_lag_count"] > 0
+        assert health["scheduler_lag_p50_us"] <= health["scheduler_lag_p99_us"] \
+            <= health["scheduler_lag_max_us"]
+        assert health["threads_measured"] > 0
+        assert 0 <= health["max_thread_cpu_utilization"] <= 1.0
+        assert health["process_cpu_utilization"] >= 0
+        assert set(health["locks"]) == {"curl_share", "conn_table", "request_loop"}
+        assert set(health["saturation_reasons"]) <= _REASONS
+        assert health["saturated"] == bool(health["saturation_reasons"])
+        if mode == "event":
+            assert health["loop_iterations"] > 0
+
+    def test_closed_model_has_no_lag(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=2)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 10),
+                                       concurrent_users=2, duration_seconds=10)
+        assert engine.get_generator_health()["scheduler_lag_count"] == 0
+
+    def test_threshold_one_never_flags_overhead(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=2, mode="event",
+                        saturation_threshold=1.0)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1),
+                                       concurrent_users=2, duration_seconds=1, loop=True,
+                                       arrival_rate=50.0)
+        health = engine.get_generator_health()
+        assert health["saturation_threshold"] == 1.0
+        assert not set(health["saturation_reasons"]) - {"cpu"}
+
+    @pytest.mark.parametrize("threshold", [0, -0.1, 1.5])
+    def test_invalid_threshold(self, threshold):
+        with pytest.raises(ValueError):
+            Engine(max_connections=10, worker_threads=1, saturation_threshold=threshold)
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker HTTP Version Tests
+=============================
+
+Tests for the load-test HTTP version options:
+- Asking for HTTP/1.1 or HTTP/2 against a local HTTP/1.1 server
+- Stream and connection counts with and without keep-alive
+- HTTP/2 with prior knowledge against nghttpd, when it is installed
+- Validation of the options
+"""
+
+import sys
+import os
+import shutil
+import socket
+import subprocess
+import time
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+
+def _requests(base_url, count, path="/ok"):
+    return [{"url": base_url + path, "method": "GET"} for _ in range(count)]
+
+
+@_skip_no_c
+class TestHttpVersion:
+    """Versions are asked for per test and counted per response."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_per_request_connections(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=2, mode=mode, event_loops=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 20),
+                                       concurrent_users=4, duration_seconds=10, http_version="1.1")
+        protocol = engine.get_protocol_metrics()
+        assert protocol['streams'] == 20
+        assert protocol['http_versions']['1.1'] == 20
+        assert protocol['connections'] == 20
+        assert protocol['streams_per_connection'] == 1.0
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_http2_falls_back_on_cleartext(self, mock_http_server, mode):
+        # The server ignores the h2c upgrade, so every stream stays HTTP/1.1
+        engine = Engine(max_connections=10, worker_threads=2, mode=mode, event_loops=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 30),
+                                       concurrent_users=3, duration_seconds=10, keep_alive=True,
+                                       http_version="2", max_streams=10)
+        metrics = engine.get_metrics()
+        protocol = engine.get_protocol_metrics()
+        assert metrics['successful_requests'] == 30
+        assert protocol['http_versions']['1.1'] == 30
+        assert 1 <= protocol['connections'] <= 3
+
+    def test_reset_clears_counts(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 5),
+                                       concurrent_users=1, duration_seconds=10)
+        assert engine.get_protocol_metrics()['streams'] == 5
+        engine.reset_metrics()
+        assert engine.get_protocol_metrics() == {
+            'streams': 0, 'http_versions': {'1.0': 0, '1.1': 0, '2': 0, '3': 0},
+            'connections': 0, 'streams_per_connection': 0.0}
+
+    @pytest.mark.parametrize("version", ["1", "2.0", "h3", ""])
+    def test_invalid_version(self, mock_http_server, version):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(ValueError):
+            engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1),
+                                           concurrent_users=1, duration_seconds=10, http_version=version)
+
+    def test_invalid_max_streams(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(ValueError):
+            engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1),
+                                           concurrent_users=1, duration_seconds=10, max_streams=-1)
+
+    def test_http3_needs_support(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        try:
+            engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1),
+                                           concurrent_users=1, duration_seconds=10, http_version="3")
+        except ValueError as e:
+            assert "not supported by this libcurl" in str(e)
+        else:
+            # libcurl has HTTP/3; over TCP it falls back
+            assert engine.get_protocol_metrics()['streams'] == 1
+
+
+@pytest.fixture
+def h2c_server(tmp_path):
+    """nghttpd serving tmp_path over cleartext HTTP/2 (prior knowledge)."""
+    if shutil.which("nghttpd") is None:
+        pytest.skip("nghttpd not installed")
+    (tmp_path / "ok").write_bytes(b"ok")
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        port = s.getsockname()[1]
+    proc = subprocess.Popen(["nghttpd", "--no-tls", "-d", str(tmp_path), str(port)],
+                            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    for _ in range(100):
+        try:
+            socket.create_connection(("127.0.0.1", port), timeout=0.1).close()
+            break
+        except OSError:
+            time.sleep(0.05)
+    yield f"http://127.0.0.1:{port}"
+    proc.terminate()
+    proc.wait(timeout=5)
+
+
+@_skip_no_c
+class TestH2c:
+    """HTTP/2 with prior knowledge against a real HTTP/2 server."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_streams_counted_as_http2(self, h2c_server, mode):
+        engine = Engine(max_connections=10, worker_threads=2, mode=mode, event_loops=1)
+        engine._engine.start_load_test(requests=_requests(h2c_server, 20),
+                                       concurrent_users=4, duration_seconds=10, http_version="h2c")
+        metrics = engine.get_metrics()
+        protocol = engine.get_protocol_metrics()
+        assert metrics['successful_requests'] == 20
+        assert protocol['http_versions']['2'] == 20
+        assert protocol['connections'] == 20
@@ -0,0 +1,447 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Load Test Execution Tests
+====================================
+
+Tests for engine_start_load_test behaviour against a local HTTP server:
+- Threaded and event-driven execution modes
+- Per-request vs keep-alive connection handling
+- Latency percentiles from the log-linear histogram
+- Variable-length request storage (bodies beyond 64 KB)
+- Compiled request templates (methods and pre-built header lists)
+- JSONL request ingestion from buffers and files
+- Open-model arrival-rate scheduling and queue-delay accounting
+- Native looping and staged load profiles
+- Windowed metrics snapshots
+- Per-label, per-status-code and per-error breakdowns
+"""
+
+import sys
+import os
+import json
+import tempfile
+import time
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine, write_requests_jsonl
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+
+def _requests(base_url, count, path="/ok"):
+    return [{"url": base_url + path, "method": "GET"} for _ in range(count)]
+
+
+class _Scenario:
+    """Minimal run_scenario() input: one GET to `url`"""
+
+    def __init__(self, url):
+        self.url = url
+
+    def build_requests(self):
+        return [{"url": self.url, "method": "GET"}]
+
+
+@_skip_no_c
+class TestEngineModes:
+    """Both execution models must produce the same accounting."""
+
+    def test_invalid_mode_rejected(self):
+        with pytest.raises(ValueError):
+            Engine(max_connections=10, worker_threads=1, mode="fibers")
+
+    def test_threaded_mode_load_test(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1, mode="threaded")
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 40),
+                                       concurrent_users=8, duration_seconds=10)
+        metrics = engine.get_metrics()
+        assert metrics['total_requests'] == 40
+        assert metrics['successful_requests'] == 40
+
+    def test_event_mode_load_test(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1, mode="event", event_loops=2)
+        requests = _requests(mock_http_server.url, 40) + _requests(mock_http_server.url, 10, "/missing")
+        engine._engine.start_load_test(requests=requests, concurrent_users=16, duration_seconds=10)
+        metrics = engine.get_metrics()
+        assert metrics['total_requests'] == 50
+        assert metrics['successful_requests'] == 40
+        assert metrics['failed_requests'] == 10
+
+    def test_event_mode_more_users_than_loops(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1, mode="event", event_loops=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 30),
+                                       concurrent_users=30, duration_seconds=10)
+        assert engine.get_metrics()['total_requests'] == 30
+
+
+@_skip_no_c
+class TestConnectionModes:
+    """keep_alive must reuse connections without changing the accounting."""
+
+    def test_per_request_opens_connection_per_request(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 20),
+                                       concurrent_users=2, duration_seconds=10)
+        assert engine.get_metrics()['successful_requests'] == 20
+        assert mock_http_server.server.connection_count == 20
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_keep_alive_reuses_connections(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        requests = _requests(mock_http_server.url, 40) + _requests(mock_http_server.url, 10, "/missing")
+        engine._engine.start_load_test(requests=requests, concurrent_users=4,
+                                       duration_seconds=10, keep_alive=True)
+        metrics = engine.get_metrics()
+        assert metrics['total_requests'] == 50
+        assert metrics['successful_requests'] == 40
+        assert metrics['failed_requests'] == 10
+        assert mock_http_server.server.connection_count < 50
+
+
+@_skip_no_c
+class TestLatencyPercentiles:
+    """Percentiles come from the HDR histogram and must be monotonic."""
+
+    def test_histogram_precision_validated(self):
+        with pytest.raises(ValueError):
+            Engine(max_connections=10, worker_threads=1, histogram_significant_digits=9)
+
+    def test_metrics_report_percentiles(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 50),
+                                       concurrent_users=4, duration_seconds=10, keep_alive=True)
+        metrics = engine.get_metrics()
+        keys = ['p50_us', 'p90_us', 'p95_us', 'p99_us', 'p999_us', 'p9999_us']
+        values = [metrics[k] for k in keys]
+        assert values == sorted(values)
+        assert metrics['min_response_time_us'] <= metrics['p50_us'] <= metrics['max_response_time_us']
+        assert metrics['p9999_us'] <= metrics['max_response_time_us']
+
+    def test_arbitrary_percentiles(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 20),
+                                       concurrent_users=2, duration_seconds=10)
+        result = engine.get_percentiles([50, 99.9, 100])
+        assert set(result) == {50.0, 99.9, 100.0}
+        assert result[100.0] == engine.get_metrics()['max_response_time_us']
+        with pytest.raises(ValueError):
+            engine.get_percentiles([101])
+
+    def test_percentiles_empty_after_reset(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 10),
+                                       concurrent_users=2, duration_seconds=10)
+        engine.reset_metrics()
+        assert engine.get_percentiles([50]) == {50.0: 0}
+
+
+@_skip_no_c
+class TestRequestStorage:
+    """Requests are stored at full length, not truncated to fixed buffers."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_large_body_sent_in_full(self, mock_http_server, mode):
+        body = "x" * 200000
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        requests = [{"url": mock_http_server.url + "/upload", "method": "POST", "body": body}
+                    for _ in range(5)]
+        engine._engine.start_load_test(requests=requests, concurrent_users=2, duration_seconds=10)
+        assert engine.get_metrics()['successful_requests'] == 5
+        assert mock_http_server.server.bytes_received == 5 * len(body)
+
+    def test_bytes_body_accepted(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        requests = [{"url": mock_http_server.url + "/upload", "method": "POST", "body": b"\x00\x01binary"}]
+        engine._engine.start_load_test(requests=requests, concurrent_users=1, duration_seconds=10)
+        assert engine.get_metrics()['successful_requests'] == 1
+        assert mock_http_server.server.bytes_received == 8
+
+
+@_skip_no_c
+class TestRequestTemplates:
+    """Each request keeps its own method and headers after template compilation."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_methods_and_headers_preserved(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        shapes = [("GET", "X-LoadSpiker-Test: a"), ("POST", "X-LoadSpiker-Test: b\nAccept: */*"),
+                  ("HEAD", ""), ("PUT", "X-LoadSpiker-Test: d"), ("DELETE", None)]
+        requests = []
+        for _ in range(10):
+            for method, headers in shapes:
+                request = {"url": mock_http_server.url + "/ok", "method": method}
+                if headers is not None:
+                    request["headers"] = headers
+                requests.append(request)
+        engine._engine.start_load_test(requests=requests, concurrent_users=3, duration_seconds=10,
+                                       keep_alive=True)
+
+        assert engine.get_metrics()['successful_requests'] == len(requests)
+        seen = sorted(mock_http_server.server.seen, key=lambda item: (item[0], item[1] or ""))
+        expected = sorted([(m, h.split("\n")[0].split(": ")[1] if h else None) for m, h in shapes] * 10,
+                          key=lambda item: (item[0], item[1] or ""))
+        assert seen == expected
+
+
+@_skip_no_c
+class TestJSONLRequests:
+    """JSONL sources load into the same request table as a list of dicts."""
+
+    @staticmethod
+    def _jsonl(base_url, count):
+        lines = []
+        for i in range(count):
+            request = {"url": "%s/upload/%d" % (base_url, i), "method": "POST" if i % 2 else "PUT",
+                       "headers": {"X-LoadSpiker-Test": str(i)}, "body": "b%d" % i}
+            lines.append(json.dumps(request))
+        return "\n".join(lines) + "\n"
+
+    @pytest.mark.parametrize("kind", ["bytes", "bytearray", "memoryview"])
+    def test_buffer_source(self, mock_http_server, kind):
+        data = self._jsonl(mock_http_server.url, 20).encode()
+        source = {"bytes": data, "bytearray": bytearray(data), "memoryview": memoryview(data)}[kind]
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=source, concurrent_users=4, duration_seconds=10)
+
+        assert engine.get_metrics()['successful_requests'] == 20
+        seen = sorted(mock_http_server.server.seen, key=lambda item: int(item[1]))
+        assert seen == [("POST" if i % 2 else "PUT", str(i)) for i in range(20)]
+        assert mock_http_server.server.bytes_received == sum(len("b%d" % i) for i in range(20))
+
+    def test_file_source(self, mock_http_server):
+        requests = [{"url": mock_http_server.url + "/ok", "method": "GET", "name": "home"}] * 7
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "requests.jsonl")
+            assert write_requests_jsonl(requests, path) == 7
+            engine = Engine(max_connections=10, worker_threads=1, mode="event", event_loops=1)
+            metrics = engine.run_requests(path, users=2)
+            assert metrics['labels']['home']['successful_requests'] == 7
+
+            import pathlib
+            engine.reset_metrics()
+            metrics = engine.run_requests(pathlib.Path(path), users=2)
+            assert metrics['successful_requests'] == 7
+
+    def test_escapes_and_blank_lines(self, mock_http_server):
+        data = ('\n{"url": "%s/upload", "method": "POST", "body": "\\u00e9\\u0000\\ud83d\\ude00\\n",'
+                ' "extra": [1, {"a": null}], "timeout_ms": 5000}\n\n' % mock_http_server.url)
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=data.encode(), concurrent_users=1, duration_seconds=10)
+        assert engine.get_metrics()['successful_requests'] == 1
+        assert mock_http_server.server.bytes_received == len("\u00e9\u0000\U0001F600\n".encode())
+
+    def test_errors_name_the_line(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        data = self._jsonl(mock_http_server.url, 3) + '{"method": "GET"}\n'
+        with pytest.raises(ValueError, match="line 4: missing"):
+            engine._engine.start_load_test(requests=data.encode(), concurrent_users=1)
+        with pytest.raises(ValueError, match="line 1"):
+            engine._engine.start_load_test(requests=b'{"url": "http://x/", "timeout_ms": "soon"}',
+                                           concurrent_users=1)
+        with pytest.raises(ValueError, match="no requests"):
+            engine._engine.start_load_test(requests=b"\n\n", concurrent_users=1)
+        assert engine.get_metrics()['total_requests'] == 0
+
+    def test_bad_sources_rejected(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(OSError):
+            engine._engine.start_load_test(requests="/nonexistent/requests.jsonl", concurrent_users=1)
+        with pytest.raises(TypeError):
+            engine._engine.start_load_test(requests=42, concurrent_users=1)
+
+    def test_refused_start_raises(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        requests = _requests(mock_http_server.url, 2)
+        for source in (requests, "\n".join(json.dumps(r) for r in requests).encode()):
+            with pytest.raises(RuntimeError, match="could not start"):
+                engine._engine.start_load_test(requests=source, concurrent_users=0)
+        test = engine._engine.start_load_test_async(requests=requests, concurrent_users=0)
+        with pytest.raises(RuntimeError, match="could not start"):
+            test.wait(5)
+        with pytest.raises(RuntimeError, match="could not start"):
+            test.poll()
+        assert engine.get_metrics()['total_requests'] == 0
+
+
+@_skip_no_c
+class TestArrivalRate:
+    """Open model: requests follow the arrival schedule, not user completions."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_requests_paced_at_arrival_rate(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        start = time.monotonic()
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 30), concurrent_users=5,
+                                       duration_seconds=10, arrival_rate=60)
+        elapsed = time.monotonic() - start
+
+        assert engine.get_metrics()['successful_requests'] == 30
+        assert elapsed >= 29 / 60.0    # closed model would finish in a few ms
+
+    def test_duration_bounds_schedule(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1000), concurrent_users=5,
+                                       duration_seconds=1, arrival_rate=50, arrival="poisson")
+        total = engine.get_metrics()['total_requests']
+        assert 20 <= total <= 100
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_latency_includes_queue_delay(self, mock_http_server, mode):
+        # One user against a 50 ms endpoint cannot keep up with 100 req/s:
+        # the backlog must show up as queue delay and in the latency itself.
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 20, "/slow"),
+                                       concurrent_users=1, duration_seconds=10, arrival_rate=100)
+        metrics = engine.get_metrics()
+
+        assert metrics['successful_requests'] == 20
+        assert metrics['queue_delay_max_us'] > 400000
+        assert metrics['max_response_time_us'] >= metrics['queue_delay_max_us'] + 40000
+        assert engine.get_percentiles([100], queue_delay=True)[100.0] == metrics['queue_delay_max_us']
+
+    def test_closed_model_has_no_queue_delay(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 10), concurrent_users=2,
+                                       duration_seconds=10)
+        assert engine.get_metrics()['queue_delay_max_us'] == 0
+
+    def test_invalid_arrival_rejected(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(ValueError):
+            engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1), arrival_rate=-1)
+        with pytest.raises(ValueError):
+            engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1), arrival_rate=10,
+                                           arrival="burst")
+
+
+@_skip_no_c
+class TestLoadProfiles:
+    """Looping and staged profiles run inside one engine call."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_loop_cycles_until_duration(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        start = time.monotonic()
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 3, "/slow"), concurrent_users=2,
+                                       duration_seconds=1, keep_alive=True, loop=True)
+        elapsed = time.monotonic() - start
+
+        assert engine.get_metrics()['successful_requests'] > 3
+        assert 0.9 <= elapsed < 3
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_stages_grow_and_shrink_users(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=2)
+        start = time.monotonic()
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1, "/slow"), keep_alive=True,
+                                       loop=True, stages=[(4, 1, "linear"), (1, 1, "step")])
+        elapsed = time.monotonic() - start
+
+        samples = mock_http_server.server.concurrency
+        assert 1.9 <= elapsed < 4
+        assert max(users for _, users in samples) == 4
+        # the step down has settled once the last 4-user requests finish
+        assert all(users == 1 for at, users in samples if at > start + 1.3)
+        assert any(at > start + 1.3 for at, _ in samples)
+
+    def test_invalid_profiles_rejected(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        requests = _requests(mock_http_server.url, 1)
+        with pytest.raises(ValueError):
+            engine._engine.start_load_test(requests=requests, stages=[(0, 5)])
+        with pytest.raises(ValueError):
+            engine._engine.start_load_test(requests=requests, stages=[(5, 0)])
+        with pytest.raises(ValueError):
+            engine._engine.start_load_test(requests=requests, stages=[(5, 1, "exponential")])
+        with pytest.raises(ValueError):
+            engine._engine.start_load_test(requests=requests, duration_seconds=0, loop=True)
+
+
+@_skip_no_c
+class TestMetricsWindows:
+    """The engine publishes per-interval snapshots while a test runs."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_windows_add_up_to_totals(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1, metrics_window_ms=200)
+        windows = []
+        engine.run_scenario(_Scenario(mock_http_server.url + "/slow"), users=2, duration=1, loop=True,
+                            keep_alive=True, on_window=windows.append)
+
+        metrics = engine.get_metrics()
+        assert len(windows) >= 4
+        assert [w['sequence'] for w in windows] == list(range(windows[0]['sequence'],
+                                                              windows[0]['sequence'] + len(windows)))
+        assert sum(w['total_requests'] for w in windows) == metrics['total_requests']
+        assert sum(w['successful_requests'] for w in windows) == metrics['successful_requests']
+        full = [w for w in windows if w['total_requests'] > 0]
+        assert all(w['p99_us'] >= 50000 and w['requests_per_second'] > 0 for w in full)
+        assert all(w['active_users'] == 2 for w in windows)
+        assert engine.get_metrics_windows() == []
+
+    def test_oldest_windows_overwritten(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1, metrics_window_ms=100, metrics_window_capacity=3)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 1), concurrent_users=1,
+                                       duration_seconds=1, loop=True)
+
+        windows = engine.get_metrics_windows()
+        assert len(windows) == 3
+        assert windows[0]['sequence'] >= 7
+        assert [w['sequence'] for w in windows] == [windows[0]['sequence'] + i for i in range(3)]
+
+    def test_windows_disabled(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1, metrics_window_ms=0)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 3), concurrent_users=1)
+        assert engine.get_metrics_windows() == []
+        with pytest.raises(ValueError):
+            Engine(max_connections=10, worker_threads=1, metrics_window_capacity=0)
+
+
+@_skip_no_c
+class TestMetricLabels:
+    """get_metrics() breaks requests down by label, status code and error."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_labels_by_method_and_path(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        requests = (_requests(mock_http_server.url, 6, "/ok?id=1") + _requests(mock_http_server.url, 4, "/slow")
+                    + _requests(mock_http_server.url, 2, "/missing"))
+        engine._engine.start_load_test(requests=requests, concurrent_users=3)
+
+        metrics = engine.get_metrics()
+        labels = metrics['labels']
+        assert set(labels) == {"GET /ok", "GET /slow", "GET /missing"}
+        assert labels["GET /ok"]['total_requests'] == 6
+        assert labels["GET /ok"]['status']['2xx'] == 6
+        assert labels["GET /slow"]['p50_us'] >= 50000
+        assert labels["GET /ok"]['p99_us'] < labels["GET /slow"]['p50_us']
+        assert labels["GET /missing"]['failed_requests'] == 2
+        assert labels["GET /missing"]['status']['4xx'] == 2
+        assert metrics['status_codes'] == {200: 10, 404: 2}
+        assert metrics['errors'] == {}
+
+    def test_named_requests_share_a_label(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        requests = [{"url": f"{mock_http_server.url}/ok/{i}", "method": "GET", "name": "item"} for i in range(5)]
+        engine._engine.start_load_test(requests=requests, concurrent_users=2)
+
+        labels = engine.get_metrics()['labels']
+        assert list(labels) == ["item"]
+        assert labels["item"]['successful_requests'] == 5
+
+    def test_transport_errors_and_reset(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine._engine.start_load_test(requests=_requests("http://127.0.0.1:9", 3), concurrent_users=1)
+
+        metrics = engine.get_metrics()
+        assert metrics['status_codes'] == {0: 3}
+        assert sum(metrics['errors'].values()) == 3
+        assert metrics['labels']["GET /ok"]['status']['none'] == 3
+
+        engine.reset_metrics()
+        metrics = engine.get_metrics()
+        assert metrics['status_codes'] == {} and metrics['errors'] == {} and metrics['labels'] == {}
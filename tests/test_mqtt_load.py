@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Pipelined MQTT Load Test Tests
+=========================================
+
+Tests for engine_start_mqtt_test against a local mock broker:
+- QoS 0, 1 and 2 publishing with per-packet-ID ack tracking
+- Publish-to-delivery latency through concurrent subscribers
+- Rate limiting and in-flight windows
+- Refused connections, lost acks and their error breakdown
+- Argument validation
+"""
+
+import sys
+import os
+import socket
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+
+def _closed_port():
+    """A local TCP port nothing listens on"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.bind(('127.0.0.1', 0))
+    port = sock.getsockname()[1]
+    sock.close()
+    return port
+
+
+@_skip_no_c
+class TestMQTTPublishing:
+    """Publishers pipelining into the broker, acks matched by packet ID."""
+
+    @pytest.mark.parametrize("qos", [0, 1, 2])
+    def test_fixed_message_count(self, mock_mqtt_broker, qos):
+        engine = Engine(max_connections=10, worker_threads=1, event_loops=2)
+        result = engine.run_mqtt_test('127.0.0.1', mock_mqtt_broker.port, topic="bench/qos",
+                                      publishers=4, subscribers=2, qos=qos, messages=50,
+                                      duration_seconds=0)
+        assert result['published'] == 200
+        assert result['expected'] == 400
+        assert result['delivered'] == 400
+        assert result['loss_rate'] == 0.0
+        assert result['connect_failures'] == 0
+        assert mock_mqtt_broker.publish_count == 200
+
+        labels = engine.get_metrics()['labels']
+        assert labels['MQTT connect']['successful_requests'] == 6
+        assert labels['MQTT subscribe']['successful_requests'] == 2
+        assert labels['MQTT publish']['successful_requests'] == 200
+        assert labels['MQTT deliver']['successful_requests'] == 400
+        if qos:
+            assert result['acknowledged'] == 200
+            assert 0 < result['ack_p50_us'] <= result['ack_max_us']
+        else:
+            assert result['acknowledged'] == 0
+            assert 'ack_p50_us' not in result
+
+    def test_delivery_latency(self, mock_mqtt_broker):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_mqtt_test('127.0.0.1', mock_mqtt_broker.port, publishers=2, subscribers=1,
+                                      qos=1, messages=20, duration_seconds=0, payload_size=256)
+        assert result['delivered'] == 40
+        assert 0 < result['latency_p50_us'] <= result['latency_p99_us'] <= result['latency_max_us']
+
+    def test_rate_is_respected(self, mock_mqtt_broker):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_mqtt_test('127.0.0.1', mock_mqtt_broker.port, publishers=2, subscribers=0,
+                                      qos=1, rate=200, duration_seconds=1)
+        assert 150 <= result['published'] <= 250
+        assert result['acknowledged'] == result['published']
+        assert result['loss_rate'] is None
+
+    def test_inflight_window_of_one(self, mock_mqtt_broker):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_mqtt_test('127.0.0.1', mock_mqtt_broker.port, publishers=1, subscribers=1,
+                                      qos=2, inflight=1, messages=30, duration_seconds=0)
+        assert result['acknowledged'] == 30
+        assert result['delivered'] == 30
+
+    def test_wildcard_subscription_and_client_ids(self, mock_mqtt_broker):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_mqtt_test('127.0.0.1', mock_mqtt_broker.port, topic="site/7/temp",
+                                      subscribe_topic="site/#", publishers=3, subscribers=1,
+                                      messages=5, duration_seconds=0, client_id_prefix="bench")
+        assert result['delivered'] == 15
+        ids = mock_mqtt_broker.client_ids
+        assert len(ids) == 4 and len(set(ids)) == 4
+        assert all(i.startswith("bench-") for i in ids)
+
+    def test_duration_bounded(self, mock_mqtt_broker):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_mqtt_test('127.0.0.1', mock_mqtt_broker.port, publishers=2, subscribers=1,
+                                      qos=1, duration_seconds=1)
+        assert result['published'] > 20
+        assert 0.5 < result['elapsed_seconds'] < 3
+        assert result['delivered'] == result['expected']
+
+
+@_skip_no_c
+class TestMQTTFailures:
+    """Broken brokers show up as failed samples, not hangs."""
+
+    def test_refused_tcp_connect(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_mqtt_test('127.0.0.1', _closed_port(), publishers=3, subscribers=1,
+                                      messages=5, duration_seconds=0)
+        assert result['connect_failures'] == 4
+        assert result['published'] == 0
+        metrics = engine.get_metrics()
+        assert metrics['labels']['MQTT connect']['failed_requests'] == 4
+        assert sum(metrics['errors'].values()) == 4
+
+    def test_connack_refused(self, mock_mqtt_broker):
+        mock_mqtt_broker.refuse_connect = True
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_mqtt_test('127.0.0.1', mock_mqtt_broker.port, publishers=2, subscribers=0,
+                                      messages=5, duration_seconds=0)
+        assert result['connect_failures'] == 2
+        assert engine.get_metrics()['labels']['MQTT connect']['failed_requests'] == 2
+
+    def test_lost_acks_time_out(self, mock_mqtt_broker):
+        mock_mqtt_broker.drop_acks = True
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_mqtt_test('127.0.0.1', mock_mqtt_broker.port, publishers=1, subscribers=0,
+                                      qos=1, inflight=4, messages=10, duration_seconds=0, timeout_ms=200)
+        # Each timeout frees a slot for the next publish, so all ten go out
+        assert result['published'] == 10
+        assert result['ack_timeouts'] == 10
+        assert result['acknowledged'] == 0
+        assert engine.get_metrics()['labels']['MQTT publish']['failed_requests'] == 10
+
+
+@_skip_no_c
+class TestMQTTValidation:
+    """Bad arguments are rejected before anything connects."""
+
+    @pytest.mark.parametrize("kwargs", [
+        {"port": 0},
+        {"topic": ""},
+        {"topic": "a/+/b"},
+        {"publishers": 0},
+        {"subscribers": -1},
+        {"qos": 3},
+        {"inflight": 0},
+        {"payload_size": 8},
+        {"payload_size": 9000},
+        {"messages": 0, "duration_seconds": 0},
+        {"rate": -1.0},
+        {"timeout_ms": 0},
+    ])
+    def test_rejects(self, kwargs):
+        engine = Engine(max_connections=10, worker_threads=1)
+        args = {"host": '127.0.0.1', "port": 1883, "duration_seconds": 1}
+        args.update(kwargs)
+        with pytest.raises(ValueError):
+            engine.run_mqtt_test(**args)
+
+    def test_unresolvable_broker(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(RuntimeError):
+            engine.run_mqtt_test('no-such-host.invalid', 1883, duration_seconds=1)
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Native Parameterization Tests
+========================================
+
+Tests for ${column} placeholders filled in by the C engine against a local
+HTTP server:
+- Data rows from CSV files, CSV buffers and lists of dicts
+- Substitution into URLs, headers and bodies in both execution modes
+- Row strategies: sequential, circular, random, unique and shared
+- Scenarios with one data source handing it to the engine
+- Data errors
+"""
+
+import sys
+import os
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.scenarios import Scenario
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+CSV = b"user,token\nalice,t1\nbob,t2\n\"c,\"\"q\"\"\",t3\n"
+
+
+def _paths(server):
+    return [path for path, _ in server.server.sent]
+
+
+@_skip_no_c
+class TestSubstitution:
+    """Placeholders take the row's cells; everything else is sent as written."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_url_header_body(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        requests = [{"url": mock_http_server.url + "/u/${user}?t=${data.token}&keep=${other}",
+                     "method": "POST", "headers": "Accept: */*\nX-LoadSpiker-Test: ${token}",
+                     "body": '{"name": "${user}"}'}]
+        metrics = engine.run_requests(requests, users=1, duration=3, loop=True, data=CSV,
+                                      data_strategy="unique")
+        assert metrics['total_requests'] == 3
+        assert _paths(mock_http_server) == ["/u/alice?t=t1&keep=${other}", "/u/bob?t=t2&keep=${other}",
+                                            "/u/c,\"q\"?t=t3&keep=${other}"]
+        assert [token for _, token in mock_http_server.server.seen] == ["t1", "t2", "t3"]
+        assert [body for _, body in mock_http_server.server.sent] == [
+            b'{"name": "alice"}', b'{"name": "bob"}', b'{"name": "c,"q""}']
+
+    def test_unparameterized_requests_untouched(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        requests = [{"url": mock_http_server.url + "/plain", "body": "${nothing}"},
+                    {"url": mock_http_server.url + "/p/${user}"}]
+        metrics = engine.run_requests(requests, users=1, duration=0, data=[{"user": "x"}])
+        assert metrics['total_requests'] == 2
+        assert mock_http_server.server.sent == [("/plain", b"${nothing}"), ("/p/x", b"")]
+
+    def test_csv_file_and_dict_rows(self, tmp_path, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        rows = [{"id": 7, "flag": True, "none": None}]
+        engine.run_requests([{"url": mock_http_server.url + "/${id}/${flag}/${none}"}], users=1,
+                            duration=0, data=rows)
+        assert _paths(mock_http_server) == ["/7/True/"]
+
+        path = tmp_path / "ids.csv"
+        path.write_bytes(b"id\r\n\r\n10\r\n11\r\n")
+        engine.run_requests([{"url": mock_http_server.url + "/${ids.id}"}], users=1, duration=2,
+                            loop=True, data=str(path), data_name="ids", data_strategy="unique")
+        assert _paths(mock_http_server)[1:] == ["/10", "/11"]
+
+
+@_skip_no_c
+class TestStrategies:
+    """Which row each pass through the requests takes."""
+
+    def _run(self, server, strategy, users=1, count=6, **kw):
+        engine = Engine(max_connections=10, worker_threads=1, mode="event", event_loops=1)
+        rows = [{"n": str(i)} for i in range(4)]
+        requests = [{"url": server.url + "/a/${n}"}, {"url": server.url + "/b/${n}"}]
+        engine.run_requests(requests * (count // 2), users=users, duration=0, data=rows,
+                            data_strategy=strategy, **kw)
+        return _paths(server)
+
+    def test_sequential_follows_user(self, mock_http_server):
+        paths = self._run(mock_http_server, "sequential", users=2)
+        assert len(paths) == 6
+        assert set(path[3:] for path in paths) <= {"0", "1"}
+
+    def test_circular_and_unique_advance_per_pass(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        requests = [{"url": mock_http_server.url + "/a/${n}"}, {"url": mock_http_server.url + "/b/${n}"}]
+        rows = [{"n": str(i)} for i in range(3)]
+        metrics = engine.run_requests(requests, users=1, duration=2, loop=True, data=rows,
+                                      data_strategy="unique")
+        assert metrics['total_requests'] == 6
+        assert _paths(mock_http_server) == ["/a/0", "/b/0", "/a/1", "/b/1", "/a/2", "/b/2"]
+
+        mock_http_server.server.sent.clear()
+        engine.run_requests(requests, users=1, duration=1, loop=True, data=rows, data_strategy="circular")
+        paths = _paths(mock_http_server)
+        assert len(paths) > 6
+        assert paths[:8] == ["/a/0", "/b/0", "/a/1", "/b/1", "/a/2", "/b/2", "/a/0", "/b/0"]
+
+    def test_random_is_seeded(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        requests = [{"url": mock_http_server.url + "/a/${n}"}, {"url": mock_http_server.url + "/b/${n}"}]
+        rows = [{"n": str(i)} for i in range(4)]
+        runs = []
+        for _ in range(2):
+            mock_http_server.server.sent.clear()
+            engine.run_requests(requests, users=1, duration=1, loop=True, data=rows,
+                                data_strategy="random", data_seed=42)
+            runs.append(_paths(mock_http_server)[:20])
+        assert runs[0] == runs[1]
+        assert all(a[3:] == b[3:] for a, b in zip(runs[0][::2], runs[0][1::2]))
+        assert len(set(path[3:] for path in runs[0])) > 1
+
+    def test_shared(self, mock_http_server):
+        paths = self._run(mock_http_server, "shared", users=3)
+        assert set(path[3:] for path in paths) == {"0"}
+
+
+@_skip_no_c
+class TestScenarioData:
+    """A scenario's one data source is substituted per request by the engine."""
+
+    def test_scenario_rows_reach_engine(self, tmp_path, mock_http_server):
+        (tmp_path / "users.csv").write_text("name,code\nann,1\nben,2\n")
+        scenario = Scenario("data")
+        scenario.set_variable("base", mock_http_server.url)
+        scenario.load_data_file(str(tmp_path / "users.csv"), name="users", strategy="unique")
+        scenario.get("${base}/${users.name}/${users.code}")
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_scenario(scenario, users=1, duration=2, loop=True)
+        assert metrics['total_requests'] == 2
+        assert _paths(mock_http_server) == ["/ann/1", "/ben/2"]
+
+
+@_skip_no_c
+class TestErrors:
+    def test_bad_data(self, tmp_path, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        requests = [{"url": mock_http_server.url + "/${a}"}]
+        with pytest.raises(ValueError, match="line 3"):
+            engine.run_requests(requests, users=1, duration=0, data=b"a,b\n1,2\n3\n")
+        with pytest.raises(ValueError, match="unterminated"):
+            engine.run_requests(requests, users=1, duration=0, data=b'a\n"x\n')
+        with pytest.raises(ValueError):
+            engine.run_requests(requests, users=1, duration=0, data=b"a\n")
+        with pytest.raises(ValueError):
+            engine.run_requests(requests, users=1, duration=0, data=b"a,a\n1,2\n")
+        with pytest.raises(ValueError):
+            engine.run_requests(requests, users=1, duration=0, data=[])
+        with pytest.raises(TypeError):
+            engine.run_requests(requests, users=1, duration=0, data=[{"a": 1}, 2])
+        with pytest.raises(TypeError):
+            engine.run_requests(requests, users=1, duration=0, data=12)
+        with pytest.raises(ValueError):
+            engine.run_requests(requests, users=1, duration=0, data=[{"a": 1}], data_strategy="pick")
+        with pytest.raises(OSError):
+            engine.run_requests(requests, users=1, duration=0, data=str(tmp_path / "missing.csv"))
+        assert mock_http_server.server.request_count == 0
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Thread Placement Tests
+=================================
+
+Tests for the engine's placement options against a local HTTP server:
+- Pinning pool workers, virtual users and event loops to a CPU list
+- NUMA-local metrics shards
+- Spreading connections over source addresses and port ranges
+- Validation of the options
+"""
+
+import sys
+import os
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+_CPUS = sorted(os.sched_getaffinity(0)) if hasattr(os, "sched_getaffinity") else [0]
+
+
+def _requests(base_url, count, path="/ok"):
+    return [{"url": base_url + path, "method": "GET"} for _ in range(count)]
+
+
+@_skip_no_c
+class TestCpuAffinity:
+    """Pinned engines account for requests exactly like unpinned ones."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_pinned_load_test(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=2, mode=mode, event_loops=2,
+                        cpu_affinity=_CPUS[:2], numa_local=True)
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 40),
+                                       concurrent_users=8, duration_seconds=10)
+        metrics = engine.get_metrics()
+        assert metrics['total_requests'] == 40
+        assert metrics['successful_requests'] == 40
+
+    def test_cpu_list_string(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1, cpu_affinity=str(_CPUS[0]))
+        assert engine.execute_request(mock_http_server.url + "/ok")['status_code'] == 200
+
+    @pytest.mark.parametrize("cpus", ["", "3-1", "0,,1", "x", [-1], [], "0-5000"])
+    def test_invalid_cpu_lists(self, cpus):
+        with pytest.raises(ValueError):
+            Engine(max_connections=10, worker_threads=1, cpu_affinity=cpus)
+
+    def test_numa_local_needs_cpus(self):
+        with pytest.raises(ValueError):
+            Engine(max_connections=10, worker_threads=1, numa_local=True)
+
+
+@_skip_no_c
+class TestSourceSpreading:
+    """Connections bind to the configured source addresses and ports."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_source_addresses_round_robin(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=2,
+                        source_addresses=["127.0.0.2", "127.0.0.3"])
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 40),
+                                       concurrent_users=4, duration_seconds=10)
+        assert engine.get_metrics()['successful_requests'] == 40
+        hosts = {host for host, _ in mock_http_server.server.peers}
+        assert hosts == {"127.0.0.2", "127.0.0.3"}
+
+    def test_source_port_range(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1,
+                        source_addresses=["127.0.0.1"], source_ports=(42000, 42999))
+        engine._engine.start_load_test(requests=_requests(mock_http_server.url, 20),
+                                       concurrent_users=4, duration_seconds=10, keep_alive=True)
+        assert engine.get_metrics()['successful_requests'] == 20
+        ports = [port for _, port in mock_http_server.server.peers]
+        assert ports and all(42000 <= port <= 42999 for port in ports)
+        # Four users, four disjoint slices of the range
+        assert len({(port - 42000) // 250 for port in ports}) == 4
+
+    @pytest.mark.parametrize("kwargs, error", [
+        ({"source_addresses": ["not-an-ip"]}, ValueError),
+        ({"source_addresses": "127.0.0.1"}, ValueError),
+        ({"source_ports": (2000, 1000)}, ValueError),
+        ({"source_ports": (0, 1000)}, ValueError),
+        ({"source_ports": [1000, 2000]}, TypeError),
+    ])
+    def test_invalid_source_options(self, kwargs, error):
+        with pytest.raises(error):
+            Engine(max_connections=10, worker_threads=1, **kwargs)
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Replay Log Tests
+===========================
+
+Tests for memory-mapped replay logs against a local HTTP server:
+- JSONL converted once into a replay log, templates and labels resolved
+- Replaying a log as a normal closed- or open-model request source
+- arrival="recorded" keeping the recorded inter-arrival gaps
+- Conversion and open errors
+"""
+
+import sys
+import os
+import json
+import time
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+if _c_extension_available:
+    from loadspiker.loadspiker_c import ReplayLog, convert_replay_log
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+
+def _write_jsonl(path, base_url, count, gap=None, **extra):
+    """count requests over three paths and two methods, gap seconds apart when given"""
+    with open(path, "w") as f:
+        for i in range(count):
+            line = {"url": "%s/ok/%d" % (base_url, i % 3), "method": "POST" if i % 2 else "GET",
+                    "body": "x" * i, "name": "step %d" % (i % 4)}
+            if gap is not None:
+                line["timestamp"] = 1700000000.0 + i * gap
+            line.update(extra)
+            f.write(json.dumps(line) + "\n")
+    return path
+
+
+@pytest.fixture
+def replay_log(tmp_path, mock_http_server):
+    """A 20-request log recorded 50 ms apart"""
+    jsonl = _write_jsonl(tmp_path / "requests.jsonl", mock_http_server.url, 20, gap=0.05)
+    convert_replay_log(jsonl, tmp_path / "requests.lsr")
+    with ReplayLog(tmp_path / "requests.lsr") as log:
+        yield log
+
+
+@_skip_no_c
+class TestConversion:
+    """A JSONL file becomes a compact log with its shapes grouped."""
+
+    def test_info(self, tmp_path, mock_http_server):
+        jsonl = _write_jsonl(tmp_path / "in.jsonl", mock_http_server.url, 20, gap=0.05)
+        info = convert_replay_log(jsonl, tmp_path / "out.lsr")
+        assert info['requests'] == 20
+        assert info['templates'] == 2
+        assert info['labels'] == 4
+        assert info['timestamps'] is True
+        assert info['span_seconds'] == pytest.approx(0.95)
+
+        with ReplayLog(tmp_path / "out.lsr") as log:
+            assert len(log) == 20
+            assert log.info() == info
+
+    def test_without_timestamps(self, tmp_path, mock_http_server):
+        jsonl = _write_jsonl(tmp_path / "in.jsonl", mock_http_server.url, 5)
+        info = convert_replay_log(jsonl, tmp_path / "out.lsr")
+        assert info['timestamps'] is False
+        assert info['span_seconds'] == 0.0
+
+    def test_label_overflow_shares_other(self, tmp_path, mock_http_server):
+        with open(tmp_path / "in.jsonl", "w") as f:
+            for i in range(100):
+                f.write(json.dumps({"url": mock_http_server.url + "/ok", "name": "n%d" % i}) + "\n")
+        info = convert_replay_log(tmp_path / "in.jsonl", tmp_path / "out.lsr")
+        assert info['labels'] == 64
+
+    def test_errors(self, tmp_path):
+        (tmp_path / "bad.jsonl").write_text('{"url": "http://x/"}\n{"method": "GET"}\n')
+        with pytest.raises(ValueError, match="line 2"):
+            convert_replay_log(tmp_path / "bad.jsonl", tmp_path / "out.lsr")
+        assert not (tmp_path / "out.lsr").exists()
+
+        (tmp_path / "ts.jsonl").write_text('{"url": "http://x/", "timestamp": "yesterday"}\n')
+        with pytest.raises(ValueError, match="timestamp"):
+            convert_replay_log(tmp_path / "ts.jsonl", tmp_path / "out.lsr")
+
+        with pytest.raises(OSError):
+            convert_replay_log(tmp_path / "missing.jsonl", tmp_path / "out.lsr")
+
+    def test_open_errors(self, tmp_path):
+        with pytest.raises(OSError):
+            ReplayLog(tmp_path / "missing.lsr")
+        (tmp_path / "junk.lsr").write_bytes(b"x" * 200)
+        with pytest.raises(ValueError):
+            ReplayLog(tmp_path / "junk.lsr")
+
+    def test_truncated_log_is_rejected(self, tmp_path, mock_http_server):
+        jsonl = _write_jsonl(tmp_path / "in.jsonl", mock_http_server.url, 5)
+        convert_replay_log(jsonl, tmp_path / "out.lsr")
+        data = (tmp_path / "out.lsr").read_bytes()
+        (tmp_path / "cut.lsr").write_bytes(data[:-3])
+        with pytest.raises(ValueError):
+            ReplayLog(tmp_path / "cut.lsr")
+
+
+@_skip_no_c
+class TestReplay:
+    """An open log runs like any other request source."""
+
+    def test_closed_model(self, replay_log, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_requests(replay_log, users=4, duration=0)
+        assert metrics['total_requests'] == 20
+        assert metrics['status_codes'] == {200: 20}
+        assert mock_http_server.server.request_count == 20
+        assert sorted(metrics['labels']) == ["step %d" % i for i in range(4)]
+        assert all(m['total_requests'] == 5 for m in metrics['labels'].values())
+        methods = [method for method, _ in mock_http_server.server.seen]
+        assert methods.count("POST") == 10
+        assert mock_http_server.server.bytes_received == sum(range(20))
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_recorded_timing(self, replay_log, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        started = time.monotonic()
+        metrics = engine.run_requests(replay_log, users=4, duration=0, arrival="recorded")
+        elapsed = time.monotonic() - started
+        assert metrics['total_requests'] == 20
+        assert 0.9 <= elapsed < 2.0
+        arrivals = [t for t, _ in mock_http_server.server.concurrency]
+        assert arrivals[-1] - arrivals[0] == pytest.approx(0.95, abs=0.15)
+
+    def test_replay_speed(self, replay_log):
+        engine = Engine(max_connections=10, worker_threads=1)
+        started = time.monotonic()
+        metrics = engine.run_requests(replay_log, users=4, duration=0, arrival="recorded", replay_speed=4)
+        assert metrics['total_requests'] == 20
+        assert time.monotonic() - started < 0.6
+
+    def test_recorded_loop(self, replay_log):
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_requests(replay_log, users=2, duration=2, loop=True, arrival="recorded")
+        # One pass takes a second: 0.95 s of gaps plus the average gap
+        assert 38 <= metrics['total_requests'] <= 41
+
+    def test_recorded_from_jsonl(self, tmp_path, mock_http_server):
+        jsonl = _write_jsonl(tmp_path / "in.jsonl", mock_http_server.url, 10, gap=0.05)
+        engine = Engine(max_connections=10, worker_threads=1)
+        started = time.monotonic()
+        metrics = engine.run_requests(jsonl, users=2, duration=0, arrival="recorded")
+        assert metrics['total_requests'] == 10
+        assert 0.4 <= time.monotonic() - started < 1.5
+
+    def test_recorded_needs_timestamps(self, tmp_path, mock_http_server):
+        jsonl = _write_jsonl(tmp_path / "in.jsonl", mock_http_server.url, 5)
+        convert_replay_log(jsonl, tmp_path / "out.lsr")
+        engine = Engine(max_connections=10, worker_threads=1)
+        with ReplayLog(tmp_path / "out.lsr") as log:
+            with pytest.raises(ValueError):
+                engine.run_requests(log, users=1, duration=0, arrival="recorded")
+        with pytest.raises(ValueError):
+            engine.run_requests(jsonl, users=1, duration=0, arrival="recorded")
+        with pytest.raises(ValueError):
+            engine.run_requests(jsonl, users=1, duration=0, replay_speed=0)
+
+    def test_closed_log(self, tmp_path, mock_http_server):
+        jsonl = _write_jsonl(tmp_path / "in.jsonl", mock_http_server.url, 5)
+        convert_replay_log(jsonl, tmp_path / "out.lsr")
+        log = ReplayLog(tmp_path / "out.lsr")
+        log.close()
+        with pytest.raises(ValueError):
+            Engine(max_connections=10, worker_threads=1).run_requests(log, users=1, duration=0)
+
+    def test_refused_start_raises(self, replay_log):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(RuntimeError, match="could not start"):
+            engine._engine.start_load_test(requests=replay_log, concurrent_users=0)
+        assert len(replay_log) == 20
+
+    def test_log_in_use_cannot_close(self, replay_log):
+        engine = Engine(max_connections=10, worker_threads=1)
+        test = engine.start_load_test_async(replay_log, users=2, duration=0, arrival="recorded")
+        with pytest.raises(RuntimeError):
+            replay_log.close()
+        test.stop()
+        assert test.wait(5)
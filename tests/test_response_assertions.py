@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Native Response Assertion Tests
+==========================================
+
+Tests for assertions the engine workers check on every load-test response
+against a local HTTP server:
+- Status, header, body and latency checks in both execution modes
+- Per-assertion counts in get_metrics() and failed requests
+- Bodies streamed through without buffering, including large ones
+- Assertion objects converted to the engine's form
+- Malformed assertions
+"""
+
+import sys
+import os
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.assertions import (status_is, response_time_under, body_contains,
+                                   body_matches, header_exists, native_assertions)
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+
+def _requests(server, path, count):
+    return [{"url": server.url + path} for _ in range(count)]
+
+
+@_skip_no_c
+class TestChecks:
+    """Every response is checked against every assertion."""
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_passing_and_failing(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=2, mode=mode, event_loops=2)
+        requests = _requests(mock_http_server, "/ok", 6) + _requests(mock_http_server, "/missing", 4)
+        metrics = engine.run_requests(requests, users=3, duration=0, assertions=[
+            {"status": (200, 299)},
+            {"header": "content-length", "value": "2"},
+            {"body_contains": "ok", "name": "says ok"},
+            {"body_excludes": b"error"},
+            {"max_latency_ms": 5000},
+        ])
+        assert metrics['total_requests'] == 10
+        assert metrics['failed_requests'] == 4
+        assert metrics['successful_requests'] == 6
+        assert metrics['assertions'] == {
+            "status 200-299": {"checked": 10, "failed": 4, "passed": 6},
+            "header content-length contains 2": {"checked": 10, "failed": 0, "passed": 10},
+            "says ok": {"checked": 10, "failed": 0, "passed": 10},
+            "body excludes error": {"checked": 10, "failed": 0, "passed": 10},
+            "latency <= 5000 ms": {"checked": 10, "failed": 0, "passed": 10},
+        }
+
+    def test_latency_and_missing_header(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=2)
+        metrics = engine.run_requests(_requests(mock_http_server, "/slow", 4), users=2, duration=0,
+                                      assertions=[{"max_latency_ms": 20}, {"header": "X-Absent"}])
+        assert metrics['failed_requests'] == 4
+        assert metrics['assertions']["latency <= 20 ms"]['failed'] == 4
+        assert metrics['assertions']["header X-Absent"]['failed'] == 4
+
+    @pytest.mark.parametrize("mode", ["threaded", "event"])
+    def test_large_body_streamed(self, mock_http_server, mode):
+        engine = Engine(max_connections=10, worker_threads=1, mode=mode, event_loops=1)
+        metrics = engine.run_requests(_requests(mock_http_server, "/large", 3), users=1, duration=0,
+                                      assertions=[{"body_contains": "x<end>"}, {"body_excludes": "y"}])
+        assert metrics['successful_requests'] == 3
+        assert metrics['assertions']["body contains x<end>"] == {"checked": 3, "failed": 0, "passed": 3}
+        assert metrics['assertions']["body excludes y"]['failed'] == 0
+
+    def test_unanswered_requests_not_checked(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_requests([{"url": "http://127.0.0.1:9/", "timeout_ms": 2000}], users=1,
+                                      duration=0, assertions=[{"status": 200}])
+        assert metrics['failed_requests'] == 1
+        assert metrics['assertions']["status 200"] == {"checked": 0, "failed": 0, "passed": 0}
+
+    def test_reset_and_no_assertions(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        engine.run_requests(_requests(mock_http_server, "/ok", 2), users=1, duration=0,
+                            assertions=[{"status": 200}])
+        engine.reset_metrics()
+        assert engine.get_metrics()['assertions']["status 200"]['checked'] == 0
+        metrics = engine.run_requests(_requests(mock_http_server, "/ok", 2), users=1, duration=0)
+        assert 'assertions' not in metrics
+        assert metrics['successful_requests'] == 2
+
+
+@_skip_no_c
+class TestAssertionObjects:
+    """Assertion objects with a native form run in the engine."""
+
+    def test_converted(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_requests(_requests(mock_http_server, "/ok", 2), users=1, duration=0, assertions=[
+            status_is(200), response_time_under(5000), body_contains("ok", message="body ok"),
+            header_exists("Content-Length")])
+        assert metrics['successful_requests'] == 2
+        assert set(metrics['assertions']) == {"status 200", "latency <= 5000 ms", "body ok",
+                                              "header content-length"}
+
+    def test_python_only_rejected(self):
+        with pytest.raises(ValueError, match="RegexAssertion"):
+            native_assertions([body_matches("o+")])
+        with pytest.raises(ValueError, match="BodyContainsAssertion"):
+            native_assertions([body_contains("ok", case_sensitive=False)])
+        assert native_assertions([{"status": 204}]) == [{"status": 204}]
+
+
+@_skip_no_c
+class TestErrors:
+    """Malformed assertions are rejected before the test starts."""
+
+    @pytest.mark.parametrize("spec", [
+        {},
+        {"status": 200, "body_contains": "x"},
+        {"status": (300, 200)},
+        {"body_contains": ""},
+        {"body_excludes": "x" * 257},
+        {"header": ""},
+        {"header": "Bad: name"},
+        {"max_latency_ms": -1},
+    ])
+    def test_invalid(self, mock_http_server, spec):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(ValueError):
+            engine.run_requests(_requests(mock_http_server, "/ok", 1), users=1, duration=0, assertions=[spec])
+        assert mock_http_server.server.request_count == 0
+
+    def test_wrong_types(self, mock_http_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        for assertions in ([{"status": "200"}], [{"body_contains": 5}], ["status"], {"status": 200}):
+            with pytest.raises(TypeError):
+                engine._engine.start_load_test(_requests(mock_http_server, "/ok", 1), 1, 0,
+                                               assertions=assertions)
+        with pytest.raises(ValueError, match="at most 32"):
+            engine._engine.start_load_test(_requests(mock_http_server, "/ok", 1), 1, 0,
+                                           assertions=[{"status": 200}] * 33)
@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker Native Socket Load Test Tests
+========================================
+
+Tests for engine_start_socket_test against local echo servers:
+- TCP send/expect scripts over persistent and per-iteration connections
+- Delimiter-terminated reads and binary payloads
+- UDP request/response flows
+- Timeouts, refused connections and their error breakdown
+- Argument validation
+- Rate-controlled UDP blasting: pps, loss and echo RTT
+"""
+
+import sys
+import os
+import socket
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+
+def _closed_port():
+    """A local TCP port nothing listens on"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.bind(('127.0.0.1', 0))
+    port = sock.getsockname()[1]
+    sock.close()
+    return port
+
+
+@_skip_no_c
+class TestTCPSocketTest:
+    """Scripts over TCP connections driven by the event loops."""
+
+    def test_echo_script_persistent_connections(self, mock_tcp_server):
+        _, port = mock_tcp_server
+        engine = Engine(max_connections=10, worker_threads=1, event_loops=2)
+        metrics = engine.run_socket_test(
+            targets=[('127.0.0.1', port)],
+            script=[{"send": "ping\n"}, {"expect": 5}],
+            connections=8, iterations=5)
+
+        labels = metrics['labels']
+        assert labels['TCP connect']['total_requests'] == 8
+        assert labels['TCP send #1']['successful_requests'] == 40
+        assert labels['TCP expect #2']['successful_requests'] == 40
+        assert metrics['total_requests'] == 88
+        assert metrics['failed_requests'] == 0
+
+    def test_reconnect_per_iteration(self, mock_tcp_server):
+        _, port = mock_tcp_server
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_socket_test(
+            targets=[('127.0.0.1', port)],
+            script=[{"send": "hello", "name": "greet"}, {"until": "llo", "name": "reply"}],
+            connections=4, iterations=3, reconnect=True)
+
+        labels = metrics['labels']
+        assert labels['TCP connect']['successful_requests'] == 12
+        assert labels['greet']['successful_requests'] == 12
+        assert labels['reply']['successful_requests'] == 12
+
+    def test_binary_payload(self, mock_tcp_server):
+        _, port = mock_tcp_server
+        payload = bytes(range(256)) * 64
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_socket_test(
+            targets=[('127.0.0.1', port)],
+            script=[{"send": payload}, {"expect": len(payload)}],
+            connections=2, iterations=2)
+        assert metrics['successful_requests'] == 2 + 4 + 4
+        assert metrics['failed_requests'] == 0
+
+    def test_connect_only(self, mock_tcp_server):
+        _, port = mock_tcp_server
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_socket_test(targets=[('127.0.0.1', port)], script=[],
+                                         connections=5, iterations=2)
+        assert metrics['labels']['TCP connect']['successful_requests'] == 10
+
+    def test_duration_bounded(self, mock_tcp_server):
+        _, port = mock_tcp_server
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_socket_test(
+            targets=[('127.0.0.1', port)],
+            script=[{"send": "x"}, {"expect": 1}],
+            connections=4, duration_seconds=1, iterations=0)
+        labels = metrics['labels']
+        assert labels['TCP expect #2']['successful_requests'] > 4
+        assert labels['TCP send #1']['total_requests'] == labels['TCP expect #2']['total_requests']
+
+    def test_refused_connections(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_socket_test(
+            targets=[('127.0.0.1', _closed_port())],
+            script=[{"send": "x"}], connections=3, iterations=2)
+        assert metrics['labels']['TCP connect']['failed_requests'] == 6
+        assert 'TCP send #1' not in metrics['labels']
+        assert sum(metrics['errors'].values()) == 6
+
+    def test_expect_timeout(self, mock_tcp_server):
+        _, port = mock_tcp_server
+        engine = Engine(max_connections=10, worker_threads=1)
+        metrics = engine.run_socket_test(
+            targets=[('127.0.0.1', port)],
+            script=[{"send": "abc"}, {"expect": 10}],
+            connections=2, iterations=1, timeout_ms=200)
+        labels = metrics['labels']
+        assert labels['TCP expect #2']['failed_requests'] == 2
+        assert labels['TCP send #1']['successful_requests'] == 2
+        assert sum(metrics['errors'].values()) == 2
+
+
+@_skip_no_c
+class TestUDPSocketTest:
+    """Request/response flows over connected UDP sockets."""
+
+    def test_echo_flows(self, mock_udp_server):
+        _, port = mock_udp_server
+        engine = Engine(max_connections=10, worker_threads=1, event_loops=2)
+        metrics = engine.run_socket_test(
+            protocol="udp",
+            targets=[('127.0.0.1', port)],
+            script=[{"send": "ping"}, {"expect": 4}],
+            connections=4, iterations=5)
+        labels = metrics['labels']
+        assert 'UDP connect' not in labels
+        assert labels['UDP send #1']['successful_requests'] == 20
+        assert labels['UDP expect #2']['successful_requests'] == 20
+
+    def test_requires_a_step(self, mock_udp_server):
+        _, port = mock_udp_server
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(ValueError):
+            engine.run_socket_test(protocol="udp", targets=[('127.0.0.1', port)], script=[])
+
+
+@_skip_no_c
+class TestSocketTestValidation:
+    """Bad arguments are rejected before anything runs."""
+
+    @pytest.mark.parametrize("kwargs", [
+        {"protocol": "sctp"},
+        {"targets": []},
+        {"targets": [('127.0.0.1', 0)]},
+        {"connections": 0},
+        {"timeout_ms": 0},
+        {"iterations": 0, "duration_seconds": 0},
+        {"script": [{"send": ""}]},
+        {"script": [{"expect": 0}]},
+        {"script": [{"send": "a", "expect": 1}]},
+        {"script": [{"name": "nothing"}]},
+    ])
+    def test_rejects(self, kwargs):
+        engine = Engine(max_connections=10, worker_threads=1)
+        args = {"targets": [('127.0.0.1', 9)], "script": [{"send": "x"}]}
+        args.update(kwargs)
+        with pytest.raises(ValueError):
+            engine.run_socket_test(**args)
+
+    def test_rejects_non_dict_step(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(TypeError):
+            engine.run_socket_test(targets=[('127.0.0.1', 9)], script=["send"])
+
+    def test_unresolvable_target(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(RuntimeError):
+            engine.run_socket_test(targets=[('no-such-host.invalid', 80)], script=[{"send": "x"}])
+
+
+@_skip_no_c
+class TestUDPBlast:
+    """Rate-controlled datagram blasting with and without an echoing peer."""
+
+    def test_echo_rtt_and_loss(self, mock_udp_server):
+        _, port = mock_udp_server
+        engine = Engine(max_connections=10, worker_threads=1, event_loops=2)
+        result = engine.udp_blast('127.0.0.1', port, rate_pps=400, duration_seconds=1,
+                                  flows=2, expect_echo=True)
+        assert 300 <= result['datagrams_sent'] <= 500
+        assert result['datagrams_received'] == result['datagrams_sent']
+        assert result['drop_rate'] == 0.0
+        assert 0 < result['rtt_p50_us'] <= result['rtt_p99_us'] <= result['rtt_max_us']
+        assert result['bytes_sent'] == result['datagrams_sent'] * 64
+        echo = engine.get_metrics()['labels']['UDP echo']
+        assert echo['successful_requests'] == result['datagrams_received']
+
+    def test_rate_is_respected(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.udp_blast('127.0.0.1', _closed_port(), rate_pps=2000, duration_seconds=1)
+        attempted = result['datagrams_sent'] + result['send_errors']
+        assert 1600 <= attempted <= 2400
+        assert result['drop_rate'] is None
+        assert 'rtt_p50_us' not in result
+
+    def test_unthrottled_batches(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.udp_blast('127.0.0.1', _closed_port(), duration_seconds=1,
+                                  payload_size=128, batch_size=32, gso=True)
+        assert result['datagrams_sent'] + result['send_errors'] > 2000
+        assert result['send_pps'] > 0
+        assert isinstance(result['gso'], bool)
+
+    @pytest.mark.parametrize("kwargs", [
+        {"payload_size": 8},
+        {"payload_size": 70000},
+        {"batch_size": 0},
+        {"duration_seconds": 0},
+        {"flows": 0},
+        {"rate_pps": -1.0},
+        {"port": 0},
+    ])
+    def test_rejects(self, kwargs):
+        engine = Engine(max_connections=10, worker_threads=1)
+        args = {"host": '127.0.0.1', "port": 9, "duration_seconds": 1}
+        args.update(kwargs)
+        with pytest.raises(ValueError):
+            engine.udp_blast(**args)
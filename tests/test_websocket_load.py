@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+LoadSpiker WebSocket Load Test Tests
+====================================
+
+Tests for engine_start_websocket_test against a local echo server:
+- Round-trip mode with one echo outstanding per connection
+- Rate mode pacing, binary frames and connection ramp-up
+- Upgrade paths, subprotocols and server-initiated closes
+- Refused connections, rejected upgrades and lost echoes
+- Argument validation
+"""
+
+import sys
+import os
+import socket
+import pytest
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from loadspiker import Engine
+from loadspiker.engine import _c_extension_available
+
+_skip_no_c = pytest.mark.skipif(not _c_extension_available,
+    reason="C extension not built")
+
+
+def _closed_port():
+    """A local TCP port nothing listens on"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.bind(('127.0.0.1', 0))
+    port = sock.getsockname()[1]
+    sock.close()
+    return port
+
+
+@_skip_no_c
+class TestWebSocketMessaging:
+    """Connections held open on the event loops, echoes matched by stamp."""
+
+    def test_round_trip_fixed_count(self, mock_websocket_server):
+        engine = Engine(max_connections=10, worker_threads=1, event_loops=2)
+        result = engine.run_websocket_test(mock_websocket_server.url('/echo'), connections=8,
+                                           messages=25, duration_seconds=0)
+        assert result['connected'] == 8
+        assert result['peak_open'] == 8
+        assert result['messages_sent'] == 200
+        assert result['echoes'] == 200
+        assert result['loss_rate'] == 0.0
+        assert result['timeouts'] == 0
+        assert 0 < result['rtt_p50_us'] <= result['rtt_p99_us'] <= result['rtt_max_us']
+        assert mock_websocket_server.message_count == 200
+        assert mock_websocket_server.paths == ['/echo'] * 8
+
+        labels = engine.get_metrics()['labels']
+        assert labels['WS connect']['successful_requests'] == 8
+        assert labels['WS message']['successful_requests'] == 200
+
+    def test_rate_is_respected(self, mock_websocket_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_websocket_test(mock_websocket_server.url(), connections=4, mode="rate",
+                                           rate=200, duration_seconds=1)
+        assert 150 <= result['messages_sent'] <= 250
+        assert result['echoes'] == result['messages_sent']
+
+    def test_binary_and_large_frames(self, mock_websocket_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_websocket_test(mock_websocket_server.url(), connections=2, binary=True,
+                                           payload_size=70000, messages=5, duration_seconds=0)
+        assert result['echoes'] == 10
+        assert result['bytes_sent'] >= 10 * 70000
+        assert mock_websocket_server.opcodes == {0x2}
+
+    def test_connect_ramp(self, mock_websocket_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_websocket_test(mock_websocket_server.url(), connections=10, connect_rate=20,
+                                           messages=1, duration_seconds=0)
+        assert result['connected'] == 10
+        assert result['echoes'] == 10
+        assert result['elapsed_seconds'] >= 0.3
+
+    def test_duration_bounded(self, mock_websocket_server):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_websocket_test(mock_websocket_server.url(), connections=4, duration_seconds=1)
+        assert result['echoes'] > 20
+        assert 0.5 < result['elapsed_seconds'] < 4
+        assert result['echoes'] == result['messages_sent']
+
+    def test_server_close_is_counted(self, mock_websocket_server):
+        mock_websocket_server.close_after = 3
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_websocket_test(mock_websocket_server.url(), connections=3, messages=10,
+                                           duration_seconds=0)
+        assert result['closed_by_server'] == 3
+        assert result['echoes'] == 9
+
+
+@_skip_no_c
+class TestWebSocketFailures:
+    """Broken servers show up as failed samples, not hangs."""
+
+    def test_refused_tcp_connect(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_websocket_test('ws://127.0.0.1:%d/' % _closed_port(), connections=4,
+                                           messages=5, duration_seconds=0)
+        assert result['connect_failures'] == 4
+        assert result['messages_sent'] == 0
+        metrics = engine.get_metrics()
+        assert metrics['labels']['WS connect']['failed_requests'] == 4
+        assert sum(metrics['errors'].values()) == 4
+
+    def test_rejected_upgrade(self, mock_websocket_server):
+        mock_websocket_server.reject_upgrade = True
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_websocket_test(mock_websocket_server.url(), connections=3, messages=5,
+                                           duration_seconds=0)
+        assert result['connect_failures'] == 3
+        assert engine.get_metrics()['labels']['WS connect']['failed_requests'] == 3
+
+    def test_lost_echoes_time_out(self, mock_websocket_server):
+        mock_websocket_server.no_echo = True
+        engine = Engine(max_connections=10, worker_threads=1)
+        result = engine.run_websocket_test(mock_websocket_server.url(), connections=1, messages=3,
+                                           duration_seconds=0, timeout_ms=200, linger_ms=100)
+        # Each timeout frees the connection for its next message
+        assert result['messages_sent'] == 3
+        assert result['timeouts'] == 3
+        assert result['echoes'] == 0
+        assert 'rtt_p50_us' not in result
+        assert engine.get_metrics()['labels']['WS message']['failed_requests'] == 3
+
+
+@_skip_no_c
+class TestWebSocketValidation:
+    """Bad arguments are rejected before anything connects."""
+
+    @pytest.mark.parametrize("kwargs", [
+        {"url": "wss://127.0.0.1/"},
+        {"url": "http://127.0.0.1/"},
+        {"mode": "flood"},
+        {"connections": 0},
+        {"payload_size": 8},
+        {"payload_size": 2 << 20},
+        {"messages": 0, "duration_seconds": 0},
+        {"rate": -1.0},
+        {"timeout_ms": 0},
+        {"connect_rate": -1.0},
+    ])
+    def test_rejects(self, kwargs):
+        engine = Engine(max_connections=10, worker_threads=1)
+        args = {"url": 'ws://127.0.0.1:9/', "duration_seconds": 1}
+        args.update(kwargs)
+        with pytest.raises(ValueError):
+            engine.run_websocket_test(**args)
+
+    def test_unresolvable_host(self):
+        engine = Engine(max_connections=10, worker_threads=1)
+        with pytest.raises(RuntimeError):
+            engine.run_websocket_test('ws://no-such-host.invalid/', duration_seconds=1)
@@ -7,20 +7,101 @@
  * Connections WILL fail (no server listening) — that is expected and intentional.
  * TSAN cares about concurrent access to shared pool arrays, not connection success.
  *
+ * A second phase has NUM_THREADS threads record metrics into one engine while
+ * another thread keeps merging snapshots, then checks nothing was lost and
+ * that histogram percentiles stay within the configured precision and
+ * survive an encode/decode round trip and a merge. Finally a
+ * short load test per execution mode checks request dispatch: every request
+ * in the table must be attempted exactly once (against a closed port), and
+ * a looping test drained by concurrent window consumers checks the windows
+ * add up to the cumulative totals. The placement check repeats it with
+ * the engine's threads pinned to the process's CPUs and connections bound
+ * to a source address and port range. The replay check converts the same
+ * requests from JSONL with timestamps into a replay log and plays it back
+ * on the recorded schedule, checking the same totals. The param check
+ * loops over requests with ${column} placeholders, each pass taking a fresh
+ * data row, and checks the test ends once every row has been used.
+ * The match check feeds a body to the response assertion matcher split at
+ * every offset, so each needle straddles a chunk boundary somewhere. The
+ * assertion check then runs a test with one failing and several passing
+ * assertions against a local server that writes its body in two pieces,
+ * and checks every response was checked and counted under each. The
+ * health check runs an open-model test against the same server while a
+ * reader samples the phase timings and generator health, and four threads
+ * contend for a lock through the lock statistics; every request must be
+ * timed in each phase and lagged exactly once. The protocol check asks for
+ * HTTP/2 on keep-alive connections to the same HTTP/1.1 server and checks
+ * every stream was counted as HTTP/1.1 on its own connection.
+ *
+ * The pool check holds one TCP connection in a blocking receive and checks
+ * that a full connect/send/disconnect on another connection is not held up.
+ * The growth check opens more UDP endpoints than the default pool holds from
+ * all threads at once, closes them again and repeats, so freed slots are
+ * reused while other threads are still allocating.
+ *
+ * The socket test check runs a send/expect script over TCP connections
+ * spread across two socket loops against a local echo server, while the
+ * controller closes metrics windows, then checks every step was counted.
+ * The UDP check bounces a sendmmsg() batch and a two-thread, rate-limited
+ * blast off a local echo server and checks the counts agree.
+ * The MQTT check runs QoS 2 publishers and subscribers over two MQTT loops
+ * against a tiny local broker and checks every publish was acknowledged
+ * and delivered to every subscriber.
+ * The WebSocket check holds connections on two WebSocket loops against a
+ * local echo server that does the upgrade and unmasks every frame, and
+ * checks every round trip came back.
+ * The JSONL check parses a few MB of requests on four threads and checks
+ * they land in the table in input order.
+ * The stop check ends a looping one-minute test from another thread with
+ * engine_stop() in each execution mode, after checking that a claim and a
+ * second start on the busy engine are both refused with EBUSY.
+ * The abort check points a looping test at a listener that never answers
+ * and checks both the end of its duration and engine_stop() return at once
+ * rather than after the 30 s request timeout, with nothing recorded; a
+ * request queued to the pool workers afterwards must still be sent.
+ * The request loop check submits non-blocking requests from four threads
+ * while the main thread waits on the completion fd and collects them, and
+ * checks every ticket comes back exactly once.
+ * The scratch check sends blocking requests with headers from four threads
+ * and checks they took their header lists from per-thread arenas, which
+ * are unmapped as the threads exit, without a single heap allocation.
+ * The dispatch check pushes items through a small lock-free request queue
+ * from four producers to four batch-claiming consumers that park when it
+ * runs dry, and checks every item arrived exactly once; then it queues
+ * fire-and-forget requests from four threads and checks the pool workers
+ * sent every one.
+ *
  * Build and run via: make tsan
  */
 
+#define _GNU_SOURCE   /* sched_getaffinity */
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include "../src/engine.h"
+#include "../src/engine_internal.h"
+#include "../src/common.h"
 #include "../src/protocols/tcp.h"
 #include "../src/protocols/udp.h"
 #include "../src/protocols/mqtt.h"
+#include "../src/protocols/websocket.h"
 #include "../src/protocols/database.h"
+#include "../src/request_jsonl.h"
+#include "../src/mpmc_queue.h"
 
 #define NUM_THREADS 8
 #define ITERATIONS  20
+#define METRIC_SAMPLES 20000
+#define JSONL_REQUESTS 40000
 
 /* Thread argument carrying the thread index so each thread can use a unique
    client_id for MQTT (avoiding all threads contending for the same slot). */
@@ -92,19 +173,2008 @@ static void *db_thread_func(void *arg)
     thread_arg_t *targ = (thread_arg_t *)arg;
     (void)targ;
 
+    /* Nothing listens on port 1: every connect fails fast, and each thread
+       still builds and registers its own pool */
     for (int i = 0; i < ITERATIONS; i++) {
         response_t resp;
         memset(&resp, 0, sizeof(resp));
-        database_connect("mysql://127.0.0.1:3306/test", "mysql", &resp);
+        database_connect("postgresql://u:p@127.0.0.1:1/test", "postgresql", &resp);
 
         memset(&resp, 0, sizeof(resp));
-        database_disconnect("mysql://127.0.0.1:3306/test", &resp);
+        database_execute_query("postgresql://u:p@127.0.0.1:1/test", "SELECT 1", &resp);
+
+        memset(&resp, 0, sizeof(resp));
+        database_disconnect("postgresql://u:p@127.0.0.1:1/test", &resp);
     }
     return NULL;
 }
 
+/* ---- Per-connection pool locking ---------------------------------------- */
+
+static int listen_local(int *port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int blocked_port;
+static response_t blocked_response;
+
+static void *blocked_receive_func(void *arg)
+{
+    (void)arg;
+    tcp_receive("127.0.0.1", blocked_port, &blocked_response);
+    return NULL;
+}
+
+static int run_pool_check(void)
+{
+    int other_port = 0;
+    int blocked_listener = listen_local(&blocked_port);
+    int other_listener = listen_local(&other_port);
+    if (blocked_listener < 0 || other_listener < 0) return 1;
+
+    response_t resp;
+    int peer = -1;
+    if (tcp_connect("127.0.0.1", blocked_port, &resp) == 0) {
+        peer = accept(blocked_listener, NULL, NULL);
+    }
+    if (peer < 0) {
+        printf("tsan_check: pool check could not connect to its listener\n");
+        return 1;
+    }
+
+    pthread_t receiver;
+    pthread_create(&receiver, NULL, blocked_receive_func, NULL);
+    usleep(100000);  /* let the receiver park in select() with its slot locked */
+
+    uint64_t start_us = get_time_us();
+    int rc = tcp_connect("127.0.0.1", other_port, &resp);
+    rc |= tcp_send("127.0.0.1", other_port, "ping", &resp);
+    rc |= tcp_disconnect("127.0.0.1", other_port, &resp);
+    uint64_t elapsed_us = get_time_us() - start_us;
+
+    send(peer, "pong", 4, 0);
+    pthread_join(receiver, NULL);
+    tcp_disconnect("127.0.0.1", blocked_port, &resp);
+    close(peer);
+    close(blocked_listener);
+    close(other_listener);
+
+    if (rc != 0 || elapsed_us > 1000000 || blocked_response.status_code != 200) {
+        printf("tsan_check: pool check: other connection took %llu us (rc %d), blocked receive got %d\n",
+               (unsigned long long)elapsed_us, rc, blocked_response.status_code);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Growable pools ------------------------------------------------------ */
+
+#define GROWTH_ENDPOINTS_PER_THREAD 40
+#define GROWTH_BASE_PORT 20000
+
+static _Atomic int growth_failures;
+
+static void *growth_thread_func(void *arg)
+{
+    thread_arg_t *targ = (thread_arg_t *)arg;
+    int first = GROWTH_BASE_PORT + targ->idx * GROWTH_ENDPOINTS_PER_THREAD;
+    response_t resp;
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < GROWTH_ENDPOINTS_PER_THREAD; i++) {
+            if (udp_create_endpoint("127.0.0.1", first + i, &resp) != 0) growth_failures++;
+        }
+        for (int i = 0; i < GROWTH_ENDPOINTS_PER_THREAD; i++) {
+            if (udp_close_endpoint("127.0.0.1", first + i, &resp) != 0) growth_failures++;
+        }
+    }
+    return NULL;
+}
+
+static int run_pool_growth_check(void)
+{
+    const int total = NUM_THREADS * GROWTH_ENDPOINTS_PER_THREAD;
+    int default_size = udp_get_pool_size();
+    int baseline = udp_get_pool_in_use();
+    if (udp_set_pool_size(baseline + total) != 0) return 1;
+
+    pthread_t threads[NUM_THREADS];
+    thread_arg_t args[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        args[i].idx = i;
+        pthread_create(&threads[i], NULL, growth_thread_func, &args[i]);
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    int after_rounds = udp_get_pool_in_use();
+
+    /* Fill the pool exactly, then one more endpoint must be refused */
+    response_t resp;
+    int filled = 0;
+    for (int i = 0; i < total; i++) {
+        if (udp_create_endpoint("127.0.0.1", GROWTH_BASE_PORT + i, &resp) == 0) filled++;
+    }
+    int overflow = udp_create_endpoint("127.0.0.1", GROWTH_BASE_PORT + total, &resp);
+    for (int i = 0; i < total; i++) {
+        udp_close_endpoint("127.0.0.1", GROWTH_BASE_PORT + i, &resp);
+    }
+    int after_close = udp_get_pool_in_use();
+    udp_set_pool_size(default_size);
+
+    if (growth_failures != 0 || after_rounds != baseline || filled != total || overflow == 0 ||
+        after_close != baseline) {
+        printf("tsan_check: growth check: %d failures, %d in use after rounds, %d/%d filled, overflow %d, "
+               "%d in use after close (baseline %d)\n",
+               (int)growth_failures, after_rounds, filled, total, overflow, after_close, baseline);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Metrics ------------------------------------------------------------- */
+
+static engine_t *metrics_engine;
+static _Atomic int metrics_writers_done;
+
+static void *metrics_writer_func(void *arg)
+{
+    thread_arg_t *targ = (thread_arg_t *)arg;
+
+    for (int i = 0; i < METRIC_SAMPLES; i++) {
+        /* Spread samples over several histogram buckets */
+        engine_update_metrics(metrics_engine, (uint64_t)(targ->idx * 1000 + i % 5000), i % 10 != 0);
+    }
+    return NULL;
+}
+
+static void *metrics_reader_func(void *arg)
+{
+    (void)arg;
+    metrics_t snapshot;
+
+    while (!atomic_load(&metrics_writers_done)) {
+        engine_get_metrics(metrics_engine, &snapshot);
+    }
+    return NULL;
+}
+
+static int run_metrics_check(void)
+{
+    pthread_t writers[NUM_THREADS];
+    pthread_t reader;
+    thread_arg_t args[NUM_THREADS];
+
+    metrics_engine = engine_create(10, 1);
+    if (!metrics_engine) {
+        printf("tsan_check: engine_create failed\n");
+        return 1;
+    }
+
+    pthread_create(&reader, NULL, metrics_reader_func, NULL);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        args[i].idx = i;
+        pthread_create(&writers[i], NULL, metrics_writer_func, &args[i]);
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(writers[i], NULL);
+    }
+    atomic_store(&metrics_writers_done, 1);
+    pthread_join(reader, NULL);
+
+    metrics_t metrics;
+    engine_get_metrics(metrics_engine, &metrics);
+    engine_destroy(metrics_engine);
+
+    uint64_t expected = (uint64_t)NUM_THREADS * METRIC_SAMPLES;
+    if (metrics.total_requests != expected ||
+        metrics.successful_requests + metrics.failed_requests != expected) {
+        printf("tsan_check: metrics lost samples (%llu of %llu)\n",
+               (unsigned long long)metrics.total_requests, (unsigned long long)expected);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Histogram ----------------------------------------------------------- */
+
+static int within_precision(uint64_t actual, uint64_t expected)
+{
+    /* 2 significant digits: every value resolves to within 1% */
+    uint64_t diff = actual > expected ? actual - expected : expected - actual;
+    return diff * 100 <= expected;
+}
+
+static int run_histogram_check(void)
+{
+    histogram_layout_t layout;
+    if (histogram_layout_init(&layout, HISTOGRAM_DEFAULT_HIGHEST_US, HISTOGRAM_DEFAULT_SIGNIFICANT_DIGITS) != 0) {
+        printf("tsan_check: histogram_layout_init failed\n");
+        return 1;
+    }
+    histogram_t *h = histogram_create(&layout);
+    if (!h) return 1;
+
+    for (uint64_t v = 1; v <= 100000; v++) {
+        histogram_record(h, v);
+    }
+    int ok = within_precision(histogram_value_at_percentile(h, 50.0), 50000) &&
+             within_precision(histogram_value_at_percentile(h, 99.9), 99900) &&
+             within_precision(histogram_value_at_percentile(h, 1.0), 1000) &&
+             histogram_value_at_percentile(h, 100.0) == 100000;
+
+    /* Beyond the tracked range: counted in the top bucket, exact max kept */
+    histogram_record(h, 2 * HISTOGRAM_DEFAULT_HIGHEST_US);
+    ok = ok && h->total_count == 100001 && h->max_value == 2 * HISTOGRAM_DEFAULT_HIGHEST_US;
+
+    /* Encoded and decoded, then added to itself: same shape, twice the samples */
+    size_t len = 0;
+    uint8_t *encoded = histogram_encode(h, &len);
+    histogram_t *copy = encoded ? histogram_decode(encoded, len) : NULL;
+    ok = ok && copy && copy->total_count == h->total_count && copy->max_value == h->max_value &&
+         memcmp(copy->counts, h->counts, sizeof(uint64_t) * (size_t)layout.counts_len) == 0 &&
+         histogram_add(copy, h) == 0 && copy->total_count == 2 * h->total_count &&
+         histogram_value_at_percentile(copy, 99.9) == histogram_value_at_percentile(h, 99.9);
+    /* Truncated input is rejected, not read past */
+    ok = ok && histogram_decode(encoded, len - 1) == NULL && histogram_decode(encoded, 3) == NULL;
+    histogram_destroy(copy);
+    free(encoded);
+
+    histogram_destroy(h);
+    if (!ok) {
+        printf("tsan_check: histogram percentiles out of precision (%d counters)\n", layout.counts_len);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- JSONL request ingestion ---------------------------------------------- */
+
+static int run_jsonl_check(void)
+{
+    size_t cap = (size_t)JSONL_REQUESTS * 128, len = 0;
+    char *data = malloc(cap);
+    if (!data) return 1;
+    for (int i = 0; i < JSONL_REQUESTS; i++) {
+        len += (size_t)snprintf(data + len, cap - len,
+                                "{\"url\": \"http://127.0.0.1:9/item/%d\", \"method\": \"%s\", "
+                                "\"headers\": {\"X-Seq\": \"%d\"}, \"body\": \"n=%d\"}\n",
+                                i, i % 2 ? "POST" : "GET", i, i);
+    }
+
+    request_table_t table;
+    request_table_init(&table);
+    char error[256];
+    int added = request_table_load_jsonl(&table, data, len, 4, error, sizeof(error));
+    int ok = added == JSONL_REQUESTS && table.count == JSONL_REQUESTS;
+    for (int i = 0; ok && i < JSONL_REQUESTS; i += 997) {
+        request_view_t view;
+        char url[64], headers[32];
+        snprintf(url, sizeof(url), "http://127.0.0.1:9/item/%d", i);
+        snprintf(headers, sizeof(headers), "X-Seq: %d", i);
+        ok = request_table_get(&table, i, &view) == 0 && strcmp(view.url, url) == 0 &&
+             strcmp(view.headers, headers) == 0 && strcmp(view.method, i % 2 ? "POST" : "GET") == 0;
+    }
+
+    /* An error deep into a later chunk reports its line in the whole input */
+    data[len - 3] = ',';
+    request_table_t broken;
+    request_table_init(&broken);
+    ok = ok && request_table_load_jsonl(&broken, data, len, 4, error, sizeof(error)) == -1 &&
+         broken.count == 0 && strncmp(error, "line 40000:", 11) == 0;
+
+    request_table_free(&table);
+    request_table_free(&broken);
+    free(data);
+    if (!ok) {
+        printf("tsan_check: JSONL ingestion lost or reordered requests (%d added, %s)\n", added, error);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Load test dispatch -------------------------------------------------- */
+
+#define LOAD_TEST_REQUESTS 200
+#define LOAD_TEST_ARRIVAL_RATE 2000.0   /* open model: the whole table in ~0.1 s */
+
+/* Nothing listens on port 9: every request is a "GET /" or "POST /" that got
+   no HTTP response, so each breakdown must account for all of them */
+static int check_breakdown(engine_t *engine, int requests)
+{
+    if (engine_get_label_count(engine) != 2) return 0;
+
+    uint64_t labelled = 0;
+    for (int l = 0; l < 2; l++) {
+        label_metrics_t label;
+        if (engine_get_label_metrics(engine, l, &label) != 0) return 0;
+        if (strcmp(label.name, l == 0 ? "GET /" : "POST /") != 0) return 0;
+        if (label.total_requests != (uint64_t)requests / 2 || label.status_classes[0] != label.total_requests) return 0;
+        labelled += label.total_requests;
+    }
+
+    uint64_t status[ENGINE_STATUS_CODES];
+    uint64_t errors[ENGINE_ERROR_CODES];
+    engine_get_status_counts(engine, status, ENGINE_STATUS_CODES);
+    engine_get_error_counts(engine, errors, ENGINE_ERROR_CODES);
+    uint64_t failed = 0;
+    for (int i = 0; i < ENGINE_ERROR_CODES; i++) failed += errors[i];
+    return labelled == (uint64_t)requests && status[0] == (uint64_t)requests && failed == (uint64_t)requests;
+}
+
+static int run_load_test_check(engine_mode_t mode, arrival_mode_t arrival)
+{
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.mode = mode;
+    config.event_loops = 2;
+
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) return 1;
+
+    request_table_t table;
+    request_table_init(&table);
+    for (int i = 0; i < LOAD_TEST_REQUESTS; i++) {
+        request_table_add(&table, i % 2 ? "POST" : "GET", "http://127.0.0.1:9/", "X-Test: 1",
+                          "payload", 7, 2000);
+    }
+
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 8;
+    options.duration_seconds = 10;
+    options.arrival_mode = arrival;
+    options.arrival_rate = arrival == ARRIVAL_MODE_CLOSED ? 0.0 : LOAD_TEST_ARRIVAL_RATE;
+    options.arrival_seed = 42;
+
+    int rc = engine_start_load_test_table(engine, &table, &options);
+    metrics_t metrics;
+    engine_get_metrics(engine, &metrics);
+    int breakdown_ok = check_breakdown(engine, LOAD_TEST_REQUESTS);
+    engine_destroy(engine);
+    request_table_free(&table);
+
+    if (rc != 0 || metrics.total_requests != LOAD_TEST_REQUESTS) {
+        printf("tsan_check: load test (mode %d, arrival %d) dispatched %llu of %d requests\n",
+               (int)mode, (int)arrival, (unsigned long long)metrics.total_requests, LOAD_TEST_REQUESTS);
+        return 1;
+    }
+    if (!breakdown_ok) {
+        printf("tsan_check: load test (mode %d, arrival %d) label/status breakdown does not add up\n",
+               (int)mode, (int)arrival);
+        return 1;
+    }
+    return 0;
+}
+
+/* The same dispatch with the engine's threads pinned to this process's
+   CPUs, NUMA-local shards and connections bound to a source address and
+   port range */
+static int run_placement_check(engine_mode_t mode)
+{
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 2;
+    config.mode = mode;
+    config.event_loops = 2;
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE && config.cpu_count < 4; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) config.cpus[config.cpu_count++] = cpu;
+        }
+    }
+    config.numa_local = true;
+    strcpy(config.source_addresses[0], "127.0.0.1");
+    config.source_address_count = 1;
+    config.source_port_min = 43000;
+    config.source_port_max = 43999;
+
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) return 1;
+
+    request_table_t table;
+    request_table_init(&table);
+    for (int i = 0; i < LOAD_TEST_REQUESTS; i++) {
+        request_table_add(&table, i % 2 ? "POST" : "GET", "http://127.0.0.1:9/", "X-Test: 1",
+                          "payload", 7, 2000);
+    }
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 8;
+    options.duration_seconds = 10;
+
+    int rc = engine_start_load_test_table(engine, &table, &options);
+    metrics_t metrics;
+    engine_get_metrics(engine, &metrics);
+    int breakdown_ok = check_breakdown(engine, LOAD_TEST_REQUESTS);
+    /* Every bind worked: the requests all failed at connect() */
+    uint64_t errors[ENGINE_ERROR_CODES];
+    engine_get_error_counts(engine, errors, ENGINE_ERROR_CODES);
+    engine_destroy(engine);
+    request_table_free(&table);
+
+    if (rc != 0 || metrics.total_requests != LOAD_TEST_REQUESTS || !breakdown_ok ||
+        errors[CURLE_COULDNT_CONNECT] != LOAD_TEST_REQUESTS) {
+        printf("tsan_check: placed load test (mode %d) dispatched %llu of %d requests, %llu refused\n",
+               (int)mode, (unsigned long long)metrics.total_requests, LOAD_TEST_REQUESTS,
+               (unsigned long long)errors[CURLE_COULDNT_CONNECT]);
+        return 1;
+    }
+    return 0;
+}
+
+/* The same dispatch from a replay log converted from JSONL, paced by the
+   recorded timestamps (1 ms apart, replayed at 4x) */
+static int run_replay_check(engine_mode_t mode)
+{
+    char jsonl_path[] = "/tmp/tsan_replay_XXXXXX";
+    int fd = mkstemp(jsonl_path);
+    if (fd < 0) return 1;
+    FILE *out = fdopen(fd, "w");
+    for (int i = 0; out && i < LOAD_TEST_REQUESTS; i++) {
+        fprintf(out, "{\"url\": \"http://127.0.0.1:9/\", \"method\": \"%s\", \"headers\": {\"X-Test\": \"1\"}, "
+                     "\"body\": \"payload\", \"timeout_ms\": 2000, \"timestamp\": %.3f}\n",
+                i % 2 ? "POST" : "GET", 1700000000.0 + i * 0.001);
+    }
+    if (out) fclose(out);
+
+    char log_path[sizeof(jsonl_path) + 4];
+    snprintf(log_path, sizeof(log_path), "%s.lsr", jsonl_path);
+    char error[256] = "";
+    replay_log_info_t info;
+    int converted = replay_log_convert_jsonl(jsonl_path, log_path, 2, &info, error, sizeof(error));
+    unlink(jsonl_path);
+    replay_log_t *log = converted == 0 ? replay_log_open(log_path, error, sizeof(error)) : NULL;
+    unlink(log_path);
+    if (!log || info.requests != LOAD_TEST_REQUESTS || info.templates != 2 || !info.timestamps ||
+        info.span_us != (LOAD_TEST_REQUESTS - 1) * 1000) {
+        printf("tsan_check: replay log conversion failed (%s)\n", error);
+        replay_log_close(log);
+        return 1;
+    }
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.mode = mode;
+    config.event_loops = 2;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) {
+        replay_log_close(log);
+        return 1;
+    }
+
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 8;
+    options.duration_seconds = 0;
+    options.arrival_mode = ARRIVAL_MODE_RECORDED;
+    options.replay_speed = 4.0;
+
+    int rc = engine_start_replay_test(engine, log, &options);
+    metrics_t metrics;
+    engine_get_metrics(engine, &metrics);
+    int breakdown_ok = check_breakdown(engine, LOAD_TEST_REQUESTS);
+    engine_destroy(engine);
+    replay_log_close(log);
+
+    if (rc != 0 || metrics.total_requests != LOAD_TEST_REQUESTS || !breakdown_ok) {
+        printf("tsan_check: replay test (mode %d) dispatched %llu of %d requests\n",
+               (int)mode, (unsigned long long)metrics.total_requests, LOAD_TEST_REQUESTS);
+        return 1;
+    }
+    return 0;
+}
+
+/* Data-driven requests: every pass takes a fresh row, substituted into the
+   URL, headers and body in each worker's scratch, until the rows run out */
+static int run_param_check(engine_mode_t mode)
+{
+    enum { ROWS = 16, REQUESTS = 3 };
+    param_table_t data;
+    param_table_init(&data, "users");
+    char csv[2048];
+    int len = snprintf(csv, sizeof(csv), "id,token\n");
+    for (int i = 0; i < ROWS; i++) len += snprintf(csv + len, sizeof(csv) - (size_t)len, "%d,\"t,%d\"\n", i, i * 7);
+    char error[256] = "";
+    if (param_table_load_csv(&data, csv, (size_t)len, ',', error, sizeof(error)) != ROWS) {
+        printf("tsan_check: param table load failed (%s)\n", error);
+        param_table_free(&data);
+        return 1;
+    }
+
+    request_table_t table;
+    request_table_init(&table);
+    static const char body[] = "{\"id\": ${id}, \"token\": \"${users.token}\"}";
+    request_table_add(&table, "GET", "http://127.0.0.1:9/users/${id}", "X-Token: ${token}", NULL, 0, 2000);
+    request_table_add(&table, "POST", "http://127.0.0.1:9/orders", "X-Test: 1", body, sizeof(body) - 1, 2000);
+    request_table_add(&table, "PUT", "http://127.0.0.1:9/users/${id}?unknown=${nope}", NULL, body, sizeof(body) - 1, 2000);
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.mode = mode;
+    config.event_loops = 2;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) {
+        request_table_free(&table);
+        param_table_free(&data);
+        return 1;
+    }
+
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 8;
+    options.duration_seconds = 10;
+    options.loop_requests = true;
+    options.data = &data;
+    options.data_strategy = PARAM_ROWS_UNIQUE;
+
+    int rc = engine_start_load_test_table(engine, &table, &options);
+    metrics_t metrics;
+    engine_get_metrics(engine, &metrics);
+    engine_destroy(engine);
+    request_table_free(&table);
+    param_table_free(&data);
+
+    if (rc != 0 || metrics.total_requests != ROWS * REQUESTS) {
+        printf("tsan_check: param test (mode %d) sent %llu of %d requests\n",
+               (int)mode, (unsigned long long)metrics.total_requests, ROWS * REQUESTS);
+        return 1;
+    }
+    return 0;
+}
+
+/* Response assertions: a needle split across body chunks, or held back
+   over several tiny ones, is still found, and an absent one is not */
+static int run_response_match_check(void)
+{
+    static const char body[] = "{\"status\": \"ok\", \"items\": [1, 2, 3], \"next\": null}";
+    const size_t len = sizeof(body) - 1;
+    response_assert_t assertions[3];
+    memset(assertions, 0, sizeof(assertions));
+    assertions[0].kind = RESPONSE_ASSERT_BODY_CONTAINS;
+    snprintf(assertions[0].text, sizeof(assertions[0].text), "\"items\": [1, 2, 3]");
+    assertions[1].kind = RESPONSE_ASSERT_BODY_CONTAINS;
+    snprintf(assertions[1].text, sizeof(assertions[1].text), "null}");
+    assertions[2].kind = RESPONSE_ASSERT_BODY_EXCLUDES;
+    snprintf(assertions[2].text, sizeof(assertions[2].text), "error");
+    for (int i = 0; i < 3; i++) {
+        assertions[i].text_len = strlen(assertions[i].text);
+        if (response_assert_prepare(&assertions[i]) != 0) return 1;
+    }
+
+    response_match_t match;
+    response_match_init(&match, assertions, 3);
+    for (size_t split = 0; split <= len; split++) {
+        for (size_t step = 1; step <= 3; step++) {
+            /* body[0..split) at once, then the rest `step` bytes at a time */
+            response_match_reset(&match);
+            response_match_body((char *)body, 1, split, &match);
+            for (size_t off = split; off < len; off += step) {
+                response_match_body((char *)body + off, 1, off + step <= len ? step : len - off, &match);
+            }
+            if (response_match_finish(&match, 200, 0) != 0) {
+                printf("tsan_check: response match missed a needle (split %zu, step %zu)\n", split, step);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static _Atomic int http_stop;
+
+/* One response per connection: headers and the first half of the body in
+   one write, the rest in another */
+static void *http_server_func(void *arg)
+{
+    static const char head[] = "HTTP/1.1 200 OK\r\nContent-Length: 14\r\nX-Check: yes-42\r\n"
+                               "Connection: close\r\n\r\nhello, ";
+    static const char tail[] = "world!!";
+    int listener = *(int *)arg;
+    struct pollfd pfd = {listener, POLLIN, 0};
+    while (!atomic_load(&http_stop)) {
+        if (poll(&pfd, 1, 50) <= 0) continue;
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) continue;
+        char buf[4096];
+        size_t got = 0;
+        while (got < sizeof(buf) - 1) {
+            ssize_t n = recv(fd, buf + got, sizeof(buf) - 1 - got, 0);
+            if (n <= 0) break;
+            got += (size_t)n;
+            buf[got] = '\0';
+            if (strstr(buf, "\r\n\r\n")) {
+                send(fd, head, sizeof(head) - 1, MSG_NOSIGNAL);
+                usleep(1000);
+                send(fd, tail, sizeof(tail) - 1, MSG_NOSIGNAL);
+                break;
+            }
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+/* Assertions checked by the workers: every response is checked against all
+   of them, and the one that always fails makes every request a failure */
+static int run_assertion_check(engine_mode_t mode)
+{
+    enum { REQUESTS = 12, ASSERTIONS = 5 };
+    int port = 0;
+    int listener = listen_local(&port);
+    if (listener < 0) return 1;
+    pthread_t server;
+    atomic_store(&http_stop, 0);
+    pthread_create(&server, NULL, http_server_func, &listener);
+
+    request_table_t table;
+    request_table_init(&table);
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/check", port);
+    for (int i = 0; i < REQUESTS; i++) request_table_add(&table, "GET", url, NULL, NULL, 0, 5000);
+
+    response_assert_t assertions[ASSERTIONS];
+    memset(assertions, 0, sizeof(assertions));
+    assertions[0].kind = RESPONSE_ASSERT_STATUS;
+    assertions[0].status_min = 200;
+    assertions[0].status_max = 299;
+    assertions[1].kind = RESPONSE_ASSERT_HEADER;
+    snprintf(assertions[1].header, sizeof(assertions[1].header), "x-check");
+    assertions[1].text_len = 2;
+    memcpy(assertions[1].text, "42", 2);
+    assertions[2].kind = RESPONSE_ASSERT_BODY_CONTAINS;
+    assertions[2].text_len = 9;
+    memcpy(assertions[2].text, ", world!!", 9);
+    assertions[3].kind = RESPONSE_ASSERT_BODY_EXCLUDES;
+    assertions[3].text_len = 5;
+    memcpy(assertions[3].text, "hello", 5);    /* always fails */
+    assertions[4].kind = RESPONSE_ASSERT_LATENCY;
+    assertions[4].max_latency_us = 10000000;
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 2;
+    config.mode = mode;
+    config.event_loops = 2;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) {
+        request_table_free(&table);
+        return 1;
+    }
+
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 4;
+    options.duration_seconds = 10;
+    options.assertions = assertions;
+    options.num_assertions = ASSERTIONS;
+
+    int rc = engine_start_load_test_table(engine, &table, &options);
+    atomic_store(&http_stop, 1);
+    pthread_join(server, NULL);
+    close(listener);
+    request_table_free(&table);
+
+    metrics_t metrics;
+    engine_get_metrics(engine, &metrics);
+    int ok = rc == 0 && metrics.total_requests == REQUESTS && metrics.failed_requests == REQUESTS &&
+             engine_get_assertion_count(engine) == ASSERTIONS;
+    for (int i = 0; ok && i < ASSERTIONS; i++) {
+        assertion_metrics_t assertion;
+        ok = engine_get_assertion_metrics(engine, i, &assertion) == 0 && assertion.checked == REQUESTS &&
+             assertion.failed == (i == 3 ? REQUESTS : 0);
+        if (!ok) {
+            printf("tsan_check: assertion '%s' (mode %d) checked %llu, failed %llu\n", assertion.name, (int)mode,
+                   (unsigned long long)assertion.checked, (unsigned long long)assertion.failed);
+        }
+    }
+    engine_destroy(engine);
+
+    if (!ok) {
+        printf("tsan_check: assertion test (mode %d) sent %llu, failed %llu of %d requests\n", (int)mode,
+               (unsigned long long)metrics.total_requests, (unsigned long long)metrics.failed_requests, REQUESTS);
+        return 1;
+    }
+    return 0;
+}
+
+/* Generator health: a reader samples the phase and health getters while an
+   open-model test records them, and four threads fight over one
+   lock_stats_lock() mutex so its contention counters move concurrently */
+static engine_t *health_engine;
+static _Atomic int health_test_done;
+static pthread_mutex_t health_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t health_shared;
+
+static void *health_reader_func(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&health_test_done)) {
+        generator_health_t health;
+        phase_metrics_t phase;
+        engine_get_generator_health(health_engine, &health);
+        engine_get_phase_metrics(health_engine, ENGINE_PHASE_TTFB, &phase);
+        histogram_t *h = engine_get_phase_histogram(health_engine, ENGINE_PHASE_CONNECT);
+        histogram_destroy(h);
+        usleep(2000);
+    }
+    return NULL;
+}
+
+static void *health_locker_func(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < 2000; i++) {
+        lock_stats_lock(&health_mutex, LOCK_SITE_REQUEST_LOOP);
+        health_shared++;
+        pthread_mutex_unlock(&health_mutex);
+    }
+    return NULL;
+}
+
+static int run_health_check(engine_mode_t mode)
+{
+    enum { REQUESTS = 40, LOCKERS = 4 };
+    int port = 0;
+    int listener = listen_local(&port);
+    if (listener < 0) return 1;
+    pthread_t server;
+    atomic_store(&http_stop, 0);
+    pthread_create(&server, NULL, http_server_func, &listener);
+
+    request_table_t table;
+    request_table_init(&table);
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/health", port);
+    for (int i = 0; i < REQUESTS; i++) request_table_add(&table, "GET", url, NULL, NULL, 0, 5000);
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 2;
+    config.mode = mode;
+    config.event_loops = 2;
+    health_engine = engine_create_with_config(&config);
+    if (!health_engine) {
+        request_table_free(&table);
+        return 1;
+    }
+
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 4;
+    options.duration_seconds = 10;
+    options.arrival_mode = ARRIVAL_MODE_CONSTANT;
+    options.arrival_rate = 200.0;
+
+    lock_site_stats_t locks_before[LOCK_SITES], locks_after[LOCK_SITES];
+    lock_stats_read(locks_before);
+    health_shared = 0;
+    atomic_store(&health_test_done, 0);
+    pthread_t reader, lockers[LOCKERS];
+    pthread_create(&reader, NULL, health_reader_func, NULL);
+    for (int i = 0; i < LOCKERS; i++) pthread_create(&lockers[i], NULL, health_locker_func, NULL);
+
+    int rc = engine_start_load_test_table(health_engine, &table, &options);
+    atomic_store(&health_test_done, 1);
+    pthread_join(reader, NULL);
+    for (int i = 0; i < LOCKERS; i++) pthread_join(lockers[i], NULL);
+    atomic_store(&http_stop, 1);
+    pthread_join(server, NULL);
+    close(listener);
+    request_table_free(&table);
+    lock_stats_read(locks_after);
+
+    /* The server closes every connection, so each request connects afresh */
+    phase_metrics_t ttfb, connect;
+    generator_health_t health;
+    int ok = rc == 0 && engine_get_phase_metrics(health_engine, ENGINE_PHASE_TTFB, &ttfb) == 0 &&
+             engine_get_phase_metrics(health_engine, ENGINE_PHASE_CONNECT, &connect) == 0 &&
+             engine_get_generator_health(health_engine, &health) == 0 &&
+             ttfb.count == REQUESTS && connect.count == REQUESTS &&
+             health.scheduler_lag_count == REQUESTS && health.threads_measured > 0 &&
+             health.saturated == (health.saturation_reasons != 0) &&
+             health_shared == (uint64_t)LOCKERS * 2000 &&
+             /* any contended acquisition must have added some wait */
+             (locks_after[LOCK_SITE_REQUEST_LOOP].contended == locks_before[LOCK_SITE_REQUEST_LOOP].contended ||
+              locks_after[LOCK_SITE_REQUEST_LOOP].wait_ns > locks_before[LOCK_SITE_REQUEST_LOOP].wait_ns);
+    engine_destroy(health_engine);
+
+    if (!ok) {
+        printf("tsan_check: health test (mode %d) timed %llu ttfb, %llu connects, %llu lags of %d requests\n",
+               (int)mode, (unsigned long long)ttfb.count, (unsigned long long)connect.count,
+               (unsigned long long)health.scheduler_lag_count, REQUESTS);
+        return 1;
+    }
+    return 0;
+}
+
+/* HTTP versions: users asking for HTTP/2 over cleartext keep-alive
+   connections (so event loops wait for a multiplexable one) against the
+   HTTP/1.1 server above; every response must come back as HTTP/1.1 on a
+   connection of its own, which the server closes */
+static int run_protocol_check(engine_mode_t mode)
+{
+    enum { REQUESTS = 24 };
+    int port = 0;
+    int listener = listen_local(&port);
+    if (listener < 0) return 1;
+    pthread_t server;
+    atomic_store(&http_stop, 0);
+    pthread_create(&server, NULL, http_server_func, &listener);
+
+    request_table_t table;
+    request_table_init(&table);
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/version", port);
+    for (int i = 0; i < REQUESTS; i++) request_table_add(&table, "GET", url, NULL, NULL, 0, 5000);
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 2;
+    config.mode = mode;
+    config.event_loops = 2;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) {
+        request_table_free(&table);
+        return 1;
+    }
+
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 4;
+    options.duration_seconds = 10;
+    options.connection_mode = CONNECTION_MODE_KEEP_ALIVE;
+    options.http_version = HTTP_VERSION_2;
+    options.max_streams = 8;
+
+    int rc = engine_http_version_supported(HTTP_VERSION_2) ? engine_start_load_test_table(engine, &table, &options) : 0;
+    atomic_store(&http_stop, 1);
+    pthread_join(server, NULL);
+    close(listener);
+
+    protocol_metrics_t protocol;
+    engine_get_protocol_metrics(engine, &protocol);
+    int ok = rc == 0 && (!engine_http_version_supported(HTTP_VERSION_2) ||
+                         (protocol.streams == REQUESTS && protocol.streams_by_version[ENGINE_HTTP_1_1] == REQUESTS &&
+                          protocol.connections == REQUESTS));
+    /* A version this libcurl cannot send is refused up front */
+    options.http_version = HTTP_VERSION_3;
+    ok = ok && (engine_http_version_supported(HTTP_VERSION_3) || engine_start_load_test_table(engine, &table, &options) == -1);
+    request_table_free(&table);
+    engine_destroy(engine);
+
+    if (!ok) {
+        printf("tsan_check: protocol test (mode %d) counted %llu HTTP/1.1 streams on %llu connections of %d requests\n",
+               (int)mode, (unsigned long long)protocol.streams_by_version[ENGINE_HTTP_1_1],
+               (unsigned long long)protocol.connections, REQUESTS);
+        return 1;
+    }
+    return 0;
+}
+
+/* Looping through a staged profile: users ramp up, drop, and the test ends
+   on the profile's clock rather than when the table runs out */
+static int run_profile_check(engine_mode_t mode)
+{
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.mode = mode;
+    config.event_loops = 2;
+
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) return 1;
+
+    request_table_t table;
+    request_table_init(&table);
+    request_table_add(&table, "GET", "http://127.0.0.1:9/", NULL, NULL, 0, 2000);
+
+    static const load_stage_t stages[] = {
+        {6, 1, STAGE_RAMP_LINEAR},
+        {2, 1, STAGE_RAMP_STEP},
+    };
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 1;
+    options.loop_requests = true;
+    options.stages = stages;
+    options.num_stages = 2;
+
+    uint64_t start_us = get_time_us();
+    int rc = engine_start_load_test_table(engine, &table, &options);
+    uint64_t elapsed_us = get_time_us() - start_us;
+    metrics_t metrics;
+    engine_get_metrics(engine, &metrics);
+    engine_destroy(engine);
+    request_table_free(&table);
+
+    if (rc != 0 || metrics.total_requests <= 1 || elapsed_us < 1900000 || elapsed_us > 4000000) {
+        printf("tsan_check: staged loop (mode %d) sent %llu requests in %llu us\n", (int)mode,
+               (unsigned long long)metrics.total_requests, (unsigned long long)elapsed_us);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Windowed snapshots -------------------------------------------------- */
+
+#define WINDOW_CONSUMERS 2
+
+static engine_t *window_engine;
+static _Atomic int window_test_done;
+static _Atomic uint64_t window_requests;
+static _Atomic uint64_t window_samples;
+static _Atomic int window_errors;
+
+static void *window_consumer_func(void *arg)
+{
+    (void)arg;
+    histogram_t *interval = engine_get_latency_histogram(window_engine);
+    metrics_window_t window;
+    uint64_t last_sequence = 0;
+    int seen = 0;
+
+    for (;;) {
+        int done = atomic_load(&window_test_done);
+        int rc;
+        while ((rc = engine_next_metrics_window(window_engine, &window, interval)) == 1) {
+            /* Counters and counts are merged moments apart, so a single window's
+               may differ; summed over the test both are exact */
+            atomic_fetch_add(&window_requests, window.total_requests);
+            atomic_fetch_add(&window_samples, interval->total_count);
+            if (seen && window.sequence <= last_sequence) {
+                atomic_fetch_add(&window_errors, 1);
+            }
+            last_sequence = window.sequence;
+            seen = 1;
+        }
+        if (rc != 0) atomic_fetch_add(&window_errors, 1);
+        if (done) break;
+    }
+    histogram_destroy(interval);
+    return NULL;
+}
+
+static int run_window_check(engine_mode_t mode)
+{
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.mode = mode;
+    config.event_loops = 2;
+    config.metrics_window_ms = 100;
+
+    window_engine = engine_create_with_config(&config);
+    if (!window_engine) return 1;
+    atomic_store(&window_test_done, 0);
+    atomic_store(&window_requests, 0);
+    atomic_store(&window_samples, 0);
+    atomic_store(&window_errors, 0);
+
+    request_table_t table;
+    request_table_init(&table);
+    request_table_add(&table, "GET", "http://127.0.0.1:9/", NULL, NULL, 0, 2000);
+
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 4;
+    options.duration_seconds = 1;
+    options.loop_requests = true;
+
+    pthread_t consumers[WINDOW_CONSUMERS];
+    for (int i = 0; i < WINDOW_CONSUMERS; i++) {
+        pthread_create(&consumers[i], NULL, window_consumer_func, NULL);
+    }
+    int rc = engine_start_load_test_table(window_engine, &table, &options);
+    atomic_store(&window_test_done, 1);
+    for (int i = 0; i < WINDOW_CONSUMERS; i++) {
+        pthread_join(consumers[i], NULL);
+    }
+
+    metrics_t metrics;
+    engine_get_metrics(window_engine, &metrics);
+    engine_destroy(window_engine);
+    request_table_free(&table);
+
+    uint64_t windowed = atomic_load(&window_requests);
+    if (rc != 0 || metrics.total_requests == 0 || windowed != metrics.total_requests ||
+        atomic_load(&window_samples) != metrics.total_requests || atomic_load(&window_errors) != 0) {
+        printf("tsan_check: windows (mode %d) counted %llu of %llu requests, %d bad windows\n", (int)mode,
+               (unsigned long long)windowed, (unsigned long long)metrics.total_requests,
+               atomic_load(&window_errors));
+        return 1;
+    }
+    return 0;
+}
+
 /* ---- main ---------------------------------------------------------------- */
 
+/* ---- Native socket tests ------------------------------------------------ */
+
+#define SOCKET_TEST_CONNECTIONS 16
+#define SOCKET_TEST_ITERATIONS  10
+
+static _Atomic int echo_stop;
+
+/* Single-threaded poll() echo server for the socket test check */
+static void *echo_server_func(void *arg)
+{
+    int listener = *(int *)arg;
+    struct pollfd fds[SOCKET_TEST_CONNECTIONS + 1];
+    int count = 1;
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+
+    while (!atomic_load(&echo_stop)) {
+        if (poll(fds, (nfds_t)count, 50) <= 0) continue;
+        if ((fds[0].revents & POLLIN) && count <= SOCKET_TEST_CONNECTIONS) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0) {
+                fds[count].fd = fd;
+                fds[count].events = POLLIN;
+                fds[count].revents = 0;
+                count++;
+            }
+        }
+        for (int i = 1; i < count; i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            char buf[4096];
+            ssize_t n = recv(fds[i].fd, buf, sizeof(buf), 0);
+            if (n > 0 && send(fds[i].fd, buf, (size_t)n, MSG_NOSIGNAL) == n) continue;
+            close(fds[i].fd);
+            fds[i--] = fds[--count];
+        }
+    }
+    for (int i = 1; i < count; i++) close(fds[i].fd);
+    return NULL;
+}
+
+static int run_socket_test_check(void)
+{
+    int port = 0;
+    int listener = listen_local(&port);
+    if (listener < 0) return 1;
+    pthread_t server;
+    atomic_store(&echo_stop, 0);
+    pthread_create(&server, NULL, echo_server_func, &listener);
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.event_loops = 2;
+    config.metrics_window_ms = 100;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) return 1;
+
+    socket_target_t target = {"127.0.0.1", port};
+    socket_step_t steps[] = {
+        {SOCKET_STEP_SEND, "ping\n", 5, NULL},
+        {SOCKET_STEP_EXPECT_UNTIL, "\n", 1, "echo"},
+    };
+    socket_test_options_t options;
+    engine_socket_test_options_init(&options);
+    options.targets = &target;
+    options.num_targets = 1;
+    options.steps = steps;
+    options.num_steps = 2;
+    options.connections = SOCKET_TEST_CONNECTIONS;
+    options.iterations = SOCKET_TEST_ITERATIONS;
+
+    int rc = engine_start_socket_test(engine, &options);
+    atomic_store(&echo_stop, 1);
+    pthread_join(server, NULL);
+    close(listener);
+
+    static const char *names[] = {"TCP connect", "TCP send #1", "echo"};
+    static const uint64_t expected[] = {SOCKET_TEST_CONNECTIONS,
+                                        SOCKET_TEST_CONNECTIONS * SOCKET_TEST_ITERATIONS,
+                                        SOCKET_TEST_CONNECTIONS * SOCKET_TEST_ITERATIONS};
+    int ok = rc == 0 && engine_get_label_count(engine) == 3;
+    for (int l = 0; ok && l < 3; l++) {
+        label_metrics_t label;
+        ok = engine_get_label_metrics(engine, l, &label) == 0 && strcmp(label.name, names[l]) == 0 &&
+             label.successful_requests == expected[l] && label.failed_requests == 0;
+    }
+    engine_destroy(engine);
+
+    if (!ok) {
+        printf("tsan_check: socket test did not complete every step on every connection\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Batched UDP and blasting ------------------------------------------ */
+
+#define UDP_BATCH_DATAGRAMS 100
+#define UDP_BLAST_RATE 2000
+
+static void *udp_echo_func(void *arg)
+{
+    int fd = *(int *)arg;
+    struct pollfd pfd = {fd, POLLIN, 0};
+    while (!atomic_load(&echo_stop)) {
+        if (poll(&pfd, 1, 50) <= 0) continue;
+        char buf[2048];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        if (n > 0) sendto(fd, buf, (size_t)n, 0, (struct sockaddr *)&from, from_len);
+    }
+    return NULL;
+}
+
+static response_t udp_batch_response;
+
+static int run_udp_batch_check(void)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) != 0) return 1;
+    int port = ntohs(addr.sin_port);
+    pthread_t server;
+    atomic_store(&echo_stop, 0);
+    pthread_create(&server, NULL, udp_echo_func, &fd);
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.event_loops = 2;
+    config.metrics_window_ms = 100;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) return 1;
+
+    /* Batch send, then collect the echoes in batches */
+    static char payloads[UDP_BATCH_DATAGRAMS][16];
+    static char inbox[UDP_BATCH_DATAGRAMS][16];
+    udp_datagram_t datagrams[UDP_BATCH_DATAGRAMS];
+    udp_message_t messages[UDP_BATCH_DATAGRAMS];
+    for (int i = 0; i < UDP_BATCH_DATAGRAMS; i++) {
+        snprintf(payloads[i], sizeof(payloads[i]), "dgram-%03d", i);
+        datagrams[i].data = payloads[i];
+        datagrams[i].len = strlen(payloads[i]);
+        messages[i].data = inbox[i];
+        messages[i].capacity = sizeof(inbox[i]);
+    }
+    int sent = engine_udp_send_batch(engine, -1, datagrams, UDP_BATCH_DATAGRAMS, "127.0.0.1", port,
+                                     &udp_batch_response);
+    int socket_fd = udp_batch_response.protocol_data.udp.socket_fd;
+    int received = 0;
+    for (int round = 0; round < 20 && received < UDP_BATCH_DATAGRAMS; round++) {
+        int n = engine_udp_receive_batch(engine, socket_fd, messages + received, UDP_BATCH_DATAGRAMS - received,
+                                         200, &udp_batch_response);
+        if (n < 0) break;
+        received += n;
+    }
+    udp_close_endpoint("127.0.0.1", port, &udp_batch_response);
+    int batch_ok = sent == UDP_BATCH_DATAGRAMS && received == UDP_BATCH_DATAGRAMS &&
+                   messages[0].len == 9 && memcmp(messages[0].data, "dgram-", 6) == 0;
+
+    /* Rate-limited blast from two threads, echoes recorded concurrently */
+    udp_blast_options_t options;
+    engine_udp_blast_options_init(&options);
+    options.host = "127.0.0.1";
+    options.port = port;
+    options.flows = 2;
+    options.rate_pps = UDP_BLAST_RATE;
+    options.duration_seconds = 1;
+    options.expect_echo = true;
+    udp_blast_result_t result;
+    int rc = engine_start_udp_blast(engine, &options, &result);
+
+    atomic_store(&echo_stop, 1);
+    pthread_join(server, NULL);
+    close(fd);
+
+    label_metrics_t echo;
+    int blast_ok = rc == 0 && result.datagrams_sent >= UDP_BLAST_RATE / 2 &&
+                   result.datagrams_sent <= UDP_BLAST_RATE * 3 / 2 &&
+                   result.datagrams_received <= result.datagrams_sent &&
+                   engine_get_label_count(engine) == 1 && engine_get_label_metrics(engine, 0, &echo) == 0 &&
+                   echo.successful_requests == result.datagrams_received;
+    engine_destroy(engine);
+
+    if (!batch_ok) {
+        printf("tsan_check: UDP batch sent %d and got %d of %d echoes back\n", sent, received, UDP_BATCH_DATAGRAMS);
+        return 1;
+    }
+    if (!blast_ok) {
+        printf("tsan_check: UDP blast sent %llu, received %llu; counts do not add up\n",
+               (unsigned long long)result.datagrams_sent, (unsigned long long)result.datagrams_received);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Pipelined MQTT ------------------------------------------------------ */
+
+#define MQTT_TEST_PUBLISHERS  4
+#define MQTT_TEST_SUBSCRIBERS 2
+#define MQTT_TEST_MESSAGES    50
+#define MQTT_TEST_CLIENTS     (MQTT_TEST_PUBLISHERS + MQTT_TEST_SUBSCRIBERS)
+
+typedef struct {
+    int fd;
+    bool subscriber;
+    unsigned char buf[16384];
+    size_t len;
+} broker_client_t;
+
+static void broker_send(int fd, const void *data, size_t len)
+{
+    if (send(fd, data, len, MSG_NOSIGNAL) != (ssize_t)len) shutdown(fd, SHUT_RDWR);
+}
+
+/* Act on the complete packets in c->buf; false to drop the client */
+static bool broker_packets(broker_client_t *c, broker_client_t *clients, int count)
+{
+    size_t pos = 0;
+    while (c->len - pos >= 2) {
+        size_t length = 0, header = 1;
+        int shift = 0;
+        unsigned char byte;
+        do {
+            if (pos + header >= c->len) goto incomplete;
+            byte = c->buf[pos + header++];
+            length |= (size_t)(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        if (c->len - pos - header < length) break;
+
+        unsigned char type = c->buf[pos];
+        unsigned char *body = c->buf + pos + header;
+        if ((type & 0xF0) == MQTT_CONNECT) {
+            static const unsigned char connack[] = {MQTT_CONNACK, 2, 0, 0};
+            broker_send(c->fd, connack, sizeof(connack));
+        } else if (type == MQTT_SUBSCRIBE) {
+            unsigned char suback[] = {MQTT_SUBACK, 3, body[0], body[1], body[length - 1]};
+            c->subscriber = true;
+            broker_send(c->fd, suback, sizeof(suback));
+        } else if ((type & 0xF0) == MQTT_PUBLISH) {
+            int qos = (type >> 1) & 0x03;
+            size_t topic_end = 2 + (size_t)((body[0] << 8) | body[1]);
+            /* Fan out at QoS 0: same topic and payload, no packet ID */
+            unsigned char out[MAX_MQTT_MESSAGE_LENGTH + 512];
+            size_t payload = topic_end + (qos ? 2 : 0);
+            size_t out_len = topic_end + (length - payload);
+            size_t o = 0;
+            out[o++] = MQTT_PUBLISH;
+            for (size_t rl = out_len; ; ) {
+                out[o++] = (unsigned char)((rl % 128) | (rl >= 128 ? 0x80 : 0));
+                rl /= 128;
+                if (rl == 0) break;
+            }
+            memcpy(out + o, body, topic_end);
+            memcpy(out + o + topic_end, body + payload, length - payload);
+            for (int i = 0; i < count; i++) {
+                if (clients[i].subscriber) broker_send(clients[i].fd, out, o + out_len);
+            }
+            if (qos) {
+                unsigned char ack[] = {qos == 1 ? MQTT_PUBACK : MQTT_PUBREC, 2, body[topic_end], body[topic_end + 1]};
+                broker_send(c->fd, ack, sizeof(ack));
+            }
+        } else if (type == MQTT_PUBREL) {
+            unsigned char pubcomp[] = {MQTT_PUBCOMP, 2, body[0], body[1]};
+            broker_send(c->fd, pubcomp, sizeof(pubcomp));
+        } else if (type == MQTT_PINGREQ) {
+            static const unsigned char pingresp[] = {MQTT_PINGRESP, 0};
+            broker_send(c->fd, pingresp, sizeof(pingresp));
+        } else if (type == MQTT_DISCONNECT) {
+            return false;
+        }
+        pos += header + length;
+    }
+incomplete:
+    memmove(c->buf, c->buf + pos, c->len - pos);
+    c->len -= pos;
+    return true;
+}
+
+/* Single-threaded poll() broker: one topic, every subscriber gets everything */
+static void *mqtt_broker_func(void *arg)
+{
+    int listener = *(int *)arg;
+    static broker_client_t clients[MQTT_TEST_CLIENTS];
+    struct pollfd fds[MQTT_TEST_CLIENTS + 1];
+    int count = 0;
+
+    while (!atomic_load(&echo_stop)) {
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < count; i++) {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        if (poll(fds, (nfds_t)count + 1, 50) <= 0) continue;
+        for (int i = 0; i < count; i++) {
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            broker_client_t *c = &clients[i];
+            ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+            if (n > 0) {
+                c->len += (size_t)n;
+                if (broker_packets(c, clients, count)) continue;
+            }
+            close(c->fd);
+            c->fd = -1;
+            c->subscriber = false;
+        }
+        int live = 0;
+        for (int i = 0; i < count; i++) {
+            if (clients[i].fd >= 0) clients[live++] = clients[i];
+        }
+        count = live;
+        if ((fds[0].revents & POLLIN) && count < MQTT_TEST_CLIENTS) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0) {
+                memset(&clients[count], 0, sizeof(broker_client_t));
+                clients[count++].fd = fd;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) close(clients[i].fd);
+    return NULL;
+}
+
+static int run_mqtt_test_check(void)
+{
+    int port = 0;
+    int listener = listen_local(&port);
+    if (listener < 0) return 1;
+    pthread_t server;
+    atomic_store(&echo_stop, 0);
+    pthread_create(&server, NULL, mqtt_broker_func, &listener);
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.event_loops = 2;
+    config.metrics_window_ms = 100;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) return 1;
+
+    mqtt_test_options_t options;
+    engine_mqtt_test_options_init(&options);
+    options.host = "127.0.0.1";
+    options.port = port;
+    options.publishers = MQTT_TEST_PUBLISHERS;
+    options.subscribers = MQTT_TEST_SUBSCRIBERS;
+    options.qos = MQTT_QOS_2;
+    options.inflight = 8;
+    options.messages = MQTT_TEST_MESSAGES;
+    options.duration_seconds = 0;
+    mqtt_test_result_t result;
+    memset(&result, 0, sizeof(result));
+    int rc = engine_start_mqtt_test(engine, &options, &result);
+
+    atomic_store(&echo_stop, 1);
+    pthread_join(server, NULL);
+    close(listener);
+
+    uint64_t published = MQTT_TEST_PUBLISHERS * MQTT_TEST_MESSAGES;
+    label_metrics_t deliver;
+    int ok = rc == 0 && result.published == published && result.acknowledged == published &&
+             result.delivered == published * MQTT_TEST_SUBSCRIBERS && result.connect_failures == 0 &&
+             engine_get_label_count(engine) == 4 && engine_get_label_metrics(engine, 3, &deliver) == 0 &&
+             deliver.successful_requests == result.delivered;
+    engine_destroy(engine);
+
+    if (!ok) {
+        printf("tsan_check: MQTT test published %llu, acknowledged %llu, delivered %llu\n",
+               (unsigned long long)result.published, (unsigned long long)result.acknowledged,
+               (unsigned long long)result.delivered);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- WebSocket ------------------------------------------------------------ */
+
+#define WS_TEST_CONNECTIONS 12
+#define WS_TEST_MESSAGES    40
+
+typedef struct {
+    int fd;
+    bool upgraded;
+    unsigned char buf[16384];
+    size_t len;
+} ws_server_client_t;
+
+/* Answer the upgrade, then echo every data frame unmasked; false to drop
+   the client */
+static bool ws_server_input(ws_server_client_t *c)
+{
+    size_t pos = 0;
+    if (!c->upgraded) {
+        size_t end = websocket_find_headers_end((const char *)c->buf, c->len);
+        if (end == 0) return c->len < sizeof(c->buf);
+        c->buf[end - 1] = '\0';
+        const char *key = strstr((const char *)c->buf, "Sec-WebSocket-Key: ");
+        if (!key) return false;
+        char client_key[WS_KEY_LENGTH + 1], accept[WS_ACCEPT_LENGTH + 1], reply[256];
+        memcpy(client_key, key + 19, WS_KEY_LENGTH);
+        client_key[WS_KEY_LENGTH] = '\0';
+        websocket_accept_for_key(client_key, accept);
+        int n = snprintf(reply, sizeof(reply), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                         "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+        broker_send(c->fd, reply, (size_t)n);
+        c->upgraded = true;
+        pos = end;
+    }
+    for (;;) {
+        websocket_frame_t frame;
+        int parsed = websocket_parse_frame(c->buf + pos, c->len - pos, &frame);
+        if (parsed < 0 || (parsed > 0 && frame.payload_len >= 126)) return false;
+        if (parsed == 0 || c->len - pos - frame.header_len < frame.payload_len) break;
+        unsigned char out[2 + 125];
+        size_t len = (size_t)frame.payload_len;
+        out[0] = (unsigned char)(0x80 | frame.opcode);
+        out[1] = (unsigned char)len;
+        websocket_mask(out + 2, c->buf + pos + frame.header_len, len, frame.mask, 0);
+        broker_send(c->fd, out, 2 + len);
+        pos += frame.header_len + len;
+        if (frame.opcode == WS_OPCODE_CLOSE) return false;
+    }
+    memmove(c->buf, c->buf + pos, c->len - pos);
+    c->len -= pos;
+    return true;
+}
+
+/* Single-threaded poll() WebSocket echo server */
+static void *ws_server_func(void *arg)
+{
+    int listener = *(int *)arg;
+    static ws_server_client_t clients[WS_TEST_CONNECTIONS];
+    struct pollfd fds[WS_TEST_CONNECTIONS + 1];
+    int count = 0;
+
+    while (!atomic_load(&echo_stop)) {
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < count; i++) {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        if (poll(fds, (nfds_t)count + 1, 50) <= 0) continue;
+        for (int i = 0; i < count; i++) {
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ws_server_client_t *c = &clients[i];
+            ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+            if (n > 0) {
+                c->len += (size_t)n;
+                if (ws_server_input(c)) continue;
+            }
+            close(c->fd);
+            c->fd = -1;
+        }
+        int live = 0;
+        for (int i = 0; i < count; i++) {
+            if (clients[i].fd >= 0) clients[live++] = clients[i];
+        }
+        count = live;
+        if ((fds[0].revents & POLLIN) && count < WS_TEST_CONNECTIONS) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0) {
+                memset(&clients[count], 0, sizeof(ws_server_client_t));
+                clients[count++].fd = fd;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) close(clients[i].fd);
+    return NULL;
+}
+
+static int run_websocket_test_check(void)
+{
+    int port = 0;
+    int listener = listen_local(&port);
+    if (listener < 0) return 1;
+    pthread_t server;
+    atomic_store(&echo_stop, 0);
+    pthread_create(&server, NULL, ws_server_func, &listener);
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.event_loops = 2;
+    config.metrics_window_ms = 100;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) return 1;
+
+    char url[64];
+    snprintf(url, sizeof(url), "ws://127.0.0.1:%d/echo", port);
+    websocket_test_options_t options;
+    engine_websocket_test_options_init(&options);
+    options.url = url;
+    options.connections = WS_TEST_CONNECTIONS;
+    options.messages = WS_TEST_MESSAGES;
+    options.duration_seconds = 0;
+    websocket_test_result_t result;
+    memset(&result, 0, sizeof(result));
+    int rc = engine_start_websocket_test(engine, &options, &result);
+
+    atomic_store(&echo_stop, 1);
+    pthread_join(server, NULL);
+    close(listener);
+
+    uint64_t sent = WS_TEST_CONNECTIONS * WS_TEST_MESSAGES;
+    label_metrics_t message;
+    int ok = rc == 0 && result.connected == WS_TEST_CONNECTIONS && result.messages_sent == sent &&
+             result.echoes == sent && result.connect_failures == 0 && engine_get_label_count(engine) == 2 &&
+             engine_get_label_metrics(engine, 1, &message) == 0 && message.successful_requests == sent;
+    engine_destroy(engine);
+
+    if (!ok) {
+        printf("tsan_check: WebSocket test connected %llu, sent %llu, echoed %llu\n",
+               (unsigned long long)result.connected, (unsigned long long)result.messages_sent,
+               (unsigned long long)result.echoes);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Stopping a test and non-blocking requests -------------------------- */
+
+#define STOP_TEST_SECONDS 60
+#define SUBMIT_THREADS 4
+#define SUBMIT_REQUESTS 50
+
+static _Atomic int stopper_tries;
+static _Atomic int stopper_refused;
+
+/* Once the engine's test is under way, check that a claim and a second
+   start are both refused, then stop the test from outside */
+static void *stopper_func(void *arg)
+{
+    engine_t *engine = arg;
+    usleep(200000);
+    while (engine_claim(engine) == 0) {
+        engine_release(engine);
+        usleep(1000);
+    }
+    bool claim_busy = errno == EBUSY;
+
+    request_table_t table;
+    request_table_init(&table);
+    request_table_add(&table, "GET", "http://127.0.0.1:9/", "", NULL, 0, 2000);
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 1;
+    options.duration_seconds = 1;
+    errno = 0;
+    if (engine_start_load_test_table(engine, &table, &options) == -1 && errno == EBUSY && claim_busy) {
+        atomic_fetch_add(&stopper_refused, 1);
+    }
+    request_table_free(&table);
+
+    while (engine_stop(engine) != 0) {
+        atomic_fetch_add(&stopper_tries, 1);
+        usleep(1000);
+    }
+    return NULL;
+}
+
+static int run_stop_check(engine_mode_t mode)
+{
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.mode = mode;
+    config.event_loops = 2;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) return 1;
+
+    request_table_t table;
+    request_table_init(&table);
+    request_table_add(&table, "GET", "http://127.0.0.1:9/", "", NULL, 0, 2000);
+
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 4;
+    options.duration_seconds = STOP_TEST_SECONDS;
+    options.loop_requests = true;
+
+    int before = engine_stop(engine);
+    pthread_t stopper;
+    atomic_store(&stopper_tries, 0);
+    atomic_store(&stopper_refused, 0);
+    pthread_create(&stopper, NULL, stopper_func, engine);
+    uint64_t start_us = get_time_us();
+    int rc = engine_start_load_test_table(engine, &table, &options);
+    uint64_t elapsed_us = get_time_us() - start_us;
+    pthread_join(stopper, NULL);
+    int after = engine_stop(engine);
+    engine_destroy(engine);
+    request_table_free(&table);
+
+    if (rc != 0 || before != -1 || after != -1 || elapsed_us > 10000000 || atomic_load(&stopper_refused) != 1) {
+        printf("tsan_check: stopped test (mode %d) returned %d after %llu ms, second start refused %d\n",
+               (int)mode, rc, (unsigned long long)(elapsed_us / 1000), atomic_load(&stopper_refused));
+        return 1;
+    }
+    return 0;
+}
+
+/* Requests to a listener that never answers must not hold up the end of a
+   timed test or a stop: both abandon them well inside their 30 s timeout */
+static int run_abort_check(engine_mode_t mode)
+{
+    int port = 0;
+    int listen_fd = listen_local(&port);
+    if (listen_fd < 0) return 1;
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    config.mode = mode;
+    config.event_loops = 2;
+    engine_t *engine = engine_create_with_config(&config);
+    if (!engine) {
+        close(listen_fd);
+        return 1;
+    }
+
+    request_table_t table;
+    request_table_init(&table);
+    request_table_add(&table, "GET", url, "", NULL, 0, 30000);
+
+    load_test_options_t options;
+    engine_load_test_options_init(&options);
+    options.concurrent_users = 4;
+    options.duration_seconds = 1;
+    options.loop_requests = true;
+
+    uint64_t start_us = get_time_us();
+    int timed_rc = engine_start_load_test_table(engine, &table, &options);
+    uint64_t timed_us = get_time_us() - start_us;
+
+    options.duration_seconds = STOP_TEST_SECONDS;
+    pthread_t stopper;
+    pthread_create(&stopper, NULL, stopper_func, engine);
+    start_us = get_time_us();
+    int stopped_rc = engine_start_load_test_table(engine, &table, &options);
+    uint64_t stopped_us = get_time_us() - start_us;
+    pthread_join(stopper, NULL);
+
+    metrics_t metrics;
+    engine_get_metrics(engine, &metrics);
+    uint64_t aborted_requests = metrics.total_requests;
+
+    /* The aborts ended with their tests: a fire-and-forget request to a
+       closed port is sent by the pool workers and counted as a failure */
+    http_request_t *request = calloc(1, sizeof(http_request_t));
+    http_response_t *response = malloc(sizeof(http_response_t));
+    if (request && response) {
+        strcpy(request->method, "GET");
+        strcpy(request->url, "http://127.0.0.1:9/");
+        request->timeout_ms = 2000;
+        engine_execute_request(engine, request, response);
+        for (int waited = 0; waited < 5000; waited += 10) {
+            engine_get_metrics(engine, &metrics);
+            if (metrics.total_requests > aborted_requests) break;
+            usleep(10000);
+        }
+    }
+    free(request);
+    free(response);
+    engine_destroy(engine);
+    request_table_free(&table);
+    close(listen_fd);
+
+    /* Nothing ever completed, and abandoned requests are not samples */
+    if (timed_rc != 0 || stopped_rc != 0 || timed_us > 2000000 || stopped_us > 1500000 ||
+        aborted_requests != 0 || metrics.total_requests != 1) {
+        printf("tsan_check: abort (mode %d): timed test %d after %llu ms, stopped test %d after %llu ms, "
+               "%llu requests recorded, %llu after a queued request\n", (int)mode, timed_rc,
+               (unsigned long long)(timed_us / 1000), stopped_rc, (unsigned long long)(stopped_us / 1000),
+               (unsigned long long)aborted_requests, (unsigned long long)metrics.total_requests);
+        return 1;
+    }
+    return 0;
+}
+
+static engine_t *submit_engine;
+
+static void *submit_func(void *arg)
+{
+    (void)arg;
+    http_request_t *request = calloc(1, sizeof(http_request_t));
+    if (!request) return NULL;
+    strcpy(request->method, "POST");
+    strcpy(request->url, "http://127.0.0.1:9/");
+    strcpy(request->headers, "X-Test: 1\nX-Other: 2");
+    strcpy(request->body, "payload");
+    request->timeout_ms = 2000;
+    for (int i = 0; i < SUBMIT_REQUESTS; i++) {
+        if (engine_submit_request(submit_engine, request) == 0) break;
+    }
+    free(request);
+    return NULL;
+}
+
+static int run_request_loop_check(void)
+{
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    submit_engine = engine_create_with_config(&config);
+    if (!submit_engine) return 1;
+    int fd = engine_completion_fd(submit_engine);
+
+    pthread_t threads[SUBMIT_THREADS];
+    for (int i = 0; i < SUBMIT_THREADS; i++) {
+        pthread_create(&threads[i], NULL, submit_func, NULL);
+    }
+
+    /* Collect on this thread the way an event loop would: wait for the
+       fd, then drain; every ticket must come back exactly once */
+    static bool seen[SUBMIT_THREADS * SUBMIT_REQUESTS + 1];
+    http_response_t *response = malloc(sizeof(http_response_t));
+    int collected = 0, duplicates = 0, bad = 0;
+    uint64_t deadline_us = get_time_us() + 30000000;
+    while (response && collected < SUBMIT_THREADS * SUBMIT_REQUESTS && get_time_us() < deadline_us) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        poll(&pfd, 1, 100);
+        uint64_t ticket;
+        while (engine_collect_response(submit_engine, &ticket, response) == 1) {
+            if (ticket == 0 || ticket > SUBMIT_THREADS * SUBMIT_REQUESTS) {
+                bad++;
+            } else if (seen[ticket]) {
+                duplicates++;
+            } else {
+                seen[ticket] = true;
+            }
+            if (response->success || response->error_message[0] == '\0') bad++;
+            collected++;
+        }
+    }
+    for (int i = 0; i < SUBMIT_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(response);
+
+    metrics_t metrics;
+    engine_get_metrics(submit_engine, &metrics);
+    uint64_t ticket;
+    http_response_t leftover;
+    int extra = engine_collect_response(submit_engine, &ticket, &leftover);
+    engine_destroy(submit_engine);
+
+    if (collected != SUBMIT_THREADS * SUBMIT_REQUESTS || duplicates || bad || extra != 0 ||
+        metrics.total_requests != (uint64_t)collected || metrics.failed_requests != (uint64_t)collected) {
+        printf("tsan_check: request loop collected %d of %d responses (%d duplicate, %d bad), metrics %llu\n",
+               collected, SUBMIT_THREADS * SUBMIT_REQUESTS, duplicates, bad,
+               (unsigned long long)metrics.total_requests);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Per-thread request scratch ---------------------------------------- */
+
+#define SCRATCH_THREADS 4
+#define SCRATCH_REQUESTS 20
+
+static engine_t *scratch_engine;
+static _Atomic int scratch_failures;
+
+static void *scratch_func(void *arg)
+{
+    (void)arg;
+    http_request_t *request = calloc(1, sizeof(http_request_t));
+    http_response_t *response = malloc(sizeof(http_response_t));
+    if (request && response) {
+        strcpy(request->method, "GET");
+        strcpy(request->url, "http://127.0.0.1:9/");
+        strcpy(request->headers, "X-Test: 1\r\nX-Other: 2\n\nAccept: */*");
+        request->timeout_ms = 2000;
+        for (int i = 0; i < SCRATCH_REQUESTS; i++) {
+            if (engine_execute_request_sync(scratch_engine, request, response) != 0 || response->success) {
+                atomic_fetch_add(&scratch_failures, 1);
+            }
+        }
+    }
+    free(request);
+    free(response);
+    return NULL;
+}
+
+static int run_scratch_check(void)
+{
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 10;
+    config.worker_threads = 1;
+    scratch_engine = engine_create_with_config(&config);
+    if (!scratch_engine) return 1;
+
+    scratch_stats_t before, after;
+    engine_get_alloc_stats(scratch_engine, &before);
+    pthread_t threads[SCRATCH_THREADS];
+    for (int i = 0; i < SCRATCH_THREADS; i++) {
+        pthread_create(&threads[i], NULL, scratch_func, NULL);
+    }
+    for (int i = 0; i < SCRATCH_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    engine_get_alloc_stats(scratch_engine, &after);
+    metrics_t metrics;
+    engine_get_metrics(scratch_engine, &metrics);
+    engine_destroy(scratch_engine);
+
+    if (atomic_load(&scratch_failures) != 0 || metrics.total_requests != SCRATCH_THREADS * SCRATCH_REQUESTS ||
+        after.heap_allocations != before.heap_allocations || after.arenas != before.arenas ||
+        after.high_water == 0) {
+        printf("tsan_check: scratch check sent %llu requests, %llu heap allocations, %llu arenas left\n",
+               (unsigned long long)metrics.total_requests,
+               (unsigned long long)(after.heap_allocations - before.heap_allocations),
+               (unsigned long long)after.arenas);
+        return 1;
+    }
+    return 0;
+}
+
+/* ---- Lock-free request dispatch ----------------------------------------- */
+
+#define DISPATCH_THREADS 4
+#define DISPATCH_ITEMS 20000
+#define DISPATCH_REQUESTS 50
+
+static mpmc_queue_t *dispatch_queue;
+static _Atomic unsigned char dispatch_seen[DISPATCH_THREADS * DISPATCH_ITEMS];
+static _Atomic int dispatch_consumed;
+static engine_t *dispatch_engine;
+
+static void *dispatch_producer(void *arg)
+{
+    int id = (int)(intptr_t)arg;
+    for (int i = 0; i < DISPATCH_ITEMS; i++) {
+        uint32_t *slot;
+        while (!(slot = mpmc_queue_reserve(dispatch_queue))) sched_yield();
+        *slot = (uint32_t)(id * DISPATCH_ITEMS + i);
+        mpmc_queue_publish(dispatch_queue, slot);
+    }
+    return NULL;
+}
+
+static void *dispatch_consumer(void *arg)
+{
+    (void)arg;
+    const int total = DISPATCH_THREADS * DISPATCH_ITEMS;
+    while (atomic_load(&dispatch_consumed) < total) {
+        void *items[8];
+        int n = mpmc_queue_claim(dispatch_queue, items, 8);
+        if (n == 0) {
+            uint32_t key = mpmc_queue_prepare_wait(dispatch_queue);
+            if (atomic_load(&dispatch_consumed) >= total || mpmc_queue_depth(dispatch_queue) > 0) {
+                mpmc_queue_cancel_wait(dispatch_queue);
+            } else {
+                mpmc_queue_wait(dispatch_queue, key);
+            }
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            atomic_fetch_add(&dispatch_seen[*(uint32_t *)items[i]], 1);
+            mpmc_queue_release(dispatch_queue, items[i]);
+        }
+        if (atomic_fetch_add(&dispatch_consumed, n) + n >= total) mpmc_queue_wake_all(dispatch_queue);
+    }
+    return NULL;
+}
+
+static void *dispatch_submit_func(void *arg)
+{
+    (void)arg;
+    http_request_t *request = calloc(1, sizeof(http_request_t));
+    http_response_t *response = malloc(sizeof(http_response_t));
+    if (request && response) {
+        strcpy(request->method, "GET");
+        strcpy(request->url, "http://127.0.0.1:9/");
+        request->timeout_ms = 2000;
+        for (int i = 0; i < DISPATCH_REQUESTS; i++) {
+            while (engine_execute_request(dispatch_engine, request, response) != 0) usleep(1000);
+        }
+    }
+    free(request);
+    free(response);
+    return NULL;
+}
+
+static int run_dispatch_check(void)
+{
+    dispatch_queue = mpmc_queue_create(sizeof(uint32_t), 64);
+    if (!dispatch_queue) return 1;
+    pthread_t producers[DISPATCH_THREADS], consumers[DISPATCH_THREADS];
+    for (int i = 0; i < DISPATCH_THREADS; i++) {
+        pthread_create(&consumers[i], NULL, dispatch_consumer, NULL);
+        pthread_create(&producers[i], NULL, dispatch_producer, (void *)(intptr_t)i);
+    }
+    for (int i = 0; i < DISPATCH_THREADS; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+    size_t depth = mpmc_queue_depth(dispatch_queue);
+    mpmc_queue_destroy(dispatch_queue);
+
+    int missing = 0, duplicates = 0;
+    for (int i = 0; i < DISPATCH_THREADS * DISPATCH_ITEMS; i++) {
+        unsigned char seen = atomic_load(&dispatch_seen[i]);
+        if (seen == 0) missing++;
+        else if (seen > 1) duplicates++;
+    }
+    if (missing || duplicates || depth != 0) {
+        printf("tsan_check: dispatch queue lost %d and duplicated %d items, %zu left\n", missing, duplicates, depth);
+        return 1;
+    }
+
+    engine_config_t config;
+    engine_config_init(&config);
+    config.max_connections = 8;
+    config.worker_threads = 4;
+    dispatch_engine = engine_create_with_config(&config);
+    if (!dispatch_engine) return 1;
+    pthread_t threads[DISPATCH_THREADS];
+    for (int i = 0; i < DISPATCH_THREADS; i++) {
+        pthread_create(&threads[i], NULL, dispatch_submit_func, NULL);
+    }
+    for (int i = 0; i < DISPATCH_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    metrics_t metrics;
+    for (int waited = 0; waited < 30000; waited += 10) {
+        engine_get_metrics(dispatch_engine, &metrics);
+        if (metrics.total_requests >= DISPATCH_THREADS * DISPATCH_REQUESTS) break;
+        usleep(10000);
+    }
+    engine_destroy(dispatch_engine);
+
+    if (metrics.total_requests != DISPATCH_THREADS * DISPATCH_REQUESTS ||
+        metrics.failed_requests != metrics.total_requests) {
+        printf("tsan_check: pool workers sent %llu of %d queued requests\n",
+               (unsigned long long)metrics.total_requests, DISPATCH_THREADS * DISPATCH_REQUESTS);
+        return 1;
+    }
+    return 0;
+}
+
 int main(void)
 {
     pthread_t tcp_threads[NUM_THREADS];
@@ -132,6 +2202,33 @@ int main(void)
         pthread_join(db_threads[i],   NULL);
     }
 
+    if (run_pool_check() != 0 || run_pool_growth_check() != 0 || run_metrics_check() != 0 || run_histogram_check() != 0 ||
+        run_jsonl_check() != 0 || run_response_match_check() != 0) {
+        return 1;
+    }
+    static const engine_mode_t modes[] = {ENGINE_MODE_THREADED, ENGINE_MODE_EVENT};
+    static const arrival_mode_t arrivals[] = {ARRIVAL_MODE_CLOSED, ARRIVAL_MODE_CONSTANT, ARRIVAL_MODE_POISSON};
+    for (int m = 0; m < 2; m++) {
+        for (int a = 0; a < 3; a++) {
+            if (run_load_test_check(modes[m], arrivals[a]) != 0) return 1;
+        }
+        if (run_placement_check(modes[m]) != 0) return 1;
+        if (run_replay_check(modes[m]) != 0) return 1;
+        if (run_param_check(modes[m]) != 0) return 1;
+        if (run_assertion_check(modes[m]) != 0) return 1;
+        if (run_health_check(modes[m]) != 0) return 1;
+        if (run_protocol_check(modes[m]) != 0) return 1;
+        if (run_profile_check(modes[m]) != 0) return 1;
+        if (run_window_check(modes[m]) != 0) return 1;
+        if (run_stop_check(modes[m]) != 0) return 1;
+        if (run_abort_check(modes[m]) != 0) return 1;
+    }
+    if (run_request_loop_check() != 0 || run_scratch_check() != 0 || run_dispatch_check() != 0) return 1;
+    if (run_socket_test_check() != 0 || run_udp_batch_check() != 0 || run_mqtt_test_check() != 0 ||
+        run_websocket_test_check() != 0) {
+        return 1;
+    }
+
     printf("tsan_check: all threads completed, no races detected\n");
     return 0;
 }